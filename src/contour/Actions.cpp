@@ -50,14 +50,18 @@ optional<Action> fromString(string const& _name)
 {
     auto static const mappings = array{
         mapAction<actions::FollowHyperlink>("FollowHyperlink"),
+        mapAction<actions::CancelPaste>("CancelPaste"),
         mapAction<actions::ChangeProfile>("ChangeProfile"),
         mapAction<actions::CopySelection>("CopySelection"),
         mapAction<actions::DecreaseFontSize>("DecreaseFontSize"),
         mapAction<actions::DecreaseOpacity>("DecreaseOpacity"),
+        mapAction<actions::DumpInputLatency>("DumpInputLatency"),
+        mapAction<actions::ExportScrollback>("ExportScrollback"),
         mapAction<actions::IncreaseFontSize>("IncreaseFontSize"),
         mapAction<actions::IncreaseOpacity>("IncreaseOpacity"),
         mapAction<actions::NewTerminal>("NewTerminal"),
         mapAction<actions::OpenConfiguration>("OpenConfiguration"),
+        mapAction<actions::OpenFileIntoScrollback>("OpenFileIntoScrollback"),
         mapAction<actions::OpenFileManager>("OpenFileManager"),
         mapAction<actions::PasteClipboard>("PasteClipboard"),
         mapAction<actions::PasteSelection>("PasteSelection"),
@@ -74,6 +78,8 @@ optional<Action> fromString(string const& _name)
         mapAction<actions::ScrollToTop>("ScrollToTop"),
         mapAction<actions::ScrollUp>("ScrollUp"),
         mapAction<actions::SendChars>("SendChars"),
+        mapAction<actions::ToggleFold>("ToggleFold"),
+        mapAction<actions::TogglePerformanceHud>("TogglePerformanceHud"),
         mapAction<actions::ToggleFullScreen>("ToggleFullscreen"),
         mapAction<actions::WriteScreen>("WriteScreen"),
         mapAction<actions::ResetFontSize>("ResetFontSize"),
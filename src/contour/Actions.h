@@ -36,20 +36,26 @@ struct ScrollPageUp{};
 struct ScrollPageDown{};
 struct ScrollMarkUp{};
 struct ScrollMarkDown{};
+struct ToggleFold{};
 struct ScrollToTop{};
 struct ScrollToBottom{};
 struct PasteClipboard{};
 struct CopySelection{};
 struct PasteSelection{};
+struct CancelPaste{};
 struct ChangeProfile{ std::string name; };
 struct NewTerminal{ std::optional<std::string> profileName; };
 struct OpenConfiguration{};
 struct OpenFileManager{};
+struct OpenFileIntoScrollback{ std::optional<std::string> path; };
+struct ExportScrollback{ std::optional<std::string> path; bool withAttributes = false; };
 struct Quit{};
 struct ResetFontSize{};
 struct ReloadConfig{ std::optional<std::string> profileName; };
 struct ResetConfig{};
 struct CopyPreviousMarkRange{};
+struct TogglePerformanceHud{};
+struct DumpInputLatency{};
 // CloseTab
 // OpenTab
 // FocusNextTab
@@ -76,17 +82,23 @@ using Action = std::variant<
     ScrollPageDown,
     ScrollMarkUp,
     ScrollMarkDown,
+    ToggleFold,
     ScrollToTop,
     ScrollToBottom,
     CopySelection,
     PasteSelection,
     PasteClipboard,
+    CancelPaste,
     ChangeProfile,
     NewTerminal,
     OpenConfiguration,
     OpenFileManager,
+    OpenFileIntoScrollback,
+    ExportScrollback,
     Quit,
-    CopyPreviousMarkRange
+    CopyPreviousMarkRange,
+    TogglePerformanceHud,
+    DumpInputLatency
 >;
 
 std::optional<Action> fromString(std::string const& _name);
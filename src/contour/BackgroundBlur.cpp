@@ -15,6 +15,15 @@
 
 #if defined(CONTOUR_BLUR_PLATFORM_KWIN)
 #include <KWindowEffects>
+#elif defined(CONTOUR_BLUR_PLATFORM_X11)
+#include <QtGui/QGuiApplication>
+#include <xcb/xcb.h>
+#include <cstdlib>
+#include <string_view>
+#elif defined(CONTOUR_BLUR_PLATFORM_MACOS)
+#include <objc/message.h>
+#include <objc/runtime.h>
+#include <cstdint>
 #endif
 
 #include <QtCore/QDebug>
@@ -23,13 +32,60 @@
 #include <Windows.h>
 #endif
 
+#if defined(CONTOUR_BLUR_PLATFORM_MACOS)
+// Private CoreGraphics API, as used by the window server for blurring behind windows.
+extern "C" {
+    int CGSDefaultConnectionForThread();
+    int32_t CGSSetWindowBackgroundBlurRadius(int _connection, long _windowNumber, int _radius);
+}
+#endif
+
 namespace WindowBackgroundBlur {
 
+namespace
+{
+    // Radius in points of the blur applied by the window server, where it is configurable.
+    [[maybe_unused]] auto constexpr BlurRadius = 20;
+}
+
 void setEnabled(WId _winId, bool _enable)
 {
 #if defined(CONTOUR_BLUR_PLATFORM_KWIN)
     KWindowEffects::enableBlurBehind(_winId, _enable);
     KWindowEffects::enableBackgroundContrast(_winId, _enable);
+#elif defined(CONTOUR_BLUR_PLATFORM_X11)
+    // Same window property as set by KWindowEffects, which is honored by KWin and other X11
+    // compositors, whereas an empty region means the whole window.
+    if (QGuiApplication::platformName() != "xcb")
+        return;
+
+    xcb_connection_t* connection = xcb_connect(nullptr, nullptr);
+    if (!xcb_connection_has_error(connection))
+    {
+        auto constexpr name = std::string_view{"_KDE_NET_WM_BLUR_BEHIND_REGION"};
+        auto const cookie = xcb_intern_atom(connection, 0, static_cast<uint16_t>(name.size()), name.data());
+        if (xcb_intern_atom_reply_t* reply = xcb_intern_atom_reply(connection, cookie, nullptr); reply)
+        {
+            auto const window = static_cast<xcb_window_t>(_winId);
+            if (_enable)
+                xcb_change_property(connection, XCB_PROP_MODE_REPLACE, window, reply->atom, XCB_ATOM_CARDINAL, 32, 0, nullptr);
+            else
+                xcb_delete_property(connection, window, reply->atom);
+            std::free(reply);
+            xcb_flush(connection);
+        }
+    }
+    xcb_disconnect(connection);
+#elif defined(CONTOUR_BLUR_PLATFORM_MACOS)
+    // The window ID is the window's NSView, whose NSWindow is blurred by the window server.
+    auto const sendId = reinterpret_cast<id (*)(id, SEL)>(objc_msgSend);
+    auto const sendLong = reinterpret_cast<long (*)(id, SEL)>(objc_msgSend);
+    if (id const window = sendId(reinterpret_cast<id>(_winId), sel_registerName("window")); window != nullptr)
+    {
+        auto const windowNumber = sendLong(window, sel_registerName("windowNumber"));
+        if (CGSSetWindowBackgroundBlurRadius(CGSDefaultConnectionForThread(), windowNumber, _enable ? BlurRadius : 0) != 0)
+            qDebug() << "CGSSetWindowBackgroundBlurRadius failed";
+    }
 #elif defined(_WIN32)
     // Awesome hack with the noteworty links:
     // * https://gist.github.com/ethanhs/0e157e4003812e99bf5bc7cb6f73459f (used as code template)
@@ -84,7 +140,7 @@ void setEnabled(WId _winId, bool _enable)
         }
     }
 #else
-   // Get me working on other platforms/compositors (such as OSX, Gnome, ...), please.
+   // Get me working on other platforms/compositors (such as Gnome on Wayland), please.
 #endif
 }
 
@@ -12,6 +12,7 @@
  * limitations under the License.
  */
 #include "Config.h"
+#include "ConfigCache.h"
 #include "contour_yaml.h"
 
 #include <terminal/InputGenerator.h>
@@ -24,6 +25,8 @@
 #include <yaml-cpp/yaml.h>
 #include <yaml-cpp/ostream_wrapper.h>
 
+#include <QtCore/qnamespace.h>
+
 #include <algorithm>
 #include <array>
 #include <fstream>
@@ -148,19 +151,19 @@ namespace {
         return mods;
     };
 
-    QKeySequence toQtKeySequence(terminal::CharInputEvent _char) {
+    int toQtKeyCode(terminal::CharInputEvent _char) {
         auto const mods = toQtKeyboardModifier(_char.modifier);
         using terminal::ControlCode::C0;
         switch (static_cast<C0>(_char.value))
         {
             case C0::CR:
-                return QKeySequence(Qt::Key_Return | mods);
+                return static_cast<int>(Qt::Key_Return | mods);
             default:
-                return QKeySequence(_char.value | mods);
+                return static_cast<int>(_char.value | mods);
         }
     };
 
-    QKeySequence toQtKeySequence(terminal::KeyInputEvent const& _key) {
+    int toQtKeyCode(terminal::KeyInputEvent const& _key) {
         using terminal::Key;
 
         static auto constexpr mapping = array{
@@ -208,7 +211,7 @@ namespace {
         };
 
         if (auto i = find_if(begin(mapping), end(mapping), [_key](auto const& x) { return x.first == _key.key; }); i != end(mapping))
-            return QKeySequence{static_cast<int>(i->second) | static_cast<int>(toQtKeyboardModifier(_key.modifier)) };
+            return static_cast<int>(i->second) | static_cast<int>(toQtKeyboardModifier(_key.modifier));
 
         throw std::invalid_argument(fmt::format("Unsupported input Key. {}", _key.key));
     };
@@ -259,6 +262,34 @@ FileSystem::path configHome()
     return configHome("contour");
 }
 
+FileSystem::path cacheHome(string const& _programName)
+{
+#if defined(__unix__) || defined(__APPLE__)
+	if (auto const *value = getenv("XDG_CACHE_HOME"); value && *value)
+		return FileSystem::path{value} / _programName;
+	else if (auto const *value = getenv("HOME"); value && *value)
+		return FileSystem::path{value} / ".cache" / _programName;
+#endif
+
+#if defined(_WIN32)
+	DWORD size = GetEnvironmentVariable("LOCALAPPDATA", nullptr, 0);
+	if (size)
+	{
+		std::vector<char> buf;
+		buf.resize(size);
+		GetEnvironmentVariable("LOCALAPPDATA", &buf[0], size);
+		return FileSystem::path{&buf[0]} / _programName / "cache";
+	}
+#endif
+
+	throw runtime_error{"Could not find cache home folder."};
+}
+
+FileSystem::path cacheHome()
+{
+    return cacheHome("contour");
+}
+
 template <typename T>
 bool softLoadValue(YAML::Node const& _node, string const& _name, T& _store)
 {
@@ -427,7 +458,7 @@ optional<variant<terminal::Key, char32_t>> parseKeyOrChar(string const& _name)
     return nullopt;
 }
 
-void parseInputMapping(Config& _config, YAML::Node const& _mapping)
+void parseInputMapping(Config& _config, Config::KeyMappings& _keyMappings, YAML::Node const& _mapping)
 {
 	using namespace terminal;
 
@@ -457,6 +488,29 @@ void parseInputMapping(Config& _config, YAML::Node const& _mapping)
                 return action;
         }
 
+        if (holds_alternative<actions::ExportScrollback>(action))
+        {
+            auto result = actions::ExportScrollback{};
+            if (auto path = _parent["path"]; path && path.IsScalar())
+                result.path = path.as<string>();
+            if (auto format = _parent["format"]; format && format.IsScalar())
+            {
+                if (format.as<string>() == "vt")
+                    result.withAttributes = true;
+                else if (format.as<string>() != "text")
+                    return nullopt;
+            }
+            return result;
+        }
+
+        if (holds_alternative<actions::OpenFileIntoScrollback>(action))
+        {
+            if (auto path = _parent["path"]; path && path.IsScalar())
+                return actions::OpenFileIntoScrollback{path.as<string>()};
+            else
+                return action;
+        }
+
         if (holds_alternative<actions::ReloadConfig>(action))
         {
             if (auto profileName = _parent["profile"]; profileName.IsScalar())
@@ -557,10 +611,10 @@ void parseInputMapping(Config& _config, YAML::Node const& _mapping)
         {
             if (keyEvent.has_value())
             {
-                if (holds_alternative<KeyInputEvent>(*keyEvent))
-                    _config.keyMappings[toQtKeySequence(get<KeyInputEvent>(*keyEvent))].emplace_back(*action);
-                else
-                    _config.keyMappings[toQtKeySequence(get<CharInputEvent>(*keyEvent))].emplace_back(*action);
+                auto const keyCode = holds_alternative<KeyInputEvent>(*keyEvent)
+                    ? toQtKeyCode(get<KeyInputEvent>(*keyEvent))
+                    : toQtKeyCode(get<CharInputEvent>(*keyEvent));
+                _keyMappings.try_emplace(keyCode).first->emplace_back(*action);
             }
         }
         else if (auto const [mouseEvent, ok] = parseMouseEvent(_mapping["mouse"], mods.value()); ok)
@@ -749,6 +803,15 @@ TerminalProfile loadTerminalProfile(YAML::Node const& _node,
 
     softLoadValue(_node, "tab_width", profile.tabWidth);
 
+    if (auto mouse = _node["mouse"]; mouse)
+        softLoadValue(mouse, "coalesce_motion", profile.mouseMotionCoalescing);
+
+    if (auto latency = _node["latency"]; latency)
+    {
+        if (auto parseSlice = latency["parse_slice"]; parseSlice)
+            profile.parseSliceTime = chrono::microseconds(max(parseSlice.as<int>(), 1));
+    }
+
     if (auto history = _node["history"]; history)
     {
         if (auto limit = history["limit"]; limit)
@@ -759,6 +822,23 @@ TerminalProfile loadTerminalProfile(YAML::Node const& _node,
                 profile.maxHistoryLineCount = limit.as<size_t>();
         }
 
+        if (auto spillThreshold = history["spill_threshold"]; spillThreshold)
+        {
+            if (spillThreshold.as<int>() < 0)
+                profile.historySpillThreshold = nullopt;
+            else
+                profile.historySpillThreshold = spillThreshold.as<size_t>() * 1024 * 1024;
+        }
+
+        if (auto pageSize = history["page_size"]; pageSize)
+            profile.historyPageSize = static_cast<size_t>(max(pageSize.as<int>(), 16));
+
+        if (auto cachedPages = history["cached_pages"]; cachedPages)
+            profile.historyCachedPages = static_cast<size_t>(max(cachedPages.as<int>(), 1));
+
+        if (auto snapshotFile = history["snapshot_file"]; snapshotFile && snapshotFile.IsScalar() && !snapshotFile.as<string>().empty())
+            profile.historySnapshotFile = {FileSystem::path{snapshotFile.as<string>()}};
+
         softLoadValue(history, "auto_scroll_on_update", profile.autoScrollOnUpdate);
         softLoadValue(history, "scroll_multiplier", profile.historyScrollMultiplier);
     }
@@ -793,32 +873,64 @@ TerminalProfile loadTerminalProfile(YAML::Node const& _node,
 
         if (cursor["blinking_interval"].IsDefined())
             profile.cursorBlinkInterval = chrono::milliseconds(cursor["blinking_interval"].as<int>());
+
+        if (cursor["motion_duration"].IsDefined())
+            profile.cursorMotionDuration = chrono::milliseconds(cursor["motion_duration"].as<int>());
     }
 
     return profile;
 }
 
-void loadConfigFromFile(Config& _config,
-                        FileSystem::path const& _fileName,
-                        Logger const& _logger)
+void loadConfigFromYAML(Config& _config, YAML::Node const& _doc, Logger const& _logger)
 {
-    _config.backingFilePath = _fileName;
-    createFileIfNotExists(_config.backingFilePath);
-
-    YAML::Node doc = YAML::LoadFile(_fileName.string());
-
-    softLoadValue(doc, "word_delimiters", _config.wordDelimiters);
+    softLoadValue(_doc, "word_delimiters", _config.wordDelimiters);
 
-    if (auto images = doc["images"]; images)
+    if (auto images = _doc["images"]; images)
     {
         softLoadValue(images, "sixel_scrolling", _config.sixelScrolling);
         softLoadValue(images, "sixel_cursor_conformance", _config.sixelCursorConformance);
         softLoadValue(images, "sixel_register_count", _config.maxImageColorRegisters);
+        softLoadValue(images, "sixel_decoder_threads", _config.sixelDecoderThreads);
         softLoadValue(images, "max_width", _config.maxImageSize.width);
         softLoadValue(images, "max_height", _config.maxImageSize.height);
+        softLoadValue(images, "max_memory", _config.maxImageMemory);
+        softLoadValue(images, "max_gpu_memory", _config.maxImageGpuMemory);
     }
 
-    if (auto scrollbar = doc["scrollbar"]; scrollbar)
+    if (auto pty = _doc["pty"]; pty)
+    {
+        softLoadValue(pty, "read_buffer_size", _config.ptyReadBufferSize);
+        if (auto latency = pty["read_coalescing_latency"]; latency)
+            _config.ptyReadCoalescingLatency = chrono::microseconds(latency.as<int>());
+        softLoadValue(pty, "fast_forward_threshold", _config.ptyFastForwardThreshold);
+    }
+
+    if (auto delay = _doc["alternate_screen_release_delay"]; delay)
+        _config.alternateScreenReleaseDelay = chrono::seconds(delay.as<int>());
+
+    if (auto renderer = _doc["renderer"]; renderer)
+    {
+        softLoadValue(renderer, "max_fps", _config.maxFramesPerSecond);
+        if (auto timeout = renderer["idle_timeout"]; timeout)
+            _config.idleTimeout = chrono::seconds(timeout.as<int>());
+        softLoadValue(renderer, "distance_field_glyphs", _config.distanceFieldGlyphs);
+        softLoadValue(renderer, "partial_presentation", _config.partialPresentation);
+        softLoadValue(renderer, "render_thread", _config.renderThread);
+        if (auto value = renderer["present_mode"]; value)
+        {
+            auto const literal = toLower(value.as<string>());
+            if (literal == "fifo")
+                _config.presentMode = PresentMode::Fifo;
+            else if (literal == "fifo_relaxed")
+                _config.presentMode = PresentMode::FifoRelaxed;
+            else if (literal == "mailbox")
+                _config.presentMode = PresentMode::Mailbox;
+            else
+                throw std::runtime_error("Invalid value in renderer.present_mode. Should be one of: fifo, fifo_relaxed, mailbox.");
+        }
+    }
+
+    if (auto scrollbar = _doc["scrollbar"]; scrollbar)
     {
         if (auto value = scrollbar["position"]; value)
         {
@@ -837,7 +949,7 @@ void loadConfigFromFile(Config& _config,
             _config.hideScrollbarInAltScreen = value.as<bool>();
     }
 
-    if (auto profiles = doc["color_schemes"]; profiles)
+    if (auto profiles = _doc["color_schemes"]; profiles)
     {
         for (auto i = profiles.begin(); i != profiles.end(); ++i)
         {
@@ -846,7 +958,7 @@ void loadConfigFromFile(Config& _config,
         }
     }
 
-    if (auto profiles = doc["profiles"]; profiles)
+    if (auto profiles = _doc["profiles"]; profiles)
     {
         for (auto i = profiles.begin(); i != profiles.end(); ++i)
         {
@@ -855,25 +967,38 @@ void loadConfigFromFile(Config& _config,
         }
     }
 
-    softLoadValue(doc, "default_profile", _config.defaultProfileName);
+    softLoadValue(_doc, "default_profile", _config.defaultProfileName);
     if (!_config.defaultProfileName.empty() && _config.profile(_config.defaultProfileName) == nullptr)
     {
         _logger(fmt::format("default_profile \"{}\" not found in profiles list.",
                             _config.defaultProfileName));
     }
 
-	if (auto mapping = doc["input_mapping"]; mapping)
+	if (auto mapping = _doc["input_mapping"]; mapping)
     {
+        auto keyMappings = Config::KeyMappings{};
 		if (mapping.IsSequence())
 			for (size_t i = 0; i < mapping.size(); ++i)
-				parseInputMapping(_config, mapping[i]);
+				parseInputMapping(_config, keyMappings, mapping[i]);
+        _config.keyMappings = make_shared<Config::KeyMappings const>(move(keyMappings));
     }
 
-    if (auto logging = doc["logging"]; logging)
+    if (auto logging = _doc["logging"]; logging)
     {
         if (auto filePath = logging["file"]; filePath)
             _config.logFilePath = {FileSystem::path{filePath.as<string>()}};
 
+        softLoadValue(logging, "trace_buffer", _config.logTraceBufferSize);
+
+        if (auto interval = logging["memory_usage_interval"]; interval && interval.IsScalar())
+            _config.logMemoryUsageInterval = chrono::seconds(max(interval.as<int>(), 0));
+
+        if (auto recording = logging["session_recording"]; recording && recording.IsScalar() && !recording.as<string>().empty())
+            _config.sessionRecordingPath = {FileSystem::path{recording.as<string>()}};
+
+        if (auto socket = logging["statistics_socket"]; socket && socket.IsScalar() && !socket.as<string>().empty())
+            _config.statisticsSocketPath = {FileSystem::path{socket.as<string>()}};
+
         auto constexpr mappings = array{
             pair{"parse_errors", LogMask::ParserError},
             pair{"invalid_output", LogMask::InvalidOutput},
@@ -897,27 +1022,56 @@ void loadConfigFromFile(Config& _config,
     }
 }
 
-optional<std::string> readConfigFile(std::string const& _filename)
+void loadConfigFromFile(Config& _config,
+                        FileSystem::path const& _fileName,
+                        Logger const& _logger)
 {
-    for (FileSystem::path const& prefix : configHomes("contour"))
+    _config.backingFilePath = _fileName;
+    createFileIfNotExists(_config.backingFilePath);
+
+    if (auto cached = loadCachedConfig(_fileName); cached.has_value())
     {
-        FileSystem::path path = prefix / _filename;
-        if (!FileSystem::exists(path))
-            continue;
-
-        auto ifs = ifstream(path.string());
-        if (!ifs.good())
-            continue;
-
-        auto const size = FileSystem::file_size(path);
-        auto text = string{};
-        text.resize(size);
-        ifs.read(text.data(), size);
-        return {text};
+        _config = move(*cached);
+        return;
     }
+
+    // Only configurations loaded without any failure are cached, such that failures are reported
+    // each time.
+    auto failures = 0;
+    auto const logger = [&](string const& _message) {
+        ++failures;
+        _logger(_message);
+    };
+    loadConfigFromYAML(_config, YAML::LoadFile(_fileName.string()), logger);
+    if (failures == 0)
+        storeCachedConfig(_config);
+}
+
+optional<FileSystem::path> findConfigFile(std::string const& _filename)
+{
+    for (FileSystem::path const& prefix : configHomes("contour"))
+        if (FileSystem::path path = prefix / _filename; FileSystem::exists(path))
+            return {path};
     return nullopt;
 }
 
+optional<std::string> readConfigFile(std::string const& _filename)
+{
+    auto const path = findConfigFile(_filename);
+    if (!path.has_value())
+        return nullopt;
+
+    auto ifs = ifstream(path->string());
+    if (!ifs.good())
+        return nullopt;
+
+    auto const size = FileSystem::file_size(*path);
+    auto text = string{};
+    text.resize(size);
+    ifs.read(text.data(), size);
+    return {text};
+}
+
 std::optional<ShaderConfig> Config::loadShaderConfig(ShaderClass _shaderClass)
 {
     auto const& defaultConfig = terminal::view::defaultShaderConfig(_shaderClass);
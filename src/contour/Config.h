@@ -23,11 +23,11 @@
 #include <terminal_view/ShaderConfig.h>
 #include <terminal_view/DecorationRenderer.h> // Decorator
 
+#include <crispy/flat_hash_map.h>
 #include <crispy/stdfs.h>
 
-#include <QKeySequence>
-
 #include <chrono>
+#include <memory>
 #include <system_error>
 #include <optional>
 #include <string>
@@ -43,6 +43,14 @@ enum class ScrollBarPosition
     Right
 };
 
+/// How rendered frames are presented on the display.
+enum class PresentMode
+{
+    Fifo,           // waits for the display's vertical blank, never tearing
+    FifoRelaxed,    // like Fifo, but presents late frames right away, tearing rather than stuttering
+    Mailbox,        // never waits, while frames are paced to the display's refresh rate nonetheless
+};
+
 struct FontSpec
 {
     std::string pattern;
@@ -88,9 +96,18 @@ struct TerminalProfile {
     terminal::Size terminalSize;
 
     std::optional<int> maxHistoryLineCount;
+    std::optional<size_t> historySpillThreshold;
+    size_t historyPageSize = 256;       // Lines packed together, and decoded together when viewed.
+    size_t historyCachedPages = 4;      // Pages kept decoded for scrolling through them.
+    std::optional<FileSystem::path> historySnapshotFile; // restores the history from and saves it to
     int historyScrollMultiplier;
     bool autoScrollOnUpdate;
 
+    bool mouseMotionCoalescing = true; // Merges mouse motion reports into one per frame.
+
+    // Maximum time the application's output is parsed at once before rendering gets its turn.
+    std::chrono::microseconds parseSliceTime{4000};
+
     short fontSize;
     FontSpecList fonts;
 
@@ -101,9 +118,10 @@ struct TerminalProfile {
     terminal::CursorShape cursorShape;
     terminal::CursorDisplay cursorDisplay;
     std::chrono::milliseconds cursorBlinkInterval;
+    std::chrono::milliseconds cursorMotionDuration{0}; // 0 for moving the cursor instantly.
 
     terminal::Opacity backgroundOpacity; // value between 0 (fully transparent) and 0xFF (fully visible).
-    bool backgroundBlur; // On Windows 10, this will enable Acrylic Backdrop.
+    bool backgroundBlur; // On Windows 10, this will enable Acrylic Backdrop, and compositor blur elsewhere.
 
     struct {
         terminal::view::Decorator normal = terminal::view::Decorator::DottedUnderline;
@@ -115,11 +133,17 @@ using terminal::view::ShaderConfig;
 using terminal::view::ShaderClass;
 
 // NB: All strings in here must be UTF8-encoded.
+// NB: Fields loaded from the configuration file must be listed in ConfigCache.cpp as well.
 struct Config {
     FileSystem::path backingFilePath;
 
     std::optional<FileSystem::path> logFilePath;
     LogMask loggingMask;
+    size_t logTraceBufferSize = 0;      // number of raw and traced events kept in memory until flushed, 0 for none
+    std::chrono::seconds logMemoryUsageInterval{0}; // interval of logging memory usage, 0 for never
+    std::optional<FileSystem::path> sessionRecordingPath; // file to record the application's output to
+    std::optional<FileSystem::path> statisticsSocketPath; // local socket to serve runtime statistics at
+    std::optional<FileSystem::path> sessionSocketPath; // session daemon to attach to instead of running a shell, by --attach
 
     bool fullscreen;
 
@@ -138,23 +162,62 @@ struct Config {
     std::string wordDelimiters;
 
     // input mapping
-    std::map<QKeySequence, std::vector<actions::Action>> keyMappings;
+    /// Key bindings by Qt key code combined with the keyboard modifiers (as in a QKeySequence),
+    /// such that a key press is looked up with a single probe. Shared by all copies of the config.
+    using KeyMappings = crispy::flat_hash_map<int, std::vector<actions::Action>>;
+    std::shared_ptr<KeyMappings const> keyMappings = std::make_shared<KeyMappings const>();
     std::unordered_map<terminal::MouseEvent, std::vector<actions::Action>> mouseMappings;
 
     static std::optional<ShaderConfig> loadShaderConfig(ShaderClass _shaderClass);
 
     ShaderConfig backgroundShader = terminal::view::defaultShaderConfig(ShaderClass::Background);
     ShaderConfig textShader = terminal::view::defaultShaderConfig(ShaderClass::Text);
+    ShaderConfig cursorShader = terminal::view::defaultShaderConfig(ShaderClass::Cursor);
 
     bool sixelScrolling = false;
     bool sixelCursorConformance = true;
     terminal::Size maxImageSize = {2000, 2000};
     int maxImageColorRegisters = 256;
+    unsigned sixelDecoderThreads = 0;   // 0 or 1 for decoding serially
+    size_t maxImageMemory = 256;        // in MiB, 0 for no limit
+    size_t maxImageGpuMemory = 256;     // in MiB, 0 for no limit
+
+    // PTY reader tuning
+    size_t ptyReadBufferSize = 256 * 1024;
+    std::chrono::microseconds ptyReadCoalescingLatency{500};
+    size_t ptyFastForwardThreshold = 1024 * 1024; // unparsed bytes beyond which parsing fast-forwards, 0 for never
+
+    // Time after leaving the alternate screen, beyond which its buffer is freed, 0 for keeping it.
+    std::chrono::seconds alternateScreenReleaseDelay{0};
+
+    // Frame pacing, 0 for rendering at most at the display's refresh rate.
+    unsigned maxFramesPerSecond = 0;
+
+    // Time without output or input, after which the cursor stops blinking and periodic timers are
+    // suspended, 0 for never.
+    std::chrono::seconds idleTimeout{30};
+
+    // Whether to render text from distance fields, scaled to any font size without rasterizing.
+    bool distanceFieldGlyphs = false;
+
+    // Applied to newly opened windows only.
+    PresentMode presentMode = PresentMode::Fifo;
+
+    // Whether frames present only the rows changed since the previous frame, applied to newly
+    // opened windows only.
+    bool partialPresentation = true;
+
+    // Whether frames are rendered on a thread of their own rather than on the GUI thread,
+    // applied to newly opened windows only.
+    bool renderThread = false;
 
     ScrollBarPosition scrollbarPosition = ScrollBarPosition::Right;
     bool hideScrollbarInAltScreen = true;
 };
 
+/// @returns the path of @p _filename in the first configuration directory containing it.
+std::optional<FileSystem::path> findConfigFile(std::string const& _filename);
+
 std::optional<std::string> readConfigFile(std::string const& _filename);
 
 using Logger = std::function<void(std::string const&)>;
@@ -166,6 +229,9 @@ Config loadConfigFromFile(FileSystem::path const& _fileName,
                           Logger const& _logger);
 Config loadConfig(Logger const& _logger);
 
+/// @returns the directory to keep data in that may be discarded any time, such as font caches.
+FileSystem::path cacheHome();
+
 std::error_code createDefaultConfig(FileSystem::path const& _path);
 
 } // namespace contour::config
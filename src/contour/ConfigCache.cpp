@@ -0,0 +1,502 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2020 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <contour/ConfigCache.h>
+
+#include <terminal/Process.h>
+
+#include <crispy/FNV.h>
+#include <crispy/mapped_file.h>
+
+#include <fmt/format.h>
+
+#include <cstring>
+#include <map>
+#include <memory>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
+#include <variant>
+#include <vector>
+
+using std::make_shared;
+using std::move;
+using std::nullopt;
+using std::optional;
+using std::shared_ptr;
+using std::string;
+using std::vector;
+
+namespace contour::config {
+
+namespace
+{
+    // Cache file layout: FileHeader, followed by FileHeader::size bytes of the serialized Config.
+    auto constexpr FileMagic = uint32_t{0x47464e43}; // "CNFG"
+    auto constexpr FileVersion = uint32_t{3};        // to be incremented whenever the serialized fields change
+
+    struct FileHeader {
+        uint32_t magic;
+        uint32_t version;
+        uint64_t key;
+        uint64_t size;
+        uint64_t checksum;  // of the serialized Config
+    };
+    static_assert(sizeof(FileHeader) == 32);
+
+    auto constexpr fnvBasis = uint64_t{14695981039346656037llu};
+    auto constexpr fnv = crispy::FNV<uint64_t>{1099511628211llu, fnvBasis};
+
+    /// @returns 64-bit FNV-1a hash of the given bytes and their number, continuing from @p _hash.
+    uint64_t hashBytes(uint64_t _hash, void const* _data, size_t _size) noexcept
+    {
+        auto const* bytes = static_cast<uint8_t const*>(_data);
+        for (size_t i = 0; i < _size; ++i)
+            _hash = fnv(_hash, bytes[i]);
+        return fnv(_hash, _size);
+    }
+
+    uint64_t hashString(uint64_t _hash, string const& _text) noexcept
+    {
+        return hashBytes(_hash, _text.data(), _text.size());
+    }
+
+    template <typename Time>
+    uint64_t timeValue(Time _time) noexcept
+    {
+        if constexpr (std::is_arithmetic_v<Time>)
+            return static_cast<uint64_t>(_time); // std::time_t, as of boost::filesystem
+        else
+            return static_cast<uint64_t>(_time.time_since_epoch().count());
+    }
+
+    /// @returns a key identifying the configuration loaded from @p _fileName in the file's current
+    ///          state, or std::nullopt if that could not be determined.
+    optional<uint64_t> cacheKey(FileSystem::path const& _fileName)
+    {
+        auto ec = FileSystemError{};
+        auto const size = FileSystem::file_size(_fileName, ec);
+        if (ec)
+            return nullopt;
+
+        auto const time = FileSystem::last_write_time(_fileName, ec);
+        if (ec)
+            return nullopt;
+
+        // The login shell and home directory are the defaults of settings missing in the file.
+        auto hash = fnvBasis;
+        hash = hashString(hash, _fileName.string());
+        hash = fnv(hash, static_cast<uint64_t>(size));
+        hash = fnv(hash, timeValue(time));
+        hash = hashString(hash, terminal::Process::loginShell());
+        hash = hashString(hash, terminal::Process::homeDirectory().string());
+        hash = hashString(hash, CONTOUR_VERSION_STRING);
+        return fnv(hash, FileVersion);
+    }
+
+    FileSystem::path cachePath(FileSystem::path const& _fileName)
+    {
+        return cacheHome() / "config" / fmt::format("config-{:016x}.bin", hashString(fnvBasis, _fileName.string()));
+    }
+
+    // {{{ serialized fields
+    // Trivially copyable values are serialized as they are, and standard containers element by
+    // element. Other structs are serialized by the fields listed here.
+    template <typename T>
+    constexpr auto fieldsOf();
+
+    template <>
+    constexpr auto fieldsOf<terminal::Process::ExecInfo>()
+    {
+        using T = terminal::Process::ExecInfo;
+        return std::tuple{&T::program, &T::arguments, &T::workingDirectory, &T::env};
+    }
+
+    template <>
+    constexpr auto fieldsOf<FontSpec>()
+    {
+        return std::tuple{&FontSpec::pattern, &FontSpec::features};
+    }
+
+    template <>
+    constexpr auto fieldsOf<FontSpecList>()
+    {
+        using T = FontSpecList;
+        return std::tuple{&T::regular, &T::bold, &T::italic, &T::boldItalic, &T::emoji};
+    }
+
+    template <>
+    constexpr auto fieldsOf<TerminalProfile>()
+    {
+        using T = TerminalProfile;
+        return std::tuple{
+            &T::shell,
+            &T::terminalSize,
+            &T::maxHistoryLineCount,
+            &T::historySpillThreshold,
+            &T::historyPageSize,
+            &T::historyCachedPages,
+            &T::historySnapshotFile,
+            &T::historyScrollMultiplier,
+            &T::autoScrollOnUpdate,
+            &T::mouseMotionCoalescing,
+            &T::parseSliceTime,
+            &T::fontSize,
+            &T::fonts,
+            &T::tabWidth,
+            &T::colors,
+            &T::cursorShape,
+            &T::cursorDisplay,
+            &T::cursorBlinkInterval,
+            &T::cursorMotionDuration,
+            &T::backgroundOpacity,
+            &T::backgroundBlur,
+            &T::hyperlinkDecoration
+        };
+    }
+
+    template <> constexpr auto fieldsOf<actions::SendChars>() { return std::tuple{&actions::SendChars::chars}; }
+    template <> constexpr auto fieldsOf<actions::WriteScreen>() { return std::tuple{&actions::WriteScreen::chars}; }
+    template <> constexpr auto fieldsOf<actions::ChangeProfile>() { return std::tuple{&actions::ChangeProfile::name}; }
+    template <> constexpr auto fieldsOf<actions::NewTerminal>() { return std::tuple{&actions::NewTerminal::profileName}; }
+    template <> constexpr auto fieldsOf<actions::ReloadConfig>() { return std::tuple{&actions::ReloadConfig::profileName}; }
+    template <> constexpr auto fieldsOf<actions::OpenFileIntoScrollback>() { return std::tuple{&actions::OpenFileIntoScrollback::path}; }
+
+    template <>
+    constexpr auto fieldsOf<actions::ExportScrollback>()
+    {
+        return std::tuple{&actions::ExportScrollback::path, &actions::ExportScrollback::withAttributes};
+    }
+
+    /// Fields of the configuration loaded from the file. The backing file path, the session
+    /// socket path (a command line option) and the shaders (loaded separately) are left out.
+    template <>
+    constexpr auto fieldsOf<Config>()
+    {
+        using T = Config;
+        return std::tuple{
+            &T::logFilePath,
+            &T::loggingMask,
+            &T::logTraceBufferSize,
+            &T::logMemoryUsageInterval,
+            &T::sessionRecordingPath,
+            &T::statisticsSocketPath,
+            &T::fullscreen,
+            &T::colorschemes,
+            &T::profiles,
+            &T::defaultProfileName,
+            &T::wordDelimiters,
+            &T::keyMappings,
+            &T::mouseMappings,
+            &T::sixelScrolling,
+            &T::sixelCursorConformance,
+            &T::maxImageSize,
+            &T::maxImageColorRegisters,
+            &T::sixelDecoderThreads,
+            &T::maxImageMemory,
+            &T::maxImageGpuMemory,
+            &T::ptyReadBufferSize,
+            &T::ptyReadCoalescingLatency,
+            &T::ptyFastForwardThreshold,
+            &T::alternateScreenReleaseDelay,
+            &T::maxFramesPerSecond,
+            &T::idleTimeout,
+            &T::distanceFieldGlyphs,
+            &T::presentMode,
+            &T::partialPresentation,
+            &T::renderThread,
+            &T::scrollbarPosition,
+            &T::hideScrollbarInAltScreen
+        };
+    }
+    // }}}
+
+    template <typename T> struct is_optional : std::false_type {};
+    template <typename T> struct is_optional<std::optional<T>> : std::true_type {};
+
+    template <typename T> struct is_variant : std::false_type {};
+    template <typename... T> struct is_variant<std::variant<T...>> : std::true_type {};
+
+    template <typename T> struct is_vector : std::false_type {};
+    template <typename T, typename A> struct is_vector<std::vector<T, A>> : std::true_type {};
+
+    template <typename T> struct is_map : std::false_type {};
+    template <typename... T> struct is_map<std::map<T...>> : std::true_type {};
+    template <typename... T> struct is_map<std::unordered_map<T...>> : std::true_type {};
+
+    using KeyMappingsPtr = shared_ptr<Config::KeyMappings const>;
+
+    /// Serializes values into a byte buffer, to be deserialized by Reader.
+    class Writer {
+      public:
+        template <typename T>
+        void write(T const& _value)
+        {
+            if constexpr (std::is_trivially_copyable_v<T>)
+                bytes(&_value, sizeof(T));
+            else if constexpr (std::is_same_v<T, string>)
+            {
+                write(static_cast<uint64_t>(_value.size()));
+                bytes(_value.data(), _value.size());
+            }
+            else if constexpr (std::is_same_v<T, FileSystem::path>)
+                write(_value.string());
+            else if constexpr (is_optional<T>::value)
+            {
+                write(_value.has_value());
+                if (_value.has_value())
+                    write(*_value);
+            }
+            else if constexpr (is_variant<T>::value)
+            {
+                write(static_cast<uint64_t>(_value.index()));
+                std::visit([this](auto const& _alternative) { write(_alternative); }, _value);
+            }
+            else if constexpr (is_vector<T>::value)
+            {
+                write(static_cast<uint64_t>(_value.size()));
+                for (auto const& element : _value)
+                    write(element);
+            }
+            else if constexpr (is_map<T>::value)
+            {
+                write(static_cast<uint64_t>(_value.size()));
+                for (auto const& [key, value] : _value)
+                {
+                    write(key);
+                    write(value);
+                }
+            }
+            else if constexpr (std::is_same_v<T, KeyMappingsPtr>)
+            {
+                write(static_cast<uint64_t>(_value->size()));
+                _value->for_each([this](int _keyCode, vector<actions::Action> const& _actions) {
+                    write(_keyCode);
+                    write(_actions);
+                });
+            }
+            else
+                std::apply([&](auto... _fields) { (write(_value.*_fields), ...); }, fieldsOf<T>());
+        }
+
+        string const& buffer() const noexcept { return buffer_; }
+
+      private:
+        void bytes(void const* _data, size_t _size)
+        {
+            buffer_.append(static_cast<char const*>(_data), _size);
+        }
+
+        string buffer_;
+    };
+
+    /// Deserializes values written by Writer, failing on running out of bytes.
+    class Reader {
+      public:
+        Reader(uint8_t const* _data, size_t _size) : data_{_data}, size_{_size} {}
+
+        /// @returns whether all bytes have been read, and nothing more.
+        bool good() const noexcept { return !failed_ && offset_ == size_; }
+
+        template <typename T>
+        void read(T& _value)
+        {
+            if (failed_)
+                return;
+
+            if constexpr (std::is_trivially_copyable_v<T>)
+                bytes(&_value, sizeof(T));
+            else if constexpr (std::is_same_v<T, string>)
+            {
+                auto const size = readSize();
+                if (!failed_)
+                {
+                    _value.assign(reinterpret_cast<char const*>(data_ + offset_), size);
+                    offset_ += size;
+                }
+            }
+            else if constexpr (std::is_same_v<T, FileSystem::path>)
+            {
+                auto value = string{};
+                read(value);
+                _value = FileSystem::path(value);
+            }
+            else if constexpr (is_optional<T>::value)
+            {
+                auto hasValue = false;
+                read(hasValue);
+                if (hasValue)
+                    read(_value.emplace());
+                else
+                    _value.reset();
+            }
+            else if constexpr (is_variant<T>::value)
+            {
+                auto index = uint64_t{0};
+                read(index);
+                readAlternative<T>(index, _value);
+            }
+            else if constexpr (is_vector<T>::value)
+            {
+                auto const count = readSize();
+                _value.clear();
+                for (size_t i = 0; i < count && !failed_; ++i)
+                    read(_value.emplace_back());
+            }
+            else if constexpr (is_map<T>::value)
+            {
+                auto const count = readSize();
+                _value.clear();
+                for (size_t i = 0; i < count && !failed_; ++i)
+                {
+                    auto key = typename T::key_type{};
+                    auto value = typename T::mapped_type{};
+                    read(key);
+                    read(value);
+                    _value.emplace(move(key), move(value));
+                }
+            }
+            else if constexpr (std::is_same_v<T, KeyMappingsPtr>)
+            {
+                auto const count = readSize();
+                auto keyMappings = Config::KeyMappings{};
+                for (size_t i = 0; i < count && !failed_; ++i)
+                {
+                    auto keyCode = 0;
+                    auto keyActions = vector<actions::Action>{};
+                    read(keyCode);
+                    read(keyActions);
+                    keyMappings.try_emplace(keyCode, move(keyActions));
+                }
+                _value = make_shared<Config::KeyMappings const>(move(keyMappings));
+            }
+            else
+                std::apply([&](auto... _fields) { (read(_value.*_fields), ...); }, fieldsOf<T>());
+        }
+
+      private:
+        void bytes(void* _data, size_t _size)
+        {
+            if (size_ - offset_ < _size)
+            {
+                failed_ = true;
+                return;
+            }
+            std::memcpy(_data, data_ + offset_, _size);
+            offset_ += _size;
+        }
+
+        /// Reads a number of bytes or elements, each of which takes at least one byte.
+        size_t readSize()
+        {
+            auto size = uint64_t{0};
+            read(size);
+            if (size > size_ - offset_)
+                failed_ = true;
+            return failed_ ? 0 : static_cast<size_t>(size);
+        }
+
+        template <typename Variant, size_t I = 0>
+        void readAlternative(uint64_t _index, Variant& _value)
+        {
+            if constexpr (I < std::variant_size_v<Variant>)
+            {
+                if (_index == I)
+                    read(_value.template emplace<I>());
+                else
+                    readAlternative<Variant, I + 1>(_index, _value);
+            }
+            else
+                failed_ = true;
+        }
+
+        uint8_t const* data_;
+        size_t size_;
+        size_t offset_ = 0;
+        bool failed_ = false;
+    };
+}
+
+optional<Config> loadCachedConfig(FileSystem::path const& _fileName)
+{
+    try
+    {
+        auto const key = cacheKey(_fileName);
+        if (!key.has_value())
+            return nullopt;
+
+        auto const file = crispy::mapped_file::open(cachePath(_fileName).string());
+        if (!file.has_value() || file->size() < sizeof(FileHeader))
+            return nullopt;
+
+        auto header = FileHeader{};
+        std::memcpy(&header, file->data(), sizeof(header));
+        if (header.magic != FileMagic
+                || header.version != FileVersion
+                || header.key != *key
+                || header.size != file->size() - sizeof(FileHeader))
+            return nullopt;
+
+        auto const* data = file->data() + sizeof(FileHeader);
+        if (hashBytes(fnvBasis, data, header.size) != header.checksum)
+            return nullopt;
+
+        auto config = Config{};
+        auto reader = Reader{data, header.size};
+        reader.read(config);
+        if (!reader.good())
+            return nullopt;
+
+        config.backingFilePath = _fileName;
+        return config;
+    }
+    catch (std::exception const&)
+    {
+        return nullopt;
+    }
+}
+
+void storeCachedConfig(Config const& _config)
+{
+    try
+    {
+        auto const key = cacheKey(_config.backingFilePath);
+        if (!key.has_value())
+            return;
+
+        auto writer = Writer{};
+        writer.write(_config);
+        auto const& data = writer.buffer();
+
+        auto const header = FileHeader{
+            FileMagic,
+            FileVersion,
+            *key,
+            data.size(),
+            hashBytes(fnvBasis, data.data(), data.size())
+        };
+        auto contents = string(reinterpret_cast<char const*>(&header), sizeof(header));
+        contents += data;
+
+        auto const path = cachePath(_config.backingFilePath);
+        auto ec = FileSystemError{};
+        FileSystem::create_directories(path.parent_path(), ec);
+        crispy::replace_file(path.string(), contents.data(), contents.size());
+    }
+    catch (std::exception const&)
+    {
+        // The configuration is parsed again next time.
+    }
+}
+
+} // namespace contour::config
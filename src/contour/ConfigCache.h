@@ -0,0 +1,34 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2020 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <contour/Config.h>
+
+#include <crispy/stdfs.h>
+
+#include <optional>
+
+namespace contour::config {
+
+/// @returns the configuration loaded from @p _fileName before, as cached by storeCachedConfig(),
+///          or std::nullopt if there is none or the file has been modified since.
+///
+/// The cache holds the configuration in binary form, such that loading it is a single read
+/// rather than parsing the YAML file and walking its nodes.
+std::optional<Config> loadCachedConfig(FileSystem::path const& _fileName);
+
+/// Caches @p _config, as just loaded from its backing file, for loadCachedConfig().
+void storeCachedConfig(Config const& _config);
+
+} // namespace contour::config
@@ -17,6 +17,8 @@
 #include <QtCore/QProcess>
 #include <QtGui/QGuiApplication>
 
+#include <fmt/format.h>
+
 using namespace std;
 
 namespace contour {
@@ -37,6 +39,9 @@ Controller::Controller(std::string _programPath,
 
     connect(this, &Controller::started, this, [this]() { newWindow(); });
 
+    notificationTimer_.setSingleShot(true);
+    connect(&notificationTimer_, &QTimer::timeout, this, [this]() { sendPendingNotification(); });
+
     self_ = this;
 }
 
@@ -56,11 +61,47 @@ void Controller::newWindow()
     terminalWindows_.push_back(mainWindow);
     // TODO: Remove window from list when destroyed.
 
-    // QObject::connect(mainWindow, &TerminalWindow::showNotification,
-    //                  this, &Controller::showNotification);
+    QObject::connect(mainWindow, &TerminalWindow::showNotification,
+                     this, &Controller::showNotification);
 }
 
 void Controller::showNotification(QString const& _title, QString const& _content)
+{
+    // Bursts of notifications, such as one per test case of a build, are coalesced into one
+    // sent at most every NotificationInterval, showing the most recent one along with their count.
+    auto const now = chrono::steady_clock::now();
+    if (!notificationTimer_.isActive() && now - lastNotification_ >= NotificationInterval)
+    {
+        lastNotification_ = now;
+        sendNotification(_title, _content);
+        return;
+    }
+
+    pendingTitle_ = _title;
+    pendingContent_ = _content;
+    ++pendingCount_;
+    if (!notificationTimer_.isActive())
+    {
+        auto const due = chrono::duration_cast<chrono::milliseconds>(lastNotification_ + NotificationInterval - now);
+        notificationTimer_.start(static_cast<int>(due.count()));
+    }
+}
+
+void Controller::sendPendingNotification()
+{
+    if (pendingCount_ == 0)
+        return;
+
+    auto content = pendingContent_;
+    if (pendingCount_ > 1)
+        content += QString::fromStdString(fmt::format("\n({} more)", pendingCount_ - 1));
+
+    lastNotification_ = chrono::steady_clock::now();
+    pendingCount_ = 0;
+    sendNotification(pendingTitle_, content);
+}
+
+void Controller::sendNotification(QString const& _title, QString const& _content)
 {
     // systrayIcon_->showMessage(
     //     _title,
@@ -71,13 +112,14 @@ void Controller::showNotification(QString const& _title, QString const& _content
 
 #if defined(__linux__)
     // XXX requires notify-send to be installed.
+    // It is started detached, such that neither spawning it nor waiting for it blocks.
     QStringList args;
     args.append("--urgency=low");
     args.append("--expire-time=10000");
     args.append("--category=terminal");
     args.append(_title);
     args.append(_content);
-    QProcess::execute(QString::fromLatin1("notify-send"), args);
+    QProcess::startDetached(QString::fromLatin1("notify-send"), args);
 #elif defined(__APPLE__)
     // TODO: use Growl?
 #elif defined(_WIN32)
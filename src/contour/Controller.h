@@ -16,8 +16,10 @@
 #include <contour/Config.h>
 
 #include <QtCore/QThread>
+#include <QtCore/QTimer>
 #include <QtWidgets/QSystemTrayIcon>
 
+#include <chrono>
 #include <string>
 
 #include <thread>
@@ -44,6 +46,12 @@ class Controller : public QThread {
   private:
     static void onSigInt(int _signum);
 
+    void sendNotification(QString const& _title, QString const& _content);
+    void sendPendingNotification();
+
+    /// Notifications following each other more closely are coalesced into one.
+    static constexpr auto NotificationInterval = std::chrono::seconds(2);
+
   private:
     static Controller* self_;
 
@@ -54,6 +62,14 @@ class Controller : public QThread {
     std::list<TerminalWindow*> terminalWindows_;
 
     QSystemTrayIcon* systrayIcon_ = nullptr;
+
+    // {{{ notifications
+    std::chrono::steady_clock::time_point lastNotification_{};
+    QTimer notificationTimer_;              // sends the pending notification once due
+    QString pendingTitle_;                  // most recent notification not sent yet
+    QString pendingContent_;
+    int pendingCount_ = 0;                  // number of notifications coalesced into the pending one
+    // }}}
 };
 
 } // end namespace
@@ -12,15 +12,37 @@
  * limitations under the License.
  */
 #include "FileChangeWatcher.h"
-#include <thread>
+
+#include <array>
+#include <cerrno>
 #include <chrono>
+#include <cstdint>
+#include <string>
+#include <thread>
+
+#if defined(__linux__)
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
 
 using namespace std;
 
+namespace
+{
+    /// Time a burst of changes needs to settle before being notified, as editors tend to
+    /// save files in multiple steps.
+    auto constexpr SettleTime = 50ms;
+}
+
 FileChangeWatcher::FileChangeWatcher(FileSystem::path _filePath, Notifier _notifier) :
     filePath_{ move(_filePath) },
     notifier_{ move(_notifier) },
     exit_{ false },
+#if defined(__linux__)
+    wakeup_{ eventfd(0, EFD_CLOEXEC) },
+#endif
     watcher_{ [this]() { watch(); } }
 {
 }
@@ -29,27 +51,146 @@ FileChangeWatcher::~FileChangeWatcher()
 {
     stop();
     watcher_.join();
+
+#if defined(__linux__)
+    if (wakeup_ >= 0)
+        ::close(wakeup_);
+#endif
 }
 
 void FileChangeWatcher::watch()
 {
-    auto lastWriteTime = FileSystem::last_write_time(filePath_);
-    while (!exit_)
+    // The file may be erased and recreated at any time, e.g. by editors saving it, hence each
+    // transition is notified once only, and querying an erased file must not throw.
+    auto ec = FileSystemError{};
+    lastWriteTime_ = FileSystem::last_write_time(filePath_, ec);
+    exists_ = !ec;
+
+    if (!watchNotified())
+        watchPolled();
+}
+
+void FileChangeWatcher::check()
+{
+    auto ec = FileSystemError{};
+    auto lwt = FileSystem::last_write_time(filePath_, ec);
+    if (ec)
     {
-        if (!FileSystem::exists(filePath_))
+        if (exists_)
             notifier_(Event::Erased);
+        exists_ = false;
+    }
+    else if (!exists_ || lwt != lastWriteTime_)
+    {
+        exists_ = true;
+        lastWriteTime_ = lwt;
+        notifier_(Event::Modified);
+    }
+}
 
-        auto lwt = FileSystem::last_write_time(filePath_);
-        if (lwt != lastWriteTime)
+void FileChangeWatcher::watchPolled()
+{
+    while (!exit_)
+    {
+        check();
+        this_thread::sleep_for(1s);
+    }
+}
+
+bool FileChangeWatcher::watchNotified()
+{
+#if defined(__linux__)
+    if (wakeup_ < 0)
+        return false;
+
+    int const fd = inotify_init1(IN_CLOEXEC | IN_NONBLOCK);
+    if (fd < 0)
+        return false;
+
+    // The directories of the file and, if it is a symbolic link, of its target are watched,
+    // and only events about entries of either name are considered.
+    auto names = array<string, 2>{ filePath_.filename().string() };
+    auto const directory = filePath_.has_parent_path() ? filePath_.parent_path() : FileSystem::path{"."};
+    auto watched = inotify_add_watch(fd, directory.c_str(), IN_CLOSE_WRITE | IN_MODIFY | IN_ATTRIB
+                                                          | IN_CREATE | IN_DELETE
+                                                          | IN_MOVED_FROM | IN_MOVED_TO
+                                                          | IN_DELETE_SELF | IN_MOVE_SELF) >= 0;
+    auto ec = FileSystemError{};
+    if (auto const target = FileSystem::canonical(filePath_, ec); !ec && target != filePath_)
+    {
+        names[1] = target.filename().string();
+        watched = inotify_add_watch(fd, target.parent_path().c_str(), IN_CLOSE_WRITE | IN_MODIFY | IN_ATTRIB
+                                                                     | IN_CREATE | IN_DELETE
+                                                                     | IN_MOVED_FROM | IN_MOVED_TO) >= 0 && watched;
+    }
+    if (!watched)
+    {
+        ::close(fd);
+        return false;
+    }
+
+    // @returns whether any of the pending events concerns the watched file.
+    auto lost = false;
+    auto const readEvents = [&]() {
+        alignas(inotify_event) char buffer[4096];
+        bool relevant = false;
+        for (;;)
         {
-            lastWriteTime = lwt;
-            notifier_(Event::Modified);
+            auto const n = ::read(fd, buffer, sizeof(buffer));
+            if (n <= 0)
+                return relevant;
+
+            for (auto i = ssize_t{0}; i < n; )
+            {
+                auto const* event = reinterpret_cast<inotify_event const*>(buffer + i);
+                auto const name = event->len ? string(event->name) : string{};
+                if (event->len == 0 || name == names[0] || (!names[1].empty() && name == names[1]))
+                    relevant = true;
+                if (event->mask & IN_IGNORED)
+                    lost = true;
+                i += static_cast<ssize_t>(sizeof(inotify_event) + event->len);
+            }
         }
-        this_thread::sleep_for(1s);
+    };
+
+    auto fds = array<pollfd, 2>{ pollfd{ fd, POLLIN, 0 }, pollfd{ wakeup_, POLLIN, 0 } };
+    auto pending = false;
+    while (!exit_ && !lost)
+    {
+        // Pending changes are checked once no further events arrived for SettleTime.
+        auto const timeout = pending ? static_cast<int>(chrono::milliseconds(SettleTime).count()) : -1;
+        auto const rv = ::poll(fds.data(), fds.size(), timeout);
+        if (rv < 0 && errno != EINTR)
+            break;
+        if (rv == 0)
+        {
+            pending = false;
+            check();
+        }
+        else if (fds[0].revents & POLLIN)
+            pending = readEvents() || pending;
     }
+
+    ::close(fd);
+
+    // Continues polling if a directory has been removed (or waiting failed).
+    if (lost)
+        check();
+    return exit_;
+#else
+    return false;
+#endif
 }
 
 void FileChangeWatcher::stop()
 {
     exit_ = true;
+
+#if defined(__linux__)
+    if (wakeup_ >= 0)
+    {
+        uint64_t const one = 1;
+        (void) ::write(wakeup_, &one, sizeof(one));
+    }
+#endif
 }
@@ -15,9 +15,18 @@
 
 #include <crispy/stdfs.h>
 
+#include <atomic>
 #include <functional>
 #include <thread>
 
+/**
+ * Notifies about a file being modified or erased, from a thread of its own.
+ *
+ * Changes are picked up via inotify on Linux, watching the file's directory such that
+ * files replaced by editors (e.g. writing a new file and renaming it over the old one)
+ * are followed, and bursts of changes are only notified once they settled. Other
+ * platforms poll the file's modification time once per second.
+ */
 class FileChangeWatcher {
   public:
     enum class Event {
@@ -35,9 +44,23 @@ class FileChangeWatcher {
   private:
     void watch();
 
+    /// Waits for changes via inotify.
+    ///
+    /// @retval false inotify is not (or no longer) available for the file, so it has to be polled instead.
+    bool watchNotified();
+    void watchPolled();
+
+    /// Notifies the transition of the file since the last check, if any.
+    void check();
+
   private:
     FileSystem::path filePath_;
     Notifier notifier_;
-    bool exit_;
+    std::atomic<bool> exit_;
+    int wakeup_ = -1;  // eventfd signaled by stop(), if notified via inotify
+
+    FileSystem::file_time_type lastWriteTime_{};
+    bool exists_ = false;
+
     std::thread watcher_;
 };
@@ -0,0 +1,125 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2020 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <terminal/InputGenerator.h>
+
+#include <QtCore/qnamespace.h>
+
+#include <algorithm>
+#include <array>
+#include <optional>
+#include <utility>
+
+namespace contour {
+
+// Mapping of Qt's input events onto the terminal's ones, shared by all frontend windows.
+
+/// @returns the terminal modifiers of the given Qt keyboard modifiers.
+constexpr inline terminal::Modifier makeModifier(int _mods)
+{
+    using terminal::Modifier;
+
+    Modifier mods{};
+
+    if (_mods & Qt::AltModifier)
+        mods |= Modifier::Alt;
+    if (_mods & Qt::ShiftModifier)
+        mods |= Modifier::Shift;
+    if (_mods & Qt::ControlModifier)
+        mods |= Modifier::Control;
+    if (_mods & Qt::MetaModifier)
+        mods |= Modifier::Meta;
+
+    return mods;
+}
+
+/// @returns the terminal mouse button of the given Qt mouse button.
+constexpr terminal::MouseButton makeMouseButton(Qt::MouseButton _button)
+{
+    switch (_button)
+    {
+        case Qt::MouseButton::RightButton:
+            return terminal::MouseButton::Right;
+        case Qt::MiddleButton:
+            return terminal::MouseButton::Middle;
+        case Qt::LeftButton:
+            [[fallthrough]];
+        default: // d'oh
+            return terminal::MouseButton::Left;
+    }
+}
+
+/// @returns the terminal input event of a non-character key, or std::nullopt if it is a character.
+inline std::optional<terminal::InputEvent> mapQtToTerminalKeyEvent(int _key, Qt::KeyboardModifiers _mods)
+{
+    using terminal::Key;
+    using terminal::InputEvent;
+    using terminal::KeyInputEvent;
+    using terminal::CharInputEvent;
+
+    static auto constexpr mapping = std::array{
+        std::pair{Qt::Key_Insert, Key::Insert},
+        std::pair{Qt::Key_Delete, Key::Delete},
+        std::pair{Qt::Key_Right, Key::RightArrow},
+        std::pair{Qt::Key_Left, Key::LeftArrow},
+        std::pair{Qt::Key_Down, Key::DownArrow},
+        std::pair{Qt::Key_Up, Key::UpArrow},
+        std::pair{Qt::Key_PageDown, Key::PageDown},
+        std::pair{Qt::Key_PageUp, Key::PageUp},
+        std::pair{Qt::Key_Home, Key::Home},
+        std::pair{Qt::Key_End, Key::End},
+        std::pair{Qt::Key_F1, Key::F1},
+        std::pair{Qt::Key_F2, Key::F2},
+        std::pair{Qt::Key_F3, Key::F3},
+        std::pair{Qt::Key_F4, Key::F4},
+        std::pair{Qt::Key_F5, Key::F5},
+        std::pair{Qt::Key_F6, Key::F6},
+        std::pair{Qt::Key_F7, Key::F7},
+        std::pair{Qt::Key_F8, Key::F8},
+        std::pair{Qt::Key_F9, Key::F9},
+        std::pair{Qt::Key_F10, Key::F10},
+        std::pair{Qt::Key_F11, Key::F11},
+        std::pair{Qt::Key_F12, Key::F12},
+        // todo: F13..F25
+        // TODO: NumPad
+        // pair{Qt::Key_0, Key::Numpad_0},
+        // pair{Qt::Key_1, Key::Numpad_1},
+        // pair{Qt::Key_2, Key::Numpad_2},
+        // pair{Qt::Key_3, Key::Numpad_3},
+        // pair{Qt::Key_4, Key::Numpad_4},
+        // pair{Qt::Key_5, Key::Numpad_5},
+        // pair{Qt::Key_6, Key::Numpad_6},
+        // pair{Qt::Key_7, Key::Numpad_7},
+        // pair{Qt::Key_8, Key::Numpad_8},
+        // pair{Qt::Key_9, Key::Numpad_9},
+        // pair{Qt::Key_Period, Key::Numpad_Decimal},
+        // pair{Qt::Key_Slash, Key::Numpad_Divide},
+        // pair{Qt::Key_Asterisk, Key::Numpad_Multiply},
+        // pair{Qt::Key_Minus, Key::Numpad_Subtract},
+        // pair{Qt::Key_Plus, Key::Numpad_Add},
+        // pair{Qt::Key_Enter, Key::Numpad_Enter},
+        // pair{Qt::Key_Equal, Key::Numpad_Equal},
+    };
+
+    if (auto i = std::find_if(std::begin(mapping), std::end(mapping), [_key](auto const& x) { return x.first == _key; }); i != std::end(mapping))
+        return { InputEvent{KeyInputEvent{i->second, makeModifier(_mods)}} };
+
+    if (_key == Qt::Key_Backtab)
+        return { InputEvent{CharInputEvent{'\t', makeModifier(_mods | Qt::ShiftModifier)}} };
+
+    return std::nullopt;
+}
+
+} // end namespace
@@ -18,13 +18,124 @@
 
 #include <fmt/format.h>
 
+#include <algorithm>
 #include <array>
+#include <cstring>
 #include <fstream>
+#include <string_view>
 
 using namespace std;
 using namespace terminal;
 using namespace crispy;
 
+namespace
+{
+    // Bytes of text a TraceBuffer slot holds, chosen for a slot to span four cache lines.
+    auto constexpr TraceTextSize = size_t{256 - 16};
+
+    /// @returns the (up to) two texts of the given event.
+    pair<string_view, string_view> textOf(LogEvent const& _event)
+    {
+        return visit(overloaded{
+            [](ParserErrorEvent const& v) { return pair<string_view, string_view>{v.reason, {}}; },
+            [](TraceInputEvent const& v) { return pair<string_view, string_view>{v.message, {}}; },
+            [](RawInputEvent const& v) { return pair<string_view, string_view>{v.sequence, {}}; },
+            [](RawOutputEvent const& v) { return pair<string_view, string_view>{v.sequence, {}}; },
+            [](InvalidOutputEvent const& v) { return pair<string_view, string_view>{v.sequence, v.reason}; },
+            [](UnsupportedOutputEvent const& v) { return pair<string_view, string_view>{v.sequence, {}}; },
+            [](TraceOutputEvent const& v) { return pair<string_view, string_view>{v.sequence, {}}; },
+        }, _event);
+    }
+
+    /// @returns the event of the given index, made up of the given texts.
+    LogEvent makeEvent(size_t _eventIndex, string _first, string _second)
+    {
+        switch (_eventIndex)
+        {
+            case logEventIndex<ParserErrorEvent>(): return ParserErrorEvent{move(_first)};
+            case logEventIndex<TraceInputEvent>(): return TraceInputEvent{move(_first)};
+            case logEventIndex<RawInputEvent>(): return RawInputEvent{move(_first)};
+            case logEventIndex<RawOutputEvent>(): return RawOutputEvent{move(_first)};
+            case logEventIndex<InvalidOutputEvent>(): return InvalidOutputEvent{move(_first), move(_second)};
+            case logEventIndex<UnsupportedOutputEvent>(): return UnsupportedOutputEvent{move(_first)};
+            case logEventIndex<TraceOutputEvent>(): return TraceOutputEvent{move(_first)};
+        }
+        return ParserErrorEvent{move(_first)}; // should never be reached
+    }
+
+    /// @returns whether events of the given mask are recorded into the trace buffer, if any.
+    constexpr bool isTrace(LogMask _mask) noexcept
+    {
+        return (_mask & (LogMask::RawInput | LogMask::RawOutput | LogMask::TraceInput | LogMask::TraceOutput)) != LogMask::None;
+    }
+}
+
+// {{{ TraceBuffer
+struct TraceBuffer::Slot {
+    // 2 * sequence number + 1 while being recorded, and 2 * sequence number + 2 once recorded.
+    std::atomic<uint64_t> state = 0;
+    uint16_t eventIndex = 0;
+    uint16_t firstSize = 0;
+    uint16_t secondSize = 0;
+    char text[TraceTextSize];
+};
+
+TraceBuffer::TraceBuffer(size_t _capacity) :
+    capacity_{ max(_capacity, size_t{1}) },
+    slots_{ make_unique<Slot[]>(capacity_) }
+{
+}
+
+TraceBuffer::~TraceBuffer() = default;
+
+void TraceBuffer::record(LogEvent const& _event) noexcept
+{
+    static_assert(sizeof(Slot) == 256, "Slots are meant to span whole cache lines.");
+
+    auto const sequence = next_.fetch_add(1, memory_order_relaxed);
+    Slot& slot = slots_[sequence % capacity_];
+
+    slot.state.store(2 * sequence + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+
+    auto const [first, second] = textOf(_event);
+    auto const firstSize = min(first.size(), TraceTextSize);
+    auto const secondSize = min(second.size(), TraceTextSize - firstSize);
+    slot.eventIndex = static_cast<uint16_t>(_event.index());
+    slot.firstSize = static_cast<uint16_t>(firstSize);
+    slot.secondSize = static_cast<uint16_t>(secondSize);
+    memcpy(slot.text, first.data(), firstSize);
+    memcpy(slot.text + firstSize, second.data(), secondSize);
+
+    slot.state.store(2 * sequence + 2, memory_order_release);
+}
+
+void TraceBuffer::dump(ostream& _output)
+{
+    auto const end = next_.load(memory_order_acquire);
+    auto const begin = max(dumped_, end > capacity_ ? end - capacity_ : uint64_t{0});
+    dumped_ = end;
+
+    for (auto sequence = begin; sequence < end; ++sequence)
+    {
+        Slot const& slot = slots_[sequence % capacity_];
+        auto const state = slot.state.load(memory_order_acquire);
+        if (state != 2 * sequence + 2)
+            continue; // still being recorded, or overwritten by a more recent event meanwhile
+
+        auto const eventIndex = slot.eventIndex;
+        auto first = string(slot.text, min(size_t{slot.firstSize}, TraceTextSize));
+        auto second = string(slot.text + first.size(), min(size_t{slot.secondSize}, TraceTextSize - first.size()));
+
+        atomic_thread_fence(memory_order_acquire);
+        if (slot.state.load(memory_order_relaxed) != state)
+            continue;
+
+        _output << fmt::format("{}\n", makeEvent(eventIndex, move(first), move(second)));
+    }
+}
+// }}}
+
 LoggingSink::LoggingSink(LogMask _logMask, FileSystem::path _logfile) :
     logMask_{ _logMask },
     ownedSink_{ make_unique<ofstream>(_logfile.string(), ios::trunc) },
@@ -39,6 +150,35 @@ LoggingSink::LoggingSink(LogMask _logMask, std::ostream* _sink) :
 {
 }
 
+LoggingSink& LoggingSink::operator=(LoggingSink&& _other)
+{
+    if (this != &_other)
+    {
+        flush();
+        logMask_ = _other.logMask_;
+        ownedSink_ = move(_other.ownedSink_);
+        sink_ = _other.sink_;
+        traceBuffer_ = move(_other.traceBuffer_);
+    }
+    return *this;
+}
+
+LoggingSink::~LoggingSink()
+{
+    // The events of a moved-from sink went along with its trace buffer.
+    if (traceBuffer_)
+        flush();
+}
+
+void LoggingSink::setTraceBufferSize(size_t _capacity)
+{
+    flush();
+    if (_capacity)
+        traceBuffer_ = make_unique<TraceBuffer>(_capacity);
+    else
+        traceBuffer_.reset();
+}
+
 void LoggingSink::keyPress(Key _key, Modifier _modifier)
 {
     log(TraceInputEvent{ fmt::format("key: {} {}", to_string(_key), to_string(_modifier)) });
@@ -52,41 +192,45 @@ void LoggingSink::keyPress(char32_t _char, Modifier _modifier)
         log(TraceInputEvent{ fmt::format("char: 0x{:04X} ({})", static_cast<uint32_t>(_char), to_string(_modifier)) });
 }
 
-LogMask getLogMask(LogEvent const& _event)
+LogMask getLogMask(size_t _eventIndex)
+{
+    switch (_eventIndex)
+    {
+        case logEventIndex<ParserErrorEvent>(): return LogMask::ParserError;
+        case logEventIndex<RawInputEvent>(): return LogMask::RawInput;
+        case logEventIndex<RawOutputEvent>(): return LogMask::RawOutput;
+        case logEventIndex<InvalidOutputEvent>(): return LogMask::InvalidOutput;
+        case logEventIndex<UnsupportedOutputEvent>(): return LogMask::UnsupportedOutput;
+        case logEventIndex<TraceInputEvent>(): return LogMask::TraceInput;
+        case logEventIndex<TraceOutputEvent>(): return LogMask::TraceOutput;
+    }
+    return LogMask::ParserError; // should never be reached
+}
+
+bool LoggingSink::enabled(size_t _eventIndex) const noexcept
 {
-    #if 0 // The code below causes an internal compiler error on MSVC (16.7)
-    LogMask const m = visit(overloaded{
-            [&](ParserErrorEvent const&) { return LogMask::ParserError; },
-            [&](RawInputEvent const&) { return LogMask::RawInput; },
-            [&](RawOutputEvent const&) { return LogMask::RawOutput; },
-            [&](InvalidOutputEvent const&) { return LogMask::InvalidOutput; },
-            [&](UnsupportedOutputEvent const&) { return LogMask::UnsupportedOutput; },
-            [&](TraceInputEvent const&) { return LogMask::TraceInput; },
-            [&](TraceOutputEvent const&) { return LogMask::TraceOutput; },
-        },
-        _event
-    );
-    return m;
-    #else
-    if (holds_alternative<ParserErrorEvent>(_event)) return LogMask::ParserError;
-    else if (holds_alternative<RawInputEvent>(_event)) return LogMask::RawInput;
-    else if (holds_alternative<RawOutputEvent>(_event)) return LogMask::RawOutput;
-    else if (holds_alternative<InvalidOutputEvent>(_event)) return LogMask::InvalidOutput;
-    else if (holds_alternative<UnsupportedOutputEvent>(_event)) return LogMask::UnsupportedOutput;
-    else if (holds_alternative<TraceInputEvent>(_event)) return LogMask::TraceInput;
-    else if (holds_alternative<TraceOutputEvent>(_event)) return LogMask::TraceOutput;
-    else return LogMask::ParserError; // should never be reached
-    #endif
+    return (logMask_ & getLogMask(_eventIndex)) != LogMask::None;
 }
 
 void LoggingSink::log(LogEvent const& _event)
 {
-    if ((logMask_ & getLogMask(_event)) != LogMask::None)
+    auto const mask = logMask_ & getLogMask(_event.index());
+    if (mask == LogMask::None)
+        return;
+
+    if (traceBuffer_ && isTrace(mask))
+        traceBuffer_->record(_event);
+    else if (sink_)
         *sink_ << fmt::format("{}\n", _event);
 }
 
 void LoggingSink::flush()
 {
-    if (sink_)
-        sink_->flush();
+    if (!sink_)
+        return;
+
+    if (traceBuffer_)
+        traceBuffer_->dump(*sink_);
+
+    sink_->flush();
 }
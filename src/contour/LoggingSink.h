@@ -17,6 +17,8 @@
 #include <terminal/Logger.h>
 #include <crispy/stdfs.h>
 
+#include <atomic>
+#include <cstdint>
 #include <iostream>
 #include <memory>
 #include <string>
@@ -65,6 +67,38 @@ constexpr bool operator!=(LogMask lhs, unsigned rhs) noexcept
     return static_cast<unsigned>(lhs) != rhs;
 }
 
+/**
+ * Lock-free ring of the most recently logged events, kept in binary form.
+ *
+ * Recording an event merely copies its kind and text into the next slot, whereas escaping and
+ * formatting is left to dump(), such that tracing can stay enabled without taxing keystroke and
+ * paste latency. Events may be recorded by any thread. Once full, the oldest events are
+ * overwritten, and text exceeding a slot is truncated.
+ */
+class TraceBuffer {
+  public:
+    explicit TraceBuffer(size_t _capacity);
+    ~TraceBuffer();
+
+    TraceBuffer(TraceBuffer const&) = delete;
+    TraceBuffer& operator=(TraceBuffer const&) = delete;
+
+    size_t capacity() const noexcept { return capacity_; }
+
+    void record(terminal::LogEvent const& _event) noexcept;
+
+    /// Formats the events recorded since the last dump, oldest first.
+    void dump(std::ostream& _output);
+
+  private:
+    struct Slot;
+
+    size_t const capacity_;
+    std::unique_ptr<Slot[]> slots_;
+    std::atomic<uint64_t> next_ = 0;    // sequence number of the next event to be recorded
+    uint64_t dumped_ = 0;               // sequence number of the first event not yet dumped
+};
+
 /// glterm Logging endpoint.
 class LoggingSink {
   public:
@@ -74,12 +108,19 @@ class LoggingSink {
     LoggingSink(LoggingSink const&) = delete;
     LoggingSink(LoggingSink&&) = default;
     LoggingSink& operator=(LoggingSink const&) = delete;
-    LoggingSink& operator=(LoggingSink&&) = default;
-    ~LoggingSink() = default;
+    LoggingSink& operator=(LoggingSink&& _other);
+    ~LoggingSink();
 
     LogMask logMask() const noexcept { return logMask_; }
     void setLogMask(LogMask _level) { logMask_ = _level; }
 
+    /// @returns whether events of the given index (see terminal::logEventIndex()) are logged.
+    bool enabled(size_t _eventIndex) const noexcept;
+
+    /// Records raw and traced input and output into a TraceBuffer of @p _capacity events,
+    /// which are written on flush() instead, or directly if zero.
+    void setTraceBufferSize(size_t _capacity);
+
     void log(terminal::LogEvent const& _event);
     void operator()(terminal::LogEvent const& _event) { log(_event); }
 
@@ -95,4 +136,5 @@ class LoggingSink {
     LogMask logMask_;
     std::unique_ptr<std::ostream> ownedSink_;
     std::ostream* sink_;
+    std::unique_ptr<TraceBuffer> traceBuffer_;
 };
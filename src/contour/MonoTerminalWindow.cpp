@@ -0,0 +1,279 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2020 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <contour/MonoTerminalWindow.h>
+#include <contour/InputMapping.h>
+#include <contour/TerminalWidget.h>
+
+#include <terminal/pty/Pty.h>
+
+#if defined(_MSC_VER)
+#include <terminal/pty/ConPty.h>
+#else
+#include <terminal/pty/UnixPty.h>
+#endif
+
+#include <QtCore/QMetaObject>
+#include <QtGui/QKeyEvent>
+#include <QtGui/QMatrix4x4>
+#include <QtGui/QScreen>
+#include <QtGui/QWheelEvent>
+
+#include <fmt/format.h>
+
+using std::make_unique;
+using std::move;
+using std::string;
+using std::chrono::steady_clock;
+
+using namespace std::string_literals;
+
+namespace contour {
+
+using terminal::view::Renderer;
+
+namespace
+{
+    QMatrix4x4 ortho(float _width, float _height)
+    {
+        QMatrix4x4 mat;
+#if defined(LIBTERMINAL_VIEW_NATURAL_COORDS)
+        mat.ortho(0.0f, _width, 0.0f, _height, -1.0f, 1.0f);
+#else
+        mat.ortho(0.0f, _width, _height, 0.0f, -1.0f, 1.0f);
+#endif
+        return mat;
+    }
+}
+
+MonoTerminalWindow::MonoTerminalWindow(config::Config _config, string const& _profileName) :
+    QOpenGLWindow(QOpenGLWindow::NoPartialUpdate),
+    config_{ move(_config) },
+    profile_{ *config_.profile(_profileName) },
+    now_{ steady_clock::now() },
+    fontLoader_{},
+    fonts_{ loadFonts() },
+    blinkTimer_(this)
+{
+    setFormat(TerminalWidget::surfaceFormat(config_.presentMode));
+    setTitle("contour");
+
+    resize(profile_.terminalSize.width * fonts_.regular.first.get().maxAdvance(),
+           profile_.terminalSize.height * fonts_.regular.first.get().lineHeight());
+
+    connect(this, &QOpenGLWindow::frameSwapped, this, &MonoTerminalWindow::onFrameSwapped);
+    connect(&blinkTimer_, &QTimer::timeout, this, [this]() { update(); });
+}
+
+MonoTerminalWindow::~MonoTerminalWindow()
+{
+    // The renderer releases its OpenGL resources, which requires the context to be current.
+    makeCurrent();
+    terminalView_.reset();
+    doneCurrent();
+}
+
+terminal::view::FontConfig MonoTerminalWindow::loadFonts()
+{
+    auto const dpi = screen() ? screen()->logicalDotsPerInchX() : 96.0;
+    int const fontSize = static_cast<int>((static_cast<double>(profile_.fontSize) / 72.0) * dpi);
+
+    return terminal::view::FontConfig{
+        fontLoader_.load(profile_.fonts.regular.pattern, fontSize),
+        fontLoader_.load(profile_.fonts.bold.pattern, fontSize),
+        fontLoader_.load(profile_.fonts.italic.pattern, fontSize),
+        fontLoader_.load(profile_.fonts.boldItalic.pattern, fontSize),
+        fontLoader_.load("emoji", fontSize)
+    };
+}
+
+void MonoTerminalWindow::initializeGL()
+{
+    initializeOpenGLFunctions();
+
+#if defined(_MSC_VER)
+    auto pty = make_unique<terminal::ConPty>(profile_.terminalSize);
+#else
+    auto pty = terminal::UnixPty::create(profile_.terminalSize, config_.ptyReadCoalescingLatency);
+#endif
+    // The shell starts up while the renderer is set up.
+    auto process = make_unique<terminal::Process>(profile_.shell, *pty);
+
+    terminalView_ = make_unique<terminal::view::TerminalView>(
+        now_,
+        *this,
+        profile_.maxHistoryLineCount,
+        config_.wordDelimiters,
+        fonts_,
+        profile_.cursorShape,
+        profile_.cursorDisplay,
+        profile_.cursorBlinkInterval,
+        profile_.colors,
+        profile_.backgroundOpacity,
+        profile_.hyperlinkDecoration.normal,
+        profile_.hyperlinkDecoration.hover,
+        move(pty),
+        move(process),
+        ortho(static_cast<float>(width()), static_cast<float>(height())),
+        *config::Config::loadShaderConfig(config::ShaderClass::Background),
+        *config::Config::loadShaderConfig(config::ShaderClass::Text),
+        *config::Config::loadShaderConfig(config::ShaderClass::Cursor),
+        terminal::Logger{}
+    );
+
+    terminalView_->terminal().setReadBufferSize(config_.ptyReadBufferSize);
+    terminalView_->terminal().setFastForwardThreshold(config_.ptyFastForwardThreshold);
+    terminalView_->terminal().setAlternateBufferReleaseDelay(config_.alternateScreenReleaseDelay);
+    terminalView_->terminal().setMouseMotionCoalescing(profile_.mouseMotionCoalescing);
+    terminalView_->terminal().setParseSliceTime(profile_.parseSliceTime);
+    terminalView_->setMaxImageTextureMemory(config_.maxImageGpuMemory * 1024 * 1024);
+    terminalView_->setCursorMotionDuration(profile_.cursorMotionDuration);
+
+    terminal::Screen& screen = terminalView_->terminal().screen();
+    screen.setTabWidth(profile_.tabWidth);
+    screen.setHistorySpillThreshold(profile_.historySpillThreshold);
+    screen.setHistoryPaging(profile_.historyPageSize, profile_.historyCachedPages);
+    screen.setMode(terminal::Mode::SixelScrolling, config_.sixelScrolling);
+    screen.setMaxImageSize(config_.maxImageSize);
+    screen.setMaxImageColorRegisters(config_.maxImageColorRegisters);
+    screen.setSixelDecoderThreads(config_.sixelDecoderThreads);
+    screen.setMaxImageMemory(config_.maxImageMemory * 1024 * 1024);
+    screen.setSixelCursorConformance(config_.sixelCursorConformance);
+
+    if (profile_.cursorDisplay == terminal::CursorDisplay::Blink)
+        blinkTimer_.start(static_cast<int>(profile_.cursorBlinkInterval.count()));
+}
+
+void MonoTerminalWindow::resizeGL(int _width, int _height)
+{
+    if (_width == 0 || _height == 0)
+        return;
+
+    terminalView_->resize(_width, _height);
+    terminalView_->setProjection(ortho(static_cast<float>(_width), static_cast<float>(_height)));
+    scheduleRedraw();
+}
+
+void MonoTerminalWindow::paintGL()
+{
+    now_ = steady_clock::now();
+    dirty_ = false;
+
+    // Mouse motion merged since the last frame is reported once per frame.
+    terminalView_->terminal().flushMouseMotion();
+
+    bool const reverseVideo = terminalView_->terminal().screen().isModeEnabled(terminal::Mode::ReverseVideo);
+    QVector4D const bg = Renderer::canonicalColor(
+        reverseVideo ? profile_.colors.defaultForeground : profile_.colors.defaultBackground,
+        profile_.backgroundOpacity
+    );
+
+    glClearColor(bg[0], bg[1], bg[2], bg[3]);
+    glClear(GL_COLOR_BUFFER_BIT);
+
+    terminalView_->render(now_, terminalView_->terminal().fastForwarding());
+}
+
+void MonoTerminalWindow::onFrameSwapped()
+{
+    // Screen updates that came in while painting are rendered with the next vertical refresh.
+    if (dirty_.load() || terminalView_->renderer().cursorAnimating(steady_clock::now()))
+        update();
+}
+
+void MonoTerminalWindow::scheduleRedraw()
+{
+    if (!dirty_.exchange(true))
+        QMetaObject::invokeMethod(this, [this]() { update(); }, Qt::QueuedConnection);
+}
+
+void MonoTerminalWindow::keyPressEvent(QKeyEvent* _keyEvent)
+{
+    now_ = steady_clock::now();
+
+    auto& terminal = terminalView_->terminal();
+    if (auto const inputEvent = mapQtToTerminalKeyEvent(_keyEvent->key(), _keyEvent->modifiers()))
+        terminal.send(*inputEvent, now_);
+    else if (!_keyEvent->text().isEmpty())
+    {
+        auto const modifiers = makeModifier(_keyEvent->modifiers());
+        for (auto const ch : _keyEvent->text().toUcs4())
+            terminal.send(terminal::InputEvent{terminal::CharInputEvent{ch, modifiers}}, now_);
+    }
+    else
+        return;
+
+    if (terminal.viewport().scrollToBottom())
+        scheduleRedraw();
+}
+
+void MonoTerminalWindow::wheelEvent(QWheelEvent* _event)
+{
+    now_ = steady_clock::now();
+
+    // Wheel events are forwarded to applications requesting them, and scroll the history otherwise.
+    auto const button = _event->angleDelta().y() > 0 ? terminal::MouseButton::WheelUp : terminal::MouseButton::WheelDown;
+    auto& terminal = terminalView_->terminal();
+    if (terminal.send(terminal::MousePressEvent{button, makeModifier(_event->modifiers())}, now_))
+        return;
+
+    auto const scrolled = button == terminal::MouseButton::WheelUp
+        ? terminal.viewport().scrollUp(profile_.historyScrollMultiplier)
+        : terminal.viewport().scrollDown(profile_.historyScrollMultiplier);
+    if (scrolled)
+        scheduleRedraw();
+}
+
+void MonoTerminalWindow::focusInEvent(QFocusEvent* _event)
+{
+    QOpenGLWindow::focusInEvent(_event);
+    terminalView_->terminal().screen().setFocus(true);
+    terminalView_->terminal().send(terminal::FocusInEvent{}, now_);
+    scheduleRedraw();
+}
+
+void MonoTerminalWindow::focusOutEvent(QFocusEvent* _event)
+{
+    QOpenGLWindow::focusOutEvent(_event);
+    terminalView_->terminal().screen().setFocus(false);
+    terminalView_->terminal().send(terminal::FocusOutEvent{}, now_);
+    scheduleRedraw();
+}
+
+// {{{ TerminalView::Events overrides
+void MonoTerminalWindow::screenUpdated()
+{
+    if (profile_.autoScrollOnUpdate && terminalView_->terminal().viewport().scrolled())
+        terminalView_->terminal().viewport().scrollToBottom();
+
+    scheduleRedraw();
+}
+
+void MonoTerminalWindow::glyphsRasterized()
+{
+    scheduleRedraw();
+}
+
+void MonoTerminalWindow::onClosed()
+{
+    QMetaObject::invokeMethod(this, [this]() { close(); }, Qt::QueuedConnection);
+}
+
+void MonoTerminalWindow::setWindowTitle(std::string_view const& _title)
+{
+    auto const title = _title.empty() ? "contour"s : fmt::format("{} - contour", _title);
+    QMetaObject::invokeMethod(this, [this, title]() { setTitle(QString::fromUtf8(title.c_str())); }, Qt::QueuedConnection);
+}
+// }}}
+
+} // namespace contour
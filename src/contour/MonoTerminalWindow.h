@@ -0,0 +1,84 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2020 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <contour/Config.h>
+#include <terminal_view/TerminalView.h>
+#include <terminal_view/FontConfig.h>
+
+#include <crispy/text/FontLoader.h>
+
+#include <QtCore/QTimer>
+#include <QtGui/QOpenGLExtraFunctions>
+#include <QtGui/QOpenGLWindow>
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+
+namespace contour {
+
+/**
+ * Minimal-overhead terminal window, as used with the --mono command line option.
+ *
+ * Unlike the TerminalWidget, which is composited by Qt Widgets from a framebuffer object,
+ * this window renders directly into the window's default framebuffer. As a compromise, it lacks
+ * the UI features, such as the scrollbar, input mappings, selection and configuration reloading.
+ */
+class MonoTerminalWindow :
+    public QOpenGLWindow,
+    public terminal::view::TerminalView::Events,
+    protected QOpenGLExtraFunctions
+{
+    Q_OBJECT
+
+  public:
+    MonoTerminalWindow(config::Config _config, std::string const& _profileName);
+    ~MonoTerminalWindow() override;
+
+  protected:
+    void initializeGL() override;
+    void resizeGL(int _width, int _height) override;
+    void paintGL() override;
+
+    void keyPressEvent(QKeyEvent* _keyEvent) override;
+    void wheelEvent(QWheelEvent* _wheelEvent) override;
+    void focusInEvent(QFocusEvent* _event) override;
+    void focusOutEvent(QFocusEvent* _event) override;
+
+  private:
+    terminal::view::FontConfig loadFonts();
+    void onFrameSwapped();
+
+    /// Requests a frame, unless requested already since the last one. Thread-safe.
+    void scheduleRedraw();
+
+    void screenUpdated() override;
+    void glyphsRasterized() override;
+    void onClosed() override;
+    void setWindowTitle(std::string_view const& _title) override;
+
+  private:
+    config::Config config_;
+    config::TerminalProfile profile_;
+    std::chrono::steady_clock::time_point now_;
+    crispy::text::FontLoader fontLoader_;
+    terminal::view::FontConfig fonts_;
+    std::unique_ptr<terminal::view::TerminalView> terminalView_;
+    QTimer blinkTimer_;                     // update() timer used to animate the blinking cursor
+    std::atomic<bool> dirty_ = true;        // whether the screen changed since the last frame
+};
+
+} // namespace contour
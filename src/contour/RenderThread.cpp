@@ -0,0 +1,72 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2020 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <contour/RenderThread.h>
+
+using namespace std;
+
+namespace contour {
+
+shared_ptr<RenderThread> RenderThread::shared()
+{
+    static auto mutex = std::mutex{};
+    static auto instance = weak_ptr<RenderThread>{};
+
+    auto const _l = scoped_lock{mutex};
+    if (auto thread = instance.lock(); thread)
+        return thread;
+
+    auto thread = shared_ptr<RenderThread>{new RenderThread()};
+    thread->setObjectName("render");
+    thread->start();
+    instance = thread;
+    return thread;
+}
+
+RenderThread::~RenderThread()
+{
+    {
+        auto const _l = scoped_lock{mutex_};
+        quit_ = true;
+    }
+    wakeup_.notify_one();
+    wait();
+}
+
+void RenderThread::post(function<void()> _job)
+{
+    {
+        auto const _l = scoped_lock{mutex_};
+        jobs_.emplace_back(move(_job));
+    }
+    wakeup_.notify_one();
+}
+
+void RenderThread::run()
+{
+    for (;;)
+    {
+        auto job = function<void()>{};
+        {
+            auto lock = unique_lock{mutex_};
+            wakeup_.wait(lock, [this]() { return quit_ || !jobs_.empty(); });
+            if (jobs_.empty())
+                return;
+            job = move(jobs_.front());
+            jobs_.pop_front();
+        }
+        job();
+    }
+}
+
+} // end namespace
@@ -0,0 +1,53 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2020 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <QtCore/QThread>
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+
+namespace contour {
+
+/// Thread rendering the frames of the terminal widgets of this process, one after another, such
+/// that expensive frames do not delay handling input on the GUI thread, and vice versa.
+///
+/// Widgets move their GL context to this thread for rendering a frame, see TerminalWidget.
+class RenderThread : public QThread {
+  public:
+    /// @returns the render thread shared by all widgets rendering on it, started with the first
+    ///          call and stopped once the last widget released it.
+    static std::shared_ptr<RenderThread> shared();
+
+    ~RenderThread() override;
+
+    /// Runs @p _job on the render thread, after the jobs posted before.
+    void post(std::function<void()> _job);
+
+  protected:
+    void run() override;
+
+  private:
+    RenderThread() = default;
+
+    std::mutex mutex_;
+    std::condition_variable wakeup_;
+    std::deque<std::function<void()>> jobs_;
+    bool quit_ = false;
+};
+
+} // end namespace
@@ -0,0 +1,75 @@
+/**
+ * This file is part of the "contour" project
+ *   Copyright (c) 2019-2020 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <contour/StatisticsServer.h>
+
+#include <QtNetwork/QLocalSocket>
+
+using std::move;
+using std::string;
+
+namespace contour {
+
+StatisticsServer::StatisticsServer(Report _report) :
+    report_{ move(_report) }
+{
+    QObject::connect(&server_, &QLocalServer::newConnection, &server_, [this]() { onNewConnection(); });
+}
+
+StatisticsServer::~StatisticsServer()
+{
+    close();
+}
+
+bool StatisticsServer::listen(FileSystem::path const& _path)
+{
+    close();
+
+    auto const name = QString::fromStdString(_path.string());
+    if (server_.listen(name))
+        return true;
+
+    if (server_.serverError() != QAbstractSocket::AddressInUseError)
+        return false;
+
+    // The socket file may be left over by a process that crashed, which nobody accepts on anymore.
+    QLocalSocket probe;
+    probe.connectToServer(name);
+    if (probe.waitForConnected(100))
+        return false;
+
+    QLocalServer::removeServer(name);
+    return server_.listen(name);
+}
+
+void StatisticsServer::close()
+{
+    if (server_.isListening())
+        server_.close();
+}
+
+void StatisticsServer::onNewConnection()
+{
+    while (QLocalSocket* socket = server_.nextPendingConnection())
+    {
+        QObject::connect(socket, &QLocalSocket::disconnected, socket, &QObject::deleteLater);
+
+        string const report = report_();
+        socket->write(report.data(), static_cast<qint64>(report.size()));
+
+        // Disconnects once the report has been written.
+        socket->disconnectFromServer();
+    }
+}
+
+} // namespace contour
@@ -0,0 +1,58 @@
+/**
+ * This file is part of the "contour" project
+ *   Copyright (c) 2019-2020 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <crispy/stdfs.h>
+
+#include <QtNetwork/QLocalServer>
+
+#include <functional>
+#include <string>
+
+namespace contour {
+
+/**
+ * Serves runtime statistics to monitoring, over a local socket (a Unix domain socket, or a
+ * named pipe on Windows).
+ *
+ * Each client connecting is sent one report and disconnected, such that e.g.
+ * `socat - UNIX-CONNECT:/path/to/socket` prints the current statistics.
+ *
+ * The server lives on the GUI thread, which is where the report is created.
+ */
+class StatisticsServer {
+  public:
+    using Report = std::function<std::string()>;
+
+    explicit StatisticsServer(Report _report);
+    ~StatisticsServer();
+
+    /// Starts serving at @p _path, replacing a stale socket file left over by a crashed process.
+    ///
+    /// @retval false the path is in use by another live server, or could not be listened on.
+    bool listen(FileSystem::path const& _path);
+
+    /// Stops serving and removes the socket file.
+    void close();
+
+    bool listening() const { return server_.isListening(); }
+
+  private:
+    void onNewConnection();
+
+    Report report_;
+    QLocalServer server_;
+};
+
+} // namespace contour
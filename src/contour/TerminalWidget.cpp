@@ -13,9 +13,14 @@
  */
 #include <contour/TerminalWidget.h>
 #include <contour/Actions.h>
+#include <contour/InputMapping.h>
 
 #include <terminal/Metrics.h>
 #include <terminal/pty/Pty.h>
+#include <terminal_view/ShaderCache.h>
+#include <terminal_view/ShaderConfig.h>
+
+#include <crispy/mapped_file.h>
 
 #if defined(_MSC_VER)
 #include <terminal/pty/ConPty.h>
@@ -24,22 +29,28 @@
 #endif
 
 #include <QtCore/QDebug>
+#include <QtCore/QDir>
 #include <QtCore/QFileInfo>
 #include <QtCore/QProcess>
 #include <QtCore/QTimer>
 #include <QtNetwork/QHostInfo>
 #include <QtGui/QClipboard>
 #include <QtGui/QDesktopServices>
+#include <QtGui/QImage>
 #include <QtGui/QKeyEvent>
+#include <QtGui/QOpenGLContext>
 #include <QtGui/QScreen>
 #include <QtGui/QWindow>
 #include <QtWidgets/QApplication>
+#include <QtWidgets/QFileDialog>
 #include <QtWidgets/QScrollBar>
 
 #if defined(CONTOUR_BLUR_PLATFORM_KWIN)
 #include <KWindowEffects>
 #endif
 
+#include <algorithm>
+#include <cctype>
 #include <cstring>
 #include <fstream>
 #include <stdexcept>
@@ -57,6 +68,7 @@ using std::endl;
 using std::exception;
 using std::get;
 using std::lock_guard;
+using std::make_shared;
 using std::make_unique;
 using std::max;
 using std::move;
@@ -93,6 +105,12 @@ using actions::Action;
 
 namespace // {{{
 {
+    /// Interval at which the screen snapshot is saved, if configured.
+    constexpr auto SnapshotInterval = std::chrono::seconds(10);
+
+    /// Time the window size must not change for, before the screen and the application follow.
+    constexpr auto ResizeQuietPeriod = std::chrono::milliseconds(100);
+
     inline char const* signalName(int _signo)
     {
 #if defined(__unix__) || defined(__APPLE__)
@@ -102,97 +120,22 @@ namespace // {{{
 #endif
     }
 
-    constexpr inline terminal::Modifier makeModifier(int _mods)
-    {
-        using terminal::Modifier;
-
-        Modifier mods{};
-
-        if (_mods & Qt::AltModifier)
-            mods |= Modifier::Alt;
-        if (_mods & Qt::ShiftModifier)
-            mods |= Modifier::Shift;
-        if (_mods & Qt::ControlModifier)
-            mods |= Modifier::Control;
-        if (_mods & Qt::MetaModifier)
-            mods |= Modifier::Meta;
-
-        return mods;
-    }
-
-    constexpr terminal::MouseButton makeMouseButton(Qt::MouseButton _button)
+    /// Decodes a compressed inline image into RGBA, scaled to the size it is displayed at.
+    optional<terminal::Image::Data> decodeImage(string_view _data, terminal::Size _pixelSize)
     {
-        switch (_button)
-        {
-            case Qt::MouseButton::RightButton:
-                return terminal::MouseButton::Right;
-            case Qt::MiddleButton:
-                return terminal::MouseButton::Middle;
-            case Qt::LeftButton:
-                [[fallthrough]];
-            default: // d'oh
-                return terminal::MouseButton::Left;
-        }
-    }
-
-    optional<terminal::InputEvent> mapQtToTerminalKeyEvent(int _key, Qt::KeyboardModifiers _mods)
-    {
-        using terminal::Key;
-        using terminal::InputEvent;
-        using terminal::KeyInputEvent;
-        using terminal::CharInputEvent;
-
-        static auto constexpr mapping = array{
-            pair{Qt::Key_Insert, Key::Insert},
-            pair{Qt::Key_Delete, Key::Delete},
-            pair{Qt::Key_Right, Key::RightArrow},
-            pair{Qt::Key_Left, Key::LeftArrow},
-            pair{Qt::Key_Down, Key::DownArrow},
-            pair{Qt::Key_Up, Key::UpArrow},
-            pair{Qt::Key_PageDown, Key::PageDown},
-            pair{Qt::Key_PageUp, Key::PageUp},
-            pair{Qt::Key_Home, Key::Home},
-            pair{Qt::Key_End, Key::End},
-            pair{Qt::Key_F1, Key::F1},
-            pair{Qt::Key_F2, Key::F2},
-            pair{Qt::Key_F3, Key::F3},
-            pair{Qt::Key_F4, Key::F4},
-            pair{Qt::Key_F5, Key::F5},
-            pair{Qt::Key_F6, Key::F6},
-            pair{Qt::Key_F7, Key::F7},
-            pair{Qt::Key_F8, Key::F8},
-            pair{Qt::Key_F9, Key::F9},
-            pair{Qt::Key_F10, Key::F10},
-            pair{Qt::Key_F11, Key::F11},
-            pair{Qt::Key_F12, Key::F12},
-            // todo: F13..F25
-            // TODO: NumPad
-            // pair{Qt::Key_0, Key::Numpad_0},
-            // pair{Qt::Key_1, Key::Numpad_1},
-            // pair{Qt::Key_2, Key::Numpad_2},
-            // pair{Qt::Key_3, Key::Numpad_3},
-            // pair{Qt::Key_4, Key::Numpad_4},
-            // pair{Qt::Key_5, Key::Numpad_5},
-            // pair{Qt::Key_6, Key::Numpad_6},
-            // pair{Qt::Key_7, Key::Numpad_7},
-            // pair{Qt::Key_8, Key::Numpad_8},
-            // pair{Qt::Key_9, Key::Numpad_9},
-            // pair{Qt::Key_Period, Key::Numpad_Decimal},
-            // pair{Qt::Key_Slash, Key::Numpad_Divide},
-            // pair{Qt::Key_Asterisk, Key::Numpad_Multiply},
-            // pair{Qt::Key_Minus, Key::Numpad_Subtract},
-            // pair{Qt::Key_Plus, Key::Numpad_Add},
-            // pair{Qt::Key_Enter, Key::Numpad_Enter},
-            // pair{Qt::Key_Equal, Key::Numpad_Equal},
-        };
-
-        if (auto i = find_if(begin(mapping), end(mapping), [_key](auto const& x) { return x.first == _key; }); i != end(mapping))
-            return { InputEvent{KeyInputEvent{i->second, makeModifier(_mods)}} };
-
-        if (_key == Qt::Key_Backtab)
-            return { InputEvent{CharInputEvent{'\t', makeModifier(_mods | Qt::ShiftModifier)}} };
-
-        return nullopt;
+        auto image = QImage::fromData(reinterpret_cast<uchar const*>(_data.data()), static_cast<int>(_data.size()));
+        if (image.isNull())
+            return nullopt;
+
+        if (image.width() != _pixelSize.width || image.height() != _pixelSize.height)
+            image = image.scaled(_pixelSize.width, _pixelSize.height, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+        image = image.convertToFormat(QImage::Format_RGBA8888);
+
+        auto const rowSize = static_cast<size_t>(_pixelSize.width) * 4;
+        auto data = terminal::Image::Data(rowSize * static_cast<size_t>(_pixelSize.height));
+        for (int y = 0; y < _pixelSize.height; ++y)
+            std::memcpy(data.data() + static_cast<size_t>(y) * rowSize, image.constScanLine(y), rowSize);
+        return data;
     }
 
     inline QMatrix4x4 ortho(float left, float right, float bottom, float top)
@@ -357,6 +300,20 @@ namespace // {{{
     {
         cerr << unhandledExceptionMessage(where, e) << endl;
     }
+
+    /// @returns the given cache directory, or an empty path (disabling the cache) if there is no cache home.
+    FileSystem::path cacheDirectory(std::string const& _name)
+    {
+        try
+        {
+            return config::cacheHome() / _name;
+        }
+        catch (std::exception const& e)
+        {
+            reportUnhandledException(__PRETTY_FUNCTION__, e);
+            return {};
+        }
+    }
 } // }}}
 
 TerminalWidget::TerminalWidget(config::Config _config,
@@ -373,15 +330,32 @@ TerminalWidget::TerminalWidget(config::Config _config,
             ? LoggingSink{config_.loggingMask, config_.logFilePath->string()}
             : LoggingSink{config_.loggingMask, &cout}
     },
-    fontLoader_{&cerr},
-    fonts_{loadFonts(profile())},
+    fontLoader_{&cerr, cacheDirectory("fonts")},
     terminalView_{},
     configFileChangeWatcher_{
         config_.backingFilePath,
         [this](FileChangeWatcher::Event event) { onConfigReload(event); }
     },
-    updateTimer_(this)
+    updateTimer_(this),
+    frameTimer_(this),
+    memoryLogTimer_(this),
+    snapshotTimer_(this),
+    resizeTimer_(this),
+    statisticsServer_{[this]() { return statisticsReport(); }}
 {
+    // Startup work is overlapped: the shell is spawned first, such that it starts up meanwhile,
+    // writing into the PTY until the view reads from it. The fonts are loaded and the shader
+    // programs built on worker threads while the window and its GL context are created.
+    startupTimes_.start = steady_clock::now();
+    createPty();
+    fontsLoaded_ = std::async(std::launch::async, [this, specs = profile().fonts, size = fontPixelSize(profile())]() {
+        auto const start = steady_clock::now();
+        auto result = loadFonts(specs, size);
+        startupTimes_.fonts = steady_clock::now() - start;
+        return result;
+    });
+    prebuildShaders();
+
     // qDebug() << "TerminalWidget.ctor:"
     //     << QString::fromUtf8(fmt::format("{}", config_.profile(config_.defaultProfileName)->terminalSize).c_str())
     //     << "fontSize:" << profile().fontSize
@@ -389,6 +363,8 @@ TerminalWidget::TerminalWidget(config::Config _config,
     //     << "geometry:" << geometry()
     //     ;
 
+    logger_.setTraceBufferSize(config_.logTraceBufferSize);
+
     setMouseTracking(true);
 
     // QPalette p = QApplication::palette();
@@ -397,7 +373,10 @@ TerminalWidget::TerminalWidget(config::Config _config,
     // p.setColor(QPalette::Window, backgroundColor);
     // setPalette(p);
 
-    setFormat(surfaceFormat());
+    setFormat(surfaceFormat(config_.presentMode));
+
+    // The previous frame is kept for the renderer to draw the rows changed since only.
+    setUpdateBehavior(config_.partialPresentation ? QOpenGLWidget::PartialUpdate : QOpenGLWidget::NoPartialUpdate);
 
     setAttribute(Qt::WA_InputMethodEnabled, true);
     setAttribute(Qt::WA_OpaquePaintEvent);
@@ -407,8 +386,44 @@ TerminalWidget::TerminalWidget(config::Config _config,
 
     createScrollBar();
 
+    lastActivity_ = steady_clock::now().time_since_epoch().count();
+
     updateTimer_.setSingleShot(true);
-    connect(&updateTimer_, &QTimer::timeout, this, QOverload<>::of(&TerminalWidget::blinkingCursorUpdate));
+    connect(&updateTimer_, &QTimer::timeout, this, [this]() { timerWakeup(); blinkingCursorUpdate(); });
+
+    frameTimer_.setSingleShot(true);
+    frameTimer_.setTimerType(Qt::PreciseTimer);
+    connect(&frameTimer_, &QTimer::timeout, this, [this]() { timerWakeup(); update(); });
+
+    connect(&memoryLogTimer_, &QTimer::timeout, this, [this]() { timerWakeup(); logMemoryUsage(); });
+    if (config_.logMemoryUsageInterval.count() != 0)
+        memoryLogTimer_.start(std::chrono::milliseconds(config_.logMemoryUsageInterval));
+
+    // Once idling, the snapshot is written a final time.
+    connect(&snapshotTimer_, &QTimer::timeout, this, [this]() { timerWakeup(); writeSnapshot(); });
+
+    resizeTimer_.setSingleShot(true);
+    connect(&resizeTimer_, &QTimer::timeout, this, [this]() {
+        timerWakeup();
+        if (terminalView_->applyScreenSize() && setScreenDirty())
+            requestFrame();
+    });
+
+    // Composing reads the framebuffer and resizing replaces it, hence neither may happen while the
+    // render thread renders into it. The lock is released before onFrameSwapped() takes it again.
+    if (config_.renderThread)
+    {
+        renderThread_ = RenderThread::shared();
+        auto const lock = [this]() { composeLock_ = lockRenderer(); };
+        auto const unlock = [this]() {
+            if (composeLock_.owns_lock())
+                composeLock_.unlock();
+        };
+        connect(this, &QOpenGLWidget::aboutToCompose, this, lock);
+        connect(this, &QOpenGLWidget::frameSwapped, this, unlock);
+        connect(this, &QOpenGLWidget::aboutToResize, this, lock);
+        connect(this, &QOpenGLWidget::resized, this, unlock);
+    }
 
     connect(this, SIGNAL(frameSwapped()), this, SLOT(onFrameSwapped()));
 
@@ -418,8 +433,19 @@ TerminalWidget::TerminalWidget(config::Config _config,
 TerminalWidget::~TerminalWidget()
 {
     std::cout << "TerminalWidget.dtor!\n";
+    auto const rendererLock = lockRenderer();
     makeCurrent(); // XXX must be called.
     statsSummary();
+    writeSnapshot();
+#if !defined(_MSC_VER)
+    // Stops mirroring into the terminal before it is gone.
+    sessionViewer_.reset();
+#endif
+
+    if (selectionCopyThread_.joinable())
+        selectionCopyThread_.join();
+    if (scrollbackExportThread_.joinable())
+        scrollbackExportThread_.join();
 }
 
 void TerminalWidget::statsSummary()
@@ -429,6 +455,22 @@ void TerminalWidget::statsSummary()
     std::cout << "================================================\n\n";
     for (auto const& [name, freq] : terminalMetrics_.ordered())
         std::cout << fmt::format("{:>10}: {}\n", freq, name);
+
+    std::cout << fmt::format("\nEstimated time per function (1 in {} dispatches timed)\n\n",
+                             terminalMetrics_.sampleInterval);
+    std::cout << fmt::format("{:>10} {:>10} {:>10}  {}\n", "calls", "total ms", "ns/call", "function");
+    for (auto const& entry : terminalMetrics_.profile())
+        std::cout << fmt::format("{:>10} {:>10.3f} {:>10.1f}  {}\n",
+                                 entry.count,
+                                 entry.nanoseconds / 1e6,
+                                 entry.nanoseconds / static_cast<double>(entry.count),
+                                 entry.name);
+
+    std::cout << "\nBytes per category\n\n";
+    for (auto const& [category, bytes] : terminalMetrics_.bytesPerCategory())
+        std::cout << fmt::format("{:>10}: {}\n", bytes, category);
+    std::cout << fmt::format("\nPeak input queue depth: {} bytes\n",
+                             terminalView_->terminal().peakPendingInputBytes());
 #endif
 }
 
@@ -445,7 +487,7 @@ void TerminalWidget::createScrollBar()
     connect(scrollBar_, &QScrollBar::valueChanged, this, QOverload<>::of(&TerminalWidget::onScrollBarValueChanged));
 }
 
-QSurfaceFormat TerminalWidget::surfaceFormat()
+QSurfaceFormat TerminalWidget::surfaceFormat(config::PresentMode _presentMode)
 {
     QSurfaceFormat format;
 
@@ -472,7 +514,20 @@ QSurfaceFormat TerminalWidget::surfaceFormat()
 
     format.setAlphaBufferSize(8);
     format.setSwapBehavior(QSurfaceFormat::DoubleBuffer);
-    format.setSwapInterval(1);
+    switch (_presentMode)
+    {
+        case config::PresentMode::Fifo:
+            format.setSwapInterval(1);
+            break;
+        case config::PresentMode::FifoRelaxed:
+            // Adaptive vsync (EXT_swap_control_tear), where the driver supports it.
+            format.setSwapInterval(-1);
+            break;
+        case config::PresentMode::Mailbox:
+            // requestFrame() paces the frames to the display's refresh rate still.
+            format.setSwapInterval(0);
+            break;
+    }
 
 #if !defined(NDEBUG)
     format.setOption(QSurfaceFormat::DebugContext);
@@ -483,18 +538,148 @@ QSurfaceFormat TerminalWidget::surfaceFormat()
 
 void TerminalWidget::blinkingCursorUpdate()
 {
-    update();
+    if (!hidden_)
+        update();
+}
+
+void TerminalWidget::timerWakeup()
+{
+    statistics_.timerWakeups.fetch_add(1, std::memory_order_relaxed);
+    updateIdleState(steady_clock::now());
+}
+
+void TerminalWidget::updateIdleState(steady_clock::time_point _now)
+{
+    auto const lastActivity = steady_clock::time_point(steady_clock::duration(lastActivity_.load()));
+    auto const idle = config_.idleTimeout.count() != 0 && _now - lastActivity >= config_.idleTimeout;
+    if (idle == idle_.exchange(idle))
+        return;
+
+    // Frames are only rendered on output and input while idle, hence the cursor stops blinking.
+    {
+        auto const _l = lockRenderer();
+        terminalView_->renderer().setCursorBlinking(!idle);
+    }
+    if (idle)
+    {
+        snapshotTimer_.stop();
+        memoryLogTimer_.stop();
+    }
+    else
+    {
+        if (snapshotWriter_)
+            snapshotTimer_.start(SnapshotInterval);
+        if (config_.logMemoryUsageInterval.count() != 0)
+            memoryLogTimer_.start(std::chrono::milliseconds(config_.logMemoryUsageInterval));
+    }
+}
+
+void TerminalWidget::updateVisibility()
+{
+    auto const* windowHandle = window()->windowHandle();
+    auto const hidden = !isVisible()
+                     || !windowHandle
+                     || !windowHandle->isExposed()
+                     || windowHandle->visibility() == QWindow::Minimized;
+    if (hidden == hidden_.exchange(hidden))
+        return;
+
+    if (hidden)
+    {
+        updateTimer_.stop();
+        frameTimer_.stop();
+        statistics_.frameDue.reset();
+    }
+    else
+    {
+        // The screen kept track of the rows changed meanwhile, only those are rendered.
+        setScreenDirty();
+        requestFrame();
+    }
+}
+
+std::chrono::microseconds TerminalWidget::frameInterval() const
+{
+    auto const* windowHandle = window()->windowHandle();
+    auto const refreshRate = windowHandle && windowHandle->screen() ? windowHandle->screen()->refreshRate() : 0.0;
+
+    // More frames than the display refreshes with would never be seen anyways.
+    auto framesPerSecond = refreshRate > 0.0 ? refreshRate : 60.0;
+    if (config_.maxFramesPerSecond != 0)
+        framesPerSecond = std::min(framesPerSecond, static_cast<double>(config_.maxFramesPerSecond));
+
+    return std::chrono::microseconds(static_cast<int64_t>(1'000'000.0 / framesPerSecond));
+}
+
+void TerminalWidget::requestFrame()
+{
+    if (hidden_ || frameTimer_.isActive())
+        return;
+
+    // Rendering right away after a period of inactivity keeps typing latency low, whereas
+    // continuous updates (such as flooding output) are paced to one frame per frame interval,
+    // each one showing the latest screen state. Right after a frame has been swapped, which
+    // blocks until the display's vertical refresh, the interval has usually passed already.
+    //
+    // update() is always invoked from the timer, as calling it from within the frameSwapped()
+    // handler is known to freeze on Wayland.
+    auto const nextFrame = lastFrame_ + frameInterval();
+    auto const now = steady_clock::now();
+    auto const delay = nextFrame > now
+                     ? std::chrono::duration_cast<std::chrono::milliseconds>(nextFrame - now)
+                     : std::chrono::milliseconds(0);
+    frameTimer_.start(static_cast<int>(delay.count()));
+    statistics_.frameDue = std::max(nextFrame, now);
+}
+
+void TerminalWidget::scheduleRedraw()
+{
+    if (setScreenDirty())
+        requestFrame();
 }
 
 void TerminalWidget::onFrameSwapped()
 {
+    auto const rendererLock = lockRenderer();
+
+    if (auto const inputTime = terminalView_->terminal().takeRenderedInputTime(); inputTime.has_value())
+        inputLatency_.add(steady_clock::now() - *inputTime);
+
+    auto const& metrics = terminalView_->renderer().metrics();
+    statistics_.renderedFrames.fetch_add(1, std::memory_order_relaxed);
+    statistics_.shapingCacheHits.fetch_add(metrics.shapingCacheHits, std::memory_order_relaxed);
+    statistics_.shapingCacheMisses.fetch_add(metrics.shapingCacheMisses, std::memory_order_relaxed);
+    statistics_.rasterizedGlyphs.fetch_add(metrics.rasterizedGlyphs, std::memory_order_relaxed);
+    statistics_.missingGlyphs.fetch_add(metrics.missingGlyphs, std::memory_order_relaxed);
+
+    if (performanceHud_.visible)
+        updatePerformanceHud();
+
 #if defined(CONTOUR_PERF_STATS)
     qDebug() << QString::fromStdString(fmt::format(
-        "Consecutive renders: {}, updates since last render: {}; {}",
+        "Consecutive renders: {}, updates since last render: {}, pending input: {} bytes; {}",
         STATS_GET(consecutiveRenderCount),
         STATS_GET(updatesSinceRendering),
+        terminalView_->terminal().pendingInputBytes(),
         terminalView_->renderer().metrics().to_string()
     ));
+
+    if (!std::exchange(startupTimes_.reported, true))
+    {
+        auto const ms = [](steady_clock::duration _duration) {
+            return std::chrono::duration_cast<std::chrono::milliseconds>(_duration).count();
+        };
+        qDebug() << QString::fromStdString(fmt::format(
+            "Startup: first frame after {} ms; shell spawned in {} ms, fonts loaded in {} ms and "
+            "shaders built in {} ms while the context was created in {} ms, view created in {} ms",
+            ms(steady_clock::now() - startupTimes_.start),
+            ms(startupTimes_.shell),
+            ms(startupTimes_.fonts),
+            ms(startupTimes_.shaders),
+            ms(startupTimes_.context),
+            ms(startupTimes_.view)
+        ));
+    }
 #endif
 
     for (;;)
@@ -506,18 +691,12 @@ void TerminalWidget::onFrameSwapped()
                 //assert(!"The impossible happened, painting but painting. Shakesbeer.");
                 qDebug() << "The impossible happened, onFrameSwapped() called in wrong state DirtyIdle.";
                 renderingPressure_ = false;
-                update();
+                requestFrame();
                 return;
             case State::DirtyPainting:
-                // FIXME: Qt/Wayland!
-                // QCoreApplication::postEvent() works on both, but horrorble performance
-                // requestUpdate() works on X11 as well as Wayland but isn't mentioned in any QtGL docs.
-                // update() is meant to be correct way and works on X11 but freezes on Wayland!
-
-                //QCoreApplication::postEvent(this, new QEvent(QEvent::UpdateRequest));
-                //requestUpdate();
+                // Screen updates arrived while painting, render them with the next frame.
                 // TODO(don't do pressure-optimizations right now) renderingPressure_ = true;
-                update();
+                requestFrame();
                 return;
             case State::CleanPainting:
                 if (!state_.compare_exchange_strong(state, State::CleanIdle))
@@ -526,7 +705,23 @@ void TerminalWidget::onFrameSwapped()
             case State::CleanIdle:
                 renderingPressure_ = false;
                 STATS_ZERO(consecutiveRenderCount);
-                if (profile().cursorDisplay == terminal::CursorDisplay::Blink
+                if (hidden_)
+                    return;
+                // The cursor moves in the shader, but only as long as frames are rendered.
+                if (terminalView_->renderer().cursorAnimating(steady_clock::now()))
+                {
+                    requestFrame();
+                    return;
+                }
+                // A synchronized update not ended by the application is shown once it timed out.
+                if (auto const remaining = terminalView_->terminal().synchronizedOutputRemaining(steady_clock::now());
+                        remaining.count() > 0)
+                {
+                    updateTimer_.start(remaining);
+                    return;
+                }
+                if (!idle_
+                        && profile().cursorDisplay == terminal::CursorDisplay::Blink
                         && terminalView_->terminal().cursorVisibility())
                     updateTimer_.start(terminalView_->terminal().nextRender(steady_clock::now()));
                 return;
@@ -534,16 +729,281 @@ void TerminalWidget::onFrameSwapped()
     }
 }
 
+void TerminalWidget::updatePerformanceHud()
+{
+    using std::chrono::duration;
+    using std::milli;
+
+    // Throughput is sampled over a while, as a single frame parses in bursts.
+    auto constexpr SampleInterval = std::chrono::milliseconds(500);
+
+    auto const now = steady_clock::now();
+    auto const parsedBytes = terminalView_->terminal().parsedBytes();
+#if defined(CRISPY_ALLOCATION_TRACKING)
+    namespace allocation_tracker = crispy::allocation_tracker;
+    auto allocations = decltype(performanceHud_.frameAllocations){};
+    for (size_t i = 0; i < allocation_tracker::subsystem_count; ++i)
+        allocations[i] = allocation_tracker::total(static_cast<allocation_tracker::subsystem>(i)).count;
+#endif
+    if (now - performanceHud_.sampleTime >= SampleInterval)
+    {
+        auto const seconds = duration<double>(now - performanceHud_.sampleTime).count();
+        performanceHud_.parsedBytesPerSecond = static_cast<double>(parsedBytes - performanceHud_.sampleParsedBytes) / seconds;
+#if defined(CRISPY_ALLOCATION_TRACKING)
+        for (size_t i = 0; i < allocation_tracker::subsystem_count; ++i)
+            performanceHud_.allocationsPerSecond[i] = static_cast<double>(allocations[i] - performanceHud_.sampleAllocations[i]) / seconds;
+        performanceHud_.sampleAllocations = allocations;
+#endif
+        performanceHud_.sampleTime = now;
+        performanceHud_.sampleParsedBytes = parsedBytes;
+        auto const _l = scoped_lock{terminalView_->terminal()};
+        performanceHud_.memoryUsage = memoryUsage();
+    }
+
+    auto const& metrics = terminalView_->renderer().metrics();
+    auto const ms = [](auto _duration) { return duration<double, milli>(_duration).count(); };
+    auto const line = [&](string_view _name, auto _duration) {
+        return fmt::format(" {:<13}{:>8.2f} ms ", _name, ms(_duration));
+    };
+
+    auto lines = std::vector<std::string>{
+        line("frame", now - lastFrame_),
+        line("lock wait", metrics.lockWaitTime),
+        line("cell walk", metrics.cellWalkTime),
+        line("shaping", metrics.shapingTime),
+        line("atlas upload", metrics.atlasUploadTime),
+        line("GL submit", metrics.submitTime),
+        fmt::format(" {:<13}{:>8}    ", "draw calls", metrics.drawCalls),
+        fmt::format(" {:<13}{:>8} KB ", "GL upload", metrics.uploadedBytes / 1024),
+        line("swap", now - paintEnd_),
+        fmt::format(" {:<13}{:>8.2f} MB/s", "parser", performanceHud_.parsedBytesPerSecond / (1024.0 * 1024.0)),
+        fmt::format(" {:<13}{:>8} KB ", "PTY backlog", terminalView_->terminal().pendingOutputBytes() / 1024),
+        line("input p50", inputLatency_.percentile(50)),
+        line("input p99", inputLatency_.percentile(99))
+    };
+    for (auto const& [name, bytes] : performanceHud_.memoryUsage)
+        lines.emplace_back(fmt::format(" {:<13}{:>8.2f} MB ", name, static_cast<double>(bytes) / (1024.0 * 1024.0)));
+
+#if defined(CRISPY_ALLOCATION_TRACKING)
+    // Allocations of the previous frame, and per second over the previous sample.
+    for (size_t i = 0; i < allocation_tracker::subsystem_count; ++i)
+        lines.emplace_back(fmt::format(" alloc {:<7}{:>6}/f {:>8.0f}/s ",
+                                       allocation_tracker::name(static_cast<allocation_tracker::subsystem>(i)),
+                                       allocations[i] - performanceHud_.frameAllocations[i],
+                                       performanceHud_.allocationsPerSecond[i]));
+    performanceHud_.frameAllocations = allocations;
+#endif
+
+    terminalView_->setOverlay(lines);
+}
+
+std::vector<std::pair<std::string_view, size_t>> TerminalWidget::memoryUsage()
+{
+    auto const screen = terminalView_->terminal().screen().memoryUsage();
+    auto const renderer = terminalView_->renderer().memoryUsage();
+
+    return {
+        {"screen", screen.lines},
+        {"history", screen.history},
+        {"cell extras", screen.cellExtras},
+        {"hyperlinks", screen.hyperlinks},
+        {"attributes", screen.attributes},
+        {"images", screen.images},
+        {"shaping cache", renderer.shapingCache},
+        {"GPU textures", renderer.textures},
+        {"GPU glyphs", renderer.glyphTextures},
+        {"total", screen.total() + renderer.total()}
+    };
+}
+
+void TerminalWidget::logMemoryUsage()
+{
+    auto* sink = logger_.sink();
+    if (!sink)
+        return;
+
+    auto const usage = [&]() {
+        auto const rendererLock = lockRenderer();
+        auto const _l = scoped_lock{terminalView_->terminal()};
+        return memoryUsage();
+    }();
+
+    // One line of key=value pairs, to be picked up by monitoring.
+    auto line = std::string{"memory_usage:"};
+    for (auto const& [name, bytes] : usage)
+    {
+        auto key = std::string(name);
+        std::replace(key.begin(), key.end(), ' ', '_');
+        std::transform(key.begin(), key.end(), key.begin(), [](char c) { return static_cast<char>(std::tolower(c)); });
+        line += fmt::format(" {}={}", key, bytes);
+    }
+    *sink << line << '\n';
+    sink->flush();
+}
+
+string TerminalWidget::statisticsReport()
+{
+    using std::chrono::duration;
+
+    if (!terminalView_)
+        return {};
+
+    auto& terminal = terminalView_->terminal();
+    auto const now = steady_clock::now();
+    auto const rendererLock = lockRenderer();
+
+    // Walking the screen's cells takes the screen lock, so the memory usage is sampled at most once a second.
+    if (now - statistics_.memoryUsageTime >= std::chrono::seconds(1))
+    {
+        auto const _l = scoped_lock{terminal};
+        statistics_.memoryUsage = memoryUsage();
+        statistics_.memoryUsageTime = now;
+    }
+
+    auto const relaxed = [](std::atomic<uint64_t> const& _counter) { return _counter.load(std::memory_order_relaxed); };
+    auto const atlas = terminalView_->renderer().atlasOccupancy();
+    auto const seconds = [](auto _duration) { return duration<double>(_duration).count(); };
+
+    auto report = string{};
+    auto const add = [&](string_view _name, auto _value) { report += fmt::format("{} {}\n", _name, _value); };
+    add("parsed_bytes_total", terminal.parsedBytes());
+    add("parse_backlog_bytes", terminal.pendingOutputBytes());
+    add("input_backlog_bytes", terminal.pendingInputBytes());
+    add("frames_rendered_total", relaxed(statistics_.renderedFrames));
+    add("frames_dropped_total", relaxed(statistics_.droppedFrames));
+    add("shaping_cache_hits_total", relaxed(statistics_.shapingCacheHits));
+    add("shaping_cache_misses_total", relaxed(statistics_.shapingCacheMisses));
+    add("glyphs_rasterized_total", relaxed(statistics_.rasterizedGlyphs));
+    add("glyphs_missing_total", relaxed(statistics_.missingGlyphs));
+    add("timer_wakeups_total", relaxed(statistics_.timerWakeups));
+    add("idle", idle_ ? 1 : 0);
+    add("atlas_fill_ratio{atlas=\"glyphs\"}", atlas.glyphs);
+    add("atlas_fill_ratio{atlas=\"color_glyphs\"}", atlas.colorGlyphs);
+    add("atlas_fill_ratio{atlas=\"images\"}", atlas.images);
+    add("atlas_pages", atlas.pages);
+    add("input_latency_seconds{quantile=\"0.5\"}", seconds(inputLatency_.percentile(50)));
+    add("input_latency_seconds{quantile=\"0.99\"}", seconds(inputLatency_.percentile(99)));
+    for (auto const& [name, bytes] : statistics_.memoryUsage)
+    {
+        auto subsystem = string(name);
+        std::replace(subsystem.begin(), subsystem.end(), ' ', '_');
+        std::transform(subsystem.begin(), subsystem.end(), subsystem.begin(), [](char c) { return static_cast<char>(std::tolower(c)); });
+        add(fmt::format("memory_bytes{{subsystem=\"{}\"}}", subsystem), bytes);
+    }
+    return report;
+}
+
+void TerminalWidget::serveStatistics(std::optional<FileSystem::path> const& _path)
+{
+    if (!_path)
+        statisticsServer_.close();
+    else if (!statisticsServer_.listen(*_path))
+        cerr << fmt::format("Could not serve statistics at {}.\n", _path->string());
+}
+
+void TerminalWidget::startSessionRecording(FileSystem::path const& _path)
+{
+    auto& terminal = terminalView_->terminal();
+    auto recorder = terminal::SessionRecorder::create(_path.string(), terminal.screenSize(), steady_clock::now());
+    if (!recorder)
+        cerr << fmt::format("Could not create session recording {}.\n", _path.string());
+    terminal.setRecorder(move(recorder));
+}
+
+void TerminalWidget::writeSnapshot()
+{
+    if (!snapshotWriter_)
+        return;
+
+    auto const _l = scoped_lock{terminalView_->terminal()};
+    if (!snapshotWriter_->write(terminalView_->terminal().screen()))
+        cerr << fmt::format("Could not write screen snapshot {}.\n", profile().historySnapshotFile->string());
+}
+
+void TerminalWidget::dumpInputLatency()
+{
+    using std::chrono::duration;
+    using std::milli;
+
+    auto const ms = [](auto _duration) { return duration<double, milli>(_duration).count(); };
+    std::cout << fmt::format("Input latency (key press to frame swap) of {} key presses: "
+                             "p50 {:.2f} ms, p90 {:.2f} ms, p99 {:.2f} ms, max {:.2f} ms\n",
+                             inputLatency_.count(),
+                             ms(inputLatency_.percentile(50)),
+                             ms(inputLatency_.percentile(90)),
+                             ms(inputLatency_.percentile(99)),
+                             ms(inputLatency_.max()));
+}
+
 void TerminalWidget::onScreenChanged(QScreen* _screen)
 {
     // TODO: Update font size and window size based on new screen's contentScale().
     (void) _screen;
 }
 
+void TerminalWidget::createPty()
+{
+    auto const start = steady_clock::now();
+    auto shell = optional{profile().shell};
+#if defined(_MSC_VER)
+    pty_ = make_unique<terminal::ConPty>(profile().terminalSize);
+#else
+    if (config_.sessionSocketPath)
+    {
+        // The session's application runs in the daemon, whose screen is mirrored instead.
+        sessionViewer_ = terminal::SessionViewer::connect(config_.sessionSocketPath->string());
+        if (sessionViewer_)
+        {
+            pty_ = sessionViewer_->createPty(profile().terminalSize);
+            shell.reset();
+        }
+        else
+            cerr << fmt::format("Could not attach to session {}.\n", config_.sessionSocketPath->string());
+    }
+    if (!pty_)
+        pty_ = terminal::UnixPty::create(profile().terminalSize, config_.ptyReadCoalescingLatency);
+#endif
+
+    if (shell)
+        process_ = make_unique<terminal::Process>(*shell, *pty_);
+    startupTimes_.shell = steady_clock::now() - start;
+}
+
+void TerminalWidget::prebuildShaders()
+{
+    // Shader programs are built once per driver and reused across windows and processes.
+    terminal::view::ShaderCache::get().setDirectory(cacheDirectory("shaders"));
+
+    if (!QOpenGLContext::supportsThreadedOpenGL())
+        return;
+
+    // The worker's context is of the same format as the widget's, hence the binaries it puts
+    // into the cache are the ones the widget's context looks up.
+    shaderSurface_ = make_unique<QOffscreenSurface>();
+    shaderSurface_->setFormat(surfaceFormat(config_.presentMode));
+    shaderSurface_->create();
+
+    shadersBuilt_ = std::async(std::launch::async, [this]() {
+        auto const start = steady_clock::now();
+        QOpenGLContext context;
+        context.setFormat(shaderSurface_->format());
+        if (context.create() && context.makeCurrent(shaderSurface_.get()))
+        {
+            for (auto const shaderClass : {config::ShaderClass::Background, config::ShaderClass::Text, config::ShaderClass::Cursor})
+                (void) terminal::view::createShader(*config::Config::loadShaderConfig(shaderClass));
+            context.doneCurrent();
+        }
+        startupTimes_.shaders = steady_clock::now() - start;
+    });
+}
+
 void TerminalWidget::initializeGL()
 {
     initializeOpenGLFunctions();
 
+    if (auto* windowHandle = window()->windowHandle())
+        windowHandle->installEventFilter(this);
+
     // {{{ some info
     static bool infoPrinted = false;
     if (!infoPrinted)
@@ -591,12 +1051,20 @@ void TerminalWidget::initializeGL()
     glDebugMessageCallback(&glMessageCallback, this);
 #endif
 
+    startupTimes_.context = steady_clock::now() - startupTimes_.start;
+
+    // The shader programs built meanwhile are loaded from the shader cache.
+    if (shadersBuilt_.valid())
+        shadersBuilt_.get();
+    shaderSurface_.reset();
+
+    auto const viewStart = steady_clock::now();
     terminalView_ = make_unique<terminal::view::TerminalView>(
         now_,
         *this,
         profile().maxHistoryLineCount,
         config_.wordDelimiters,
-        fonts_,
+        fonts(),
         profile().cursorShape,
         profile().cursorDisplay,
         profile().cursorBlinkInterval,
@@ -604,30 +1072,75 @@ void TerminalWidget::initializeGL()
         profile().backgroundOpacity,
         profile().hyperlinkDecoration.normal,
         profile().hyperlinkDecoration.hover,
-#if defined(_MSC_VER)
-        make_unique<terminal::ConPty>(profile().terminalSize),
-#else
-        make_unique<terminal::UnixPty>(profile().terminalSize),
-#endif
-        profile().shell,
+        move(pty_),
+        move(process_),
         ortho(0.0f, static_cast<float>(width()), 0.0f, static_cast<float>(height())),
         *config::Config::loadShaderConfig(config::ShaderClass::Background),
         *config::Config::loadShaderConfig(config::ShaderClass::Text),
-        ref(logger_)
+        *config::Config::loadShaderConfig(config::ShaderClass::Cursor),
+        terminal::Logger{
+            ref(logger_),
+            [this](size_t _eventIndex) { return logger_.enabled(_eventIndex); }
+        }
     );
 
+    terminalView_->terminal().setReadBufferSize(config_.ptyReadBufferSize);
+    terminalView_->terminal().setFastForwardThreshold(config_.ptyFastForwardThreshold);
+    terminalView_->terminal().setAlternateBufferReleaseDelay(config_.alternateScreenReleaseDelay);
+    terminalView_->terminal().setMouseMotionCoalescing(profile().mouseMotionCoalescing);
+    terminalView_->terminal().setParseSliceTime(profile().parseSliceTime);
+    terminalView_->terminal().setImageDecoder(&decodeImage);
+    if (config_.sessionRecordingPath)
+        startSessionRecording(*config_.sessionRecordingPath);
+    if (config_.statisticsSocketPath)
+        serveStatistics(config_.statisticsSocketPath);
+    terminalView_->setGlyphCacheDirectory(cacheDirectory("glyphs"));
+    terminalView_->setMaxImageTextureMemory(config_.maxImageGpuMemory * 1024 * 1024);
+    terminalView_->setCursorMotionDuration(profile().cursorMotionDuration);
+    terminalView_->setDistanceFieldGlyphs(config_.distanceFieldGlyphs);
+    terminalView_->renderer().setPartialPresentation(config_.partialPresentation);
+    watchShaders();
+    startupTimes_.view = steady_clock::now() - viewStart;
+
     terminal::Screen& screen = terminalView_->terminal().screen();
 
     screen.setLogRaw((config_.loggingMask & LogMask::RawOutput) != LogMask::None);
     screen.setLogTrace((config_.loggingMask & LogMask::TraceOutput) != LogMask::None);
     screen.setTabWidth(profile().tabWidth);
+    screen.setHistorySpillThreshold(profile().historySpillThreshold);
+    screen.setHistoryPaging(profile().historyPageSize, profile().historyCachedPages);
 
     // Sixel-scrolling default is *only* loaded during startup and NOT reloading during config file
     // hot reloading, because this value may have changed manually by an application already.
     screen.setMode(terminal::Mode::SixelScrolling, config_.sixelScrolling);
     screen.setMaxImageSize(config_.maxImageSize);
     screen.setMaxImageColorRegisters(config_.maxImageColorRegisters);
+    screen.setSixelDecoderThreads(config_.sixelDecoderThreads);
+    screen.setMaxImageMemory(config_.maxImageMemory * 1024 * 1024);
     screen.setSixelCursorConformance(config_.sixelCursorConformance);
+#if defined(CONTOUR_VT_METRICS)
+    screen.setMetrics(&terminalMetrics_);
+#endif
+
+#if !defined(_MSC_VER)
+    if (sessionViewer_)
+    {
+        // The session keeps the history, hence no snapshot of its own is needed.
+        sessionViewer_->attach(terminalView_->terminal());
+        return;
+    }
+#endif
+
+    if (auto const& path = profile().historySnapshotFile; path)
+    {
+        {
+            auto const _l = scoped_lock{terminalView_->terminal()};
+            if (FileSystem::exists(*path) && !terminal::restoreSnapshot(screen, path->string()))
+                cerr << fmt::format("Could not restore screen snapshot {}.\n", path->string());
+        }
+        snapshotWriter_ = std::make_unique<terminal::SnapshotWriter>(path->string());
+        snapshotTimer_.start(SnapshotInterval);
+    }
 }
 
 void TerminalWidget::resizeGL(int _width, int _height)
@@ -659,7 +1172,15 @@ void TerminalWidget::resizeGL(int _width, int _height)
     auto const viewWidth = width() - scrollBar_->sizeHint().width();
     auto const viewHeight = height();
 
-    terminalView_->resize(viewWidth, viewHeight);
+    // While the window is being resized interactively, the current screen is shown clipped or
+    // padded to the window, and only the settled size is forwarded to the screen and the PTY,
+    // sparing the application a reflow for each of the intermediate sizes.
+    if (resizeTimer_.isActive())
+        terminalView_->resizeView(viewWidth, viewHeight);
+    else
+        terminalView_->resize(viewWidth, viewHeight);
+    resizeTimer_.start(ResizeQuietPeriod);
+
     terminalView_->setProjection(
         ortho(
             0.0f, static_cast<float>(viewWidth),      // left, right
@@ -687,36 +1208,144 @@ void TerminalWidget::paintGL()
 // #endif
 
     try {
-        STATS_INC(consecutiveRenderCount);
-        state_.store(State::CleanPainting);
-        now_ = steady_clock::now();
+        beginFrame();
+        drawFrame();
+    }
+    catch (exception const& e)
+    {
+        reportUnhandledException(__PRETTY_FUNCTION__, e);
+    }
+}
 
-        invokeQueuedCalls();
+void TerminalWidget::paintEvent(QPaintEvent* _event)
+{
+    if (!renderThread_ || !isValid())
+    {
+        QOpenGLWidget::paintEvent(_event);
+        return;
+    }
 
-        bool const reverseVideo =
-            terminalView_->terminal().screen().isModeEnabled(terminal::Mode::ReverseVideo);
+    // Unless the framebuffer already holds the frame rendered on the render thread, which is
+    // composed right after, the frame is rendered there rather than by paintGL().
+    if (!std::exchange(frameRendered_, false))
+        renderOnRenderThread();
+}
 
-        QVector4D const bg = Renderer::canonicalColor(
-            reverseVideo
-                ? profile().colors.defaultForeground
-                : profile().colors.defaultBackground,
-            profile().backgroundOpacity);
+void TerminalWidget::beginFrame()
+{
+    STATS_INC(consecutiveRenderCount);
+    state_.store(State::CleanPainting);
+    now_ = steady_clock::now();
+    lastFrame_ = now_;
 
-        if (bg != renderStateCache_.backgroundColor)
-        {
-            glClearColor(bg[0], bg[1], bg[2], bg[3]);
-            renderStateCache_.backgroundColor = bg;
-        }
+    // Frames painted on Qt's own behalf (such as when exposed) were never due.
+    if (statistics_.frameDue.has_value())
+    {
+        auto const late = now_ - *statistics_.frameDue;
+        if (auto const interval = frameInterval(); late >= interval)
+            statistics_.droppedFrames.fetch_add(static_cast<uint64_t>(late / interval), std::memory_order_relaxed);
+        statistics_.frameDue.reset();
+    }
+
+    invokeQueuedCalls();
+    updateIdleState(now_);
 
+    // Mouse motion merged since the last frame is reported once per frame.
+    terminalView_->terminal().flushMouseMotion();
+}
+
+void TerminalWidget::drawFrame()
+{
+    bool const reverseVideo =
+        terminalView_->terminal().screen().isModeEnabled(terminal::Mode::ReverseVideo);
+
+    QVector4D const bg = Renderer::canonicalColor(
+        reverseVideo
+            ? profile().colors.defaultForeground
+            : profile().colors.defaultBackground,
+        profile().backgroundOpacity);
+
+    if (bg != renderStateCache_.backgroundColor)
+    {
+        glClearColor(bg[0], bg[1], bg[2], bg[3]);
+        renderStateCache_.backgroundColor = bg;
+        terminalView_->renderer().redrawAll();
+    }
+
+    // With partial presentation, the renderer clears what it draws itself.
+    if (!config_.partialPresentation)
         glClear(GL_COLOR_BUFFER_BIT);
 
-        //terminal::view::render(terminalView_, now_);
-        STATS_SET(updatesSinceRendering) terminalView_->render(now_, renderingPressure_);
+    //terminal::view::render(terminalView_, now_);
+    auto const pressure = renderingPressure_ || terminalView_->terminal().fastForwarding();
+    STATS_SET(updatesSinceRendering) terminalView_->render(now_, pressure);
+    paintEnd_ = steady_clock::now();
+}
+
+void TerminalWidget::renderOnRenderThread()
+{
+    if (renderingOnRenderThread_ || executingActions_)
+    {
+        frameWanted_ = true;
+        return;
+    }
+
+    auto rendererLock = lockRenderer();
+    try {
+        beginFrame();
     }
     catch (exception const& e)
     {
         reportUnhandledException(__PRETTY_FUNCTION__, e);
+        return;
     }
+
+    // The context is handed over to the render thread for the frame, which hands it back after.
+    renderingOnRenderThread_ = true;
+    contextOnRenderThread_ = true;
+    doneCurrent();
+    context()->moveToThread(renderThread_.get());
+    rendererLock.unlock();
+
+    renderThread_->post([this, guiThread = thread()]() {
+        // All of it is done with the lock held, which the widget's destructor waits for.
+        auto const _l = scoped_lock{renderLock_};
+        makeCurrent();
+        try {
+            drawFrame();
+        }
+        catch (exception const& e)
+        {
+            reportUnhandledException(__PRETTY_FUNCTION__, e);
+        }
+        doneCurrent();
+        context()->moveToThread(guiThread);
+        contextOnRenderThread_ = false;
+        contextReturned_.notify_all();
+        QMetaObject::invokeMethod(this, [this]() { onFrameRendered(); }, Qt::QueuedConnection);
+    });
+}
+
+void TerminalWidget::onFrameRendered()
+{
+    renderingOnRenderThread_ = false;
+    frameRendered_ = true;
+    update();
+
+    // Paints requested by Qt meanwhile (such as on exposure) are caught up with the next frame.
+    if (std::exchange(frameWanted_, false) && setScreenDirty())
+        requestFrame();
+}
+
+std::unique_lock<std::recursive_mutex> TerminalWidget::lockRenderer()
+{
+    auto lock = std::unique_lock{renderLock_, std::defer_lock};
+    if (renderThread_)
+    {
+        lock.lock();
+        contextReturned_.wait(lock, [this]() { return !contextOnRenderThread_; });
+    }
+    return lock;
 }
 
 void TerminalWidget::invokeQueuedCalls()
@@ -780,16 +1409,51 @@ bool TerminalWidget::reloadConfigValues(config::Config _newConfig, string const&
                         _newConfig.backingFilePath.string(),
                         _profileName);
 
-    logger_ =
-        _newConfig.logFilePath
-            ? LoggingSink{_newConfig.loggingMask, _newConfig.logFilePath->string()}
-            : LoggingSink{_newConfig.loggingMask, &cout};
+    // Only the subsystems whose settings changed are touched, so that reloading an (almost)
+    // unchanged configuration neither reopens the log nor causes any GPU work.
+    if (_newConfig.logFilePath != config_.logFilePath || _newConfig.loggingMask != config_.loggingMask)
+    {
+        logger_ =
+            _newConfig.logFilePath
+                ? LoggingSink{_newConfig.loggingMask, _newConfig.logFilePath->string()}
+                : LoggingSink{_newConfig.loggingMask, &cout};
+        logger_.setTraceBufferSize(_newConfig.logTraceBufferSize);
+    }
+    else if (_newConfig.logTraceBufferSize != config_.logTraceBufferSize)
+        logger_.setTraceBufferSize(_newConfig.logTraceBufferSize);
+
+    if (_newConfig.logMemoryUsageInterval != config_.logMemoryUsageInterval)
+    {
+        if (_newConfig.logMemoryUsageInterval.count() != 0)
+            memoryLogTimer_.start(std::chrono::milliseconds(_newConfig.logMemoryUsageInterval));
+        else
+            memoryLogTimer_.stop();
+    }
 
-    terminalView_->terminal().setWordDelimiters(_newConfig.wordDelimiters);
+    if (_newConfig.distanceFieldGlyphs != config_.distanceFieldGlyphs)
+        terminalView_->setDistanceFieldGlyphs(_newConfig.distanceFieldGlyphs);
+
+    if (_newConfig.sessionRecordingPath != config_.sessionRecordingPath)
+    {
+        if (_newConfig.sessionRecordingPath)
+            startSessionRecording(*_newConfig.sessionRecordingPath);
+        else
+            terminalView_->terminal().setRecorder(nullptr);
+    }
+
+    if (_newConfig.statisticsSocketPath != config_.statisticsSocketPath)
+        serveStatistics(_newConfig.statisticsSocketPath);
+
+    if (_newConfig.wordDelimiters != config_.wordDelimiters)
+        terminalView_->terminal().setWordDelimiters(_newConfig.wordDelimiters);
 
     terminalView_->terminal().screen().setMaxImageSize(_newConfig.maxImageSize);
-    terminalView_->terminal().screen().setMaxImageColorRegisters(config_.maxImageColorRegisters);
-    terminalView_->terminal().screen().setSixelCursorConformance(config_.sixelCursorConformance);
+    terminalView_->terminal().screen().setMaxImageColorRegisters(_newConfig.maxImageColorRegisters);
+    terminalView_->terminal().screen().setSixelDecoderThreads(_newConfig.sixelDecoderThreads);
+    terminalView_->terminal().screen().setMaxImageMemory(_newConfig.maxImageMemory * 1024 * 1024);
+    if (_newConfig.maxImageGpuMemory != config_.maxImageGpuMemory)
+        terminalView_->setMaxImageTextureMemory(_newConfig.maxImageGpuMemory * 1024 * 1024);
+    terminalView_->terminal().screen().setSixelCursorConformance(_newConfig.sixelCursorConformance);
 
     terminalView_->terminal().screen().setLogRaw((_newConfig.loggingMask & LogMask::RawOutput) != LogMask::None);
     terminalView_->terminal().screen().setLogTrace((_newConfig.loggingMask & LogMask::TraceOutput) != LogMask::None);
@@ -817,26 +1481,24 @@ constexpr inline bool isModifier(Qt::Key _key)
 
 void TerminalWidget::keyPressEvent(QKeyEvent* _keyEvent)
 {
-    auto const keySeq = QKeySequence(
-        isModifier(static_cast<Qt::Key>(_keyEvent->key()))
-            ? _keyEvent->modifiers()
-            : _keyEvent->modifiers() | _keyEvent->key()
-    );
+    // Combined like a QKeySequence, without constructing one, see Config::KeyMappings.
+    auto const keyCode = isModifier(static_cast<Qt::Key>(_keyEvent->key()))
+        ? static_cast<int>(_keyEvent->modifiers())
+        : static_cast<int>(_keyEvent->modifiers()) | _keyEvent->key();
 
     // if (!_keyEvent->text().isEmpty())
     //     qDebug() << "keyPress:"
     //         << "text:" << _keyEvent->text()
-    //         << "seq:" << keySeq
-    //         << "seq.empty?" << keySeq.isEmpty()
+    //         << "keyCode:" << keyCode
     //         << "key:" << static_cast<Qt::Key>(_keyEvent->key())
-    //         << QString::fromLatin1(fmt::format("0x{:x}", keySeq[0]).c_str());
+    //         << QString::fromLatin1(fmt::format("0x{:x}", keyCode).c_str());
 
     if (!_keyEvent->text().isEmpty() && cursor().shape() != Qt::CursorShape::BlankCursor)
         setCursor(Qt::CursorShape::BlankCursor);
 
-    if (auto i = config_.keyMappings.find(keySeq); i != end(config_.keyMappings))
+    if (auto const* boundActions = config_.keyMappings->find(keyCode); boundActions != nullptr)
     {
-        executeAllActions(i->second);
+        executeAllActions(*boundActions);
     }
     else if (auto const inputEvent = mapQtToTerminalKeyEvent(_keyEvent->key(), _keyEvent->modifiers()))
     {
@@ -860,6 +1522,31 @@ void TerminalWidget::wheelEvent(QWheelEvent* _event)
     auto const button = _event->delta() > 0 ? terminal::MouseButton::WheelUp : terminal::MouseButton::WheelDown;
     auto const mouseEvent = terminal::MousePressEvent{button, makeModifier(_event->modifiers())};
 
+    // Touchpads and high-resolution wheels report the distance in pixels, which scroll the history
+    // by pixels where the wheel is bound to scrolling it, rather than by whole rows.
+    auto const scrollsHistory = [&]() {
+        auto const mapping = config_.mouseMappings.find(mouseEvent);
+        return mapping != config_.mouseMappings.end()
+            && mapping->second.size() == 1
+            && (holds_alternative<actions::ScrollUp>(mapping->second.front())
+                || holds_alternative<actions::ScrollDown>(mapping->second.front()));
+    };
+    if (!_event->pixelDelta().isNull() && scrollsHistory())
+    {
+        auto scrolled = false;
+        {
+            auto const _l = scoped_lock{terminalView_->terminal()};
+            scrolled = terminalView_->terminal().viewport().scrollPixels(_event->pixelDelta().y(),
+                                                                         terminalView_->cellHeight());
+        }
+        if (scrolled)
+        {
+            updateScrollBarValue();
+            scheduleRedraw();
+        }
+        return;
+    }
+
     executeInput(mouseEvent);
 }
 
@@ -887,8 +1574,7 @@ void TerminalWidget::mousePressEvent(QMouseEvent* _event)
     // This includes selection intiiation as well as selection clearing actions.
     if (handled)
     {
-        setScreenDirty();
-        update();
+        scheduleRedraw();
     }
 }
 
@@ -899,8 +1585,7 @@ void TerminalWidget::mouseReleaseEvent(QMouseEvent* _event)
 
     if (handled)
     {
-        setScreenDirty();
-        update();
+        scheduleRedraw();
     }
 }
 
@@ -936,8 +1621,7 @@ void TerminalWidget::mouseMoveEvent(QMouseEvent* _event)
 
     if (hyperlinkVisible || handled || terminalView_->terminal().isSelectionAvailable()) // && only if selection has changed!
     {
-        setScreenDirty();
-        update();
+        scheduleRedraw();
     }
 }
 
@@ -960,8 +1644,7 @@ void TerminalWidget::scrollToBottomAndRedraw()
     auto const dirty = terminalView_->terminal().viewport().scrollToBottom();
     if (dirty)
     {
-        setScreenDirty();
-        update();
+        scheduleRedraw();
     }
 }
 
@@ -982,8 +1665,7 @@ void TerminalWidget::focusInEvent(QFocusEvent* _event) // TODO: paint with "norm
     emit setBackgroundBlur(profile_.backgroundBlur);
 
     // force redraw because of setFocus()-change otherwise sometimes not being shown in realtime
-    setScreenDirty();
-    update();
+    scheduleRedraw();
 }
 
 void TerminalWidget::focusOutEvent(QFocusEvent* _event) // TODO maybe paint with "faint" colors
@@ -994,8 +1676,7 @@ void TerminalWidget::focusOutEvent(QFocusEvent* _event) // TODO maybe paint with
     terminalView_->terminal().send(terminal::FocusOutEvent{}, now_);
 
     // force redraw because of setFocus()-change otherwise sometimes not being shown in realtime
-    setScreenDirty();
-    update();
+    scheduleRedraw();
 }
 
 void TerminalWidget::inputMethodEvent(QInputMethodEvent* _event)
@@ -1055,9 +1736,33 @@ bool TerminalWidget::event(QEvent* _event)
     try
     {
         // qDebug() << "TerminalWidget.event():" << _event;
+        if (_event->type() == QEvent::Show || _event->type() == QEvent::Hide)
+            updateVisibility();
+
+        switch (_event->type())
+        {
+            case QEvent::KeyPress:
+            case QEvent::InputMethod:
+            case QEvent::MouseButtonPress:
+            case QEvent::MouseButtonRelease:
+            case QEvent::MouseMove:
+            case QEvent::Wheel:
+                lastActivity_ = steady_clock::now().time_since_epoch().count();
+                if (idle_)
+                {
+                    // The cursor blinks again from the next frame on.
+                    updateIdleState(steady_clock::now());
+                    scheduleRedraw();
+                }
+                break;
+            default:
+                break;
+        }
+
         if (_event->type() == QEvent::Close)
         {
-            terminalView_->process().terminate(terminal::Process::TerminationHint::Hangup);
+            if (auto* process = terminalView_->process())
+                process->terminate(terminal::Process::TerminationHint::Hangup);
 
             emit terminated(this);
         }
@@ -1071,6 +1776,15 @@ bool TerminalWidget::event(QEvent* _event)
     }
 }
 
+bool TerminalWidget::eventFilter(QObject* _object, QEvent* _event)
+{
+    // Exposure and window state changes are only seen by the window.
+    if (_event->type() == QEvent::Expose || _event->type() == QEvent::WindowStateChange)
+        updateVisibility();
+
+    return QOpenGLWidget::eventFilter(_object, _event);
+}
+
 bool TerminalWidget::fullscreen() const
 {
     return window()->isFullScreen();
@@ -1117,11 +1831,20 @@ bool TerminalWidget::setFontSize(int _fontSize)
 
 bool TerminalWidget::executeAllActions(std::vector<actions::Action> const& _actions)
 {
+    // Frames wanted meanwhile, such as while a dialog opened by an action is shown, are rendered
+    // on the render thread only afterwards, as it would wait for the renderer lock.
+    auto rendererLock = lockRenderer();
+    auto const executingActions = std::exchange(executingActions_, true);
     auto handled = false;
 
     for (actions::Action const& action : _actions)
         handled = executeAction(action) || handled;
 
+    executingActions_ = executingActions;
+    rendererLock.unlock();
+    if (!executingActions_ && std::exchange(frameWanted_, false))
+        update();
+
     return handled;
 }
 
@@ -1206,38 +1929,65 @@ bool TerminalWidget::executeAction(Action const& _action)
         [this, postScroll](actions::ScrollMarkDown) -> Result {
             return postScroll(terminalView_->terminal().viewport().scrollMarkDown());
         },
+        [this, postScroll](actions::ToggleFold) -> Result {
+            auto const _l = scoped_lock{terminalView_->terminal()};
+            return postScroll(terminalView_->terminal().viewport().toggleFold());
+        },
         [this, postScroll](actions::ScrollToTop) -> Result {
             return postScroll(terminalView_->terminal().viewport().scrollToTop());
         },
         [this, postScroll](actions::ScrollToBottom) -> Result {
             return postScroll(terminalView_->terminal().viewport().scrollToBottom());
         },
+        [this](actions::TogglePerformanceHud) -> Result {
+            performanceHud_.visible = !performanceHud_.visible;
+            if (performanceHud_.visible)
+            {
+                performanceHud_.sampleTime = steady_clock::now();
+                performanceHud_.sampleParsedBytes = terminalView_->terminal().parsedBytes();
+                performanceHud_.parsedBytesPerSecond = 0.0;
+                {
+                    auto const _l = scoped_lock{terminalView_->terminal()};
+                    performanceHud_.memoryUsage = memoryUsage();
+                }
+                updatePerformanceHud();
+            }
+            else
+                terminalView_->setOverlay({});
+            return Result::Dirty;
+        },
+        [this](actions::DumpInputLatency) -> Result {
+            dumpInputLatency();
+            return Result::Nothing;
+        },
         [this](actions::CopyPreviousMarkRange) -> Result {
             copyToClipboard(extractLastMarkRange());
             return Result::Silently;
         },
         [this](actions::CopySelection) -> Result {
-            string const text = extractSelectionText();
-            if (QClipboard* clipboard = QGuiApplication::clipboard(); clipboard != nullptr)
-                clipboard->setText(QString::fromUtf8(text.c_str(), static_cast<int>(text.size())));
+            copySelection(QClipboard::Clipboard);
             return Result::Silently;
         },
         [this](actions::PasteSelection) -> Result {
             if (QClipboard* clipboard = QGuiApplication::clipboard(); clipboard != nullptr)
             {
-                string const text = clipboard->text(QClipboard::Selection).toUtf8().toStdString();
-                terminalView_->terminal().sendPaste(string_view{text});
+                string text = clipboard->text(QClipboard::Selection).toUtf8().toStdString();
+                terminalView_->terminal().sendPaste(move(text));
             }
             return Result::Silently;
         },
         [this](actions::PasteClipboard) -> Result {
             if (QClipboard* clipboard = QGuiApplication::clipboard(); clipboard != nullptr)
             {
-                string const text = clipboard->text(QClipboard::Clipboard).toUtf8().toStdString();
-                terminalView_->terminal().sendPaste(string_view{text});
+                string text = clipboard->text(QClipboard::Clipboard).toUtf8().toStdString();
+                terminalView_->terminal().sendPaste(move(text));
             }
             return Result::Silently;
         },
+        [this](actions::CancelPaste) -> Result {
+            terminalView_->terminal().cancelPaste();
+            return Result::Silently;
+        },
         [this](actions::ChangeProfile const& v) -> Result {
             cerr << fmt::format("Changing profile to '{}'.", v.name) << endl;
             if (auto newProfile = config_.profile(v.name); newProfile)
@@ -1255,6 +2005,58 @@ bool TerminalWidget::executeAction(Action const& _action)
                 cerr << "Could not open configuration file \"" << config_.backingFilePath << "\"" << endl;
             return Result::Silently;
         },
+        [this](actions::OpenFileIntoScrollback const& v) -> Result {
+            auto path = v.path.value_or(string{});
+            if (path.empty())
+                path = QFileDialog::getOpenFileName(this, tr("Open file into scrollback")).toStdString();
+            if (path.empty())
+                return Result::Nothing;
+
+            auto file = crispy::mapped_file::open(path);
+            if (!file)
+            {
+                cerr << fmt::format("Could not open file \"{}\".", path) << endl;
+                return Result::Nothing;
+            }
+
+            // The history refers to the mapped file until it is cleared or replaced.
+            auto const mapping = make_shared<crispy::mapped_file const>(move(*file));
+            {
+                auto& terminal = terminalView_->terminal();
+                auto const _l = scoped_lock{terminal};
+                terminal.screen().openHistory(
+                    crispy::span<uint8_t const>{mapping->data(), mapping->data() + mapping->size()},
+                    mapping
+                );
+            }
+            updateScrollBarPosition();
+            return Result::Dirty;
+        },
+        [this](actions::ExportScrollback const& v) -> Result {
+            if (exportingScrollback_)
+            {
+                cerr << "The scrollback is still being exported." << endl;
+                return Result::Nothing;
+            }
+
+            auto path = v.path.value_or(string{});
+            if (path.empty())
+                path = QFileDialog::getSaveFileName(this, tr("Export scrollback")).toStdString();
+            if (path.empty())
+                return Result::Nothing;
+
+            // The lines are written from a thread of its own, locking the terminal a page at a time.
+            if (scrollbackExportThread_.joinable())
+                scrollbackExportThread_.join();
+            exportingScrollback_ = true;
+            auto const format = v.withAttributes ? terminal::ExportFormat::VT : terminal::ExportFormat::Text;
+            scrollbackExportThread_ = std::thread([this, path, format]() {
+                if (!terminalView_->terminal().exportLines(path, format))
+                    cerr << fmt::format("Could not export the scrollback to \"{}\".", path) << endl;
+                exportingScrollback_ = false;
+            });
+            return Result::Nothing;
+        },
         [](actions::OpenFileManager) -> Result {
             // TODO open file manager at current window's current working directory (via /proc/self/cwd)
             return Result::Silently;
@@ -1295,14 +2097,33 @@ bool TerminalWidget::executeAction(Action const& _action)
         },
         [this](actions::FollowHyperlink) -> Result {
             auto const _l = scoped_lock{terminalView_->terminal()};
+            auto& screen = terminalView_->terminal().screen();
             auto const currentMousePosition = terminalView_->terminal().currentMousePosition();
-            if (terminalView_->terminal().screen().contains(currentMousePosition))
+            if (screen.contains(currentMousePosition))
             {
-                if (auto hyperlink = terminalView_->terminal().screen().at(currentMousePosition).hyperlink(); hyperlink != nullptr)
+                if (auto const* hyperlink = screen.hyperlinks().get(screen.at(currentMousePosition).hyperlink()); hyperlink != nullptr)
                 {
                     followHyperlink(*hyperlink);
                     return Result::Silently;
                 }
+
+                auto const absolutePosition = terminalView_->terminal().absoluteCoordinate(currentMousePosition);
+                if (auto const link = screen.implicitHyperlinkAt(absolutePosition); link.has_value())
+                {
+                    // Detected paths without a scheme are relative to the working or home directory.
+                    auto const& hyperlink = *screen.hyperlinks().get(link->hyperlink);
+                    if (hyperlink.scheme().empty())
+                    {
+                        auto const* process = terminalView_->process();
+                        auto const path = hyperlink.uri.substr(0, 2) == "~/"
+                            ? QDir::homePath().toStdString() + hyperlink.uri.substr(1)
+                            : (process ? process->workingDirectory() : QDir::homePath().toStdString()) + "/" + hyperlink.uri;
+                        followHyperlink(terminal::HyperlinkInfo{hyperlink.id, "file://" + path});
+                    }
+                    else
+                        followHyperlink(hyperlink);
+                    return Result::Silently;
+                }
             }
             return Result::Nothing;
         }
@@ -1311,8 +2132,7 @@ bool TerminalWidget::executeAction(Action const& _action)
     switch (result)
     {
         case Result::Dirty:
-            setScreenDirty();
-            update();
+            scheduleRedraw();
             return true;
         case Result::Silently:
             return true;
@@ -1325,7 +2145,8 @@ bool TerminalWidget::executeAction(Action const& _action)
 void TerminalWidget::followHyperlink(terminal::HyperlinkInfo const& _hyperlink)
 {
     auto const fileInfo = QFileInfo(QString::fromStdString(std::string(_hyperlink.path())));
-    auto const isLocal = _hyperlink.isLocal() && _hyperlink.host() == QHostInfo::localHostName().toStdString();
+    auto const isLocal = _hyperlink.isLocal()
+                      && (_hyperlink.host().empty() || _hyperlink.host() == QHostInfo::localHostName().toStdString());
     auto const editorEnv = getenv("EDITOR");
 
     if (isLocal && fileInfo.isFile() && fileInfo.isExecutable())
@@ -1345,51 +2166,78 @@ void TerminalWidget::followHyperlink(terminal::HyperlinkInfo const& _hyperlink)
         args.append(QString::fromUtf8(_hyperlink.path().data(), static_cast<int>(_hyperlink.path().size())));
         QProcess::execute(QString::fromStdString(programPath_), args);
     }
-    else
+    else if (_hyperlink.isLocal())
         QDesktopServices::openUrl(QUrl::fromLocalFile(QString::fromUtf8(std::string(_hyperlink.path()).c_str())));
+    else
+        QDesktopServices::openUrl(QUrl(QString::fromStdString(_hyperlink.uri)));
+}
+
+int TerminalWidget::fontPixelSize(config::TerminalProfile const& _profile) const
+{
+    return static_cast<int>((static_cast<float>(_profile.fontSize) / 72.0f) * static_cast<float>(logicalDpiX()));
 }
 
 terminal::view::FontConfig TerminalWidget::loadFonts(config::TerminalProfile const& _profile)
 {
-    int const fontSize = static_cast<int>((static_cast<float>(_profile.fontSize) / 72.0f) * static_cast<float>(logicalDpiX()));
+    return loadFonts(_profile.fonts, fontPixelSize(_profile));
+}
 
-    // cout << fmt::format("TerminalWidget.loadFonts: size: {}; {} * {}\n",
-    //                     _profile.fontSize, fontSize, contentScale());
+terminal::view::FontConfig TerminalWidget::loadFonts(config::FontSpecList const& _fonts, int _fontSize)
+{
+    // cout << fmt::format("TerminalWidget.loadFonts: size: {}\n", _fontSize);
 
     // TODO: make these fonts customizable even further for the user
     return terminal::view::FontConfig{
-        fontLoader_.load(_profile.fonts.regular.pattern, fontSize),
-        fontLoader_.load(_profile.fonts.bold.pattern, fontSize),
-        fontLoader_.load(_profile.fonts.italic.pattern, fontSize),
-        fontLoader_.load(_profile.fonts.boldItalic.pattern, fontSize),
-        fontLoader_.load("emoji", fontSize)
+        fontLoader_.load(_fonts.regular.pattern, _fontSize),
+        fontLoader_.load(_fonts.bold.pattern, _fontSize),
+        fontLoader_.load(_fonts.italic.pattern, _fontSize),
+        fontLoader_.load(_fonts.boldItalic.pattern, _fontSize),
+        fontLoader_.load("emoji", _fontSize)
     };
 }
 
+terminal::view::FontConfig const& TerminalWidget::fonts() const
+{
+    if (!fonts_)
+        fonts_ = fontsLoaded_.get();
+    return *fonts_;
+}
+
 void TerminalWidget::setProfile(config::TerminalProfile newProfile)
 {
     if (newProfile.fonts != profile().fonts)
     {
         fonts_ = loadFonts(newProfile);
-        terminalView_->setFont(fonts_);
+        terminalView_->setFont(*fonts_);
     }
     else
         setFontSize(newProfile.fontSize);
 
     auto const newScreenSize = terminal::Size{
-        size().width() / fonts_.regular.first.get().maxAdvance(),
-        size().height() / fonts_.regular.first.get().lineHeight()
+        size().width() / fonts().regular.first.get().maxAdvance(),
+        size().height() / fonts().regular.first.get().lineHeight()
     };
 
     if (newScreenSize != terminalView_->terminal().screenSize())
         terminalView_->setTerminalSize(newScreenSize);
         // TODO: maybe update margin after this call?
-    terminalView_->terminal().screen().setMaxHistoryLineCount(newProfile.maxHistoryLineCount);
-
-    terminalView_->setColorProfile(newProfile.colors);
-
-    terminalView_->setHyperlinkDecoration(newProfile.hyperlinkDecoration.normal,
-                                          newProfile.hyperlinkDecoration.hover);
+    if (newProfile.maxHistoryLineCount != profile().maxHistoryLineCount)
+        terminalView_->terminal().screen().setMaxHistoryLineCount(newProfile.maxHistoryLineCount);
+    if (newProfile.historySpillThreshold != profile().historySpillThreshold)
+        terminalView_->terminal().screen().setHistorySpillThreshold(newProfile.historySpillThreshold);
+    if (newProfile.historyPageSize != profile().historyPageSize
+            || newProfile.historyCachedPages != profile().historyCachedPages)
+        terminalView_->terminal().screen().setHistoryPaging(newProfile.historyPageSize, newProfile.historyCachedPages);
+
+    // A changed color profile only needs the screen to be repainted, whereas the glyph atlas is
+    // rebuilt on font changes only.
+    if (newProfile.colors != profile().colors)
+        terminalView_->setColorProfile(newProfile.colors);
+
+    if (newProfile.hyperlinkDecoration.normal != profile().hyperlinkDecoration.normal
+            || newProfile.hyperlinkDecoration.hover != profile().hyperlinkDecoration.hover)
+        terminalView_->setHyperlinkDecoration(newProfile.hyperlinkDecoration.normal,
+                                              newProfile.hyperlinkDecoration.hover);
 
     if (newProfile.cursorShape != profile().cursorShape)
         terminalView_->setCursorShape(newProfile.cursorShape);
@@ -1397,37 +2245,44 @@ void TerminalWidget::setProfile(config::TerminalProfile newProfile)
     if (newProfile.cursorDisplay != profile().cursorDisplay)
         terminalView_->terminal().setCursorDisplay(newProfile.cursorDisplay);
 
+    terminalView_->setCursorMotionDuration(newProfile.cursorMotionDuration);
+
     if (newProfile.backgroundBlur != profile().backgroundBlur)
         emit setBackgroundBlur(newProfile.backgroundBlur);
 
     if (newProfile.tabWidth != profile().tabWidth)
         terminalView_->terminal().screen().setTabWidth(newProfile.tabWidth);
 
+    terminalView_->terminal().setMouseMotionCoalescing(newProfile.mouseMotionCoalescing);
+    terminalView_->terminal().setParseSliceTime(newProfile.parseSliceTime);
+
     updateScrollBarPosition();
 
     profile_ = std::move(newProfile);
 }
 
-string TerminalWidget::extractSelectionText()
+void TerminalWidget::copySelection(QClipboard::Mode _mode)
 {
-    using namespace terminal;
-    int lastColumn = 0;
-    string text;
-    string currentLine;
+    auto& terminal = terminalView_->terminal();
+    if (!terminal.isSelectionAvailable())
+        return;
 
-    terminalView_->terminal().renderSelection([&](Coordinate const& _pos, Cell const& _cell) {
-        if (_pos.column <= lastColumn)
-        {
-            text += currentLine;
-            text += '\n';
-            currentLine.clear();
-        }
-        currentLine += _cell.toUtf8();
-        lastColumn = _pos.column;
-    });
-    text += currentLine;
+    // The selection is copied, as it may change meanwhile. A copy still in progress is completed
+    // first, so that the clipboard ends up with the most recent selection.
+    auto selection = *terminal.selector();
+    if (selectionCopyThread_.joinable())
+        selectionCopyThread_.join();
 
-    return text;
+    selectionCopyThread_ = std::thread([this, _mode, selection = move(selection)]() {
+        auto const text = [&]() {
+            auto const _l = scoped_lock{terminalView_->terminal()};
+            return terminalView_->terminal().extractText(selection);
+        }();
+        post([_mode, text = QString::fromUtf8(text.data(), static_cast<int>(text.size()))]() {
+            if (QClipboard* clipboard = QGuiApplication::clipboard(); clipboard != nullptr)
+                clipboard->setText(text, _mode);
+        });
+    });
 }
 
 string TerminalWidget::extractLastMarkRange()
@@ -1487,12 +2342,41 @@ void TerminalWidget::onConfigReload(FileChangeWatcher::Event /*_event*/)
     post([this]() {
         if (reloadConfigValues())
         {
-            setScreenDirty();
-            update();
+            scheduleRedraw();
         }
     });
 }
 
+void TerminalWidget::watchShaders()
+{
+    using terminal::view::ShaderClass;
+
+    shaderFileChangeWatchers_.clear();
+    for (auto const shaderClass : {ShaderClass::Background, ShaderClass::Text, ShaderClass::Cursor})
+        for (auto const extension : {".vert", ".frag"})
+            if (auto path = config::findConfigFile(terminal::view::to_string(shaderClass) + extension); path.has_value())
+                shaderFileChangeWatchers_.emplace_back(make_unique<FileChangeWatcher>(
+                    move(*path),
+                    [this](FileChangeWatcher::Event event) { onShaderReload(event); }
+                ));
+}
+
+void TerminalWidget::onShaderReload(FileChangeWatcher::Event /*_event*/)
+{
+    // Shaders are built on the render thread, with the widget's OpenGL context being current.
+    post([this]() {
+        auto const reloaded = terminalView_->setShaders(
+            *config::Config::loadShaderConfig(config::ShaderClass::Background),
+            *config::Config::loadShaderConfig(config::ShaderClass::Text),
+            *config::Config::loadShaderConfig(config::ShaderClass::Cursor)
+        );
+        if (reloaded)
+            scheduleRedraw();
+        else
+            qDebug() << "Failed to reload the shaders, keeping the current ones.";
+    });
+}
+
 void TerminalWidget::post(std::function<void()> _fn)
 {
 	auto lg = lock_guard{queuedCallsLock_};
@@ -1530,11 +2414,7 @@ void TerminalWidget::setWindowTitle(std::string_view const& _title)
 
 void TerminalWidget::onSelectionComplete()
 {
-    if (QClipboard* clipboard = QGuiApplication::clipboard(); clipboard != nullptr)
-    {
-        string const text = extractSelectionText();
-        clipboard->setText(QString::fromUtf8(text.c_str(), static_cast<int>(text.size())), QClipboard::Selection);
-    }
+    copySelection(QClipboard::Selection);
 }
 
 void TerminalWidget::bufferChanged(terminal::ScreenType)
@@ -1547,11 +2427,7 @@ void TerminalWidget::bufferChanged(terminal::ScreenType)
 
 void TerminalWidget::screenUpdated()
 {
-#if defined(CONTOUR_VT_METRICS)
-    // TODO
-    // for (auto const& command : _commands)
-    //     terminalMetrics_(command);
-#endif
+    lastActivity_ = steady_clock::now().time_since_epoch().count();
 
     if (profile().autoScrollOnUpdate && terminalView_->terminal().viewport().scrolled())
         terminalView_->terminal().viewport().scrollToBottom();
@@ -1565,12 +2441,20 @@ void TerminalWidget::screenUpdated()
     {
         updateScrollBarValue();
 
-        if (setScreenDirty())
-            update(); //QCoreApplication::postEvent(this, new QEvent(QEvent::UpdateRequest));
+        // Only the first update since the last frame requests a new one, all further updates
+        // until then are shown by that frame as well. While hidden, the screen is only flagged
+        // dirty, to be rendered once shown again.
+        if (setScreenDirty() && !hidden_)
+            QMetaObject::invokeMethod(this, "requestFrame", Qt::QueuedConnection);
     }
     //);
 }
 
+void TerminalWidget::glyphsRasterized()
+{
+    post([this]() { scheduleRedraw(); });
+}
+
 void TerminalWidget::updateScrollBarValue()
 {
     if (auto const s = terminalView_->terminal().viewport().absoluteScrollOffset(); s.has_value())
@@ -1582,8 +2466,7 @@ void TerminalWidget::updateScrollBarValue()
 void TerminalWidget::onScrollBarValueChanged()
 {
     terminalView_->terminal().viewport().scrollToAbsolute(scrollBar_->value());
-    if (setScreenDirty())
-        update();
+    scheduleRedraw();
 }
 
 void TerminalWidget::updateScrollBarPosition()
@@ -1635,8 +2518,8 @@ void TerminalWidget::resizeWindow(int _width, int _height, bool _inPixels)
         if (!_height)
             _height = screenSize.height();
 
-        auto const width = _width / fonts_.regular.first.get().maxAdvance();
-        auto const height = _height / fonts_.regular.first.get().lineHeight();
+        auto const width = _width / fonts().regular.first.get().maxAdvance();
+        auto const height = _height / fonts().regular.first.get().lineHeight();
         auto const newScreenSize = terminal::Size{width, height};
         post([this, newScreenSize]() { setSize(newScreenSize); });
     }
@@ -1657,8 +2540,8 @@ QSize TerminalWidget::minimumSizeHint() const
 {
     auto constexpr MinimumScreenSize = terminal::Size{1, 1};
 
-    auto const w = MinimumScreenSize.width * fonts_.regular.first.get().maxAdvance();
-    auto const h = MinimumScreenSize.height * fonts_.regular.first.get().lineHeight();
+    auto const w = MinimumScreenSize.width * fonts().regular.first.get().maxAdvance();
+    auto const h = MinimumScreenSize.height * fonts().regular.first.get().lineHeight();
 
     return QSize(w, h);
 }
@@ -1666,8 +2549,8 @@ QSize TerminalWidget::minimumSizeHint() const
 QSize TerminalWidget::sizeHint() const
 {
     auto const scrollbarWidth = scrollBar_->isHidden() ? 0 : scrollBar_->sizeHint().width();
-    auto const viewWidth = profile().terminalSize.width * fonts_.regular.first.get().maxAdvance();
-    auto const viewHeight = profile().terminalSize.height * fonts_.regular.first.get().lineHeight();
+    auto const viewWidth = profile().terminalSize.width * fonts().regular.first.get().maxAdvance();
+    auto const viewHeight = profile().terminalSize.height * fonts().regular.first.get().lineHeight();
 
     cout << fmt::format("sizeHint: {}, SBW: {}, terminalSize: {}\n",
                         terminal::Size{viewWidth + scrollbarWidth, viewHeight},
@@ -1688,8 +2571,7 @@ void TerminalWidget::setSize(terminal::Size _size)
 
     updateGeometry();
 
-    if (setScreenDirty())
-        update();
+    scheduleRedraw();
 }
 
 void TerminalWidget::onClosed()
@@ -1699,8 +2581,7 @@ void TerminalWidget::onClosed()
     // TODO: silently quit instantly when window/terminal has been spawned already since N seconds.
     // This message should only be printed for "fast" terminal terminations.
 
-    terminalView_->waitForProcessExit();
-    terminal::Process::ExitStatus const ec = *terminalView_->process().checkStatus();
+    terminal::Process::ExitStatus const ec = terminalView_->waitForProcessExit();
     if (holds_alternative<Process::SignalExit>(ec))
         terminalView_->terminal().writeToScreen(fmt::format("\r\nShell has terminated with signal {} ({}).",
                                                             get<Process::SignalExit>(ec).signum,
@@ -1722,6 +2603,10 @@ void TerminalWidget::dumpState()
 {
     terminalView_->terminal().screen().dumpState("Dump screen state.");
     terminalView_->renderer().dumpState(std::cout);
+
+    std::cout << "Memory usage:\n";
+    for (auto const& [name, bytes] : memoryUsage())
+        std::cout << fmt::format("  {:<14}{:>12} bytes\n", name, bytes);
 }
 // }}}
 
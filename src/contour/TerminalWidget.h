@@ -16,14 +16,22 @@
 #include <contour/Actions.h>
 #include <contour/Config.h>
 #include <contour/FileChangeWatcher.h>
+#include <contour/RenderThread.h>
+#include <contour/StatisticsServer.h>
 #include <terminal/Metrics.h>
+#include <terminal/ScreenSnapshot.h>
+#include <terminal/SessionDaemon.h>
 #include <terminal_view/TerminalView.h>
 #include <terminal_view/FontConfig.h>
 
+#include <crispy/allocation_tracker.h>
+#include <crispy/latency_histogram.h>
 #include <crispy/text/FontLoader.h>
 
 #include <QtCore/QPoint>
 #include <QtCore/QTimer>
+#include <QtGui/QClipboard>
+#include <QtGui/QOffscreenSurface>
 #include <QtGui/QOpenGLExtraFunctions>
 #include <QtGui/QVector4D>
 #include <QtWidgets/QOpenGLWidget>
@@ -31,9 +39,16 @@
 #include <QtWidgets/QSystemTrayIcon>
 #include <QtWidgets/QScrollBar>
 
+#include <array>
 #include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <fstream>
+#include <future>
 #include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
 #include <vector>
 
 namespace contour {
@@ -54,11 +69,12 @@ class TerminalWidget :
 
     ~TerminalWidget() override;
 
-    static QSurfaceFormat surfaceFormat();
+    static QSurfaceFormat surfaceFormat(config::PresentMode _presentMode = config::PresentMode::Fifo);
 
     void initializeGL() override;
     void resizeGL(int _width, int _height) override;
     void paintGL() override;
+    void paintEvent(QPaintEvent* _event) override;
 
     QSize minimumSizeHint() const override;
     QSize sizeHint() const override;
@@ -76,6 +92,7 @@ class TerminalWidget :
     QVariant inputMethodQuery(Qt::InputMethodQuery _query) const override;
 
     bool event(QEvent* _event) override;
+    bool eventFilter(QObject* _object, QEvent* _event) override;
 
     /// Posts given function from terminal thread into the GUI thread.
     void post(std::function<void()> _fn);
@@ -90,6 +107,10 @@ class TerminalWidget :
 
   public Q_SLOTS:
     void onFrameSwapped();
+
+    /// Schedules a repaint, at the earliest one frame interval after the previous frame.
+    void requestFrame();
+
     void onScreenChanged(QScreen* _screen);
 
     void updateScrollBarValue();
@@ -98,6 +119,21 @@ class TerminalWidget :
 
   private:
     terminal::view::FontConfig loadFonts(config::TerminalProfile const& _profile);
+
+    /// Loads @p _fonts at @p _fontSize pixels. Safe to be called off the GUI thread.
+    terminal::view::FontConfig loadFonts(config::FontSpecList const& _fonts, int _fontSize);
+
+    int fontPixelSize(config::TerminalProfile const& _profile) const;
+
+    /// @returns the fonts, waiting for them if they are still being loaded since construction.
+    terminal::view::FontConfig const& fonts() const;
+
+    /// Creates the PTY and spawns the shell on it, see the constructor.
+    void createPty();
+
+    /// Builds the shader programs into the shader cache on a worker thread, see the constructor.
+    void prebuildShaders();
+
     bool executeAction(actions::Action const& _action);
     bool executeAllActions(std::vector<actions::Action> const& _actions);
     bool executeInput(terminal::MouseEvent const& event);
@@ -108,7 +144,10 @@ class TerminalWidget :
     void toggleFullScreen();
 
     bool setFontSize(int _fontSize);
-    std::string extractSelectionText();
+
+    /// Copies the current selection into the clipboard's @p _mode, with its text extracted on
+    /// a separate thread, such that copying huge selections does not stall the GUI.
+    void copySelection(QClipboard::Mode _mode);
     std::string extractLastMarkRange();
     void spawnNewTerminal(std::string const& _profileName);
 
@@ -123,17 +162,55 @@ class TerminalWidget :
 
     void onConfigReload(FileChangeWatcher::Event /*_event*/);
 
+    /// Watches the shaders loaded from the configuration directory, reloading them when modified.
+    void watchShaders();
+    void onShaderReload(FileChangeWatcher::Event /*_event*/);
+
     void blinkingCursorUpdate();
 
+    /// Stops or resumes rendering when the widget gets hidden or shown, or its window minimized,
+    /// unexposed (such as on another virtual desktop) or exposed again.
+    void updateVisibility();
+
+    /// Idles once neither output nor input arrived for the configured idle timeout, stopping the
+    /// cursor from blinking and suspending the periodic timers, or resumes from idling otherwise.
+    void updateIdleState(std::chrono::steady_clock::time_point _now);
+
+    /// Counts a wakeup by any of the timers, and updates the idle state.
+    void timerWakeup();
+
+    /// @returns minimum time between two frames, as limited by the display's refresh rate and
+    ///          the configured maximum frame rate.
+    std::chrono::microseconds frameInterval() const;
+
+    /// Flags the screen as dirty and requests a frame, unless already pending. GUI thread only.
+    void scheduleRedraw();
+
     void setDefaultCursor();
     void updateCursor();
 
+    /// Passes the timings of the frame just swapped, along with parser throughput and PTY backlog,
+    /// to the performance HUD, which shows them with the next frame.
+    void updatePerformanceHud();
+    void dumpInputLatency();
+
+    /// @returns the approximate number of bytes held per subsystem, with the screen locked by the caller.
+    std::vector<std::pair<std::string_view, size_t>> memoryUsage();
+    void logMemoryUsage();
+
+    /// @returns the runtime statistics served to monitoring, as lines of "name value".
+    std::string statisticsReport();
+    void serveStatistics(std::optional<FileSystem::path> const& _path);
+
   private:
     void createScrollBar();
+    void startSessionRecording(FileSystem::path const& _path);
+    void writeSnapshot();
 
     void bell() override;
     void bufferChanged(terminal::ScreenType) override;
     void screenUpdated() override;
+    void glyphsRasterized() override;
     void copyToClipboard(std::string_view const& _data) override;
     void dumpState() override;
     void notify(std::string_view const& /*_title*/, std::string_view const& /*_body*/) override;
@@ -205,6 +282,24 @@ class TerminalWidget :
     void setSize(terminal::Size _size);
     void invokeQueuedCalls();
 
+    // {{{ frames
+    /// Does the part of rendering a frame that needs the GUI thread, such as invoking posted calls.
+    void beginFrame();
+
+    /// Renders the frame into the framebuffer, with the GL context current.
+    void drawFrame();
+
+    /// Renders a frame on the render thread, or once the frame being rendered there is done.
+    void renderOnRenderThread();
+
+    /// Composes the frame rendered on the render thread. GUI thread only.
+    void onFrameRendered();
+
+    /// Locks the renderer against the frame being rendered on the render thread, waiting for the
+    /// GL context to be back on the GUI thread. Does nothing when rendering on the GUI thread.
+    std::unique_lock<std::recursive_mutex> lockRenderer();
+    // }}}
+
     config::TerminalProfile const& profile() const { return profile_; }
     config::TerminalProfile& profile() { return profile_; }
 
@@ -216,15 +311,60 @@ class TerminalWidget :
     std::string programPath_;
     LoggingSink logger_;
     crispy::text::FontLoader fontLoader_;
-    terminal::view::FontConfig fonts_;
+    mutable std::optional<terminal::view::FontConfig> fonts_;
+    mutable std::future<terminal::view::FontConfig> fontsLoaded_; // loading since construction
     std::unique_ptr<terminal::view::TerminalView> terminalView_;
     FileChangeWatcher configFileChangeWatcher_;
     std::mutex queuedCallsLock_;
     std::vector<std::function<void()>> queuedCalls_;
     std::vector<std::function<void()>> activatedCalls_;
+    std::thread selectionCopyThread_;               // extracts the text of a selection to be copied
+    std::thread scrollbackExportThread_;            // writes the scrollback into a file
+
+    // rendering on the render thread, if configured
+    std::shared_ptr<RenderThread> renderThread_;
+    std::recursive_mutex renderLock_;               // held while rendering or using the renderer
+    std::condition_variable_any contextReturned_;
+    bool contextOnRenderThread_ = false;            // guarded by renderLock_
+    bool renderingOnRenderThread_ = false;          // GUI thread only, as are the following
+    bool frameRendered_ = false;                    // framebuffer holds a frame not composed yet
+    bool frameWanted_ = false;                      // another frame was wanted while rendering
+    bool executingActions_ = false;                 // see executeAllActions()
+    std::unique_lock<std::recursive_mutex> composeLock_; // held while composing or resizing
+    std::atomic<bool> exportingScrollback_ = false;
+    std::vector<std::unique_ptr<FileChangeWatcher>> shaderFileChangeWatchers_;
     QTimer updateTimer_;                            // update() timer used to animate the blinking cursor.
+    QTimer frameTimer_;                             // update() timer used to pace frames, see requestFrame().
+    QTimer memoryLogTimer_;                         // logs the memory usage periodically, if configured
+    QTimer snapshotTimer_;                          // saves the screen snapshot periodically, if configured
+    QTimer resizeTimer_;                            // resizes the screen once the window size settled
+    std::unique_ptr<terminal::SnapshotWriter> snapshotWriter_;
+#if !defined(_MSC_VER)
+    std::unique_ptr<terminal::SessionViewer> sessionViewer_; // mirrors the session attached to, if any
+#endif
+
+    // {{{ startup, see the constructor
+    std::unique_ptr<terminal::Pty> pty_;            // handed over to the view by initializeGL()
+    std::unique_ptr<terminal::Process> process_;
+    std::unique_ptr<QOffscreenSurface> shaderSurface_;
+    std::future<void> shadersBuilt_;
+    struct {
+        std::chrono::steady_clock::time_point start{};
+        std::chrono::steady_clock::duration shell{};
+        std::chrono::steady_clock::duration fonts{};    // on a worker thread
+        std::chrono::steady_clock::duration shaders{};  // on a worker thread
+        std::chrono::steady_clock::duration context{};  // until initializeGL()
+        std::chrono::steady_clock::duration view{};
+        bool reported = false;
+    } startupTimes_;
+    // }}}
+    std::chrono::steady_clock::time_point lastFrame_; // time the most recent frame started painting
+    std::chrono::steady_clock::time_point paintEnd_;  // time the most recent frame finished painting
     std::mutex screenUpdateLock_;
     bool renderingPressure_ = false;
+    std::atomic<bool> hidden_ = false;              // nothing but parsing goes on while hidden
+    std::atomic<bool> idle_ = false;                // see updateIdleState()
+    std::atomic<std::chrono::steady_clock::rep> lastActivity_; // time of the most recent output or input
     struct Stats {
         std::atomic<uint64_t> updatesSinceRendering = 0;
         std::atomic<uint64_t> consecutiveRenderCount = 0;
@@ -234,12 +374,46 @@ class TerminalWidget :
     terminal::Metrics terminalMetrics_{};
 #endif
 
+    // performance HUD
+    struct {
+        bool visible = false;
+        std::chrono::steady_clock::time_point sampleTime{};  // start of the current parser throughput sample
+        uint64_t sampleParsedBytes = 0;                      // bytes parsed at the start of the sample
+        double parsedBytesPerSecond = 0.0;                   // parser throughput of the previous sample
+        std::vector<std::pair<std::string_view, size_t>> memoryUsage; // memory usage at the previous sample
+#if defined(CRISPY_ALLOCATION_TRACKING)
+        using AllocationCounts = std::array<uint64_t, crispy::allocation_tracker::subsystem_count>;
+        AllocationCounts sampleAllocations{};                // allocations per subsystem at the start of the sample
+        AllocationCounts frameAllocations{};                 // allocations per subsystem at the previous frame
+        std::array<double, crispy::allocation_tracker::subsystem_count> allocationsPerSecond{};
+#endif
+    } performanceHud_;
+
+    // time from a key press until the frame showing its echo has been swapped
+    crispy::latency_histogram inputLatency_{std::chrono::microseconds(250), 400};
+
+    // runtime statistics, as served by statisticsServer_
+    struct {
+        std::atomic<uint64_t> renderedFrames = 0;
+        std::atomic<uint64_t> droppedFrames = 0;        // frame intervals passed without the frame due
+        std::atomic<uint64_t> shapingCacheHits = 0;
+        std::atomic<uint64_t> shapingCacheMisses = 0;
+        std::atomic<uint64_t> rasterizedGlyphs = 0;
+        std::atomic<uint64_t> missingGlyphs = 0;
+        std::atomic<uint64_t> timerWakeups = 0;
+        std::optional<std::chrono::steady_clock::time_point> frameDue; // time the requested frame is due at
+        std::chrono::steady_clock::time_point memoryUsageTime{};       // time memoryUsage was sampled at
+        std::vector<std::pair<std::string_view, size_t>> memoryUsage;
+    } statistics_;
+
     // render state cache
     struct {
         QVector4D backgroundColor{};
     } renderStateCache_;
 
     QScrollBar* scrollBar_ = nullptr;
+
+    StatisticsServer statisticsServer_;
 };
 
 } // namespace contour
@@ -91,6 +91,7 @@ TerminalWidget* TerminalWindow::createTerminalWidget()
 
     connect(terminalWidget, SIGNAL(terminated(TerminalWidget*)), this, SLOT(onTerminalClosed(TerminalWidget*)));
     connect(terminalWidget, SIGNAL(setBackgroundBlur(bool)), this, SLOT(setBackgroundBlur(bool)));
+    connect(terminalWidget, &TerminalWidget::showNotification, this, &TerminalWindow::showNotification);
 
     return terminalWidget;
 }
@@ -61,6 +61,11 @@ class TerminalWindow :
     void onTerminalClosed(TerminalWidget* _terminalWidget);
     void setBackgroundBlur(bool _enable);
 
+  Q_SIGNALS:
+    /// Forwards the desktop notifications requested by the terminal.
+    void showNotification(QString const& _title, QString const& _content);
+
+  public Q_SLOTS:
 #if 0 // XXX if parent is QTabWidget
     void onTabChanged(int _index);
     TerminalWidget* newTab();
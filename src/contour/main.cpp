@@ -13,6 +13,7 @@
  */
 #include <contour/Config.h>
 #include <contour/Controller.h>
+#include <contour/MonoTerminalWindow.h>
 
 #include <terminal/Parser.h>
 
@@ -20,6 +21,7 @@
 #include <QtCore/QThread>
 #include <QtWidgets/QApplication>
 
+#include <chrono>
 #include <iostream>
 
 using namespace std;
@@ -33,6 +35,10 @@ namespace contour {
             addOption(configOption);
             addOption(profileOption);
             addOption(parserTable);
+            addOption(monoOption);
+#if !defined(_MSC_VER)
+            addOption(attachOption);
+#endif
             addPositionalArgument("executable", "path to executable to execute.");
         }
 
@@ -55,6 +61,17 @@ namespace contour {
             QCoreApplication::translate("main", "Dumps parser table")
         };
 
+        QCommandLineOption const monoOption{
+            QStringList() << "m" << "mono",
+            QCoreApplication::translate("main", "Runs a single terminal in a bare OpenGL window for best performance, lacking UI features as compromise.")
+        };
+
+        QCommandLineOption const attachOption{
+            QStringList() << "a" << "attach",
+            QCoreApplication::translate("main", "Attaches to the session served by contour-daemon at the given socket, instead of running a shell."),
+            QCoreApplication::translate("main", "SOCKET")
+        };
+
         QString profileName() const { return value(profileOption); }
     };
 }
@@ -67,6 +84,9 @@ int main(int argc, char* argv[])
         QCoreApplication::setOrganizationName("contour");
         QCoreApplication::setApplicationVersion(CONTOUR_VERSION_STRING);
         QCoreApplication::setAttribute(Qt::AA_EnableHighDpiScaling);
+
+        // All windows share their textures, such as the glyph atlas.
+        QCoreApplication::setAttribute(Qt::AA_ShareOpenGLContexts);
         QApplication app(argc, argv);
 
         auto cli = contour::CLI{};
@@ -87,9 +107,16 @@ int main(int argc, char* argv[])
 
         QString const configPath = cli.value(cli.configOption);
 
+#if defined(CONTOUR_PERF_STATS)
+        auto const configStart = chrono::steady_clock::now();
+#endif
         auto config =
             configPath.isEmpty() ? contour::config::loadConfig(configLogger)
                                  : contour::config::loadConfigFromFile(configPath.toStdString(), configLogger);
+#if defined(CONTOUR_PERF_STATS)
+        cout << fmt::format("Startup: configuration loaded in {} ms\n",
+                            chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - configStart).count());
+#endif
 
         string const profileName = [&]() {
             if (!cli.value(cli.profileOption).isEmpty())
@@ -131,6 +158,18 @@ int main(int argc, char* argv[])
                 shell.arguments.push_back(positionalArgs.at(i).toStdString());
         }
 
+#if !defined(_MSC_VER)
+        if (cli.isSet(cli.attachOption))
+            config.sessionSocketPath = FileSystem::path{cli.value(cli.attachOption).toStdString()};
+#endif
+
+        if (cli.isSet(cli.monoOption))
+        {
+            contour::MonoTerminalWindow window(config, profileName);
+            window.show();
+            return app.exec();
+        }
+
         contour::Controller controller(argv[0], config, profileName);
         controller.start();
 
@@ -13,16 +13,21 @@
  */
 #pragma once
 
+#include <crispy/flat_hash_map.h>
+#include <crispy/skyline_packer.h>
+
 #include <QtGui/QVector4D>
 
 #include <fmt/format.h>
 #include <iostream>
 
+#include <algorithm>
 #include <cassert>
+#include <cstdint>
 #include <functional>
 #include <iomanip> // setprecision
-#include <list>
 #include <map>
+#include <memory>
 #include <optional>
 #include <ostream>
 #include <type_traits>
@@ -40,6 +45,8 @@ struct CreateAtlas {
     unsigned height;
     unsigned depth;
     unsigned format;                // internal texture format (such as GL_R8 or GL_RGBA8 when using OpenGL)
+    unsigned levels = 1;            // number of mipmap levels, regenerated after uploads if more than one
+    bool bgra = false;              // whether textures are uploaded in BGRA order, swizzled when sampled
 };
 
 struct DestroyAtlas {
@@ -68,6 +75,7 @@ struct TextureInfo {
     float relativeWidth;            // width relative to Atlas::width_
     float relativeHeight;           // height relative to Atlas::height_
     unsigned user;                  // some user defined value, in my case, whether or not this texture is colored or monochrome
+    size_t slot = 0;                // index of this texture in its TextureAtlasAllocator, see TextureAtlasAllocator::get()
 };
 
 struct UploadTexture {
@@ -82,6 +90,8 @@ struct RenderTexture {
     int y;           // window y coordinate to render the texture to
     int z;           // window z coordinate to render the texture to
     QVector4D color;      // optional; a color being associated with this texture
+    float scale = 1.0f;   // factor the texture's target size is scaled by
+    bool distanceField = false; // whether the texture holds a signed distance field rather than coverage
 };
 
 /// Generic listener API to events from an Atlas.
@@ -104,14 +114,25 @@ class CommandListener {
     virtual void destroyAtlas(DestroyAtlas const&) = 0;
 };
 
+/// Owner of textures in a TextureAtlasAllocator, that is notified about evicted textures.
+class TextureOwner {
+  public:
+    virtual ~TextureOwner() = default;
+
+    /// Invoked right before the given texture is removed from the atlas to make room for others.
+    virtual void evicted(TextureInfo const& _info) = 0;
+};
+
 /**
  * Texture Atlas API.
  *
  * This Texture atlas stores textures with given dimension in a 3 dimensional array of atlases.
  * Thus, you may say a 4D atlas ;-)
  *
- * @param Key a comparable key (such as @c char or @c uint32_t) to use to store and access textures.
- * @param Metadata some optionally accessible metadata that is attached with each texture.
+ * Every 2D layer of the atlases, a page, is packed independently using the skyline heuristic.
+ * Pages are taken into use on demand. Once all of them are in use, the least recently used page,
+ * with no textures used in the current frame, is evicted as a whole.
+ * Textures without an owner are never evicted, and neither is the page they are on.
  */
 class TextureAtlasAllocator {
   private:
@@ -145,18 +166,20 @@ class TextureAtlasAllocator {
                           unsigned _height,
                           unsigned _format, // such as GL_R8 or GL_RGBA8
                           CommandListener& _listener,
-                          std::string _name = {})
+                          std::string _name = {},
+                          unsigned _levels = 1,
+                          bool _bgra = false)
       : instanceBaseId_{ _instanceBaseId },
         maxInstances_{ _maxInstances },
-        depth_{ _depth },
+        depth_{ std::max(_depth, 1u) },
         width_{ _width },
         height_{ _height },
         format_{ _format },
+        levels_{ std::max(_levels, 1u) },
+        bgra_{ _bgra },
         name_{ std::move(_name) },
-        commandListener_{ _listener },
-        currentInstanceId_{ instanceBaseId_ }
+        commandListener_{ _listener }
     {
-        notifyCreateAtlas();
     }
 
     TextureAtlasAllocator(TextureAtlasAllocator const&) = delete;
@@ -166,8 +189,8 @@ class TextureAtlasAllocator {
 
     ~TextureAtlasAllocator()
     {
-        for (unsigned id = instanceBaseId_; id <= currentInstanceId_; ++id)
-            commandListener_.destroyAtlas(DestroyAtlas{id, name_});
+        for (unsigned i = 0; i < instanceCount(); ++i)
+            commandListener_.destroyAtlas(DestroyAtlas{instanceBaseId_ + i, name_});
     }
 
     std::string const& name() const noexcept { return name_; }
@@ -177,30 +200,59 @@ class TextureAtlasAllocator {
     constexpr unsigned height() const noexcept { return height_; }
 
     /// @return number of internally used 3D texture atlases.
-    constexpr unsigned currentInstance() const noexcept { return currentInstanceId_; }
+    unsigned instanceCount() const noexcept { return static_cast<unsigned>((pages_.size() + depth_ - 1) / depth_); }
 
-    /// @return number of 2D text atlases in use in current 3D texture atlas.
-    constexpr unsigned currentZ() const noexcept { return currentZ_; }
+    /// @return number of 2D pages in use, across all 3D texture atlases.
+    size_t pageCount() const noexcept { return pages_.size(); }
 
-    /// @return current X offset into the current 3D texture atlas.
-    constexpr unsigned currentX() const noexcept { return currentX_; }
+    /// @return number of textures currently stored.
+    size_t size() const noexcept { return textureCount_; }
 
-    /// @return current Y offset into the current 3D texture atlas.
-    constexpr unsigned currentY() const noexcept { return currentY_; }
+    /// @return ratio of the area covered by textures to the area of all pages in use.
+    float fillRatio() const noexcept
+    {
+        if (pages_.empty())
+            return 0.0f;
 
-    constexpr unsigned maxTextureHeightInCurrentRow() const noexcept { return maxTextureHeightInCurrentRow_; }
+        auto const pageArea = static_cast<double>(width_) * static_cast<double>(height_);
+        return static_cast<float>(static_cast<double>(usedArea_) / (pageArea * static_cast<double>(pages_.size())));
+    }
+
+    /// @return number of pages evicted so far.
+    uint64_t evictedPages() const noexcept { return evictedPages_; }
+
+    /// @return number of textures evicted so far.
+    uint64_t evictedTextures() const noexcept { return evictedTextures_; }
+
+    /// Marks the beginning of a new frame, making textures used by the previous frames evictable.
+    void nextFrame() noexcept { ++frame_; }
+
+    /// Marks the given texture as being used in the current frame.
+    void touch(TextureInfo const& _info) noexcept
+    {
+        pages_[pageIndex(_info.atlas, _info.z)].lastUse = frame_;
+    }
 
+    /// Releases all textures, notifying their owners.
     void clear()
     {
-        currentInstanceId_ = instanceBaseId_;
-        currentZ_ = 0;
-        currentX_ = 0;
-        currentY_ = 0;
-        maxTextureHeightInCurrentRow_ = 0;
+        for (size_t i = 0; i < slotCount_; ++i)
+            if (auto& allocation = slot(i); allocation.has_value() && allocation->owner)
+                allocation->owner->evicted(allocation->info);
+
+        for (size_t i = 0; i < slotCount_; ++i)
+            slot(i).reset();
+        slotCount_ = 0;
+        textureCount_ = 0;
+        freeSlots_.clear();
         discarded_.clear();
+        for (Page& page : pages_)
+            page = Page{skyline_packer(width_, height_), 0, 0};
+        usedArea_ = 0;
     }
 
-    TextureInfo const& get(size_t _index) const { return *std::next(std::begin(textureInfos_), _index); }
+    /// @returns the texture stored in the given slot (see TextureInfo::slot).
+    TextureInfo const& get(size_t _slot) const { return slot(_slot)->info; }
 
     /// Inserts a new texture into the atlas.
     ///
@@ -210,6 +262,7 @@ class TextureAtlasAllocator {
     /// @param _format   data format
     /// @param _data     raw texture data to be inserted
     /// @param _user     user defined data that is supplied along with TexCoord's 4th component
+    /// @param _owner    owner to be notified when the texture gets evicted, the texture is never evicted if none
     ///
     /// @return index to the created TextureInfo or std::nullopt if failed.
     TextureInfo const* insert(unsigned _width,
@@ -218,52 +271,17 @@ class TextureAtlasAllocator {
                               unsigned _targetHeight,
                               unsigned _format,
                               Buffer&& _data,
-                              unsigned _user = 0)
+                              unsigned _user = 0,
+                              TextureOwner* _owner = nullptr)
     {
-        // check free-map first
-        if (auto i = discarded_.find(Size{_width, _height}); i != end(discarded_))
-        {
-            std::vector<Offset>& discardsForGivenSize = i->second;
-            if (!discardsForGivenSize.empty())
-            {
-                TextureInfo const& info = appendTextureInfo(_width, _height, _targetWidth, _targetHeight,
-                                                            discardsForGivenSize.back(),
-                                                            _user);
-
-                discardsForGivenSize.pop_back();
-                if (discardsForGivenSize.empty())
-                    discarded_.erase(i);
-
-                commandListener_.uploadTexture(UploadTexture{
-                    std::ref(info),
-                    std::move(_data),
-                    _format
-                });
-
-                return &info;
-            }
-        }
-
-        // fail early if to-be-inserted texture is too large to fit a single page in the whole atlas
-        if (_height > height_ || _width > width_)
-            return nullptr;
-
-        // ensure we have enough width space in current row
-        if (currentX_ + _width >= width_ && !advanceY())
-            return nullptr;
-
-        // ensure we have enoguh height space in current row
-        if (currentY_ + _height > height_ && !advanceZ())
+        auto const offset = allocate(_width, _height);
+        if (!offset.has_value())
             return nullptr;
 
         TextureInfo const& info = appendTextureInfo(_width, _height, _targetWidth, _targetHeight,
-                                                    Offset{currentInstanceId_, currentX_, currentY_, currentZ_},
-                                                    _user);
-
-        currentX_ += _width;
-
-        if (_height > maxTextureHeightInCurrentRow_)
-            maxTextureHeightInCurrentRow_ = _height;
+                                                    *offset,
+                                                    _user,
+                                                    _owner);
 
         commandListener_.uploadTexture(UploadTexture{
             std::ref(info),
@@ -276,100 +294,202 @@ class TextureAtlasAllocator {
 
     void release(TextureInfo const& _info)
     {
-        auto i = std::find_if(begin(textureInfos_),
-                              end(textureInfos_),
-                              [&](TextureInfo const& ti) -> bool {
-                                  return &ti == &_info;
-                              });
-
-        if (i != end(textureInfos_))
+        if (_info.slot < slotCount_ && slot(_info.slot).has_value() && &slot(_info.slot)->info == &_info)
         {
             std::vector<Offset>& discardsForGivenSize = discarded_[Size{_info.width, _info.height}];
             discardsForGivenSize.emplace_back(Offset{_info.atlas, _info.x, _info.y, _info.z});
-            textureInfos_.erase(i);
+            erase(_info.slot);
         }
     }
 
   private:
-    constexpr bool advanceY()
+    struct Page {
+        skyline_packer packer;
+        uint64_t lastUse;       // frame number this page was last used in
+        size_t pinned;          // number of textures without owner
+    };
+
+    struct Allocation {
+        TextureInfo info;
+        TextureOwner* owner;
+    };
+
+    /// Number of allocations per chunk of the pool.
+    static constexpr size_t ChunkSize = 256;
+
+    std::optional<Allocation>& slot(size_t _index) noexcept { return chunks_[_index / ChunkSize][_index % ChunkSize]; }
+    std::optional<Allocation> const& slot(size_t _index) const noexcept { return chunks_[_index / ChunkSize][_index % ChunkSize]; }
+
+    size_t pageIndex(unsigned _instance, unsigned _z) const noexcept
     {
-        if (currentY_ + maxTextureHeightInCurrentRow_ <= height_)
-        {
-            currentY_ += maxTextureHeightInCurrentRow_;
-            currentX_ = 0;
-            maxTextureHeightInCurrentRow_ = 0;
-            return true;
-        }
-        else
-            return advanceZ();
+        return static_cast<size_t>(_instance - instanceBaseId_) * depth_ + _z;
     }
 
-    constexpr bool advanceZ()
+    Offset offsetOf(size_t _pageIndex, skyline_packer::point _position) const noexcept
     {
-        if (currentZ_ < depth_)
+        return Offset{
+            instanceBaseId_ + static_cast<unsigned>(_pageIndex / depth_),
+            _position.x,
+            _position.y,
+            static_cast<unsigned>(_pageIndex % depth_)
+        };
+    }
+
+    std::optional<Offset> allocate(unsigned _width, unsigned _height)
+    {
+        // check free-map first
+        if (auto i = discarded_.find(Size{_width, _height}); i != end(discarded_))
         {
-            currentZ_++;
-            currentY_ = 0;
-            currentX_ = 0;
-            maxTextureHeightInCurrentRow_ = 0;
-            return true;
+            std::vector<Offset>& discardsForGivenSize = i->second;
+            auto const offset = discardsForGivenSize.back();
+            discardsForGivenSize.pop_back();
+            if (discardsForGivenSize.empty())
+                discarded_.erase(i);
+            return offset;
         }
-        else
-            return advanceInstance();
+
+        // empty textures (such as glyphs without an outline) still occupy a slot to be referred to
+        _width = std::max(_width, 1u);
+        _height = std::max(_height, 1u);
+
+        // fail early if to-be-inserted texture is too large to fit a single page in the whole atlas
+        if (_height > height_ || _width > width_)
+            return std::nullopt;
+
+        for (size_t i = 0; i < pages_.size(); ++i)
+            if (auto const position = pages_[i].packer.insert(_width, _height); position.has_value())
+                return offsetOf(i, *position);
+
+        if (pages_.size() < static_cast<size_t>(maxInstances_) * depth_)
+        {
+            if (pages_.size() % depth_ == 0)
+                notifyCreateAtlas(instanceBaseId_ + static_cast<unsigned>(pages_.size() / depth_));
+
+            pages_.emplace_back(Page{skyline_packer(width_, height_), frame_, 0});
+            return offsetOf(pages_.size() - 1, *pages_.back().packer.insert(_width, _height));
+        }
+
+        if (auto const victim = evictPage(); victim.has_value())
+            return offsetOf(*victim, *pages_[*victim].packer.insert(_width, _height));
+
+        return std::nullopt;
     }
 
-    constexpr bool advanceInstance()
+    /// Evicts the least recently used page that is not in use by the current frame.
+    ///
+    /// @returns the index of the evicted page.
+    std::optional<size_t> evictPage()
     {
-        if (currentInstanceId_ < instanceBaseId_ + maxInstances_)
+        auto victim = std::optional<size_t>{};
+        for (size_t i = 0; i < pages_.size(); ++i)
+            if (pages_[i].pinned == 0 && pages_[i].lastUse < frame_
+                    && (!victim.has_value() || pages_[i].lastUse < pages_[*victim].lastUse))
+                victim = i;
+
+        if (!victim.has_value())
+            return std::nullopt;
+
+        for (size_t i = 0; i < slotCount_; ++i)
         {
-            currentInstanceId_++;
-            currentZ_ = 0;
-            currentY_ = 0;
-            currentX_ = 0;
-            maxTextureHeightInCurrentRow_ = 0;
-
-            notifyCreateAtlas();
-            return true;
+            if (auto& allocation = slot(i); allocation.has_value() && pageIndex(allocation->info.atlas, allocation->info.z) == *victim)
+            {
+                allocation->owner->evicted(allocation->info);
+                ++evictedTextures_;
+                erase(i);
+            }
         }
-        else
-            return false;
+
+        for (auto i = begin(discarded_); i != end(discarded_);)
+        {
+            auto& offsets = i->second;
+            offsets.erase(std::remove_if(begin(offsets), end(offsets), [&](Offset const& _offset) {
+                              return pageIndex(_offset.i, _offset.z) == *victim;
+                          }),
+                          end(offsets));
+            i = offsets.empty() ? discarded_.erase(i) : std::next(i);
+        }
+
+        pages_[*victim].packer.clear();
+        pages_[*victim].lastUse = frame_;
+        ++evictedPages_;
+        return victim;
     }
 
-    void notifyCreateAtlas()
+    void erase(size_t _slot)
+    {
+        auto& allocation = slot(_slot);
+        auto& page = pages_[pageIndex(allocation->info.atlas, allocation->info.z)];
+        if (!allocation->owner)
+            --page.pinned;
+        usedArea_ -= static_cast<size_t>(allocation->info.width) * allocation->info.height;
+        allocation.reset();
+        freeSlots_.push_back(_slot);
+        --textureCount_;
+    }
+
+    void notifyCreateAtlas(unsigned _instanceId)
     {
         commandListener_.createAtlas({
-            currentInstanceId_,
+            _instanceId,
             name_,
             width_,
             height_,
             depth_,
-            format_
+            format_,
+            levels_,
+            bgra_
         });
     }
 
     TextureInfo const& appendTextureInfo(unsigned _width, unsigned _height,
                                          unsigned _targetWidth, unsigned _targetHeight,
                                          Offset _offset,
-                                         unsigned _user)
+                                         unsigned _user,
+                                         TextureOwner* _owner)
     {
-        textureInfos_.emplace_back(TextureInfo{
-            _offset.i,
-            name_,
-            _offset.x,
-            _offset.y,
-            _offset.z,
-            _width,
-            _height,
-            _targetWidth,
-            _targetHeight,
-            static_cast<float>(_offset.x) / static_cast<float>(width_),
-            static_cast<float>(_offset.y) / static_cast<float>(height_),
-            static_cast<float>(_width) / static_cast<float>(width_),
-            static_cast<float>(_height) / static_cast<float>(height_),
-            _user
+        size_t index = 0;
+        if (!freeSlots_.empty())
+        {
+            index = freeSlots_.back();
+            freeSlots_.pop_back();
+        }
+        else
+        {
+            index = slotCount_++;
+            if (index / ChunkSize == chunks_.size())
+                chunks_.emplace_back(std::make_unique<std::optional<Allocation>[]>(ChunkSize));
+        }
+
+        auto& allocation = slot(index);
+        allocation.emplace(Allocation{
+            TextureInfo{
+                _offset.i,
+                name_,
+                _offset.x,
+                _offset.y,
+                _offset.z,
+                _width,
+                _height,
+                _targetWidth,
+                _targetHeight,
+                static_cast<float>(_offset.x) / static_cast<float>(width_),
+                static_cast<float>(_offset.y) / static_cast<float>(height_),
+                static_cast<float>(_width) / static_cast<float>(width_),
+                static_cast<float>(_height) / static_cast<float>(height_),
+                _user,
+                index
+            },
+            _owner
         });
+        ++textureCount_;
 
-        return textureInfos_.back();
+        auto& page = pages_[pageIndex(_offset.i, _offset.z)];
+        page.lastUse = frame_;
+        if (!_owner)
+            ++page.pinned;
+        usedArea_ += static_cast<size_t>(_width) * _height;
+
+        return allocation->info;
     }
 
   private:
@@ -379,29 +499,44 @@ class TextureAtlasAllocator {
     unsigned const width_;              // atlas total width
     unsigned const height_;             // atlas total height
     unsigned const format_;             // internal storage format, such as GL_R8 or GL_RGBA8
+    unsigned const levels_;             // number of mipmap levels
+    bool const bgra_;                   // whether textures are uploaded in BGRA order
 
     std::string const name_;            // atlas human readable name (only for debugging)
     CommandListener& commandListener_;  // atlas event listener (used to perform allocation/modification actions)
 
-    unsigned currentInstanceId_;        // (OpenGL) texture count already in use
-    unsigned currentZ_ = 0;             // index to current atlas that is being filled
-    unsigned currentX_ = 0;             // current X-offset to start drawing to
-    unsigned currentY_ = 0;             // current Y-offset to start drawing to
-    unsigned maxTextureHeightInCurrentRow_ = 0; // current maximum height in the current row (used to increment currentY_ to get to the next row)
+    std::vector<Page> pages_;           // pages in use, in order of instance and z
+    uint64_t frame_ = 1;                // current frame number
+    size_t usedArea_ = 0;               // total area of all textures
+    uint64_t evictedPages_ = 0;
+    uint64_t evictedTextures_ = 0;
 
     std::map<Size, std::vector<Offset>> discarded_; // map of texture size to list of atlas texture offsets of regions that have been discarded and are available for reuse.
 
-    std::list<TextureInfo> textureInfos_;
+    // Allocations are pooled in chunks, such that they stay in place and are indexable by slot.
+    std::vector<std::unique_ptr<std::optional<Allocation>[]>> chunks_;
+    std::vector<size_t> freeSlots_;     // slots below slotCount_ not in use
+    size_t slotCount_ = 0;              // number of slots handed out
+    size_t textureCount_ = 0;
 };
 
+/// Texture atlas of textures identified by a key, each with some metadata attached.
+///
+/// Textures and their metadata are looked up through a single flat hash map, hence @p Key must
+/// be hashable by std::hash and comparable for equality.
 template <typename Key, typename Metadata = int>
-class MetadataTextureAtlas {
+class MetadataTextureAtlas : public TextureOwner {
   public:
     explicit MetadataTextureAtlas(TextureAtlasAllocator& _allocator) :
         atlas_{ _allocator }
     {
     }
 
+    ~MetadataTextureAtlas() override
+    {
+        clear();
+    }
+
     MetadataTextureAtlas(MetadataTextureAtlas const&) = delete;
     MetadataTextureAtlas& operator=(MetadataTextureAtlas const&) = delete;
     MetadataTextureAtlas(MetadataTextureAtlas&&) = delete; // TODO
@@ -414,26 +549,27 @@ class MetadataTextureAtlas {
     constexpr unsigned height() const noexcept { return atlas_.height(); }
 
     /// @return number of textures stored in this texture atlas.
-    constexpr size_t size() const noexcept { return allocations_.size(); }
+    size_t size() const noexcept { return entries_.size(); }
 
     /// @return boolean indicating whether or not this atlas is empty (has no textures present).
-    constexpr bool empty() const noexcept { return allocations_.size() == 0; }
+    bool empty() const noexcept { return entries_.empty(); }
 
     TextureAtlasAllocator& allocator() noexcept { return atlas_; }
     TextureAtlasAllocator const& allocator() const noexcept { return atlas_; }
 
-    /// Clears userdata, if the TextureAtlasAllocator has to be cleared too, that has to be done
-    /// explicitly.
+    /// Releases all textures of this atlas from the TextureAtlasAllocator, along with their userdata.
     void clear()
     {
-        allocations_.clear();
-        metadata_.clear();
+        entries_.for_each([&](Key const&, Entry const& _entry) { atlas_.release(*_entry.textureInfo); });
+
+        entries_.clear();
+        keys_.clear();
     }
 
     /// Tests whether given sub-texture is being present in this texture atlas.
-    constexpr bool contains(Key const& _id) const
+    bool contains(Key const& _id) const
     {
-        return allocations_.find(_id) != allocations_.end();
+        return entries_.contains(_id);
     }
 
     using DataRef = std::tuple<
@@ -462,53 +598,71 @@ class MetadataTextureAtlas {
                                   unsigned _user = 0,
                                   Metadata _metadata = {})
     {
-        assert(allocations_.find(_id) == allocations_.end());
+        assert(!entries_.contains(_id));
 
-        TextureInfo const* textureInfo = atlas_.insert(_width, _height, _targetWidth, _targetHeight, _format, std::move(_data), _user);
+        TextureInfo const* textureInfo = atlas_.insert(_width, _height, _targetWidth, _targetHeight, _format, std::move(_data), _user, this);
         if (!textureInfo)
             return std::nullopt;
 
-        allocations_.emplace(_id, textureInfo);
+        Entry const& entry = *entries_.try_emplace(_id, Entry{textureInfo, std::move(_metadata)}).first;
 
-        if constexpr (!std::is_same_v<Metadata, void>)
-            metadata_.emplace(std::pair{_id, std::move(_metadata)});
+        if (textureInfo->slot >= keys_.size())
+            keys_.resize(textureInfo->slot + 1);
+        keys_[textureInfo->slot].emplace(_id);
 
-        return get(_id);
+        return DataRef{*entry.textureInfo, entry.metadata};
     }
 
     /// Retrieves TextureInfo and Metadata tuple if available, std::nullopt otherwise.
+    ///
+    /// The texture is marked as being used in the current frame.
     [[nodiscard]] std::optional<DataRef> get(Key const& _id) const
     {
-        if (auto const i = allocations_.find(_id); i != allocations_.end())
-            return DataRef{*i->second, metadata_.at(_id)};
+        if (Entry const* entry = entries_.find(_id); entry)
+        {
+            atlas_.touch(*entry->textureInfo);
+            return DataRef{*entry->textureInfo, entry->metadata};
+        }
         else
             return std::nullopt;
     }
 
     void release(Key const& _id)
     {
-        if (auto k = metadata_.find(_id); k != metadata_.end())
-            metadata_.erase(k);
-
-        if (auto const i = allocations_.find(_id); i != allocations_.end())
+        if (Entry const* entry = entries_.find(_id); entry)
         {
-            TextureInfo const& ti = *i->second;
+            TextureInfo const& ti = *entry->textureInfo;
+            keys_[ti.slot].reset();
             atlas_.release(ti);
 
-            allocations_.erase(i);
+            entries_.erase(_id);
+        }
+    }
+
+    void evicted(TextureInfo const& _info) override
+    {
+        if (_info.slot < keys_.size() && keys_[_info.slot].has_value())
+        {
+            entries_.erase(*keys_[_info.slot]);
+            keys_[_info.slot].reset();
         }
     }
 
   private:
+    // conditionally transform void to int as I can't conditionally enable/disable this member var.
+    using MetadataStorage = std::conditional_t<std::is_same_v<Metadata, void>, int, Metadata>;
+
+    struct Entry {
+        TextureInfo const* textureInfo;
+        MetadataStorage metadata;
+    };
+
     TextureAtlasAllocator& atlas_;
 
-    std::map<Key, TextureInfo const*> allocations_ = {};
+    crispy::flat_hash_map<Key, Entry> entries_;
 
-    // conditionally transform void to int as I can't conditionally enable/disable this member var.
-    std::map<
-        Key,
-        std::conditional_t<std::is_same_v<Metadata, void>, int, Metadata>
-    > metadata_ = {};
+    // key of each of this atlas' textures, indexed by the texture's slot in the allocator
+    std::vector<std::optional<Key>> keys_;
 };
 
 } // end namespace
@@ -521,12 +675,14 @@ namespace fmt { // {{{
         template <typename FormatContext>
         auto format(crispy::atlas::CreateAtlas const& _cmd, FormatContext& ctx)
         {
-            return format_to(ctx.out(), "<atlas:{}, dim:{}x{}, depth:{}, format:{}>",
+            return format_to(ctx.out(), "<atlas:{}, dim:{}x{}, depth:{}, format:{}, levels:{}{}>",
                 _cmd.atlasName.get(),
                 _cmd.width,
                 _cmd.height,
                 _cmd.depth,
-                _cmd.format
+                _cmd.format,
+                _cmd.levels,
+                _cmd.bgra ? ", bgra" : ""
             );
         }
     };
@@ -603,11 +759,15 @@ namespace fmt { // {{{
         template <typename FormatContext>
         auto format(crispy::atlas::TextureAtlasAllocator const& _atlas, FormatContext& ctx)
         {
-            return format_to(ctx.out(), "TextureAtlasAllocator<instance: {}/{}, dim: {}x{}x{}, at: {}x{}x{}, rowHeight:{}>",
-                _atlas.currentInstance(), _atlas.maxInstances(),
+            return format_to(ctx.out(), "TextureAtlasAllocator<{}, instances: {}/{}, dim: {}x{}x{}, pages: {}, textures: {}, fill: {:.1f}%, evicted: {} pages, {} textures>",
+                _atlas.name(),
+                _atlas.instanceCount(), _atlas.maxInstances(),
                 _atlas.width(), _atlas.height(), _atlas.depth(),
-                _atlas.currentX(), _atlas.currentY(), _atlas.currentZ(),
-                _atlas.maxTextureHeightInCurrentRow()
+                _atlas.pageCount(),
+                _atlas.size(),
+                _atlas.fillRatio() * 100.0f,
+                _atlas.evictedPages(),
+                _atlas.evictedTextures()
             );
         }
     };
@@ -14,12 +14,18 @@
 #include <crispy/AtlasRenderer.h>
 #include <crispy/Atlas.h>
 #include <crispy/algorithm.h>
+#include <crispy/trace.h>
+#include <crispy/vertex_slots.h>
 
+#include <QtGui/QOpenGLContext>
 #include <QtGui/QOpenGLExtraFunctions>
 #include <QtGui/QOpenGLTexture>
 
 #include <algorithm>
+#include <chrono>
 #include <iostream>
+#include <optional>
+#include <set>
 
 using namespace std;
 using namespace std::placeholders;
@@ -28,15 +34,301 @@ using namespace std::placeholders;
 
 namespace crispy::atlas {
 
+namespace
+{
+    // Every rendered texture is one instance of a quad, made up of:
+    // <X Y Z> position, <W H> target size, <X Y W H> atlas coordinates, <I> atlas layer, <R G B A> color,
+    // and <D> whether the texture is a distance field.
+    auto constexpr InstanceSize = size_t{3 + 2 + 4 + 1 + 4 + 1};
+
+    // Number of vertices of the two triangles of a quad, whose corners the vertex shader derives from gl_VertexID.
+    auto constexpr QuadVertexCount = GLsizei{6};
+
+    /// Creates the texture of the given atlas, leaving it bound to GL_TEXTURE_2D_ARRAY.
+    GLuint createTexture(QOpenGLExtraFunctions& _gl, CreateAtlas const& _atlas)
+    {
+        GLuint textureId{};
+        _gl.glGenTextures(1, &textureId);
+        _gl.glBindTexture(GL_TEXTURE_2D_ARRAY, textureId);
+
+        auto const levels = static_cast<GLsizei>(_atlas.levels);
+        _gl.glTexStorage3D(GL_TEXTURE_2D_ARRAY, levels, _atlas.format, _atlas.width, _atlas.height, _atlas.depth);
+
+        _gl.glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        _gl.glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, levels > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+        _gl.glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, levels - 1);
+        _gl.glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+        _gl.glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        _gl.glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+        // Single channel atlases are sampled as white texels with the channel as their alpha value,
+        // such that the shader can tint every texture by multiplying with its color.
+        if (_atlas.format == GL_R8)
+        {
+            _gl.glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_SWIZZLE_R, GL_ONE);
+            _gl.glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_SWIZZLE_G, GL_ONE);
+            _gl.glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_SWIZZLE_B, GL_ONE);
+            _gl.glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_SWIZZLE_A, GL_RED);
+        }
+
+        // BGRA textures are stored as uploaded and have their channels swapped when sampled,
+        // such that they need not be converted on the CPU.
+        if (_atlas.bgra)
+        {
+            _gl.glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_SWIZZLE_R, GL_BLUE);
+            _gl.glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_SWIZZLE_B, GL_RED);
+        }
+
+        return textureId;
+    }
+
+    /// @returns number of bytes of GPU memory allocated for the texture of the given atlas.
+    size_t textureBytes(CreateAtlas const& _atlas) noexcept
+    {
+        // Drivers commonly pad three channel texels to four bytes.
+        auto const texelSize = _atlas.format == GL_R8 ? size_t{1} : size_t{4};
+        auto bytes = size_t{0};
+        for (unsigned level = 0; level < _atlas.levels; ++level)
+            bytes += size_t{std::max(_atlas.width >> level, 1u)} * std::max(_atlas.height >> level, 1u) * _atlas.depth * texelSize;
+        return bytes;
+    }
+
+    /// Writes the uploaded texture into the atlas texture currently bound to GL_TEXTURE_2D_ARRAY,
+    /// reading @p _pixels from client memory, or at that offset from the bound GL_PIXEL_UNPACK_BUFFER.
+    void writeTexture(QOpenGLExtraFunctions& _gl, UploadTexture const& _upload, void const* _pixels)
+    {
+        auto const& texture = _upload.texture.get();
+
+        auto constexpr target = GL_TEXTURE_2D_ARRAY;
+        auto constexpr levelOfDetail = 0;
+        auto constexpr depth = 1;
+        auto constexpr type = GL_UNSIGNED_BYTE;
+
+        _gl.glTexSubImage3D(target, levelOfDetail, texture.x, texture.y, texture.z, texture.width, texture.height, depth,
+                            _upload.format, type, _pixels);
+    }
+
+    void writeTexture(QOpenGLExtraFunctions& _gl, UploadTexture const& _upload)
+    {
+        writeTexture(_gl, _upload, _upload.data.data());
+    }
+
+    /// Writes the given uploads into the atlas textures @p _textureOf returns for them, skipping
+    /// those without any, and regenerates the mipmaps of those of them in @p _mipmapped.
+    ///
+    /// The data of all uploads is copied into @p _stagingBuffer (created if 0) first, from which
+    /// the driver transfers it into the textures asynchronously, instead of copying it out of
+    /// client memory within each glTexSubImage3D() call. The buffer's previous storage is
+    /// orphaned rather than waited for, in case the previous frame's transfers are pending still.
+    ///
+    /// @returns number of bytes of texture data uploaded.
+    template <typename TextureOf>
+    size_t writeTextures(QOpenGLExtraFunctions& _gl,
+                         GLuint& _stagingBuffer,
+                         std::vector<UploadTexture> const& _uploads,
+                         TextureOf const& _textureOf,
+                         std::set<GLuint> const& _mipmapped)
+    {
+        auto totalSize = size_t{0};
+        for (UploadTexture const& upload : _uploads)
+            if (_textureOf(upload).has_value())
+                totalSize += upload.data.size();
+        if (totalSize == 0)
+            return 0;
+
+        if (!_stagingBuffer)
+            _gl.glGenBuffers(1, &_stagingBuffer);
+
+        _gl.glBindBuffer(GL_PIXEL_UNPACK_BUFFER, _stagingBuffer);
+        _gl.glBufferData(GL_PIXEL_UNPACK_BUFFER, static_cast<GLsizeiptr>(totalSize), nullptr, GL_STREAM_DRAW);
+
+        auto* staging = static_cast<uint8_t*>(_gl.glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0,
+                                                                    static_cast<GLsizeiptr>(totalSize),
+                                                                    GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT));
+        auto staged = staging != nullptr;
+        if (staged)
+        {
+            auto offset = size_t{0};
+            for (UploadTexture const& upload : _uploads)
+            {
+                if (!_textureOf(upload).has_value())
+                    continue;
+                std::copy(upload.data.begin(), upload.data.end(), staging + offset);
+                offset += upload.data.size();
+            }
+
+            // The buffer's contents may have been lost meanwhile, e.g. on a display mode change.
+            staged = _gl.glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER) == GL_TRUE;
+        }
+        if (!staged)
+            _gl.glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+        auto offset = size_t{0};
+        auto written = std::set<GLuint>{};
+        for (UploadTexture const& upload : _uploads)
+        {
+            auto const textureId = _textureOf(upload);
+            if (!textureId.has_value())
+                continue;
+
+            _gl.glBindTexture(GL_TEXTURE_2D_ARRAY, *textureId);
+            if (staged)
+                writeTexture(_gl, upload, reinterpret_cast<void const*>(offset));
+            else
+                writeTexture(_gl, upload);
+            offset += upload.data.size();
+            written.insert(*textureId);
+        }
+
+        if (staged)
+            _gl.glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+        for (GLuint const textureId : written)
+        {
+            if (_mipmapped.count(textureId))
+            {
+                _gl.glBindTexture(GL_TEXTURE_2D_ARRAY, textureId);
+                _gl.glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+            }
+        }
+
+        return totalSize;
+    }
+}
+
+// {{{ SharedTextures
+SharedTextures::~SharedTextures()
+{
+    // The textures are only deleted if the share group is still alive, as they are gone along with it otherwise.
+    if (QOpenGLContext::currentContext())
+    {
+        auto* gl = QOpenGLContext::currentContext()->extraFunctions();
+        for ([[maybe_unused]] auto [_, textureId] : textures_)
+            gl->glDeleteTextures(1, &textureId);
+        if (stagingBuffer_)
+            gl->glDeleteBuffers(1, &stagingBuffer_);
+    }
+}
+
+size_t SharedTextures::execute(QOpenGLExtraFunctions& _gl)
+{
+    auto uploadedBytes = size_t{0};
+
+    for (CreateAtlas const& params : createAtlases_)
+    {
+        auto const textureId = createTexture(_gl, params);
+        textures_[params.atlas] = textureId;
+        textureSizes_[textureId] = textureBytes(params);
+        textureMemory_ += textureBytes(params);
+        if (params.levels > 1)
+            mipmappedTextures_.insert(textureId);
+    }
+
+    uploadedBytes += writeTextures(_gl, stagingBuffer_, uploadTextures_, [this](UploadTexture const& _upload) {
+        return textureId(_upload.texture.get().atlas);
+    }, mipmappedTextures_);
+
+    for (DestroyAtlas const& params : destroyAtlases_)
+    {
+        if (auto const it = textures_.find(params.atlas); it != textures_.end())
+        {
+            _gl.glDeleteTextures(1, &it->second);
+            textureMemory_ -= textureSizes_[it->second];
+            textureSizes_.erase(it->second);
+            mipmappedTextures_.erase(it->second);
+            textures_.erase(it);
+        }
+    }
+
+    createAtlases_.clear();
+    uploadTextures_.clear();
+    destroyAtlases_.clear();
+
+    return uploadedBytes;
+}
+
+optional<GLuint> SharedTextures::textureId(unsigned _atlas) const
+{
+    if (auto const it = textures_.find(_atlas); it != textures_.end())
+        return it->second;
+    return nullopt;
+}
+
+void SharedTextures::createAtlas(CreateAtlas const& _atlas)
+{
+    createAtlases_.emplace_back(_atlas);
+}
+
+void SharedTextures::uploadTexture(UploadTexture const& _texture)
+{
+    uploadTextures_.emplace_back(_texture);
+}
+
+void SharedTextures::renderTexture(RenderTexture const&)
+{
+    // Rendering is up to the renderers of each context.
+}
+
+void SharedTextures::destroyAtlas(DestroyAtlas const& _atlas)
+{
+    destroyAtlases_.emplace_back(_atlas);
+}
+// }}}
+
 struct Renderer::ExecutionScheduler : public CommandListener
 {
     std::vector<CreateAtlas> createAtlases;
     std::vector<UploadTexture> uploadTextures;
     std::vector<RenderTexture> renderTextures;
-    std::vector<GLfloat> buffer;
-    GLsizei vertexCount = 0;
     std::vector<DestroyAtlas> destroyAtlases;
 
+    // Instances are batched by the atlas (texture unit) they sample from, so that each batch
+    // can be drawn with a single texture bound, instead of selecting the texture per fragment.
+    std::vector<vertex_slots<GLfloat>> batches;
+    size_t slotCount = 0;
+    std::optional<size_t> selectedSlot;     // std::nullopt while rendering into the stream
+
+    vertex_slots<GLfloat>& batch(unsigned _atlas)
+    {
+        while (batches.size() <= _atlas)
+        {
+            auto& instances = batches.emplace_back(InstanceSize);
+            instances.resize(slotCount);
+            if (selectedSlot.has_value())
+                instances.select(*selectedSlot);
+        }
+        return batches[_atlas];
+    }
+
+    void resize(size_t _count)
+    {
+        slotCount = _count;
+        selectedSlot.reset();
+        for (auto& instances : batches)
+            instances.resize(_count);
+    }
+
+    void select(size_t _slot)
+    {
+        selectedSlot = _slot;
+        for (auto& instances : batches)
+            instances.select(_slot);
+    }
+
+    void selectStream()
+    {
+        selectedSlot.reset();
+        for (auto& instances : batches)
+            instances.select_stream();
+    }
+
+    void shift(long _count, GLfloat _offsetY)
+    {
+        selectedSlot.reset();
+        for (auto& instances : batches)
+            instances.shift(_count, 1, _offsetY);
+    }
+
     void createAtlas(CreateAtlas const& _atlas) override
     {
         createAtlases.emplace_back(_atlas);
@@ -56,8 +348,8 @@ struct Renderer::ExecutionScheduler : public CommandListener
         GLfloat const y = _render.y;
         GLfloat const z = _render.z;
       //GLfloat const w = _render.w;
-        GLfloat const r = _render.texture.get().targetWidth;
-        GLfloat const s = _render.texture.get().targetHeight;
+        GLfloat const r = static_cast<GLfloat>(_render.texture.get().targetWidth) * _render.scale;
+        GLfloat const s = static_cast<GLfloat>(_render.texture.get().targetHeight) * _render.scale;
 
         // TexCoords
         GLfloat const rx = _render.texture.get().relativeX;
@@ -65,7 +357,6 @@ struct Renderer::ExecutionScheduler : public CommandListener
         GLfloat const w = _render.texture.get().relativeWidth;
         GLfloat const h = _render.texture.get().relativeHeight;
         GLfloat const i = _render.texture.get().z;
-        GLfloat const u = _render.texture.get().user;
 
         // color
         GLfloat const cr = _render.color[0];
@@ -73,21 +364,14 @@ struct Renderer::ExecutionScheduler : public CommandListener
         GLfloat const cb = _render.color[2];
         GLfloat const ca = _render.color[3];
 
-        GLfloat const vertices[6 * 11] = {
-            // first triangle
-        // <X      Y      Z> <X       Y       I  U>  <R   G   B   A>
-            x,     y + s, z,  rx,     ry,     i, u,  cr, cg, cb, ca,
-            x,     y,     z,  rx,     ry + h, i, u,  cr, cg, cb, ca,
-            x + r, y,     z,  rx + w, ry + h, i, u,  cr, cg, cb, ca,
-
-            // second triangle
-            x,     y + s, z,  rx,     ry,     i, u,  cr, cg, cb, ca,
-            x + r, y,     z,  rx + w, ry + h, i, u,  cr, cg, cb, ca,
-            x + r, y + s, z,  rx + w, ry,     i, u,  cr, cg, cb, ca,
+        GLfloat const d = _render.distanceField ? 1.0f : 0.0f;
+
+        GLfloat const instance[InstanceSize] = {
+        // <X  Y  Z> <W  H> <X   Y   W  H> <I> <R   G   B   A> <D>
+            x, y, z,  r, s,  rx, ry, w, h,  i,  cr, cg, cb, ca, d
         };
 
-        copy(vertices, back_inserter(buffer));
-        vertexCount += 6;
+        batch(_render.texture.get().atlas).append(instance, InstanceSize);
     }
 
     void destroyAtlas(DestroyAtlas const& _atlas) override
@@ -109,8 +393,8 @@ struct Renderer::ExecutionScheduler : public CommandListener
         uploadTextures.clear();
         renderTextures.clear();
         destroyAtlases.clear();
-        buffer.clear();
-        vertexCount = 0;
+        for (auto& instances : batches)
+            instances.clear_stream();
     }
 };
 
@@ -124,35 +408,13 @@ Renderer::Renderer() :
     glGenVertexArrays(1, &vao_);
     glBindVertexArray(vao_);
 
-    auto constexpr BufferStride = (3 + 4 + 4) * sizeof(GLfloat);
-    auto constexpr VertexOffset = (void const*) 0;
-    auto const TexCoordOffset = (void const*) (3 * sizeof(GLfloat));
-    auto const ColorOffset = (void const*) (7 * sizeof(GLfloat));
-
-    glGenBuffers(1, &vbo_);
-    glBindBuffer(GL_ARRAY_BUFFER, vbo_);
-    glBufferData(GL_ARRAY_BUFFER, 0/* sizeof(GLfloat) * 6 * 11 * 200 * 100*/, nullptr, GL_STREAM_DRAW);
-
-    // 0 (vec3): vertex buffer
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, BufferStride, VertexOffset);
-    glEnableVertexAttribArray(0);
-
-    // 1 (vec3): texture coordinates buffer
-    glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, BufferStride, TexCoordOffset);
-    glEnableVertexAttribArray(1);
-
-    // 2 (vec4): color buffer
-    glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, BufferStride, ColorOffset);
-    glEnableVertexAttribArray(2);
-
-    // setup EBO
-    // glGenBuffers(1, &ebo_);
-    // glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo_);
-    // static const GLuint indices[6] = { 0, 1, 3, 1, 2, 3 };
-    // glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
-
-    // TODO: later for instanced rendering
-    //glVertexAttribDivisor(0, 1);
+    // All attributes advance per instance rather than per vertex. They are pointed at the
+    // buffer of each batch right before drawing it.
+    for (GLuint location = 0; location < 6; ++location)
+    {
+        glEnableVertexAttribArray(location);
+        glVertexAttribDivisor(location, 1);
+    }
 }
 
 Renderer::~Renderer()
@@ -161,8 +423,10 @@ Renderer::~Renderer()
         glDeleteTextures(1, &textureId);
 
     glDeleteVertexArrays(1, &vao_);
-    glDeleteBuffers(1, &vbo_);
-    //glDeleteBuffers(1, &ebo_);
+    if (stagingBuffer_)
+        glDeleteBuffers(1, &stagingBuffer_);
+    if (!vbos_.empty())
+        glDeleteBuffers(static_cast<GLsizei>(vbos_.size()), vbos_.data());
 }
 
 CommandListener& Renderer::scheduler() noexcept
@@ -204,44 +468,93 @@ bool Renderer::empty() const noexcept
 /// Executes all scheduled commands in proper order.
 void Renderer::execute()
 {
+    CRISPY_TRACE_ZONE("atlas::Renderer::execute");
+
     // std::cout << fmt::format("atlas::Renderer.execute() upload={} render={}\n",
     //     scheduler_->uploadTextures.size(),
     //     scheduler_->renderTextures.size()
     // );
 
+    auto const uploadStart = chrono::steady_clock::now();
+    drawCalls_ = 0;
+    uploadedBytes_ = 0;
+
     // potentially create new atlases
     for (CreateAtlas const& params : scheduler_->createAtlases)
         createAtlas(params);
 
     // potentially upload any new textures
-    for (UploadTexture const& params : scheduler_->uploadTextures)
-        uploadTexture(params);
-
-    // order and prepare texture geometry
-    sort(scheduler_->renderTextures.begin(),
-         scheduler_->renderTextures.end(),
-         [](RenderTexture const& a, RenderTexture const& b) { return a.texture.get().atlas < b.texture.get().atlas; });
-
-    for (RenderTexture const& params : scheduler_->renderTextures)
-        renderTexture(params);
+    uploadedBytes_ += writeTextures(*this, stagingBuffer_, scheduler_->uploadTextures, [this](UploadTexture const& _upload) {
+        auto const it = atlasMap_.find(AtlasKey{_upload.texture.get().atlasName, _upload.texture.get().atlas});
+        return it != atlasMap_.end() ? optional<GLuint>{it->second} : nullopt;
+    }, mipmappedTextures_);
+    currentTextureId_ = std::numeric_limits<GLuint>::max();
 
-    // upload vertices and render (iff there is anything to render)
-    if (!scheduler_->renderTextures.empty())
+    // Shared textures are brought up to date by whichever context draws first.
+    if (sharedTextures_)
     {
-        glBindVertexArray(vao_);
-
-        // upload buffer
-        glBindBuffer(GL_ARRAY_BUFFER, vbo_);
-        glBufferData(GL_ARRAY_BUFFER,
-                     scheduler_->buffer.size() * sizeof(GLfloat),
-                     scheduler_->buffer.data(),
-                     GL_STREAM_DRAW);
+        uploadedBytes_ += sharedTextures_->execute(*this);
+        currentTextureId_ = std::numeric_limits<GLuint>::max();
+    }
 
-        glDrawArrays(GL_TRIANGLES, 0, scheduler_->vertexCount);
+    uploadTime_ = chrono::steady_clock::now() - uploadStart;
 
-        // TODO: Instead of on glDrawArrays (and many if's in the shader for each GL_TEXTUREi),
-        //       make a loop over each GL_TEXTUREi and draw a sub range of the vertices and a
-        //       fixed GL_TEXTURE0. - will this be noticable faster?
+    // Draw each atlas' batch with its texture bound to GL_TEXTURE0. Retained instances may refer
+    // to any atlas, not just those of this frame's render commands.
+    glBindVertexArray(vao_);
+    selectTextureUnit(0);
+    for (unsigned atlas = 0; atlas < scheduler_->batches.size(); ++atlas)
+    {
+        auto& instances = scheduler_->batches[atlas];
+        if (instances.empty())
+            continue;
+
+        auto const texture = std::find_if(atlasMap_.begin(), atlasMap_.end(),
+                                          [&](auto const& _entry) { return _entry.first.atlasTexture == atlas; });
+        auto const textureId = texture != atlasMap_.end()
+            ? optional<GLuint>{texture->second}
+            : sharedTextures_ ? sharedTextures_->textureId(atlas) : nullopt;
+        if (!textureId.has_value())
+            continue;
+
+        bindTexture2DArray(*textureId);
+
+        while (vbos_.size() <= atlas)
+        {
+            GLuint vbo{};
+            glGenBuffers(1, &vbo);
+            vbos_.push_back(vbo);
+        }
+
+        // upload modified parts of the buffer only
+        glBindBuffer(GL_ARRAY_BUFFER, vbos_[atlas]);
+        instances.flush(
+            [this](size_t _size) {
+                glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(_size * sizeof(GLfloat)), nullptr, GL_DYNAMIC_DRAW);
+            },
+            [this](size_t _offset, GLfloat const* _data, size_t _count) {
+                glBufferSubData(GL_ARRAY_BUFFER,
+                                static_cast<GLintptr>(_offset * sizeof(GLfloat)),
+                                static_cast<GLsizeiptr>(_count * sizeof(GLfloat)),
+                                _data);
+                uploadedBytes_ += _count * sizeof(GLfloat);
+            }
+        );
+
+        // The stream (such as overlays) goes last, on top of the retained rows.
+        auto const slotInstanceCount = instances.slot_vertex_count();
+        if (slotInstanceCount)
+        {
+            bindInstances(0);
+            glDrawArraysInstanced(GL_TRIANGLES, 0, QuadVertexCount, static_cast<GLsizei>(slotInstanceCount));
+            ++drawCalls_;
+        }
+        if (auto const streamInstanceCount = static_cast<GLsizei>(instances.stream_vertex_count()); streamInstanceCount)
+        {
+            bindInstances(slotInstanceCount);
+            glDrawArraysInstanced(GL_TRIANGLES, 0, QuadVertexCount, streamInstanceCount);
+            ++drawCalls_;
+        }
     }
 
     // destroy any pending atlases that were meant to be destroyed
@@ -254,46 +567,70 @@ void Renderer::execute()
     currentTextureId_ = std::numeric_limits<GLuint>::max();
 }
 
-void Renderer::createAtlas(CreateAtlas const& _atlas)
+void Renderer::bindInstances(size_t _first)
 {
-    GLuint textureId{};
-    glGenTextures(1, &textureId);
-    bindTexture2DArray(textureId);
+    // Drawing a sub range of the instances requires GL_ARB_base_instance, which OpenGL ES lacks,
+    // hence the attributes are pointed at the first instance to be drawn instead.
+    auto constexpr Stride = static_cast<GLsizei>(InstanceSize * sizeof(GLfloat));
+    auto const offset = [&](size_t _component) {
+        return reinterpret_cast<void const*>((_first * InstanceSize + _component) * sizeof(GLfloat));
+    };
+
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, Stride, offset(0));  // position
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, Stride, offset(3));  // target size
+    glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, Stride, offset(5));  // atlas coordinates
+    glVertexAttribPointer(3, 1, GL_FLOAT, GL_FALSE, Stride, offset(9));  // atlas layer
+    glVertexAttribPointer(4, 4, GL_FLOAT, GL_FALSE, Stride, offset(10)); // color
+    glVertexAttribPointer(5, 1, GL_FLOAT, GL_FALSE, Stride, offset(14)); // distance field
+}
+
+void Renderer::setSlotCount(size_t _count)
+{
+    scheduler_->resize(_count);
+}
 
-    glTexStorage3D(GL_TEXTURE_2D_ARRAY, 1, _atlas.format, _atlas.width, _atlas.height, _atlas.depth);
+void Renderer::selectSlot(size_t _slot)
+{
+    scheduler_->select(_slot);
+}
 
-    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+void Renderer::selectStream()
+{
+    scheduler_->selectStream();
+}
+
+void Renderer::shiftSlots(long _count, GLfloat _offsetY)
+{
+    scheduler_->shift(_count, _offsetY);
+}
+
+void Renderer::createAtlas(CreateAtlas const& _atlas)
+{
+    GLuint const textureId = createTexture(*this, _atlas);
+    currentTextureId_ = textureId;
 
     auto const key = AtlasKey{_atlas.atlasName, _atlas.atlas};
     atlasMap_[key] = textureId;
+    textureSizes_[textureId] = textureBytes(_atlas);
+    textureMemory_ += textureBytes(_atlas);
+    if (_atlas.levels > 1)
+        mipmappedTextures_.insert(textureId);
 }
 
 void Renderer::uploadTexture(UploadTexture const& _upload)
 {
-    auto const& texture = _upload.texture.get();
     auto const key = AtlasKey{_upload.texture.get().atlasName, _upload.texture.get().atlas};
     [[maybe_unused]] auto const textureIdIter = atlasMap_.find(key);
     assert(textureIdIter != atlasMap_.end() && "Texture ID not found in atlas map!");
     auto const textureId = atlasMap_[key];
-    auto const x0 = texture.x;
-    auto const y0 = texture.y;
-    auto const z0 = texture.z;
 
     // cout << fmt::format("atlas::Renderer.uploadTexture({}): {}\n", textureId, _upload);
 
-    auto constexpr target = GL_TEXTURE_2D_ARRAY;
-    auto constexpr levelOfDetail = 0;
-    auto constexpr depth = 1;
-    auto constexpr type = GL_UNSIGNED_BYTE;
-
     bindTexture2DArray(textureId);
-
-    glTexSubImage3D(target, levelOfDetail, x0, y0, z0, texture.width, texture.height, depth,
-                    _upload.format, type, _upload.data.data());
+    writeTexture(*this, _upload);
+    if (mipmappedTextures_.count(textureId))
+        glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+    uploadedBytes_ += _upload.data.size();
 }
 
 void Renderer::renderTexture(RenderTexture const& _render)
@@ -319,6 +656,9 @@ void Renderer::destroyAtlas(DestroyAtlas const& _atlas)
         GLuint const textureId = it->second;
         atlasMap_.erase(it);
         glDeleteTextures(1, &textureId);
+        textureMemory_ -= textureSizes_[textureId];
+        textureSizes_.erase(textureId);
+        mipmappedTextures_.erase(textureId);
     }
 }
 
@@ -21,10 +21,57 @@
 
 #include <limits>
 #include <algorithm>
+#include <chrono>
+#include <map>
 #include <memory>
+#include <optional>
+#include <set>
+#include <vector>
 
 namespace crispy::atlas {
 
+/**
+ * Atlas textures shared by the renderers of all OpenGL contexts of one share group.
+ *
+ * Commands are queued until execute() is invoked by whichever renderer draws next, as texture
+ * objects can only be created and modified with a current context, but are then available to each
+ * context sharing it. Render commands are not accepted, as these are left to the renderers.
+ */
+class SharedTextures : public CommandListener {
+  public:
+    SharedTextures() = default;
+    ~SharedTextures() override;
+
+    SharedTextures(SharedTextures const&) = delete;
+    SharedTextures& operator=(SharedTextures const&) = delete;
+
+    /// Executes the queued commands with the given context's functions.
+    ///
+    /// @returns number of bytes of texture data uploaded.
+    size_t execute(QOpenGLExtraFunctions& _gl);
+
+    /// @returns the texture of the given atlas instance, or std::nullopt if not created (yet).
+    std::optional<GLuint> textureId(unsigned _atlas) const;
+
+    /// @returns number of bytes of GPU memory allocated by the textures created so far.
+    size_t textureMemory() const noexcept { return textureMemory_; }
+
+    void createAtlas(CreateAtlas const& _atlas) override;
+    void uploadTexture(UploadTexture const& _texture) override;
+    void renderTexture(RenderTexture const& _render) override;
+    void destroyAtlas(DestroyAtlas const& _atlas) override;
+
+  private:
+    std::vector<CreateAtlas> createAtlases_;
+    std::vector<UploadTexture> uploadTextures_;
+    std::vector<DestroyAtlas> destroyAtlases_;
+    std::map<unsigned, GLuint> textures_;   // maps atlas instance IDs to texture IDs
+    std::map<GLuint, size_t> textureSizes_; // bytes of GPU memory of each texture
+    std::set<GLuint> mipmappedTextures_;    // textures whose mipmaps are regenerated after uploads
+    size_t textureMemory_ = 0;
+    GLuint stagingBuffer_ = 0;              // pixel unpack buffer the uploaded textures are staged in
+};
+
 /**
  * Stateful Texture Atlas Renderer.
  *
@@ -54,6 +101,36 @@ class Renderer : public QOpenGLExtraFunctions, public CommandListener {
     /// First, schedule commands in order to prepare and fill command queue, then execute.
     void execute();
 
+    /// @returns time the most recent execute() spent creating atlases and uploading textures.
+    std::chrono::nanoseconds uploadTime() const noexcept { return uploadTime_; }
+
+    /// @returns number of draw calls issued by the most recent execute().
+    unsigned drawCalls() const noexcept { return drawCalls_; }
+
+    /// @returns number of bytes of textures and instances uploaded by the most recent execute().
+    size_t uploadedBytes() const noexcept { return uploadedBytes_; }
+
+    /// @returns number of bytes of GPU memory allocated by this renderer's own atlas textures,
+    ///          excluding the shared ones.
+    size_t textureMemory() const noexcept { return textureMemory_; }
+
+    /// Also draws textures of atlases in @p _textures, which must outlive this renderer.
+    void setSharedTextures(SharedTextures* _textures) noexcept { sharedTextures_ = _textures; }
+
+    // {{{ retained vertices
+    /// Retains the vertices of render commands across frames in @p _count slots, e.g. one per row.
+    void setSlotCount(size_t _count);
+
+    /// Routes subsequent render commands into the given slot, replacing its previous contents.
+    void selectSlot(size_t _slot);
+
+    /// Routes subsequent render commands into the stream of this frame only (the default).
+    void selectStream();
+
+    /// Moves the retained contents by @p _count slots towards the first one, translating them by @p _offsetY.
+    void shiftSlots(long _count, GLfloat _offsetY);
+    // }}}
+
     size_t size() const noexcept;
     bool empty() const noexcept;
 
@@ -66,10 +143,12 @@ class Renderer : public QOpenGLExtraFunctions, public CommandListener {
     void selectTextureUnit(unsigned _id);
     void bindTexture2DArray(GLuint _textureId);
 
+    /// Points the instance attributes at the @p _first instance of the currently bound buffer.
+    void bindInstances(size_t _first);
+
   private:
     GLuint vao_;                // Vertex Array Object, covering all buffer objects
-    GLuint vbo_;                // Buffer containing the vertex coordinates
-    GLuint ebo_;
+    std::vector<GLuint> vbos_;  // Buffers containing one instance per rendered texture, one buffer per atlas
 
     std::unique_ptr<ExecutionScheduler> scheduler_;
 
@@ -89,6 +168,14 @@ class Renderer : public QOpenGLExtraFunctions, public CommandListener {
     };
 
     std::map<AtlasKey, GLuint> atlasMap_{}; // maps atlas IDs to texture IDs
+    std::map<GLuint, size_t> textureSizes_; // bytes of GPU memory of each texture
+    std::set<GLuint> mipmappedTextures_;    // textures whose mipmaps are regenerated after uploads
+    size_t textureMemory_ = 0;
+    GLuint stagingBuffer_ = 0;              // pixel unpack buffer the uploaded textures are staged in
+    SharedTextures* sharedTextures_ = nullptr;
+    std::chrono::nanoseconds uploadTime_{};
+    unsigned drawCalls_ = 0;
+    size_t uploadedBytes_ = 0;
 
     GLuint currentActiveTexture_ = std::numeric_limits<GLuint>::max();
     GLuint currentTextureId_ = std::numeric_limits<GLuint>::max();
@@ -0,0 +1,90 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2020 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Replaces the global operator new and delete of the executable this is linked into, recording
+// each allocation with crispy::allocation_tracker, and writes the report on exit to the file named
+// by the environment variable CRISPY_ALLOCATION_REPORT, or to standard error.
+//
+// Over-aligned allocations are left to the default operators, and are not recorded.
+
+#include <crispy/allocation_tracker.h>
+
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <new>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define CRISPY_RETURN_ADDRESS() _ReturnAddress()
+#define CRISPY_NOINLINE __declspec(noinline)
+#else
+#define CRISPY_RETURN_ADDRESS() __builtin_return_address(0)
+#define CRISPY_NOINLINE __attribute__((noinline))
+#endif
+
+namespace
+{
+    void writeReport()
+    {
+        if (auto const* path = std::getenv("CRISPY_ALLOCATION_REPORT"); path && *path)
+        {
+            auto output = std::ofstream{path, std::ios::trunc};
+            crispy::allocation_tracker::report(output);
+        }
+        else
+            crispy::allocation_tracker::report(std::cerr);
+    }
+
+    struct ReportOnExit {
+        ReportOnExit() { std::atexit(&writeReport); }
+    } const reportOnExit;
+
+    inline void* allocate(std::size_t _size, void const* _callSite) noexcept
+    {
+        crispy::allocation_tracker::record(_size, _callSite);
+        return std::malloc(_size != 0 ? _size : 1);
+    }
+}
+
+CRISPY_NOINLINE void* operator new(std::size_t _size)
+{
+    if (void* p = allocate(_size, CRISPY_RETURN_ADDRESS()))
+        return p;
+    throw std::bad_alloc();
+}
+
+CRISPY_NOINLINE void* operator new[](std::size_t _size)
+{
+    if (void* p = allocate(_size, CRISPY_RETURN_ADDRESS()))
+        return p;
+    throw std::bad_alloc();
+}
+
+CRISPY_NOINLINE void* operator new(std::size_t _size, std::nothrow_t const&) noexcept
+{
+    return allocate(_size, CRISPY_RETURN_ADDRESS());
+}
+
+CRISPY_NOINLINE void* operator new[](std::size_t _size, std::nothrow_t const&) noexcept
+{
+    return allocate(_size, CRISPY_RETURN_ADDRESS());
+}
+
+void operator delete(void* _p) noexcept { std::free(_p); }
+void operator delete[](void* _p) noexcept { std::free(_p); }
+void operator delete(void* _p, std::size_t) noexcept { std::free(_p); }
+void operator delete[](void* _p, std::size_t) noexcept { std::free(_p); }
+void operator delete(void* _p, std::nothrow_t const&) noexcept { std::free(_p); }
+void operator delete[](void* _p, std::nothrow_t const&) noexcept { std::free(_p); }
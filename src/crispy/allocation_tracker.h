@@ -0,0 +1,238 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2020 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <cxxabi.h>
+#include <dlfcn.h>
+#include <cstdlib>
+#endif
+
+/// Counts heap allocations by subsystem and by call site.
+///
+/// Allocations are recorded by the global operator new replaced in allocation_hook.cpp, which is
+/// linked into executables built with CRISPY_ALLOCATION_TRACKING. The subsystem an allocation is
+/// accounted to is the one of the innermost CRISPY_ALLOCATION_SCOPE of the allocating thread.
+///
+/// Recording never allocates itself: counters and call sites live in fixed-size tables.
+namespace crispy::allocation_tracker {
+
+enum class subsystem : uint8_t {
+    other,
+    parser,
+    screen,
+    render,
+    image,
+};
+
+constexpr size_t subsystem_count = 5;
+
+constexpr std::string_view name(subsystem _subsystem) noexcept
+{
+    switch (_subsystem)
+    {
+        case subsystem::other: return "other";
+        case subsystem::parser: return "parser";
+        case subsystem::screen: return "screen";
+        case subsystem::render: return "render";
+        case subsystem::image: return "image";
+    }
+    return "?";
+}
+
+struct totals {
+    uint64_t count = 0;
+    uint64_t bytes = 0;
+};
+
+/// Allocations made from one call site, being the return address of operator new.
+struct hot_spot {
+    void const* address;
+    uint64_t count;
+    uint64_t bytes;
+};
+
+namespace detail
+{
+    struct call_site {
+        std::atomic<void const*> address{nullptr};
+        std::atomic<uint64_t> count{0};
+        std::atomic<uint64_t> bytes{0};
+    };
+
+    /// Number of distinct call sites tracked, the ones beyond are only counted by subsystem.
+    constexpr size_t call_site_capacity = 4096;
+
+    inline std::array<std::atomic<uint64_t>, subsystem_count> counts{};
+    inline std::array<std::atomic<uint64_t>, subsystem_count> bytes{};
+    inline std::array<call_site, call_site_capacity> call_sites{};
+    inline thread_local subsystem current = subsystem::other;
+}
+
+/// Accounts the allocations of the calling thread to a subsystem for as long as it lives.
+class scope {
+  public:
+    explicit scope(subsystem _subsystem) noexcept : previous_{ detail::current }
+    {
+        detail::current = _subsystem;
+    }
+
+    ~scope()
+    {
+        detail::current = previous_;
+    }
+
+    scope(scope const&) = delete;
+    scope& operator=(scope const&) = delete;
+
+  private:
+    subsystem previous_;
+};
+
+/// @returns the subsystem the calling thread's allocations are accounted to.
+inline subsystem current() noexcept { return detail::current; }
+
+/// Records an allocation of @p _bytes made from @p _callSite, as invoked by the allocation hook.
+inline void record(size_t _bytes, void const* _callSite) noexcept
+{
+    auto const index = static_cast<size_t>(detail::current);
+    detail::counts[index].fetch_add(1, std::memory_order_relaxed);
+    detail::bytes[index].fetch_add(_bytes, std::memory_order_relaxed);
+
+    // Open addressing with a short linear probe, claiming empty slots with a compare-and-swap.
+    auto const hash = (reinterpret_cast<uintptr_t>(_callSite) >> 4) * 0x9E3779B97F4A7C15ull;
+    for (size_t probe = 0; probe < 16; ++probe)
+    {
+        auto& slot = detail::call_sites[(hash + probe) % detail::call_site_capacity];
+        void const* address = slot.address.load(std::memory_order_acquire);
+        if (address == nullptr
+                && slot.address.compare_exchange_strong(address, _callSite, std::memory_order_acq_rel))
+            address = _callSite;
+        if (address == _callSite)
+        {
+            slot.count.fetch_add(1, std::memory_order_relaxed);
+            slot.bytes.fetch_add(_bytes, std::memory_order_relaxed);
+            return;
+        }
+    }
+}
+
+/// @returns the allocations accounted to @p _subsystem so far.
+inline totals total(subsystem _subsystem) noexcept
+{
+    auto const index = static_cast<size_t>(_subsystem);
+    return totals{
+        detail::counts[index].load(std::memory_order_relaxed),
+        detail::bytes[index].load(std::memory_order_relaxed)
+    };
+}
+
+/// @returns the allocations of all subsystems so far.
+inline totals total() noexcept
+{
+    auto sum = totals{};
+    for (size_t i = 0; i < subsystem_count; ++i)
+    {
+        auto const t = total(static_cast<subsystem>(i));
+        sum.count += t.count;
+        sum.bytes += t.bytes;
+    }
+    return sum;
+}
+
+/// @returns up to @p _limit call sites with the most allocations, most first.
+inline std::vector<hot_spot> hot_spots(size_t _limit)
+{
+    std::vector<hot_spot> spots;
+    for (auto const& slot : detail::call_sites)
+        if (void const* address = slot.address.load(std::memory_order_acquire); address != nullptr)
+            spots.emplace_back(hot_spot{address,
+                                        slot.count.load(std::memory_order_relaxed),
+                                        slot.bytes.load(std::memory_order_relaxed)});
+
+    std::sort(spots.begin(), spots.end(), [](auto const& a, auto const& b) { return a.count > b.count; });
+    if (spots.size() > _limit)
+        spots.resize(_limit);
+    return spots;
+}
+
+/// @returns the module and offset of @p _address, to be passed to addr2line, along with the
+///          name of the function it is in, as far as the dynamic symbol table knows it.
+inline std::string symbolize(void const* _address)
+{
+    char buffer[64];
+    std::snprintf(buffer, sizeof(buffer), "%p", _address);
+    auto result = std::string(buffer);
+
+#if defined(__unix__) || defined(__APPLE__)
+    Dl_info info{};
+    if (dladdr(_address, &info) == 0 || !info.dli_fname)
+        return result;
+
+    std::snprintf(buffer, sizeof(buffer), "+0x%zx",
+                  static_cast<size_t>(static_cast<char const*>(_address) - static_cast<char const*>(info.dli_fbase)));
+    result = std::string(info.dli_fname) + buffer;
+
+    if (info.dli_sname)
+    {
+        int status = 0;
+        char* demangled = abi::__cxa_demangle(info.dli_sname, nullptr, nullptr, &status);
+        result += ' ';
+        result += status == 0 && demangled ? demangled : info.dli_sname;
+        std::free(demangled);
+    }
+#endif
+
+    return result;
+}
+
+/// Writes the allocations per subsystem and the @p _limit hottest call sites.
+inline void report(std::ostream& _output, size_t _limit = 50)
+{
+    _output << "Allocations per subsystem\n\n";
+    for (size_t i = 0; i < subsystem_count; ++i)
+    {
+        auto const t = total(static_cast<subsystem>(i));
+        _output << "  " << name(static_cast<subsystem>(i)) << ": " << t.count << " allocations, " << t.bytes << " bytes\n";
+    }
+
+    _output << "\nAllocations per call site\n\n";
+    for (hot_spot const& spot : hot_spots(_limit))
+        _output << "  " << spot.count << " allocations, " << spot.bytes << " bytes: " << symbolize(spot.address) << '\n';
+}
+
+} // end namespace
+
+#define CRISPY_ALLOCATION_CONCAT_(a, b) a ## b
+#define CRISPY_ALLOCATION_CONCAT(a, b) CRISPY_ALLOCATION_CONCAT_(a, b)
+
+/// Accounts the allocations of the enclosing scope to the given subsystem (such as parser),
+/// if built with CRISPY_ALLOCATION_TRACKING defined, and compiles to nothing otherwise.
+#if defined(CRISPY_ALLOCATION_TRACKING)
+#define CRISPY_ALLOCATION_SCOPE(name) \
+    ::crispy::allocation_tracker::scope const CRISPY_ALLOCATION_CONCAT(crispyAllocationScope_, __COUNTER__){ \
+        ::crispy::allocation_tracker::subsystem::name}
+#else
+#define CRISPY_ALLOCATION_SCOPE(name) do {} while (0)
+#endif
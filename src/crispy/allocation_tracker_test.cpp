@@ -0,0 +1,59 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2020 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <crispy/allocation_tracker.h>
+
+#include <catch2/catch.hpp>
+
+#include <thread>
+
+using namespace crispy::allocation_tracker;
+
+TEST_CASE("allocation_tracker.scope")
+{
+    CHECK(current() == subsystem::other);
+    {
+        auto const parser = scope{subsystem::parser};
+        CHECK(current() == subsystem::parser);
+        {
+            auto const screen = scope{subsystem::screen};
+            CHECK(current() == subsystem::screen);
+        }
+        CHECK(current() == subsystem::parser);
+
+        // Scopes are per thread.
+        auto worker = std::thread{[]() { CHECK(current() == subsystem::other); }};
+        worker.join();
+    }
+    CHECK(current() == subsystem::other);
+}
+
+TEST_CASE("allocation_tracker.record")
+{
+    static int const callSite = 0;
+    auto const before = total(subsystem::image);
+    {
+        auto const image = scope{subsystem::image};
+        record(100, &callSite);
+        record(28, &callSite);
+    }
+    auto const after = total(subsystem::image);
+    CHECK(after.count - before.count == 2);
+    CHECK(after.bytes - before.bytes == 128);
+
+    auto const spots = hot_spots(detail::call_site_capacity);
+    auto const spot = std::find_if(spots.begin(), spots.end(), [](auto const& s) { return s.address == &callSite; });
+    REQUIRE(spot != spots.end());
+    CHECK(spot->count == 2);
+    CHECK(spot->bytes == 128);
+}
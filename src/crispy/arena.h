@@ -0,0 +1,130 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2020 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+namespace crispy {
+
+/// Monotonic allocator for data living no longer than one cycle, such as a frame.
+///
+/// Allocating bumps an offset into the current block, and reset() releases everything allocated
+/// at once. Blocks are kept for the next cycle. If a cycle has needed more than one block, they
+/// are replaced by a single block of their total size, so that cycles needing no more memory
+/// than a previous one do not allocate at all.
+///
+/// Only trivially destructible objects may be allocated, as nothing is destroyed.
+class arena {
+  public:
+    explicit arena(size_t _blockSize = 64 * 1024) : blockSize_{_blockSize} {}
+
+    arena(arena const&) = delete;
+    arena& operator=(arena const&) = delete;
+
+    /// @returns uninitialized memory for @p _count objects of type T.
+    template <typename T>
+    T* allocate(size_t _count)
+    {
+        static_assert(std::is_trivially_destructible_v<T>);
+        return static_cast<T*>(allocate_bytes(_count * sizeof(T), alignof(T)));
+    }
+
+    /// @returns a copy of the @p _count objects at @p _data.
+    template <typename T>
+    T* copy(T const* _data, size_t _count)
+    {
+        auto* result = allocate<T>(_count);
+        std::copy_n(_data, _count, result);
+        return result;
+    }
+
+    template <typename Char>
+    std::basic_string_view<Char> copy(std::basic_string_view<Char> _text)
+    {
+        return std::basic_string_view<Char>(copy(_text.data(), _text.size()), _text.size());
+    }
+
+    /// Releases everything allocated, keeping the memory for the next cycle.
+    void reset()
+    {
+        if (blocks_.size() > 1)
+        {
+            auto total = size_t{0};
+            for (block const& b : blocks_)
+                total += b.size;
+            blocks_.clear();
+            blocks_.emplace_back(block{std::make_unique<std::byte[]>(total), total});
+        }
+        current_ = 0;
+        offset_ = 0;
+        used_ = 0;
+    }
+
+    /// @returns number of bytes allocated since the last reset().
+    size_t used() const noexcept { return used_; }
+
+    /// @returns number of bytes of all blocks.
+    size_t capacity() const noexcept
+    {
+        auto total = size_t{0};
+        for (block const& b : blocks_)
+            total += b.size;
+        return total;
+    }
+
+  private:
+    struct block {
+        std::unique_ptr<std::byte[]> data;
+        size_t size;
+    };
+
+    void* allocate_bytes(size_t _size, size_t _alignment)
+    {
+        for (; current_ < blocks_.size(); ++current_, offset_ = 0)
+        {
+            auto const address = reinterpret_cast<uintptr_t>(blocks_[current_].data.get()) + offset_;
+            auto const padding = (_alignment - address % _alignment) % _alignment;
+            if (offset_ + padding + _size <= blocks_[current_].size)
+            {
+                offset_ += padding;
+                auto* result = blocks_[current_].data.get() + offset_;
+                offset_ += _size;
+                used_ += _size;
+                return result;
+            }
+        }
+
+        // Blocks are allocated with the alignment of operator new, at least that of any scalar.
+        auto const size = std::max(blockSize_, _size);
+        blocks_.emplace_back(block{std::make_unique<std::byte[]>(size), size});
+        current_ = blocks_.size() - 1;
+        offset_ = _size;
+        used_ += _size;
+        return blocks_.back().data.get();
+    }
+
+    size_t blockSize_;
+    std::vector<block> blocks_;
+    size_t current_ = 0;    // index of the block allocated from
+    size_t offset_ = 0;     // number of bytes used of the current block
+    size_t used_ = 0;
+};
+
+} // end namespace
@@ -0,0 +1,61 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2020 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <crispy/arena.h>
+
+#include <catch2/catch.hpp>
+
+#include <cstdint>
+#include <string_view>
+
+using namespace std;
+
+TEST_CASE("arena.allocate")
+{
+    auto arena = crispy::arena(64);
+
+    auto* c = arena.allocate<char>(3);
+    auto* d = arena.allocate<double>(2);
+    CHECK(reinterpret_cast<uintptr_t>(d) % alignof(double) == 0);
+    CHECK(static_cast<void*>(c) != static_cast<void*>(d));
+    CHECK(arena.used() == 3 + 2 * sizeof(double));
+
+    auto const text = arena.copy(u32string_view(U"hello"));
+    CHECK(text == U"hello");
+
+    // Larger than a block.
+    auto* large = arena.allocate<int>(100);
+    large[99] = 42;
+    CHECK(arena.capacity() >= 100 * sizeof(int));
+}
+
+TEST_CASE("arena.reset_keeps_memory")
+{
+    auto arena = crispy::arena(64);
+    for (int i = 0; i < 10; ++i)
+        arena.allocate<uint64_t>(6);
+    auto const capacity = arena.capacity();
+    CHECK(capacity >= 10 * 6 * sizeof(uint64_t));
+
+    // The same cycle fits into the single block replacing the previous ones.
+    arena.reset();
+    CHECK(arena.used() == 0);
+    CHECK(arena.capacity() == capacity);
+    auto* first = arena.allocate<uint64_t>(6);
+    for (int i = 1; i < 10; ++i)
+        arena.allocate<uint64_t>(6);
+    CHECK(arena.capacity() == capacity);
+
+    arena.reset();
+    CHECK(arena.allocate<uint64_t>(6) == first);
+}
@@ -13,9 +13,18 @@
  */
 #pragma once
 
+#include <cstdint>
+#include <cstring>
 #include <string>
 #include <string_view>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#if defined(__SSSE3__)
+#include <tmmintrin.h>
+#endif
+
 namespace crispy::base64 {
 
 namespace detail
@@ -40,6 +49,71 @@ namespace detail
         64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, // 224..239
         64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64  // 240..255
     };
+
+    /// Decodes the leading blocks of 16 characters of [_input, _input + _count) that
+    /// consist of base64 characters only (no padding), writing 12 bytes per block.
+    ///
+    /// @returns the number of characters decoded, a multiple of 16.
+    inline size_t decodeBlocks(char const* _input, size_t _count, char* _output) noexcept
+    {
+        size_t decoded = 0;
+#if defined(__SSE2__)
+        while (_count - decoded >= 16)
+        {
+            auto const chars = _mm_loadu_si128(reinterpret_cast<__m128i const*>(_input + decoded));
+            auto const inRange = [&](char _first, char _last) {
+                return _mm_and_si128(_mm_cmpgt_epi8(chars, _mm_set1_epi8(static_cast<char>(_first - 1))),
+                                     _mm_cmplt_epi8(chars, _mm_set1_epi8(static_cast<char>(_last + 1))));
+            };
+            auto const upper = inRange('A', 'Z');
+            auto const lower = inRange('a', 'z');
+            auto const digit = inRange('0', '9');
+            auto const plus = _mm_cmpeq_epi8(chars, _mm_set1_epi8('+'));
+            auto const slash = _mm_cmpeq_epi8(chars, _mm_set1_epi8('/'));
+            auto const valid = _mm_or_si128(_mm_or_si128(upper, lower), _mm_or_si128(_mm_or_si128(digit, plus), slash));
+            if (_mm_movemask_epi8(valid) != 0xFFFF)
+                break;
+
+            // The character classes are disjoint, hence each character is offset by exactly one of them.
+            auto const offset = _mm_or_si128(
+                _mm_or_si128(_mm_and_si128(upper, _mm_set1_epi8(-'A')),
+                             _mm_and_si128(lower, _mm_set1_epi8(26 - 'a'))),
+                _mm_or_si128(_mm_and_si128(digit, _mm_set1_epi8(52 - '0')),
+                             _mm_or_si128(_mm_and_si128(plus, _mm_set1_epi8(62 - '+')),
+                                          _mm_and_si128(slash, _mm_set1_epi8(63 - '/')))));
+            auto const sextets = _mm_add_epi8(chars, offset);
+
+            // Merges pairs of sextets into 12 bits, and pairs of those into the 24 bits of 3 bytes,
+            // which are stored in reverse order in the lower 3 bytes of each 32-bit lane.
+            auto const pairs = _mm_or_si128(_mm_slli_epi16(_mm_and_si128(sextets, _mm_set1_epi16(0x00FF)), 6),
+                                            _mm_srli_epi16(sextets, 8));
+            auto const triples = _mm_or_si128(_mm_slli_epi32(_mm_and_si128(pairs, _mm_set1_epi32(0xFFFF)), 12),
+                                              _mm_srli_epi32(pairs, 16));
+            auto* const output = _output + decoded / 4 * 3;
+#if defined(__SSSE3__)
+            alignas(16) char bytes[16];
+            _mm_store_si128(reinterpret_cast<__m128i*>(bytes),
+                            _mm_shuffle_epi8(triples, _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1)));
+            std::memcpy(output, bytes, 12);
+#else
+            alignas(16) uint32_t lanes[4];
+            _mm_store_si128(reinterpret_cast<__m128i*>(lanes), triples);
+            for (size_t i = 0; i < 4; ++i)
+            {
+                output[i * 3 + 0] = static_cast<char>(lanes[i] >> 16);
+                output[i * 3 + 1] = static_cast<char>(lanes[i] >> 8);
+                output[i * 3 + 2] = static_cast<char>(lanes[i]);
+            }
+#endif
+            decoded += 16;
+        }
+#else
+        (void) _input;
+        (void) _count;
+        (void) _output;
+#endif
+        return decoded;
+    }
 }
 
 template <typename Iterator, typename Alphabet>
@@ -200,11 +274,75 @@ size_t decode(std::string_view const& input, Output output)
     return decode(input.begin(), input.end(), output);
 }
 
+/// Decodes base64 incrementally, as chunks of the encoded text arrive.
+///
+/// Decoding ends at the padding or at the first character that is not part of the base64 alphabet,
+/// ignoring all input from there on.
+class decoder {
+  public:
+    /// @returns the maximum number of bytes decoded from @p _count more characters.
+    static constexpr size_t maxDecodedSize(size_t _count) noexcept { return (_count + 3) / 4 * 3; }
+
+    /// Decodes @p _chunk into @p _output, which must provide maxDecodedSize(_chunk.size()) bytes.
+    ///
+    /// @returns the number of bytes written.
+    size_t decode(std::string_view _chunk, char* _output) noexcept
+    {
+        auto out = _output;
+        auto input = _chunk.data();
+        auto const end = input + _chunk.size();
+        while (input != end && !done_)
+        {
+            // Whole blocks are decoded in bulk while at the start of a group of 4 characters.
+            if (bitCount_ == 0)
+            {
+                auto const count = detail::decodeBlocks(input, static_cast<size_t>(end - input), out);
+                input += count;
+                out += count / 4 * 3;
+                if (input == end)
+                    break;
+            }
+
+            auto const sextet = detail::indexmap[static_cast<uint8_t>(*input++)];
+            if (sextet > 63)
+            {
+                done_ = true;
+                break;
+            }
+
+            bits_ = (bits_ << 6) | sextet;
+            bitCount_ += 6;
+            if (bitCount_ >= 8)
+            {
+                bitCount_ -= 8;
+                *out++ = static_cast<char>(bits_ >> bitCount_);
+                bits_ &= (1u << bitCount_) - 1;
+            }
+        }
+        return static_cast<size_t>(out - _output);
+    }
+
+    /// Appends the bytes decoded from @p _chunk to @p _output.
+    void decode(std::string_view _chunk, std::string& _output)
+    {
+        auto const size = _output.size();
+        _output.resize(size + maxDecodedSize(_chunk.size()));
+        _output.resize(size + decode(_chunk, _output.data() + size));
+    }
+
+    /// @returns whether the end of the encoded text has been reached.
+    bool done() const noexcept { return done_; }
+
+  private:
+    uint32_t bits_ = 0;     // bits of the characters not yet forming a whole byte
+    unsigned bitCount_ = 0;
+    bool done_ = false;
+};
+
 inline std::string decode(const std::string_view& input)
 {
     std::string output;
-    output.resize(decodeLength(input));
-    output.resize(decode(input, &output[0]));
+    decoder{}.decode(input, output);
     return output;
 }
 
@@ -0,0 +1,59 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2020 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <algorithm>
+#include <bitset>
+#include <string_view>
+#include <vector>
+
+namespace crispy {
+
+/// Set of Unicode codepoints, for testing characters against a small, fixed set, such as
+/// word delimiters.
+///
+/// US-ASCII codepoints are looked up in a bitmap, any others by binary search.
+class codepoint_set {
+  public:
+    codepoint_set() = default;
+
+    codepoint_set(std::u32string_view _codepoints)
+    {
+        for (char32_t const codepoint : _codepoints)
+            if (codepoint < ascii_.size())
+                ascii_.set(codepoint);
+            else
+                others_.push_back(codepoint);
+
+        std::sort(others_.begin(), others_.end());
+        others_.erase(std::unique(others_.begin(), others_.end()), others_.end());
+    }
+
+    codepoint_set(char32_t const* _codepoints) : codepoint_set(std::u32string_view(_codepoints)) {}
+
+    bool contains(char32_t _codepoint) const noexcept
+    {
+        if (_codepoint < ascii_.size())
+            return ascii_.test(_codepoint);
+        return std::binary_search(others_.begin(), others_.end(), _codepoint);
+    }
+
+    bool empty() const noexcept { return ascii_.none() && others_.empty(); }
+
+  private:
+    std::bitset<128> ascii_;
+    std::vector<char32_t> others_;   // sorted
+};
+
+} // end namespace
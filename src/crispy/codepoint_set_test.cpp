@@ -0,0 +1,43 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2020 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <crispy/codepoint_set.h>
+
+#include <catch2/catch.hpp>
+
+using crispy::codepoint_set;
+
+TEST_CASE("codepoint_set.contains")
+{
+    auto const set = codepoint_set{U" ,; 　 "};
+    CHECK_FALSE(set.empty());
+
+    CHECK(set.contains(U' '));
+    CHECK(set.contains(U','));
+    CHECK(set.contains(U';'));
+    CHECK(set.contains(U' '));
+    CHECK(set.contains(U'　'));
+
+    CHECK_FALSE(set.contains(U'a'));
+    CHECK_FALSE(set.contains(U'\0'));
+    CHECK_FALSE(set.contains(U'\u007F'));
+    CHECK_FALSE(set.contains(U'\u0080'));
+    CHECK_FALSE(set.contains(U'\U0001F600'));
+}
+
+TEST_CASE("codepoint_set.empty")
+{
+    CHECK(codepoint_set{}.empty());
+    CHECK(codepoint_set{U""}.empty());
+    CHECK_FALSE(codepoint_set{}.contains(U' '));
+}
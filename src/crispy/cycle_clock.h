@@ -0,0 +1,73 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2020 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+namespace crispy {
+
+/// Cheapest available monotonic tick counter, for timing very short sections of code.
+///
+/// Reads the time stamp counter on x86 and the virtual counter on AArch64, which take a few
+/// cycles rather than the tens of nanoseconds of a steady_clock call. Ticks are converted to
+/// time by calibrating them against steady_clock over a longer period, see cycle_calibration.
+/// Elsewhere, ticks are steady_clock nanoseconds.
+struct cycle_clock {
+    static uint64_t now() noexcept
+    {
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+        return __rdtsc();
+#elif defined(__x86_64__) || defined(__i386__)
+        return __rdtsc();
+#elif defined(__aarch64__)
+        uint64_t value;
+        asm volatile("mrs %0, cntvct_el0" : "=r"(value));
+        return value;
+#else
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count());
+#endif
+    }
+};
+
+/// Converts cycle_clock ticks to time, by relating the ticks passed since construction to the
+/// steady_clock time passed meanwhile. The longer the period, the more accurate the conversion.
+class cycle_calibration {
+  public:
+    cycle_calibration() noexcept :
+        startTicks_{ cycle_clock::now() },
+        startTime_{ std::chrono::steady_clock::now() }
+    {}
+
+    /// @returns nanoseconds per tick, measured from construction until now.
+    double nanoseconds_per_tick() const noexcept
+    {
+        auto const ticks = cycle_clock::now() - startTicks_;
+        auto const time = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - startTime_).count();
+        return ticks != 0 ? time / static_cast<double>(ticks) : 1.0;
+    }
+
+  private:
+    uint64_t startTicks_;
+    std::chrono::steady_clock::time_point startTime_;
+};
+
+} // end namespace
@@ -0,0 +1,146 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2020 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace crispy {
+
+namespace detail
+{
+    /// Stands in for an infinite distance, while keeping the arithmetic finite.
+    constexpr float distance_infinity = 1e20f;
+
+    /// Replaces each of the @p _count values of @p _f, @p _stride apart, with its minimal squared
+    /// distance to any other value plus that value (Felzenszwalb & Huttenlocher, "Distance
+    /// Transforms of Sampled Functions"), using @p _d, @p _v, and @p _z as scratch buffers.
+    inline void distance_transform_1d(float* _f, size_t _count, size_t _stride,
+                                      std::vector<float>& _d,
+                                      std::vector<size_t>& _v,
+                                      std::vector<float>& _z)
+    {
+        _d.resize(_count);
+        _v.resize(_count);
+        _z.resize(_count + 1);
+
+        auto const f = [&](size_t _i) { return _f[_i * _stride]; };
+        auto const intersection = [&](size_t _p, size_t _q) {
+            auto const p = static_cast<float>(_p);
+            auto const q = static_cast<float>(_q);
+            return ((f(_q) + q * q) - (f(_p) + p * p)) / (2.0f * q - 2.0f * p);
+        };
+
+        // The lower envelope of the parabolas rooted at each value.
+        size_t k = 0;
+        _v[0] = 0;
+        _z[0] = -distance_infinity;
+        _z[1] = distance_infinity;
+        for (size_t q = 1; q < _count; ++q)
+        {
+            auto s = intersection(_v[k], q);
+            while (s <= _z[k] && k > 0)
+            {
+                --k;
+                s = intersection(_v[k], q);
+            }
+            ++k;
+            _v[k] = q;
+            _z[k] = s;
+            _z[k + 1] = distance_infinity;
+        }
+
+        k = 0;
+        for (size_t q = 0; q < _count; ++q)
+        {
+            while (_z[k + 1] < static_cast<float>(q))
+                ++k;
+            auto const distance = static_cast<float>(q) - static_cast<float>(_v[k]);
+            _d[q] = distance * distance + f(_v[k]);
+        }
+
+        for (size_t q = 0; q < _count; ++q)
+            _f[q * _stride] = _d[q];
+    }
+
+    /// Replaces each value of the @p _width x @p _height grid, either 0 or distance_infinity, with
+    /// the squared distance to the nearest 0.
+    inline void distance_transform_2d(std::vector<float>& _grid, size_t _width, size_t _height)
+    {
+        auto d = std::vector<float>{};
+        auto v = std::vector<size_t>{};
+        auto z = std::vector<float>{};
+        for (size_t x = 0; x < _width; ++x)
+            distance_transform_1d(_grid.data() + x, _height, _width, d, v, z);
+        for (size_t y = 0; y < _height; ++y)
+            distance_transform_1d(_grid.data() + y * _width, _width, 1, d, v, z);
+    }
+}
+
+/// Converts the 8-bit coverage bitmap of a glyph into a signed distance field.
+///
+/// The field is @p _spread pixels larger than the bitmap on each side. Each of its values maps
+/// the distance to the glyph's outline, clamped to @p _spread pixels, into 0..255, such that the
+/// outline is at 128, and values above are inside the glyph. Linearly interpolating the field
+/// keeps the outline sharp at any scale, whereas the coverage gets blurry.
+///
+/// @returns the field of (@p _width + 2 * @p _spread) x (@p _height + 2 * @p _spread) values,
+///          top row first, like the bitmap.
+inline std::vector<uint8_t> signed_distance_field(uint8_t const* _coverage,
+                                                  unsigned _width,
+                                                  unsigned _height,
+                                                  unsigned _spread)
+{
+    auto const width = size_t{_width} + 2 * _spread;
+    auto const height = size_t{_height} + 2 * _spread;
+
+    auto const inside = [&](size_t _x, size_t _y) {
+        if (_x < _spread || _y < _spread || _x >= _spread + _width || _y >= _spread + _height)
+            return false;
+        return _coverage[(_y - _spread) * _width + (_x - _spread)] >= 128;
+    };
+
+    // Squared distances of outside pixels to the nearest inside pixel, and vice versa.
+    auto outsideDistances = std::vector<float>(width * height);
+    auto insideDistances = std::vector<float>(width * height);
+    for (size_t y = 0; y < height; ++y)
+    {
+        for (size_t x = 0; x < width; ++x)
+        {
+            auto const in = inside(x, y);
+            outsideDistances[y * width + x] = in ? 0.0f : detail::distance_infinity;
+            insideDistances[y * width + x] = in ? detail::distance_infinity : 0.0f;
+        }
+    }
+    detail::distance_transform_2d(outsideDistances, width, height);
+    detail::distance_transform_2d(insideDistances, width, height);
+
+    // The outline runs half way between the centers of neighboring inside and outside pixels.
+    auto field = std::vector<uint8_t>(width * height);
+    auto const spread = static_cast<float>(std::max(_spread, 1u));
+    for (size_t i = 0; i < field.size(); ++i)
+    {
+        auto const distance = outsideDistances[i] != 0.0f
+            ? -(std::sqrt(outsideDistances[i]) - 0.5f)
+            : std::sqrt(insideDistances[i]) - 0.5f;
+        auto const value = 0.5f + std::clamp(distance / spread, -1.0f, 1.0f) * 0.5f;
+        field[i] = static_cast<uint8_t>(std::lround(std::min(value * 256.0f, 255.0f)));
+    }
+    return field;
+}
+
+} // end namespace
@@ -0,0 +1,56 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2020 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <crispy/distance_field.h>
+
+#include <catch2/catch.hpp>
+
+#include <vector>
+
+using crispy::signed_distance_field;
+
+TEST_CASE("signed_distance_field.square")
+{
+    // A 4x4 square centered in an 8x8 bitmap.
+    auto coverage = std::vector<uint8_t>(8 * 8, 0);
+    for (unsigned y = 2; y < 6; ++y)
+        for (unsigned x = 2; x < 6; ++x)
+            coverage[y * 8 + x] = 255;
+
+    auto constexpr Spread = 4u;
+    auto const field = signed_distance_field(coverage.data(), 8, 8, Spread);
+    REQUIRE(field.size() == 16 * 16);
+
+    auto const at = [&](unsigned x, unsigned y) { return field[(y + Spread) * 16 + (x + Spread)]; };
+
+    // Pixels next to the outline are just above or below its value of 128.
+    CHECK(at(2, 3) == 144);
+    CHECK(at(1, 3) == 112);
+
+    // Deeper inside and further outside, the values grow and shrink with the distance.
+    CHECK(at(3, 3) == 176);
+    CHECK(at(0, 3) == 80);
+    CHECK(at(3, 3) > at(2, 3));
+
+    // Beyond the spread, distances are clamped.
+    CHECK(field[0] == 0);
+}
+
+TEST_CASE("signed_distance_field.empty")
+{
+    auto const coverage = std::vector<uint8_t>(3 * 2, 0);
+    auto const field = signed_distance_field(coverage.data(), 3, 2, 2);
+    REQUIRE(field.size() == 7 * 6);
+    for (auto const value : field)
+        CHECK(value == 0);
+}
@@ -0,0 +1,186 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2020 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <utility>
+#include <vector>
+
+namespace crispy {
+
+/// Hash map storing its entries inline in a single array, using open addressing with linear probing.
+///
+/// A lookup is one hash computation followed by probing adjacent slots, so that hits usually
+/// touch a single cache line, as opposed to the node-based standard containers.
+/// Erasing shifts the following entries of the probe sequence back instead of leaving
+/// tombstones behind, hence lookups never slow down over time.
+///
+/// Entries move on rehashing and erasing, so pointers to values are only valid until the next
+/// modification. Keys need not be assignable, only move constructible.
+template <typename Key, typename Value, typename Hash = std::hash<Key>, typename Equal = std::equal_to<Key>>
+class flat_hash_map {
+  public:
+    struct entry {
+        Key key;
+        Value value;
+    };
+
+    flat_hash_map() = default;
+
+    size_t size() const noexcept { return size_; }
+    bool empty() const noexcept { return size_ == 0; }
+    size_t capacity() const noexcept { return slots_.size(); }
+
+    /// @returns pointer to the value associated with @p _key or nullptr if there is none.
+    Value* find(Key const& _key) noexcept
+    {
+        auto const i = indexOf(_key);
+        return i.has_value() ? &slots_[*i]->value : nullptr;
+    }
+
+    Value const* find(Key const& _key) const noexcept
+    {
+        auto const i = indexOf(_key);
+        return i.has_value() ? &slots_[*i]->value : nullptr;
+    }
+
+    bool contains(Key const& _key) const noexcept { return indexOf(_key).has_value(); }
+
+    /// Inserts a value constructed from @p _args for @p _key, unless there is one already.
+    ///
+    /// @returns the value associated with @p _key, and whether or not it has been inserted.
+    template <typename... Args>
+    std::pair<Value*, bool> try_emplace(Key const& _key, Args&&... _args)
+    {
+        if (auto const i = indexOf(_key); i.has_value())
+            return {&slots_[*i]->value, false};
+
+        // Keeping the load factor at most 3/4 keeps the probe sequences short.
+        if ((size_ + 1) * 4 > slots_.size() * 3)
+            rehash(std::max(slots_.size() * 2, size_t{16}));
+
+        auto i = home(hash(_key));
+        while (slots_[i].has_value())
+            i = next(i);
+
+        slots_[i].emplace(entry{_key, Value(std::forward<Args>(_args)...)});
+        ++size_;
+        return {&slots_[i]->value, true};
+    }
+
+    /// Removes the entry of @p _key.
+    ///
+    /// @retval true the entry has been removed.
+    /// @retval false there was no such entry.
+    bool erase(Key const& _key)
+    {
+        auto const found = indexOf(_key);
+        if (!found.has_value())
+            return false;
+
+        // Entries following the hole in its probe sequence are moved into it, unless their home
+        // slot lies cyclically after the hole (and not after themselves).
+        auto hole = *found;
+        slots_[hole].reset();
+        for (auto i = next(hole); slots_[i].has_value(); i = next(i))
+        {
+            auto const h = home(hash(slots_[i]->key));
+            bool const movable = hole <= i ? (h <= hole || h > i)
+                                           : (h <= hole && h > i);
+            if (movable)
+            {
+                slots_[hole].emplace(std::move(*slots_[i]));
+                slots_[i].reset();
+                hole = i;
+            }
+        }
+
+        --size_;
+        return true;
+    }
+
+    void clear()
+    {
+        for (auto& slot : slots_)
+            slot.reset();
+        size_ = 0;
+    }
+
+    /// Invokes @p _visit with the key and value of each entry, in no particular order.
+    template <typename Visitor>
+    void for_each(Visitor&& _visit) const
+    {
+        for (auto const& slot : slots_)
+            if (slot.has_value())
+                _visit(slot->key, slot->value);
+    }
+
+  private:
+    size_t hash(Key const& _key) const noexcept
+    {
+        // Finalizes the hash (as of MurmurHash3), as std::hash is often the identity for integers,
+        // which would otherwise make consecutive keys collide in their lower bits.
+        auto h = static_cast<uint64_t>(Hash{}(_key));
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdllu;
+        h ^= h >> 33;
+        h *= 0xc4ceb9fe1a85ec53llu;
+        h ^= h >> 33;
+        return static_cast<size_t>(h);
+    }
+
+    size_t home(size_t _hash) const noexcept { return _hash & (slots_.size() - 1); }
+    size_t next(size_t _index) const noexcept { return (_index + 1) & (slots_.size() - 1); }
+
+    std::optional<size_t> indexOf(Key const& _key) const noexcept
+    {
+        if (slots_.empty())
+            return std::nullopt;
+
+        for (auto i = home(hash(_key)); slots_[i].has_value(); i = next(i))
+            if (Equal{}(slots_[i]->key, _key))
+                return i;
+
+        return std::nullopt;
+    }
+
+    void rehash(size_t _capacity)
+    {
+        assert((_capacity & (_capacity - 1)) == 0);
+
+        auto old = std::vector<std::optional<entry>>(_capacity);
+        std::swap(old, slots_);
+        for (auto& slot : old)
+        {
+            if (!slot.has_value())
+                continue;
+
+            auto i = home(hash(slot->key));
+            while (slots_[i].has_value())
+                i = next(i);
+            slots_[i].emplace(std::move(*slot));
+        }
+    }
+
+  private:
+    std::vector<std::optional<entry>> slots_;   // capacity is always a power of two (or zero)
+    size_t size_ = 0;
+};
+
+} // end namespace
@@ -0,0 +1,133 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2020 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <crispy/flat_hash_map.h>
+
+#include <catch2/catch.hpp>
+
+#include <fmt/format.h>
+
+#include <map>
+#include <random>
+#include <string>
+
+using namespace std;
+
+namespace
+{
+    /// Hashes all keys alike, so that every key collides with every other one.
+    struct CollidingHash {
+        size_t operator()(int) const noexcept { return 42; }
+    };
+
+    struct ConstKey {
+        int const value;
+        bool operator==(ConstKey const& _rhs) const noexcept { return value == _rhs.value; }
+    };
+
+    struct ConstKeyHash {
+        size_t operator()(ConstKey const& _key) const noexcept { return static_cast<size_t>(_key.value); }
+    };
+}
+
+TEST_CASE("flat_hash_map.basic")
+{
+    auto map = crispy::flat_hash_map<string, int>{};
+    CHECK(map.empty());
+    CHECK(map.find("a") == nullptr);
+
+    auto const [a, inserted] = map.try_emplace("a", 1);
+    CHECK(inserted);
+    CHECK(*a == 1);
+
+    auto const [a2, insertedAgain] = map.try_emplace("a", 2);
+    CHECK_FALSE(insertedAgain);
+    CHECK(*a2 == 1);
+
+    map.try_emplace("b", 2);
+    CHECK(map.size() == 2);
+    REQUIRE(map.find("b") != nullptr);
+    CHECK(*map.find("b") == 2);
+
+    CHECK(map.erase("a"));
+    CHECK_FALSE(map.erase("a"));
+    CHECK_FALSE(map.contains("a"));
+    CHECK(map.contains("b"));
+    CHECK(map.size() == 1);
+
+    map.clear();
+    CHECK(map.empty());
+    CHECK_FALSE(map.contains("b"));
+}
+
+TEST_CASE("flat_hash_map.erase_within_probe_sequence")
+{
+    // All keys share one probe sequence, from which any of them can be erased.
+    for (int erased = 0; erased < 5; ++erased)
+    {
+        auto map = crispy::flat_hash_map<int, int, CollidingHash>{};
+        for (int i = 0; i < 5; ++i)
+            map.try_emplace(i, i * 10);
+
+        CHECK(map.erase(erased));
+        for (int i = 0; i < 5; ++i)
+        {
+            INFO(fmt::format("erased: {}, key: {}", erased, i));
+            if (i == erased)
+                CHECK(map.find(i) == nullptr);
+            else
+            {
+                REQUIRE(map.find(i) != nullptr);
+                CHECK(*map.find(i) == i * 10);
+            }
+        }
+    }
+}
+
+TEST_CASE("flat_hash_map.const_keys")
+{
+    auto map = crispy::flat_hash_map<ConstKey, int, ConstKeyHash>{};
+    for (int i = 0; i < 100; ++i)
+        map.try_emplace(ConstKey{i}, i);
+    for (int i = 0; i < 100; i += 2)
+        map.erase(ConstKey{i});
+
+    CHECK(map.size() == 50);
+    CHECK_FALSE(map.contains(ConstKey{10}));
+    REQUIRE(map.find(ConstKey{11}) != nullptr);
+    CHECK(*map.find(ConstKey{11}) == 11);
+}
+
+TEST_CASE("flat_hash_map.random")
+{
+    // Compared against std::map over a random sequence of insertions and erasures.
+    auto map = crispy::flat_hash_map<unsigned, unsigned>{};
+    auto reference = std::map<unsigned, unsigned>{};
+    auto rng = mt19937{4711};
+    for (int i = 0; i < 20000; ++i)
+    {
+        auto const key = rng() % 1024;
+        if (rng() % 3 == 0)
+            CHECK(map.erase(key) == (reference.erase(key) != 0));
+        else
+            CHECK(map.try_emplace(key, key + 1).second == reference.emplace(key, key + 1).second);
+    }
+
+    CHECK(map.size() == reference.size());
+    size_t visited = 0;
+    map.for_each([&](unsigned _key, unsigned _value) {
+        CHECK(reference.at(_key) == _value);
+        ++visited;
+    });
+    CHECK(visited == reference.size());
+}
@@ -0,0 +1,77 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2020 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+namespace crispy {
+
+template <typename Signature>
+class function_ref;
+
+/// Non-owning reference to a callable, for callbacks invoked often, such as per cell.
+///
+/// Unlike std::function, it never allocates, and calling it is a plain indirect call rather than
+/// a virtual one. The referred callable must outlive the function_ref, which is why temporaries
+/// such as lambdas may only be passed to parameters used while the callee runs. Callbacks stored
+/// for longer are made with bind(), calling a function with an object living long enough.
+template <typename R, typename... Args>
+class function_ref<R(Args...)> {
+  public:
+    constexpr function_ref() noexcept = default;
+
+    /// Refers to the callable object @p _callable, which must outlive this function_ref.
+    template <
+        typename F,
+        std::enable_if_t<!std::is_same_v<std::decay_t<F>, function_ref>
+                         && std::is_object_v<std::remove_reference_t<F>>
+                         && std::is_invocable_r_v<R, F&, Args...>, int> = 0
+    >
+    constexpr function_ref(F&& _callable) noexcept :
+        object_{const_cast<void*>(static_cast<void const*>(std::addressof(_callable)))},
+        invoke_{[](void* _object, Args... _args) -> R {
+            return std::invoke(*static_cast<std::remove_reference_t<F>*>(_object), std::forward<Args>(_args)...);
+        }}
+    {
+    }
+
+    /// @returns a function_ref calling @p Fn(@p _object, args...), where @p Fn may be a member
+    ///          function, and @p _object must outlive the function_ref.
+    template <auto Fn, typename T>
+    static constexpr function_ref bind(T& _object) noexcept
+    {
+        auto result = function_ref{};
+        result.object_ = const_cast<void*>(static_cast<void const*>(std::addressof(_object)));
+        result.invoke_ = [](void* _object, Args... _args) -> R {
+            return std::invoke(Fn, *static_cast<T*>(_object), std::forward<Args>(_args)...);
+        };
+        return result;
+    }
+
+    constexpr explicit operator bool() const noexcept { return invoke_ != nullptr; }
+
+    R operator()(Args... _args) const
+    {
+        return invoke_(object_, std::forward<Args>(_args)...);
+    }
+
+  private:
+    void* object_ = nullptr;
+    R (*invoke_)(void*, Args...) = nullptr;
+};
+
+} // end namespace
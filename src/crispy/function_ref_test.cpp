@@ -0,0 +1,60 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2020 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <crispy/function_ref.h>
+
+#include <catch2/catch.hpp>
+
+#include <string>
+
+using namespace std;
+
+namespace
+{
+    struct Counter {
+        int count = 0;
+        int add(int _value) { return count += _value; }
+    };
+}
+
+TEST_CASE("function_ref.callable")
+{
+    auto total = 0;
+    auto const add = [&](int _value) { total += _value; return total; };
+    auto const f = crispy::function_ref<int(int)>(add);
+    CHECK(f);
+    CHECK(f(2) == 2);
+    CHECK(f(3) == 5);
+
+    CHECK_FALSE(crispy::function_ref<void()>{});
+}
+
+TEST_CASE("function_ref.bind")
+{
+    auto counter = Counter{};
+    auto const f = crispy::function_ref<int(int)>::bind<&Counter::add>(counter);
+    f(2);
+    CHECK(f(3) == 5);
+    CHECK(counter.count == 5);
+
+    auto const text = string("hello");
+    auto const g = crispy::function_ref<size_t()>::bind<&string::size>(text);
+    CHECK(g() == 5);
+}
+
+TEST_CASE("function_ref.argument")
+{
+    // Temporaries live as long as the call they are passed to.
+    auto const apply = [](crispy::function_ref<int(int)> _f, int _value) { return _f(_value); };
+    CHECK(apply([](int _value) { return _value + 1; }, 41) == 42);
+}
@@ -0,0 +1,173 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2020 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+#include <type_traits>
+
+#if defined(_MSC_VER) && defined(_M_X64)
+#include <intrin.h>
+#endif
+
+// Fast, seedable, non-cryptographic 64-bit hashing (following wyhash), consuming its input
+// a word at a time, up to 48 bytes per round.
+//
+// Hash values are meant for in-memory tables only, as they depend on the platform's byte order.
+
+namespace crispy {
+
+namespace detail::hash
+{
+    constexpr uint64_t Secret[4] = {
+        0x2d358dccaa6c78a5llu,
+        0x8bb84b93962eacc9llu,
+        0x4b33a62ed433d4a3llu,
+        0x4d5a2da51de1aa47llu
+    };
+
+    /// Multiplies @p _a and @p _b into a 128-bit product, returned as its low and high half.
+    inline void multiply(uint64_t& _a, uint64_t& _b) noexcept
+    {
+#if defined(__SIZEOF_INT128__)
+        auto const r = static_cast<unsigned __int128>(_a) * _b;
+        _a = static_cast<uint64_t>(r);
+        _b = static_cast<uint64_t>(r >> 64);
+#elif defined(_MSC_VER) && defined(_M_X64)
+        _a = _umul128(_a, _b, &_b);
+#else
+        uint64_t const ha = _a >> 32, hb = _b >> 32, la = uint32_t(_a), lb = uint32_t(_b);
+        uint64_t const rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+        uint64_t const t = rl + (rm0 << 32);
+        uint64_t const lo = t + (rm1 << 32);
+        uint64_t const carry = (t < rl ? 1 : 0) + (lo < t ? 1 : 0);
+        _b = rh + (rm0 >> 32) + (rm1 >> 32) + carry;
+        _a = lo;
+#endif
+    }
+
+    inline uint64_t mix(uint64_t _a, uint64_t _b) noexcept
+    {
+        multiply(_a, _b);
+        return _a ^ _b;
+    }
+
+    inline uint64_t read8(uint8_t const* _p) noexcept
+    {
+        uint64_t v;
+        std::memcpy(&v, _p, sizeof(v));
+        return v;
+    }
+
+    inline uint64_t read4(uint8_t const* _p) noexcept
+    {
+        uint32_t v;
+        std::memcpy(&v, _p, sizeof(v));
+        return v;
+    }
+
+    /// Reads 1 to 3 bytes.
+    inline uint64_t read3(uint8_t const* _p, size_t _len) noexcept
+    {
+        return (uint64_t(_p[0]) << 16) | (uint64_t(_p[_len >> 1]) << 8) | _p[_len - 1];
+    }
+}
+
+/// @returns the 64-bit hash of the @p _size bytes at @p _data, for the given @p _seed.
+inline uint64_t hash_bytes(void const* _data, size_t _size, uint64_t _seed = 0) noexcept
+{
+    using namespace detail::hash;
+
+    auto p = static_cast<uint8_t const*>(_data);
+    auto seed = _seed ^ mix(_seed ^ Secret[0], Secret[1]);
+    uint64_t a = 0;
+    uint64_t b = 0;
+
+    if (_size <= 16)
+    {
+        if (_size >= 4)
+        {
+            auto const middle = (_size >> 3) << 2;
+            a = (read4(p) << 32) | read4(p + middle);
+            b = (read4(p + _size - 4) << 32) | read4(p + _size - 4 - middle);
+        }
+        else if (_size > 0)
+            a = read3(p, _size);
+    }
+    else
+    {
+        auto i = _size;
+        if (i > 48)
+        {
+            // Three independent lanes, so that the multiplications can overlap.
+            auto see1 = seed;
+            auto see2 = seed;
+            do
+            {
+                seed = mix(read8(p) ^ Secret[1], read8(p + 8) ^ seed);
+                see1 = mix(read8(p + 16) ^ Secret[2], read8(p + 24) ^ see1);
+                see2 = mix(read8(p + 32) ^ Secret[3], read8(p + 40) ^ see2);
+                p += 48;
+                i -= 48;
+            }
+            while (i > 48);
+            seed ^= see1 ^ see2;
+        }
+        while (i > 16)
+        {
+            seed = mix(read8(p) ^ Secret[1], read8(p + 8) ^ seed);
+            i -= 16;
+            p += 16;
+        }
+        a = read8(p + i - 16);
+        b = read8(p + i - 8);
+    }
+
+    a ^= Secret[1];
+    b ^= seed;
+    multiply(a, b);
+    return mix(a ^ Secret[0] ^ _size, b ^ Secret[1]);
+}
+
+/// @returns the hash of the contiguous sequence of @p _count trivially copyable values at @p _data.
+template <typename T>
+inline uint64_t hash_bytes(T const* _data, size_t _count, uint64_t _seed = 0) noexcept
+{
+    static_assert(std::is_trivially_copyable_v<T> && std::has_unique_object_representations_v<T>,
+                  "Values must not contain padding bytes.");
+    return hash_bytes(static_cast<void const*>(_data), _count * sizeof(T), _seed);
+}
+
+template <typename Char>
+inline uint64_t hash_bytes(std::basic_string_view<Char> _text, uint64_t _seed = 0) noexcept
+{
+    return hash_bytes(_text.data(), _text.size(), _seed);
+}
+
+/// @returns the hash of the single word @p _value, for the given @p _seed.
+///
+/// Cheaper than hashing the word's bytes, and suitable for chaining multiple words:
+/// hash_word(b, hash_word(a)).
+inline uint64_t hash_word(uint64_t _value, uint64_t _seed = 0) noexcept
+{
+    using namespace detail::hash;
+    auto a = _value ^ Secret[0];
+    auto b = _seed ^ Secret[1];
+    multiply(a, b);
+    return mix(a ^ Secret[0], b ^ Secret[1]);
+}
+
+} // end namespace crispy
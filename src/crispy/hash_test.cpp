@@ -0,0 +1,121 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2020 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <crispy/hash.h>
+#include <crispy/FNV.h>
+
+#include <catch2/catch.hpp>
+
+#include <fmt/format.h>
+
+#include <chrono>
+#include <iostream>
+#include <set>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using namespace std;
+using crispy::hash_bytes;
+using crispy::hash_word;
+
+TEST_CASE("hash.deterministic")
+{
+    auto const text = "The quick brown fox jumps over the lazy dog"s;
+    CHECK(hash_bytes(text.data(), text.size()) == hash_bytes(string_view(text)));
+    CHECK(hash_bytes(string_view(text), 1) == hash_bytes(text.data(), text.size(), 1));
+    CHECK(hash_word(42, 7) == hash_word(42, 7));
+}
+
+TEST_CASE("hash.seed")
+{
+    auto const text = "seeded"sv;
+    CHECK(hash_bytes(text, 0) != hash_bytes(text, 1));
+    CHECK(hash_word(42, 0) != hash_word(42, 1));
+}
+
+TEST_CASE("hash.lengths")
+{
+    // Every length takes one of the code paths by input size, and prefixes must not collide,
+    // not even those consisting of zero bytes only.
+    auto const zeros = vector<uint8_t>(200, 0);
+    auto const text = vector<uint8_t>(200, 'x');
+    auto hashes = set<uint64_t>{};
+    for (size_t n = 0; n <= zeros.size(); ++n)
+    {
+        hashes.insert(hash_bytes(zeros.data(), n));
+        hashes.insert(hash_bytes(text.data(), n));
+    }
+    CHECK(hashes.size() == 2 * (zeros.size() + 1) - 1); // the empty input is hashed twice
+}
+
+TEST_CASE("hash.every_byte_matters")
+{
+    for (size_t const size: {1u, 3u, 4u, 7u, 8u, 15u, 16u, 17u, 47u, 48u, 49u, 100u})
+    {
+        auto bytes = vector<uint8_t>(size, 0);
+        auto const original = hash_bytes(bytes.data(), bytes.size());
+        for (size_t i = 0; i < size; ++i)
+        {
+            INFO(fmt::format("size: {}, byte: {}", size, i));
+            bytes[i] = 1;
+            CHECK(hash_bytes(bytes.data(), bytes.size()) != original);
+            bytes[i] = 0;
+        }
+    }
+}
+
+TEST_CASE("hash.words")
+{
+    // Small keys of consecutive integers, such as glyph indices, must spread over the lower bits.
+    auto buckets = set<uint64_t>{};
+    for (uint64_t i = 0; i < 4096; ++i)
+        buckets.insert(hash_word(i) & 0xFFFF);
+    CHECK(buckets.size() > 3900);
+}
+
+TEST_CASE("hash.benchmark", "[.benchmark]")
+{
+    // Compares against FNV-1a, as previously used for the text shaping cache, over typical
+    // terminal line lengths.
+    auto constexpr fnv = crispy::FNV<uint64_t>{1099511628211llu, 14695981039346656037llu};
+    auto constexpr Rounds = 200'000;
+
+    for (size_t const length: {8u, 32u, 80u, 200u})
+    {
+        auto const text = u32string(length, U'x');
+
+        auto const measure = [&](auto _hash) {
+            auto sum = uint64_t{0};
+            auto const start = chrono::steady_clock::now();
+            for (int i = 0; i < Rounds; ++i)
+                sum += _hash(static_cast<uint64_t>(i));
+            auto const elapsed = chrono::duration<double, nano>(chrono::steady_clock::now() - start);
+            CHECK(sum != 0);
+            return elapsed.count() / Rounds;
+        };
+
+        auto const fnvTime = measure([&](uint64_t _round) {
+            auto hash = fnv(14695981039346656037llu, _round);
+            for (char32_t const codepoint : text)
+                hash = fnv(hash, codepoint);
+            return hash;
+        });
+        auto const wordTime = measure([&](uint64_t _round) {
+            return hash_bytes(u32string_view(text), _round);
+        });
+
+        cout << fmt::format("{:>4} codepoints: FNV-1a {:7.1f} ns, hash_bytes {:7.1f} ns\n",
+                            length, fnvTime, wordTime);
+    }
+}
@@ -0,0 +1,84 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2020 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace crispy {
+
+/// Histogram of durations in equally wide buckets, for reporting latency percentiles
+/// without keeping every sample around.
+///
+/// Samples beyond the last bucket are counted in an overflow bucket, which reports
+/// the largest sample seen.
+class latency_histogram {
+  public:
+    using duration = std::chrono::nanoseconds;
+
+    /// Constructs a histogram of @p _bucketCount buckets, each @p _bucketWidth wide.
+    latency_histogram(duration _bucketWidth, size_t _bucketCount) :
+        bucketWidth_{ std::max(_bucketWidth, duration(1)) },
+        buckets_(std::max(_bucketCount, size_t{1}) + 1, 0)
+    {
+    }
+
+    void add(duration _sample) noexcept
+    {
+        auto const bucket = static_cast<size_t>(std::max(_sample, duration::zero()) / bucketWidth_);
+        ++buckets_[std::min(bucket, buckets_.size() - 1)];
+        ++count_;
+        max_ = std::max(max_, _sample);
+    }
+
+    void clear() noexcept
+    {
+        std::fill(buckets_.begin(), buckets_.end(), 0);
+        count_ = 0;
+        max_ = duration::zero();
+    }
+
+    uint64_t count() const noexcept { return count_; }
+    bool empty() const noexcept { return count_ == 0; }
+    duration max() const noexcept { return max_; }
+
+    /// @returns the upper bound of the bucket holding the @p _percentile'th (0..100) sample,
+    ///          or zero if empty.
+    duration percentile(double _percentile) const noexcept
+    {
+        if (count_ == 0)
+            return duration::zero();
+
+        auto const rank = std::max(uint64_t{1}, static_cast<uint64_t>(_percentile / 100.0 * static_cast<double>(count_) + 0.5));
+        auto seen = uint64_t{0};
+        for (size_t i = 0; i < buckets_.size() - 1; ++i)
+        {
+            seen += buckets_[i];
+            if (seen >= rank)
+                return std::min(bucketWidth_ * static_cast<int64_t>(i + 1), max_);
+        }
+        return max_;
+    }
+
+  private:
+    duration bucketWidth_;
+    std::vector<uint64_t> buckets_;
+    uint64_t count_ = 0;
+    duration max_ = duration::zero();
+};
+
+} // end namespace
@@ -0,0 +1,54 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2020 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <crispy/latency_histogram.h>
+
+#include <catch2/catch.hpp>
+
+using namespace std::chrono;
+using crispy::latency_histogram;
+
+TEST_CASE("latency_histogram.empty")
+{
+    auto const histogram = latency_histogram{milliseconds(1), 10};
+    CHECK(histogram.empty());
+    CHECK(histogram.percentile(50) == nanoseconds::zero());
+}
+
+TEST_CASE("latency_histogram.percentile")
+{
+    auto histogram = latency_histogram{milliseconds(1), 100};
+    for (int i = 0; i < 100; ++i)
+        histogram.add(microseconds(i * 1000 + 500));
+
+    CHECK(histogram.count() == 100);
+    CHECK(histogram.percentile(50) == milliseconds(50));
+    CHECK(histogram.percentile(99) == milliseconds(99));
+
+    // The last bucket's bound is clamped to the largest sample.
+    CHECK(histogram.percentile(100) == microseconds(99500));
+}
+
+TEST_CASE("latency_histogram.overflow")
+{
+    auto histogram = latency_histogram{milliseconds(1), 10};
+    histogram.add(microseconds(500));
+    histogram.add(milliseconds(250));
+
+    CHECK(histogram.percentile(50) == milliseconds(1));
+    CHECK(histogram.percentile(99) == milliseconds(250));
+
+    histogram.clear();
+    CHECK(histogram.empty());
+    CHECK(histogram.max() == nanoseconds::zero());
+}
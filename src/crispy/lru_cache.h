@@ -0,0 +1,130 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2020 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <unordered_map>
+#include <utility>
+
+namespace crispy {
+
+/// Least recently used cache, bounded by number of entries as well as by their total size in bytes.
+///
+/// Entries are indexed by a 64-bit hash of their key, so that lookups never need to construct
+/// a key; the stored key is only compared against on hash equality. Inserting an entry whose
+/// hash is already in use replaces the previous entry.
+template <typename Key, typename Value>
+class lru_cache {
+  public:
+    struct entry {
+        uint64_t hash;
+        Key key;
+        Value value;
+        size_t bytes;
+    };
+
+    using const_iterator = typename std::list<entry>::const_iterator;
+
+    lru_cache(size_t _maxEntries, size_t _maxBytes) :
+        maxEntries_{_maxEntries},
+        maxBytes_{_maxBytes}
+    {}
+
+    size_t size() const noexcept { return entries_.size(); }
+    size_t bytes() const noexcept { return bytes_; }
+    bool empty() const noexcept { return entries_.empty(); }
+
+    uint64_t hits() const noexcept { return hits_; }
+    uint64_t misses() const noexcept { return misses_; }
+    uint64_t evictions() const noexcept { return evictions_; }
+
+    /// Looks up the entry of the given hash whose key equals @p _probe, and marks it most recently used.
+    ///
+    /// @returns pointer to the entry's value or nullptr if there is none.
+    template <typename Probe>
+    Value* find(uint64_t _hash, Probe const& _probe)
+    {
+        if (auto const i = index_.find(_hash); i != index_.end() && i->second->key == _probe)
+        {
+            entries_.splice(entries_.begin(), entries_, i->second);
+            ++hits_;
+            return &i->second->value;
+        }
+        ++misses_;
+        return nullptr;
+    }
+
+    /// Tests for an entry of the given hash whose key equals @p _probe, without marking it used.
+    template <typename Probe>
+    bool contains(uint64_t _hash, Probe const& _probe) const
+    {
+        auto const i = index_.find(_hash);
+        return i != index_.end() && i->second->key == _probe;
+    }
+
+    /// Inserts the given entry as most recently used one, accounting for @p _bytes in total,
+    /// and evicts the least recently used entries as needed to stay within the limits.
+    Value& insert(uint64_t _hash, Key _key, Value _value, size_t _bytes)
+    {
+        if (auto const i = index_.find(_hash); i != index_.end())
+            erase(i->second);
+
+        entries_.emplace_front(entry{_hash, std::move(_key), std::move(_value), _bytes});
+        index_.emplace(_hash, entries_.begin());
+        bytes_ += _bytes;
+
+        // The most recent entry is kept, even if exceeding the limits on its own.
+        while (entries_.size() > 1 && (entries_.size() > maxEntries_ || bytes_ > maxBytes_))
+        {
+            erase(std::prev(entries_.end()));
+            ++evictions_;
+        }
+
+        return entries_.front().value;
+    }
+
+    void clear()
+    {
+        entries_.clear();
+        index_.clear();
+        bytes_ = 0;
+    }
+
+    /// Iterates all entries, starting with the most recently used one.
+    const_iterator begin() const noexcept { return entries_.begin(); }
+    const_iterator end() const noexcept { return entries_.end(); }
+
+  private:
+    void erase(typename std::list<entry>::iterator _entry)
+    {
+        bytes_ -= _entry->bytes;
+        index_.erase(_entry->hash);
+        entries_.erase(_entry);
+    }
+
+    size_t maxEntries_;
+    size_t maxBytes_;
+    size_t bytes_ = 0;
+
+    std::list<entry> entries_;
+    std::unordered_map<uint64_t, typename std::list<entry>::iterator> index_;
+
+    uint64_t hits_ = 0;
+    uint64_t misses_ = 0;
+    uint64_t evictions_ = 0;
+};
+
+} // end namespace
@@ -0,0 +1,91 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2020 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <crispy/lru_cache.h>
+
+#include <catch2/catch.hpp>
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+using namespace std;
+
+namespace
+{
+    vector<string> keys(crispy::lru_cache<string, int> const& _cache)
+    {
+        auto result = vector<string>{};
+        for (auto const& entry : _cache)
+            result.push_back(entry.key);
+        return result;
+    }
+}
+
+TEST_CASE("lru_cache.entry_limit")
+{
+    auto cache = crispy::lru_cache<string, int>(2, 1000);
+    cache.insert(1, "a", 1, 1);
+    cache.insert(2, "b", 2, 1);
+
+    // Probing does not require constructing a key.
+    REQUIRE(cache.find(1, string_view{"a"}) != nullptr);
+    CHECK(*cache.find(1, string_view{"a"}) == 1);
+    CHECK(keys(cache) == vector<string>{"a", "b"});
+
+    // Testing for an entry does not mark it as used.
+    CHECK(cache.contains(2, string_view{"b"}));
+    CHECK(keys(cache) == vector<string>{"a", "b"});
+
+    cache.insert(3, "c", 3, 1);
+    CHECK(keys(cache) == vector<string>{"c", "a"});
+    CHECK(cache.find(2, string_view{"b"}) == nullptr);
+    CHECK(cache.evictions() == 1);
+    CHECK(cache.hits() == 2);
+    CHECK(cache.misses() == 1);
+}
+
+TEST_CASE("lru_cache.byte_limit")
+{
+    auto cache = crispy::lru_cache<string, int>(100, 10);
+    cache.insert(1, "a", 1, 4);
+    cache.insert(2, "b", 2, 4);
+    CHECK(cache.bytes() == 8);
+
+    cache.insert(3, "c", 3, 4);
+    CHECK(keys(cache) == vector<string>{"c", "b"});
+    CHECK(cache.bytes() == 8);
+
+    // An oversized entry evicts all others, but is kept itself.
+    cache.insert(4, "d", 4, 20);
+    CHECK(keys(cache) == vector<string>{"d"});
+    CHECK(cache.bytes() == 20);
+    CHECK(cache.evictions() == 3);
+}
+
+TEST_CASE("lru_cache.hash_collision")
+{
+    auto cache = crispy::lru_cache<string, int>(10, 100);
+    cache.insert(7, "a", 1, 1);
+
+    // Same hash but different key is a miss, and inserting it replaces the other entry.
+    CHECK(cache.find(7, string_view{"b"}) == nullptr);
+    cache.insert(7, "b", 2, 1);
+    CHECK(keys(cache) == vector<string>{"b"});
+    CHECK(cache.bytes() == 1);
+    CHECK(cache.evictions() == 0);
+
+    cache.clear();
+    CHECK(cache.empty());
+    CHECK(cache.bytes() == 0);
+}
@@ -0,0 +1,193 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2020 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace crispy {
+
+/// Read-only view of a file's contents, memory mapped where the platform supports it
+/// and read into memory otherwise.
+class mapped_file {
+  public:
+    /// @returns the mapped file or std::nullopt if it could not be opened.
+    static std::optional<mapped_file> open(std::string const& _path)
+    {
+#if defined(__unix__) || defined(__APPLE__)
+        int const fd = ::open(_path.c_str(), O_RDONLY);
+        if (fd < 0)
+            return std::nullopt;
+
+        struct stat st{};
+        if (fstat(fd, &st) != 0 || st.st_size <= 0)
+        {
+            ::close(fd);
+            return std::nullopt;
+        }
+
+        auto const size = static_cast<size_t>(st.st_size);
+        void* data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (data == MAP_FAILED)
+            return std::nullopt;
+
+        return mapped_file{static_cast<uint8_t const*>(data), size};
+#else
+        auto file = std::ifstream(_path, std::ios::binary);
+        if (!file.good())
+            return std::nullopt;
+
+        auto contents = std::vector<uint8_t>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        if (contents.empty())
+            return std::nullopt;
+
+        return mapped_file{std::move(contents)};
+#endif
+    }
+
+#if defined(__unix__) || defined(__APPLE__)
+    /// @returns the first @p _size bytes of the file opened as @p _fd mapped, or std::nullopt if
+    ///          they could not be mapped. The file descriptor may be closed afterwards.
+    static std::optional<mapped_file> map(int _fd, size_t _size)
+    {
+        if (_size == 0)
+            return std::nullopt;
+
+        void* data = mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, _fd, 0);
+        if (data == MAP_FAILED)
+            return std::nullopt;
+
+        return mapped_file{static_cast<uint8_t const*>(data), _size};
+    }
+#endif
+
+    mapped_file(mapped_file&& _other) noexcept :
+        data_{std::exchange(_other.data_, nullptr)},
+        size_{std::exchange(_other.size_, 0)},
+        contents_{std::move(_other.contents_)}
+    {}
+
+    mapped_file& operator=(mapped_file&& _other) noexcept
+    {
+        if (this != &_other)
+        {
+            unmap();
+            data_ = std::exchange(_other.data_, nullptr);
+            size_ = std::exchange(_other.size_, 0);
+            contents_ = std::move(_other.contents_);
+        }
+        return *this;
+    }
+
+    mapped_file(mapped_file const&) = delete;
+    mapped_file& operator=(mapped_file const&) = delete;
+
+    ~mapped_file() { unmap(); }
+
+    uint8_t const* data() const noexcept { return contents_.empty() ? data_ : contents_.data(); }
+    size_t size() const noexcept { return contents_.empty() ? size_ : contents_.size(); }
+
+  private:
+    mapped_file(uint8_t const* _data, size_t _size) : data_{_data}, size_{_size} {}
+    explicit mapped_file(std::vector<uint8_t> _contents) : contents_{std::move(_contents)} {}
+
+    void unmap() noexcept
+    {
+#if defined(__unix__) || defined(__APPLE__)
+        if (data_)
+            munmap(const_cast<uint8_t*>(data_), size_);
+#endif
+        data_ = nullptr;
+        size_ = 0;
+    }
+
+    uint8_t const* data_ = nullptr;  // mapped memory, if any
+    size_t size_ = 0;
+    std::vector<uint8_t> contents_;  // file contents read into memory, if not mapped
+};
+
+/// Replaces the file at @p _path with @p _size bytes of @p _data, such that concurrent readers
+/// either see the previous or the new contents, but never a partially written file.
+///
+/// @param _mode permissions of the file (minus the umask) on Unix, such as 0600 for a file that
+///              only its owner may read.
+///
+/// @retval false the file could not be written.
+inline bool replace_file(std::string const& _path, void const* _data, size_t _size, unsigned _mode = 0666)
+{
+#if defined(__unix__) || defined(__APPLE__)
+    // Created anew, rather than truncated, such that the file never has other permissions.
+    auto const temporary = _path + ".tmp." + std::to_string(getpid());
+    std::remove(temporary.c_str());
+    int const fd = ::open(temporary.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, static_cast<mode_t>(_mode));
+    if (fd < 0)
+        return false;
+
+    auto const* data = static_cast<char const*>(_data);
+    auto remaining = _size;
+    while (remaining > 0)
+    {
+        auto const n = ::write(fd, data, remaining);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            break;
+        data += n;
+        remaining -= static_cast<size_t>(n);
+    }
+    if (::close(fd) != 0 || remaining > 0)
+    {
+        std::remove(temporary.c_str());
+        return false;
+    }
+#else
+    (void) _mode;
+    auto const temporary = _path + ".tmp";
+    auto file = std::ofstream(temporary, std::ios::binary | std::ios::trunc);
+    file.write(static_cast<char const*>(_data), static_cast<std::streamsize>(_size));
+    file.close();
+    if (file.fail())
+    {
+        std::remove(temporary.c_str());
+        return false;
+    }
+    std::remove(_path.c_str()); // std::rename() does not replace existing files here
+#endif
+
+    if (std::rename(temporary.c_str(), _path.c_str()) != 0)
+    {
+        std::remove(temporary.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+} // end namespace
@@ -0,0 +1,56 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2020 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <crispy/mapped_file.h>
+#include <crispy/stdfs.h>
+
+#include <catch2/catch.hpp>
+
+#include <string>
+#include <string_view>
+
+using namespace std;
+
+namespace
+{
+    string_view contents(crispy::mapped_file const& _file)
+    {
+        return string_view(reinterpret_cast<char const*>(_file.data()), _file.size());
+    }
+}
+
+TEST_CASE("mapped_file.replace_and_open")
+{
+    auto const path = (FileSystem::temp_directory_path() / "crispy_mapped_file_test.bin").string();
+    std::remove(path.c_str());
+
+    CHECK_FALSE(crispy::mapped_file::open(path).has_value());
+
+    REQUIRE(crispy::replace_file(path, "Hello", 5));
+    auto file = crispy::mapped_file::open(path);
+    REQUIRE(file.has_value());
+    CHECK(contents(*file) == "Hello");
+
+    // Replacing does not affect the contents seen through an existing mapping.
+    REQUIRE(crispy::replace_file(path, "World!", 6));
+    CHECK(contents(*file) == "Hello");
+
+    auto moved = std::move(*file);
+    CHECK(contents(moved) == "Hello");
+
+    file = crispy::mapped_file::open(path);
+    REQUIRE(file.has_value());
+    CHECK(contents(*file) == "World!");
+
+    std::remove(path.c_str());
+}
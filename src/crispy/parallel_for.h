@@ -0,0 +1,138 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2020 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace crispy {
+
+/// Runs the iterations of a loop on a fixed set of threads, the calling thread taking part.
+///
+/// The threads are kept across runs, sleeping in between, such that short loops run every frame
+/// do not pay for creating threads.
+class parallel_for_pool {
+  public:
+    /// @param _threadCount number of threads running iterations, including the calling thread.
+    explicit parallel_for_pool(unsigned _threadCount)
+    {
+        for (unsigned i = 1; i < _threadCount; ++i)
+            workers_.emplace_back(&parallel_for_pool::work, this);
+    }
+
+    ~parallel_for_pool()
+    {
+        {
+            auto const _l = std::scoped_lock{mutex_};
+            quit_ = true;
+        }
+        wakeup_.notify_all();
+        for (std::thread& worker : workers_)
+            worker.join();
+    }
+
+    parallel_for_pool(parallel_for_pool const&) = delete;
+    parallel_for_pool& operator=(parallel_for_pool const&) = delete;
+
+    unsigned thread_count() const noexcept { return static_cast<unsigned>(workers_.size()) + 1; }
+
+    /// Invokes @p _body(i) for each i in [0, @p _count), in any order and on any of the threads,
+    /// blocking until all iterations are done.
+    ///
+    /// The body is referred to rather than copied, such that running does not allocate.
+    template <typename Body>
+    void run(size_t _count, Body const& _body)
+    {
+        if (_count < 2 || workers_.empty())
+        {
+            for (size_t i = 0; i < _count; ++i)
+                _body(i);
+            return;
+        }
+
+        {
+            auto const _l = std::scoped_lock{mutex_};
+            body_ = body_ref{&_body, [](void const* _object, size_t _i) { (*static_cast<Body const*>(_object))(_i); }};
+            count_ = _count;
+            next_ = 0;
+            busyWorkers_ = workers_.size();
+            ++generation_;
+        }
+        wakeup_.notify_all();
+
+        iterate(body_, _count);
+
+        auto lock = std::unique_lock{mutex_};
+        done_.wait(lock, [&]() { return busyWorkers_ == 0; });
+        body_ = body_ref{};
+    }
+
+  private:
+    struct body_ref {
+        void const* object = nullptr;
+        void (*invoke)(void const*, size_t) = nullptr;
+    };
+
+    void iterate(body_ref _body, size_t _count)
+    {
+        for (auto i = next_++; i < _count; i = next_++)
+            _body.invoke(_body.object, i);
+    }
+
+    void work()
+    {
+        auto generation = uint64_t{0};
+        for (;;)
+        {
+            auto body = body_ref{};
+            auto count = size_t{0};
+            {
+                auto lock = std::unique_lock{mutex_};
+                wakeup_.wait(lock, [&]() { return quit_ || generation_ != generation; });
+                if (quit_)
+                    return;
+                generation = generation_;
+                body = body_;
+                count = count_;
+            }
+
+            iterate(body, count);
+
+            auto const _l = std::scoped_lock{mutex_};
+            if (--busyWorkers_ == 0)
+                done_.notify_one();
+        }
+    }
+
+    std::vector<std::thread> workers_;
+
+    std::mutex mutex_;
+    std::condition_variable wakeup_;
+    std::condition_variable done_;
+    uint64_t generation_ = 0;
+    size_t busyWorkers_ = 0;
+    bool quit_ = false;
+
+    // state of the current run
+    body_ref body_;
+    size_t count_ = 0;
+    std::atomic<size_t> next_ = 0;
+};
+
+} // end namespace
@@ -0,0 +1,46 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2020 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <crispy/parallel_for.h>
+
+#include <catch2/catch.hpp>
+
+#include <atomic>
+#include <vector>
+
+using namespace std;
+
+TEST_CASE("parallel_for_pool.each_iteration_once")
+{
+    auto pool = crispy::parallel_for_pool(4);
+    CHECK(pool.thread_count() == 4);
+
+    // Runs follow each other with the same threads.
+    for (size_t count : {0u, 1u, 2u, 100u, 1000u})
+    {
+        auto visits = vector<atomic<int>>(count);
+        pool.run(count, [&](size_t i) { ++visits[i]; });
+        for (size_t i = 0; i < count; ++i)
+            CHECK(visits[i] == 1);
+    }
+}
+
+TEST_CASE("parallel_for_pool.single_thread")
+{
+    auto pool = crispy::parallel_for_pool(1);
+    CHECK(pool.thread_count() == 1);
+
+    auto order = vector<size_t>{};
+    pool.run(3, [&](size_t i) { order.push_back(i); });
+    CHECK(order == vector<size_t>{0, 1, 2});
+}
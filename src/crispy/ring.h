@@ -0,0 +1,284 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2020 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace crispy {
+
+template <typename T, typename Ring>
+struct ring_iterator {
+    using iterator_category = std::random_access_iterator_tag;
+    using value_type = std::remove_cv_t<T>;
+    using difference_type = std::ptrdiff_t;
+    using pointer = T*;
+    using reference = T&;
+
+    Ring* ring{};
+    difference_type current{};
+
+    constexpr ring_iterator() noexcept = default;
+    constexpr ring_iterator(Ring* _ring, difference_type _current) noexcept : ring{_ring}, current{_current} {}
+
+    /// Allows implicit conversion from iterator to const_iterator.
+    template <typename U, typename R, std::enable_if_t<std::is_convertible_v<U*, T*>, int> = 0>
+    constexpr ring_iterator(ring_iterator<U, R> const& _other) noexcept : ring{_other.ring}, current{_other.current} {}
+
+    reference operator*() const noexcept { return (*ring)[static_cast<size_t>(current)]; }
+    pointer operator->() const noexcept { return &**this; }
+    reference operator[](difference_type _n) const noexcept { return *(*this + _n); }
+
+    ring_iterator& operator++() noexcept { ++current; return *this; }
+    ring_iterator& operator--() noexcept { --current; return *this; }
+    ring_iterator operator++(int) noexcept { auto old = *this; ++current; return old; }
+    ring_iterator operator--(int) noexcept { auto old = *this; --current; return old; }
+
+    ring_iterator& operator+=(difference_type _n) noexcept { current += _n; return *this; }
+    ring_iterator& operator-=(difference_type _n) noexcept { current -= _n; return *this; }
+
+    friend ring_iterator operator+(ring_iterator _a, difference_type _n) noexcept { return _a += _n; }
+    friend ring_iterator operator+(difference_type _n, ring_iterator _a) noexcept { return _a += _n; }
+    friend ring_iterator operator-(ring_iterator _a, difference_type _n) noexcept { return _a -= _n; }
+    friend difference_type operator-(ring_iterator const& _a, ring_iterator const& _b) noexcept { return _a.current - _b.current; }
+
+    friend bool operator==(ring_iterator const& _a, ring_iterator const& _b) noexcept { return _a.current == _b.current; }
+    friend bool operator!=(ring_iterator const& _a, ring_iterator const& _b) noexcept { return _a.current != _b.current; }
+    friend bool operator<(ring_iterator const& _a, ring_iterator const& _b) noexcept { return _a.current < _b.current; }
+    friend bool operator<=(ring_iterator const& _a, ring_iterator const& _b) noexcept { return _a.current <= _b.current; }
+    friend bool operator>(ring_iterator const& _a, ring_iterator const& _b) noexcept { return _a.current > _b.current; }
+    friend bool operator>=(ring_iterator const& _a, ring_iterator const& _b) noexcept { return _a.current >= _b.current; }
+};
+
+/// Sequence container of contiguously stored elements with a movable start offset.
+///
+/// Rotating the ring (e.g. scrolling a grid of lines) is O(1) and does neither move
+/// nor reallocate any element. Element access is random access with an additional
+/// wrap-around adjustment of the index.
+///
+/// Insertion and removal at either end are supported but linearize the underlying
+/// storage first and are thus O(n).
+template <typename T>
+class ring {
+  public:
+    using value_type = T;
+    using size_type = size_t;
+    using difference_type = std::ptrdiff_t;
+    using reference = T&;
+    using const_reference = T const&;
+    using iterator = ring_iterator<T, ring<T>>;
+    using const_iterator = ring_iterator<T const, ring<T> const>;
+    using reverse_iterator = std::reverse_iterator<iterator>;
+    using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+
+    ring() = default;
+    ring(size_t _count, T const& _value) : storage_(_count, _value) {}
+    explicit ring(size_t _count) : storage_(_count) {}
+
+    ring(ring const&) = default;
+    ring(ring&&) noexcept = default;
+    ring& operator=(ring const&) = default;
+    ring& operator=(ring&&) noexcept = default;
+
+    size_t size() const noexcept { return storage_.size(); }
+    bool empty() const noexcept { return storage_.empty(); }
+
+    reference operator[](size_t _i) noexcept { return storage_[physicalIndex(_i)]; }
+    const_reference operator[](size_t _i) const noexcept { return storage_[physicalIndex(_i)]; }
+
+    reference at(size_t _i)
+    {
+        if (_i >= size())
+            throw std::out_of_range("crispy::ring::at");
+        return (*this)[_i];
+    }
+
+    const_reference at(size_t _i) const
+    {
+        if (_i >= size())
+            throw std::out_of_range("crispy::ring::at");
+        return (*this)[_i];
+    }
+
+    reference front() noexcept { return (*this)[0]; }
+    const_reference front() const noexcept { return (*this)[0]; }
+    reference back() noexcept { return (*this)[size() - 1]; }
+    const_reference back() const noexcept { return (*this)[size() - 1]; }
+
+    iterator begin() noexcept { return iterator{this, 0}; }
+    iterator end() noexcept { return iterator{this, static_cast<difference_type>(size())}; }
+    const_iterator begin() const noexcept { return const_iterator{this, 0}; }
+    const_iterator end() const noexcept { return const_iterator{this, static_cast<difference_type>(size())}; }
+    const_iterator cbegin() const noexcept { return begin(); }
+    const_iterator cend() const noexcept { return end(); }
+
+    reverse_iterator rbegin() noexcept { return reverse_iterator{end()}; }
+    reverse_iterator rend() noexcept { return reverse_iterator{begin()}; }
+    const_reverse_iterator rbegin() const noexcept { return const_reverse_iterator{end()}; }
+    const_reverse_iterator rend() const noexcept { return const_reverse_iterator{begin()}; }
+
+    /// Rotates the ring such that the element at index @p _count becomes the first one.
+    void rotate_left(size_t _count) noexcept
+    {
+        if (!empty())
+            zero_ = (zero_ + _count) % size();
+    }
+
+    /// Rotates the ring such that the last @p _count elements become the first ones.
+    void rotate_right(size_t _count) noexcept
+    {
+        if (!empty())
+            zero_ = (zero_ + size() - _count % size()) % size();
+    }
+
+    /// Rotates the elements in [_first, _last) such that the element at index @p _first + @p _count
+    /// becomes the element at index @p _first. Elements outside of that range keep their position.
+    ///
+    /// This rotates the whole ring in O(1) and then restores the elements outside of the range,
+    /// if that is cheaper than moving the elements inside of it, e.g. for a scroll region that
+    /// covers all but a status line.
+    void rotate_left(size_t _first, size_t _last, size_t _count)
+    {
+        auto const length = _last - _first;
+        _count %= std::max(length, size_t{1});
+        if (_count == 0)
+            return;
+
+        auto const outside = size() - length;
+        if (outside + _count >= length)
+        {
+            std::rotate(iterator{this, offset(_first)}, iterator{this, offset(_first + _count)}, iterator{this, offset(_last)});
+            return;
+        }
+
+        // After rotating everything, the outside elements are followed by the _count elements that
+        // wrapped around within the range, starting at _last - _count (modulo size()).
+        rotate_left(_count);
+        rotate_segment((_last - _count) % size(), outside + _count, outside);
+    }
+
+    /// Rotates the elements in [_first, _last) such that the last @p _count elements of that range
+    /// become its first ones. Elements outside of that range keep their position.
+    void rotate_right(size_t _first, size_t _last, size_t _count)
+    {
+        auto const length = _last - _first;
+        _count %= std::max(length, size_t{1});
+        if (_count == 0)
+            return;
+
+        auto const outside = size() - length;
+        if (outside + _count >= length)
+        {
+            std::rotate(iterator{this, offset(_first)}, iterator{this, offset(_last - _count)}, iterator{this, offset(_last)});
+            return;
+        }
+
+        // After rotating everything, the _count elements that wrapped around within the range
+        // are followed by the outside elements, starting at _last (modulo size()).
+        rotate_right(_count);
+        rotate_segment(_last % size(), _count + outside, _count);
+    }
+
+    // {{{ O(n) modifiers
+    template <typename... Args>
+    reference emplace_back(Args&&... _args)
+    {
+        linearize();
+        return storage_.emplace_back(std::forward<Args>(_args)...);
+    }
+
+    template <typename... Args>
+    reference emplace_front(Args&&... _args)
+    {
+        linearize();
+        return *storage_.emplace(storage_.begin(), std::forward<Args>(_args)...);
+    }
+
+    void push_back(T const& _value) { emplace_back(_value); }
+    void push_back(T&& _value) { emplace_back(std::move(_value)); }
+    void push_front(T const& _value) { emplace_front(_value); }
+    void push_front(T&& _value) { emplace_front(std::move(_value)); }
+
+    void pop_front()
+    {
+        linearize();
+        storage_.erase(storage_.begin());
+    }
+
+    void pop_back()
+    {
+        linearize();
+        storage_.pop_back();
+    }
+
+    void resize(size_t _count)
+    {
+        linearize();
+        storage_.resize(_count);
+    }
+
+    void clear() noexcept
+    {
+        storage_.clear();
+        zero_ = 0;
+    }
+    // }}}
+
+  private:
+    size_t physicalIndex(size_t _i) const noexcept
+    {
+        auto const i = zero_ + _i;
+        return i < storage_.size() ? i : i - storage_.size();
+    }
+
+    static constexpr difference_type offset(size_t _i) noexcept { return static_cast<difference_type>(_i); }
+
+    /// Rotates the @p _length elements starting at index @p _start, wrapping around the end of the ring,
+    /// such that the element at @p _start + @p _count becomes the first one.
+    void rotate_segment(size_t _start, size_t _length, size_t _count)
+    {
+        if (_count == 0 || _count == _length)
+            return;
+
+        rotate_left(_start);
+        std::rotate(begin(), iterator{this, offset(_count)}, iterator{this, offset(_length)});
+        rotate_right(_start);
+    }
+
+    /// Rearranges the storage such that logical and physical indices match again.
+    void linearize()
+    {
+        std::rotate(storage_.begin(), std::next(storage_.begin(), static_cast<difference_type>(zero_)), storage_.end());
+        zero_ = 0;
+    }
+
+    std::vector<T> storage_;
+    size_t zero_ = 0;
+};
+
+template <typename T> auto begin(ring<T>& _ring) noexcept { return _ring.begin(); }
+template <typename T> auto end(ring<T>& _ring) noexcept { return _ring.end(); }
+template <typename T> auto begin(ring<T> const& _ring) noexcept { return _ring.cbegin(); }
+template <typename T> auto end(ring<T> const& _ring) noexcept { return _ring.cend(); }
+template <typename T> auto rbegin(ring<T>& _ring) noexcept { return _ring.rbegin(); }
+template <typename T> auto rend(ring<T>& _ring) noexcept { return _ring.rend(); }
+template <typename T> auto rbegin(ring<T> const& _ring) noexcept { return _ring.rbegin(); }
+template <typename T> auto rend(ring<T> const& _ring) noexcept { return _ring.rend(); }
+
+} // end namespace
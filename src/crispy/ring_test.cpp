@@ -0,0 +1,106 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2020 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <crispy/ring.h>
+
+#include <catch2/catch.hpp>
+
+#include <algorithm>
+#include <vector>
+
+using namespace std;
+
+namespace
+{
+    template <typename T>
+    vector<T> toVector(crispy::ring<T> const& _ring)
+    {
+        return vector<T>(_ring.begin(), _ring.end());
+    }
+}
+
+TEST_CASE("ring.rotate")
+{
+    auto ring = crispy::ring<int>(4, 0);
+    for (size_t i = 0; i < ring.size(); ++i)
+        ring[i] = static_cast<int>(i);
+
+    ring.rotate_left(1);
+    CHECK(toVector(ring) == vector{1, 2, 3, 0});
+    CHECK(ring.front() == 1);
+    CHECK(ring.back() == 0);
+
+    ring.rotate_left(6);
+    CHECK(toVector(ring) == vector{3, 0, 1, 2});
+
+    ring.rotate_right(2);
+    CHECK(toVector(ring) == vector{1, 2, 3, 0});
+
+    CHECK(vector<int>(ring.rbegin(), ring.rend()) == vector{0, 3, 2, 1});
+}
+
+TEST_CASE("ring.rotate_range")
+{
+    auto ring = crispy::ring<int>(8, 0);
+    auto reference = vector<int>(8, 0);
+    for (size_t i = 0; i < ring.size(); ++i)
+        reference[i] = ring[i] = static_cast<int>(i);
+
+    // Exercises both, moving the range's elements and restoring the ones outside of it.
+    ring.rotate_left(3);
+    std::rotate(reference.begin(), next(reference.begin(), 3), reference.end());
+
+    for (size_t first = 0; first < ring.size(); ++first)
+    {
+        for (size_t last = first + 1; last <= ring.size(); ++last)
+        {
+            for (size_t count = 0; count < last - first; ++count)
+            {
+                auto const a = next(reference.begin(), static_cast<ptrdiff_t>(first));
+                auto const b = next(reference.begin(), static_cast<ptrdiff_t>(last));
+
+                ring.rotate_left(first, last, count);
+                std::rotate(a, next(a, static_cast<ptrdiff_t>(count)), b);
+                REQUIRE(toVector(ring) == reference);
+
+                ring.rotate_right(first, last, count);
+                std::rotate(a, prev(b, static_cast<ptrdiff_t>(count)), b);
+                REQUIRE(toVector(ring) == reference);
+            }
+        }
+    }
+
+    ring.rotate_left(0, 7, 2);
+    CHECK(toVector(ring) == vector{5, 6, 7, 0, 1, 3, 4, 2});
+}
+
+TEST_CASE("ring.modifiers")
+{
+    auto ring = crispy::ring<int>(3, 0);
+    ring[1] = 1;
+    ring[2] = 2;
+    ring.rotate_left(2);
+
+    ring.push_back(3);
+    ring.push_front(4);
+    CHECK(toVector(ring) == vector{4, 2, 0, 1, 3});
+
+    ring.pop_front();
+    ring.pop_back();
+    CHECK(toVector(ring) == vector{2, 0, 1});
+    CHECK(ring.at(2) == 1);
+    CHECK_THROWS_AS(ring.at(3), std::out_of_range);
+
+    std::rotate(ring.begin(), next(ring.begin()), ring.end());
+    CHECK(toVector(ring) == vector{0, 1, 2});
+}
@@ -0,0 +1,158 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2020 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <optional>
+#include <vector>
+
+namespace crispy {
+
+/// Packs rectangles into a fixed size area, using the skyline bottom-left heuristic.
+///
+/// The skyline is the upper contour of all rectangles placed so far. Each rectangle is placed on
+/// top of the skyline where its top edge ends up lowest, preferring the narrowest fitting segment.
+class skyline_packer {
+  public:
+    struct point {
+        unsigned x;
+        unsigned y;
+
+        bool operator==(point const& _rhs) const noexcept { return x == _rhs.x && y == _rhs.y; }
+    };
+
+    skyline_packer(unsigned _width, unsigned _height) :
+        width_{_width},
+        height_{_height}
+    {
+        clear();
+    }
+
+    unsigned width() const noexcept { return width_; }
+    unsigned height() const noexcept { return height_; }
+
+    /// @returns total area of all rectangles inserted since the last clear().
+    size_t used_area() const noexcept { return usedArea_; }
+
+    void clear()
+    {
+        segments_.clear();
+        segments_.push_back(segment{0, 0, width_});
+        usedArea_ = 0;
+    }
+
+    /// Places a rectangle of given dimensions.
+    ///
+    /// @returns its top left corner or std::nullopt if it does not fit anymore.
+    std::optional<point> insert(unsigned _width, unsigned _height)
+    {
+        if (_width == 0 || _height == 0 || _width > width_ || _height > height_)
+            return std::nullopt;
+
+        auto best = std::optional<size_t>{};
+        auto bestTop = 0u;
+        auto bestWidth = 0u;
+
+        for (size_t i = 0; i < segments_.size(); ++i)
+        {
+            auto const y = fit(i, _width);
+            if (!y.has_value() || *y + _height > height_)
+                continue;
+
+            auto const top = *y + _height;
+            if (!best.has_value() || top < bestTop || (top == bestTop && segments_[i].width < bestWidth))
+            {
+                best = i;
+                bestTop = top;
+                bestWidth = segments_[i].width;
+            }
+        }
+
+        if (!best.has_value())
+            return std::nullopt;
+
+        auto const position = point{segments_[*best].x, bestTop - _height};
+        place(*best, position.x, bestTop, _width);
+        usedArea_ += static_cast<size_t>(_width) * _height;
+        return position;
+    }
+
+  private:
+    struct segment {
+        unsigned x;
+        unsigned y;
+        unsigned width;
+    };
+
+    /// @returns the lowest y a rectangle of width @p _width can be placed at, starting at segment @p _index.
+    std::optional<unsigned> fit(size_t _index, unsigned _width) const
+    {
+        if (segments_[_index].x + _width > width_)
+            return std::nullopt;
+
+        auto y = 0u;
+        auto remaining = static_cast<long>(_width);
+        for (auto i = _index; remaining > 0; ++i)
+        {
+            y = std::max(y, segments_[i].y);
+            remaining -= static_cast<long>(segments_[i].width);
+        }
+        return y;
+    }
+
+    /// Raises the skyline to @p _y over [_x, _x + _width), starting at segment @p _index.
+    void place(size_t _index, unsigned _x, unsigned _y, unsigned _width)
+    {
+        segments_.insert(segments_.begin() + static_cast<long>(_index), segment{_x, _y, _width});
+
+        // Shrink or remove the segments now covered by the new one.
+        auto const right = _x + _width;
+        for (auto i = _index + 1; i < segments_.size();)
+        {
+            auto& s = segments_[i];
+            if (s.x >= right)
+                break;
+
+            auto const end = s.x + s.width;
+            if (end <= right)
+                segments_.erase(segments_.begin() + static_cast<long>(i));
+            else
+            {
+                s.width = end - right;
+                s.x = right;
+                break;
+            }
+        }
+
+        // Merge neighbouring segments of equal height.
+        for (size_t i = 0; i + 1 < segments_.size();)
+        {
+            if (segments_[i].y == segments_[i + 1].y)
+            {
+                segments_[i].width += segments_[i + 1].width;
+                segments_.erase(segments_.begin() + static_cast<long>(i + 1));
+            }
+            else
+                ++i;
+        }
+    }
+
+    unsigned width_;
+    unsigned height_;
+    std::vector<segment> segments_;
+    size_t usedArea_ = 0;
+};
+
+} // end namespace
@@ -0,0 +1,60 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2020 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <crispy/skyline_packer.h>
+
+#include <catch2/catch.hpp>
+
+using crispy::skyline_packer;
+using point = skyline_packer::point;
+
+TEST_CASE("skyline_packer.rows")
+{
+    auto packer = skyline_packer(10, 10);
+    CHECK(packer.insert(4, 3) == point{0, 0});
+    CHECK(packer.insert(4, 2) == point{4, 0});
+
+    // Does not fit the remaining width of 2, thus goes on top of the lowest segment.
+    CHECK(packer.insert(3, 2) == point{4, 2});
+    CHECK(packer.insert(2, 5) == point{8, 0});
+    CHECK(packer.used_area() == 12 + 8 + 6 + 10);
+}
+
+TEST_CASE("skyline_packer.fills_gaps")
+{
+    auto packer = skyline_packer(8, 8);
+    CHECK(packer.insert(2, 6) == point{0, 0});
+    CHECK(packer.insert(6, 2) == point{2, 0});
+
+    // Narrow rectangles end up in the lowest place.
+    CHECK(packer.insert(6, 2) == point{2, 2});
+    CHECK(packer.insert(6, 2) == point{2, 4});
+    CHECK_FALSE(packer.insert(8, 3).has_value());
+    CHECK(packer.insert(8, 2) == point{0, 6});
+    CHECK_FALSE(packer.insert(1, 1).has_value());
+    CHECK(packer.used_area() == 64);
+}
+
+TEST_CASE("skyline_packer.limits")
+{
+    auto packer = skyline_packer(4, 4);
+    CHECK_FALSE(packer.insert(5, 1).has_value());
+    CHECK_FALSE(packer.insert(1, 5).has_value());
+    CHECK_FALSE(packer.insert(0, 1).has_value());
+    CHECK(packer.insert(4, 4) == point{0, 0});
+    CHECK_FALSE(packer.insert(1, 1).has_value());
+
+    packer.clear();
+    CHECK(packer.used_area() == 0);
+    CHECK(packer.insert(4, 4) == point{0, 0});
+}
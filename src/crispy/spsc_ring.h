@@ -0,0 +1,124 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2020 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <crispy/span.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <type_traits>
+#include <vector>
+
+namespace crispy {
+
+/// Lock-free ring buffer for exactly one producer thread and one consumer thread.
+///
+/// The producer fills writable() in-place and publishes it via commit(),
+/// the consumer processes readable() in-place and releases it via consume().
+/// Neither side ever blocks; waiting for data (or space) is up to the caller.
+template <typename T>
+class spsc_ring {
+  public:
+    static_assert(std::is_trivially_copyable_v<T>);
+
+    /// Constructs the ring with at least @p _capacity elements (rounded up to a power of two).
+    explicit spsc_ring(size_t _capacity) :
+        buffer_(roundUpToPowerOfTwo(std::max(_capacity, size_t{1}))),
+        mask_{ buffer_.size() - 1 }
+    {
+    }
+
+    spsc_ring(spsc_ring const&) = delete;
+    spsc_ring& operator=(spsc_ring const&) = delete;
+
+    size_t capacity() const noexcept { return buffer_.size(); }
+    size_t size() const noexcept { return writePos_.load(std::memory_order_acquire) - readPos_.load(std::memory_order_acquire); }
+    bool empty() const noexcept { return size() == 0; }
+    bool full() const noexcept { return size() == capacity(); }
+
+    // {{{ producer side
+    /// @returns the contiguous free region the producer may write to next.
+    span<T> writable() noexcept
+    {
+        auto const w = writePos_.load(std::memory_order_relaxed);
+        auto const r = readPos_.load(std::memory_order_acquire);
+        auto const offset = w & mask_;
+        auto const n = std::min(capacity() - (w - r), capacity() - offset);
+        return span<T>{buffer_.data() + offset, buffer_.data() + offset + n};
+    }
+
+    /// Publishes @p _count elements previously written into writable() to the consumer.
+    void commit(size_t _count) noexcept
+    {
+        writePos_.store(writePos_.load(std::memory_order_relaxed) + _count, std::memory_order_release);
+    }
+
+    /// Copies as many elements of [_data, _data + _count) into the ring as currently fit.
+    ///
+    /// @returns number of elements written.
+    size_t write(T const* _data, size_t _count) noexcept
+    {
+        size_t written = 0;
+        while (written < _count)
+        {
+            auto target = writable();
+            if (target.empty())
+                break;
+            auto const n = std::min(target.size(), _count - written);
+            std::copy_n(_data + written, n, target.begin());
+            commit(n);
+            written += n;
+        }
+        return written;
+    }
+    // }}}
+
+    // {{{ consumer side
+    /// @returns the contiguous region of elements available to the consumer.
+    span<T const> readable() const noexcept
+    {
+        auto const r = readPos_.load(std::memory_order_relaxed);
+        auto const w = writePos_.load(std::memory_order_acquire);
+        auto const offset = r & mask_;
+        auto const n = std::min(w - r, capacity() - offset);
+        return span<T const>{buffer_.data() + offset, buffer_.data() + offset + n};
+    }
+
+    /// Releases @p _count elements previously obtained via readable() back to the producer.
+    void consume(size_t _count) noexcept
+    {
+        readPos_.store(readPos_.load(std::memory_order_relaxed) + _count, std::memory_order_release);
+    }
+    // }}}
+
+  private:
+    static constexpr size_t roundUpToPowerOfTwo(size_t _value) noexcept
+    {
+        size_t n = 1;
+        while (n < _value)
+            n <<= 1;
+        return n;
+    }
+
+    std::vector<T> buffer_;
+    size_t const mask_;
+
+    // Positions grow monotonically and are only reduced modulo capacity on access.
+    // They are kept on separate cache lines to avoid false sharing between both threads.
+    alignas(64) std::atomic<size_t> writePos_{0};
+    alignas(64) std::atomic<size_t> readPos_{0};
+};
+
+} // end namespace
@@ -0,0 +1,76 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2020 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <crispy/spsc_ring.h>
+
+#include <catch2/catch.hpp>
+
+#include <string>
+#include <string_view>
+#include <thread>
+
+using namespace std;
+
+TEST_CASE("spsc_ring.capacity")
+{
+    auto ring = crispy::spsc_ring<char>(5);
+    CHECK(ring.capacity() == 8);
+    CHECK(ring.empty());
+    CHECK(ring.writable().size() == 8);
+    CHECK(ring.readable().empty());
+}
+
+TEST_CASE("spsc_ring.wrap_around")
+{
+    auto ring = crispy::spsc_ring<char>(8);
+
+    REQUIRE(ring.write("abcdef", 6) == 6);
+    ring.consume(4);                        // "ef" remaining at offset 4
+    REQUIRE(ring.write("ghijklmn", 8) == 6); // only 6 free slots left
+    CHECK(ring.full());
+
+    auto const first = ring.readable();     // "efgh" up to the end of the buffer
+    CHECK(string_view(first.begin(), first.size()) == "efgh");
+    ring.consume(first.size());
+
+    auto const second = ring.readable();    // "ijkl" from the start of the buffer
+    CHECK(string_view(second.begin(), second.size()) == "ijkl");
+    ring.consume(second.size());
+
+    CHECK(ring.empty());
+}
+
+TEST_CASE("spsc_ring.threads")
+{
+    auto ring = crispy::spsc_ring<uint32_t>(64);
+    constexpr uint32_t Count = 100000;
+
+    auto producer = thread([&]() {
+        for (uint32_t i = 0; i < Count;)
+            i += static_cast<uint32_t>(ring.write(&i, 1));
+    });
+
+    uint32_t expected = 0;
+    bool inOrder = true;
+    while (expected < Count)
+    {
+        auto const chunk = ring.readable();
+        for (auto const value: chunk)
+            inOrder = inOrder && value == expected++;
+        ring.consume(chunk.size());
+    }
+    producer.join();
+
+    CHECK(inOrder);
+    CHECK(ring.empty());
+}
@@ -17,6 +17,7 @@
 
 #include <fmt/format.h>
 
+#include <algorithm>
 #include <cctype>
 #include <iostream>
 #include <map>
@@ -76,6 +77,7 @@ FT_Face Font::loadFace(ostream* _logger, FT_Library _ft, std::string const& _fon
     {
         if (_logger)
             *_logger << fmt::format("Failed to load font: \"{}\"\n", _fontPath);
+        return nullptr;
     }
 
     FT_Error ec = FT_Select_Charmap(face, FT_ENCODING_UNICODE);
@@ -100,6 +102,16 @@ Font::Font(std::ostream* _logger, FT_Library _ft, FT_Face _face, int _fontSize,
     updateBitmapDimensions();
 }
 
+Font::Font(std::ostream* _logger, FT_Library _ft, int _fontSize, std::string _fontPath) :
+    logger_{ _logger },
+    ft_{ _ft },
+    face_{ nullptr },
+    fontSize_{ _fontSize },
+    filePath_{ move(_fontPath) },
+    hashCode_{ hash<string>{}(filePath_)}
+{
+}
+
 Font::Font(Font&& v) noexcept :
     logger_{ v.logger_ },
     ft_{ v.ft_ },
@@ -108,6 +120,7 @@ Font::Font(Font&& v) noexcept :
     bitmapWidth_{ v.bitmapWidth_ },
     bitmapHeight_{ v.bitmapHeight_ },
     maxAdvance_{ v.maxAdvance_ },
+    loadFailed_{ v.loadFailed_ },
     filePath_{ move(v.filePath_) },
     hashCode_{ v.hashCode_ }
 {
@@ -129,6 +142,7 @@ Font& Font::operator=(Font&& v) noexcept
     face_ = v.face_;
     fontSize_ = v.fontSize_;
     maxAdvance_ = v.maxAdvance_;
+    loadFailed_ = v.loadFailed_;
     bitmapWidth_ = v.bitmapWidth_;
     bitmapHeight_ = v.bitmapHeight_;
     filePath_ = move(v.filePath_);
@@ -152,10 +166,32 @@ Font::~Font()
         FT_Done_Face(face_);
 }
 
+bool Font::load()
+{
+    if (face_)
+        return true;
+
+    if (loadFailed_)
+        return false;
+
+    face_ = loadFace(logger_, ft_, filePath_, fontSize_);
+    if (!face_)
+    {
+        loadFailed_ = true;
+        return false;
+    }
+
+    updateBitmapDimensions();
+    return true;
+}
+
 #define LIBTERMINAL_VIEW_NATURAL_COORDS 1
 
 optional<GlyphBitmap> Font::loadGlyphByIndex(int _glyphIndex)
 {
+    if (!load())
+        return nullopt;
+
     FT_Int32 flags = FT_LOAD_DEFAULT;
     if (FT_HAS_COLOR(face_))
         flags |= FT_LOAD_COLOR;
@@ -209,33 +245,14 @@ optional<GlyphBitmap> Font::loadGlyphByIndex(int _glyphIndex)
     }
     else
     {
-        bitmap.resize(height * width * 4);
-        auto t = bitmap.begin();
+        // Kept in FreeType's BGRA order, the renderer swizzles the channels when sampling.
+        auto const rowSize = static_cast<size_t>(width) * 4;
+        bitmap.resize(height * rowSize);
 #if defined(LIBTERMINAL_VIEW_NATURAL_COORDS) && LIBTERMINAL_VIEW_NATURAL_COORDS
-        auto s = buffer;
-        for (int i = 0; i < width * height; ++i)
-        {
-            // BGRA -> RGBA
-            *t++ = s[2];
-            *t++ = s[1];
-            *t++ = s[0];
-            *t++ = s[3];
-            s += 4;
-        }
+        std::copy_n(buffer, bitmap.size(), bitmap.begin());
 #else
         for (int y = 0; y < height; ++y)
-        {
-            auto s = buffer + (height - y - 1) * width * 4;
-            for (int x = 0; x < width * 4; x += 4)
-            {
-                // BGRA -> RGBA
-                *t++ = s[2];
-                *t++ = s[1];
-                *t++ = s[0];
-                *t++ = s[3];
-                s += 4;
-            }
-        }
+            std::copy_n(buffer + (height - y - 1) * rowSize, rowSize, bitmap.begin() + y * rowSize);
 #endif
     }
 
@@ -271,6 +288,13 @@ bool Font::doSetFontSize(ostream* _logger, FT_Face _face, int _fontSize)
 
 void Font::setFontSize(int _fontSize)
 {
+    // The size of a face not loaded yet is applied once it gets loaded.
+    if (!face_)
+    {
+        fontSize_ = _fontSize;
+        return;
+    }
+
     if (fontSize_ != _fontSize && doSetFontSize(logger_, face_, _fontSize))
     {
         fontSize_ = _fontSize;
@@ -142,6 +142,7 @@ constexpr FontStyle& operator|=(FontStyle& lhs, FontStyle rhs)
     return lhs;
 }
 
+/// Rasterized glyph, with one byte per pixel, or four in BGRA order for color fonts.
 struct GlyphBitmap {
     int width;
     int height;
@@ -157,24 +158,43 @@ struct GlyphPosition {
     uint32_t glyphIndex;
     int cluster;
 
-    GlyphPosition(Font& _font, int _x, int _y, uint32_t _gi, int _cluster) :
-        font{_font}, x{_x}, y{_y}, glyphIndex{_gi}, cluster{_cluster} {}
+    /// Whether the text must not be broken up in front of this glyph's cluster, as shaping
+    /// the two parts on their own would yield different glyphs (e.g. a ligature).
+    bool unsafeToBreak = false;
+
+    GlyphPosition(Font& _font, int _x, int _y, uint32_t _gi, int _cluster, bool _unsafeToBreak = false) :
+        font{_font}, x{_x}, y{_y}, glyphIndex{_gi}, cluster{_cluster}, unsafeToBreak{_unsafeToBreak} {}
 };
 
 using GlyphPositionList = std::vector<GlyphPosition>;
 
 /**
  * Represents one Font face along with support for its fallback fonts.
+ *
+ * A font may be created without its face being opened yet, in which case the face is opened
+ * on first use via load(). The face must be loaded before it or its metrics are accessed.
  */
 class Font {
   public:
     Font(std::ostream* _logger, FT_Library _ft, FT_Face _face, int _fontSize, std::string _fontPath);
+
+    /// Creates a font whose face is opened not before load() is invoked.
+    Font(std::ostream* _logger, FT_Library _ft, int _fontSize, std::string _fontPath);
+
     Font(Font const&) = delete;
     Font& operator=(Font const&) = delete;
     Font(Font&&) noexcept;
     Font& operator=(Font&&) noexcept;
     ~Font();
 
+    /// Opens the font's face, unless done already.
+    ///
+    /// @retval true the face is loaded.
+    /// @retval false the face could not be loaded, also on any later invocation.
+    bool load();
+
+    bool loaded() const noexcept { return face_ != nullptr; }
+
     std::string const& filePath() const noexcept { return filePath_; }
     std::size_t hashCode() const noexcept { return hashCode_; }
 
@@ -217,7 +237,9 @@ class Font {
 
     int bitmapWidth_ = 0;
     int bitmapHeight_ = 0;
-    int maxAdvance_;
+    int maxAdvance_ = 0;
+
+    bool loadFailed_ = false;
 
     std::string filePath_;
     std::size_t hashCode_;
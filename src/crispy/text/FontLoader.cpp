@@ -1,8 +1,13 @@
 #include <crispy/text/FontLoader.h>
 #include <crispy/text/Font.h>
+#include <crispy/FNV.h>
+#include <crispy/mapped_file.h>
 
 #include <fmt/format.h>
 
+#include <chrono>
+#include <memory>
+#include <sstream>
 #include <stdexcept>
 #include <vector>
 #include <iostream>
@@ -20,6 +25,9 @@ namespace crispy::text {
 using namespace std;
 
 namespace {
+    // Resolved fallback lists are resolved again after this time, in order to pick up newly installed fonts.
+    auto constexpr FallbackCacheLifetime = chrono::hours(24);
+
     static bool endsWithIgnoreCase(string const& _text, string const& _suffix)
     {
         if (_text.size() < _suffix.size())
@@ -33,6 +41,19 @@ namespace {
         return true;
     }
 
+    #if defined(HAVE_FONTCONFIG)
+    /// @returns the fontconfig configuration shared by all font loaders of this process, as
+    ///          loading it scans all installed fonts.
+    FcConfig* sharedFontConfig()
+    {
+        static auto const config = unique_ptr<FcConfig, decltype(&FcConfigDestroy)>(
+            FcInitLoadConfigAndFonts(),
+            &FcConfigDestroy
+        );
+        return config.get();
+    }
+    #endif
+
     static vector<string> getFontFilePaths([[maybe_unused]] string const& _fontPattern)
     {
         if (endsWithIgnoreCase(_fontPattern, ".ttf") || endsWithIgnoreCase(_fontPattern, ".otf"))
@@ -41,7 +62,7 @@ namespace {
         #if defined(HAVE_FONTCONFIG)
         string const& pattern = _fontPattern; // TODO: append bold/italic if needed
 
-        FcConfig* fcConfig = FcInitLoadConfigAndFonts();
+        FcConfig* fcConfig = sharedFontConfig();
         FcPattern* fcPattern = FcNameParse((FcChar8 const*) pattern.c_str());
 
         FcDefaultSubstitute(fcPattern);
@@ -69,7 +90,6 @@ namespace {
         FcCharSetDestroy(fcCharSet);
 
         FcPatternDestroy(fcPattern);
-        FcConfigDestroy(fcConfig);
         return paths;
         #endif
 
@@ -89,8 +109,9 @@ namespace {
     }
 }
 
-FontLoader::FontLoader(ostream* _logger) :
+FontLoader::FontLoader(ostream* _logger, FileSystem::path _cacheDirectory) :
     logger_{ _logger },
+    cacheDirectory_{ move(_cacheDirectory) },
     ft_{},
     fonts_{}
 {
@@ -106,16 +127,16 @@ FontLoader::~FontLoader()
 
 FontList FontLoader::load(string const& _fontPattern, int _fontSize)
 {
-    vector<string> const filePaths = getFontFilePaths(_fontPattern);
+    vector<string> const filePaths = resolveFontFilePaths(_fontPattern);
 
     Font* primaryFont = loadFromFilePath(filePaths.front(), _fontSize);
     if (!primaryFont)
         throw runtime_error{fmt::format("Failed to load primary font \"{}\".", _fontPattern)};
 
+    // Fallback fonts are opened once a glyph is shaped with them, as most of them never are.
     FontFallbackList fallbackList;
     for (size_t i = 1; i < filePaths.size(); ++i)
-        if (auto fallbackFont = loadFromFilePath(filePaths[i], _fontSize); fallbackFont != nullptr)
-            fallbackList.push_back(*fallbackFont);
+        fallbackList.push_back(lazyFromFilePath(filePaths[i], _fontSize));
 
     if (logger_)
         *logger_ << fmt::format(
@@ -137,7 +158,7 @@ Font* FontLoader::loadFromFilePath(std::string const& _path, int _fontSize)
     {
         if (k->second.fontSize() != _fontSize)
             k->second.setFontSize(_fontSize);
-        return &k->second;
+        return k->second.load() ? &k->second : nullptr;
     }
 
     if (auto face = Font::loadFace(logger_, ft_, _path, _fontSize); face != nullptr)
@@ -146,4 +167,107 @@ Font* FontLoader::loadFromFilePath(std::string const& _path, int _fontSize)
     return nullptr;
 }
 
+Font& FontLoader::lazyFromFilePath(std::string const& _path, int _fontSize)
+{
+    if (auto k = fonts_.find(_path); k != fonts_.end())
+    {
+        k->second.setFontSize(_fontSize);
+        return k->second;
+    }
+
+    return fonts_.emplace(make_pair(_path, Font(logger_, ft_, _fontSize, _path))).first->second;
+}
+
+vector<string> FontLoader::resolveFontFilePaths(string const& _fontPattern)
+{
+    bool const cacheable = !cacheDirectory_.empty()
+                        && !endsWithIgnoreCase(_fontPattern, ".ttf")
+                        && !endsWithIgnoreCase(_fontPattern, ".otf");
+    if (!cacheable)
+        return getFontFilePaths(_fontPattern);
+
+    if (auto cached = loadCachedFontFilePaths(_fontPattern); cached.has_value())
+        return move(*cached);
+
+    auto filePaths = getFontFilePaths(_fontPattern);
+    if (!filePaths.empty())
+        storeCachedFontFilePaths(_fontPattern, filePaths);
+
+    return filePaths;
+}
+
+FileSystem::path FontLoader::fallbackCachePath(string const& _fontPattern) const
+{
+    // 64-bit FNV-1a
+    auto constexpr fnv = FNV<uint64_t>{1099511628211llu, 14695981039346656037llu};
+    auto hash = uint64_t{14695981039346656037llu};
+    for (char const ch : _fontPattern)
+        hash = fnv(hash, static_cast<uint8_t>(ch));
+
+    return cacheDirectory_ / fmt::format("fallbacks-{:016x}.txt", hash);
+}
+
+optional<vector<string>> FontLoader::loadCachedFontFilePaths(string const& _fontPattern) const
+{
+    // The cache file consists of the font pattern, the time it has been resolved at in seconds
+    // since epoch, and one line per font file, holding its size and path, separated by a tab.
+    auto const file = mapped_file::open(fallbackCachePath(_fontPattern).string());
+    if (!file.has_value())
+        return nullopt;
+
+    auto input = istringstream(string(reinterpret_cast<char const*>(file->data()), file->size()));
+
+    string pattern;
+    string timestamp;
+    if (!getline(input, pattern) || pattern != _fontPattern || !getline(input, timestamp))
+        return nullopt;
+
+    auto const now = chrono::duration_cast<chrono::seconds>(chrono::system_clock::now().time_since_epoch());
+    auto const resolvedAt = chrono::seconds(strtoll(timestamp.c_str(), nullptr, 10));
+    if (now - resolvedAt > FallbackCacheLifetime || resolvedAt > now)
+        return nullopt;
+
+    // Any font file having vanished or changed invalidates the list.
+    vector<string> filePaths;
+    for (string line; getline(input, line);)
+    {
+        auto const tab = line.find('\t');
+        if (tab == string::npos)
+            return nullopt;
+
+        auto const path = line.substr(tab + 1);
+        auto ec = FileSystemError{};
+        auto const size = FileSystem::file_size(path, ec);
+        if (ec || size != strtoull(line.c_str(), nullptr, 10))
+            return nullopt;
+
+        filePaths.emplace_back(path);
+    }
+
+    if (filePaths.empty())
+        return nullopt;
+
+    return filePaths;
+}
+
+void FontLoader::storeCachedFontFilePaths(string const& _fontPattern, vector<string> const& _filePaths) const
+{
+    auto const now = chrono::duration_cast<chrono::seconds>(chrono::system_clock::now().time_since_epoch());
+
+    auto output = fmt::format("{}\n{}\n", _fontPattern, now.count());
+    for (string const& path : _filePaths)
+    {
+        auto ec = FileSystemError{};
+        auto const size = FileSystem::file_size(path, ec);
+        if (ec)
+            return;
+        output += fmt::format("{}\t{}\n", size, path);
+    }
+
+    auto ec = FileSystemError{};
+    FileSystem::create_directories(cacheDirectory_, ec);
+    if (!replace_file(fallbackCachePath(_fontPattern).string(), output.data(), output.size()) && logger_)
+        *logger_ << fmt::format("FontLoader: failed to write font fallback cache to {}\n", cacheDirectory_.string());
+}
+
 } // end namespace
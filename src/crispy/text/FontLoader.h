@@ -14,6 +14,7 @@
 #pragma once
 
 #include <crispy/reference.h>
+#include <crispy/stdfs.h>
 #include <crispy/text/Font.h>
 
 #include <ft2build.h>
@@ -27,15 +28,19 @@
 
 #include <functional>
 #include <iosfwd>
+#include <optional>
 #include <string>
 #include <unordered_map>
+#include <vector>
 
 namespace crispy::text {
 
 /// API for managing multiple fonts.
 class FontLoader {
   public:
-    explicit FontLoader(std::ostream* logger = nullptr);
+    /// @param _cacheDirectory directory to keep the resolved font fallback lists in across
+    ///                        processes, or empty for resolving them on every load.
+    explicit FontLoader(std::ostream* logger = nullptr, FileSystem::path _cacheDirectory = {});
     FontLoader(FontLoader&&) = delete;
     FontLoader(FontLoader const&) = delete;
     FontLoader& operator=(FontLoader&&) = delete;
@@ -46,9 +51,16 @@ class FontLoader {
 
   private:
     Font* loadFromFilePath(std::string const& _filePath, int _fontSize);
+    Font& lazyFromFilePath(std::string const& _filePath, int _fontSize);
+
+    std::vector<std::string> resolveFontFilePaths(std::string const& _fontPattern);
+    FileSystem::path fallbackCachePath(std::string const& _fontPattern) const;
+    std::optional<std::vector<std::string>> loadCachedFontFilePaths(std::string const& _fontPattern) const;
+    void storeCachedFontFilePaths(std::string const& _fontPattern, std::vector<std::string> const& _filePaths) const;
 
   private:
     std::ostream* logger_;
+    FileSystem::path cacheDirectory_;
     FT_Library ft_;
     std::unordered_map<std::string, Font> fonts_;
 };
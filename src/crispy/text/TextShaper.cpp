@@ -20,9 +20,11 @@
 
 #include <harfbuzz/hb.h>
 #include <harfbuzz/hb-ft.h>
+#include <harfbuzz/hb-ot.h>
 
 #include <fmt/format.h>
 
+#include <algorithm>
 #include <iostream>
 #include <functional>
 
@@ -36,6 +38,44 @@ namespace
     {
         return _gp.glyphIndex == 0;
     }
+
+    /// Tests whether the codepoint is invisible by default (joiners and variation selectors),
+    /// and therefore does not need to be covered by a font.
+    constexpr bool isDefaultIgnorable(char32_t _codepoint) noexcept
+    {
+        return _codepoint == 0x200C
+            || _codepoint == 0x200D
+            || (_codepoint >= 0xFE00 && _codepoint <= 0xFE0F)
+            || (_codepoint >= 0xE0100 && _codepoint <= 0xE01EF);
+    }
+
+    /// Tests whether the font has any substitution feature that is applied by default
+    /// and may therefore substitute even plain ASCII text.
+    bool hasDefaultSubstitutions(hb_face_t* _face)
+    {
+        auto constexpr features = std::array{
+            HB_TAG('l', 'i', 'g', 'a'),
+            HB_TAG('c', 'l', 'i', 'g'),
+            HB_TAG('c', 'a', 'l', 't'),
+            HB_TAG('r', 'l', 'i', 'g'),
+            HB_TAG('c', 'c', 'm', 'p'),
+            HB_TAG('l', 'o', 'c', 'l'),
+        };
+
+        auto tags = std::array<hb_tag_t, 32>{};
+        auto offset = 0u;
+        for (;;)
+        {
+            auto count = static_cast<unsigned>(tags.size());
+            auto const total = hb_ot_layout_table_get_feature_tags(_face, HB_OT_TAG_GSUB, offset, &count, tags.data());
+            for (auto const i : times(count))
+                if (crispy::any_of(features, [&](hb_tag_t _feature) { return _feature == tags[i]; }))
+                    return true;
+            offset += count;
+            if (count == 0 || offset >= total)
+                return false;
+        }
+    }
 }
 
 TextShaper::TextShaper()
@@ -58,31 +98,108 @@ GlyphPositionList TextShaper::shape(unicode::Script _script,
                                     int _clusterGap)
 {
     GlyphPositionList glyphPositions;
+    GlyphPositionList segmentPositions;
+
+    auto const shapeSegment = [&](int _start, int _end, Font* _font) {
+        // Codepoints not covered by any font are rendered with the primary font's missing glyph.
+        Font& font = _font ? *_font : _fonts.first.get();
+        auto const count = _end - _start;
+        if (!shape(count, _codepoints + _start, _clusters + _start, _clusterGap, _script, font, _advanceX, ref(segmentPositions)))
+        {
+#if !defined(NDEBUG)
+            string joinedCodes;
+            for (char32_t codepoint : crispy::span(_codepoints + _start, _codepoints + _end))
+            {
+                if (!joinedCodes.empty())
+                    joinedCodes += " ";
+                joinedCodes += fmt::format("{:<6x}", static_cast<unsigned>(codepoint));
+            }
+            cerr << fmt::format("Shaping failed codepoints: {}\n", joinedCodes);
+#endif
+            replaceMissingGlyphs(font, segmentPositions);
+        }
+
+        if (glyphPositions.empty())
+            swap(glyphPositions, segmentPositions);
+        else
+            glyphPositions.insert(glyphPositions.end(), segmentPositions.begin(), segmentPositions.end());
+    };
+
+    // Runs are segmented by font up front, so that every codepoint is shaped exactly once.
+    auto segmentStart = 0;
+    Font* segmentFont = nullptr;
+    for (auto i = 0; i < _size;)
+    {
+        auto clusterEnd = i + 1;
+        while (clusterEnd < _size && _clusters[clusterEnd] == _clusters[i])
+            ++clusterEnd;
+
+        Font* font = coveringFont(_fonts, _codepoints + i, clusterEnd - i);
+        if (i == 0)
+            segmentFont = font;
+        else if (font != segmentFont)
+        {
+            shapeSegment(segmentStart, i, segmentFont);
+            segmentStart = i;
+            segmentFont = font;
+        }
+
+        i = clusterEnd;
+    }
 
-    // try primary font
-    if (shape(_size, _codepoints, _clusters, _clusterGap, _script, _fonts.first.get(), _advanceX, ref(glyphPositions)))
-        return glyphPositions;
+    if (segmentStart < _size)
+        shapeSegment(segmentStart, _size, segmentFont);
 
-    // try fallback fonts
-    for (reference_wrapper<Font> const& fallback : _fonts.second)
-        if (shape(_size, _codepoints, _clusters, _clusterGap, _script, fallback.get(), _advanceX, ref(glyphPositions)))
-            return glyphPositions;
+    return glyphPositions;
+}
 
-#if !defined(NDEBUG)
-    string joinedCodes;
-    for (char32_t codepoint : crispy::span(_codepoints, _codepoints + _size))
+Font* TextShaper::coveringFont(FontList const& _fonts, char32_t _codepoint)
+{
+    Font& primary = _fonts.first.get();
+    auto& coverage = coverage_[&primary];
+    if (auto i = coverage.find(_codepoint); i != coverage.end())
+        return i->second;
+
+    Font* font = nullptr;
+    if (isDefaultIgnorable(_codepoint) || FT_Get_Char_Index(primary, _codepoint))
+        font = &primary;
+    else
     {
-        if (!joinedCodes.empty())
-            joinedCodes += " ";
-        joinedCodes += fmt::format("{:<6x}", static_cast<unsigned>(codepoint));
+        for (Font& fallback : _fonts.second)
+        {
+            if (fallback.load() && FT_Get_Char_Index(fallback, _codepoint))
+            {
+                font = &fallback;
+                break;
+            }
+        }
     }
-    cerr << fmt::format("Shaping failed codepoints: {}\n", joinedCodes);
-#endif
 
-    // render primary font with glyph-missing hints
-    shape(_size, _codepoints, _clusters, _clusterGap, _script, _fonts.first.get(), _advanceX, ref(glyphPositions));
-    replaceMissingGlyphs(_fonts.first.get(), glyphPositions);
-    return glyphPositions;
+    coverage[_codepoint] = font;
+    return font;
+}
+
+Font* TextShaper::coveringFont(FontList const& _fonts, char32_t const* _codepoints, int _count)
+{
+    auto const covers = [&](Font& _font) {
+        return _font.load() && std::all_of(_codepoints, _codepoints + _count, [&](char32_t _codepoint) {
+            return isDefaultIgnorable(_codepoint) || FT_Get_Char_Index(_font, _codepoint) != 0;
+        });
+    };
+
+    // Most clusters consist of a single codepoint, or are covered by the font of their first one.
+    Font* font = coveringFont(_fonts, _codepoints[0]);
+    if (_count == 1 || (font && covers(*font)))
+        return font;
+
+    if (covers(_fonts.first.get()))
+        return &_fonts.first.get();
+
+    for (Font& fallback : _fonts.second)
+        if (covers(fallback))
+            return &fallback;
+
+    return nullptr;
 }
 
 void TextShaper::clearCache()
@@ -91,6 +208,64 @@ void TextShaper::clearCache()
         hb_font_destroy(hbf);
 
     hb_fonts_.clear();
+    asciiGlyphs_.clear();
+    coverage_.clear();
+}
+
+hb_font_t* TextShaper::harfbuzzFont(Font& _font)
+{
+    if (auto i = hb_fonts_.find(&_font); i != hb_fonts_.end())
+        return i->second;
+
+    hb_font_t* hb_font = hb_ft_font_create_referenced(_font);
+    hb_fonts_[&_font] = hb_font;
+    return hb_font;
+}
+
+TextShaper::AsciiGlyphs const& TextShaper::asciiGlyphs(Font& _font)
+{
+    if (auto i = asciiGlyphs_.find(&_font); i != asciiGlyphs_.end())
+        return i->second;
+
+    auto& glyphs = asciiGlyphs_[&_font];
+    glyphs.substitutes = hasDefaultSubstitutions(hb_font_get_face(harfbuzzFont(_font)));
+    if (!glyphs.substitutes)
+        for (char32_t codepoint = 0x20; codepoint < 0x7F; ++codepoint)
+            glyphs.glyphIndices[codepoint] = FT_Get_Char_Index(_font, codepoint);
+
+    return glyphs;
+}
+
+bool TextShaper::shapeTrivially(int _size,
+                                char32_t const* _codepoints,
+                                int const* _clusters,
+                                int _clusterGap,
+                                Font& _font,
+                                int _advanceX,
+                                reference<GlyphPositionList> _result)
+{
+    auto const isPrintableAscii = [](char32_t _codepoint) { return _codepoint >= 0x20 && _codepoint < 0x7F; };
+    if (!std::all_of(_codepoints, _codepoints + _size, isPrintableAscii))
+        return false;
+
+    AsciiGlyphs const& glyphs = asciiGlyphs(_font);
+    if (glyphs.substitutes)
+        return false;
+
+    _result.get().clear();
+    _result.get().reserve(_size);
+
+    for (auto const i : times(_size))
+    {
+        auto const glyphIndex = glyphs.glyphIndices[_codepoints[i]];
+        if (glyphIndex == 0)
+            return false;
+
+        auto const cluster = _clusters[i] + _clusterGap;
+        _result.get().emplace_back(GlyphPosition{_font, cluster * _advanceX, 0, glyphIndex, cluster});
+    }
+
+    return true;
 }
 
 constexpr hb_script_t mapScriptToHarfbuzzScript(unicode::Script _script)
@@ -119,6 +294,13 @@ bool TextShaper::shape(int _size,
                        int _advanceX,
                        reference<GlyphPositionList> _result)
 {
+    // Fallback fonts are opened not before they are tried first.
+    if (!_font.load())
+        return false;
+
+    if (shapeTrivially(_size, _codepoints, _clusters, _clusterGap, _font, _advanceX, _result))
+        return true;
+
     hb_buffer_clear_contents(hb_buf_);
 
     for (size_t const i : times(_size))
@@ -130,16 +312,7 @@ bool TextShaper::shape(int _size,
     hb_buffer_set_language(hb_buf_, hb_language_get_default());
     hb_buffer_guess_segment_properties(hb_buf_);
 
-    hb_font_t* hb_font = nullptr;
-    if (auto i = hb_fonts_.find(&_font); i != hb_fonts_.end())
-        hb_font = i->second;
-    else
-    {
-        hb_font = hb_ft_font_create_referenced(_font);
-        hb_fonts_[&_font] = hb_font;
-    }
-
-    hb_shape(hb_font, hb_buf_, nullptr, 0);
+    hb_shape(harfbuzzFont(_font), hb_buf_, nullptr, 0);
 
     hb_buffer_normalize_glyphs(hb_buf_);
 
@@ -163,7 +336,8 @@ bool TextShaper::shape(int _size,
             cx + (pos[i].x_offset >> 6),
             cy + (pos[i].y_offset >> 6),
             info[i].codepoint,
-            static_cast<int>(info[i].cluster)
+            static_cast<int>(info[i].cluster),
+            (hb_glyph_info_get_glyph_flags(&info[i]) & HB_GLYPH_FLAG_UNSAFE_TO_BREAK) != 0
         });
     }
 
@@ -21,8 +21,10 @@
 #include <harfbuzz/hb.h>
 #include <harfbuzz/hb-ft.h>
 
+#include <array>
 #include <string>
 #include <string_view>
+#include <unordered_map>
 
 namespace crispy::text {
 
@@ -34,7 +36,10 @@ class TextShaper {
     TextShaper();
     ~TextShaper();
 
-    /// Renders codepoints into glyph positions with the first font fully matching all codepoints.
+    /// Renders codepoints into glyph positions.
+    ///
+    /// Every cluster is shaped with the first font of @p _font having glyphs for all of its
+    /// codepoints, whereas consecutive clusters of the same font are shaped together.
     ///
     /// @param _script      the matching script for the given codepoints
     /// @param _font        the font list in priority order to be used for text shaping
@@ -60,6 +65,35 @@ class TextShaper {
     void clearCache();
 
   private:
+    /// Direct-mapped glyph indices of the printable ASCII codepoints of a font.
+    struct AsciiGlyphs {
+        /// Whether or not the font substitutes glyphs (e.g. ligatures), disqualifying the table.
+        bool substitutes = true;
+        std::array<uint32_t, 0x80> glyphIndices{};
+    };
+
+    hb_font_t* harfbuzzFont(Font& _font);
+    AsciiGlyphs const& asciiGlyphs(Font& _font);
+
+    /// @returns the first font of @p _fonts having a glyph for @p _codepoint,
+    ///          or nullptr if none has.
+    Font* coveringFont(FontList const& _fonts, char32_t _codepoint);
+
+    /// @returns the first font of @p _fonts having glyphs for all of the given codepoints,
+    ///          or nullptr if none has.
+    Font* coveringFont(FontList const& _fonts, char32_t const* _codepoints, int _count);
+
+    /// Shapes the text without HarfBuzz if it only consists of codepoints that map 1:1 onto glyphs.
+    ///
+    /// @retval true the text was trivially shapeable and @p _result was filled.
+    bool shapeTrivially(int _size,
+                        char32_t const* _codepoints,
+                        int const* _clusters,
+                        int _clusterGap,
+                        Font& _font,
+                        int _advanceX,
+                        reference<GlyphPositionList> _result);
+
     /// Performs text shaping for given text using the given font.
     bool shape(int _size,
                char32_t const* _codepoints,
@@ -73,6 +107,10 @@ class TextShaper {
   private:
     hb_buffer_t* hb_buf_;
     std::unordered_map<Font const*, hb_font_t*> hb_fonts_ = {};
+    std::unordered_map<Font const*, AsciiGlyphs> asciiGlyphs_ = {};
+
+    // Covering font per codepoint, keyed by the primary font of the font list.
+    std::unordered_map<Font const*, std::unordered_map<char32_t, Font*>> coverage_ = {};
 };
 
 } // end namespace
@@ -0,0 +1,208 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2020 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace crispy::trace {
+
+/// Collects the zones (named, timed scopes) entered by any thread, and writes them as
+/// Chrome trace event JSON, which both chrome://tracing and the Perfetto UI open.
+///
+/// Zones are appended to a buffer of their own thread, so that threads do not contend
+/// with each other. Each thread's buffer is bounded, zones beyond it are dropped.
+class Recorder {
+  public:
+    /// Maximum number of zones recorded per thread.
+    static constexpr size_t MaxZonesPerThread = 4 * 1024 * 1024;
+
+    struct Zone {
+        char const* name;           // static string
+        std::chrono::nanoseconds start;
+        std::chrono::nanoseconds duration;
+    };
+
+    /// @returns the process-wide recorder, saved to the file named by the environment
+    ///          variable CRISPY_TRACE_FILE (or "trace.json") when the process exits.
+    ///
+    /// It is never destroyed, as threads may still be recording while the process exits.
+    static Recorder& get()
+    {
+        static Recorder* const recorder = []() {
+            auto const* path = std::getenv("CRISPY_TRACE_FILE");
+            auto* recorder = new Recorder{path && *path ? path : "trace.json"};
+            std::atexit([]() { get().save(); });
+            return recorder;
+        }();
+        return *recorder;
+    }
+
+    /// Constructs a recorder saving to @p _path on destruction, or nowhere if empty.
+    explicit Recorder(std::string _path = {}) :
+        path_{ std::move(_path) },
+        id_{ nextId() },
+        epoch_{ std::chrono::steady_clock::now() }
+    {}
+
+    ~Recorder()
+    {
+        save();
+    }
+
+    Recorder(Recorder const&) = delete;
+    Recorder& operator=(Recorder const&) = delete;
+
+    std::chrono::steady_clock::time_point epoch() const noexcept { return epoch_; }
+
+    /// Records a zone of the calling thread.
+    void record(char const* _name, std::chrono::steady_clock::time_point _start, std::chrono::steady_clock::time_point _end)
+    {
+        auto& buffer = threadBuffer();
+        auto const _l = std::scoped_lock{buffer.lock};
+        if (buffer.zones.size() < MaxZonesPerThread)
+            buffer.zones.push_back(Zone{_name, _start - epoch_, _end - _start});
+        else
+            ++buffer.dropped;
+    }
+
+    /// Writes all zones recorded so far to the recorder's file, unless it has none.
+    void save()
+    {
+        if (path_.empty())
+            return;
+
+        auto output = std::ofstream{path_, std::ios::trunc};
+        if (output)
+            write(output);
+    }
+
+    /// Writes all zones recorded so far as Chrome trace event JSON.
+    void write(std::ostream& _output)
+    {
+        auto const buffers = [&]() {
+            auto const _l = std::scoped_lock{lock_};
+            return buffers_;
+        }();
+
+        auto const microseconds = [](std::chrono::nanoseconds _value) {
+            return std::to_string(_value.count() / 1000) + '.' + std::to_string(1000 + _value.count() % 1000).substr(1);
+        };
+
+        _output << "{\"traceEvents\":[";
+        auto first = true;
+        for (auto const& buffer : buffers)
+        {
+            auto const _l = std::scoped_lock{buffer->lock};
+            for (Zone const& zone : buffer->zones)
+            {
+                _output << (first ? "\n" : ",\n")
+                        << "{\"name\":\"" << zone.name
+                        << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->threadId
+                        << ",\"ts\":" << microseconds(zone.start)
+                        << ",\"dur\":" << microseconds(zone.duration) << '}';
+                first = false;
+            }
+            if (buffer->dropped)
+            {
+                _output << (first ? "\n" : ",\n")
+                        << "{\"name\":\"" << buffer->dropped << " zones dropped\",\"ph\":\"i\",\"s\":\"t\",\"pid\":1,\"tid\":"
+                        << buffer->threadId << ",\"ts\":0}";
+                first = false;
+            }
+        }
+        _output << "\n]}\n";
+    }
+
+  private:
+    struct ThreadBuffer {
+        unsigned threadId;
+        std::mutex lock;            // only contended while being written out
+        std::vector<Zone> zones;
+        size_t dropped = 0;
+    };
+
+    static uint64_t nextId() noexcept
+    {
+        static std::atomic<uint64_t> id = 0;
+        return ++id;
+    }
+
+    /// @returns the calling thread's buffer, which outlives the thread.
+    ThreadBuffer& threadBuffer()
+    {
+        // Buffers are looked up by recorder ID rather than address, which may be reused.
+        thread_local auto buffers = std::vector<std::pair<uint64_t, ThreadBuffer*>>{};
+        for (auto const& [id, buffer] : buffers)
+            if (id == id_)
+                return *buffer;
+
+        auto const _l = std::scoped_lock{lock_};
+        auto buffer = std::make_shared<ThreadBuffer>();
+        buffer->threadId = static_cast<unsigned>(buffers_.size() + 1);
+        buffers_.emplace_back(buffer);
+        buffers.emplace_back(id_, buffer.get());
+        return *buffer;
+    }
+
+    std::string const path_;
+    uint64_t const id_;
+    std::chrono::steady_clock::time_point const epoch_;
+    std::mutex lock_;
+    std::vector<std::shared_ptr<ThreadBuffer>> buffers_;
+};
+
+/// Records the scope it lives in as a zone named @p _name.
+class Zone {
+  public:
+    explicit Zone(char const* _name, Recorder& _recorder = Recorder::get()) :
+        name_{ _name },
+        recorder_{ _recorder },
+        start_{ std::chrono::steady_clock::now() }
+    {}
+
+    ~Zone()
+    {
+        recorder_.record(name_, start_, std::chrono::steady_clock::now());
+    }
+
+    Zone(Zone const&) = delete;
+    Zone& operator=(Zone const&) = delete;
+
+  private:
+    char const* name_;
+    Recorder& recorder_;
+    std::chrono::steady_clock::time_point start_;
+};
+
+} // end namespace
+
+#define CRISPY_TRACE_CONCAT_(a, b) a ## b
+#define CRISPY_TRACE_CONCAT(a, b) CRISPY_TRACE_CONCAT_(a, b)
+
+/// Records the enclosing scope as a zone named @p name (a string literal), if built with
+/// CRISPY_TRACE_ZONES defined, and compiles to nothing otherwise.
+#if defined(CRISPY_TRACE_ZONES)
+#define CRISPY_TRACE_ZONE(name) ::crispy::trace::Zone const CRISPY_TRACE_CONCAT(crispyTraceZone_, __COUNTER__){name}
+#else
+#define CRISPY_TRACE_ZONE(name) do {} while (0)
+#endif
@@ -0,0 +1,54 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2020 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <crispy/trace.h>
+
+#include <catch2/catch.hpp>
+
+#include <sstream>
+#include <string>
+#include <thread>
+
+using namespace std;
+using namespace std::chrono;
+
+TEST_CASE("trace.write")
+{
+    auto recorder = crispy::trace::Recorder{};
+    auto const start = recorder.epoch() + microseconds(1500);
+    recorder.record("parse", start, start + nanoseconds(2250));
+
+    auto output = ostringstream{};
+    recorder.write(output);
+
+    CHECK(output.str() == "{\"traceEvents\":[\n"
+                          "{\"name\":\"parse\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":1500.000,\"dur\":2.250}\n"
+                          "]}\n");
+}
+
+TEST_CASE("trace.threads")
+{
+    auto recorder = crispy::trace::Recorder{};
+    {
+        auto const zone = crispy::trace::Zone{"main", recorder};
+        auto worker = thread{[&]() { auto const zone = crispy::trace::Zone{"worker", recorder}; }};
+        worker.join();
+    }
+
+    auto output = ostringstream{};
+    recorder.write(output);
+
+    // Each thread records into a buffer of its own, numbered in the order of their first zone.
+    CHECK(output.str().find("{\"name\":\"worker\",\"ph\":\"X\",\"pid\":1,\"tid\":1,") != string::npos);
+    CHECK(output.str().find("{\"name\":\"main\",\"ph\":\"X\",\"pid\":1,\"tid\":2,") != string::npos);
+}
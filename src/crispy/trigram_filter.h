@@ -0,0 +1,75 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2020 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <bitset>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+namespace crispy {
+
+/// Probabilistic set of the byte trigrams of some text, ignoring ASCII case.
+///
+/// Used as a cheap pre-filter to rule out that a block of text contains a given string:
+/// if the block's filter does not contain all trigrams of the string, the string cannot occur
+/// within the block. The converse is not true, false positives have to be checked by the caller.
+class trigram_filter {
+  public:
+    static constexpr size_t bit_count = 4096;
+
+    /// Constructs the filter of all trigrams of @p _text.
+    static trigram_filter of(std::string_view _text)
+    {
+        auto filter = trigram_filter{};
+        filter.add(_text);
+        return filter;
+    }
+
+    /// Adds all trigrams of @p _text. Trigrams spanning multiple calls are not added.
+    void add(std::string_view _text) noexcept
+    {
+        for (size_t i = 2; i < _text.size(); ++i)
+            bits_.set(hash(_text[i - 2], _text[i - 1], _text[i]));
+    }
+
+    /// Tests whether all trigrams in @p _needle may be contained in this filter.
+    bool may_contain(trigram_filter const& _needle) const noexcept
+    {
+        return (bits_ & _needle.bits_) == _needle.bits_;
+    }
+
+    bool empty() const noexcept { return bits_.none(); }
+
+    void clear() noexcept { bits_.reset(); }
+
+  private:
+    static constexpr uint8_t fold(char _ch) noexcept
+    {
+        auto const ch = static_cast<uint8_t>(_ch);
+        return ch >= 'A' && ch <= 'Z' ? static_cast<uint8_t>(ch | 0x20) : ch;
+    }
+
+    static constexpr size_t hash(char _a, char _b, char _c) noexcept
+    {
+        uint32_t h = 2166136261u;
+        for (uint8_t const ch : {fold(_a), fold(_b), fold(_c)})
+            h = (h ^ ch) * 16777619u;
+        return (h ^ (h >> 16)) % bit_count;
+    }
+
+    std::bitset<bit_count> bits_;
+};
+
+} // end namespace
@@ -0,0 +1,39 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2020 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <crispy/trigram_filter.h>
+
+#include <catch2/catch.hpp>
+
+using crispy::trigram_filter;
+
+TEST_CASE("trigram_filter.may_contain")
+{
+    auto filter = trigram_filter{};
+    CHECK(filter.empty());
+
+    filter.add("Hello, World");
+    filter.add("second line");
+
+    CHECK(filter.may_contain(trigram_filter::of("World")));
+    CHECK(filter.may_contain(trigram_filter::of("hello")));
+    CHECK(filter.may_contain(trigram_filter::of("cond li")));
+    CHECK_FALSE(filter.may_contain(trigram_filter::of("Goodbye")));
+
+    // Too short to have any trigram, thus not ruled out.
+    CHECK(trigram_filter::of("xy").empty());
+    CHECK(filter.may_contain(trigram_filter::of("xy")));
+
+    filter.clear();
+    CHECK_FALSE(filter.may_contain(trigram_filter::of("World")));
+}
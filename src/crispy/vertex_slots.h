@@ -0,0 +1,208 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2020 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <optional>
+#include <vector>
+
+namespace crispy {
+
+/// CPU side of a vertex buffer that is partitioned into slots (e.g. one per screen row),
+/// retained across frames, followed by a stream region that is refilled every frame.
+///
+/// Every slot occupies a fixed-capacity region of the GPU buffer. Unused vertices of a slot
+/// are zeroed and thus form degenerate triangles (or empty quads, when each vertex is the
+/// instance of an instanced draw), so that all slots can be drawn at once.
+/// Only slots modified since the last flush() are uploaded again.
+template <typename T>
+class vertex_slots {
+  public:
+    /// @param _vertexSize number of components per vertex.
+    explicit vertex_slots(size_t _vertexSize) : vertexSize_{_vertexSize} {}
+
+    size_t slot_count() const noexcept { return used_.size(); }
+
+    /// Resizes to @p _count slots, discarding all retained vertices.
+    void resize(size_t _count)
+    {
+        used_.assign(_count, 0);
+        dirty_.assign(_count, 0);
+        storage_.assign(_count * capacity_, T{});
+        reallocate_ = true;
+    }
+
+    /// Discards all retained vertices.
+    void reset() { resize(slot_count()); }
+
+    /// Routes subsequent append() calls into the given slot, replacing its previous contents.
+    void select(size_t _slot)
+    {
+        assert(_slot < slot_count());
+        auto const start = std::next(storage_.begin(), static_cast<std::ptrdiff_t>(_slot * capacity_));
+        std::fill_n(start, used_[_slot], T{});
+        dirty_[_slot] = std::max(dirty_[_slot], used_[_slot]);
+        used_[_slot] = 0;
+        current_ = _slot;
+    }
+
+    /// Routes subsequent append() calls into the stream region.
+    void select_stream() noexcept { current_.reset(); }
+
+    void append(T const* _data, size_t _count)
+    {
+        if (!current_)
+        {
+            stream_.insert(stream_.end(), _data, _data + _count);
+            return;
+        }
+
+        auto const slot = *current_;
+        if (used_[slot] + _count > capacity_)
+            grow(used_[slot] + _count);
+
+        std::copy_n(_data, _count, std::next(storage_.begin(), static_cast<std::ptrdiff_t>(slot * capacity_ + used_[slot])));
+        used_[slot] += _count;
+        dirty_[slot] = std::max(dirty_[slot], used_[slot]);
+    }
+
+    /// Moves all slot contents @p _count slots towards the first slot (or towards the last slot
+    /// if negative), adding @p _offset to the @p _component'th component of each moved vertex.
+    ///
+    /// Slots that have no predecessor to be moved from become empty.
+    void shift(long _count, size_t _component, T _offset)
+    {
+        auto const n = static_cast<long>(slot_count());
+        if (_count == 0)
+            return;
+
+        if (_count >= n || -_count >= n)
+        {
+            for (size_t i = 0; i < slot_count(); ++i)
+                select(i);
+            select_stream();
+            return;
+        }
+
+        auto const moveSlot = [&](long _target, long _source) {
+            auto const target = static_cast<size_t>(_target);
+            auto const source = static_cast<size_t>(_source);
+            select(target);
+            auto const from = std::next(storage_.begin(), static_cast<std::ptrdiff_t>(source * capacity_));
+            auto const to = std::next(storage_.begin(), static_cast<std::ptrdiff_t>(target * capacity_));
+            std::copy_n(from, used_[source], to);
+            for (size_t i = _component; i < used_[source]; i += vertexSize_)
+                to[static_cast<std::ptrdiff_t>(i)] += _offset;
+            used_[target] = used_[source];
+            dirty_[target] = std::max(dirty_[target], used_[target]);
+        };
+
+        if (_count > 0)
+        {
+            for (long i = 0; i + _count < n; ++i)
+                moveSlot(i, i + _count);
+            for (long i = n - _count; i < n; ++i)
+                select(static_cast<size_t>(i));
+        }
+        else
+        {
+            for (long i = n - 1; i + _count >= 0; --i)
+                moveSlot(i, i + _count);
+            for (long i = 0; i < -_count; ++i)
+                select(static_cast<size_t>(i));
+        }
+        select_stream();
+    }
+
+    /// Discards the stream region, usually after each frame.
+    void clear_stream() noexcept { stream_.clear(); }
+
+    /// @returns number of vertices covered by all slots, including zeroed ones.
+    size_t slot_vertex_count() const noexcept { return slot_count() * capacity_ / vertexSize_; }
+
+    /// @returns number of vertices in the stream region, which starts right after all slots.
+    size_t stream_vertex_count() const noexcept { return stream_.size() / vertexSize_; }
+
+    bool empty() const noexcept
+    {
+        return stream_.empty() && std::all_of(used_.begin(), used_.end(), [](size_t n) { return n == 0; });
+    }
+
+    /// Transfers all modifications to the GPU buffer.
+    ///
+    /// @param _allocate invoked as (size) to (re)allocate the GPU buffer to the given number of components.
+    /// @param _update   invoked as (offset, data, count) to upload @p count components at the given offset.
+    template <typename Allocate, typename Update>
+    void flush(Allocate&& _allocate, Update&& _update)
+    {
+        auto const streamOffset = slot_count() * capacity_;
+
+        if (reallocate_ || stream_.size() > streamCapacity_)
+        {
+            streamCapacity_ = std::max(stream_.size(), 2 * streamCapacity_);
+            _allocate(streamOffset + streamCapacity_);
+            if (!storage_.empty())
+                _update(size_t{0}, storage_.data(), storage_.size());
+            std::fill(dirty_.begin(), dirty_.end(), 0);
+            reallocate_ = false;
+        }
+        else
+        {
+            for (size_t i = 0; i < slot_count(); ++i)
+            {
+                if (dirty_[i])
+                {
+                    _update(i * capacity_, storage_.data() + i * capacity_, dirty_[i]);
+                    dirty_[i] = 0;
+                }
+            }
+        }
+
+        if (!stream_.empty())
+            _update(streamOffset, stream_.data(), stream_.size());
+    }
+
+  private:
+    void grow(size_t _minimum)
+    {
+        auto const triangleSize = 3 * vertexSize_;
+        auto const minimum = (_minimum + triangleSize - 1) / triangleSize * triangleSize;
+        auto const capacity = std::max(minimum, 2 * capacity_);
+
+        auto storage = std::vector<T>(slot_count() * capacity, T{});
+        for (size_t i = 0; i < slot_count(); ++i)
+            std::copy_n(std::next(storage_.begin(), static_cast<std::ptrdiff_t>(i * capacity_)),
+                        used_[i],
+                        std::next(storage.begin(), static_cast<std::ptrdiff_t>(i * capacity)));
+
+        storage_ = std::move(storage);
+        capacity_ = capacity;
+        reallocate_ = true;
+    }
+
+    size_t vertexSize_;
+    size_t capacity_ = 0;           // number of components reserved per slot
+    std::vector<T> storage_;        // slot_count() * capacity_ components
+    std::vector<size_t> used_;      // number of components in use, per slot
+    std::vector<size_t> dirty_;     // number of components to upload, per slot
+    std::optional<size_t> current_;
+
+    std::vector<T> stream_;
+    size_t streamCapacity_ = 0;
+    bool reallocate_ = true;
+};
+
+} // end namespace
@@ -0,0 +1,117 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2020 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <crispy/vertex_slots.h>
+
+#include <catch2/catch.hpp>
+
+#include <vector>
+
+using namespace std;
+
+namespace
+{
+    /// Mimics a GPU buffer as seen through vertex_slots::flush().
+    struct Buffer {
+        vector<float> data;
+        size_t allocations = 0;
+        size_t uploadedComponents = 0;
+
+        void flush(crispy::vertex_slots<float>& _slots)
+        {
+            _slots.flush(
+                [&](size_t _size) { data.assign(_size, -1.0f); ++allocations; },
+                [&](size_t _offset, float const* _data, size_t _count) {
+                    REQUIRE(_offset + _count <= data.size());
+                    copy_n(_data, _count, next(data.begin(), static_cast<ptrdiff_t>(_offset)));
+                    uploadedComponents += _count;
+                }
+            );
+        }
+
+        /// @returns the vertex value (one component per vertex) at the given slot, or 0 for padding.
+        float at(crispy::vertex_slots<float> const& _slots, size_t _slot, size_t _vertex) const
+        {
+            auto const capacity = _slots.slot_vertex_count() / _slots.slot_count();
+            return data.at(_slot * capacity + _vertex);
+        }
+    };
+
+    void appendTriangle(crispy::vertex_slots<float>& _slots, float _value)
+    {
+        float const vertices[3] = {_value, _value, _value};
+        _slots.append(vertices, 3);
+    }
+}
+
+TEST_CASE("vertex_slots.retained")
+{
+    auto slots = crispy::vertex_slots<float>(1);
+    slots.resize(3);
+    auto buffer = Buffer{};
+
+    for (size_t i = 0; i < 3; ++i)
+    {
+        slots.select(i);
+        appendTriangle(slots, static_cast<float>(i + 1));
+    }
+    slots.select_stream();
+    appendTriangle(slots, 9.0f);
+
+    buffer.flush(slots);
+    CHECK(buffer.allocations == 1);
+    REQUIRE(slots.slot_vertex_count() == 9);
+    REQUIRE(slots.stream_vertex_count() == 3);
+    CHECK(buffer.at(slots, 0, 0) == 1.0f);
+    CHECK(buffer.at(slots, 2, 2) == 3.0f);
+    CHECK(buffer.data.at(slots.slot_vertex_count()) == 9.0f);
+
+    SECTION("only dirty slots are uploaded") {
+        slots.clear_stream();
+        buffer.uploadedComponents = 0;
+        slots.select(1);
+        slots.select_stream();
+        buffer.flush(slots);
+        CHECK(buffer.allocations == 1);
+        CHECK(buffer.uploadedComponents == 3);
+        CHECK(buffer.at(slots, 0, 0) == 1.0f);
+        CHECK(buffer.at(slots, 1, 0) == 0.0f); // emptied slot is zeroed
+        CHECK(buffer.at(slots, 2, 0) == 3.0f);
+        CHECK_FALSE(slots.empty());
+    }
+
+    SECTION("growing a slot reallocates") {
+        slots.select(0);
+        appendTriangle(slots, 4.0f);
+        appendTriangle(slots, 5.0f);
+        buffer.flush(slots);
+        CHECK(buffer.allocations == 2);
+        CHECK(buffer.at(slots, 0, 3) == 5.0f);
+        CHECK(buffer.at(slots, 1, 0) == 2.0f);
+        CHECK(buffer.at(slots, 1, 3) == 0.0f);
+    }
+
+    SECTION("shift") {
+        slots.shift(1, 0, 10.0f);
+        buffer.flush(slots);
+        CHECK(buffer.at(slots, 0, 0) == 12.0f);
+        CHECK(buffer.at(slots, 1, 0) == 13.0f);
+        CHECK(buffer.at(slots, 2, 0) == 0.0f);
+
+        slots.shift(-2, 0, 1.0f);
+        buffer.flush(slots);
+        CHECK(buffer.at(slots, 0, 0) == 0.0f);
+        CHECK(buffer.at(slots, 1, 0) == 0.0f);
+        CHECK(buffer.at(slots, 2, 0) == 13.0f);
+    }
+}
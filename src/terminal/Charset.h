@@ -16,6 +16,7 @@
 #include <terminal/Sequencer.h>
 
 #include <array>
+#include <string_view>
 #include <fmt/format.h>
 
 namespace terminal {
@@ -41,40 +42,87 @@ class CharsetMapping {
 
     char32_t map(char _code) noexcept
     {
+        if (identity_)
+            return static_cast<char32_t>(_code);
+
         auto result = map(shift_, _code);
-        shift_ = selected_;
+        if (shift_ != selected_)
+        {
+            shift_ = selected_;
+            updateIdentity();
+        }
         return result;
     }
 
+    /// Maps a run of US-ASCII characters like map() above, passing each mapped character to @p _sink.
+    ///
+    /// The run is passed through as is while no table but US-ASCII is in effect, and otherwise
+    /// translated with a single table lookup per character after the first one, which consumes
+    /// the single shift, if any.
+    template <typename Sink>
+    void map(std::string_view _codes, Sink _sink) noexcept(noexcept(_sink(char32_t{})))
+    {
+        if (identity_)
+        {
+            for (auto const code: _codes)
+                _sink(static_cast<char32_t>(code));
+            return;
+        }
+
+        if (_codes.empty())
+            return;
+
+        _sink(map(_codes.front()));
+
+        auto const& table = *tables_[static_cast<size_t>(selected_)];
+        for (auto const code: _codes.substr(1))
+            _sink(table[static_cast<size_t>(code)]);
+    }
+
     char32_t map(CharsetTable _table, char _code) const noexcept
     {
         return (*tables_[static_cast<size_t>(_table)])[_code];
     }
 
-    constexpr void singleShift(CharsetTable _table) noexcept
+    void singleShift(CharsetTable _table) noexcept
     {
         shift_ = _table;
+        updateIdentity();
     }
 
-    constexpr void selectDefaultTable(CharsetTable _table) noexcept
+    void selectDefaultTable(CharsetTable _table) noexcept
     {
         selected_ = _table;
         shift_ = _table;
+        updateIdentity();
     }
 
     void select(CharsetTable _table, CharsetId _id) noexcept
     {
         tables_[static_cast<size_t>(_table)] = charsetMap(_id);
+        updateIdentity();
     }
 
     constexpr CharsetTable currentTable() const noexcept { return shift_; }
 
+    /// @returns whether characters are mapped to themselves, i.e. the selected table is US-ASCII
+    ///          and not single-shifted.
+    constexpr bool identity() const noexcept { return identity_; }
+
+  private:
+    void updateIdentity() noexcept
+    {
+        identity_ = shift_ == selected_
+                 && tables_[static_cast<size_t>(selected_)] == charsetMap(CharsetId::USASCII);
+    }
+
   private:
     CharsetTable shift_ = CharsetTable::G0;
     CharsetTable selected_ = CharsetTable::G0;
 
     using Tables = std::array<CharsetMap const*, 4>;
     Tables tables_;
+    bool identity_ = true;
 };
 
 } // end namespace
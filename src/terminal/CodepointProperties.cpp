@@ -0,0 +1,68 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2020 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <terminal/CodepointProperties.h>
+
+#include <unicode/width.h>
+
+#include <algorithm>
+
+using std::array;
+using std::clamp;
+using std::memory_order_acq_rel;
+using std::memory_order_acquire;
+
+namespace terminal {
+
+namespace {
+    // A codepoint of each grapheme cluster break property that keeps some successor in its cluster:
+    // Other, CR, L, V, T, LV, LVT, ZWJ, Regional Indicator, and a virama linking Indic consonants.
+    // A pair of codepoints neither kept with any of these nor keeping 'A' always breaks (UAX #29, GB999).
+    constexpr array<char32_t, 10> JoiningProbes{
+        U'A', 0x000D, 0x1100, 0x1160, 0x11A8, 0xAC00, 0xAC01, 0x200D, 0x1F1E6, 0x094D
+    };
+}
+
+std::array<std::atomic<CodepointProperties::Block const*>, (CodepointProperties::MaxCodepoint >> CodepointProperties::BlockBits) + 1>
+    CodepointProperties::blocks_{};
+
+uint8_t CodepointProperties::properties(char32_t _codepoint) noexcept
+{
+    auto const width = static_cast<uint8_t>(clamp(unicode::width(_codepoint), 0, 3));
+
+    // Joins its predecessor (such as combining marks) or its successor (Prepend).
+    auto joining = unicode::grapheme_segmenter::nonbreakable(_codepoint, U'A');
+    for (auto const probe: JoiningProbes)
+        joining = joining || unicode::grapheme_segmenter::nonbreakable(probe, _codepoint);
+
+    return static_cast<uint8_t>(width | (joining ? Joining : 0));
+}
+
+CodepointProperties::Block const* CodepointProperties::loadBlock(char32_t _index) noexcept
+{
+    auto block = new Block();
+    for (char32_t i = 0; i < BlockSize; ++i)
+        (*block)[i] = properties((_index << BlockBits) | i);
+
+    // Another thread may have filled in the same block meanwhile, then that one is used.
+    // Blocks live as long as the process does.
+    Block const* expected = nullptr;
+    if (!blocks_[_index].compare_exchange_strong(expected, block, memory_order_acq_rel, memory_order_acquire))
+    {
+        delete block;
+        return expected;
+    }
+    return block;
+}
+
+} // end namespace
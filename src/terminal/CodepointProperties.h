@@ -0,0 +1,78 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2020 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <unicode/grapheme_segmenter.h>
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+namespace terminal {
+
+/// Width and grapheme cluster breaking of codepoints, as looked up for every codepoint written
+/// into the screen.
+///
+/// Both properties are combined into one byte per codepoint in a two-stage table, whose second
+/// stage is filled in from libunicode per block of 128 codepoints when first used, such that
+/// a lookup usually is a single load.
+class CodepointProperties {
+  public:
+    /// @returns the number of columns the codepoint occupies, see unicode::width().
+    static int width(char32_t _codepoint) noexcept
+    {
+        return lookup(_codepoint) & WidthMask;
+    }
+
+    /// @returns whether a grapheme cluster continues from @p _a to @p _b,
+    ///          see unicode::grapheme_segmenter::nonbreakable().
+    static bool nonbreakable(char32_t _a, char32_t _b) noexcept
+    {
+        // Clusters of codepoints without any grapheme cluster break property (such as letters
+        // or ideographs) always break between them.
+        if (!((lookup(_a) | lookup(_b)) & Joining))
+            return false;
+
+        return unicode::grapheme_segmenter::nonbreakable(_a, _b);
+    }
+
+  private:
+    static constexpr uint8_t WidthMask = 0x03;
+    static constexpr uint8_t Joining = 0x04; // may be kept in a grapheme cluster with its neighbors
+
+    static constexpr unsigned BlockBits = 7;
+    static constexpr char32_t BlockSize = 1u << BlockBits;
+    static constexpr char32_t MaxCodepoint = 0x10FFFF;
+
+    using Block = std::array<uint8_t, BlockSize>;
+
+    static uint8_t lookup(char32_t _codepoint) noexcept
+    {
+        if (_codepoint > MaxCodepoint)
+            return properties(_codepoint);
+
+        auto const index = _codepoint >> BlockBits;
+        auto const* block = blocks_[index].load(std::memory_order_acquire);
+        if (!block)
+            block = loadBlock(index);
+        return (*block)[_codepoint & (BlockSize - 1)];
+    }
+
+    static uint8_t properties(char32_t _codepoint) noexcept;
+    static Block const* loadBlock(char32_t _index) noexcept;
+
+    static std::array<std::atomic<Block const*>, (MaxCodepoint >> BlockBits) + 1> blocks_;
+};
+
+} // end namespace
@@ -0,0 +1,57 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2020 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <terminal/CodepointProperties.h>
+
+#include <unicode/grapheme_segmenter.h>
+#include <unicode/width.h>
+
+#include <catch2/catch.hpp>
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <array>
+
+using terminal::CodepointProperties;
+
+namespace {
+    // Letters, ideographs, Hangul, combining marks, variation selectors, ZWJ, emoji and regional indicators.
+    constexpr std::array<char32_t, 18> Samples{
+        U'a', U'#', 0x00E4, 0x0301, 0x094D, 0x0915, 0x1100, 0x1161, 0x11A8,
+        0x200D, 0x2757, 0x4E00, 0xAC00, 0xFE0F, 0xFF21, 0x1F1E9, 0x1F600, 0x1F3FB
+    };
+}
+
+TEST_CASE("CodepointProperties.width", "[unicode]")
+{
+    auto mismatches = 0;
+    for (char32_t codepoint = 0x20; codepoint < 0x20000; ++codepoint)
+    {
+        if (CodepointProperties::width(codepoint) != std::max(unicode::width(codepoint), 0))
+        {
+            UNSCOPED_INFO(fmt::format("U+{:04X}", static_cast<unsigned>(codepoint)));
+            ++mismatches;
+        }
+    }
+    CHECK(mismatches == 0);
+}
+
+TEST_CASE("CodepointProperties.nonbreakable", "[unicode]")
+{
+    for (auto const a: Samples)
+        for (auto const b: Samples)
+        {
+            INFO(fmt::format("U+{:04X} U+{:04X}", static_cast<unsigned>(a), static_cast<unsigned>(b)));
+            CHECK(CodepointProperties::nonbreakable(a, b) == unicode::grapheme_segmenter::nonbreakable(a, b));
+        }
+}
@@ -218,6 +218,25 @@ struct ColorProfile {
     }();
 };
 
+inline bool operator==(ColorProfile const& a, ColorProfile const& b) noexcept
+{
+    return a.defaultForeground == b.defaultForeground
+        && a.defaultBackground == b.defaultBackground
+        && a.selectionForeground == b.selectionForeground
+        && a.selectionBackground == b.selectionBackground
+        && a.cursor == b.cursor
+        && a.mouseForeground == b.mouseForeground
+        && a.mouseBackground == b.mouseBackground
+        && a.hyperlinkDecoration.normal == b.hyperlinkDecoration.normal
+        && a.hyperlinkDecoration.hover == b.hyperlinkDecoration.hover
+        && a.palette == b.palette;
+}
+
+inline bool operator!=(ColorProfile const& a, ColorProfile const& b) noexcept
+{
+    return !(a == b);
+}
+
 enum class ColorTarget {
     Foreground,
     Background,
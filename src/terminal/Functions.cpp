@@ -25,6 +25,8 @@
 
 #include <array>
 #include <algorithm>
+#include <cstdint>
+#include <limits>
 #include <numeric>
 #include <sstream>
 #include <string>
@@ -43,27 +45,75 @@ using std::stringstream;
 
 namespace terminal {
 
+namespace {
+    /// Maps function selectors directly onto the (small) range of candidate
+    /// definitions in functions(), so that select() does not need to search.
+    struct FunctionIndex
+    {
+        /// Contiguous range of definitions within functions().
+        struct Range {
+            uint8_t offset = 0;
+            uint8_t count = 0;
+        };
+
+        /// Highest OSC code (exclusive) that can be looked up.
+        static constexpr int MaxOscCode = 2048;
+
+        /// Ranges indexed by category (except OSC) and final symbol.
+        array<array<Range, 128>, 5> byFinalSymbol{};
+
+        /// Ranges for OSC functions, indexed by their numeric code.
+        array<Range, MaxOscCode> byOscCode{};
+
+        template <typename Functions>
+        explicit FunctionIndex(Functions const& _functions) noexcept
+        {
+            static_assert(std::tuple_size_v<Functions> <= std::numeric_limits<uint8_t>::max());
+
+            for (size_t i = 0; i < _functions.size(); ++i)
+            {
+                FunctionDefinition const& f = _functions[i];
+                Range& range = f.category == FunctionCategory::OSC
+                    ? byOscCode.at(static_cast<size_t>(f.maximumParameters))
+                    : byFinalSymbol[static_cast<size_t>(f.category)][static_cast<uint8_t>(f.finalSymbol) & 0x7F];
+
+                // functions() is sorted by category and final symbol first, so
+                // all candidates for one slot are guaranteed to be adjacent.
+                if (range.count == 0)
+                    range.offset = static_cast<uint8_t>(i);
+                range.count++;
+            }
+        }
+
+        Range const& operator[](FunctionSelector const& _selector) const noexcept
+        {
+            static constexpr Range none{};
+
+            if (_selector.category == FunctionCategory::OSC)
+                return 0 <= _selector.argc && _selector.argc < MaxOscCode
+                    ? byOscCode[static_cast<size_t>(_selector.argc)]
+                    : none;
+
+            auto const finalSymbol = static_cast<uint8_t>(_selector.finalSymbol);
+            return finalSymbol < 128
+                ? byFinalSymbol[static_cast<size_t>(_selector.category)][finalSymbol]
+                : none;
+        }
+    };
+}
+
 FunctionDefinition const* select(FunctionSelector const& _selector) noexcept
 {
     auto static const& funcs = functions();
+    auto static const index = FunctionIndex{funcs};
 
     //std::cout << fmt::format("select: {}\n", _selector);
 
-    int a = 0;
-    int b = static_cast<int>(funcs.size()) - 1;
-    while (a <= b)
-    {
-        auto const i = (a + b) / 2;
-        auto const& I = funcs[i];
-        auto const rel = compare(_selector, I);
-        //std::cout << fmt::format(" - a:{:>2} b:{:>2} i:{} rel:{} I: {}\n", a, b, i, rel < 0 ? '<' : rel > 0 ? '>' : '=', I);
-        if (rel > 0)
-            a = i + 1;
-        else if (rel < 0)
-            b = i - 1;
-        else
-            return &I;
-    }
+    auto const& range = index[_selector];
+    for (auto i = range.offset; i < range.offset + range.count; ++i)
+        if (compare(_selector, funcs[i]) == 0)
+            return &funcs[i];
+
     return nullptr;
 }
 
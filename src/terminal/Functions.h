@@ -326,6 +326,7 @@ constexpr inline auto RCOLORMOUSEBG = detail::OSC(114, "RCOLORMOUSEBG", "Reset m
 constexpr inline auto RCOLORHIGHLIGHTFG = detail::OSC(119, "RCOLORHIGHLIGHTFG", "Reset highlight foreground color.");
 constexpr inline auto RCOLORHIGHLIGHTBG = detail::OSC(117, "RCOLORHIGHLIGHTBG", "Reset highlight background color.");
 constexpr inline auto NOTIFY        = detail::OSC(777, "NOTIFY", "Send Notification.");
+constexpr inline auto INLINEIMAGE   = detail::OSC(1337, "INLINEIMAGE", "Displays an inline image (iTerm2 File= protocol).");
 constexpr inline auto DUMPSTATE     = detail::OSC(888, "DUMPSTATE", "Dumps internal state to debug stream.");
 
 inline auto const& functions() noexcept
@@ -444,6 +445,7 @@ inline auto const& functions() noexcept
             RCOLORHIGHLIGHTBG,
             NOTIFY,
             DUMPSTATE,
+            INLINEIMAGE,
         };
         crispy::sort(f, [](FunctionDefinition const& a, FunctionDefinition const& b) constexpr { return compare(a, b); });
         return f;
@@ -502,86 +504,6 @@ inline FunctionDefinition const* selectOSCommand(int _id)
     return select({FunctionCategory::OSC, 0, _id, 0, 0});
 }
 
-/// Tests if given function can be batched with regards to synchronized output (SM/RM ?2026).
-constexpr bool isBatchable(FunctionDefinition const& _function)
-{
-    switch (_function)
-    {
-        // C0
-        case BS:
-        case TAB:
-        case LF:
-        case VT:
-        case FF:
-        case CR:
-
-        // ESC
-        case SCS_G0_SPECIAL:
-        case SCS_G0_USASCII:
-        case SCS_G1_SPECIAL:
-        case SCS_G1_USASCII:
-        case DECALN:
-        case DECBI:
-        case DECFI:
-        case DECRS:
-        case DECSC:
-        case HTS:
-        case IND:
-        case NEL:
-        case RI:
-        case SS2:
-        case SS3:
-
-        // CSI
-        case ANSISYSSC:
-        case CBT:
-        case CHA:
-        case CHT:
-        case CNL:
-        case CPL:
-        case CUB:
-        case CUD:
-        case CUF:
-        case CUP:
-        case CUU:
-        case DCH:
-        case DECDC:
-        case DECIC:
-        case DECSCUSR:
-        case DECSLRM:
-        case DECSTBM:
-        case DL:
-        case ECH:
-        case ED:
-        case EL:
-        case HPA:
-        case HPR:
-        case HVP:
-        case ICH:
-        case IL:
-        case SCOSC:
-        case SD:
-        case SETMARK:
-        case SGR:
-        case SU:
-        case TBC:
-        case VPA:
-
-        // OSC
-        case HYPERLINK:
-        case RCOLORFG:
-        case RCOLORBG:
-        case RCOLORCURSOR:
-        case RCOLORMOUSEFG:
-        case RCOLORMOUSEBG:
-        case RCOLORHIGHLIGHTFG:
-        case RCOLORHIGHLIGHTBG:
-            return true;
-        default:
-            return false;
-    }
-}
-
 } // end namespace
 
 namespace std {
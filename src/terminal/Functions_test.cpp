@@ -70,3 +70,21 @@ TEST_CASE("Functions.OSC777", "[Functions]")
     REQUIRE(osc);
     CHECK(*osc == NOTIFY);
 }
+
+TEST_CASE("Functions.select_all", "[Functions]")
+{
+    for (FunctionDefinition const& f: functions())
+    {
+        INFO(fmt::format("function: {}", f));
+        auto const argc = f.category == FunctionCategory::OSC ? f.maximumParameters : f.minimumParameters;
+        FunctionDefinition const* selected = select({f.category, f.leader, argc, f.intermediate, f.finalSymbol});
+        REQUIRE(selected);
+        CHECK(*selected == f);
+    }
+}
+
+TEST_CASE("Functions.select_unknown", "[Functions]")
+{
+    CHECK(terminal::selectControl(0, 0, 0, 'y') == nullptr);
+    CHECK(terminal::selectOSCommand(4711) == nullptr);
+}
@@ -13,65 +13,127 @@
  */
 #pragma once
 
+#include <cstdint>
+#include <optional>
 #include <string>
-#include <unordered_map>
-#include <list>
-#include <memory>
+#include <string_view>
+#include <utility>
+#include <vector>
 
 namespace terminal {
 
-enum class HyperlinkState {
-    /// Default hyperlink state.
-    Inactive,
+using URI = std::string;
 
-    /// mouse or cursor is hovering this hyperlink
-    Hover,
+struct HyperlinkInfo { // TODO: rename to Hyperlink
+    HyperlinkInfo(std::string _id, URI _uri) :
+        id{std::move(_id)},
+        uri{std::move(_uri)}
+    {
+        // The URI is split into its parts once, rather than on every query.
+        if (auto const i = uri.find("://"); i != uri.npos)
+        {
+            scheme_ = Part{0, i};
+            if (auto const j = uri.find('/', i + 3); j != uri.npos)
+            {
+                host_ = Part{i + 3, j - i - 3};
+                path_ = Part{j, uri.size() - j};
+            }
+        }
+    }
 
-    /// mouse or cursor is hovering and has this item selected (e.g. via pressing Ctrl)
-    //Active,
-};
+    std::string const id;
+    URI const uri;
 
-using URI = std::string;
+    bool isLocal() const noexcept { return scheme() == "file"; }
 
-struct HyperlinkInfo { // TODO: rename to Hyperlink
-    std::string id;
-    URI uri;
-    HyperlinkState state = HyperlinkState::Inactive;
+    std::string_view host() const noexcept { return part(host_); }
+    std::string_view path() const noexcept { return part(path_); }
+    std::string_view scheme() const noexcept { return part(scheme_); }
+
+  private:
+    using Part = std::pair<size_t, size_t>; // offset and length within uri
 
-    bool isLocal() const noexcept
+    std::string_view part(Part _part) const noexcept
     {
-        return uri.size() >= 7 && uri.substr(0, 7) == "file://";
+        return std::string_view{uri}.substr(_part.first, _part.second);
     }
 
-    std::string_view host() const noexcept
-    {
-        if (auto const i = uri.find("://"); i != uri.npos)
-            if (auto const j = uri.find('/', i + 3); j != uri.npos)
-                return std::string_view{uri.data() + i + 3, j - i - 3};
+    Part scheme_{};
+    Part host_{};
+    Part path_{};
+};
 
-        return "";
+/// Refers to a hyperlink in the HyperlinkStorage of a Screen, with 0 meaning no hyperlink.
+using HyperlinkId = uint32_t;
+
+/// Table of the hyperlinks of a Screen, referred to by cells via their HyperlinkId.
+///
+/// Hyperlinks are not reference counted by the cells referring to them, but released
+/// altogether by collect(), given the ids still in use.
+class HyperlinkStorage {
+  public:
+    /// Adds the given hyperlink, possibly reusing the id of a released one.
+    HyperlinkId add(HyperlinkInfo _hyperlink)
+    {
+        if (free_.empty())
+        {
+            entries_.emplace_back(std::move(_hyperlink));
+            return static_cast<HyperlinkId>(entries_.size());
+        }
+
+        auto const id = free_.back();
+        free_.pop_back();
+        entries_[id - 1].emplace(std::move(_hyperlink));
+        return id;
     }
 
-    std::string_view path() const noexcept
+    /// @returns the hyperlink of the given id, or nullptr if there is none.
+    ///          The hyperlink is only guaranteed to stay at that address until the next add().
+    HyperlinkInfo const* get(HyperlinkId _id) const noexcept
     {
-        if (auto const i = uri.find("://"); i != uri.npos)
-            if (auto const j = uri.find('/', i + 3); j != uri.npos)
-                return std::string_view{uri.data() + j};
+        if (_id == 0 || _id > entries_.size() || !entries_[_id - 1].has_value())
+            return nullptr;
+        return &*entries_[_id - 1];
+    }
+
+    /// @returns number of hyperlinks held.
+    size_t size() const noexcept { return entries_.size() - free_.size(); }
+
+    /// @returns one past the greatest id handed out.
+    HyperlinkId idEnd() const noexcept { return static_cast<HyperlinkId>(entries_.size() + 1); }
 
-        return "";
+    /// Releases all hyperlinks whose id is not set in @p _used, being indexed by id.
+    void collect(std::vector<bool> const& _used)
+    {
+        for (HyperlinkId id = 1; id <= entries_.size(); ++id)
+        {
+            if (entries_[id - 1].has_value() && (id >= _used.size() || !_used[id]))
+            {
+                entries_[id - 1].reset();
+                free_.push_back(id);
+            }
+        }
     }
 
-    std::string_view scheme() const noexcept
+    void clear()
     {
-        if (auto const i = uri.find("://"); i != uri.npos)
-            return std::string_view{uri.data(), i};
-        else
-            return {};
+        entries_.clear();
+        free_.clear();
     }
-};
 
-using HyperlinkRef = std::shared_ptr<HyperlinkInfo>;
+    /// @returns number of heap bytes held by the table and its hyperlinks.
+    size_t memoryUsage() const noexcept
+    {
+        auto bytes = entries_.capacity() * sizeof(entries_[0]) + free_.capacity() * sizeof(HyperlinkId);
+        for (auto const& entry : entries_)
+            if (entry.has_value())
+                bytes += entry->id.capacity() + entry->uri.capacity();
+        return bytes;
+    }
 
-bool is_local(HyperlinkInfo const& _hyperlink);
+  private:
+    std::vector<std::optional<HyperlinkInfo>> entries_; // indexed by id - 1
+    std::vector<HyperlinkId> free_;
+};
 
 } // end namespace
@@ -0,0 +1,365 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2020 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <terminal/IOReactor.h>
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cerrno>
+#include <stdexcept>
+#include <system_error>
+#include <utility>
+
+#if defined(__linux__)
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#elif defined(_WIN32)
+#include <Windows.h>
+#endif
+
+using namespace std;
+
+namespace terminal {
+
+namespace
+{
+    /// Data of the wakeup eventfd's epoll registrations (completion key of the packet stopping the
+    /// reactor thread on Windows), never used as session id.
+    constexpr uint64_t WakeupId = 0;
+}
+
+unsigned IOReactor::defaultWorkerCount() noexcept
+{
+    return max(1u, min(4u, thread::hardware_concurrency() / 2));
+}
+
+bool IOReactor::supported() noexcept
+{
+#if defined(__linux__) || defined(_WIN32)
+    return true;
+#else
+    return false;
+#endif
+}
+
+IOReactor& IOReactor::get()
+{
+    static IOReactor reactor{};
+    return reactor;
+}
+
+IOReactor::IOReactor(unsigned _workerCount)
+{
+#if defined(__linux__)
+    epoll_ = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_ < 0)
+        throw system_error{errno, system_category(), "epoll_create1"};
+
+    wakeup_ = eventfd(0, EFD_CLOEXEC);
+    if (wakeup_ < 0)
+    {
+        auto const ec = errno;
+        ::close(epoll_);
+        throw system_error{ec, system_category(), "eventfd"};
+    }
+
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.u64 = WakeupId;
+    epoll_ctl(epoll_, EPOLL_CTL_ADD, wakeup_, &event);
+
+    reactor_ = thread{ [this]() { reactorThread(); } };
+#elif defined(_WIN32)
+    completionPort_ = CreateIoCompletionPort(INVALID_HANDLE_VALUE, nullptr, 0, 1);
+    if (!completionPort_)
+        throw system_error{static_cast<int>(GetLastError()), system_category(), "CreateIoCompletionPort"};
+
+    reactor_ = thread{ [this]() { reactorThread(); } };
+#endif
+
+    for (unsigned i = 0; i < max(_workerCount, 1u); ++i)
+        workers_.emplace_back([this]() { workerThread(); });
+}
+
+IOReactor::~IOReactor()
+{
+    {
+        auto const _l = scoped_lock{lock_};
+        quit_ = true;
+    }
+    readyChanged_.notify_all();
+    for (auto& worker : workers_)
+        worker.join();
+
+#if defined(__linux__)
+    uint64_t const one = 1;
+    (void) ::write(wakeup_, &one, sizeof(one));
+    reactor_.join();
+
+    ::close(wakeup_);
+    ::close(epoll_);
+#elif defined(_WIN32)
+    PostQueuedCompletionStatus(completionPort_, 0, WakeupId, nullptr);
+    reactor_.join();
+
+    CloseHandle(completionPort_);
+#endif
+}
+
+void IOReactor::add(NativeHandle _handle, Session& _session)
+{
+    auto const _l = scoped_lock{lock_};
+    assert(ids_.find(&_session) == ids_.end());
+
+    auto const id = nextId_++;
+#if defined(_WIN32)
+    // The handle's completions are reported for good, as it cannot be dissociated again.
+    // Those arriving after the session has been removed are ignored like any unknown id.
+    if (!CreateIoCompletionPort(_handle, completionPort_, static_cast<ULONG_PTR>(id), 0))
+        throw system_error{static_cast<int>(GetLastError()), system_category(), "CreateIoCompletionPort"};
+#endif
+    auto& entry = *entries_.emplace(id, make_unique<Entry>(Entry{&_session, _handle, id})).first->second;
+    ids_[&_session] = id;
+    watch(entry);
+}
+
+void IOReactor::remove(Session& _session)
+{
+    auto l = unique_lock{lock_};
+    auto const i = ids_.find(&_session);
+    if (i == ids_.end())
+        return;
+
+    auto const id = i->second;
+    auto& entry = *entries_.at(id);
+    if (entry.armed)
+        unwatch(entry);
+
+    entryChanged_.wait(l, [&]() { return !entry.reading && !entry.running; });
+
+    readyQueue_.erase(std::remove(readyQueue_.begin(), readyQueue_.end(), id), readyQueue_.end());
+    for (auto timer = timers_.begin(); timer != timers_.end(); )
+        timer = timer->second == id ? timers_.erase(timer) : next(timer);
+    ids_.erase(i);
+    entries_.erase(id);
+}
+
+void IOReactor::resume(Session& _session)
+{
+    auto const _l = scoped_lock{lock_};
+    auto const i = ids_.find(&_session);
+    if (i == ids_.end())
+        return;
+
+    auto& entry = *entries_.at(i->second);
+    if (entry.reading)
+        entry.resumeRequested = true;
+    else if (!entry.armed)
+        watch(entry);
+}
+
+void IOReactor::schedule(Session& _session)
+{
+    auto const _l = scoped_lock{lock_};
+    if (auto const i = ids_.find(&_session); i != ids_.end())
+        scheduleLocked(*entries_.at(i->second));
+}
+
+void IOReactor::scheduleAt(Session& _session, chrono::steady_clock::time_point _time)
+{
+    auto const _l = scoped_lock{lock_};
+    if (auto const i = ids_.find(&_session); i != ids_.end())
+    {
+        timers_.emplace(_time, i->second);
+        // A worker waiting for a later timer, or for none, has to wait for this one instead.
+        readyChanged_.notify_one();
+    }
+}
+
+void IOReactor::scheduleDueLocked()
+{
+    auto const now = chrono::steady_clock::now();
+    while (!timers_.empty() && timers_.begin()->first <= now)
+    {
+        auto const id = timers_.begin()->second;
+        timers_.erase(timers_.begin());
+        if (auto const i = entries_.find(id); i != entries_.end())
+            scheduleLocked(*i->second);
+    }
+}
+
+void IOReactor::scheduleLocked(Entry& _entry)
+{
+    if (!_entry.queued)
+    {
+        _entry.queued = true;
+        readyQueue_.push_back(_entry.id);
+        readyChanged_.notify_one();
+    }
+    else if (_entry.running)
+        _entry.rescheduled = true;
+}
+
+void IOReactor::watch(Entry& _entry)
+{
+#if defined(__linux__)
+    // Watching is stopped by removing the file descriptor rather than by clearing its events,
+    // as hang-ups would otherwise still be reported over and over again.
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.u64 = _entry.id;
+    epoll_ctl(epoll_, EPOLL_CTL_ADD, _entry.handle, &event);
+#elif defined(_WIN32)
+    // Reads may have completed while not being watched, and are not reported again.
+    PostQueuedCompletionStatus(completionPort_, 0, static_cast<ULONG_PTR>(_entry.id), nullptr);
+#endif
+    _entry.armed = true;
+}
+
+void IOReactor::unwatch(Entry& _entry)
+{
+#if defined(__linux__)
+    epoll_ctl(epoll_, EPOLL_CTL_DEL, _entry.handle, nullptr);
+#endif
+    _entry.armed = false;
+}
+
+void IOReactor::reactorThread()
+{
+#if defined(__linux__)
+    auto events = array<epoll_event, 64>{};
+    for (;;)
+    {
+        auto const count = epoll_wait(epoll_, events.data(), static_cast<int>(events.size()), -1);
+        if (count < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+
+        for (int k = 0; k < count; ++k)
+        {
+            auto const id = events[static_cast<size_t>(k)].data.u64;
+            if (id == WakeupId)
+                return;
+
+            serviceReadable(id);
+        }
+    }
+#elif defined(_WIN32)
+    auto entries = array<OVERLAPPED_ENTRY, 64>{};
+    for (;;)
+    {
+        // Failed reads are reported as well, the session learning about them by reading.
+        auto count = ULONG{0};
+        if (!GetQueuedCompletionStatusEx(completionPort_, entries.data(), static_cast<ULONG>(entries.size()),
+                                         &count, INFINITE, FALSE))
+            break;
+
+        for (ULONG k = 0; k < count; ++k)
+        {
+            auto const id = static_cast<uint64_t>(entries[k].lpCompletionKey);
+            if (id == WakeupId)
+                return;
+
+            serviceReadable(id);
+        }
+    }
+#endif
+}
+
+void IOReactor::serviceReadable(uint64_t _id)
+{
+    // Events may still be reported for sessions removed meanwhile.
+    Entry* entry = nullptr;
+    {
+        auto const _l = scoped_lock{lock_};
+        if (auto const i = entries_.find(_id); i != entries_.end() && i->second->armed)
+        {
+            entry = i->second.get();
+            entry->reading = true;
+        }
+    }
+    if (!entry)
+        return;
+
+    // Each readable session reads once per round, so that all get their turn.
+    bool const keepWatching = entry->session->onReadable();
+
+    {
+        auto const _l = scoped_lock{lock_};
+        entry->reading = false;
+        if (!keepWatching && entry->armed)
+        {
+            // Watching anew if resumed meanwhile, rather than just staying watched, as on
+            // Windows that is what makes reads completed meanwhile being looked at.
+            unwatch(*entry);
+            if (entry->resumeRequested)
+                watch(*entry);
+        }
+        entry->resumeRequested = false;
+        scheduleLocked(*entry);
+    }
+    entryChanged_.notify_all();
+}
+
+void IOReactor::workerThread()
+{
+    auto l = unique_lock{lock_};
+    for (;;)
+    {
+        scheduleDueLocked();
+        if (quit_)
+            return;
+
+        if (readyQueue_.empty())
+        {
+            if (timers_.empty())
+                readyChanged_.wait(l);
+            else
+                readyChanged_.wait_until(l, timers_.begin()->first);
+            continue;
+        }
+
+        auto const id = readyQueue_.front();
+        readyQueue_.pop_front();
+
+        auto const i = entries_.find(id);
+        if (i == entries_.end())
+            continue;
+
+        Entry& entry = *i->second;
+        entry.running = true;
+        entry.rescheduled = false;
+        l.unlock();
+
+        bool const morePending = entry.session->process();
+
+        l.lock();
+        entry.running = false;
+        if (morePending || exchange(entry.rescheduled, false))
+        {
+            // Back of the queue, behind all sessions that became ready meanwhile.
+            readyQueue_.push_back(id);
+            readyChanged_.notify_one();
+        }
+        else
+            entry.queued = false;
+        entryChanged_.notify_all();
+    }
+}
+
+}  // namespace terminal
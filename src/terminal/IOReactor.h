@@ -0,0 +1,145 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2020 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <terminal/pty/Pty.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace terminal {
+
+/// Services the I/O of many sessions (such as terminals) with a fixed number of threads.
+///
+/// A single reactor thread waits for the sessions' file descriptors to become readable and lets
+/// the session read what is available, whereas a small pool of worker threads processes the
+/// data read. Each session is processed by at most one worker at a time, and only for one slice
+/// of work before the next ready session is taken, in first-come first-served order, such that a
+/// session flooding output cannot starve the others.
+///
+/// Available on Linux (epoll) and Windows (I/O completion ports), see supported().
+///
+/// On Windows, handles are not waited on for readability but report completed reads. A session
+/// therefore keeps an overlapped read pending on its handle, whose completion lets the reactor
+/// invoke onReadable(). As completions are not repeated, each time a session is (again) watched,
+/// onReadable() is invoked once unconditionally, such that reads completed meanwhile are not missed.
+class IOReactor {
+  public:
+    class Session {
+      public:
+        virtual ~Session() = default;
+
+        /// Invoked from the reactor thread once the session's handle became readable.
+        ///
+        /// Reads are meant to be short and non-blocking, and may find nothing to read on Windows. The session is scheduled for processing
+        /// afterwards.
+        ///
+        /// @retval true  keep on watching the file descriptor.
+        /// @retval false stop watching it until resume() is called, e.g. because the session's
+        ///               buffer is full or the file descriptor has been closed.
+        virtual bool onReadable() = 0;
+
+        /// Invoked from one of the worker threads to process one slice of the data read.
+        ///
+        /// @retval true  more work is pending, so the session is scheduled again.
+        /// @retval false all work done for now.
+        virtual bool process() = 0;
+    };
+
+    /// Default number of worker threads, derived from the number of CPU cores.
+    static unsigned defaultWorkerCount() noexcept;
+
+    /// @returns whether or not this platform supports sessions being serviced by a reactor.
+    static bool supported() noexcept;
+
+    /// @returns the process-wide reactor, started on first use.
+    static IOReactor& get();
+
+    explicit IOReactor(unsigned _workerCount = defaultWorkerCount());
+    ~IOReactor();
+
+    IOReactor(IOReactor const&) = delete;
+    IOReactor& operator=(IOReactor const&) = delete;
+
+    /// Starts watching @p _handle for readability on behalf of @p _session.
+    void add(NativeHandle _handle, Session& _session);
+
+    /// Stops servicing @p _session.
+    ///
+    /// Waits for any callback currently running for @p _session to complete, hence
+    /// must not be called from within one of its callbacks.
+    void remove(Session& _session);
+
+    /// Resumes watching the session's handle after onReadable() returned false.
+    void resume(Session& _session);
+
+    /// Schedules @p _session to be processed, unless already scheduled.
+    void schedule(Session& _session);
+
+    /// Schedules @p _session to be processed once @p _time has come, such as for work that is
+    /// due later rather than caused by reading.
+    void scheduleAt(Session& _session, std::chrono::steady_clock::time_point _time);
+
+  private:
+    struct Entry {
+        Session* session;
+        NativeHandle handle;
+        uint64_t id;
+        bool armed = true;          // handle is watched
+        bool reading = false;       // onReadable() is running
+        bool resumeRequested = false; // resume() was called while reading
+        bool queued = false;        // in readyQueue_ or being processed
+        bool running = false;       // process() is running
+        bool rescheduled = false;   // schedule() was called while running
+    };
+
+    void reactorThread();
+    void serviceReadable(uint64_t _id);
+    void workerThread();
+    void watch(Entry& _entry);
+    void unwatch(Entry& _entry);
+    void scheduleLocked(Entry& _entry);
+    void scheduleDueLocked();
+
+  private:
+#if defined(_WIN32)
+    void* completionPort_ = nullptr; // HANDLE of the I/O completion port
+#else
+    int epoll_ = -1;
+    int wakeup_ = -1;           // eventfd to stop the reactor thread
+#endif
+    bool quit_ = false;
+
+    std::mutex lock_;
+    std::condition_variable readyChanged_;  // readyQueue_, timers_ or quit_ changed
+    std::condition_variable entryChanged_;  // an entry's reading or running state changed
+    uint64_t nextId_ = 1;
+    std::unordered_map<uint64_t, std::unique_ptr<Entry>> entries_;
+    std::unordered_map<Session const*, uint64_t> ids_;
+    std::deque<uint64_t> readyQueue_;
+    std::multimap<std::chrono::steady_clock::time_point, uint64_t> timers_; // waited for by the workers
+
+    std::thread reactor_;
+    std::vector<std::thread> workers_;
+};
+
+}  // namespace terminal
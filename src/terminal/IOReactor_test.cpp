@@ -0,0 +1,211 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2020 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <terminal/IOReactor.h>
+#include <catch2/catch.hpp>
+
+#if defined(__linux__)
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace terminal;
+using namespace std::chrono_literals;
+using std::string;
+
+namespace
+{
+    /// Session reading from a non-blocking pipe, having @p _slicesPerByte slices to process per byte read.
+    class PipeSession : public IOReactor::Session {
+      public:
+        explicit PipeSession(int _slicesPerByte = 1) : slicesPerByte_{ _slicesPerByte }
+        {
+            REQUIRE(pipe2(fds_, O_NONBLOCK | O_CLOEXEC) == 0);
+        }
+
+        ~PipeSession() override
+        {
+            ::close(fds_[0]);
+            if (fds_[1] >= 0)
+                ::close(fds_[1]);
+        }
+
+        int readEnd() const noexcept { return fds_[0]; }
+
+        void send(string const& _data) { REQUIRE(::write(fds_[1], _data.data(), _data.size()) == static_cast<ssize_t>(_data.size())); }
+        void hangUp() { ::close(fds_[1]); fds_[1] = -1; }
+
+        bool onReadable() override
+        {
+            char buf[256];
+            auto const n = ::read(fds_[0], buf, sizeof(buf));
+            if (n <= 0)
+            {
+                closed_ = n == 0;
+                return false;
+            }
+            auto const _l = std::scoped_lock{lock_};
+            pendingSlices_ += static_cast<int>(n) * slicesPerByte_;
+            return !paused_;
+        }
+
+        bool process() override
+        {
+            ++calls_;
+            auto const _l = std::scoped_lock{lock_};
+            if (pendingSlices_ > 0)
+            {
+                --pendingSlices_;
+                ++processedSlices_;
+                done_.notify_all();
+            }
+            return pendingSlices_ > 0;
+        }
+
+        /// Waits (at most @p _timeout) for @p _count slices processed in total.
+        bool waitProcessed(int _count, std::chrono::milliseconds _timeout = 5s)
+        {
+            auto l = std::unique_lock{lock_};
+            return done_.wait_for(l, _timeout, [&]() { return processedSlices_ >= _count; });
+        }
+
+        int processed()
+        {
+            auto const _l = std::scoped_lock{lock_};
+            return processedSlices_;
+        }
+
+        void pause(bool _paused)
+        {
+            auto const _l = std::scoped_lock{lock_};
+            paused_ = _paused;
+        }
+
+        bool closed() const noexcept { return closed_.load(); }
+
+        /// @returns number of times process() has been invoked, with or without work pending.
+        int calls() const noexcept { return calls_.load(); }
+
+      private:
+        int fds_[2] = {-1, -1};
+        int slicesPerByte_;
+        std::mutex lock_;
+        std::condition_variable done_;
+        int pendingSlices_ = 0;
+        int processedSlices_ = 0;
+        bool paused_ = false;
+        std::atomic<bool> closed_ = false;
+        std::atomic<int> calls_ = 0;
+    };
+}
+
+TEST_CASE("IOReactor.process", "[reactor]")
+{
+    auto reactor = IOReactor{2};
+    auto session = PipeSession{};
+    reactor.add(session.readEnd(), session);
+
+    session.send("abc");
+    CHECK(session.waitProcessed(3));
+
+    session.send("de");
+    CHECK(session.waitProcessed(5));
+
+    reactor.remove(session);
+}
+
+TEST_CASE("IOReactor.fairness", "[reactor]")
+{
+    // With a single worker, a session having lots of work pending must not delay others
+    // until it is done.
+    auto reactor = IOReactor{1};
+    auto flooding = PipeSession{1'000'000};
+    auto quiet = PipeSession{};
+    reactor.add(flooding.readEnd(), flooding);
+    reactor.add(quiet.readEnd(), quiet);
+
+    flooding.send("x");
+    REQUIRE(flooding.waitProcessed(1));
+
+    quiet.send("y");
+    CHECK(quiet.waitProcessed(1));
+    CHECK(flooding.processed() < 1'000'000);
+
+    reactor.remove(flooding);
+    reactor.remove(quiet);
+}
+
+TEST_CASE("IOReactor.resume", "[reactor]")
+{
+    auto reactor = IOReactor{1};
+    auto session = PipeSession{};
+    session.pause(true);
+    reactor.add(session.readEnd(), session);
+
+    // Not watched anymore after the first read, until resumed.
+    session.send("a");
+    REQUIRE(session.waitProcessed(1));
+    session.send("b");
+    CHECK_FALSE(session.waitProcessed(2, 50ms));
+
+    session.pause(false);
+    reactor.resume(session);
+    CHECK(session.waitProcessed(2));
+
+    reactor.remove(session);
+}
+
+TEST_CASE("IOReactor.scheduleAt", "[reactor]")
+{
+    auto reactor = IOReactor{2};
+    auto session = PipeSession{};
+    reactor.add(session.readEnd(), session);
+
+    auto const start = std::chrono::steady_clock::now();
+    reactor.scheduleAt(session, start + 100ms);
+    reactor.scheduleAt(session, start + 50ms);
+    for (int i = 0; i < 500 && session.calls() == 0; ++i)
+        std::this_thread::sleep_for(1ms);
+    CHECK(session.calls() >= 1);
+    CHECK(std::chrono::steady_clock::now() - start >= 50ms);
+
+    for (int i = 0; i < 500 && session.calls() < 2; ++i)
+        std::this_thread::sleep_for(1ms);
+    CHECK(session.calls() == 2);
+    CHECK(std::chrono::steady_clock::now() - start >= 100ms);
+
+    reactor.remove(session);
+}
+
+TEST_CASE("IOReactor.hangUp", "[reactor]")
+{
+    auto reactor = IOReactor{1};
+    auto session = PipeSession{};
+    reactor.add(session.readEnd(), session);
+
+    session.hangUp();
+    for (int i = 0; i < 500 && !session.closed(); ++i)
+        std::this_thread::sleep_for(1ms);
+    CHECK(session.closed());
+
+    reactor.remove(session);
+}
+
+#endif
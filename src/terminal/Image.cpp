@@ -13,86 +13,219 @@
  */
 #include <terminal/Image.h>
 
+#include <crispy/hash.h>
+
 #include <algorithm>
+#include <array>
 #include <memory>
+#include <vector>
 
 using std::copy;
+using std::max;
 using std::min;
 using std::move;
+using std::pair;
 using std::shared_ptr;
+using std::string_view;
 
 namespace terminal {
 
+namespace
+{
+    /// @returns 64-bit hash of the given image, seeded with its format and size.
+    template <typename Bytes>
+    uint64_t hashImage(ImageFormat _format, Size _size, Bytes const& _data) noexcept
+    {
+        auto seed = crispy::hash_word(static_cast<uint64_t>(_format));
+        seed = crispy::hash_word((static_cast<uint64_t>(_size.width) << 32) | static_cast<uint32_t>(_size.height), seed);
+        return crispy::hash_bytes(_data.data(), _data.size(), seed);
+    }
+}
+
 Image::Data RasterizedImage::fragment(Coordinate _pos) const
 {
-    // TODO: respect alignment hint
-    // TODO: respect resize hint
+    return fragment(_pos, Size{1, 1});
+}
 
-    auto const xOffset = _pos.column * cellSize_.width;
-    auto const yOffset = _pos.row * cellSize_.height;
-    auto const pixelOffset = Coordinate{yOffset, xOffset};
+ImageRect RasterizedImage::placement() const noexcept
+{
+    auto const areaWidth = static_cast<double>(cellSpan_.width * cellSize_.width);
+    auto const areaHeight = static_cast<double>(cellSpan_.height * cellSize_.height);
+    auto const imageWidth = static_cast<double>(image_->width());
+    auto const imageHeight = static_cast<double>(image_->height());
+    if (imageWidth <= 0 || imageHeight <= 0)
+        return ImageRect{};
 
-    Image::Data fragData;
-    fragData.resize(cellSize_.width * cellSize_.height * 4); // RGBA
-    auto const availableWidth = min(image_->width() - pixelOffset.column, cellSize_.width);
-    auto const availableHeight = min(image_->height() - pixelOffset.row, cellSize_.height);
-
-    // auto const availableSize = Size{availableWidth, availableHeight};
-    // std::cout << fmt::format(
-    //     "RasterizedImage.fragment({}): pixelOffset={}, cellSize={}/{}\n",
-    //     _pos,
-    //     pixelOffset,
-    //     cellSize_,
-    //     availableSize
-    // );
-
-    // auto const fitsWidth = pixelOffset.column + cellSize_.width < image_.get().width();
-    // auto const fitsHeight = pixelOffset.row + cellSize_.height < image_.get().height();
-    // if (!fitsWidth || !fitsHeight)
-    //     std::cout << fmt::format("ImageFragment: out of bounds{}{} ({}x{}); {}\n",
-    //             fitsWidth ? "" : " (width)",
-    //             fitsHeight ? "" : " (height)",
-    //             availableWidth,
-    //             availableHeight,
-    //             *this);
+    auto const [width, height] = [&]() -> pair<double, double> {
+        switch (resizePolicy_)
+        {
+            case ImageResize::NoResize:
+                break;
+            case ImageResize::ResizeToFit:
+            {
+                auto const scale = min(areaWidth / imageWidth, areaHeight / imageHeight);
+                return pair{imageWidth * scale, imageHeight * scale};
+            }
+            case ImageResize::ResizeToFill:
+            {
+                auto const scale = max(areaWidth / imageWidth, areaHeight / imageHeight);
+                return pair{imageWidth * scale, imageHeight * scale};
+            }
+            case ImageResize::StretchToFill:
+                return pair{areaWidth, areaHeight};
+        }
+        return pair{imageWidth, imageHeight};
+    }();
+
+    // Alignments are enumerated row by row, each being start, center and end.
+    auto const alignment = static_cast<int>(alignmentPolicy_);
+    auto const align = [](int _position, double _area, double _extent) {
+        return (_area - _extent) * _position / 2.0;
+    };
+
+    return ImageRect{
+        align(alignment % 3, areaWidth, width),
+        align(alignment / 3, areaHeight, height),
+        width,
+        height
+    };
+}
 
+Image::Data RasterizedImage::fragment(Coordinate _pos, Size _cellCount) const
+{
     // TODO: if input format is (RGB | PNG), transform to RGBA
 
-    auto target = &fragData[0];
-    for (int y = 0; y < availableHeight; ++y)
+    auto const pixelOffset = Coordinate{_pos.row * cellSize_.height, _pos.column * cellSize_.width};
+    auto const width = _cellCount.width * cellSize_.width;
+    auto const height = _cellCount.height * cellSize_.height;
+    auto const area = placement();
+
+    // @returns the image pixel sampled by the center of the given target pixel, or -1 for the gap.
+    auto const sample = [](int _target, double _areaOffset, double _areaExtent, int _imageExtent) {
+        auto const position = (_target + 0.5 - _areaOffset) / _areaExtent;
+        return position >= 0.0 && position < 1.0 ? min(static_cast<int>(position * _imageExtent), _imageExtent - 1) : -1;
+    };
+
+    auto columns = std::vector<int>(static_cast<size_t>(width));
+    for (int x = 0; x < width; ++x)
+        columns[static_cast<size_t>(x)] = sample(pixelOffset.column + x, area.left, area.width, image_->width());
+
+    // Evicted images are rendered in their gap color only.
+    auto const data = image_->data();
+    auto const defaultColor = std::array<uint8_t, 4>{
+        defaultColor_.red(),
+        defaultColor_.green(),
+        defaultColor_.blue(),
+        defaultColor_.alpha()
+    };
+
+    Image::Data fragData;
+    fragData.resize(static_cast<size_t>(width * height * 4)); // RGBA
+    auto target = fragData.data();
+    for (int y = 0; y < height; ++y)
+    {
+        auto const row = data ? sample(pixelOffset.row + y, area.top, area.height, image_->height()) : -1;
+        for (int const column : columns)
+        {
+            auto const source = row >= 0 && column >= 0
+                ? &(*data)[static_cast<size_t>(row * image_->width() + column) * 4]
+                : defaultColor.data();
+            target = copy(source, source + 4, target);
+        }
+    }
+
+    return fragData;
+}
+
+shared_ptr<Image const> ImagePool::create(ImageFormat _format, Size _size, Image::Data&& _data)
+{
+    auto const hash = hashImage(_format, _size, _data);
+
+    auto const [first, last] = imagesByHash_.equal_range(hash);
+    for (auto i = first; i != last; ++i)
     {
-        auto const startOffset = ((pixelOffset.row + y) * image_->width() + pixelOffset.column) * 4;
-        auto const source = &image_->data()[startOffset];
-        target = copy(source, source + availableWidth * 4, target);
+        Entry& entry = *i->second;
+        if (entry.compressed || entry.image.format() != _format || entry.image.size() != _size)
+            continue;
+
+        auto const data = entry.image.data();
+        if (data && *data != _data)
+            continue;
 
-        // fill vertical gap on right
-        for (int x = availableWidth; x < cellSize_.width; ++x)
+        // An evicted image is provided with its pixel data again, as it is about to be used again.
+        if (!data)
         {
-            *target++ = defaultColor_.red();
-            *target++ = defaultColor_.green();
-            *target++ = defaultColor_.blue();
-            *target++ = defaultColor_.alpha();
+            memoryUsage_ += _data.size();
+            entry.image.restore(move(_data));
         }
+
+        ++deduplicated_;
+        return entry.ref.lock();
     }
 
-    // fill horizontal gap at the bottom
-    for (int y = availableHeight * cellSize_.width; y < cellSize_.height * cellSize_.width; ++y)
+    auto const bytes = _data.size();
+    Entry& entry = images_.emplace_back(hash, false, nextImageId_++, _format, move(_data), _size);
+    auto image = shared_ptr<Image const>(&entry.image,
+                                         [this](Image const* _image) { removeImage(const_cast<Image*>(_image)); });
+    entry.ref = image;
+    imagesByHash_.emplace(hash, &entry);
+    memoryUsage_ += bytes;
+    return image;
+}
+
+pair<shared_ptr<Image const>, bool> ImagePool::createCompressed(ImageFormat _format,
+                                                                Size _size,
+                                                                string_view _data)
+{
+    // The compressed data is not kept, hence images decoded from it are identified by hash only.
+    auto const hash = hashImage(_format, _size, _data);
+
+    auto const [first, last] = imagesByHash_.equal_range(hash);
+    for (auto i = first; i != last; ++i)
     {
-        *target++ = defaultColor_.red();
-        *target++ = defaultColor_.green();
-        *target++ = defaultColor_.blue();
-        *target++ = defaultColor_.alpha();
+        Entry& entry = *i->second;
+        if (!entry.compressed || entry.image.size() != _size)
+            continue;
+
+        ++deduplicated_;
+        return pair{entry.ref.lock(), entry.image.evicted()};
     }
 
-    return fragData;
+    Entry& entry = images_.emplace_back(hash, true, nextImageId_++, _size);
+    auto image = shared_ptr<Image const>(&entry.image,
+                                         [this](Image const* _image) { removeImage(const_cast<Image*>(_image)); });
+    entry.ref = image;
+    imagesByHash_.emplace(hash, &entry);
+    return pair{image, true};
 }
 
-shared_ptr<Image const> ImagePool::create(ImageFormat _format, Size _size, Image::Data&& _data)
+void ImagePool::provide(Image const& _image, Image::Data&& _data)
 {
-    // TODO: This operation should be idempotent, i.e. if that image has been created already, return a reference to that.
-    images_.emplace_back(nextImageId_++, _format, move(_data), _size);
-    return shared_ptr<Image>(&images_.back(),
-                             [this](Image* _image) { removeImage(_image); });
+    auto i = find_if(images_.begin(), images_.end(), [&](Entry const& p) { return &p.image == &_image; });
+    if (i == images_.end())
+        return;
+
+    if (auto const data = i->image.data(); data)
+        memoryUsage_ -= data->size();
+
+    memoryUsage_ += _data.size();
+    i->image.restore(move(_data));
+}
+
+void ImagePool::evict(std::function<bool(Image const&)> const& _inUse)
+{
+    for (auto i = images_.begin(); i != images_.end() && exceedsMemoryBudget(); ++i)
+    {
+        Image& image = i->image;
+        auto const data = image.data();
+        if (!data || _inUse(image))
+            continue;
+
+        memoryUsage_ -= data->size();
+        ++evicted_;
+        image.evict();
+        onImageRemove_(&image);
+    }
 }
 
 shared_ptr<RasterizedImage const> ImagePool::rasterize(shared_ptr<Image const> _image,
@@ -111,8 +244,21 @@ void ImagePool::removeImage(Image* _image)
 {
     if (auto i = find_if(images_.begin(),
                          images_.end(),
-                         [&](Image const& p) { return &p == _image; }); i != images_.end())
+                         [&](Entry const& p) { return &p.image == _image; }); i != images_.end())
     {
+        auto const [first, last] = imagesByHash_.equal_range(i->hash);
+        for (auto k = first; k != last; ++k)
+        {
+            if (k->second == &*i)
+            {
+                imagesByHash_.erase(k);
+                break;
+            }
+        }
+
+        if (auto const data = _image->data(); data)
+            memoryUsage_ -= data->size();
+
         onImageRemove_(_image);
         images_.erase(i);
     }
@@ -23,6 +23,9 @@
 #include <list>
 #include <map>
 #include <memory>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
 namespace terminal {
@@ -37,6 +40,7 @@ enum class ImageFormat {
     RGB,
     RGBA,
     PNG,
+    JPEG,
 };
 
 /**
@@ -54,7 +58,15 @@ class Image {
     Image(Id _id, ImageFormat _format, Data _data, Size _pixelSize) :
         id_{ _id },
         format_{ _format },
-        data_{ move(_data) },
+        data_{ std::make_shared<Data const>(move(_data)) },
+        size_{ _pixelSize }
+    {}
+
+    /// Constructs an RGBA image whose pixel data is provided later on.
+    Image(Id _id, Size _pixelSize) :
+        id_{ _id },
+        format_{ ImageFormat::RGBA },
+        data_{},
         size_{ _pixelSize }
     {}
 
@@ -65,15 +77,30 @@ class Image {
 
     constexpr Id id() const noexcept { return id_; }
     constexpr ImageFormat format() const noexcept { return format_; }
-    Data const& data() const noexcept { return data_; }
     constexpr Size size() const noexcept { return size_; }
     constexpr int width() const noexcept { return size_.width; }
     constexpr int height() const noexcept { return size_.height; }
 
+    /// @returns the image's pixel data, or nullptr if evicted by the ImagePool.
+    ///
+    /// The data may be evicted concurrently, hence a reference is handed out to keep it alive.
+    std::shared_ptr<Data const> data() const noexcept { return std::atomic_load(&data_); }
+
+    bool evicted() const noexcept { return !data(); }
+
+  private:
+    friend class ImagePool;
+
+    /// Releases the pixel data, leaving the image in place, rendered in its gap color.
+    void evict() noexcept { std::atomic_store(&data_, std::shared_ptr<Data const>{}); }
+
+    /// Provides the pixel data of an evicted image again.
+    void restore(Data&& _data) { std::atomic_store(&data_, std::make_shared<Data const>(move(_data))); }
+
   private:
     Id const id_;
     ImageFormat const format_;
-    Data const data_;
+    std::shared_ptr<Data const> data_;
     Size const size_;
 };
 
@@ -85,6 +112,19 @@ enum class ImageResize {
     StretchToFill,
 };
 
+/// Requested width or height of an image to be placed onto the screen.
+struct ImageExtent {
+    enum class Unit {
+        Auto,       // the image's own size
+        Cells,
+        Pixels,
+        Percent,    // of the screen's size
+    };
+
+    Unit unit = Unit::Auto;
+    int value = 0;
+};
+
 /// Image alignment policy are used to properly align the image to a given spot when not fully
 /// filling the area this image as to be placed to.
 enum class ImageAlignment {
@@ -99,6 +139,14 @@ enum class ImageAlignment {
     BottomEnd
 };
 
+/// Rectangle in pixels, of fractional position and extent once scaled.
+struct ImageRect {
+    double left = 0;
+    double top = 0;
+    double width = 0;
+    double height = 0;
+};
+
 /**
  * RasterizedImage wraps an Image into a fixed-size grid with some additional graphical properties for rasterization.
  */
@@ -131,9 +179,20 @@ class RasterizedImage
     Size cellSpan() const noexcept { return cellSpan_; }
     Size cellSize() const noexcept { return cellSize_; }
 
+    /// @returns the rectangle the image is drawn into, in pixels relative to the top left of the
+    ///          grid cells spanned, as determined by the resize and alignment policies.
+    ///
+    /// Any part of the grid cells not covered shows the default color, and any part of the image
+    /// beyond the grid cells is cut off.
+    ImageRect placement() const noexcept;
+
     /// @returns an RGBA buffer for a grid cell at given coordinate @p _pos of the rasterized image.
     Image::Data fragment(Coordinate _pos) const;
 
+    /// @returns an RGBA buffer for the block of @p _cellCount grid cells starting at the given
+    ///          coordinate @p _pos of the rasterized image, with the cells' rows laid out continuously.
+    Image::Data fragment(Coordinate _pos, Size _cellCount) const;
+
   private:
     std::shared_ptr<Image const> const image_;  //!< Reference to the Image to be rasterized.
     ImageAlignment const alignmentPolicy_;      //!< Alignment policy of the image inside the raster size.
@@ -166,6 +225,8 @@ class ImageFragment {
     Coordinate offset() const noexcept { return offset_; }
 
     /// Extracts the data from the image that is to be rendered.
+    ///
+    /// Renderers scaling on the GPU use RasterizedImage::placement() instead.
     Image::Data data() const { return rasterizedImage_->fragment(offset_); }
 
   private:
@@ -193,6 +254,9 @@ inline bool operator<(ImageFragment const& a, ImageFragment const& b) noexcept
 /// Highlevel Image Storage Pool.
 ///
 /// Stores RGBA images in host memory, also taking care of eviction.
+///
+/// Images of identical contents are stored once. Once the pool's images exceed the memory budget,
+/// the pixel data of the least recently created images not in use anymore is evicted.
 class ImagePool {
   public:
     using OnImageRemove = std::function<void(Image const*)>;
@@ -205,9 +269,35 @@ class ImagePool {
 
     ImagePool() : ImagePool([](auto) {}, 1) {}
 
-    /// Creates an RGBA image of given size in pixels.
+    /// Creates an RGBA image of given size in pixels, or returns the existing image of the same contents.
     std::shared_ptr<Image const> create(ImageFormat _format, Size _pixelSize, Image::Data&& _data);
 
+    /// Creates an RGBA image of given size in pixels, to be decoded from compressed @p _data of
+    /// the given format, or returns the existing image decoded from the same data.
+    ///
+    /// @returns the image and whether or not its pixel data is to be provided via provide().
+    std::pair<std::shared_ptr<Image const>, bool> createCompressed(ImageFormat _format,
+                                                                   Size _pixelSize,
+                                                                   std::string_view _data);
+
+    /// Provides the pixel data of an image created from compressed data.
+    void provide(Image const& _image, Image::Data&& _data);
+
+    /// Sets the maximum number of bytes of pixel data to keep, or 0 for no limit.
+    void setMaxMemory(size_t _bytes) noexcept { maxMemory_ = _bytes; }
+    size_t maxMemory() const noexcept { return maxMemory_; }
+
+    /// @returns number of bytes of pixel data held by the pool.
+    size_t memoryUsage() const noexcept { return memoryUsage_; }
+
+    bool exceedsMemoryBudget() const noexcept { return maxMemory_ != 0 && memoryUsage_ > maxMemory_; }
+
+    /// Evicts the pixel data of the least recently created images until the memory budget is met,
+    /// sparing the images @p _inUse reports to be in use still.
+    ///
+    /// Evicted images are notified as removed, and render in their gap color from then on.
+    void evict(std::function<bool(Image const&)> const& _inUse);
+
     /// Rasterizes an Image.
     std::shared_ptr<RasterizedImage const> rasterize(std::shared_ptr<Image const> _image,
                                                      ImageAlignment _alignmentPolicy,
@@ -225,14 +315,35 @@ class ImagePool {
     size_t imageCount() const noexcept { return images_.size(); }
     size_t rasterizedImageCount() const noexcept { return rasterizedImages_.size(); }
     size_t namedImageCount() const noexcept { return namedImages_.size(); }
+    uint64_t deduplicatedImageCount() const noexcept { return deduplicated_; }
+    uint64_t evictedImageCount() const noexcept { return evicted_; }
 
   private:
+    struct Entry {
+        template <typename... Args>
+        Entry(uint64_t _hash, bool _compressed, Args&&... _args) :
+            hash{ _hash },
+            compressed{ _compressed },
+            image{ std::forward<Args>(_args)... }
+        {}
+
+        uint64_t const hash;                //!< hash of the image's format, size and pixel (or compressed) data
+        bool const compressed;              //!< whether or not the image is decoded from compressed data
+        Image image;
+        std::weak_ptr<Image const> ref;     //!< handed out references to the image
+    };
+
     void removeImage(Image* _image);                        //!< Removes given image from pool.
     void removeRasterizedImage(RasterizedImage* _image);    //!< Removes a rasterized image from pool.
 
   private:
     Image::Id nextImageId_;                                             //!< ID for next image to be put into the pool
-    std::list<Image> images_;                                           //!< pool of raw images
+    std::list<Entry> images_;                                           //!< pool of raw images, least recently created first
+    std::unordered_multimap<uint64_t, Entry*> imagesByHash_;            //!< images by content hash, for deduplication
+    size_t maxMemory_ = 0;                                              //!< maximum number of bytes of pixel data, 0 for no limit
+    size_t memoryUsage_ = 0;                                            //!< number of bytes of pixel data not evicted
+    uint64_t deduplicated_ = 0;                                         //!< number of images created that existed already
+    uint64_t evicted_ = 0;                                              //!< number of images whose pixel data has been evicted
     std::list<RasterizedImage> rasterizedImages_;                       //!< pool of rasterized images
     std::map<std::string, std::shared_ptr<Image const>> namedImages_;   //!< keeps mapping from name to raw image
     OnImageRemove const onImageRemove_;                                 //!< Callback to be invoked when image gets removed from pool.
@@ -0,0 +1,169 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2020 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <terminal/ImageDecoder.h>
+
+using std::move;
+using std::nullopt;
+using std::optional;
+using std::pair;
+using std::scoped_lock;
+using std::string;
+using std::string_view;
+using std::unique_lock;
+
+namespace terminal {
+
+namespace
+{
+    constexpr uint32_t bigEndian16(string_view _data, size_t _offset) noexcept
+    {
+        return static_cast<uint32_t>(static_cast<uint8_t>(_data[_offset])) << 8
+             | static_cast<uint32_t>(static_cast<uint8_t>(_data[_offset + 1]));
+    }
+
+    constexpr uint32_t bigEndian32(string_view _data, size_t _offset) noexcept
+    {
+        return bigEndian16(_data, _offset) << 16 | bigEndian16(_data, _offset + 2);
+    }
+
+    optional<Size> probePNG(string_view _data) noexcept
+    {
+        // signature, followed by the IHDR chunk: length, type, width, height, ...
+        auto constexpr signature = string_view{"\x89PNG\r\n\x1a\n", 8};
+        if (_data.size() < 24 || _data.substr(0, 8) != signature || _data.substr(12, 4) != "IHDR")
+            return nullopt;
+
+        return Size{static_cast<int>(bigEndian32(_data, 16)), static_cast<int>(bigEndian32(_data, 20))};
+    }
+
+    optional<Size> probeJPEG(string_view _data) noexcept
+    {
+        if (_data.size() < 4 || static_cast<uint8_t>(_data[0]) != 0xFF || static_cast<uint8_t>(_data[1]) != 0xD8)
+            return nullopt;
+
+        // Skips the segments up to the first start-of-frame, which holds the image size.
+        size_t i = 2;
+        while (i + 4 <= _data.size())
+        {
+            if (static_cast<uint8_t>(_data[i]) != 0xFF)
+                return nullopt;
+
+            auto const marker = static_cast<uint8_t>(_data[i + 1]);
+            if (marker == 0xFF) // fill byte
+            {
+                ++i;
+                continue;
+            }
+
+            if (marker == 0x01 || (marker >= 0xD0 && marker <= 0xD7)) // segments without length
+            {
+                i += 2;
+                continue;
+            }
+
+            auto const length = bigEndian16(_data, i + 2);
+            auto const isStartOfFrame = marker >= 0xC0 && marker <= 0xCF
+                                     && marker != 0xC4 && marker != 0xC8 && marker != 0xCC;
+            if (isStartOfFrame)
+            {
+                // length, precision, height, width
+                if (i + 9 > _data.size())
+                    return nullopt;
+                return Size{static_cast<int>(bigEndian16(_data, i + 7)), static_cast<int>(bigEndian16(_data, i + 5))};
+            }
+
+            if (marker == 0xD9 || marker == 0xDA || length < 2) // end of image, start of scan
+                return nullopt;
+
+            i += 2 + length;
+        }
+
+        return nullopt;
+    }
+}
+
+optional<pair<ImageFormat, Size>> probeImage(string_view _data) noexcept
+{
+    if (auto const size = probePNG(_data); size.has_value())
+        return pair{ImageFormat::PNG, *size};
+
+    if (auto const size = probeJPEG(_data); size.has_value())
+        return pair{ImageFormat::JPEG, *size};
+
+    return nullopt;
+}
+
+ImageDecoder::ImageDecoder(OnDecoded _onDecoded) :
+    onDecoded_{ move(_onDecoded) }
+{
+}
+
+ImageDecoder::~ImageDecoder()
+{
+    {
+        auto const _l = scoped_lock{mutex_};
+        quit_ = true;
+    }
+    wakeup_.notify_all();
+
+    if (thread_.joinable())
+        thread_.join();
+}
+
+void ImageDecoder::setDecode(Decode _decode)
+{
+    auto const _l = scoped_lock{mutex_};
+    decode_ = move(_decode);
+}
+
+void ImageDecoder::decode(std::shared_ptr<Image const> _image, string _data)
+{
+    {
+        auto const _l = scoped_lock{mutex_};
+        if (!decode_)
+            return;
+
+        jobs_.emplace_back(Job{move(_image), move(_data)});
+
+        if (!thread_.joinable())
+            thread_ = std::thread(&ImageDecoder::work, this);
+    }
+    wakeup_.notify_one();
+}
+
+void ImageDecoder::work()
+{
+    for (;;)
+    {
+        auto job = Job{};
+        auto decode = Decode{};
+        {
+            auto lock = unique_lock{mutex_};
+            wakeup_.wait(lock, [&]() { return quit_ || !jobs_.empty(); });
+            if (quit_)
+                return;
+            job = move(jobs_.front());
+            jobs_.pop_front();
+            decode = decode_;
+        }
+
+        auto data = decode ? decode(job.data, job.image->size()) : nullopt;
+        if (data.has_value() && data->size() != static_cast<size_t>(job.image->width()) * static_cast<size_t>(job.image->height()) * 4)
+            data.reset();
+
+        onDecoded_(move(job.image), move(data));
+    }
+}
+
+} // end namespace
@@ -0,0 +1,76 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2020 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <terminal/Image.h>
+#include <terminal/Size.h>
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+
+namespace terminal {
+
+/// @returns the format and size in pixels of the given compressed (PNG or JPEG) image,
+///          by inspecting its header only, or std::nullopt if not recognized.
+std::optional<std::pair<ImageFormat, Size>> probeImage(std::string_view _data) noexcept;
+
+/// Decodes compressed images into RGBA on a worker thread.
+///
+/// The decoding itself is provided by the embedder, as libterminal does not depend on any image
+/// codecs, and the image it is decoded for has been placed onto the screen already.
+class ImageDecoder {
+  public:
+    /// Decodes @p _data into an RGBA buffer of exactly @p _pixelSize pixels, or std::nullopt on failure.
+    using Decode = std::function<std::optional<Image::Data>(std::string_view _data, Size _pixelSize)>;
+
+    /// Invoked on the worker thread with the decoded pixel data, or std::nullopt if decoding failed.
+    using OnDecoded = std::function<void(std::shared_ptr<Image const>&& _image, std::optional<Image::Data>&& _data)>;
+
+    explicit ImageDecoder(OnDecoded _onDecoded);
+    ~ImageDecoder();
+
+    ImageDecoder(ImageDecoder const&) = delete;
+    ImageDecoder& operator=(ImageDecoder const&) = delete;
+
+    void setDecode(Decode _decode);
+
+    /// Queues the compressed @p _data to be decoded into the pixel data of @p _image.
+    void decode(std::shared_ptr<Image const> _image, std::string _data);
+
+  private:
+    struct Job {
+        std::shared_ptr<Image const> image;
+        std::string data;
+    };
+
+    void work();
+
+    OnDecoded const onDecoded_;
+    Decode decode_;
+    std::deque<Job> jobs_;
+    std::mutex mutex_;
+    std::condition_variable wakeup_;
+    bool quit_ = false;
+    std::thread thread_; // started with the first job
+};
+
+} // end namespace
@@ -0,0 +1,90 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2020 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <terminal/ImageDecoder.h>
+#include <catch2/catch.hpp>
+
+#include <future>
+#include <string>
+
+using namespace terminal;
+using std::string;
+
+namespace
+{
+    /// @returns the leading bytes of a PNG file of the given size, up to and including its IHDR chunk.
+    string pngHeader(int _width, int _height)
+    {
+        auto const be32 = [](int _value) {
+            return string{char(_value >> 24), char(_value >> 16), char(_value >> 8), char(_value)};
+        };
+        return string("\x89PNG\r\n\x1A\n", 8)
+             + be32(13) + "IHDR" + be32(_width) + be32(_height)
+             + string("\x08\x06\x00\x00\x00", 5);
+    }
+
+    /// @returns the leading bytes of a baseline JPEG file of the given size, up to its SOF0 segment.
+    string jpegHeader(int _width, int _height)
+    {
+        return string("\xFF\xD8", 2)
+             + string("\xFF\xE0\x00\x04\x4A\x46", 6) // APP0, skipped
+             + string("\xFF\xC0\x00\x11\x08", 5)
+             + char(_height >> 8) + char(_height)
+             + char(_width >> 8) + char(_width)
+             + string("\x03", 1);
+    }
+}
+
+TEST_CASE("probeImage.PNG", "[image]")
+{
+    auto const probe = probeImage(pngHeader(640, 480));
+    REQUIRE(probe.has_value());
+    CHECK(probe->first == ImageFormat::PNG);
+    CHECK(probe->second == Size{640, 480});
+
+    CHECK_FALSE(probeImage(pngHeader(640, 480).substr(0, 20)).has_value());
+}
+
+TEST_CASE("probeImage.JPEG", "[image]")
+{
+    auto const probe = probeImage(jpegHeader(300, 200));
+    REQUIRE(probe.has_value());
+    CHECK(probe->first == ImageFormat::JPEG);
+    CHECK(probe->second == Size{300, 200});
+}
+
+TEST_CASE("probeImage.unknown", "[image]")
+{
+    CHECK_FALSE(probeImage("").has_value());
+    CHECK_FALSE(probeImage("GIF89a").has_value());
+}
+
+TEST_CASE("ImageDecoder.decode", "[image]")
+{
+    auto decoded = std::promise<std::optional<Image::Data>>{};
+    auto decoder = ImageDecoder{[&](auto&& _image, auto&& _data) {
+        _image.reset();
+        decoded.set_value(std::move(_data));
+    }};
+    decoder.setDecode([](std::string_view _data, Size _pixelSize) -> std::optional<Image::Data> {
+        return Image::Data(static_cast<size_t>(area(_pixelSize)) * 4, static_cast<uint8_t>(_data.size()));
+    });
+
+    auto const image = std::make_shared<Image const>(1, Size{2, 3});
+    decoder.decode(image, "abc");
+
+    auto const data = decoded.get_future().get();
+    REQUIRE(data.has_value());
+    CHECK(data->size() == 2 * 3 * 4);
+    CHECK(data->front() == 3);
+}
@@ -0,0 +1,177 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2020 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <terminal/Image.h>
+#include <catch2/catch.hpp>
+
+#include <vector>
+
+using namespace terminal;
+using std::vector;
+
+namespace
+{
+    auto constexpr FillColor = RGBAColor{0x10, 0x20, 0x30, 0x40};
+
+    /// @returns an RGBA image whose every pixel's red channel is its index.
+    Image::Data makePixels(Size _size)
+    {
+        auto data = Image::Data{};
+        for (int i = 0; i < _size.width * _size.height; ++i)
+        {
+            data.push_back(static_cast<uint8_t>(i));
+            data.push_back(0);
+            data.push_back(0);
+            data.push_back(0xFF);
+        }
+        return data;
+    }
+
+    /// @returns the red channel of every pixel of the given RGBA buffer.
+    vector<int> reds(Image::Data const& _data)
+    {
+        auto result = vector<int>{};
+        for (size_t i = 0; i < _data.size(); i += 4)
+            result.push_back(_data[i] == FillColor.red() && _data[i + 3] == FillColor.alpha() ? -1 : _data[i]);
+        return result;
+    }
+}
+
+TEST_CASE("RasterizedImage.fragment", "[image]")
+{
+    // 3x2 pixels, rasterized onto 2x2 cells of 2x1 pixels each.
+    auto pool = ImagePool{};
+    auto const image = pool.create(ImageFormat::RGBA, Size{3, 2}, makePixels(Size{3, 2}));
+    auto const rasterized = pool.rasterize(image, ImageAlignment::TopStart, ImageResize::NoResize,
+                                           FillColor, Size{2, 2}, Size{2, 1});
+
+    SECTION("single cell") {
+        CHECK(reds(rasterized->fragment(Coordinate{0, 0})) == vector<int>{0, 1});
+        CHECK(reds(rasterized->fragment(Coordinate{1, 0})) == vector<int>{3, 4});
+    }
+
+    SECTION("cell partially outside of the image") {
+        CHECK(reds(rasterized->fragment(Coordinate{0, 1})) == vector<int>{2, -1});
+    }
+
+    SECTION("cell fully outside of the image") {
+        CHECK(reds(rasterized->fragment(Coordinate{2, 2})) == vector<int>{-1, -1});
+    }
+
+    SECTION("block of cells") {
+        CHECK(reds(rasterized->fragment(Coordinate{0, 0}, Size{2, 2})) == vector<int>{0, 1, 2, -1,
+                                                                                    3, 4, 5, -1});
+        CHECK(reds(rasterized->fragment(Coordinate{1, 1}, Size{1, 2})) == vector<int>{5, -1,
+                                                                                    -1, -1});
+    }
+}
+
+TEST_CASE("RasterizedImage.placement", "[image]")
+{
+    // 2x1 pixels, rasterized onto 2x2 cells of 2x2 pixels each.
+    auto pool = ImagePool{};
+    auto const image = pool.create(ImageFormat::RGBA, Size{2, 1}, makePixels(Size{2, 1}));
+    auto const placement = [&](ImageAlignment _alignment, ImageResize _resize) {
+        auto const rect = pool.rasterize(image, _alignment, _resize, FillColor, Size{2, 2}, Size{2, 2})->placement();
+        return vector<double>{rect.left, rect.top, rect.width, rect.height};
+    };
+
+    CHECK(placement(ImageAlignment::TopStart, ImageResize::NoResize) == vector<double>{0, 0, 2, 1});
+    CHECK(placement(ImageAlignment::BottomEnd, ImageResize::NoResize) == vector<double>{2, 3, 2, 1});
+    CHECK(placement(ImageAlignment::MiddleCenter, ImageResize::ResizeToFit) == vector<double>{0, 1, 4, 2});
+    CHECK(placement(ImageAlignment::MiddleCenter, ImageResize::ResizeToFill) == vector<double>{-2, 0, 8, 4});
+    CHECK(placement(ImageAlignment::TopEnd, ImageResize::StretchToFill) == vector<double>{0, 0, 4, 4});
+
+    // The CPU rasterization follows the placement, too.
+    auto const fitted = pool.rasterize(image, ImageAlignment::MiddleCenter, ImageResize::ResizeToFit,
+                                       FillColor, Size{2, 2}, Size{2, 2});
+    CHECK(reds(fitted->fragment(Coordinate{0, 0}, Size{2, 2})) == vector<int>{-1, -1, -1, -1,
+                                                                             0,  0,  1,  1,
+                                                                             0,  0,  1,  1,
+                                                                             -1, -1, -1, -1});
+}
+
+TEST_CASE("ImagePool.deduplicate", "[image]")
+{
+    auto pool = ImagePool{};
+    auto const a = pool.create(ImageFormat::RGBA, Size{3, 2}, makePixels(Size{3, 2}));
+    auto const b = pool.create(ImageFormat::RGBA, Size{3, 2}, makePixels(Size{3, 2}));
+    auto const c = pool.create(ImageFormat::RGBA, Size{2, 3}, makePixels(Size{2, 3}));
+
+    CHECK(a == b);
+    CHECK(a != c);
+    CHECK(pool.imageCount() == 2);
+    CHECK(pool.deduplicatedImageCount() == 1);
+    CHECK(pool.memoryUsage() == 2 * 3 * 2 * 4);
+}
+
+TEST_CASE("ImagePool.evict", "[image]")
+{
+    auto removed = vector<Image::Id>{};
+    auto pool = ImagePool{[&](Image const* _image) { removed.push_back(_image->id()); }, 1};
+    pool.setMaxMemory(2 * 4 * 4);
+
+    auto const a = pool.create(ImageFormat::RGBA, Size{2, 2}, makePixels(Size{2, 2}));
+    auto const b = pool.create(ImageFormat::RGBA, Size{4, 1}, makePixels(Size{4, 1}));
+    CHECK_FALSE(pool.exceedsMemoryBudget());
+
+    auto const c = pool.create(ImageFormat::RGBA, Size{1, 4}, makePixels(Size{1, 4}));
+    REQUIRE(pool.exceedsMemoryBudget());
+
+    // The least recently created image not in use is evicted.
+    pool.evict([&](Image const& _image) { return _image.id() == a->id() || _image.id() == c->id(); });
+    CHECK_FALSE(pool.exceedsMemoryBudget());
+    CHECK(removed == vector<Image::Id>{b->id()});
+    CHECK(b->evicted());
+    CHECK(pool.evictedImageCount() == 1);
+    CHECK(pool.imageCount() == 3);
+
+    auto const rasterized = pool.rasterize(b, ImageAlignment::TopStart, ImageResize::NoResize,
+                                           FillColor, Size{1, 1}, Size{2, 1});
+    CHECK(reds(rasterized->fragment(Coordinate{0, 0})) == vector<int>{-1, -1});
+
+    // Creating the same image again provides the evicted one with its pixels again.
+    auto const d = pool.create(ImageFormat::RGBA, Size{4, 1}, makePixels(Size{4, 1}));
+    CHECK(d == b);
+    CHECK_FALSE(b->evicted());
+    CHECK(reds(rasterized->fragment(Coordinate{0, 0})) == vector<int>{0, 1});
+}
+
+TEST_CASE("ImagePool.compressed", "[image]")
+{
+    auto pool = ImagePool{[](Image const*) {}, 1};
+
+    auto const [a, aPending] = pool.createCompressed(ImageFormat::PNG, Size{2, 2}, "png data");
+    REQUIRE(aPending);
+    CHECK(a->evicted());
+    CHECK(pool.memoryUsage() == 0);
+
+    // The same compressed data shares its image, as long as it is still pending.
+    auto const [b, bPending] = pool.createCompressed(ImageFormat::PNG, Size{2, 2}, "png data");
+    CHECK(b == a);
+    CHECK(bPending);
+
+    pool.provide(*a, makePixels(Size{2, 2}));
+    CHECK_FALSE(a->evicted());
+    CHECK(pool.memoryUsage() == 2 * 2 * 4);
+
+    auto const [c, cPending] = pool.createCompressed(ImageFormat::PNG, Size{2, 2}, "png data");
+    CHECK(c == a);
+    CHECK_FALSE(cPending);
+    CHECK(pool.deduplicatedImageCount() == 2);
+
+    // Other sizes are decoded separately.
+    auto const [d, dPending] = pool.createCompressed(ImageFormat::PNG, Size{1, 1}, "png data");
+    CHECK(d != a);
+    CHECK(dPending);
+}
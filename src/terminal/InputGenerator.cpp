@@ -336,6 +336,8 @@ bool InputGenerator::generate(InputEvent const& _inputEvent)
 
 bool InputGenerator::generate(char32_t _characterEvent, Modifier _modifier)
 {
+    flushMouseMotion();
+
     char const chr = static_cast<char>(_characterEvent);
 
     // See section "Alt and Meta Keys" in ctlseqs.txt from xterm.
@@ -372,6 +374,8 @@ bool InputGenerator::generate(char32_t _characterEvent, Modifier _modifier)
 
 bool InputGenerator::generate(Key _key, Modifier _modifier)
 {
+    flushMouseMotion();
+
     if (_modifier)
     {
         if (auto mapping = tryMap(mappings::functionKeysWithModifiers, _key); mapping)
@@ -394,11 +398,21 @@ bool InputGenerator::generate(Key _key, Modifier _modifier)
 
 void InputGenerator::generatePaste(std::string_view const& _text)
 {
+    generatePasteBegin();
+    append(_text);
+    generatePasteEnd();
+}
+
+void InputGenerator::generatePasteBegin()
+{
+    flushMouseMotion();
+
     if (bracketedPaste_)
         append("\033[200~"sv);
+}
 
-    append(_text);
-
+void InputGenerator::generatePasteEnd()
+{
     if (bracketedPaste_)
         append("\033[201~"sv);
 }
@@ -435,6 +449,8 @@ inline bool InputGenerator::append(unsigned int _number)
 
 bool InputGenerator::generate(FocusInEvent const&)
 {
+    flushMouseMotion();
+
     if (generateFocusEvents())
     {
         append("\033[I");
@@ -445,6 +461,8 @@ bool InputGenerator::generate(FocusInEvent const&)
 
 bool InputGenerator::generate(FocusOutEvent const&)
 {
+    flushMouseMotion();
+
     if (generateFocusEvents())
     {
         append("\033[O");
@@ -463,6 +481,26 @@ void InputGenerator::setMouseProtocol(MouseProtocol _mouseProtocol, bool _enable
     }
     else
         mouseProtocol_ = std::nullopt;
+
+    // Reports held back are not meant for the newly requested protocol.
+    pendingMouseMotion_.reset();
+}
+
+void InputGenerator::setMouseMotionCoalescing(bool _enable)
+{
+    if (!_enable)
+        flushMouseMotion();
+    mouseMotionCoalescing_ = _enable;
+}
+
+bool InputGenerator::flushMouseMotion()
+{
+    if (!pendingMouseMotion_.has_value())
+        return false;
+
+    auto const motion = *pendingMouseMotion_;
+    pendingMouseMotion_.reset();
+    return generateMouse(MouseButton::Left, motion.modifier, motion.row, motion.column, MouseEventType::Drag);
 }
 
 void InputGenerator::setMouseTransport(MouseTransport _mouseTransport)
@@ -669,6 +707,8 @@ bool InputGenerator::mouseTransportURXVT(uint8_t _button, uint8_t _modifier, int
 
 bool InputGenerator::generate(MousePressEvent const& _mouse)
 {
+    flushMouseMotion();
+
     currentMousePosition_ = {_mouse.row, _mouse.column};
 
     switch (mouseWheelMode())
@@ -712,6 +752,8 @@ bool InputGenerator::generate(MousePressEvent const& _mouse)
 
 bool InputGenerator::generate(MouseReleaseEvent const& _mouse)
 {
+    flushMouseMotion();
+
     currentMousePosition_ = {_mouse.row, _mouse.column};
 
     if (auto i = currentlyPressedMouseButtons_.find(_mouse.button); i != currentlyPressedMouseButtons_.end())
@@ -731,6 +773,11 @@ bool InputGenerator::generate(MouseMoveEvent const& _mouse)
             bool const buttonsPressed = !currentlyPressedMouseButtons_.empty();
             bool const report = (mouseProtocol_.value() == MouseProtocol::ButtonTracking && buttonsPressed)
                               || mouseProtocol_.value() == MouseProtocol::AnyEventTracking;
+            if (report && mouseMotionCoalescing_)
+            {
+                pendingMouseMotion_ = MouseMotion{_mouse.modifier, _mouse.row, _mouse.column};
+                return true;
+            }
             if (report)
                 return generateMouse(MouseButton::Left,
                                      _mouse.modifier,
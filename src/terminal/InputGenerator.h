@@ -358,6 +358,16 @@ class InputGenerator {
     void setGenerateFocusEvents(bool _enable) noexcept { generateFocusEvents_ = _enable; }
     bool generateFocusEvents() const noexcept { return generateFocusEvents_; };
 
+    /// Enables merging consecutive mouse motion reports into the most recent one, which is then
+    /// only generated by flushMouseMotion() or ahead of any other input.
+    void setMouseMotionCoalescing(bool _enable);
+    bool mouseMotionCoalescing() const noexcept { return mouseMotionCoalescing_; }
+
+    /// Generates the mouse motion report held back by mouse motion coalescing, if any.
+    ///
+    /// @retval true a report has been generated.
+    bool flushMouseMotion();
+
     /// Generates input sequences for given input event.
     bool generate(InputEvent const& _inputEvent);
 
@@ -370,6 +380,10 @@ class InputGenerator {
     /// Generates input sequence for bracketed paste text.
     void generatePaste(std::string_view const& _text);
 
+    /// Generates the sequences enclosing pasted text, if in bracketed paste mode.
+    void generatePasteBegin();
+    void generatePasteEnd();
+
     /// Generates input sequence for a mouse button press event.
     bool generate(MousePressEvent const& _mousePress);
 
@@ -409,6 +423,7 @@ class InputGenerator {
     KeyMode numpadKeysMode_ = KeyMode::Normal;
     bool bracketedPaste_ = false;
     bool generateFocusEvents_ = false;
+    bool mouseMotionCoalescing_ = false;
     std::optional<MouseProtocol> mouseProtocol_ = std::nullopt;
     MouseTransport mouseTransport_ = MouseTransport::Default;
     MouseWheelMode mouseWheelMode_ = MouseWheelMode::Default;
@@ -416,6 +431,13 @@ class InputGenerator {
 
     std::set<MouseButton> currentlyPressedMouseButtons_{};
     terminal::Coordinate currentMousePosition_{0, 0}; // current mouse position
+
+    struct MouseMotion {
+        Modifier modifier;
+        int row;
+        int column;
+    };
+    std::optional<MouseMotion> pendingMouseMotion_;   // held back by mouse motion coalescing
 };
 
 inline std::string to_string(InputGenerator::MouseEventType _value)
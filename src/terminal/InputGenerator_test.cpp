@@ -0,0 +1,79 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2020 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <terminal/InputGenerator.h>
+#include <catch2/catch.hpp>
+
+#include <string>
+
+using namespace std;
+using namespace terminal;
+
+namespace
+{
+    string generated(InputGenerator& _generator)
+    {
+        auto sequence = InputGenerator::Sequence{};
+        _generator.swap(sequence);
+        return string(sequence.begin(), sequence.end());
+    }
+
+    InputGenerator anyEventTracking(bool _coalescing)
+    {
+        auto generator = InputGenerator{};
+        generator.setMouseProtocol(MouseProtocol::AnyEventTracking, true);
+        generator.setMouseTransport(MouseTransport::SGR);
+        generator.setMouseMotionCoalescing(_coalescing);
+        return generator;
+    }
+}
+
+TEST_CASE("InputGenerator.mouseMotion.uncoalesced")
+{
+    auto generator = anyEventTracking(false);
+    CHECK(generator.generate(MouseMoveEvent{1, 2}));
+    CHECK(generator.generate(MouseMoveEvent{1, 3}));
+    CHECK(generated(generator) == "\033[<32;2;1M\033[<32;3;1M");
+}
+
+TEST_CASE("InputGenerator.mouseMotion.coalesced")
+{
+    auto generator = anyEventTracking(true);
+    CHECK(generator.generate(MouseMoveEvent{1, 2}));
+    CHECK(generator.generate(MouseMoveEvent{1, 3}));
+    CHECK(generator.generate(MouseMoveEvent{2, 4}));
+    CHECK(generated(generator).empty());
+
+    CHECK(generator.flushMouseMotion());
+    CHECK(generated(generator) == "\033[<32;4;2M");
+    CHECK_FALSE(generator.flushMouseMotion());
+}
+
+TEST_CASE("InputGenerator.mouseMotion.flushed_ahead_of_other_input")
+{
+    auto generator = anyEventTracking(true);
+    CHECK(generator.generate(MouseMoveEvent{1, 2}));
+    CHECK(generator.generate(MouseMoveEvent{1, 3}));
+    CHECK(generator.generate(MousePressEvent{MouseButton::Left, Modifier::None, 1, 3}));
+    CHECK(generator.generate(U'a', Modifier::None));
+    CHECK(generated(generator) == "\033[<32;3;1M\033[<0;3;1Ma");
+}
+
+TEST_CASE("InputGenerator.mouseMotion.dropped_on_protocol_change")
+{
+    auto generator = anyEventTracking(true);
+    CHECK(generator.generate(MouseMoveEvent{1, 2}));
+    generator.setMouseProtocol(MouseProtocol::AnyEventTracking, false);
+    CHECK_FALSE(generator.flushMouseMotion());
+    CHECK(generated(generator).empty());
+}
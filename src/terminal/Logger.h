@@ -1,10 +1,14 @@
 #pragma once
 
+#include <crispy/escape.h>
 #include <crispy/overloaded.h>
 #include <fmt/format.h>
 
+#include <cstddef>
 #include <functional>
 #include <string>
+#include <type_traits>
+#include <utility>
 #include <variant>
 
 namespace terminal {
@@ -17,10 +21,12 @@ struct TraceInputEvent {
     std::string message;
 };
 
+/// Bytes sent to the application, escaped only when formatted.
 struct RawInputEvent {
     std::string sequence;
 };
 
+/// Bytes received from the application, escaped only when formatted.
 struct RawOutputEvent {
     std::string sequence;
 };
@@ -48,7 +54,68 @@ using LogEvent = std::variant<
     TraceOutputEvent
 >;
 
-using Logger = std::function<void(LogEvent)>;
+namespace detail
+{
+    template <typename T, typename Variant> struct variant_index;
+
+    template <typename T, typename... Ts>
+    struct variant_index<T, std::variant<Ts...>> {
+        static constexpr size_t value = []() {
+            size_t i = 0;
+            ((std::is_same_v<T, Ts> ? false : (++i, true)) && ...);
+            return i;
+        }();
+    };
+}
+
+/// @returns the index of @p Event among the alternatives of LogEvent.
+template <typename Event>
+constexpr size_t logEventIndex() noexcept
+{
+    return detail::variant_index<Event, LogEvent>::value;
+}
+
+/// Receiver of log events.
+///
+/// Events are only to be constructed when enabled(), as formatting their message may cost more
+/// than what is being logged, such as on every key press or chunk of input sent to the application.
+class Logger {
+  public:
+    using Sink = std::function<void(LogEvent)>;
+
+    /// Tests whether events of the given index (see logEventIndex()) are wanted.
+    using Filter = std::function<bool(size_t)>;
+
+    Logger() = default;
+
+    template <
+        typename T,
+        std::enable_if_t<!std::is_same_v<std::decay_t<T>, Logger> && std::is_constructible_v<Sink, T>, int> = 0
+    >
+    Logger(T&& _sink, Filter _filter = {}) :
+        sink_{ std::forward<T>(_sink) },
+        filter_{ std::move(_filter) }
+    {}
+
+    explicit operator bool() const noexcept { return static_cast<bool>(sink_); }
+
+    /// @returns whether events of type @p Event are to be logged at all.
+    template <typename Event>
+    bool enabled() const
+    {
+        return sink_ && (!filter_ || filter_(logEventIndex<Event>()));
+    }
+
+    void operator()(LogEvent _event) const
+    {
+        if (sink_)
+            sink_(std::move(_event));
+    }
+
+  private:
+    Sink sink_;
+    Filter filter_;
+};
 
 } // namespace terminal
 
@@ -73,10 +140,10 @@ namespace fmt {
                     return format_to(ctx.out(), "Trace Input: {}", v.message);
                 },
                 [&](RawInputEvent const& v) {
-                    return format_to(ctx.out(), "Raw Input: \"{}\"", v.sequence);
+                    return format_to(ctx.out(), "Raw Input: \"{}\"", crispy::escape(v.sequence));
                 },
                 [&](RawOutputEvent const& v) {
-                    return format_to(ctx.out(), "Raw Output: \"{}\"", v.sequence);
+                    return format_to(ctx.out(), "Raw Output: \"{}\"", crispy::escape(v.sequence));
                 },
                 [&](InvalidOutputEvent const& v) {
                     return format_to(ctx.out(), "Invalid output sequence: {}. {}", v.sequence, v.reason);
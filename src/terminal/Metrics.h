@@ -13,30 +13,146 @@
  */
 #pragma once
 
+#include <terminal/Functions.h>
 #include <terminal/Sequencer.h> // Sequence
 
+#include <crispy/cycle_clock.h>
+
 #include <algorithm>
-#include <map>
+#include <array>
+#include <atomic>
 #include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
 
 namespace terminal {
 
+/// Kinds of bytes of the application's output, as accounted for by Metrics.
+enum class OutputCategory {
+    Text,   // printable characters
+    C0,     // C0 control characters, such as CR, LF, or BS
+    ESC,    // escape sequences, including the string terminator
+    CSI,
+    OSC,
+    DCS,
+};
+
 /// Used for collecting VT sequence usage metrics.
+///
+/// Counting is a single relaxed atomic increment per sequence, indexed by the
+/// function's position in functions(), so it is cheap enough to stay enabled.
+///
+/// Additionally, every sampleInterval'th dispatch of a sequence or write of text is timed
+/// using the cycle_clock, such that the time spent per function can be estimated without
+/// reading a clock twice per sequence. Metrics are written by a single sequencer at a time,
+/// and may be read from any thread meanwhile.
 struct Metrics {
-    // XXX Too bad the key is a string.
-    std::map<std::string, uint64_t> sequences;
+    using FunctionTable = std::decay_t<decltype(functions())>;
+    static constexpr size_t FunctionCount = std::tuple_size_v<FunctionTable>;
+
+    /// Default number of dispatches per timed dispatch.
+    static constexpr uint32_t DefaultSampleInterval = 16;
+
+    std::array<std::atomic<uint64_t>, FunctionCount> sequences{};
+    std::atomic<uint64_t> unknownSequences = 0;
+    std::atomic<uint64_t> textWrites = 0;
+
+    // Sum of the sampled dispatch times in cycle_clock ticks and the number of samples,
+    // indexed like sequences, followed by the text writes.
+    std::array<std::atomic<uint64_t>, FunctionCount + 1> sampledTicks{};
+    std::array<std::atomic<uint64_t>, FunctionCount + 1> samples{};
+
+    // Bytes of output, indexed by OutputCategory.
+    std::array<std::atomic<uint64_t>, 6> bytes{};
+
+    /// Number of dispatches per timed dispatch, or 0 for timing none.
+    uint32_t sampleInterval = DefaultSampleInterval;
+
+    void operator()(FunctionDefinition const& _function) noexcept
+    {
+        if (auto const i = indexOf(_function); i < FunctionCount)
+            sequences[i].fetch_add(1, std::memory_order_relaxed);
+        else
+            unknownSequences.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void operator()(Sequence const& _seq) noexcept
+    {
+        if (FunctionDefinition const* f = _seq.functionDefinition(); f != nullptr)
+            (*this)(*f);
+        else
+            unknownSequences.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    /// Counts text having been written, of @p _bytes bytes.
+    void text(size_t _bytes) noexcept
+    {
+        textWrites.fetch_add(1, std::memory_order_relaxed);
+        bytes[static_cast<size_t>(OutputCategory::Text)].fetch_add(_bytes, std::memory_order_relaxed);
+    }
+
+    void addBytes(OutputCategory _category, size_t _bytes) noexcept
+    {
+        bytes[static_cast<size_t>(_category)].fetch_add(_bytes, std::memory_order_relaxed);
+    }
+
+    /// Tests whether the next dispatch is to be timed, to be invoked once per dispatch.
+    bool sampleNext() noexcept
+    {
+        if (sampleInterval == 0 || --sampleCountdown_ != 0)
+            return false;
+        sampleCountdown_ = sampleInterval;
+        return true;
+    }
 
-    void operator()(Sequence const& _seq)
+    /// Adds a sampled dispatch of @p _function (or writing text, if nullptr) having taken @p _ticks.
+    void addSample(FunctionDefinition const* _function, uint64_t _ticks) noexcept
     {
-        sequences[_seq.text()]++;
+        auto const i = _function ? std::min(indexOf(*_function), FunctionCount) : FunctionCount;
+        if (i == FunctionCount && _function)
+            return;
+        sampledTicks[i].fetch_add(_ticks, std::memory_order_relaxed);
+        samples[i].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    /// @returns approximate number of bytes the ESC, CSI, or DCS header @p _seq has been encoded
+    ///          with, not knowing about default parameters versus explicit zeros, nor 8-bit
+    ///          introducers.
+    static size_t encodedSize(Sequence const& _seq) noexcept
+    {
+        auto const digits = [](int _value) {
+            size_t n = 1;
+            for (; _value >= 10; _value /= 10)
+                ++n;
+            return n;
+        };
+
+        size_t size = _seq.category() == FunctionCategory::ESC ? 2 : 3; // introducer and final character
+        if (_seq.leaderSymbol())
+            ++size;
+        size += _seq.intermediateCharacters().size();
+        for (size_t i = 0; i < _seq.parameterCount(); ++i)
+        {
+            size += digits(_seq.param(i)) + (i != 0 ? 1 : 0);
+            for (size_t k = 0; k < _seq.subParameterCount(i); ++k)
+                size += 1 + digits(_seq.subparam(i, k));
+        }
+        return size;
     }
 
     /// @returns an ordered list of collected metrics, with highest frequencey first.
     std::vector<std::pair<std::string, uint64_t>> ordered() const
     {
+        auto const& funcs = functions();
+
         std::vector<std::pair<std::string, uint64_t>> vec;
-        for (auto const& [name, freq] : sequences)
-            vec.emplace_back(std::pair{name, freq});
+        for (size_t i = 0; i < sequences.size(); ++i)
+            if (auto const freq = sequences[i].load(std::memory_order_relaxed); freq != 0)
+                vec.emplace_back(std::pair{std::string(funcs[i].mnemonic), freq});
+        if (auto const freq = unknownSequences.load(std::memory_order_relaxed); freq != 0)
+            vec.emplace_back(std::pair{std::string("(unknown)"), freq});
 
         std::sort(vec.begin(), vec.end(), [](auto const& a, auto const& b) {
             if (a.second > b.second)
@@ -47,6 +163,67 @@ struct Metrics {
         });
         return vec;
     }
+
+    struct ProfileEntry {
+        std::string name;
+        uint64_t count;             // number of dispatches
+        uint64_t samples;           // number of dispatches timed
+        double nanoseconds;         // estimated total time, extrapolated from the samples
+    };
+
+    /// @returns the estimated time spent per function and for writing text, most expensive first.
+    ///
+    /// Functions that have been dispatched but never sampled are estimated at zero.
+    std::vector<ProfileEntry> profile() const
+    {
+        auto const& funcs = functions();
+        auto const nanosecondsPerTick = calibration_.nanoseconds_per_tick();
+        auto const estimate = [&](size_t _index, uint64_t _count) {
+            auto const n = samples[_index].load(std::memory_order_relaxed);
+            auto const ticks = sampledTicks[_index].load(std::memory_order_relaxed);
+            return n ? static_cast<double>(ticks) / static_cast<double>(n) * static_cast<double>(_count) * nanosecondsPerTick : 0.0;
+        };
+
+        std::vector<ProfileEntry> vec;
+        for (size_t i = 0; i < FunctionCount; ++i)
+            if (auto const count = sequences[i].load(std::memory_order_relaxed); count != 0)
+                vec.emplace_back(ProfileEntry{std::string(funcs[i].mnemonic), count, samples[i].load(), estimate(i, count)});
+        if (auto const count = textWrites.load(std::memory_order_relaxed); count != 0)
+            vec.emplace_back(ProfileEntry{"(text)", count, samples[FunctionCount].load(), estimate(FunctionCount, count)});
+
+        std::sort(vec.begin(), vec.end(), [](auto const& a, auto const& b) {
+            if (a.nanoseconds != b.nanoseconds)
+                return a.nanoseconds > b.nanoseconds;
+            return a.count > b.count;
+        });
+        return vec;
+    }
+
+    /// @returns the bytes of output per category, most first.
+    std::vector<std::pair<std::string_view, uint64_t>> bytesPerCategory() const
+    {
+        auto constexpr names = std::array<std::string_view, 6>{"text", "C0", "ESC", "CSI", "OSC", "DCS"};
+
+        std::vector<std::pair<std::string_view, uint64_t>> vec;
+        for (size_t i = 0; i < bytes.size(); ++i)
+            vec.emplace_back(names[i], bytes[i].load(std::memory_order_relaxed));
+
+        std::stable_sort(vec.begin(), vec.end(), [](auto const& a, auto const& b) { return a.second > b.second; });
+        return vec;
+    }
+
+  private:
+    /// @returns the index of @p _function in functions(), or FunctionCount if not in there.
+    static size_t indexOf(FunctionDefinition const& _function) noexcept
+    {
+        auto const& funcs = functions();
+        if (funcs.data() <= &_function && &_function < funcs.data() + funcs.size())
+            return static_cast<size_t>(&_function - funcs.data());
+        return FunctionCount;
+    }
+
+    uint32_t sampleCountdown_ = 1;          // only accessed by the writing sequencer
+    crispy::cycle_calibration calibration_;
 };
 
 } // end namespace
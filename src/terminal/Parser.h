@@ -18,21 +18,28 @@
 
 #include <crispy/overloaded.h>
 #include <crispy/range.h>
+#include <crispy/trace.h>
 
 #include <unicode/utf8.h>
 
 #include <array>
+#include <cstddef>
 #include <cstdint>
 #include <functional>
 #include <iterator>
 #include <limits>
 #include <string>
 #include <string_view>
+#include <utility>
 #include <variant>
 #include <vector>
 
 #include <fmt/format.h>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 namespace terminal::parser { // {{{ enum class types
 
 enum class State : uint8_t {
@@ -699,11 +706,54 @@ constexpr ParserTable ParserTable::get() // {{{
     }
 
     // TODO: verify the above is correct (programatically as much as possible)
-    // TODO: see if we can reduce the preassure on L2 caches (is this even an issue?)
 
     return t;
 } // }}}
 
+/// ParserTable packed into a single 16-bit entry per (state, input), such that processing an input
+/// takes one table load.
+///
+/// Each entry holds 4 bits each of the target state, the action of the transition (or event),
+/// the exit action of the current state and the entry action of the target state. A target state
+/// of State::Undefined means that the input does not change the state but only causes the action.
+struct PackedParserTable {
+    using Entry = uint16_t;
+
+    /// Inputs per state (all bytes and UnicodeCodepoint), padded to whole cache lines.
+    static constexpr size_t RowSize = 288;
+
+    alignas(64) std::array<std::array<Entry, RowSize>, std::numeric_limits<State>::size()> entries{};
+
+    static constexpr PackedParserTable from(ParserTable const& _table);
+
+    static constexpr State target(Entry _entry) noexcept { return static_cast<State>(_entry & 0x0F); }
+    static constexpr Action action(Entry _entry) noexcept { return static_cast<Action>((_entry >> 4) & 0x0F); }
+    static constexpr Action exitAction(Entry _entry) noexcept { return static_cast<Action>((_entry >> 8) & 0x0F); }
+    static constexpr Action entryAction(Entry _entry) noexcept { return static_cast<Action>(_entry >> 12); }
+};
+
+constexpr PackedParserTable PackedParserTable::from(ParserTable const& _table)
+{
+    static_assert(std::numeric_limits<State>::size() <= 0x10 && static_cast<unsigned>(Action::OSC_End) < 0x10,
+                  "States and actions must fit into 4 bits each.");
+
+    auto t = PackedParserTable{};
+    for (size_t state = 0; state < std::numeric_limits<State>::size(); ++state)
+    {
+        for (size_t input = 0; input <= ParserTable::UnicodeCodepoint::Value; ++input)
+        {
+            auto const target = _table.transitions[state][input];
+            auto const entry = static_cast<unsigned>(target)
+                             | static_cast<unsigned>(_table.events[state][input]) << 4;
+            t.entries[state][input] = static_cast<Entry>(target == State::Undefined
+                ? entry
+                : entry | static_cast<unsigned>(_table.exitEvents[state]) << 8
+                        | static_cast<unsigned>(_table.entryEvents[static_cast<size_t>(target)]) << 12);
+        }
+    }
+    return t;
+}
+
 /**
  * Terminal Parser.
  *
@@ -715,7 +765,6 @@ constexpr ParserTable ParserTable::get() // {{{
  */
 class Parser {
   public:
-    using ParseError = std::function<void(std::string const&)>;
     using iterator = uint8_t const*;
 
     explicit Parser(ParserEvents& _listener) :
@@ -746,12 +795,179 @@ class Parser {
     ParserEvents& eventListener_;
 };
 
+namespace detail {
+    /// @returns the number of leading bytes in [_begin, _end) that are printable US-ASCII (0x20 .. 0x7E).
+    inline size_t countPrintableAscii(uint8_t const* _begin, uint8_t const* _end) noexcept
+    {
+        auto input = _begin;
+
+#if defined(__SSE2__)
+        // Interpreted as signed 8-bit values, all bytes >= 0x80 are negative,
+        // so the printable range becomes a simple (0x1F, 0x7F) interval test.
+        auto const lower = _mm_set1_epi8(0x1F);
+        auto const upper = _mm_set1_epi8(0x7F);
+        while (_end - input >= 16)
+        {
+            auto const batch = _mm_loadu_si128(reinterpret_cast<__m128i const*>(input));
+            auto const printable = _mm_and_si128(_mm_cmpgt_epi8(batch, lower), _mm_cmplt_epi8(batch, upper));
+            auto const mask = static_cast<unsigned>(_mm_movemask_epi8(printable));
+            if (mask != 0xFFFF)
+                return static_cast<size_t>(input - _begin) + static_cast<size_t>(__builtin_ctz(~mask));
+            input += 16;
+        }
+#endif
+
+        while (input != _end && *input >= 0x20 && *input < 0x7F)
+            ++input;
+
+        return static_cast<size_t>(input - _begin);
+    }
+
+    /// Decodes the longest prefix of complete and well-formed multi-byte UTF-8 sequences
+    /// in [_begin, _end) into @p _output, writing at most @p _capacity codepoints.
+    ///
+    /// Decoding stops at the first US-ASCII byte as well as at the first malformed or
+    /// incomplete sequence, leaving those to the stateful (byte-wise) decoder.
+    ///
+    /// @returns the number of bytes consumed and the number of codepoints written.
+    inline std::pair<size_t, size_t> decodeUtf8(uint8_t const* _begin, uint8_t const* _end,
+                                                char32_t* _output, size_t _capacity) noexcept
+    {
+        auto const isContinuation = [](uint8_t _byte) constexpr { return (_byte & 0xC0) == 0x80; };
+
+        auto input = _begin;
+        size_t count = 0;
+
+        while (count < _capacity && input != _end)
+        {
+            auto const available = _end - input;
+            auto const lead = input[0];
+
+            if (lead >= 0xC2 && lead <= 0xDF)
+            {
+                if (available < 2 || !isContinuation(input[1]))
+                    break;
+                _output[count++] = (char32_t(lead & 0x1F) << 6) | char32_t(input[1] & 0x3F);
+                input += 2;
+            }
+            else if (lead >= 0xE0 && lead <= 0xEF)
+            {
+                if (available < 3 || !isContinuation(input[1]) || !isContinuation(input[2]))
+                    break;
+                if ((lead == 0xE0 && input[1] < 0xA0) || (lead == 0xED && input[1] >= 0xA0))
+                    break; // overlong encoding or UTF-16 surrogate
+                _output[count++] = (char32_t(lead & 0x0F) << 12)
+                                 | (char32_t(input[1] & 0x3F) << 6)
+                                 | char32_t(input[2] & 0x3F);
+                input += 3;
+            }
+            else if (lead >= 0xF0 && lead <= 0xF4)
+            {
+                if (available < 4 || !isContinuation(input[1]) || !isContinuation(input[2]) || !isContinuation(input[3]))
+                    break;
+                if ((lead == 0xF0 && input[1] < 0x90) || (lead == 0xF4 && input[1] >= 0x90))
+                    break; // overlong encoding or beyond U+10FFFF
+                _output[count++] = (char32_t(lead & 0x07) << 18)
+                                 | (char32_t(input[1] & 0x3F) << 12)
+                                 | (char32_t(input[2] & 0x3F) << 6)
+                                 | char32_t(input[3] & 0x3F);
+                input += 4;
+            }
+            else
+                break;
+        }
+
+        return {static_cast<size_t>(input - _begin), count};
+    }
+
+    /// @returns the number of leading bytes in [_begin, _end) that are characters of an OSC string,
+    ///          i.e. printable US-ASCII and complete UTF-8 sequences of codepoints beyond the C1 controls.
+    inline size_t countOscStringBytes(uint8_t const* _begin, uint8_t const* _end) noexcept
+    {
+        auto input = _begin;
+        while (input != _end)
+        {
+            input += countPrintableAscii(input, _end);
+            if (input == _end || *input < 0x80)
+                break;
+
+            char32_t codepoint{};
+            auto const [consumed, count] = decodeUtf8(input, _end, &codepoint, 1);
+            if (count == 0 || codepoint < 0xA0)
+                break;
+            input += consumed;
+        }
+        return static_cast<size_t>(input - _begin);
+    }
+}
+
 inline void Parser::parseFragment(iterator _begin, iterator _end)
 {
+    CRISPY_TRACE_ZONE("Parser::parseFragment");
+
     static constexpr char32_t ReplacementCharacter {0xFFFD};
 
-    for (auto const current : crispy::range(_begin, _end))
+    auto input = _begin;
+    while (input != _end)
     {
+        if (utf8DecoderState_.expectedLength == 0)
+        {
+            // Fast path: plain US-ASCII text in ground state does not need to go
+            // through UTF-8 decoding nor the state transition table.
+            if (state_ == State::Ground)
+            {
+                if (auto const count = detail::countPrintableAscii(input, _end); count != 0)
+                {
+                    eventListener_.print(std::string_view(reinterpret_cast<char const*>(input), count));
+                    input += count;
+                    continue;
+                }
+            }
+            // Likewise, the payloads of OSC and DCS strings (such as clipboard contents or Sixel images)
+            // are passed on as received, up to the next byte that may terminate them.
+            else if (state_ == State::OSC_String)
+            {
+                if (auto const count = detail::countOscStringBytes(input, _end); count != 0)
+                {
+                    eventListener_.putOSC(std::string_view(reinterpret_cast<char const*>(input), count));
+                    input += count;
+                    continue;
+                }
+            }
+            else if (state_ == State::DCS_PassThrough)
+            {
+                if (auto const count = detail::countPrintableAscii(input, _end); count != 0)
+                {
+                    eventListener_.put(std::string_view(reinterpret_cast<char const*>(input), count));
+                    input += count;
+                    continue;
+                }
+            }
+
+            // Decode complete multi-byte sequences block-wise. Anything that cannot be decoded
+            // here (including a sequence that is split across fragments) is left to the
+            // stateful decoder below, which carries it over to the next call.
+            if (*input >= 0x80)
+            {
+                std::array<char32_t, 64> codepoints;
+                auto const [consumed, count] = detail::decodeUtf8(input, _end, codepoints.data(), codepoints.size());
+                if (count != 0)
+                {
+                    for (size_t i = 0; i < count; ++i)
+                        processInput(codepoints[i]);
+                    input += consumed;
+                    continue;
+                }
+            }
+            else
+            {
+                // US-ASCII bytes, such as those of control sequences, are codepoints by themselves.
+                processInput(*input++);
+                continue;
+            }
+        }
+
+        auto const current = *input++;
 #if 0
         std::visit(
             overloaded{
@@ -781,22 +997,26 @@ inline void Parser::processInput(char32_t _ch)
 {
     auto const s = static_cast<size_t>(state_);
 
-    ParserTable static constexpr table = ParserTable::get();
+    PackedParserTable static constexpr table = PackedParserTable::from(ParserTable::get());
 
     auto const ch = _ch < 0xFF ? _ch : static_cast<char32_t>(ParserTable::UnicodeCodepoint::Value);
+    auto const entry = table.entries[s][ch];
 
-    if (auto const t = table.transitions[s][ch]; t != State::Undefined)
+    if (auto const t = PackedParserTable::target(entry); t == State::Undefined)
     {
-        // handle(_actionClass, _action, currentChar());
-        handle(ActionClass::Leave, table.exitEvents[s], _ch);
-        handle(ActionClass::Transition, table.events[s][ch], _ch);
-        state_ = t;
-        handle(ActionClass::Enter, table.entryEvents[static_cast<size_t>(t)], _ch);
+        // By far most inputs stay in their state, causing a single action.
+        if (Action const a = PackedParserTable::action(entry); a != Action::Undefined)
+            handle(ActionClass::Event, a, _ch);
+        else
+            eventListener_.error(fmt::format("Parser Error: Unknown action for state/input pair ({}, 0x{:02X})", state_, static_cast<uint32_t>(ch)));
     }
-    else if (Action const a = table.events[s][ch]; a != Action::Undefined)
-        handle(ActionClass::Event, a, _ch);
     else
-        eventListener_.error(fmt::format("Parser Error: Unknown action for state/input pair ({}, 0x{:02X})", state_, static_cast<uint32_t>(ch)));
+    {
+        handle(ActionClass::Leave, PackedParserTable::exitAction(entry), _ch);
+        handle(ActionClass::Transition, PackedParserTable::action(entry), _ch);
+        state_ = t;
+        handle(ActionClass::Enter, PackedParserTable::entryAction(entry), _ch);
+    }
 }
 
 inline void Parser::handle(ActionClass _actionClass, Action _action, char32_t _char)
@@ -13,7 +13,10 @@
  */
 #pragma once
 
+#include <unicode/utf8.h>
+
 #include <string_view>
+#include <variant>
 
 namespace terminal {
 
@@ -39,6 +42,12 @@ class ParserEvents {
      */
     virtual void print(char32_t _text) = 0;
 
+    /**
+     * Same as print(char32_t), but for a whole run of printable US-ASCII characters
+     * (0x20 .. 0x7E) that the parser has consumed in ground state in one go.
+     */
+    virtual void print(std::string_view _chars) = 0;
+
     /**
      * The C0 or C1 control function should be executed, which may have any one of a variety of
      * effects, including changing the cursor position, suspending or resuming communications or
@@ -110,6 +119,12 @@ class ParserEvents {
      */
     virtual void putOSC(char32_t _char) = 0;
 
+    /**
+     * Same as putOSC(char32_t), but for a whole run of the control string's characters, passed
+     * as the UTF-8 encoded bytes received, that the parser has consumed in one go.
+     */
+    virtual void putOSC(std::string_view _chars) = 0;
+
     /**
      * This action is called when the OSC string is terminated by ST, CAN, SUB or ESC,
      * to allow the OSC handler to finish neatly.
@@ -133,6 +148,12 @@ class ParserEvents {
      */
     virtual void put(char32_t _char) = 0;
 
+    /**
+     * Same as put(char32_t), but for a whole run of printable US-ASCII characters (0x20 .. 0x7E)
+     * of the data string that the parser has consumed in one go.
+     */
+    virtual void put(std::string_view _chars) = 0;
+
     /**
      * When a device control string is terminated by ST, CAN, SUB or ESC, this action calls the
      * previously selected handler function with an “end of data” parameter. This allows the
@@ -145,6 +166,7 @@ class BasicParserEvents : public ParserEvents {
   public:
     void error(std::string_view const&) override {}
     void print(char32_t) override {}
+    void print(std::string_view _chars) override { for (char const ch: _chars) print(static_cast<char32_t>(ch)); }
     void execute(char) override {}
     void clear() override {}
     void collect(char) override {}
@@ -154,9 +176,17 @@ class BasicParserEvents : public ParserEvents {
     void dispatchCSI(char) override {}
     void startOSC() override {}
     void putOSC(char32_t) override {}
+    void putOSC(std::string_view _chars) override
+    {
+        auto state = unicode::utf8_decoder_state{};
+        for (char const ch: _chars)
+            if (auto const r = unicode::from_utf8(state, static_cast<uint8_t>(ch)); std::holds_alternative<unicode::Success>(r))
+                putOSC(std::get<unicode::Success>(r).value);
+    }
     void dispatchOSC() override {}
     void hook(char) override {}
     void put(char32_t) override {}
+    void put(std::string_view _chars) override { for (char const ch: _chars) put(static_cast<char32_t>(ch)); }
     void unhook() override {}
 };
 } // end namespace terminal
@@ -2,6 +2,7 @@
 
 #include <functional>
 #include <string>
+#include <string_view>
 
 namespace terminal {
 
@@ -17,15 +18,27 @@ class ParserExtension
 
     virtual void start() = 0;
     virtual void pass(char32_t _char) = 0;
+
+    /// Passes a run of printable US-ASCII characters at once.
+    virtual void pass(std::string_view _chars)
+    {
+        for (char const ch: _chars)
+            pass(static_cast<char32_t>(ch));
+    }
     virtual void finalize() = 0;
 };
 
+/// Collects the string passed, up to a maximum length beyond which characters are dropped.
 class SimpleStringCollector : public ParserExtension
 {
   public:
-    explicit SimpleStringCollector(std::function<void(std::u32string const&)> _done)
+    static constexpr size_t DefaultMaxLength = 1024;
+
+    explicit SimpleStringCollector(std::function<void(std::u32string const&)> _done,
+                                   size_t _maxLength = DefaultMaxLength)
         : data_{},
-          done_{ std::move(_done) }
+          done_{ std::move(_done) },
+          maxLength_{ _maxLength }
     {}
 
     void start() override
@@ -35,7 +48,8 @@ class SimpleStringCollector : public ParserExtension
 
     void pass(char32_t _char) override
     {
-        data_.push_back(_char);
+        if (data_.size() < maxLength_)
+            data_.push_back(_char);
     }
 
     void finalize() override
@@ -47,6 +61,7 @@ class SimpleStringCollector : public ParserExtension
   private:
     std::u32string data_;
     std::function<void(std::u32string const&)> done_;
+    size_t maxLength_;
 };
 
 } // end namespace
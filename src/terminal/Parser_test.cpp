@@ -25,6 +25,18 @@ class MockParserEvents : public terminal::BasicParserEvents {
     void print(char32_t _ch) override { text.push_back(_ch); }
 };
 
+class MockStringEvents : public terminal::BasicParserEvents {
+  public:
+    std::u32string osc;
+    std::u32string dcs;
+    int oscCount = 0;
+
+    void error(string_view const& _msg) override { INFO(fmt::format("Parser error received. {}", _msg)); }
+    void putOSC(char32_t _ch) override { osc.push_back(_ch); }
+    void dispatchOSC() override { ++oscCount; }
+    void put(char32_t _ch) override { dcs.push_back(_ch); }
+};
+
 TEST_CASE("Parser.utf8_single", "[Parser]")
 {
     MockParserEvents textListener;
@@ -36,3 +48,106 @@ TEST_CASE("Parser.utf8_single", "[Parser]")
     CHECK(0xF6 == static_cast<unsigned>(textListener.text.at(0)));
 }
 
+
+TEST_CASE("Parser.print_ascii_run", "[Parser]")
+{
+    MockParserEvents textListener;
+    auto p = parser::Parser(textListener);
+
+    // Long enough to cross a vectorized scan boundary, with a multi-byte character in between.
+    p.parseFragment("Hello, World! This is a long text.\xC3\xB6 The End.");
+
+    auto const expected = std::u32string(U"Hello, World! This is a long text.ö The End.");
+    REQUIRE(std::u32string(textListener.text.begin(), textListener.text.end()) == expected);
+}
+
+TEST_CASE("Parser.print_ascii_run_split_sequence", "[Parser]")
+{
+    MockParserEvents textListener;
+    auto p = parser::Parser(textListener);
+
+    // A UTF-8 sequence that is split across fragments must not be interrupted by the ASCII fast path.
+    p.parseFragment("ab\xC3");
+    p.parseFragment("\xB6" "cd");
+
+    auto const expected = std::u32string(U"aböcd");
+    REQUIRE(std::u32string(textListener.text.begin(), textListener.text.end()) == expected);
+}
+
+TEST_CASE("Parser.utf8_block", "[Parser]")
+{
+    MockParserEvents textListener;
+    auto p = parser::Parser(textListener);
+
+    // 2-, 3- and 4-byte sequences, with the last one split across fragments.
+    p.parseFragment("\xC3\xB6\xE4\xB8\xAD\xF0\x9F\x98");
+    p.parseFragment("\x80\xE4\xB8\xAD");
+
+    auto const expected = std::u32string(U"ö中\U0001F600中");
+    REQUIRE(std::u32string(textListener.text.begin(), textListener.text.end()) == expected);
+}
+
+TEST_CASE("Parser.utf8_block_invalid", "[Parser]")
+{
+    MockParserEvents textListener;
+    auto p = parser::Parser(textListener);
+
+    p.parseFragment("\xE4\xB8\xAD\xFF\xE4\xB8\xAD");
+
+    auto const expected = std::u32string(U"中\uFFFD中");
+    REQUIRE(std::u32string(textListener.text.begin(), textListener.text.end()) == expected);
+}
+
+TEST_CASE("Parser.packed_table", "[Parser]")
+{
+    using parser::Action;
+    using parser::PackedParserTable;
+    using parser::ParserTable;
+    using parser::State;
+
+    static constexpr auto table = ParserTable::get();
+    static constexpr auto packed = PackedParserTable::from(table);
+
+    for (size_t state = 0; state < std::numeric_limits<State>::size(); ++state)
+    {
+        for (size_t input = 0; input <= ParserTable::UnicodeCodepoint::Value; ++input)
+        {
+            INFO(fmt::format("state {}, input 0x{:02X}", static_cast<State>(state), input));
+            auto const entry = packed.entries[state][input];
+            auto const target = table.transitions[state][input];
+            REQUIRE(PackedParserTable::target(entry) == target);
+            REQUIRE(PackedParserTable::action(entry) == table.events[state][input]);
+            if (target != State::Undefined)
+            {
+                REQUIRE(PackedParserTable::exitAction(entry) == table.exitEvents[state]);
+                REQUIRE(PackedParserTable::entryAction(entry) == table.entryEvents[static_cast<size_t>(target)]);
+            }
+        }
+    }
+}
+
+TEST_CASE("Parser.osc_string_run", "[Parser]")
+{
+    MockStringEvents events;
+    auto p = parser::Parser(events);
+
+    // UTF-8 sequences may be split across fragments, and U+009C (ST) terminates the string.
+    p.parseFragment("\033]2;Gr\xC3\xBC\xC3");
+    p.parseFragment("\x9F" "e, \xE4\xB8\x96\xE7\x95\x8C\x7F!\xC2\x9C");
+    CHECK(events.osc == U"2;Grüße, 世界\x7F!");
+    CHECK(events.oscCount == 1);
+
+    events.osc.clear();
+    p.parseFragment("\033]8;;file\007");
+    CHECK(events.osc == U"8;;file");
+    CHECK(events.oscCount == 2);
+}
+
+TEST_CASE("Parser.dcs_string_run", "[Parser]")
+{
+    MockStringEvents events;
+    auto p = parser::Parser(events);
+
+    p.parseFragment("\033Pq#0;2;0;0;0~~\r\n-~\033\\");
+    CHECK(events.dcs == U"#0;2;0;0;0~~\r\n-~");
+}
@@ -26,6 +26,7 @@
 #include <numeric>
 #include <stdexcept>
 #include <string>
+#include <string_view>
 #include <unordered_map>
 
 #if !defined(_WIN32)
@@ -34,6 +35,7 @@
 #include <signal.h>
 #include <sys/types.h>
 #include <sys/wait.h>
+#include <fcntl.h>
 #include <unistd.h>
 #else
 #include <direct.h>
@@ -44,6 +46,20 @@
 #include <terminal/pty/ConPty.h>
 #endif
 
+// posix_spawn() can only attach the child to a terminal and close inherited file descriptors
+// as of glibc 2.34, and it only avoids copying the caller's page tables on Linux.
+#if defined(__linux__) && defined(__GLIBC__)
+#if __GLIBC_PREREQ(2, 34)
+#define LIBTERMINAL_POSIX_SPAWN 1
+#endif
+#endif
+
+#if defined(LIBTERMINAL_POSIX_SPAWN)
+#include <terminal/pty/UnixPty.h>
+#include <spawn.h>
+extern char** environ;
+#endif
+
 using namespace std;
 
 namespace terminal {
@@ -152,6 +168,76 @@ namespace {
         return hr;
     }
 	#endif
+
+#if defined(LIBTERMINAL_POSIX_SPAWN)
+    /// Spawns @p _path with the terminal of the given slave end as its controlling terminal,
+    /// without fork() copying the page tables of this (possibly large) process.
+    ///
+    /// @returns the process id of the child, or -1 if it could not be spawned this way.
+    pid_t spawnAttached(string const& _path,
+                        vector<string> const& _args,
+                        FileSystem::path const& _cwd,
+                        Process::Environment const& _env,
+                        int _slave)
+    {
+        char const* ttyPath = _slave >= 0 ? ttyname(_slave) : nullptr;
+        if (!ttyPath)
+            return -1;
+        auto const tty = string(ttyPath);
+        auto const cwd = _cwd.generic_string();
+
+        auto argv = vector<char*>{};
+        argv.push_back(const_cast<char*>(_path.c_str()));
+        for (string const& arg : _args)
+            argv.push_back(const_cast<char*>(arg.c_str()));
+        argv.push_back(nullptr);
+
+        // The environment of this process, with the given variables added or replaced.
+        auto environment = vector<string>{};
+        for (char** entry = environ; *entry != nullptr; ++entry)
+        {
+            auto const variable = string_view{*entry};
+            if (_env.find(string(variable.substr(0, variable.find('=')))) == _env.end())
+                environment.emplace_back(variable);
+        }
+        for (auto const& [name, value] : _env)
+            environment.emplace_back(name + '=' + value);
+
+        auto envp = vector<char*>{};
+        for (string& variable : environment)
+            envp.push_back(variable.data());
+        envp.push_back(nullptr);
+
+        posix_spawn_file_actions_t actions;
+        posix_spawn_file_actions_init(&actions);
+
+        // Opening the terminal as the leader of a new session makes it the controlling terminal.
+        posix_spawn_file_actions_addopen(&actions, STDIN_FILENO, tty.c_str(), O_RDWR, 0);
+        posix_spawn_file_actions_adddup2(&actions, STDIN_FILENO, STDOUT_FILENO);
+        posix_spawn_file_actions_adddup2(&actions, STDIN_FILENO, STDERR_FILENO);
+        if (!cwd.empty())
+            posix_spawn_file_actions_addchdir_np(&actions, cwd.c_str());
+        posix_spawn_file_actions_addclosefrom_np(&actions, STDERR_FILENO + 1);
+
+        // reset signal(s) to default that may have been changed in the parent process.
+        posix_spawnattr_t attributes;
+        posix_spawnattr_init(&attributes);
+        sigset_t signals;
+        sigemptyset(&signals);
+        posix_spawnattr_setsigmask(&attributes, &signals);
+        sigaddset(&signals, SIGPIPE);
+        posix_spawnattr_setsigdefault(&attributes, &signals);
+        posix_spawnattr_setflags(&attributes, POSIX_SPAWN_SETSID | POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF);
+
+        pid_t pid = -1;
+        auto const rv = posix_spawnp(&pid, _path.c_str(), &actions, &attributes, argv.data(), envp.data());
+
+        posix_spawnattr_destroy(&attributes);
+        posix_spawn_file_actions_destroy(&actions);
+
+        return rv == 0 ? pid : -1;
+    }
+#endif
 } // anonymous namespace
 
 Process::Process(string const& _path,
@@ -161,6 +247,19 @@ Process::Process(string const& _path,
                  Pty& _pty)
 {
 #if defined(__unix__) || defined(__APPLE__)
+#if defined(LIBTERMINAL_POSIX_SPAWN)
+    // Failing that, the child is forked, reporting errors (e.g. of chdir) in the terminal.
+    if (auto const* unixPty = dynamic_cast<UnixPty const*>(&_pty); unixPty != nullptr)
+    {
+        pid_ = spawnAttached(_path, _args, _cwd, _env, unixPty->slave());
+        if (pid_ != -1)
+        {
+            _pty.prepareParentProcess();
+            return;
+        }
+    }
+#endif
+
     pid_ = fork();
     switch (pid_)
     {
@@ -13,15 +13,19 @@
  */
 #include <terminal/Screen.h>
 
+#include <terminal/ImageDecoder.h>
 #include <terminal/InputGenerator.h>
 
 #include <terminal/Logger.h>
+#include <terminal/Search.h>
 #include <terminal/Size.h>
 #include <terminal/VTType.h>
 
 #include <crispy/algorithm.h>
+#include <crispy/allocation_tracker.h>
 #include <crispy/escape.h>
 #include <crispy/times.h>
+#include <crispy/trace.h>
 #include <crispy/utils.h>
 
 #include <unicode/emoji_segmenter.h>
@@ -30,9 +34,15 @@
 #include <unicode/utf8.h>
 
 #include <algorithm>
+#include <atomic>
 #include <iostream>
 #include <iterator>
+#include <memory>
+#include <mutex>
+#include <set>
 #include <sstream>
+#include <stdexcept>
+#include <unordered_map>
 #include <variant>
 
 #include <assert.h>
@@ -47,8 +57,13 @@
 using namespace crispy;
 
 using std::accumulate;
+using std::back_inserter;
 using std::cerr;
 using std::endl;
+using std::fill;
+using std::fill_n;
+using std::for_each;
+using std::generate_n;
 using std::get;
 using std::holds_alternative;
 using std::make_shared;
@@ -60,6 +75,7 @@ using std::nullopt;
 using std::optional;
 using std::ostringstream;
 using std::pair;
+using std::prev;
 using std::ref;
 using std::string;
 using std::string_view;
@@ -227,14 +243,1386 @@ namespace // {{{ helper
         Color currentBackgroundColor_ = DefaultColor{};
         KeyMode cursorKeysMode_ = KeyMode::Normal;
     };
+
+    /// Sets the graphics rendition written by @p _writer to @p _attributes, starting from a reset.
+    ///
+    /// Underline variants are written as plain underlines, and underline colors are not written.
+    void setGraphicsAttributes(VTWriter& _writer, GraphicsAttributes const& _attributes)
+    {
+        static constexpr pair<CharacterStyleMask::Mask, unsigned> styles[] = {
+            {CharacterStyleMask::Bold, 1},
+            {CharacterStyleMask::Faint, 2},
+            {CharacterStyleMask::Italic, 3},
+            {CharacterStyleMask::Underline, 4},
+            {CharacterStyleMask::CurlyUnderlined, 4},
+            {CharacterStyleMask::DottedUnderline, 4},
+            {CharacterStyleMask::DashedUnderline, 4},
+            {CharacterStyleMask::Blinking, 5},
+            {CharacterStyleMask::Inverse, 7},
+            {CharacterStyleMask::Hidden, 8},
+            {CharacterStyleMask::CrossedOut, 9},
+            {CharacterStyleMask::DoublyUnderlined, 21},
+            {CharacterStyleMask::Framed, 51},
+            {CharacterStyleMask::Encircled, 52},
+            {CharacterStyleMask::Overline, 53},
+        };
+
+        _writer.sgr_add(GraphicsRendition::Reset);
+        for (auto const& [mask, sgr] : styles)
+            if ((_attributes.styles & mask) != 0)
+                _writer.sgr_add(sgr);
+        if (!holds_alternative<DefaultColor>(_attributes.foregroundColor))
+            _writer.setForegroundColor(_attributes.foregroundColor);
+        if (!holds_alternative<DefaultColor>(_attributes.backgroundColor))
+            _writer.setBackgroundColor(_attributes.backgroundColor);
+        _writer.flush();
+    }
+}
+// }}}
+
+// {{{ GraphicsAttributesTable
+namespace
+{
+    constexpr uint32_t packColor(Color const& _color) noexcept
+    {
+        auto const tag = static_cast<uint32_t>(_color.index()) << 24;
+        if (holds_alternative<IndexedColor>(_color))
+            return tag | static_cast<uint32_t>(get<IndexedColor>(_color));
+        if (holds_alternative<BrightColor>(_color))
+            return tag | static_cast<uint32_t>(get<BrightColor>(_color));
+        if (holds_alternative<RGBColor>(_color))
+        {
+            auto const& rgb = get<RGBColor>(_color);
+            return tag | (uint32_t(rgb.red) << 16) | (uint32_t(rgb.green) << 8) | uint32_t(rgb.blue);
+        }
+        return tag;
+    }
+
+    /// GraphicsAttributes in a compact, trivially hashable form.
+    struct AttributesKey {
+        uint32_t foreground;
+        uint32_t background;
+        uint32_t underline;
+        uint32_t styles;
+
+        explicit AttributesKey(GraphicsAttributes const& _attributes) noexcept :
+            foreground{packColor(_attributes.foregroundColor)},
+            background{packColor(_attributes.backgroundColor)},
+            underline{packColor(_attributes.underlineColor)},
+            styles{_attributes.styles.mask()}
+        {}
+
+        bool operator==(AttributesKey const& _other) const noexcept
+        {
+            return foreground == _other.foreground
+                && background == _other.background
+                && underline == _other.underline
+                && styles == _other.styles;
+        }
+    };
+
+    struct AttributesKeyHash {
+        size_t operator()(AttributesKey const& _key) const noexcept
+        {
+            auto h = uint64_t(_key.foreground) << 32 | _key.background;
+            h ^= (uint64_t(_key.underline) << 32 | _key.styles) * 0x9E3779B97F4A7C15ull;
+            return static_cast<size_t>(h ^ (h >> 29));
+        }
+    };
+
+    /// Storage of the GraphicsAttributesTable.
+    ///
+    /// Entries are stored in fixed-size chunks that are never reallocated, so that readers
+    /// may access interned entries without taking the lock.
+    class AttributesStorage {
+      public:
+        static constexpr size_t ChunkSize = 4096;
+        static constexpr size_t MaxChunks = GraphicsAttributesTable::MaxEntries / ChunkSize;
+
+        AttributesStorage()
+        {
+            insert(AttributesKey{GraphicsAttributes{}}, GraphicsAttributes{});
+        }
+
+        static AttributesStorage& get()
+        {
+            static AttributesStorage storage;
+            return storage;
+        }
+
+        GraphicsAttributesTable::Id intern(GraphicsAttributes const& _attributes)
+        {
+            auto const key = AttributesKey{_attributes};
+            auto _l = std::lock_guard{lock_};
+            if (auto const i = ids_.find(key); i != ids_.end())
+                return i->second;
+            if (count_ == GraphicsAttributesTable::MaxEntries)
+                return GraphicsAttributesTable::InvalidId;
+            return insert(key, _attributes);
+        }
+
+        GraphicsAttributes const& at(GraphicsAttributesTable::Id _id) const noexcept
+        {
+            return chunks_[_id / ChunkSize][_id % ChunkSize];
+        }
+
+        size_t size() const noexcept { return count_; }
+
+      private:
+        GraphicsAttributesTable::Id insert(AttributesKey const& _key, GraphicsAttributes const& _attributes)
+        {
+            auto const id = static_cast<GraphicsAttributesTable::Id>(count_);
+            auto& chunk = chunks_[id / ChunkSize];
+            if (!chunk)
+                chunk = std::make_unique<GraphicsAttributes[]>(ChunkSize);
+            chunk[id % ChunkSize] = _attributes;
+            ids_.emplace(_key, id);
+            count_.store(count_ + 1, std::memory_order_release);
+            return id;
+        }
+
+        std::mutex lock_;
+        std::unordered_map<AttributesKey, GraphicsAttributesTable::Id, AttributesKeyHash> ids_;
+        std::array<std::unique_ptr<GraphicsAttributes[]>, MaxChunks> chunks_;
+        std::atomic<size_t> count_{0};
+    };
+}
+
+GraphicsAttributesTable::Id GraphicsAttributesTable::intern(GraphicsAttributes const& _attributes)
+{
+    // Consecutive cells are nearly always written with the same attributes,
+    // so remember the most recent lookup of this thread to bypass the shared table.
+    thread_local GraphicsAttributes lastAttributes{};
+    thread_local Id lastId = DefaultId;
+
+    if (_attributes == lastAttributes)
+        return lastId;
+
+    auto const id = AttributesStorage::get().intern(_attributes);
+    if (id != InvalidId)
+    {
+        lastAttributes = _attributes;
+        lastId = id;
+    }
+    return id;
+}
+
+GraphicsAttributes const& GraphicsAttributesTable::get(Id _id) noexcept
+{
+    return AttributesStorage::get().at(_id);
+}
+
+size_t GraphicsAttributesTable::size() noexcept
+{
+    return AttributesStorage::get().size();
+}
+// }}}
+
+std::string Cell::toUtf8() const
+{
+    auto const codepoints = this->codepoints();
+    return unicode::to_utf8(codepoints.data(), codepoints.size());
+}
+
+void Line::appendText(std::string& _output, size_t _length) const
+{
+    int covered = 0;
+    for (Cell const& cell : crispy::range(begin(), std::next(begin(), static_cast<std::ptrdiff_t>(std::min(_length, size())))))
+    {
+        if (covered > 0)
+        {
+            --covered;
+            continue;
+        }
+
+        if (cell.empty())
+            _output += ' ';
+        else
+        {
+            uint8_t bytes[4];
+            auto const count = unicode::to_utf8(cell.codepoint(0), bytes);
+            _output.append(reinterpret_cast<char const*>(bytes), count);
+        }
+        covered = cell.width() - 1;
+    }
+}
+
+// {{{ SavedLines
+namespace
+{
+    void writeVarint(vector<uint8_t>& _output, uint32_t _value)
+    {
+        while (_value >= 0x80)
+        {
+            _output.push_back(static_cast<uint8_t>(_value | 0x80));
+            _value >>= 7;
+        }
+        _output.push_back(static_cast<uint8_t>(_value));
+    }
+
+    uint32_t readVarint(uint8_t const*& _input) noexcept
+    {
+        uint32_t value = 0;
+        for (unsigned shift = 0; ; shift += 7)
+        {
+            auto const byte = *_input++;
+            value |= uint32_t(byte & 0x7F) << shift;
+            if (!(byte & 0x80))
+                return value;
+        }
+    }
+
+    /// Flag in a cell's header byte, denoting an image fragment index to follow.
+    constexpr uint8_t ImageFlag = 0x80;
+
+    /// Splits VT output into lines without parsing it, for SavedLines::appendOutput().
+    ///
+    /// Escape sequences are skipped, and every other byte is counted as a column, which is
+    /// an upper bound for UTF-8 text, whose characters span at most as many columns as bytes.
+    class OutputScanner {
+      public:
+        /// Number of bytes of SGR sequences kept for the start of the next line at most.
+        static constexpr size_t MaxPrefixSize = 256;
+
+        /// Scans the line starting at @p _input, advancing it past the line's LF.
+        /// @returns an upper bound for the number of columns of the line.
+        size_t scanLine(uint8_t const*& _input, uint8_t const* _end)
+        {
+            auto column = size_t{0};
+            auto columns = size_t{0};
+            while (_input != _end)
+            {
+                auto const byte = *_input++;
+                switch (state_)
+                {
+                    case State::Ground:
+                        if (byte == '\n')
+                            return columns;
+                        else if (byte == '\r')
+                            column = 0;
+                        else if (byte == '\t')
+                            column = (column / 8 + 1) * 8;
+                        else if (byte == '\b')
+                            column -= column != 0 ? 1 : 0;
+                        else if (byte == 0x1B)
+                        {
+                            state_ = State::Escape;
+                            sequenceStart_ = _input - 1;
+                        }
+                        else if (byte >= 0x20 && byte != 0x7F)
+                            ++column;
+                        columns = std::max(columns, column);
+                        break;
+                    case State::Escape:
+                        if (byte == '[')
+                            state_ = State::ControlSequence;
+                        else if (byte == ']' || byte == 'P' || byte == '_' || byte == '^' || byte == 'X')
+                            state_ = State::String;
+                        else if (byte == 'c')
+                        {
+                            prefix_.clear();
+                            state_ = State::Ground;
+                        }
+                        else if (byte < 0x20 || byte > 0x2F) // but intermediate bytes
+                            state_ = State::Ground;
+                        break;
+                    case State::ControlSequence:
+                        if (byte == '\n')
+                            return columns;
+                        if (byte >= 0x40 && byte <= 0x7E)
+                        {
+                            if (byte == 'm')
+                                recordGraphicsRendition(sequenceStart_, _input);
+                            state_ = State::Ground;
+                        }
+                        break;
+                    case State::String:
+                        // Strings are terminated by BEL or ST (ESC \\), spanning lines otherwise.
+                        if (byte == 0x07)
+                            state_ = State::Ground;
+                        else if (byte == 0x1B)
+                            state_ = State::Escape;
+                        break;
+                }
+            }
+            return columns;
+        }
+
+        /// @returns the SGR sequences in effect, since the most recent reset.
+        std::string const& prefix() const noexcept { return prefix_; }
+
+      private:
+        enum class State { Ground, Escape, ControlSequence, String };
+
+        void recordGraphicsRendition(uint8_t const* _begin, uint8_t const* _end)
+        {
+            auto const sequence = std::string_view(reinterpret_cast<char const*>(_begin), static_cast<size_t>(_end - _begin));
+            if (sequence == "\033[m" || sequence == "\033[0m")
+                prefix_.clear();
+            else if (prefix_.size() + sequence.size() <= MaxPrefixSize)
+                prefix_ += sequence;
+        }
+
+        State state_ = State::Ground;
+        uint8_t const* sequenceStart_ = nullptr;
+        std::string prefix_;
+    };
+}
+
+SavedLines::SavedLines()
+{
+    cache_.reserve(cachedPageCount_);
+}
+
+SavedLines::~SavedLines() = default;
+SavedLines::SavedLines(SavedLines&&) noexcept = default;
+SavedLines& SavedLines::operator=(SavedLines&&) noexcept = default;
+
+// Encodes the line as consecutive runs of cells sharing the same attributes and hyperlink:
+//
+//   line   := cellCount:varint run*
+//   run    := length:varint attributesId:varint [attributesIndex:varint] hyperlinkIndex:varint cell{length}
+//   cell   := header:byte [imageIndex:varint] codepoint:varint*
+//
+// with the header being composed of ImageFlag, width (bits 4..6) and codepoint count (bits 0..3).
+void SavedLines::encodeLine(Line const& _line, Page& _page)
+{
+    auto& output = _page.data;
+    writeVarint(output, static_cast<uint32_t>(_line.size()));
+
+    size_t i = 0;
+    while (i < _line.size())
+    {
+        Cell const& first = _line[i];
+        auto const attributesId = first.attributesId();
+        auto const hyperlink = first.hyperlink();
+
+        size_t n = 1;
+        if (attributesId != GraphicsAttributesTable::InvalidId)
+            while (i + n < _line.size()
+                    && _line[i + n].attributesId() == attributesId
+                    && _line[i + n].hyperlink() == hyperlink)
+                ++n;
+
+        writeVarint(output, static_cast<uint32_t>(n));
+        writeVarint(output, attributesId);
+        if (attributesId == GraphicsAttributesTable::InvalidId)
+        {
+            writeVarint(output, static_cast<uint32_t>(_page.attributes.size()));
+            _page.attributes.push_back(first.attributes());
+        }
+
+        if (!hyperlink)
+            writeVarint(output, 0);
+        else
+        {
+            if (_page.hyperlinks.empty() || _page.hyperlinks.back() != hyperlink)
+                _page.hyperlinks.push_back(hyperlink);
+            writeVarint(output, static_cast<uint32_t>(_page.hyperlinks.size()));
+        }
+
+        for (; n != 0; --n, ++i)
+        {
+            Cell const& cell = _line[i];
+            auto const& image = cell.imageFragment();
+            auto const header = static_cast<uint8_t>((image ? ImageFlag : 0)
+                                                     | ((cell.width() & 0x07) << 4)
+                                                     | cell.codepointCount());
+            output.push_back(header);
+            if (image)
+            {
+                writeVarint(output, static_cast<uint32_t>(_page.images.size()));
+                _page.images.push_back(*image);
+            }
+            for (char32_t const codepoint : cell.codepoints())
+                writeVarint(output, static_cast<uint32_t>(codepoint));
+        }
+    }
+}
+
+namespace
+{
+    /// Decodes a line encoded by SavedLines::encodeLine() or PortableLines::append(), with the
+    /// given tables referred to by the encoding.
+    Line decodeLine(uint8_t const*& _input,
+                    vector<GraphicsAttributes> const& _attributes,
+                    vector<HyperlinkId> const& _hyperlinks,
+                    vector<ImageFragment> const& _images)
+    {
+        auto const cellCount = readVarint(_input);
+        auto line = Line(cellCount, Cell{});
+
+        size_t i = 0;
+        while (i < cellCount)
+        {
+            auto const n = readVarint(_input);
+            auto const attributesId = readVarint(_input);
+            auto const& attributes = attributesId != GraphicsAttributesTable::InvalidId
+                ? GraphicsAttributesTable::get(attributesId)
+                : _attributes.at(readVarint(_input));
+            auto const hyperlinkIndex = readVarint(_input);
+            auto const hyperlink = hyperlinkIndex ? _hyperlinks.at(hyperlinkIndex - 1) : HyperlinkId{0};
+
+            // Bounded by the line's length, such that a corrupted snapshot cannot overrun it.
+            for (auto const end = min(i + max<size_t>(n, 1), size_t{cellCount}); i != end; ++i)
+            {
+                Cell& cell = line[i];
+                auto const header = *_input++;
+                if (header & ImageFlag)
+                    cell.setImage(_images.at(readVarint(_input)), hyperlink);
+                else
+                    cell.setHyperlink(hyperlink);
+
+                auto const codepointCount = header & 0x0F;
+                for (int k = 0; k < codepointCount; ++k)
+                {
+                    auto const codepoint = static_cast<char32_t>(readVarint(_input));
+                    if (k == 0)
+                        cell.setCharacter(codepoint);
+                    else
+                        cell.appendCharacter(codepoint);
+                }
+
+                cell.setWidth((header >> 4) & 0x07);
+                cell.setAttributes(attributes);
+            }
+        }
+
+        return line;
+    }
+}
+
+void SavedLines::indexLine(Line const& _line, Page& _page)
+{
+    auto const start = _page.text.size();
+    _line.appendText(_page.text, usedLength(_line));
+    _page.textEnds.push_back(static_cast<uint32_t>(_page.text.size()));
+    _page.trigrams.add(std::string_view{_page.text}.substr(start));
+}
+
+size_t SavedLines::usedLength(Line const& _line) noexcept
+{
+    auto n = _line.size();
+    while (n != 0)
+    {
+        Cell const& cell = _line[n - 1];
+        if (!cell.empty()
+                || cell.attributesId() != GraphicsAttributesTable::DefaultId
+                || cell.hyperlink()
+                || cell.imageFragment().has_value())
+            break;
+        --n;
+    }
+    return n;
+}
+
+size_t SavedLines::layoutLength(Line const& _line) noexcept
+{
+    return max(usedLength(_line), static_cast<size_t>(_line.joinedLength));
+}
+
+std::pair<size_t, size_t> SavedLines::locate(size_t _index) const noexcept
+{
+    auto const i = _index + frontSkip_;
+    return {i / pageSize_, i % pageSize_};
+}
+
+Line& SavedLines::at(size_t _index)
+{
+    if (_index >= packedLineCount_)
+        return hotLines_.at(_index - packedLineCount_);
+
+    auto const [pageIndex, offset] = locate(_index);
+    auto& page = cachedPage(pageIndex);
+    page.dirty = true;
+    return page.lines[offset];
+}
+
+Line const& SavedLines::at(size_t _index) const
+{
+    if (_index >= packedLineCount_)
+        return hotLines_.at(_index - packedLineCount_);
+
+    auto const [pageIndex, offset] = locate(_index);
+    return cachedPage(pageIndex).lines[offset];
+}
+
+Line& SavedLines::back()
+{
+    thawBack();
+    return hotLines_.back();
+}
+
+bool SavedLines::marked(size_t _index) const
+{
+    if (_index >= packedLineCount_)
+        return hotLines_.at(_index - packedLineCount_).marked;
+
+    auto const [pageIndex, offset] = locate(_index);
+    auto const serial = firstPageSerial_ + pageIndex;
+    for (CachedPage const& cached : cache_)
+        if (cached.serial == serial && cached.dirty)
+            return cached.lines[offset].marked;
+
+    return pages_[pageIndex].marks[offset];
+}
+
+SavedLines::CachedPage& SavedLines::cachedPage(size_t _pageIndex) const
+{
+    auto const serial = firstPageSerial_ + _pageIndex;
+    for (CachedPage& cached : cache_)
+    {
+        if (cached.serial == serial)
+        {
+            cached.lastUse = ++useCounter_;
+            return cached;
+        }
+    }
+
+    auto lines = decode(pages_[_pageIndex]);
+
+    if (cache_.size() < cachedPageCount_)
+        return cache_.emplace_back(CachedPage{serial, std::move(lines), false, ++useCounter_});
+
+    auto& victim = *std::min_element(
+        cache_.begin(),
+        cache_.end(),
+        [](CachedPage const& a, CachedPage const& b) { return a.lastUse < b.lastUse; }
+    );
+    writeBack(victim);
+    victim = CachedPage{serial, std::move(lines), false, ++useCounter_};
+    return victim;
+}
+
+void SavedLines::dropCachedPage(size_t _serial) const noexcept
+{
+    cache_.erase(
+        std::remove_if(cache_.begin(), cache_.end(), [&](CachedPage const& c) { return c.serial == _serial; }),
+        cache_.end()
+    );
+}
+
+void SavedLines::writeBack(CachedPage& _cachedPage) const
+{
+    if (!_cachedPage.dirty)
+        return;
+
+    Page& page = pages_[_cachedPage.serial - firstPageSerial_];
+    releasePage(page);
+
+    page = Page{};
+    for (Line const& line : _cachedPage.lines)
+    {
+        encodeLine(line, page);
+        page.marks.push_back(line.marked);
+        page.lengths.push_back(static_cast<uint32_t>(layoutLength(line)));
+        indexLine(line, page);
+    }
+    page.data.shrink_to_fit();
+    residentSize_ += page.data.size();
+    _cachedPage.dirty = false;
+}
+
+vector<Line> SavedLines::decode(Page const& _page) const
+{
+    if (!_page.output.empty())
+        return parse(_page.outputPrefix, _page.output, pageSize_);
+
+    auto spilledData = vector<uint8_t>{};
+    uint8_t const* input = _page.external.empty() ? _page.data.data() : _page.external.begin();
+
+    if (_page.spilled.has_value())
+    {
+        auto const [offset, size] = *_page.spilled;
+        spilledData.resize(size);
+        if (std::fseek(spillFile_.get(), offset, SEEK_SET) != 0
+                || std::fread(spilledData.data(), 1, size, spillFile_.get()) != size)
+            throw std::runtime_error("Failed to read back history from disk.");
+        input = spilledData.data();
+    }
+
+    auto lines = vector<Line>{};
+    lines.reserve(pageSize_);
+    for (auto const i : crispy::times(pageSize_))
+    {
+        lines.emplace_back(decodeLine(input, _page.attributes, _page.hyperlinks, _page.images));
+        lines.back().marked = _page.marks[i];
+        if (_page.lengths[i] > usedLength(lines.back()))
+            lines.back().joinedLength = _page.lengths[i];
+    }
+    return lines;
+}
+
+void SavedLines::releasePage(Page const& _page) const noexcept
+{
+    if (_page.spilled.has_value())
+        spilledSize_ -= _page.spilled->second;
+    else
+        residentSize_ -= _page.data.size();
+}
+
+void SavedLines::emplace_back(Line&& _line)
+{
+    if (_line.wrapped && !empty())
+    {
+        Line& last = back();
+        // The row joined keeps its place in the layout, even if blank.
+        last.joinedLength = static_cast<uint32_t>(last.size() + 1);
+        last.cells().insert(last.end(), std::make_move_iterator(_line.begin()), std::make_move_iterator(_line.end()));
+        if (layoutValid_)
+            rowEnds_.back() = (rowEnds_.size() > 1 ? rowEnds_[rowEnds_.size() - 2] : droppedRows_)
+                            + rowsOf(layoutLength(last));
+
+        if (spareLines_.size() < pageSize_)
+        {
+            _line.cells().clear();
+            spareLines_.emplace_back(std::move(_line));
+        }
+        return;
+    }
+
+    // Joined lines grow geometrically. Once complete, a long one gives back its spare capacity,
+    // which would otherwise be kept as long as the line is, possibly for megabytes of cells.
+    auto constexpr LongLineCells = size_t{4096};
+    if (!hotLines_.empty() && hotLines_.back().size() >= LongLineCells)
+    {
+        auto& cells = hotLines_.back().cells();
+        if (cells.capacity() - cells.size() > cells.size() / 4)
+            cells.shrink_to_fit();
+    }
+
+    hotLines_.emplace_back(std::move(_line));
+    if (hotLines_.back().marked)
+        markedSerials_.push_back(firstSerial_ + size() - 1);
+    if (layoutValid_)
+        rowEnds_.push_back((rowEnds_.empty() ? droppedRows_ : rowEnds_.back()) + rowsOf(layoutLength(hotLines_.back())));
+
+    if (hotLines_.size() >= hotLineCount() + pageSize_)
+        packFront();
+}
+
+void SavedLines::pop_front()
+{
+    if (!markedSerials_.empty() && markedSerials_.front() == firstSerial_)
+        markedSerials_.pop_front();
+
+    ++firstSerial_;
+
+    if (layoutValid_)
+    {
+        droppedRows_ = rowEnds_.front();
+        rowEnds_.pop_front();
+    }
+
+    if (packedLineCount_ == 0)
+    {
+        if (spareLines_.size() < pageSize_)
+            spareLines_.emplace_back(std::move(hotLines_.front()));
+        hotLines_.pop_front();
+        return;
+    }
+
+    --packedLineCount_;
+    if (++frontSkip_ == pageSize_)
+    {
+        dropCachedPage(firstPageSerial_);
+        releasePage(pages_.front());
+        pages_.pop_front();
+        ++firstPageSerial_;
+        frontSkip_ = 0;
+
+        if (pages_.empty())
+            spillFile_.reset();
+    }
+}
+
+void SavedLines::pop_back()
+{
+    if (!markedSerials_.empty() && markedSerials_.back() == firstSerial_ + size() - 1)
+        markedSerials_.pop_back();
+
+    thawBack();
+    hotLines_.pop_back();
+    if (layoutValid_)
+        rowEnds_.pop_back();
+}
+
+void SavedLines::clear()
+{
+    firstSerial_ += size();
+    firstPageSerial_ += pages_.size();
+    pages_.clear();
+    cache_.clear();
+    hotLines_.clear();
+    markedSerials_.clear();
+    frontSkip_ = 0;
+    packedLineCount_ = 0;
+    residentSize_ = 0;
+    spilledSize_ = 0;
+    spillFile_.reset();
+    rowEnds_.clear();
+    droppedRows_ = 0;
+    layoutValid_ = true;
+}
+
+// {{{ row layout
+size_t SavedLines::lengthOf(size_t _index) const
+{
+    if (_index >= packedLineCount_)
+        return layoutLength(hotLines_[_index - packedLineCount_]);
+
+    auto const [pageIndex, offset] = locate(_index);
+    return pages_[pageIndex].lengths[offset];
+}
+
+size_t SavedLines::rowsOf(size_t _length) const noexcept
+{
+    if (rowWidth_ == 0 || _length <= rowWidth_)
+        return 1;
+    return (_length + rowWidth_ - 1) / rowWidth_;
+}
+
+void SavedLines::ensureLayout() const
+{
+    if (layoutValid_)
+        return;
+
+    rowEnds_.clear();
+    droppedRows_ = 0;
+
+    size_t rowCount = 0;
+    for (size_t i = 0; i < size(); ++i)
+    {
+        rowCount += rowsOf(lengthOf(i));
+        rowEnds_.push_back(rowCount);
+    }
+    layoutValid_ = true;
+}
+
+void SavedLines::setRowWidth(size_t _width)
+{
+    if (_width == rowWidth_)
+        return;
+
+    rowWidth_ = _width;
+    layoutValid_ = false;
+    rowEnds_.clear();
+    droppedRows_ = 0;
+}
+
+size_t SavedLines::rowCount() const
+{
+    ensureLayout();
+    return rowEnds_.empty() ? 0 : rowEnds_.back() - droppedRows_;
+}
+
+std::pair<size_t, size_t> SavedLines::locateRow(size_t _row) const
+{
+    ensureLayout();
+    auto const row = _row + droppedRows_;
+    auto const i = std::upper_bound(rowEnds_.begin(), rowEnds_.end(), row);
+    auto const lineIndex = static_cast<size_t>(std::distance(rowEnds_.begin(), i));
+    auto const firstRow = lineIndex == 0 ? droppedRows_ : rowEnds_[lineIndex - 1];
+    return {lineIndex, (row - firstRow) * rowWidth_};
+}
+
+bool SavedLines::rowMarked(size_t _row) const
+{
+    auto const [lineIndex, offset] = locateRow(_row);
+    return offset == 0 && marked(lineIndex);
+}
+
+std::optional<size_t> SavedLines::markedRowBefore(size_t _row) const
+{
+    if (_row == 0 || empty())
+        return std::nullopt;
+
+    auto const lineIndex = locateRow(std::min(_row, rowCount()) - 1).first;
+    auto const i = std::upper_bound(markedSerials_.begin(), markedSerials_.end(), firstSerial_ + lineIndex);
+    if (i == markedSerials_.begin())
+        return std::nullopt;
+
+    return firstRowOf(*std::prev(i) - firstSerial_);
+}
+
+std::optional<size_t> SavedLines::markedRowAfter(size_t _row) const
+{
+    if (_row >= rowCount())
+        return std::nullopt;
+
+    auto const lineIndex = locateRow(_row).first;
+    auto const i = std::upper_bound(markedSerials_.begin(), markedSerials_.end(), firstSerial_ + lineIndex);
+    if (i == markedSerials_.end())
+        return std::nullopt;
+
+    return firstRowOf(*i - firstSerial_);
+}
+
+Line SavedLines::takeBackRow()
+{
+    Line& last = back();
+    auto const rows = rowsOf(layoutLength(last));
+    if (rows == 1)
+    {
+        auto line = std::move(last);
+        line.joinedLength = 0;
+        pop_back();
+        return line;
+    }
+
+    auto const start = static_cast<std::ptrdiff_t>((rows - 1) * rowWidth_);
+    auto row = Line{};
+    row.cells().assign(std::make_move_iterator(next(last.begin(), start)), std::make_move_iterator(last.end()));
+    row.wrapped = true;
+    last.resize(static_cast<size_t>(start));
+    last.joinedLength = min(last.joinedLength, static_cast<uint32_t>(start));
+
+    if (layoutValid_)
+        rowEnds_.back() = (rowEnds_.size() > 1 ? rowEnds_[rowEnds_.size() - 2] : droppedRows_)
+                        + rowsOf(layoutLength(last));
+
+    return row;
+}
+
+void SavedLines::popFrontRows(size_t _count)
+{
+    ensureLayout();
+    while (_count != 0 && !empty())
+    {
+        auto const rows = rowEnds_.front() - droppedRows_;
+        if (rows <= _count)
+        {
+            pop_front();
+            _count -= rows;
+            continue;
+        }
+
+        // The line's start is gone, hence it is no longer marked.
+        if (!markedSerials_.empty() && markedSerials_.front() == firstSerial_)
+            markedSerials_.pop_front();
+
+        auto const cells = _count * rowWidth_;
+        Line& line = at(0);
+        line.marked = false;
+        line.cells().erase(line.begin(), next(line.begin(), static_cast<std::ptrdiff_t>(cells)));
+        line.joinedLength = line.joinedLength > cells ? line.joinedLength - static_cast<uint32_t>(cells) : 0;
+        droppedRows_ += _count;
+
+        // A packed line is written back right away, such that the page's lengths and text are
+        // kept up to date for laying out and searching.
+        if (packedLineCount_ != 0)
+            writeBack(cachedPage(locate(0).first));
+        return;
+    }
+}
+
+size_t SavedLines::firstRowOf(size_t _index) const
+{
+    ensureLayout();
+    return (_index == 0 ? droppedRows_ : rowEnds_[_index - 1]) - droppedRows_;
+}
+// }}}
+
+// {{{ text index
+std::string_view SavedLines::text(size_t _index, std::string& _buffer) const
+{
+    if (_index >= packedLineCount_)
+    {
+        Line const& line = hotLines_.at(_index - packedLineCount_);
+        _buffer.clear();
+        line.appendText(_buffer, usedLength(line));
+        return _buffer;
+    }
+
+    auto const [pageIndex, offset] = locate(_index);
+    Page const& page = pages_[pageIndex];
+    if (!page.output.empty())
+    {
+        Line const& line = cachedPage(pageIndex).lines[offset];
+        _buffer.clear();
+        line.appendText(_buffer, usedLength(line));
+        return _buffer;
+    }
+
+    for (CachedPage const& cached : cache_)
+    {
+        if (cached.serial == firstPageSerial_ + pageIndex && cached.dirty)
+        {
+            Line const& line = cached.lines[offset];
+            _buffer.clear();
+            line.appendText(_buffer, usedLength(line));
+            return _buffer;
+        }
+    }
+
+    auto const start = offset == 0 ? 0 : page.textEnds[offset - 1];
+    return std::string_view{page.text}.substr(start, page.textEnds[offset] - start);
+}
+
+std::optional<size_t> SavedLines::firstLineOfPageWithout(size_t _index, crispy::trigram_filter const& _needle) const
+{
+    if (_index >= packedLineCount_)
+        return std::nullopt;
+
+    auto const [pageIndex, offset] = locate(_index);
+    if (!pages_[pageIndex].output.empty())
+        return std::nullopt;
+    for (CachedPage const& cached : cache_)
+        if (cached.serial == firstPageSerial_ + pageIndex && cached.dirty)
+            return std::nullopt;
+
+    if (pages_[pageIndex].trigrams.may_contain(_needle))
+        return std::nullopt;
+
+    // The first page may have been partially dropped already.
+    return pageIndex == 0 ? 0 : _index - offset;
+}
+// }}}
+
+Line SavedLines::spareLine()
+{
+    if (spareLines_.empty())
+        return Line{};
+
+    auto line = std::move(spareLines_.back());
+    spareLines_.pop_back();
+    return line;
+}
+
+namespace
+{
+    void markHyperlinks(Line const& _line, vector<bool>& _used)
+    {
+        auto const mark = [&](Cell const& _cell) {
+            if (auto const id = _cell.hyperlink(); id < _used.size())
+                _used[id] = true;
+        };
+
+        // Cleared lines are not materialized just for marking their cells.
+        if (Cell const* blankCell = _line.blankCell(); blankCell != nullptr)
+            mark(*blankCell);
+        else
+            for (Cell const& cell : _line)
+                mark(cell);
+    }
+}
+
+void SavedLines::markHyperlinks(vector<bool>& _used) const
+{
+    // Cells of cached or spare lines may refer to hyperlinks not (or no longer) held by any page.
+    for (Page const& page : pages_)
+        for (HyperlinkId const id : page.hyperlinks)
+            if (id < _used.size())
+                _used[id] = true;
+    for (CachedPage const& cachedPage : cache_)
+        for (Line const& line : cachedPage.lines)
+            terminal::markHyperlinks(line, _used);
+    for (Line const& line : hotLines_)
+        terminal::markHyperlinks(line, _used);
+    for (Line const& line : spareLines_)
+        terminal::markHyperlinks(line, _used);
+}
+
+size_t SavedLines::memoryUsage() const noexcept
+{
+    auto bytes = rowEnds_.size() * sizeof(size_t) + markedSerials_.size() * sizeof(size_t);
+    for (Page const& page : pages_)
+        bytes += sizeof(Page)
+               + page.data.capacity()
+               + page.marks.capacity() / 8
+               + page.lengths.capacity() * sizeof(uint32_t)
+               + page.hyperlinks.capacity() * sizeof(HyperlinkId)
+               + page.images.capacity() * sizeof(ImageFragment)
+               + page.attributes.capacity() * sizeof(GraphicsAttributes)
+               + page.text.capacity()
+               + page.textEnds.capacity() * sizeof(uint32_t);
+    for (CachedPage const& cachedPage : cache_)
+        for (Line const& line : cachedPage.lines)
+            bytes += sizeof(Line) + line.memoryUsage();
+    for (Line const& line : hotLines_)
+        bytes += sizeof(Line) + line.memoryUsage();
+    for (Line const& line : spareLines_)
+        bytes += sizeof(Line) + line.memoryUsage();
+    return bytes;
+}
+
+size_t SavedLines::extraMemoryUsage() const noexcept
+{
+    auto bytes = size_t{0};
+    for (CachedPage const& cachedPage : cache_)
+        for (Line const& line : cachedPage.lines)
+            bytes += line.extraMemoryUsage();
+    for (Line const& line : hotLines_)
+        bytes += line.extraMemoryUsage();
+    for (Line const& line : spareLines_)
+        bytes += line.extraMemoryUsage();
+    return bytes;
+}
+
+void SavedLines::setSpillThreshold(optional<size_t> _bytes)
+{
+    spillThreshold_ = _bytes;
+    spill();
+}
+
+void SavedLines::setPaging(size_t _pageSize, size_t _cachedPageCount)
+{
+    _pageSize = max(_pageSize, size_t{1});
+    _cachedPageCount = max(_cachedPageCount, size_t{1});
+
+    // Decoded pages beyond the new count are let go of, least recently used first.
+    while (cache_.size() > _cachedPageCount)
+    {
+        auto const victim = std::min_element(
+            cache_.begin(),
+            cache_.end(),
+            [](CachedPage const& a, CachedPage const& b) { return a.lastUse < b.lastUse; }
+        );
+        writeBack(*victim);
+        cache_.erase(victim);
+    }
+    cachedPageCount_ = _cachedPageCount;
+
+    if (_pageSize == pageSize_)
+        return;
+
+    if (empty())
+    {
+        pageSize_ = _pageSize;
+        return;
+    }
+
+    // The lines are appended to a history of the new page size, which packs them as they come,
+    // such that not all of them are decoded at once.
+    auto repacked = SavedLines{};
+    repacked.pageSize_ = _pageSize;
+    repacked.cachedPageCount_ = cachedPageCount_;
+    repacked.firstSerial_ = firstSerial_;
+    repacked.rowWidth_ = rowWidth_;
+    repacked.layoutValid_ = layoutValid_;
+    repacked.droppedRows_ = layoutValid_ ? droppedRows_ : 0;
+    repacked.spillThreshold_ = spillThreshold_;
+    for (size_t i = 0; i < size(); ++i)
+    {
+        auto line = std::as_const(*this).at(i);
+        line.wrapped = false; // lines of the history are logical lines already, not to be joined again
+        repacked.emplace_back(std::move(line));
+    }
+    repacked.spareLines_ = std::move(spareLines_);
+
+    *this = std::move(repacked);
+}
+
+void SavedLines::packFront()
+{
+    auto page = Page{};
+    page.marks.reserve(pageSize_);
+
+    for (auto i = pageSize_; i != 0; --i)
+    {
+        Line& line = hotLines_.front();
+        encodeLine(line, page);
+        page.marks.push_back(line.marked);
+        page.lengths.push_back(static_cast<uint32_t>(layoutLength(line)));
+        indexLine(line, page);
+        if (spareLines_.size() < pageSize_)
+            spareLines_.emplace_back(std::move(line));
+        hotLines_.pop_front();
+    }
+
+    page.data.shrink_to_fit();
+    residentSize_ += page.data.size();
+    pages_.emplace_back(std::move(page));
+    packedLineCount_ += pageSize_;
+
+    spill();
+}
+
+void SavedLines::thawBack()
+{
+    if (!hotLines_.empty() || pages_.empty())
+        return;
+
+    auto const pageIndex = pages_.size() - 1;
+    auto const first = pageIndex == 0 ? frontSkip_ : 0;
+    auto lines = std::move(cachedPage(pageIndex).lines);
+
+    dropCachedPage(firstPageSerial_ + pageIndex);
+    releasePage(pages_.back());
+    pages_.pop_back();
+    packedLineCount_ -= pageSize_ - first;
+
+    for (auto i = first; i < lines.size(); ++i)
+        hotLines_.emplace_back(std::move(lines[i]));
+
+    if (pages_.empty())
+    {
+        frontSkip_ = 0;
+        spillFile_.reset();
+    }
+}
+
+void SavedLines::spill()
+{
+    if (!spillThreshold_.has_value())
+        return;
+
+    for (Page& page : pages_)
+    {
+        if (residentSize_ <= spillThreshold_.value())
+            break;
+
+        // External pages and pages of output are kept on disk already.
+        if (page.spilled.has_value() || !page.external.empty() || !page.output.empty())
+            continue;
+
+        if (!spillFile_)
+        {
+            spillFile_.reset(std::tmpfile());
+            if (!spillFile_)
+            {
+                // No place to spill to, so keep everything in memory.
+                spillThreshold_.reset();
+                return;
+            }
+        }
+
+        std::fseek(spillFile_.get(), 0, SEEK_END);
+        auto const offset = std::ftell(spillFile_.get());
+        if (offset < 0 || std::fwrite(page.data.data(), 1, page.data.size(), spillFile_.get()) != page.data.size())
+        {
+            spillThreshold_.reset();
+            return;
+        }
+
+        page.spilled = pair{offset, page.data.size()};
+        residentSize_ -= page.data.size();
+        spilledSize_ += page.data.size();
+        vector<uint8_t>{}.swap(page.data);
+    }
+}
+
+void SavedLines::append(PortableLines const& _lines, vector<HyperlinkId> _hyperlinkIds)
+{
+    if (_lines.size() != pageSize_ || !hotLines_.empty())
+    {
+        for (Line& line : _lines.decode(_hyperlinkIds))
+        {
+            // Lines of the history are logical lines already, not to be joined again.
+            line.wrapped = false;
+            emplace_back(std::move(line));
+        }
+        return;
+    }
+
+    auto page = Page{};
+    if (_lines.externalData.empty())
+    {
+        page.data = _lines.data;
+        residentSize_ += page.data.size();
+    }
+    else
+    {
+        page.external = _lines.externalData;
+        page.externalOwner = _lines.externalOwner;
+    }
+    page.lengths = _lines.lengths;
+    page.hyperlinks = std::move(_hyperlinkIds);
+    page.attributes = _lines.attributes;
+    page.text = _lines.text;
+    page.textEnds = _lines.textEnds;
+
+    page.marks.reserve(pageSize_);
+    for (size_t i = 0; i < pageSize_; ++i)
+    {
+        auto const marked = (_lines.flags[i] & PortableLines::Marked) != 0;
+        page.marks.push_back(marked);
+        if (marked)
+            markedSerials_.push_back(firstSerial_ + size() + i);
+
+        auto const start = i == 0 ? 0 : page.textEnds[i - 1];
+        page.trigrams.add(std::string_view{page.text}.substr(start, page.textEnds[i] - start));
+
+        if (layoutValid_)
+            rowEnds_.push_back((rowEnds_.empty() ? droppedRows_ : rowEnds_.back()) + rowsOf(page.lengths[i]));
+    }
+
+    pages_.emplace_back(std::move(page));
+    packedLineCount_ += pageSize_;
+}
+
+void SavedLines::appendOutput(crispy::span<uint8_t const> _output, std::shared_ptr<void const> _owner)
+{
+    auto scanner = OutputScanner{};
+    auto input = _output.begin();
+    auto const end = _output.end();
+
+    // Pages are split off as long as no lines have been appended otherwise, as packed pages
+    // precede all other lines. The rest of the output is parsed right away.
+    auto prefix = std::string{};
+    auto lineCount = size_t{0};
+    while (hotLines_.empty() && input != end)
+    {
+        auto page = Page{};
+        page.outputPrefix = scanner.prefix();
+        page.lengths.reserve(pageSize_);
+        auto const begin = input;
+        while (input != end && page.lengths.size() < pageSize_)
+            page.lengths.push_back(static_cast<uint32_t>(scanner.scanLine(input, end)));
+
+        // The last line may not be terminated, which is parsed like an incomplete page.
+        if (page.lengths.size() < pageSize_ || (input == end && end[-1] != '\n'))
+        {
+            input = begin;
+            prefix = std::move(page.outputPrefix);
+            lineCount = page.lengths.size();
+            break;
+        }
+
+        page.output = crispy::span<uint8_t const>{begin, input};
+        page.externalOwner = _owner;
+        page.marks.resize(pageSize_);
+        if (layoutValid_)
+            for (uint32_t const length : page.lengths)
+                rowEnds_.push_back((rowEnds_.empty() ? droppedRows_ : rowEnds_.back()) + rowsOf(length));
+        pages_.emplace_back(std::move(page));
+        packedLineCount_ += pageSize_;
+    }
+
+    if (input == end)
+        return;
+
+    if (lineCount == 0)
+    {
+        prefix = scanner.prefix();
+        for (auto i = input; i != end; ++lineCount)
+            scanner.scanLine(i, end);
+    }
+
+    for (Line& line : parse(prefix, crispy::span<uint8_t const>{input, end}, lineCount))
+        emplace_back(std::move(line));
+}
+
+vector<Line> SavedLines::parse(std::string_view _prefix, crispy::span<uint8_t const> _output, size_t _lineCount) const
+{
+    // The output is written into a screen of one row, as wide as the history's rows, each line
+    // thereby ending up as a logical line in that screen's history.
+    auto events = MockScreenEvents{};
+    auto screen = Screen{Size{rowWidth_ ? static_cast<int>(rowWidth_) : 80, 1}, events};
+    screen.setMode(Mode::AutomaticNewLine, true);
+    screen.write(_prefix);
+    screen.write(reinterpret_cast<char const*>(_output.begin()), _output.size());
+    if (_output.end()[-1] != '\n')
+        screen.write("\n", 1);
+
+    // Hyperlinks refer to the screen's storage, hence are dropped. Output moving the cursor
+    // across lines may have yielded more or fewer lines than split into.
+    SavedLines const& history = screen.scrollbackLines();
+    auto lines = vector<Line>{};
+    lines.reserve(_lineCount);
+    for (size_t i = 0; i < _lineCount; ++i)
+    {
+        auto& line = lines.emplace_back(i < history.size() ? history.at(i) : Line(rowWidth_, Cell{}));
+        line.marked = false;
+        line.wrapped = false;
+        for (Cell& cell : line)
+            if (cell.hyperlink())
+                cell.setHyperlink(0);
+    }
+    return lines;
 }
 // }}}
 
-std::string Cell::toUtf8() const
+// {{{ PortableLines
+// Encodes lines like SavedLines::encodeLine(), but with the attributes of every run indexed
+// into the attributes table, and hyperlinks indexed into the hyperlinks table by value.
+void PortableLines::append(Line const& _line, HyperlinkStorage const& _hyperlinks)
+{
+    auto const attributesIndex = [&](Cell const& _cell) {
+        auto const id = _cell.attributesId();
+        if (id != GraphicsAttributesTable::InvalidId)
+            if (auto const i = attributeIndices_.find(id); i != attributeIndices_.end())
+                return i->second;
+
+        auto const index = static_cast<uint32_t>(attributes.size());
+        attributes.push_back(_cell.attributes());
+        if (id != GraphicsAttributesTable::InvalidId)
+            attributeIndices_.emplace(id, index);
+        return index;
+    };
+
+    auto const hyperlinkIndex = [&](HyperlinkId _id) -> uint32_t {
+        if (!_id)
+            return 0;
+        if (auto const i = hyperlinkIndices_.find(_id); i != hyperlinkIndices_.end())
+            return i->second;
+
+        auto const* hyperlink = _hyperlinks.get(_id);
+        if (!hyperlink)
+            return 0;
+
+        hyperlinks.emplace_back(hyperlink->id, hyperlink->uri);
+        auto const index = static_cast<uint32_t>(hyperlinks.size());
+        hyperlinkIndices_.emplace(_id, index);
+        return index;
+    };
+
+    writeVarint(data, static_cast<uint32_t>(_line.size()));
+
+    size_t i = 0;
+    while (i < _line.size())
+    {
+        Cell const& first = _line[i];
+        auto const attributesId = first.attributesId();
+        auto const hyperlink = first.hyperlink();
+
+        size_t n = 1;
+        if (attributesId != GraphicsAttributesTable::InvalidId)
+            while (i + n < _line.size()
+                    && _line[i + n].attributesId() == attributesId
+                    && _line[i + n].hyperlink() == hyperlink)
+                ++n;
+
+        writeVarint(data, static_cast<uint32_t>(n));
+        writeVarint(data, GraphicsAttributesTable::InvalidId);
+        writeVarint(data, attributesIndex(first));
+        writeVarint(data, hyperlinkIndex(hyperlink));
+
+        for (; n != 0; --n, ++i)
+        {
+            Cell const& cell = _line[i];
+            data.push_back(static_cast<uint8_t>(((cell.width() & 0x07) << 4) | cell.codepointCount()));
+            for (char32_t const codepoint : cell.codepoints())
+                writeVarint(data, static_cast<uint32_t>(codepoint));
+        }
+    }
+
+    flags.push_back(static_cast<uint8_t>((_line.marked ? Marked : 0) | (_line.wrapped ? Wrapped : 0)));
+    lengths.push_back(static_cast<uint32_t>(SavedLines::layoutLength(_line)));
+    _line.appendText(text, SavedLines::usedLength(_line));
+    textEnds.push_back(static_cast<uint32_t>(text.size()));
+}
+
+vector<Line> PortableLines::decode(vector<HyperlinkId> const& _hyperlinkIds) const
 {
-    return unicode::to_utf8(codepoints_.data(), codepointCount_);
+    static auto const noImages = vector<ImageFragment>{};
+
+    uint8_t const* input = cells().begin();
+    auto lines = vector<Line>{};
+    lines.reserve(size());
+    for (size_t i = 0; i < size(); ++i)
+    {
+        lines.emplace_back(decodeLine(input, attributes, _hyperlinkIds, noImages));
+        lines.back().marked = (flags[i] & Marked) != 0;
+        lines.back().wrapped = (flags[i] & Wrapped) != 0;
+        if (lengths[i] > SavedLines::usedLength(lines.back()))
+            lines.back().joinedLength = lengths[i];
+    }
+    return lines;
 }
+// }}}
 
+/// @returns the screen buffers, of which the alternate one is only allocated once used.
 std::array<Lines, 2> emptyBuffers(Size _size)
 {
     return std::array<Lines, 2>{
@@ -242,10 +1630,7 @@ std::array<Lines, 2> emptyBuffers(Size _size)
             static_cast<size_t>(_size.height),
             Line(static_cast<size_t>(_size.width), Cell{})
         ),
-        Lines(
-            static_cast<size_t>(_size.height),
-            Line(static_cast<size_t>(_size.width), Cell{})
-        )
+        Lines{}
     };
 }
 
@@ -282,6 +1667,7 @@ Screen::Screen(Size const& _size,
     maxHistoryLineCount_{ _maxHistoryLineCount },
     sixelCursorConformance_{ _sixelCursorConformance }
 {
+    savedLines_.setRowWidth(static_cast<size_t>(_size.width));
     resetHard();
 }
 
@@ -300,11 +1686,15 @@ void Screen::clampSavedLines()
     clampSavedLines(savedLines_);
 }
 
-void Screen::clampSavedLines(Lines& _savedLines) const
+void Screen::clampSavedLines(SavedLines& _savedLines) const
 {
-    if (maxHistoryLineCount_.has_value())
-        while (_savedLines.size() > maxHistoryLineCount_.value())
-            _savedLines.pop_front();
+    // Bounded by rows rather than logical lines, as a single line may span any number of rows.
+    if (!maxHistoryLineCount_.has_value())
+        return;
+
+    auto const limit = *maxHistoryLineCount_ + openedHistoryRowCount_;
+    if (auto const rowCount = _savedLines.rowCount(); rowCount > limit)
+        _savedLines.popFrontRows(rowCount - limit);
 }
 
 void Screen::resizeColumns(int _newColumnCount, bool _clear)
@@ -334,10 +1724,14 @@ void Screen::resizeColumns(int _newColumnCount, bool _clear)
 
 void Screen::resize(Size const& _newSize)
 {
-    // TODO: only resize current screen buffer, and then make sure we resize the other upon actual switch
+    savedLines_.setRowWidth(static_cast<size_t>(_newSize.width));
 
-    auto dummyLines = Lines{};
-    resizeBuffer(_newSize, alternateBuffer(), dummyLines);
+    // The alternate buffer is resized upon switching to it, unless in use.
+    if (isAlternateScreen())
+    {
+        auto dummyLines = SavedLines{};
+        resizeBuffer(_newSize, alternateBuffer(), dummyLines);
+    }
 
     cursor_.position = resizeBuffer(_newSize, primaryBuffer(), savedLines_);
 
@@ -357,6 +1751,9 @@ void Screen::resize(Size const& _newSize)
     };
 
     size_ = _newSize;
+    damagedLines_.assign(static_cast<size_t>(size_.height), false);
+    damageScreen();
+    implicitHyperlinks_.clear();
 
     cursor_.position = clampCoordinate(cursor_.position);
     updateCursorIterators();
@@ -378,7 +1775,7 @@ void Screen::resize(Size const& _newSize)
 
 Coordinate Screen::resizeBuffer(Size const& _newSize,
                                 Lines& _lines,
-                                Lines& _savedLines) const
+                                SavedLines& _savedLines) const
 {
     auto newPosition = cursor_.position;
 
@@ -388,14 +1785,14 @@ Coordinate Screen::resizeBuffer(Size const& _newSize,
         // or create new ones until size_.height == _newSize.height.
         auto const extendCount = _newSize.height - size_.height;
 
-        auto const rowsToTakeFromSavedLines = min(extendCount, static_cast<int>(std::size(_savedLines)));
+        auto const rowsToTakeFromSavedLines = min(extendCount, static_cast<int>(_savedLines.rowCount()));
 
         for_each(
             crispy::times(rowsToTakeFromSavedLines),
             [&](auto) {
-                _savedLines.back().resize(_newSize.width);
-                _lines.emplace_front(std::move(_savedLines.back()));
-                _savedLines.pop_back();
+                auto line = _savedLines.takeBackRow();
+                line.resize(_newSize.width);
+                _lines.emplace_front(std::move(line));
             }
         );
 
@@ -417,7 +1814,6 @@ Coordinate Screen::resizeBuffer(Size const& _newSize,
             crispy::for_each(
                 crispy::times(n),
                 [&](auto) {
-                    _lines.front().resize(_newSize.width);
                     _savedLines.emplace_back(std::move(_lines.front()));
                     _lines.pop_front();
                 }
@@ -445,6 +1841,60 @@ Coordinate Screen::resizeBuffer(Size const& _newSize,
     return newPosition;
 }
 
+// {{{ damage tracking
+void Screen::damageLines(int _from, int _to) noexcept
+{
+    assert(1 <= _from && _to <= size_.height);
+
+    for (int row = _from; row <= _to; ++row)
+        damagedLines_[static_cast<size_t>(row - 1)] = true;
+
+    if (!implicitHyperlinksDamage_ || _from < *implicitHyperlinksDamage_)
+        implicitHyperlinksDamage_ = _from;
+
+    if (!damagedRows_)
+        damagedRows_ = Margin::Range{_from, _to};
+    else
+    {
+        damagedRows_->from = min(damagedRows_->from, _from);
+        damagedRows_->to = max(damagedRows_->to, _to);
+    }
+}
+
+void Screen::damageScroll(int _n)
+{
+    if (_n <= 0)
+        return;
+
+    // Damage of the remaining rows moves up along with them, the rows scrolled in are new.
+    damagedLines_.erase(damagedLines_.begin(), next(damagedLines_.begin(), _n));
+    damagedLines_.insert(damagedLines_.end(), static_cast<size_t>(_n), false);
+
+    if (damagedRows_ && damagedRows_->to - _n >= 1)
+        damagedRows_ = Margin::Range{max(1, damagedRows_->from - _n), damagedRows_->to - _n};
+    else
+        damagedRows_.reset();
+
+    // Lines scrolled off the top are invalidated by their serial number.
+    if (implicitHyperlinksDamage_)
+        implicitHyperlinksDamage_ = max(1, *implicitHyperlinksDamage_ - _n);
+
+    damageLines(size_.height - _n + 1, size_.height);
+    scrolledLines_ += _n;
+}
+
+void Screen::clearDamage() noexcept
+{
+    scrolledLines_ = 0;
+
+    if (!damagedRows_)
+        return;
+
+    fill(next(damagedLines_.begin(), damagedRows_->from - 1), next(damagedLines_.begin(), damagedRows_->to), false);
+    damagedRows_.reset();
+}
+// }}}
+
 void Screen::verifyState() const
 {
 #if !defined(NDEBUG)
@@ -491,8 +1941,8 @@ void Screen::fail(std::string const& _message) const
 void Screen::write(char const * _data, size_t _size)
 {
 #if defined(LIBTERMINAL_LOG_RAW)
-    if (logRaw_ && logger_)
-        logger_(RawOutputEvent{ escape(_data, _data + _size) });
+    if (logRaw_ && logger_.enabled<RawOutputEvent>())
+        logger_(RawOutputEvent{ string(_data, _size) });
 #endif
 
     parser_.parseFragment(_data, _size);
@@ -515,7 +1965,7 @@ void Screen::writeText(char32_t _char)
     bool const consecutiveTextWrite = sequencer_.instructionCounter() == 1;
 
     if (wrapPending_ && cursor_.autoWrap)
-        linefeed(margin_.horizontal.from);
+        wrapLine();
 
     auto const ch =
         _char < 127 ? cursor_.charsets.map(static_cast<char>(_char))
@@ -524,13 +1974,14 @@ void Screen::writeText(char32_t _char)
     bool const insertToPrev =
         consecutiveTextWrite
         && !lastColumn_->empty()
-        && unicode::grapheme_segmenter::nonbreakable(lastColumn_->codepoint(lastColumn_->codepointCount() - 1), ch);
+        && CodepointProperties::nonbreakable(lastColumn_->codepoint(lastColumn_->codepointCount() - 1), ch);
 
     if (!insertToPrev)
         writeCharToCurrentAndAdvance(ch);
     else
     {
         auto const extendedWidth = lastColumn_->appendCharacter(ch);
+        damageLine(lastCursorPosition_.row);
 
         if (extendedWidth > 0)
             clearAndAdvance(extendedWidth);
@@ -539,12 +1990,72 @@ void Screen::writeText(char32_t _char)
     sequencer_.resetInstructionCounter();
 }
 
+void Screen::writeText(string_view _chars)
+{
+    if (_chars.empty())
+        return;
+
+    // The first character may still extend the grapheme cluster of the previously written cell.
+    writeText(static_cast<char32_t>(_chars.front()));
+    _chars.remove_prefix(1);
+
+    while (!_chars.empty())
+    {
+        if (wrapPending_ && cursor_.autoWrap)
+            wrapLine();
+
+        // A cursor left of the right margin enters the margins while writing, where it wraps at
+        // the right margin, just like when writing character by character.
+        bool const rightMarginAhead = isModeEnabled(Mode::LeftRightMargin)
+                                   && margin_.vertical.contains(cursor_.position.row)
+                                   && cursor_.position.column <= margin_.horizontal.to;
+        auto const cellsAvailable = rightMarginAhead ? margin_.horizontal.to - cursor_.position.column
+                                                     : size_.width - cursor_.position.column;
+        auto const n = min(static_cast<int>(_chars.size()), cellsAvailable);
+
+        if (n <= 0)
+        {
+            // Last column reached: this sets wrapPending (or overwrites the last column).
+            writeCharToCurrentAndAdvance(cursor_.charsets.map(_chars.front()));
+            _chars.remove_prefix(1);
+            continue;
+        }
+
+        // Rewriting what is on screen already (as full-screen applications redrawing periodically
+        // do) leaves the row undamaged.
+        auto const attributesId = GraphicsAttributesTable::intern(cursor_.graphicsRendition);
+        auto changed = false;
+        cursor_.charsets.map(_chars.substr(0, static_cast<size_t>(n)), [&](char32_t _ch) {
+            Cell& cell = *currentColumn_++;
+            if (cell.holds(_ch, attributesId, currentHyperlink_))
+                return;
+            cell.setCharacter(_ch);
+            cell.setAttributes(cursor_.graphicsRendition);
+            cell.setHyperlink(currentHyperlink_);
+            changed = true;
+        });
+        if (changed)
+            damageLine(cursor_.position.row);
+
+        lastColumn_ = prev(currentColumn_);
+        cursor_.position.column += n - 1;
+        lastCursorPosition_ = cursor_.position;
+        cursor_.position.column++;
+
+        _chars.remove_prefix(static_cast<size_t>(n));
+    }
+}
+
 void Screen::writeCharToCurrentAndAdvance(char32_t _character)
 {
     Cell& cell = *currentColumn_;
-    cell.setCharacter(_character);
-    cell.attributes() = cursor_.graphicsRendition;
-    cell.setHyperlink(currentHyperlink_);
+    if (!cell.holds(_character, GraphicsAttributesTable::intern(cursor_.graphicsRendition), currentHyperlink_))
+    {
+        damageLine(cursor_.position.row);
+        cell.setCharacter(_character);
+        cell.setAttributes(cursor_.graphicsRendition);
+        cell.setHyperlink(currentHyperlink_);
+    }
 
     lastColumn_ = currentColumn_;
     lastCursorPosition_ = cursor_.position;
@@ -558,6 +2069,9 @@ void Screen::writeCharToCurrentAndAdvance(char32_t _character)
     if (n == cell.width())
     {
         assert(n > 0);
+        // The cells covered by a wide character may have been written to on their own since.
+        if (n > 1)
+            damageLine(cursor_.position.row);
         cursor_.position.column += n;
         currentColumn_++;
         for (int i = 1; i < n; ++i)
@@ -593,9 +2107,9 @@ string Screen::renderHistoryTextLine(int _lineNumberIntoHistory) const
     assert(1 <= _lineNumberIntoHistory && _lineNumberIntoHistory <= historyLineCount());
     string line;
     line.reserve(size_.width);
-    auto const lineIter = next(savedLines_.rbegin(), _lineNumberIntoHistory - 1);
-    for (Cell const& cell : *lineIter)
-        if (cell.codepointCount())
+    auto const row = static_cast<size_t>(historyLineCount() - _lineNumberIntoHistory);
+    for (int column = 1; column <= size_.width; ++column)
+        if (Cell const& cell = historyCell(row, column); cell.codepointCount())
             line += cell.toUtf8();
         else
             line += " "; // fill character
@@ -603,6 +2117,15 @@ string Screen::renderHistoryTextLine(int _lineNumberIntoHistory) const
     return line;
 }
 
+Cell const& Screen::historyCell(size_t _row, int _column) const
+{
+    static Cell const emptyCell{};
+    auto const [lineIndex, offset] = savedLines_.locateRow(_row);
+    Line const& line = savedLines_.at(lineIndex);
+    auto const i = offset + static_cast<size_t>(_column - 1);
+    return i < line.size() ? line[i] : emptyCell;
+}
+
 std::string Screen::screenshot() const
 {
     auto result = std::stringstream{};
@@ -638,6 +2161,284 @@ std::string Screen::screenshot() const
     return result.str();
 }
 
+// {{{ text search
+bool Screen::startsLogicalLine(int _row) const
+{
+    if (_row == 1)
+        return !lines().front().wrapped || savedLines_.empty() || isAlternateScreen();
+    return !next(begin(lines()), _row - 1)->wrapped;
+}
+
+optional<int> Screen::firstRowOfLine(size_t _serial) const
+{
+    auto serial = savedLines_.firstSerial() + savedLines_.size();
+    for (int row = 1; row <= size_.height; ++row)
+    {
+        if (!startsLogicalLine(row))
+            continue;
+        if (serial == _serial)
+            return row;
+        ++serial;
+    }
+    return nullopt;
+}
+
+size_t Screen::lineSerialOfRow(int _row) const
+{
+    // A top row not starting a logical line continues the most recent history line.
+    auto serial = savedLines_.firstSerial() + savedLines_.size() - 1;
+    for (int row = 1; row <= _row; ++row)
+        if (startsLogicalLine(row))
+            ++serial;
+    return serial;
+}
+
+size_t Screen::lineSerialEnd() const
+{
+    auto serial = savedLines_.firstSerial() + savedLines_.size();
+    for (int row = 1; row <= size_.height; ++row)
+        if (startsLogicalLine(row))
+            ++serial;
+    return serial;
+}
+
+string_view Screen::lineText(size_t _serial, string& _buffer) const
+{
+    auto const historyEnd = savedLines_.firstSerial() + savedLines_.size();
+
+    int row = 1;
+    if (_serial < historyEnd)
+    {
+        auto const text = savedLines_.text(_serial - savedLines_.firstSerial(), _buffer);
+        if (_serial + 1 != historyEnd || startsLogicalLine(1))
+            return text;
+
+        // The most recent history line is continued by the first rows of the current buffer.
+        if (text.data() != _buffer.data())
+            _buffer.assign(text);
+    }
+    else if (auto const firstRow = firstRowOfLine(_serial); firstRow.has_value())
+    {
+        _buffer.clear();
+        row = *firstRow;
+        next(begin(lines()), row - 1)->appendText(_buffer, static_cast<size_t>(size_.width));
+        ++row;
+    }
+    else
+        return {};
+
+    for (; row <= size_.height && !startsLogicalLine(row); ++row)
+        next(begin(lines()), row - 1)->appendText(_buffer, static_cast<size_t>(size_.width));
+
+    auto const length = _buffer.find_last_not_of(' ');
+    _buffer.resize(length == string::npos ? 0 : length + 1);
+    return _buffer;
+}
+
+void Screen::exportLines(size_t _serial, size_t _count, ExportFormat _format, string& _output) const
+{
+    auto const from = max(_serial, savedLines_.firstSerial());
+    auto const to = min(_serial + _count, lineSerialEnd());
+
+    if (_format == ExportFormat::Text)
+    {
+        auto buffer = string{};
+        for (auto serial = from; serial < to; ++serial)
+        {
+            _output += lineText(serial, buffer);
+            _output += '\n';
+        }
+        return;
+    }
+
+    auto const historyEnd = savedLines_.firstSerial() + savedLines_.size();
+    auto writer = VTWriter([&](char const* _data, size_t _size) { _output.append(_data, _size); });
+    auto cells = vector<Cell const*>{};
+    auto const appendCells = [&](Line const& _line, size_t _length) {
+        for (size_t i = 0; i < min(_length, _line.size()); ++i)
+            cells.push_back(&_line[i]);
+    };
+
+    for (auto serial = from; serial < to; ++serial)
+    {
+        // Gathers the cells of the logical line, which may continue from the history into the buffer.
+        cells.clear();
+        int row = size_.height + 1;
+        if (serial < historyEnd)
+        {
+            Line const& line = savedLines_.at(serial - savedLines_.firstSerial());
+            appendCells(line, line.size());
+            if (serial + 1 == historyEnd && !startsLogicalLine(1))
+                row = 1;
+        }
+        else if (auto const firstRow = firstRowOfLine(serial); firstRow.has_value())
+        {
+            appendCells(*next(begin(lines()), *firstRow - 1), static_cast<size_t>(size_.width));
+            row = *firstRow + 1;
+        }
+        for (; row <= size_.height && !startsLogicalLine(row); ++row)
+            appendCells(*next(begin(lines()), row - 1), static_cast<size_t>(size_.width));
+
+        auto length = cells.size();
+        while (length != 0 && cells[length - 1]->empty()
+                && cells[length - 1]->attributesId() == GraphicsAttributesTable::DefaultId)
+            --length;
+
+        auto attributes = GraphicsAttributes{};
+        int covered = 0;
+        for (size_t i = 0; i < length; ++i)
+        {
+            Cell const& cell = *cells[i];
+            if (covered > 0)
+            {
+                --covered;
+                continue;
+            }
+
+            if (cell.attributes() != attributes)
+            {
+                attributes = cell.attributes();
+                setGraphicsAttributes(writer, attributes);
+            }
+
+            if (cell.empty())
+                _output += ' ';
+            else
+                for (char32_t const codepoint : cell.codepoints())
+                {
+                    uint8_t bytes[4];
+                    auto const count = unicode::to_utf8(codepoint, bytes);
+                    _output.append(reinterpret_cast<char const*>(bytes), count);
+                }
+            covered = cell.width() - 1;
+        }
+
+        if (attributes != GraphicsAttributes{})
+            _output += "\033[m";
+        _output += '\n';
+    }
+}
+
+optional<size_t> Screen::firstLineWithout(size_t _serial, crispy::trigram_filter const& _needle) const
+{
+    auto const first = savedLines_.firstSerial();
+    if (_serial < first || _serial >= first + savedLines_.size())
+        return nullopt;
+
+    if (auto const index = savedLines_.firstLineOfPageWithout(_serial - first, _needle); index.has_value())
+        return first + *index;
+
+    return nullopt;
+}
+
+optional<Coordinate> Screen::absoluteCoordinate(size_t _serial, int _column) const
+{
+    auto const first = savedLines_.firstSerial();
+    if (_serial < first)
+        return nullopt;
+
+    auto const rowOffset = _column / size_.width;
+    auto const column = _column % size_.width + 1;
+
+    if (_serial < first + savedLines_.size())
+    {
+        auto const row = static_cast<int>(savedLines_.firstRowOf(_serial - first));
+        return Coordinate{row + rowOffset + 1, column};
+    }
+
+    if (auto const row = firstRowOfLine(_serial); row.has_value())
+        return Coordinate{historyLineCount() + *row + rowOffset, column};
+
+    return nullopt;
+}
+// }}}
+
+// {{{ implicit hyperlinks
+void Screen::invalidateImplicitHyperlinks()
+{
+    auto const top = lineSerialOfRow(1);
+
+    if (!implicitHyperlinks_.empty())
+    {
+        // Lines scrolled off the top since the last lookup may have been modified before,
+        // and modifying a row may renumber all lines below.
+        auto const firstModified = implicitHyperlinksDamage_.has_value()
+                                 ? lineSerialOfRow(*implicitHyperlinksDamage_)
+                                 : lineSerialEnd();
+        for (auto i = implicitHyperlinks_.begin(); i != implicitHyperlinks_.end();)
+        {
+            auto const serial = i->first;
+            if (serial < savedLines_.firstSerial()
+                    || (implicitHyperlinksTop_ <= serial && serial < top)
+                    || firstModified <= serial)
+                i = implicitHyperlinks_.erase(i);
+            else
+                ++i;
+        }
+    }
+
+    implicitHyperlinksTop_ = top;
+    implicitHyperlinksDamage_.reset();
+}
+
+optional<Screen::ImplicitHyperlink> Screen::implicitHyperlinkAt(Coordinate const& _absolute)
+{
+    auto const historyRows = historyLineCount();
+    if (_absolute.row < 1 || _absolute.row > historyRows + size_.height
+            || _absolute.column < 1 || _absolute.column > size_.width)
+        return nullopt;
+
+    invalidateImplicitHyperlinks();
+
+    // Locates the logical line and the zero-based column within it.
+    auto serial = size_t{0};
+    auto column = _absolute.column - 1;
+    if (_absolute.row <= historyRows)
+    {
+        auto const [lineIndex, offset] = savedLines_.locateRow(static_cast<size_t>(_absolute.row - 1));
+        serial = savedLines_.firstSerial() + lineIndex;
+        column += static_cast<int>(offset);
+    }
+    else
+    {
+        auto const screenRow = _absolute.row - historyRows;
+        auto row = screenRow;
+        while (row > 1 && !startsLogicalLine(row))
+            --row;
+        column += (screenRow - row) * size_.width;
+        if (!startsLogicalLine(row))
+            column += static_cast<int>(savedLines_.rowCount() - savedLines_.firstRowOf(savedLines_.size() - 1)) * size_.width;
+        serial = lineSerialOfRow(row);
+    }
+
+    auto links = implicitHyperlinks_.find(serial);
+    if (links == implicitHyperlinks_.end())
+    {
+        auto buffer = string{};
+        auto detected = vector<ImplicitLink>{};
+        for (DetectedLink& link : detectLinks(lineText(serial, buffer)))
+        {
+            auto const hyperlink = addHyperlink(HyperlinkInfo{"", std::move(link.uri)});
+            detected.emplace_back(ImplicitLink{link.column, link.length, hyperlink});
+        }
+        links = implicitHyperlinks_.emplace(serial, std::move(detected)).first;
+    }
+
+    for (ImplicitLink const& link : links->second)
+    {
+        if (link.column <= column && column < link.column + link.length)
+        {
+            auto const from = absoluteCoordinate(serial, link.column);
+            auto const to = absoluteCoordinate(serial, link.column + link.length - 1);
+            if (from.has_value() && to.has_value())
+                return ImplicitHyperlink{link.hyperlink, *from, *to};
+        }
+    }
+
+    return nullopt;
+}
+// }}}
+
 optional<int> Screen::findMarkerBackward(int _currentCursorLine) const
 {
     if (_currentCursorLine < 0 || !isPrimaryScreen())
@@ -651,9 +2452,8 @@ optional<int> Screen::findMarkerBackward(int _currentCursorLine) const
             return {historyLineCount() + i};
 
     // saved lines
-    for (int i = min(_currentCursorLine, historyLineCount()) - 1; i >= 0; --i)
-        if (savedLines_.at(i).marked)
-            return {i};
+    if (auto const row = savedLines_.markedRowBefore(static_cast<size_t>(_currentCursorLine)); row.has_value())
+        return {static_cast<int>(*row)};
 
     return nullopt;
 }
@@ -663,17 +2463,125 @@ optional<int> Screen::findMarkerForward(int _currentCursorLine) const
     if (_currentCursorLine < 0 || !isPrimaryScreen())
         return nullopt;
 
-    for (int i = _currentCursorLine + 1; i < historyLineCount(); ++i)
-        if (savedLines_.at(i).marked)
-            return {i};
+    if (auto const row = savedLines_.markedRowAfter(static_cast<size_t>(_currentCursorLine)); row.has_value())
+        return {static_cast<int>(*row)};
 
     for (int i = _currentCursorLine < historyLineCount()
             ? 0 : _currentCursorLine - historyLineCount() + 1; i < size_.height; ++i)
         if (lines().at(i).marked)
             return {historyLineCount() + i};
 
-    return nullopt;
+    return nullopt;
+}
+
+// {{{ output folding
+optional<size_t> Screen::markedLineAt(int _absoluteRow) const
+{
+    if (_absoluteRow < 0 || _absoluteRow >= historyLineCount() || !isPrimaryScreen())
+        return nullopt;
+
+    auto const row = savedLines_.markedRowBefore(static_cast<size_t>(_absoluteRow) + 1);
+    if (!row.has_value())
+        return nullopt;
+
+    return savedLines_.firstSerial() + savedLines_.locateRow(*row).first;
+}
+
+bool Screen::foldOutput(int _absoluteRow)
+{
+    auto const mark = markedLineAt(_absoluteRow);
+    if (!mark.has_value())
+        return false;
+
+    // Folds up to the next marked line, or all of the history if the output is still going on.
+    auto const first = savedLines_.firstSerial();
+    auto to = first + savedLines_.size();
+    if (auto const next = savedLines_.markedRowAfter(savedLines_.firstRowOf(*mark - first)); next.has_value())
+        to = first + savedLines_.locateRow(*next).first;
+
+    if (to <= *mark + 1)
+        return false;
+
+    // Drops the folds of lines no longer in the history.
+    while (!folds_.empty() && folds_.begin()->second <= first)
+        folds_.erase(folds_.begin());
+
+    folds_[*mark + 1] = to;
+    ++foldChanges_;
+    return true;
+}
+
+bool Screen::unfoldOutput(int _absoluteRow)
+{
+    auto const mark = markedLineAt(_absoluteRow);
+    if (!mark.has_value() || folds_.erase(*mark + 1) == 0)
+        return false;
+
+    ++foldChanges_;
+    return true;
+}
+
+bool Screen::toggleFold(int _absoluteRow)
+{
+    return unfoldOutput(_absoluteRow) || foldOutput(_absoluteRow);
+}
+
+int Screen::foldedRowCount() const
+{
+    auto count = 0;
+    forEachFoldedRows([&](int _from, int _to) { count += _to - _from; return true; });
+    return count;
+}
+
+int Screen::absoluteRowOf(int _visibleRow) const
+{
+    auto row = _visibleRow;
+    forEachFoldedRows([&](int _from, int _to) {
+        if (_from > row)
+            return false;
+        row += _to - _from;
+        return true;
+    });
+    return row;
+}
+
+int Screen::visibleRowOf(int _absoluteRow) const
+{
+    auto hidden = 0;
+    forEachFoldedRows([&](int _from, int _to) {
+        if (_from >= _absoluteRow)
+            return false;
+        hidden += min(_to, _absoluteRow) - _from;
+        return true;
+    });
+    return _absoluteRow - hidden;
+}
+
+int Screen::unfoldedRowFrom(int _absoluteRow) const
+{
+    auto row = _absoluteRow;
+    forEachFoldedRows([&](int _from, int _to) {
+        if (_from > row)
+            return false;
+        row = max(row, _to);
+        return true;
+    });
+    return row;
+}
+
+optional<size_t> Screen::foldStart(size_t _serial) const
+{
+    auto i = folds_.upper_bound(_serial);
+    if (i == folds_.begin())
+        return nullopt;
+
+    --i;
+    if (_serial >= i->second || _serial >= savedLines_.firstSerial() + savedLines_.size())
+        return nullopt;
+
+    return max(i->first, savedLines_.firstSerial());
 }
+// }}}
 
 // {{{ tabs related
 void Screen::clearAllTabs()
@@ -696,8 +2604,10 @@ void Screen::clearTabUnderCursor()
 
 void Screen::setTabUnderCursor()
 {
-    tabs_.emplace_back(realCursorPosition().column);
-    sort(begin(tabs_), end(tabs_));
+    // Tab stops are kept sorted and unique, such that repeatedly setting one does not grow them.
+    auto const column = realCursorPosition().column;
+    if (auto const i = lower_bound(begin(tabs_), end(tabs_), column); i == end(tabs_) || *i != column)
+        tabs_.insert(i, column);
 }
 // }}}
 
@@ -754,6 +2664,8 @@ void Screen::resetHard()
 
     lines_ = emptyBuffers(size_);
     activeBuffer_ = &primaryBuffer();
+    damagedLines_.assign(static_cast<size_t>(size_.height), false);
+    damageScreen();
     moveCursorTo(Coordinate{1, 1});
 
     lastColumn_ = currentColumn_;
@@ -765,6 +2677,7 @@ void Screen::resetHard()
     };
 
     currentHyperlink_ = {};
+    implicitHyperlinks_.clear();
 }
 
 void Screen::moveCursorTo(Coordinate to)
@@ -774,6 +2687,37 @@ void Screen::moveCursorTo(Coordinate to)
     updateCursorIterators();
 }
 
+void Screen::allocateAlternateBuffer()
+{
+    auto& buffer = alternateBuffer();
+    auto const width = static_cast<size_t>(size_.width);
+    auto const height = static_cast<size_t>(size_.height);
+    if (buffer.size() == 0)
+    {
+        buffer = Lines(height, Line(width, Cell{}));
+        return;
+    }
+
+    // Resized while not in use, which is cutting or adding lines at the bottom, as there is no
+    // cursor to keep in view.
+    while (buffer.size() > height)
+        buffer.pop_back();
+    while (buffer.size() < height)
+        buffer.emplace_back(width, Cell{});
+    for (Line& line : buffer)
+        if (line.size() < width)
+            line.resize(width);
+}
+
+bool Screen::releaseAlternateBuffer()
+{
+    if (!isPrimaryScreen() || alternateBuffer().size() == 0)
+        return false;
+
+    alternateBuffer() = Lines{};
+    return true;
+}
+
 void Screen::setBuffer(ScreenType _type)
 {
     if (bufferType() != _type)
@@ -789,15 +2733,28 @@ void Screen::setBuffer(ScreenType _type)
                     eventListener_.setMouseWheelMode(InputGenerator::MouseWheelMode::ApplicationCursorKeys);
                 else
                     eventListener_.setMouseWheelMode(InputGenerator::MouseWheelMode::NormalCursorKeys);
+                allocateAlternateBuffer();
                 activeBuffer_ = &alternateBuffer();
                 break;
         }
         screenType_ = _type;
+        updateCursorIterators();
+        damageScreen();
+        implicitHyperlinks_.clear();
 
         eventListener_.bufferChanged(_type);
     }
 }
 
+void Screen::wrapLine()
+{
+    linefeed(margin_.horizontal.from);
+
+    // Only full-width lines are soft-wrapped, wrapping within left/right margins is not.
+    if (!isModeEnabled(Mode::LeftRightMargin))
+        currentLine_->wrapped = true;
+}
+
 void Screen::linefeed(int _newColumn)
 {
     wrapPending_ = 0;
@@ -822,6 +2779,13 @@ void Screen::linefeed(int _newColumn)
 
 void Screen::scrollUp(int v_n, Margin const& margin)
 {
+    CRISPY_TRACE_ZONE("Screen::scrollUp");
+
+    if (margin.horizontal == Margin::Range{1, size_.width} && margin.vertical == Margin::Range{1, size_.height})
+        damageScroll(min(v_n, size_.height));
+    else
+        damageLines(margin.vertical.from, margin.vertical.to);
+
     if (margin.horizontal != Margin::Range{1, size_.width})
     {
         // a full "inside" scroll-up
@@ -834,13 +2798,11 @@ void Screen::scrollUp(int v_n, Margin const& margin)
             auto sourceLine = next(begin(lines()), margin.vertical.from - 1 + n); // source line
             auto const bottomLine = next(begin(lines()), margin.vertical.to);     // bottom margin's end-line iterator
 
+            // Cells are moved rather than copied, as the source cells get cleared anyway.
             for (; sourceLine != bottomLine; ++sourceLine, ++targetLine)
             {
-                copy_n(
-                    next(begin(*sourceLine), margin.horizontal.from - 1),
-                    margin.horizontal.length(),
-                    next(begin(*targetLine), margin.horizontal.from - 1)
-                );
+                auto const source = next(begin(*sourceLine), margin.horizontal.from - 1);
+                std::move(source, next(source, margin.horizontal.length()), next(begin(*targetLine), margin.horizontal.from - 1));
             }
         }
 
@@ -883,24 +2845,18 @@ void Screen::scrollUp(int v_n, Margin const& margin)
                     crispy::times(n),
                     [&](auto) {
                         savedLines_.emplace_back(std::move(lines().front()));
-                        lines().pop_front();
+                        clampSavedLines();
+                        // Reuse the storage of dropped or packed history lines for the new bottom line.
+                        lines().front() = savedLines_.spareLine();
+                        lines().rotate_left(1);
                     }
                 );
-                clampSavedLines();
             }
             else
-            {
-                crispy::for_each(
-                    crispy::times(n),
-                    [&](auto) { lines().pop_front(); }
-                );
-            }
+                lines().rotate_left(static_cast<size_t>(n));
 
-            generate_n(
-                back_inserter(lines()),
-                n,
-                [this]() { return Line{static_cast<size_t>(size_.width), Cell{{}, cursor_.graphicsRendition}}; }
-            );
+            for (Line& line : crispy::range(next(begin(lines()), size_.height - n), end(lines())))
+                line.reset(static_cast<size_t>(size_.width), Cell{{}, cursor_.graphicsRendition});
         }
     }
     else
@@ -908,23 +2864,14 @@ void Screen::scrollUp(int v_n, Margin const& margin)
         // scroll up only inside vertical margin with full horizontal extend
         auto const marginHeight = margin.vertical.length();
         auto const n = min(v_n, marginHeight);
-        if (n < marginHeight)
-        {
-            rotate(
-                next(begin(lines()), margin.vertical.from - 1),
-                next(begin(lines()), margin.vertical.from - 1 + n),
-                next(begin(lines()), margin.vertical.to)
-            );
-        }
-
-        for_each(
-            LIBTERMINAL_EXECUTION_COMMA(par)
-            next(begin(lines()), margin.vertical.to - n),
-            next(begin(lines()), margin.vertical.to),
-            [&](Line& line) {
-                fill(begin(line), end(line), Cell{{}, cursor_.graphicsRendition});
-            }
+        lines().rotate_left(
+            static_cast<size_t>(margin.vertical.from - 1),
+            static_cast<size_t>(margin.vertical.to),
+            static_cast<size_t>(n)
         );
+
+        for (Line& line : crispy::range(next(begin(lines()), margin.vertical.to - n), next(begin(lines()), margin.vertical.to)))
+            line.reset(static_cast<size_t>(size_.width), Cell{{}, cursor_.graphicsRendition});
     }
 
     updateCursorIterators();
@@ -932,6 +2879,8 @@ void Screen::scrollUp(int v_n, Margin const& margin)
 
 void Screen::scrollDown(int v_n, Margin const& _margin)
 {
+    damageLines(_margin.vertical.from, _margin.vertical.to);
+
     auto const marginHeight = _margin.vertical.length();
     auto const n = min(v_n, marginHeight);
 
@@ -942,25 +2891,15 @@ void Screen::scrollDown(int v_n, Margin const& _margin)
         {
             auto sourceLine = next(begin(lines()), _margin.vertical.to - n - 1);
             auto targetLine = next(begin(lines()), _margin.vertical.to - 1);
-            auto const sourceEndLine = next(begin(lines()), _margin.vertical.from - 1);
+            auto const sourceEndLine = prev(next(begin(lines()), _margin.vertical.from - 1));
 
-            while (sourceLine != sourceEndLine)
+            // Cells are moved rather than copied, as the source cells get cleared anyway.
+            for (; sourceLine != sourceEndLine; --sourceLine, --targetLine)
             {
-                copy_n(
-                    next(begin(*sourceLine), _margin.horizontal.from - 1),
-                    _margin.horizontal.length(),
-                    next(begin(*targetLine), _margin.horizontal.from - 1)
-                );
-                --targetLine;
-                --sourceLine;
+                auto const source = next(begin(*sourceLine), _margin.horizontal.from - 1);
+                std::move(source, next(source, _margin.horizontal.length()), next(begin(*targetLine), _margin.horizontal.from - 1));
             }
 
-            copy_n(
-                next(begin(*sourceLine), _margin.horizontal.from - 1),
-                _margin.horizontal.length(),
-                next(begin(*targetLine), _margin.horizontal.from - 1)
-            );
-
             for_each(
                 next(begin(lines()), _margin.vertical.from - 1),
                 next(begin(lines()), _margin.vertical.from - 1 + n),
@@ -991,44 +2930,22 @@ void Screen::scrollDown(int v_n, Margin const& _margin)
     }
     else if (_margin.vertical == Margin::Range{1, size_.height})
     {
-        rotate(
-            begin(lines()),
-            next(begin(lines()), marginHeight - n),
-            end(lines())
-        );
+        lines().rotate_right(static_cast<size_t>(n));
 
-        for_each(
-            begin(lines()),
-            next(begin(lines()), n),
-            [this](Line& line) {
-                fill(
-                    begin(line),
-                    end(line),
-                    Cell{{}, cursor_.graphicsRendition}
-                );
-            }
-        );
+        for (Line& line : crispy::range(begin(lines()), next(begin(lines()), n)))
+            line.reset(static_cast<size_t>(size_.width), Cell{{}, cursor_.graphicsRendition});
     }
     else
     {
         // scroll down only inside vertical margin with full horizontal extend
-        rotate(
-            next(begin(lines()), _margin.vertical.from - 1),
-            next(begin(lines()), _margin.vertical.to - n),
-            next(begin(lines()), _margin.vertical.to)
+        lines().rotate_right(
+            static_cast<size_t>(_margin.vertical.from - 1),
+            static_cast<size_t>(_margin.vertical.to),
+            static_cast<size_t>(n)
         );
 
-        for_each(
-            next(begin(lines()), _margin.vertical.from - 1),
-            next(begin(lines()), _margin.vertical.from - 1 + n),
-            [this](Line& line) {
-                fill(
-                    begin(line),
-                    end(line),
-                    Cell{{}, cursor_.graphicsRendition}
-                );
-            }
-        );
+        for (Line& line : crispy::range(next(begin(lines()), _margin.vertical.from - 1), next(begin(lines()), _margin.vertical.from - 1 + n)))
+            line.reset(static_cast<size_t>(size_.width), Cell{{}, cursor_.graphicsRendition});
     }
 
     updateCursorIterators();
@@ -1055,6 +2972,45 @@ string Screen::renderTextLine(int row) const
     return line;
 }
 
+void Screen::appendRowText(int _absoluteRow, int _fromColumn, int _toColumn, string& _output) const
+{
+    auto const row = _absoluteRow - historyLineCount();
+    if (row > size_.height || _fromColumn > _toColumn)
+        return;
+
+    // Rows of the history are located within their (possibly longer) logical line.
+    auto const [line, offset] = [&]() -> pair<Line const*, size_t> {
+        if (row > 0)
+            return {&*next(begin(lines()), row - 1), 0};
+        auto const [lineIndex, offset] = savedLines_.locateRow(static_cast<size_t>(historyLineCount() - 1 + row));
+        return {&savedLines_.at(lineIndex), offset};
+    }();
+
+    auto const& cells = line->cells();
+    auto const first = min(offset + static_cast<size_t>(_fromColumn - 1), cells.size());
+    auto const last = min(offset + static_cast<size_t>(_toColumn), cells.size());
+    for (Cell const& cell : crispy::range(next(cells.begin(), static_cast<std::ptrdiff_t>(first)),
+                                          next(cells.begin(), static_cast<std::ptrdiff_t>(last))))
+    {
+        for (char32_t const codepoint : cell.codepoints())
+        {
+            uint8_t bytes[4];
+            auto const count = unicode::to_utf8(codepoint, bytes);
+            _output.append(reinterpret_cast<char const*>(bytes), count);
+        }
+    }
+}
+
+bool Screen::continuesLine(int _absoluteRow) const
+{
+    auto const row = _absoluteRow - historyLineCount();
+    if (row > size_.height || _absoluteRow < 1)
+        return false;
+    if (row > 0)
+        return !startsLogicalLine(row);
+    return savedLines_.locateRow(static_cast<size_t>(_absoluteRow - 1)).second != 0;
+}
+
 string Screen::renderText() const
 {
     string text;
@@ -1077,6 +3033,9 @@ void Screen::linefeed()
         linefeed(margin_.horizontal.from);
     else
         linefeed(realCursorPosition().column);
+
+    // An explicit line feed ends the logical line.
+    currentLine_->wrapped = false;
 }
 
 void Screen::backspace()
@@ -1168,32 +3127,24 @@ void Screen::sendTerminalId()
 void Screen::clearToEndOfScreen()
 {
     if (isAlternateScreen() && cursor_.position.row == 1 && cursor_.position.column == 1)
-        hyperlinks_.clear();
+        hyperlinkIds_.clear();
 
     clearToEndOfLine();
 
-    for_each(
-        LIBTERMINAL_EXECUTION_COMMA(par)
-        next(currentLine_),
-        end(lines()),
-        [&](Line& line) {
-            fill(begin(line), end(line), Cell{{}, cursor_.graphicsRendition});
-        }
-    );
+    auto const blankCell = Cell{{}, cursor_.graphicsRendition};
+    for (Line& line : crispy::range(next(currentLine_), end(lines())))
+        line.clear(blankCell);
+    damageLines(cursor_.position.row, size_.height);
 }
 
 void Screen::clearToBeginOfScreen()
 {
     clearToBeginOfLine();
 
-    for_each(
-        LIBTERMINAL_EXECUTION_COMMA(par)
-        begin(lines()),
-        currentLine_,
-        [&](Line& line) {
-            fill(begin(line), end(line), Cell{{}, cursor_.graphicsRendition});
-        }
-    );
+    auto const blankCell = Cell{{}, cursor_.graphicsRendition};
+    for (Line& line : crispy::range(begin(lines()), currentLine_))
+        line.clear(blankCell);
+    damageLines(1, cursor_.position.row);
 }
 
 void Screen::clearScreen()
@@ -1207,6 +3158,8 @@ void Screen::clearScreen()
 void Screen::clearScrollbackBuffer()
 {
     savedLines_.clear();
+    openedHistoryRowCount_ = 0;
+    unfoldAll();
     eventListener_.scrollbackBufferCleared();
 }
 
@@ -1217,6 +3170,7 @@ void Screen::eraseCharacters(int _n)
     // TODO: See what xterm does ;-)
     size_t const n = min(size_.width - realCursorPosition().column + 1, _n == 0 ? 1 : _n);
     fill_n(currentColumn_, n, Cell{{}, cursor_.graphicsRendition});
+    damageLine(cursor_.position.row);
 }
 
 void Screen::clearToEndOfLine()
@@ -1226,6 +3180,7 @@ void Screen::clearToEndOfLine()
         end(*currentLine_),
         Cell{{}, cursor_.graphicsRendition}
     );
+    damageLine(cursor_.position.row);
 }
 
 void Screen::clearToBeginOfLine()
@@ -1235,6 +3190,7 @@ void Screen::clearToBeginOfLine()
         next(currentColumn_),
         Cell{{}, cursor_.graphicsRendition}
     );
+    damageLine(cursor_.position.row);
 }
 
 void Screen::clearLine()
@@ -1244,6 +3200,7 @@ void Screen::clearLine()
         end(*currentLine_),
         Cell{{}, cursor_.graphicsRendition}
     );
+    damageLine(cursor_.position.row);
 }
 
 void Screen::moveCursorToNextLine(int _n)
@@ -1273,7 +3230,10 @@ void Screen::insertChars(int _lineNo, int _n)
     auto column1 = next(begin(*line), margin_.horizontal.to - n);
     auto column2 = next(begin(*line), margin_.horizontal.to);
 
-    rotate(
+    // The cells shifted out at the right margin are dropped rather than rotated back in,
+    // as the vacated cells are overwritten below anyway. Moving a cell merely moves its
+    // out-of-line record's pointer, if any.
+    std::move_backward(
         column0,
         column1,
         column2
@@ -1287,6 +3247,7 @@ void Screen::insertChars(int _lineNo, int _n)
         n,
         Cell{L' ', cursor_.graphicsRendition}
     );
+    damageLine(_lineNo);
 }
 
 void Screen::insertLines(int _n)
@@ -1337,10 +3298,11 @@ void Screen::deleteChars(int _lineNo, int _n)
     auto rightMargin = next(begin(*line), margin_.horizontal.to);
     auto const n = min(_n, static_cast<int>(distance(column, rightMargin)));
 
-    rotate(
-        column,
+    // Like insertChars(), the deleted cells are dropped rather than rotated to the right margin.
+    std::move(
         next(column, n),
-        rightMargin
+        rightMargin,
+        column
     );
 
     updateCursorIterators();
@@ -1352,6 +3314,7 @@ void Screen::deleteChars(int _lineNo, int _n)
         rightMargin,
         Cell{L' ', cursor_.graphicsRendition}
     );
+    damageLine(_lineNo);
 }
 void Screen::deleteColumns(int _n)
 {
@@ -1381,22 +3344,60 @@ void Screen::horizontalTabSet()
 void Screen::hyperlink(string const& _id, string const& _uri)
 {
     if (_uri.empty())
-        currentHyperlink_ = nullptr;
+        currentHyperlink_ = 0;
     else if (_id.empty())
-        currentHyperlink_ = make_shared<HyperlinkInfo>(HyperlinkInfo{_id, _uri});
-    else if (auto i = hyperlinks_.find(_id); i != hyperlinks_.end())
+        currentHyperlink_ = addHyperlink(HyperlinkInfo{_id, _uri});
+    else if (auto i = hyperlinkIds_.find(_id); i != hyperlinkIds_.end())
         currentHyperlink_ = i->second;
     else
     {
-        currentHyperlink_ = make_shared<HyperlinkInfo>(HyperlinkInfo{_id, _uri});
-        hyperlinks_[_id] = currentHyperlink_;
+        currentHyperlink_ = addHyperlink(HyperlinkInfo{_id, _uri});
+        hyperlinkIds_[_id] = currentHyperlink_;
     }
     // TODO:
-    // Care about eviction.
     // Move hyperlink store into ScreenBuffer, so it gets reset upon every switch into
     // alternate screen (not for main screen!)
 }
 
+HyperlinkId Screen::addHyperlink(HyperlinkInfo _hyperlink)
+{
+    if (hyperlinks_.size() >= hyperlinkCollectionSize_)
+    {
+        collectHyperlinks();
+        hyperlinkCollectionSize_ = max(MinHyperlinkCollectionSize, 2 * hyperlinks_.size());
+    }
+    return hyperlinks_.add(std::move(_hyperlink));
+}
+
+void Screen::collectHyperlinks()
+{
+    auto used = vector<bool>(hyperlinks_.idEnd(), false);
+    auto const mark = [&](HyperlinkId _id) {
+        if (_id < used.size())
+            used[_id] = true;
+    };
+
+    for (Lines const& lines : lines_)
+        for (Line const& line : lines)
+            markHyperlinks(line, used);
+    savedLines_.markHyperlinks(used);
+    mark(currentHyperlink_);
+    for (auto const& [_, links] : implicitHyperlinks_)
+        for (ImplicitLink const& link : links)
+            mark(link.hyperlink);
+
+    hyperlinks_.collect(used);
+
+    // Released hyperlinks are not continued by OSC 8 anymore.
+    for (auto i = hyperlinkIds_.begin(); i != hyperlinkIds_.end();)
+    {
+        if (!hyperlinks_.get(i->second))
+            i = hyperlinkIds_.erase(i);
+        else
+            ++i;
+    }
+}
+
 void Screen::moveCursorUp(int _n)
 {
     auto const n = min(
@@ -1519,8 +3520,9 @@ void Screen::notify(string const& _title, string const& _content)
 
 void Screen::cursorForwardTab(int _count)
 {
-    printf("CHT: %d\n", _count);
-    for (int i = 0; i < _count; ++i)
+    // Steps are bounded by the screen width, as the time taken is proportional to their number,
+    // and tabbing across more than a full line is not meaningful anyway.
+    for (int i = 0; i < min(_count, size_.width); ++i)
         moveCursorToNextTab();
 }
 
@@ -1531,7 +3533,9 @@ void Screen::cursorBackwardTab(int _count)
 
     if (!tabs_.empty())
     {
-        for (int k = 0; k < _count; ++k)
+        // Each step moves to a tab stop left of the cursor, or finally to the left margin, so there
+        // is at most one more step than tab stops.
+        for (int k = 0; k < min(_count, static_cast<int>(tabs_.size()) + 1); ++k)
         {
             auto const i = std::find_if(rbegin(tabs_), rend(tabs_),
                                         [&](auto tabPos) -> bool {
@@ -1712,25 +3716,18 @@ void Screen::setMark()
 
 void Screen::saveModes(std::vector<Mode> const& _modes)
 {
+    vector<Mode> decModes;
     for (Mode const mode : _modes)
         if (!isAnsiMode(mode))
-            savedModes_[mode].push_back(isModeEnabled(mode));
+            decModes.push_back(mode);
+    modes_.save(decModes);
 }
 
 void Screen::restoreModes(std::vector<Mode> const& _modes)
 {
     for (Mode const mode : _modes)
-    {
-        if (auto i = savedModes_.find(mode); i != savedModes_.end())
-        {
-            vector<bool>& saved = i->second;
-            if (!saved.empty())
-            {
-                setMode(mode, saved.back());
-                saved.pop_back();
-            }
-        }
-    }
+        if (auto const enabled = modes_.restore(mode); enabled.has_value())
+            setMode(mode, *enabled);
 }
 
 void Screen::setMode(Mode _mode, bool _enable)
@@ -1761,8 +3758,8 @@ void Screen::setMode(Mode _mode, bool _enable)
             }
             break;
         case Mode::BatchedRendering:
-            // Only perform batched rendering when NOT in debugging mode.
-            // TODO: also, do I still need this here?
+            if (_enable != isModeEnabled(_mode))
+                eventListener_.setSynchronizedOutput(_enable);
             break;
         case Mode::UseAlternateScreen:
             if (_enable)
@@ -1804,6 +3801,10 @@ void Screen::setMode(Mode _mode, bool _enable)
         case Mode::FocusTracking:
             eventListener_.setGenerateFocusEvents(_enable);
             break;
+        case Mode::ReverseVideo:
+            if (_enable != isModeEnabled(_mode))
+                damageScreen();
+            break;
         case Mode::UsePrivateColorRegisters:
             sequencer_.setUsePrivateColorRegisters(_enable);
             break;
@@ -1930,6 +3931,7 @@ void Screen::screenAlignmentPattern()
             );
         }
     );
+    damageScreen();
 }
 
 void Screen::sendMouseEvents(MouseProtocol _protocol, bool _enable)
@@ -1957,9 +3959,7 @@ void Screen::singleShiftSelect(CharsetTable _table)
 
 void Screen::sixelImage(Size _pixelSize, Image::Data&& _data)
 {
-    auto const columnCount = int(ceilf(float(_pixelSize.width) / float(cellPixelSize_.width)));
-    auto const rowCount = int(ceilf(float(_pixelSize.height) / float(cellPixelSize_.height)));
-    auto const extent = Size{columnCount, rowCount};
+    auto const extent = gridSizeOf(_pixelSize);
     auto const sixelScrolling = isModeEnabled(Mode::SixelScrolling);
     auto const topLeft = sixelScrolling ? cursorPosition() : Coordinate{1, 1};
 
@@ -1978,9 +3978,128 @@ void Screen::sixelImage(Size _pixelSize, Image::Data&& _data)
         linefeed(topLeft.column);
 }
 
+void Screen::sixelImagePreview(Size _pixelSize, Image::Data&& _data)
+{
+    auto const extent = gridSizeOf(_pixelSize);
+    auto const topLeft = isModeEnabled(Mode::SixelScrolling) ? cursorPosition() : Coordinate{1, 1};
+    auto const linesToBeRendered = min(extent.height, 1 + size_.height - topLeft.row);
+    auto const columnsToBeRendered = min(extent.width, size_.width - topLeft.column - 1);
+    if (linesToBeRendered <= 0 || columnsToBeRendered <= 0)
+        return;
+
+    auto const imageRef = uploadImage(ImageFormat::RGBA, _pixelSize, move(_data));
+    if (!imageRef)
+        return;
+
+    auto const rasterizedImage = imagePool_.rasterize(
+        imageRef,
+        ImageAlignment::TopStart,
+        ImageResize::NoResize,
+        RGBAColor{},
+        extent,
+        cellPixelSize_
+    );
+
+    crispy::for_each(
+        LIBTERMINAL_EXECUTION_COMMA(par)
+        Size{columnsToBeRendered, linesToBeRendered},
+        [&](Coordinate const& offset) {
+            at(topLeft + offset).setImage(
+                ImageFragment{rasterizedImage, offset},
+                currentHyperlink_
+            );
+        }
+    );
+    damageLines(topLeft.row, topLeft.row + linesToBeRendered - 1);
+}
+
+Size Screen::gridSizeOf(Size _pixelSize) const noexcept
+{
+    auto const columnCount = int(ceilf(float(_pixelSize.width) / float(cellPixelSize_.width)));
+    auto const rowCount = int(ceilf(float(_pixelSize.height) / float(cellPixelSize_.height)));
+    return Size{columnCount, rowCount};
+}
+
 std::shared_ptr<Image const> Screen::uploadImage(ImageFormat _format, Size _imageSize, Image::Data&& _pixmap)
 {
-    return imagePool_.create(_format, _imageSize, move(_pixmap));
+    CRISPY_ALLOCATION_SCOPE(image);
+    auto image = imagePool_.create(_format, _imageSize, move(_pixmap));
+    evictImages(*image);
+    return image;
+}
+
+void Screen::evictImages(Image const& _keep)
+{
+    if (!imagePool_.exceedsMemoryBudget())
+        return;
+
+    // Images on either screen buffer are in use, any others are only referenced from history.
+    auto inUse = std::set<Image::Id>{_keep.id()};
+    for (Lines const& buffer : lines_)
+        for (Line const& line : buffer)
+            for (Cell const& cell : line.cells())
+                if (auto const& fragment = cell.imageFragment(); fragment.has_value())
+                    inUse.insert(fragment->rasterizedImage().image().id());
+
+    imagePool_.evict([&](Image const& _image) { return inUse.count(_image.id()) != 0; });
+}
+
+void Screen::inlineImage(std::string&& _data, ImageExtent _width, ImageExtent _height, bool _preserveAspectRatio)
+{
+    auto const probe = probeImage(_data);
+    if (!probe.has_value() || !area(cellPixelSize_))
+        return;
+
+    auto const [format, naturalSize] = *probe;
+    if (!area(naturalSize))
+        return;
+
+    auto const resolve = [](ImageExtent _extent, int _cells, int _cellPixels) -> optional<double> {
+        switch (_extent.unit)
+        {
+            case ImageExtent::Unit::Auto: return nullopt;
+            case ImageExtent::Unit::Cells: return _extent.value * _cellPixels;
+            case ImageExtent::Unit::Pixels: return _extent.value;
+            case ImageExtent::Unit::Percent: return _cells * _cellPixels * _extent.value / 100.0;
+        }
+        return nullopt;
+    };
+    auto const width = resolve(_width, size_.width, cellPixelSize_.width);
+    auto const height = resolve(_height, size_.height, cellPixelSize_.height);
+    auto const naturalWidth = double(naturalSize.width);
+    auto const naturalHeight = double(naturalSize.height);
+
+    // Scales the image into the requested extent, and then into the maximum image size.
+    auto scaleX = width.value_or(naturalWidth) / naturalWidth;
+    auto scaleY = height.value_or(naturalHeight) / naturalHeight;
+    if (_preserveAspectRatio && (width || height))
+    {
+        auto const scale = min(width ? scaleX : scaleY, height ? scaleY : scaleX);
+        scaleX = scaleY = scale;
+    }
+    auto const maxSize = sequencer_.maxImageSize();
+    auto const limit = min({1.0, maxSize.width / (naturalWidth * scaleX), maxSize.height / (naturalHeight * scaleY)});
+    auto const pixelSize = Size{
+        max(1, int(naturalWidth * scaleX * limit)),
+        max(1, int(naturalHeight * scaleY * limit))
+    };
+
+    auto [image, pending] = imagePool_.createCompressed(format, pixelSize, _data);
+    if (pending)
+        eventListener_.decodeImage(image, move(_data));
+
+    auto const topLeft = cursorPosition();
+    renderImage(image, topLeft, gridSizeOf(pixelSize),
+                Coordinate{0, 0}, pixelSize,
+                ImageAlignment::TopStart, ImageResize::NoResize,
+                true);
+    linefeed(topLeft.column);
+}
+
+void Screen::provideImage(Image const& _image, Image::Data&& _data)
+{
+    imagePool_.provide(_image, move(_data));
+    evictImages(_image);
 }
 
 void Screen::renderImage(std::shared_ptr<Image const> const& _imageRef,
@@ -2019,6 +4138,7 @@ void Screen::renderImage(std::shared_ptr<Image const> const& _imageRef,
                 );
             }
         );
+        damageLines(_topLeft.row, _topLeft.row + linesToBeRendered - 1);
         moveCursorTo(Coordinate{_topLeft.row + linesToBeRendered - 1, _topLeft.column});
     }
 
@@ -2041,6 +4161,7 @@ void Screen::renderImage(std::shared_ptr<Image const> const& _imageRef,
                     );
                 }
             );
+            damageLine(size_.height);
         }
     }
 
@@ -2056,15 +4177,17 @@ void Screen::setWindowTitle(std::string const& _title)
 
 void Screen::saveWindowTitle()
 {
-    savedWindowTitles_.push(windowTitle_);
+    if (savedWindowTitles_.size() == MaxSavedWindowTitles)
+        savedWindowTitles_.pop_front();
+    savedWindowTitles_.push_back(windowTitle_);
 }
 
 void Screen::restoreWindowTitle()
 {
     if (!savedWindowTitles_.empty())
     {
-        windowTitle_ = savedWindowTitles_.top();
-        savedWindowTitles_.pop();
+        windowTitle_ = move(savedWindowTitles_.back());
+        savedWindowTitles_.pop_back();
         eventListener_.setWindowTitle(windowTitle_);
     }
 }
@@ -2187,6 +4310,289 @@ void Screen::dumpState()
     eventListener_.dumpState();
 }
 
+ScreenMemoryUsage Screen::memoryUsage() const
+{
+    auto usage = ScreenMemoryUsage{};
+
+    for (Lines const& lines : lines_)
+    {
+        for (Line const& line : lines)
+        {
+            usage.lines += sizeof(Line) + line.memoryUsage();
+            usage.cellExtras += line.extraMemoryUsage();
+        }
+    }
+
+    usage.history = savedLines_.memoryUsage();
+    usage.cellExtras += savedLines_.extraMemoryUsage();
+
+    usage.hyperlinks = hyperlinks_.memoryUsage() + hyperlinkIds_.size() * sizeof(pair<string const, HyperlinkId>);
+    for (auto const& [serial, links] : implicitHyperlinks_)
+        usage.hyperlinks += sizeof(serial) + sizeof(links) + links.capacity() * sizeof(ImplicitLink);
+
+    usage.attributes = GraphicsAttributesTable::size() * sizeof(GraphicsAttributes);
+    usage.images = imagePool_.memoryUsage();
+
+    return usage;
+}
+
+// {{{ snapshots
+void Screen::saveHistory(size_t _serial, size_t _count, PortableLines& _output) const
+{
+    auto const first = _serial - savedLines_.firstSerial();
+    for (size_t i = first; i < first + _count; ++i)
+        _output.append(savedLines_.at(i), hyperlinks_);
+}
+
+ScreenState Screen::saveState() const
+{
+    auto state = ScreenState{};
+    saveCursorAndModes(state);
+    for (Line const& line : lines_[0])
+        state.primaryLines.append(line, hyperlinks_);
+    for (Line const& line : lines_[1])
+        state.alternateLines.append(line, hyperlinks_);
+    return state;
+}
+
+void Screen::openHistory(crispy::span<uint8_t const> _output, std::shared_ptr<void const> _owner)
+{
+    clearScrollbackBuffer();
+    savedLines_.appendOutput(_output, std::move(_owner));
+
+    // Output following keeps the room it had, pushing out the oldest lines of the file then.
+    openedHistoryRowCount_ = savedLines_.rowCount();
+
+    // The serial numbers of the screen's lines have moved on.
+    implicitHyperlinks_.clear();
+    damageScreen();
+}
+
+void Screen::restore(vector<PortableLines> const& _history, size_t _skip, ScreenState const& _state)
+{
+    auto const size = size_;
+
+    // Restores at the size saved, being resized as usual afterwards.
+    size_ = Size{max(_state.size.width, 1), max(_state.size.height, 1)};
+    savedLines_.clear();
+    openedHistoryRowCount_ = 0;
+    savedLines_.setRowWidth(static_cast<size_t>(size_.width));
+    hyperlinks_.clear();
+    hyperlinkIds_.clear();
+    folds_.clear();
+    ++foldChanges_;
+    resetHard();
+
+    // Hyperlinks are added without collecting unused ones, as the lines referring to them
+    // are not part of the screen yet.
+    auto const addHyperlinks = [this](PortableLines const& _lines) {
+        auto ids = vector<HyperlinkId>{};
+        ids.reserve(_lines.hyperlinks.size());
+        for (auto const& [id, uri] : _lines.hyperlinks)
+            ids.push_back(hyperlinks_.add(HyperlinkInfo{id, uri}));
+        return ids;
+    };
+
+    for (PortableLines const& lines : _history)
+        savedLines_.append(lines, addHyperlinks(lines));
+    for (size_t i = 0; i < _skip && !savedLines_.empty(); ++i)
+        savedLines_.pop_front();
+    clampSavedLines();
+
+    auto const restoreLines = [&](Lines& _buffer, PortableLines const& _lines) {
+        auto lines = _lines.decode(addHyperlinks(_lines));
+        for (size_t row = 0; row < min(lines.size(), _buffer.size()); ++row)
+        {
+            lines[row].resize(static_cast<size_t>(size_.width));
+            _buffer[row] = std::move(lines[row]);
+        }
+    };
+    restoreLines(primaryBuffer(), _state.primaryLines);
+    if (_state.alternateLines.size() != 0)
+    {
+        allocateAlternateBuffer();
+        restoreLines(alternateBuffer(), _state.alternateLines);
+    }
+    hyperlinkCollectionSize_ = max(MinHyperlinkCollectionSize, 2 * hyperlinks_.size());
+
+    restoreCursorAndModes(_state);
+    damageScreen();
+    implicitHyperlinks_.clear();
+
+    if (size_ != size)
+        resize(size);
+}
+
+void Screen::saveCursorAndModes(ScreenState& _state) const
+{
+    _state.size = size_;
+    _state.screenType = screenType_;
+    _state.cursor = cursor_;
+    _state.savedCursor = savedCursor_;
+    _state.wrapPending = wrapPending_;
+    _state.margin = margin_;
+    _state.modes.resize(ModeCount);
+    for (size_t i = 0; i < ModeCount; ++i)
+        _state.modes[i] = modes_.enabled(static_cast<Mode>(i));
+    _state.tabWidth = tabWidth_;
+    _state.tabs = tabs_;
+    _state.windowTitle = windowTitle_;
+}
+
+void Screen::restoreCursorAndModes(ScreenState const& _state)
+{
+    for (size_t i = 0; i < ModeCount; ++i)
+    {
+        auto const mode = static_cast<Mode>(i);
+        auto const enabled = i < _state.modes.size() && _state.modes[i];
+        switch (mode)
+        {
+            case Mode::Columns132:
+            case Mode::SaveCursor:
+            case Mode::ExtendedAltScreen:
+            case Mode::UseAlternateScreen:
+                // Their effects on the buffers and cursors are restored along with those.
+                modes_.set(mode, enabled);
+                break;
+            default:
+                if (enabled != isModeEnabled(mode))
+                    setMode(mode, enabled);
+                break;
+        }
+    }
+    setBuffer(_state.screenType);
+
+    margin_.vertical.from = std::clamp(_state.margin.vertical.from, 1, size_.height);
+    margin_.vertical.to = std::clamp(_state.margin.vertical.to, margin_.vertical.from, size_.height);
+    margin_.horizontal.from = std::clamp(_state.margin.horizontal.from, 1, size_.width);
+    margin_.horizontal.to = std::clamp(_state.margin.horizontal.to, margin_.horizontal.from, size_.width);
+
+    auto const restoreCursor = [this](Cursor& _cursor, Cursor const& _saved) {
+        _cursor.position = clampToScreen(_saved.position);
+        _cursor.autoWrap = _saved.autoWrap;
+        _cursor.originMode = _saved.originMode;
+        _cursor.visible = _saved.visible;
+        _cursor.graphicsRendition = _saved.graphicsRendition;
+    };
+    restoreCursor(cursor_, _state.cursor);
+    restoreCursor(savedCursor_, _state.savedCursor);
+    wrapPending_ = _state.wrapPending;
+    updateCursorIterators();
+    lastColumn_ = currentColumn_;
+    lastCursorPosition_ = cursor_.position;
+
+    tabWidth_ = _state.tabWidth;
+    tabs_ = _state.tabs;
+    if (windowTitle_ != _state.windowTitle)
+    {
+        windowTitle_ = _state.windowTitle;
+        eventListener_.setWindowTitle(windowTitle_);
+    }
+}
+
+ScreenUpdate Screen::takeUpdate(size_t& _historySerialEnd, bool _full)
+{
+    auto update = makeUpdate(_historySerialEnd, _full);
+    clearDamage();
+    return update;
+}
+
+ScreenUpdate Screen::keyframe(size_t& _historySerialEnd) const
+{
+    return makeUpdate(_historySerialEnd, true);
+}
+
+ScreenUpdate Screen::makeUpdate(size_t& _historySerialEnd, bool _full) const
+{
+    auto update = ScreenUpdate{};
+
+    // Resends the most recent history line the viewer knows of, as it may have been continued
+    // since, unless all of the lines it knows of are gone.
+    auto const first = savedLines_.firstSerial();
+    auto const end = historySerialEnd();
+    auto const known = min(_historySerialEnd, end);
+    auto from = first;
+    if (_historySerialEnd <= first)
+        update.historyCleared = true;
+    else
+    {
+        from = known > first ? known - 1 : first;
+        update.historyDropped = _historySerialEnd - from;
+    }
+    saveHistory(from, end - from, update.history);
+    _historySerialEnd = end;
+
+    update.scrolledLines = _full ? 0 : scrolledLines_;
+    for (int row = 1; row <= size_.height; ++row)
+    {
+        if (_full || isLineDamaged(row))
+        {
+            update.rows.push_back(row);
+            update.lines.append((*activeBuffer_)[static_cast<size_t>(row - 1)], hyperlinks_);
+        }
+    }
+
+    saveCursorAndModes(update.state);
+    return update;
+}
+
+void Screen::applyUpdate(ScreenUpdate const& _update)
+{
+    // Hyperlinks are added without collecting unused ones, as the lines referring to them
+    // are not part of the screen yet.
+    auto const addHyperlinks = [this](PortableLines const& _lines) {
+        auto ids = vector<HyperlinkId>{};
+        ids.reserve(_lines.hyperlinks.size());
+        for (auto const& [id, uri] : _lines.hyperlinks)
+            ids.push_back(hyperlinks_.add(HyperlinkInfo{id, uri}));
+        return ids;
+    };
+
+    if (_update.historyCleared)
+        clearScrollbackBuffer();
+    for (size_t i = 0; i < _update.historyDropped && !savedLines_.empty(); ++i)
+        savedLines_.pop_back();
+    savedLines_.append(_update.history, addHyperlinks(_update.history));
+    clampSavedLines();
+
+    restoreCursorAndModes(_update.state);
+
+    auto& buffer = *activeBuffer_;
+    auto const height = static_cast<int>(buffer.size());
+    if (_update.scrolledLines >= height)
+        damageScreen();
+    else if (_update.scrolledLines > 0)
+    {
+        std::rotate(buffer.begin(), next(buffer.begin(), _update.scrolledLines), buffer.end());
+        damageScroll(_update.scrolledLines);
+    }
+
+    auto lines = _update.lines.decode(addHyperlinks(_update.lines));
+    for (size_t i = 0; i < min(lines.size(), _update.rows.size()); ++i)
+    {
+        auto const row = _update.rows[i];
+        if (row < 1 || row > height)
+            continue;
+
+        lines[i].resize(static_cast<size_t>(size_.width));
+        buffer[static_cast<size_t>(row - 1)] = std::move(lines[i]);
+        damageLine(row);
+    }
+
+    updateCursorIterators();
+    lastColumn_ = currentColumn_;
+    lastCursorPosition_ = cursor_.position;
+    implicitHyperlinks_.clear();
+    if (hyperlinks_.size() >= hyperlinkCollectionSize_)
+    {
+        collectHyperlinks();
+        hyperlinkCollectionSize_ = max(MinHyperlinkCollectionSize, 2 * hyperlinks_.size());
+    }
+
+    eventListener_.screenUpdated();
+}
+// }}}
+
 void Screen::dumpState(std::string const& _message) const
 {
     auto const hline = [&]() {
@@ -14,6 +14,7 @@
 #pragma once
 
 #include <terminal/Charset.h>
+#include <terminal/CodepointProperties.h>
 #include <terminal/Color.h>
 #include <terminal/Hyperlink.h>
 #include <terminal/Image.h>
@@ -26,27 +27,32 @@
 #include <terminal/Size.h>
 
 #include <crispy/algorithm.h>
+#include <crispy/ring.h>
+#include <crispy/span.h>
 #include <crispy/times.h>
+#include <crispy/trigram_filter.h>
 #include <crispy/utils.h>
 
 #include <unicode/grapheme_segmenter.h>
-#include <unicode/width.h>
 #include <unicode/utf8.h>
 
 #include <fmt/format.h>
 
 #include <algorithm>
+#include <array>
+#include <bitset>
+#include <cstdio>
 #include <deque>
 #include <functional>
 #include <list>
 #include <map>
 #include <memory>
 #include <optional>
-#include <set>
 #include <sstream>
-#include <stack>
 #include <string>
 #include <string_view>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
 namespace terminal {
@@ -59,20 +65,38 @@ class Modes {
   public:
     void set(Mode _mode, bool _enabled)
     {
-        if (_enabled)
-            enabled_.insert(_mode);
-        else if (auto i = enabled_.find(_mode); i != enabled_.end())
-            enabled_.erase(i);
+        enabled_[static_cast<size_t>(_mode)] = _enabled;
     }
 
     bool enabled(Mode _mode) const noexcept
     {
-        return enabled_.find(_mode) != enabled_.end();
+        return enabled_[static_cast<size_t>(_mode)];
+    }
+
+    /// Pushes the current state of each of the given modes onto its save stack (XTSAVE).
+    void save(std::vector<Mode> const& _modes)
+    {
+        for (Mode const mode : _modes)
+            saved_[static_cast<size_t>(mode)].push_back(enabled(mode));
+    }
+
+    /// Pops the most recently saved state of the given mode from its save stack (XTRESTORE).
+    ///
+    /// @returns the saved state or nothing if the mode has not been saved.
+    std::optional<bool> restore(Mode _mode)
+    {
+        auto& saved = saved_[static_cast<size_t>(_mode)];
+        if (saved.empty())
+            return std::nullopt;
+
+        auto const enabled = saved.back();
+        saved.pop_back();
+        return enabled;
     }
 
   private:
-    // TODO: make this a vector<bool> by casting from Mode, but that requires ensured small linearity in Mode enum values.
-    std::set<Mode> enabled_;
+    std::bitset<ModeCount> enabled_;
+    std::array<std::vector<bool>, ModeCount> saved_;
 };
 // }}}
 
@@ -216,6 +240,35 @@ constexpr bool operator!=(GraphicsAttributes const& a, GraphicsAttributes const&
 {
     return !(a == b);
 }
+
+/// Process-wide, append-only table of all distinct GraphicsAttributes in use.
+///
+/// Cells refer to their graphics rendition by id into this table rather than carrying
+/// a full copy each. Interned entries are never moved nor released, so references
+/// obtained via get() stay valid for the lifetime of the process.
+class GraphicsAttributesTable {
+  public:
+    using Id = uint32_t;
+
+    /// Id of the default-constructed GraphicsAttributes.
+    static constexpr Id DefaultId = 0;
+
+    /// Returned by intern() when the table is exhausted.
+    static constexpr Id InvalidId = (1u << 24) - 1;
+
+    /// Maximum number of distinct attributes the table will hold.
+    static constexpr size_t MaxEntries = 1u << 20;
+
+    /// @returns the id of the given attributes, adding them to the table if not present yet,
+    ///          or InvalidId if the table is full.
+    static Id intern(GraphicsAttributes const& _attributes);
+
+    /// @returns the attributes for an id previously returned by intern().
+    static GraphicsAttributes const& get(Id _id) noexcept;
+
+    /// @returns number of distinct attributes interned so far.
+    static size_t size() noexcept;
+};
 // }}}
 
 // {{{ Cursor
@@ -238,88 +291,147 @@ struct Cursor
 
 // {{{ Cell
 /// Grid cell with character and graphics rendition information.
+///
+/// Cells are kept as small as possible (16 bytes), as there are millions of them per terminal
+/// once the history is taken into account. The first codepoint is stored inline and the
+/// graphics rendition is referred to by its id in the GraphicsAttributesTable.
+/// Everything that is rarely needed (combining codepoints, hyperlinks, image fragments)
+/// lives in an out-of-line record that is only allocated on demand.
 class Cell {
   public:
     static size_t constexpr MaxCodepoints = 9;
 
-    Cell(char32_t _ch, GraphicsAttributes _attrib) noexcept :
-        codepoints_{},
-        attributes_{std::move(_attrib)},
+    Cell(char32_t _ch, GraphicsAttributes const& _attrib) :
+        codepoint_{0},
+        attributesId_{GraphicsAttributesTable::DefaultId},
         width_{1},
         codepointCount_{0}
     {
         setCharacter(_ch);
+        setAttributes(_attrib);
     }
 
     constexpr Cell() noexcept :
-        codepoints_{},
-        attributes_{},
+        codepoint_{0},
+        attributesId_{GraphicsAttributesTable::DefaultId},
         width_{1},
         codepointCount_{0}
     {}
 
     void reset() noexcept
     {
-        attributes_ = {};
+        extra_.reset();
+        attributesId_ = GraphicsAttributesTable::DefaultId;
         codepointCount_ = 0;
         width_ = 1;
-        hyperlink_ = nullptr;
-        imageFragment_.reset();
     }
 
-    void reset(GraphicsAttributes _attribs, HyperlinkRef const& _hyperlink) noexcept
+    void reset(GraphicsAttributes const& _attribs, HyperlinkId _hyperlink)
     {
-        attributes_ = std::move(_attribs);
-        codepointCount_ = 0;
-        width_ = 1;
-        hyperlink_ = _hyperlink;
-        imageFragment_.reset();
+        reset();
+        setAttributes(_attribs);
+        setHyperlink(_hyperlink);
+    }
+
+    Cell(Cell const& _other) :
+        extra_{_other.extra_ ? std::make_unique<Extra>(*_other.extra_) : nullptr},
+        codepoint_{_other.codepoint_},
+        attributesId_{_other.attributesId_},
+        width_{_other.width_},
+        codepointCount_{_other.codepointCount_}
+    {}
+
+    Cell& operator=(Cell const& _other)
+    {
+        if (this != &_other)
+        {
+            extra_ = _other.extra_ ? std::make_unique<Extra>(*_other.extra_) : nullptr;
+            codepoint_ = _other.codepoint_;
+            attributesId_ = _other.attributesId_;
+            width_ = _other.width_;
+            codepointCount_ = _other.codepointCount_;
+        }
+        return *this;
     }
 
-    Cell(Cell const&) = default;
     Cell(Cell&&) noexcept = default;
-    Cell& operator=(Cell const&) = default;
     Cell& operator=(Cell&&) noexcept = default;
 
-    constexpr std::u32string_view codepoints() const noexcept
+    std::u32string_view codepoints() const noexcept
     {
-        return std::u32string_view{codepoints_.data(), codepointCount_};
+        if (codepointCount_ > 1)
+            return std::u32string_view{extra_->codepoints.data(), codepointCount_};
+        return std::u32string_view{&codepoint_, codepointCount_};
     }
 
-    constexpr char32_t codepoint(size_t i) const noexcept { return codepoints_[i]; }
+    char32_t codepoint(size_t i) const noexcept
+    {
+        if (i >= codepointCount_)
+            return 0;
+        return i == 0 ? codepoint_ : extra_->codepoints[i];
+    }
     constexpr int codepointCount() const noexcept { return codepointCount_; }
 
     constexpr bool empty() const noexcept { return codepointCount_ == 0; }
 
     constexpr int width() const noexcept { return width_; }
 
-    constexpr GraphicsAttributes const& attributes() const noexcept { return attributes_; }
-    constexpr GraphicsAttributes& attributes() noexcept { return attributes_; }
+    GraphicsAttributes const& attributes() const noexcept
+    {
+        if (attributesId_ != GraphicsAttributesTable::InvalidId)
+            return GraphicsAttributesTable::get(attributesId_);
+        return *extra_->attributes;
+    }
+
+    /// @returns the GraphicsAttributesTable id of this cell's graphics rendition,
+    ///          or GraphicsAttributesTable::InvalidId if stored out-of-line.
+    constexpr GraphicsAttributesTable::Id attributesId() const noexcept { return attributesId_; }
+
+    void setAttributes(GraphicsAttributes const& _attributes)
+    {
+        attributesId_ = GraphicsAttributesTable::intern(_attributes);
+        if (attributesId_ == GraphicsAttributesTable::InvalidId)
+            extra().attributes = _attributes;
+        else if (extra_ && extra_->attributes)
+        {
+            extra_->attributes.reset();
+            releaseUnusedExtra();
+        }
+    }
 
-    std::optional<ImageFragment> const& imageFragment() const noexcept { return imageFragment_; }
+    std::optional<ImageFragment> const& imageFragment() const noexcept
+    {
+        static std::optional<ImageFragment> const none;
+        return extra_ ? extra_->imageFragment : none;
+    }
 
-    void setImage(ImageFragment _imageFragment, HyperlinkRef _hyperlink)
+    void setImage(ImageFragment _imageFragment, HyperlinkId _hyperlink)
     {
-        imageFragment_.emplace(std::move(_imageFragment));
-        hyperlink_ = std::move(_hyperlink);
+        extra().imageFragment.emplace(std::move(_imageFragment));
+        extra_->hyperlink = _hyperlink;
         width_ = 1;
         codepointCount_ = 0;
     }
 
     void setCharacter(char32_t _codepoint) noexcept
     {
-        imageFragment_.reset();
-        codepoints_[0] = _codepoint;
+        codepoint_ = _codepoint;
         if (_codepoint)
         {
             codepointCount_ = 1;
-            width_ = std::max(unicode::width(_codepoint), 1);
+            width_ = std::max(CodepointProperties::width(_codepoint), 1);
         }
         else
         {
             codepointCount_ = 0;
             width_ = 1;
         }
+
+        if (extra_)
+        {
+            extra_->imageFragment.reset();
+            releaseUnusedExtra();
+        }
     }
 
     void setWidth(int _width) noexcept
@@ -329,10 +441,19 @@ class Cell {
 
     int appendCharacter(char32_t _codepoint) noexcept
     {
-        imageFragment_.reset();
-        if (codepointCount_ < MaxCodepoints)
+        if (extra_)
+            extra_->imageFragment.reset();
+
+        if (codepointCount_ == 0)
+        {
+            codepoint_ = _codepoint;
+            codepointCount_ = 1;
+        }
+        else if (codepointCount_ < MaxCodepoints)
         {
-            codepoints_[codepointCount_] = _codepoint;
+            auto& codepoints = extra().codepoints;
+            codepoints[0] = codepoint_;
+            codepoints[codepointCount_] = _codepoint;
             codepointCount_++;
 
             constexpr bool AllowWidthChange = false; // TODO: make configurable
@@ -345,7 +466,7 @@ class Cell {
                     case 0xFE0F:
                         return 2;
                     default:
-                        return unicode::width(_codepoint);
+                        return CodepointProperties::width(_codepoint);
                 }
             }();
 
@@ -361,35 +482,84 @@ class Cell {
 
     std::string toUtf8() const;
 
-    HyperlinkRef hyperlink() const noexcept { return hyperlink_; }
-    void setHyperlink(HyperlinkRef const& _hyperlink) { hyperlink_ = _hyperlink; }
+    /// @returns whether this cell holds just @p _codepoint with the interned attributes
+    ///          @p _attributesId and the hyperlink @p _hyperlink, such that writing these to it
+    ///          would not change it.
+    bool holds(char32_t _codepoint, GraphicsAttributesTable::Id _attributesId, HyperlinkId _hyperlink) const noexcept
+    {
+        return codepointCount_ == 1
+            && codepoint_ == _codepoint
+            && attributesId_ == _attributesId
+            && _attributesId != GraphicsAttributesTable::InvalidId
+            && hyperlink() == _hyperlink;
+    }
+
+    /// @returns id of the hyperlink in the HyperlinkStorage of the Screen, or 0 if there is none.
+    HyperlinkId hyperlink() const noexcept { return extra_ ? extra_->hyperlink : 0; }
+
+    void setHyperlink(HyperlinkId _hyperlink)
+    {
+        if (_hyperlink)
+            extra().hyperlink = _hyperlink;
+        else if (extra_)
+        {
+            extra_->hyperlink = 0;
+            releaseUnusedExtra();
+        }
+    }
+
+    /// @returns number of heap bytes held by this cell's out-of-line record, if any.
+    size_t extraMemoryUsage() const noexcept { return extra_ ? sizeof(Extra) : 0; }
 
   private:
-    /// Unicode codepoint to be displayed.
-    std::array<char32_t, MaxCodepoints> codepoints_;
+    /// Rarely used cell properties, stored out-of-line.
+    struct Extra {
+        /// All codepoints of this cell, if it holds more than one.
+        std::array<char32_t, MaxCodepoints> codepoints{};
+        HyperlinkId hyperlink = 0;
+        /// Image fragment to be rendered in this cell.
+        std::optional<ImageFragment> imageFragment;
+        /// Graphics rendition, if the GraphicsAttributesTable was exhausted.
+        std::optional<GraphicsAttributes> attributes;
+    };
+
+    Extra& extra()
+    {
+        if (!extra_)
+            extra_ = std::make_unique<Extra>();
+        return *extra_;
+    }
+
+    void releaseUnusedExtra() noexcept
+    {
+        if (codepointCount_ <= 1 && !extra_->hyperlink && !extra_->imageFragment && !extra_->attributes)
+            extra_.reset();
+    }
+
+    std::unique_ptr<Extra> extra_;
+
+    /// First (and usually only) Unicode codepoint to be displayed.
+    char32_t codepoint_;
 
     /// Graphics renditions, such as foreground/background color or other grpahics attributes.
-    GraphicsAttributes attributes_;
+    uint32_t attributesId_ : 24;
 
     /// number of cells this cell spans. Usually this is 1, but it may be also 0 or >= 2.
-    uint8_t width_;
+    uint32_t width_ : 4;
 
     /// Number of combined codepoints stored in this cell.
-    uint8_t codepointCount_;
-
-    HyperlinkRef hyperlink_ = nullptr;
-
-    /// Image fragment to be rendered in this cell.
-    std::optional<ImageFragment> imageFragment_;
+    uint32_t codepointCount_ : 4;
 };
 
-constexpr bool operator==(Cell const& a, Cell const& b) noexcept
+inline bool operator==(Cell const& a, Cell const& b) noexcept
 {
     if (a.codepointCount() != b.codepointCount())
         return false;
 
-    if (!(a.attributes() == b.attributes()))
-        return false;
+    // Interned attributes are unique, so equal ids imply equal attributes.
+    if (a.attributesId() != b.attributesId() || a.attributesId() == GraphicsAttributesTable::InvalidId)
+        if (!(a.attributes() == b.attributes()))
+            return false;
 
     for (auto const i : crispy::times(a.codepointCount()))
         if (a.codepoint(i) != b.codepoint(i))
@@ -402,9 +572,15 @@ constexpr bool operator==(Cell const& a, Cell const& b) noexcept
 
 struct Line { // {{{
     using LineBuffer = std::vector<Cell>;
-    LineBuffer buffer;
     bool marked = false;
 
+    /// Soft-wrap marker, indicating that this line continues the previous one due to auto-wrap.
+    bool wrapped = false;
+
+    /// Number of cells a history line is laid out in at least, such that the rows joined into it
+    /// keep their place even if blank, see SavedLines::layoutLength().
+    uint32_t joinedLength = 0;
+
     using iterator = LineBuffer::iterator;
     using const_iterator = LineBuffer::const_iterator;
     using reverse_iterator = LineBuffer::reverse_iterator;
@@ -417,25 +593,86 @@ struct Line { // {{{
     Line& operator=(Line const&) = default;
     Line& operator=(Line&&) = default;
 
-    LineBuffer* operator->() noexcept { return &buffer; }
-    LineBuffer const* operator->()  const noexcept { return &buffer; }
-    auto& operator[](std::size_t _index) { return buffer[_index]; }
-    auto const& operator[](std::size_t _index) const { return buffer[_index]; }
+    LineBuffer* operator->() { return &cells(); }
+    LineBuffer const* operator->()  const { return &cells(); }
+    auto& operator[](std::size_t _index) { return cells()[_index]; }
+    auto const& operator[](std::size_t _index) const { return cells()[_index]; }
     auto size() const noexcept { return buffer.size(); }
     void resize(size_type _size) { buffer.resize(_size); }
 
-    iterator begin() { return buffer.begin(); }
-    iterator end() { return buffer.end(); }
-    const_iterator begin() const { return buffer.begin(); }
-    const_iterator end() const { return buffer.end(); }
-    reverse_iterator rbegin() { return buffer.rbegin(); }
-    reverse_iterator rend() { return buffer.rend(); }
-    const_iterator cbegin() const { return buffer.cbegin(); }
-    const_iterator cend() const { return buffer.cend(); }
+    /// Reinitializes the line with @p _numCols copies of @p _defaultCell, reusing its storage.
+    void reset(size_t _numCols, Cell const& _defaultCell)
+    {
+        buffer.resize(_numCols);
+        clear(_defaultCell);
+        marked = false;
+        wrapped = false;
+        joinedLength = 0;
+    }
+
+    /// Logically assigns @p _blankCell to every cell of this line.
+    ///
+    /// The cells are only materialized once they are accessed, as most cleared lines
+    /// are either cleared again or left blank, e.g. in full-screen applications.
+    void clear(Cell const& _blankCell)
+    {
+        blankCell_ = _blankCell;
+        blank_ = true;
+    }
+
+    /// @returns the cell that all cells of this line equal if the line was cleared
+    ///          and not accessed since, or nullptr otherwise.
+    Cell const* blankCell() const noexcept { return blank_ ? &blankCell_ : nullptr; }
+
+    /// Appends the text of the first @p _length cells to @p _output, with exactly one codepoint
+    /// per cell (a space for empty cells) except for the cells covered by wide characters.
+    void appendText(std::string& _output, size_t _length) const;
+
+    LineBuffer& cells() { materialize(); return buffer; }
+    LineBuffer const& cells() const { materialize(); return buffer; }
+
+    /// @returns number of heap bytes held by this line's cells, excluding their out-of-line records.
+    size_t memoryUsage() const noexcept { return buffer.capacity() * sizeof(Cell); }
+
+    /// @returns number of heap bytes held by the out-of-line records of this line's cells,
+    ///          including those of cells that are logically cleared but not materialized yet.
+    size_t extraMemoryUsage() const noexcept
+    {
+        auto bytes = blankCell_.extraMemoryUsage();
+        for (Cell const& cell : buffer)
+            bytes += cell.extraMemoryUsage();
+        return bytes;
+    }
+
+    iterator begin() { return cells().begin(); }
+    iterator end() { return cells().end(); }
+    const_iterator begin() const { return cells().begin(); }
+    const_iterator end() const { return cells().end(); }
+    reverse_iterator rbegin() { return cells().rbegin(); }
+    reverse_iterator rend() { return cells().rend(); }
+    const_iterator cbegin() const { return cells().cbegin(); }
+    const_iterator cend() const { return cells().cend(); }
+
+  private:
+    void materialize() const
+    {
+        if (blank_)
+        {
+            std::fill(buffer.begin(), buffer.end(), blankCell_);
+            blank_ = false;
+        }
+    }
+
+    // Mutable, as reading a cleared line materializes its cells.
+    mutable LineBuffer buffer;
+    mutable bool blank_ = false;
+    Cell blankCell_;
 };
 // }}}
 
-using Lines = std::deque<Line>;
+/// Lines of a screen buffer, rotated in-place when scrolling.
+using Lines = crispy::ring<Line>;
+
 using ColumnIterator = Line::iterator;
 using LineIterator = Lines::iterator;
 
@@ -446,6 +683,361 @@ inline auto end(Line const& _line) { return _line.cend(); }
 inline Line::const_iterator cbegin(Line const& _line) { return _line.cbegin(); }
 inline Line::const_iterator cend(Line const& _line) { return _line.cend(); }
 
+// {{{ PortableLines
+/// Lines encoded such that they do not refer to anything of the process they were encoded in,
+/// carrying the graphics renditions and hyperlinks of their cells by value, as saved to snapshots.
+///
+/// Cells are encoded like the history's packed pages (see SavedLines), with all graphics
+/// renditions stored in attributes. Image fragments are not kept.
+struct PortableLines {
+    /// Flags of each line.
+    static constexpr uint8_t Marked = 0x01;
+    static constexpr uint8_t Wrapped = 0x02;
+
+    /// Encoded cells of all lines, or empty if referring to external data instead.
+    std::vector<uint8_t> data;
+    /// Encoded cells of all lines kept elsewhere, such as in a memory mapped file, if not empty.
+    crispy::span<uint8_t const> externalData{};
+    /// Keeps the external data alive, if any.
+    std::shared_ptr<void const> externalOwner;
+
+    std::vector<uint8_t> flags;
+    /// Number of columns each line is laid out in, see SavedLines::layoutLength().
+    std::vector<uint32_t> lengths;
+    std::vector<GraphicsAttributes> attributes;
+    /// Hyperlinks by id parameter and URI, referred to by their index plus one.
+    std::vector<std::pair<std::string, URI>> hyperlinks;
+    /// Text of all lines (see Line::appendText()), and the end offset of each line's text.
+    std::string text;
+    std::vector<uint32_t> textEnds;
+
+    size_t size() const noexcept { return flags.size(); }
+
+    /// @returns the encoded cells of all lines.
+    crispy::span<uint8_t const> cells() const noexcept
+    {
+        return externalData.empty() ? crispy::span<uint8_t const>{data.data(), data.data() + data.size()} : externalData;
+    }
+
+    /// Appends @p _line, resolving the ids of its cells' hyperlinks in @p _hyperlinks.
+    void append(Line const& _line, HyperlinkStorage const& _hyperlinks);
+
+    /// Decodes all lines, with their hyperlinks referring to the given ids, indexed like hyperlinks.
+    std::vector<Line> decode(std::vector<HyperlinkId> const& _hyperlinkIds) const;
+
+  private:
+    std::unordered_map<GraphicsAttributesTable::Id, uint32_t> attributeIndices_;
+    std::unordered_map<HyperlinkId, uint32_t> hyperlinkIndices_;
+};
+// }}}
+
+// {{{ SavedLines
+/// Lines that have been scrolled off the primary screen buffer, oldest first.
+///
+/// History is stored as logical lines: a line that was soft-wrapped onto the next one is
+/// joined with its continuation when that enters the history. Logical lines are presented
+/// as rows of rowWidth() cells, laid out lazily on first access after the width changed,
+/// so that resizing does not touch any history lines.
+///
+/// The most recent hotLineCount() lines are kept as they are. Older lines are packed into
+/// pages of pageSize() lines each (run-length encoded attributes and varint encoded codepoints),
+/// that are decoded on demand into a small page cache. Optionally, packed pages are moved into
+/// a temporary file once they exceed a given amount of memory, see setSpillThreshold().
+///
+/// References to lines are only guaranteed to be valid until the next modification
+/// or until more than cachedPageCount() other pages have been accessed.
+class SavedLines {
+  public:
+    /// Default number of lines per packed page, which is also the number of history lines per
+    /// chunk of screen snapshots.
+    static constexpr size_t DefaultPageSize = 256;
+
+    /// Default number of decoded pages kept for access.
+    static constexpr size_t DefaultCachedPageCount = 4;
+
+    using iterator = crispy::ring_iterator<Line, SavedLines>;
+    using const_iterator = crispy::ring_iterator<Line const, SavedLines const>;
+    using reverse_iterator = std::reverse_iterator<iterator>;
+    using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+
+    SavedLines();
+    ~SavedLines();
+    SavedLines(SavedLines const&) = delete;
+    SavedLines& operator=(SavedLines const&) = delete;
+    SavedLines(SavedLines&&) noexcept;
+    SavedLines& operator=(SavedLines&&) noexcept;
+
+    size_t size() const noexcept { return packedLineCount_ + hotLines_.size(); }
+    bool empty() const noexcept { return size() == 0; }
+
+    // {{{ paging
+    /// Sets the number of lines per packed page and the number of decoded pages kept for access.
+    ///
+    /// Larger pages pack better and are skipped by searches in larger steps, but take longer to
+    /// decode when scrolled into view. A changed page size repacks all lines.
+    void setPaging(size_t _pageSize, size_t _cachedPageCount);
+
+    size_t pageSize() const noexcept { return pageSize_; }
+    size_t cachedPageCount() const noexcept { return cachedPageCount_; }
+
+    /// @returns number of most recent lines that are never packed.
+    size_t hotLineCount() const noexcept { return 2 * pageSize_; }
+
+    /// @returns number of lines held by packed pages, which are the oldest ones.
+    size_t packedLineCount() const noexcept { return packedLineCount_; }
+    // }}}
+
+    Line& at(size_t _index);
+    Line const& at(size_t _index) const;
+    Line& operator[](size_t _index) { return at(_index); }
+    Line const& operator[](size_t _index) const { return at(_index); }
+
+    Line& front() { return at(0); }
+    Line& back();
+
+    /// Tests whether the line at the given index is marked, without decoding it.
+    ///
+    /// Marks are indexed as lines are appended, hence must not be changed on saved lines.
+    bool marked(size_t _index) const;
+
+    // {{{ row layout
+    /// Sets the number of columns logical lines are wrapped at, with 0 meaning no wrapping.
+    void setRowWidth(size_t _width);
+    size_t rowWidth() const noexcept { return rowWidth_; }
+
+    /// @returns number of rows all logical lines span at the current row width.
+    size_t rowCount() const;
+
+    /// @returns logical line index and column offset into that line for the given row.
+    std::pair<size_t, size_t> locateRow(size_t _row) const;
+
+    /// Tests whether the given row is the first row of a marked line.
+    bool rowMarked(size_t _row) const;
+
+    /// @returns the first row of the last marked line that starts before the given row.
+    std::optional<size_t> markedRowBefore(size_t _row) const;
+
+    /// @returns the first row of the first marked line that starts after the given row.
+    std::optional<size_t> markedRowAfter(size_t _row) const;
+
+    /// Removes the last row from the history and returns it.
+    Line takeBackRow();
+
+    /// Removes the oldest @p _count rows from the history, cutting the leading rows off the
+    /// oldest remaining line if it spans more rows than are left to be removed.
+    void popFrontRows(size_t _count);
+
+    /// @returns the first row of the given logical line.
+    size_t firstRowOf(size_t _index) const;
+    // }}}
+
+    // {{{ text index
+    /// @returns the serial number of the first line. Lines are numbered consecutively
+    ///          in the order they have been appended, starting at 0.
+    size_t firstSerial() const noexcept { return firstSerial_; }
+
+    /// @returns the text of the given line (see Line::appendText()) without trailing blanks.
+    ///          Packed lines are not decoded, @p _buffer is used for the other ones.
+    std::string_view text(size_t _index, std::string& _buffer) const;
+
+    /// @returns index of the first line of the page holding the given line, if that page
+    ///          cannot contain any line with all the trigrams of @p _needle, or std::nullopt.
+    std::optional<size_t> firstLineOfPageWithout(size_t _index, crispy::trigram_filter const& _needle) const;
+    // }}}
+
+    iterator begin() noexcept { return iterator{this, 0}; }
+    iterator end() noexcept { return iterator{this, static_cast<std::ptrdiff_t>(size())}; }
+    const_iterator begin() const noexcept { return const_iterator{this, 0}; }
+    const_iterator end() const noexcept { return const_iterator{this, static_cast<std::ptrdiff_t>(size())}; }
+    reverse_iterator rbegin() noexcept { return reverse_iterator{end()}; }
+    reverse_iterator rend() noexcept { return reverse_iterator{begin()}; }
+    const_reverse_iterator rbegin() const noexcept { return const_reverse_iterator{end()}; }
+    const_reverse_iterator rend() const noexcept { return const_reverse_iterator{begin()}; }
+
+    /// Sets the ids of all hyperlinks referred to by the saved lines in @p _used (indexed by id).
+    void markHyperlinks(std::vector<bool>& _used) const;
+
+    /// Appends the given line, joining it with the last line if it is a soft-wrapped continuation.
+    void emplace_back(Line&& _line);
+    void pop_front();
+    void pop_back();
+    void clear();
+
+    /// @returns a line whose cell storage may be reused, recovered from lines that have been
+    ///          dropped or packed, or an empty line if there is none.
+    Line spareLine();
+
+    /// Sets the number of bytes of packed pages to keep in memory before moving
+    /// the oldest ones into a temporary file, or std::nullopt to never do so.
+    void setSpillThreshold(std::optional<size_t> _bytes);
+
+    /// @returns number of bytes held by packed pages in memory.
+    size_t residentSize() const noexcept { return residentSize_; }
+
+    /// @returns number of bytes of packed pages that have been moved to disk.
+    size_t spilledSize() const noexcept { return spilledSize_; }
+
+    /// @returns number of heap bytes held by packed pages and by lines not packed,
+    ///          excluding the out-of-line records of their cells.
+    size_t memoryUsage() const noexcept;
+
+    /// @returns number of heap bytes held by the out-of-line records of cells of lines not packed.
+    size_t extraMemoryUsage() const noexcept;
+
+    /// @returns number of used columns of the given line, excluding trailing blanks.
+    static size_t usedLength(Line const& _line) noexcept;
+
+    /// @returns number of columns the given line is laid out in, which are its used columns,
+    ///          or more if blank rows have been joined into it.
+    static size_t layoutLength(Line const& _line) noexcept;
+
+    /// Appends the lines of @p _lines, with their hyperlinks referring to @p _hyperlinkIds.
+    ///
+    /// Lines are adopted as a packed page as they are, if they are pageSize() lines appended before
+    /// any other lines, such that their cells are only decoded once accessed.
+    void append(PortableLines const& _lines, std::vector<HyperlinkId> _hyperlinkIds);
+
+    /// Appends the lines of the VT output @p _output, such as a log file mapped into memory,
+    /// kept alive by @p _owner.
+    ///
+    /// If no lines have been appended before, the output is merely split into lines, and pages
+    /// of pageSize() lines are parsed only once accessed or searched, like packed pages are decoded.
+    /// Each page is parsed on its own, starting in the ground state with the graphics rendition
+    /// in effect at its start, as recorded while splitting.
+    void appendOutput(crispy::span<uint8_t const> _output, std::shared_ptr<void const> _owner);
+
+  private:
+    struct Page {
+        /// Encoded lines, empty if spilled or external.
+        std::vector<uint8_t> data;
+        /// Encoded lines kept elsewhere, such as in a memory mapped snapshot, if not empty.
+        crispy::span<uint8_t const> external;
+        std::shared_ptr<void const> externalOwner;
+        /// Offset and length of the encoded lines in the spill file, if spilled.
+        std::optional<std::pair<long, size_t>> spilled;
+        std::vector<bool> marks;
+        /// Number of columns each line is laid out in, see layoutLength().
+        std::vector<uint32_t> lengths;
+        std::vector<HyperlinkId> hyperlinks;
+        std::vector<ImageFragment> images;
+        /// Attributes that could not be interned.
+        std::vector<GraphicsAttributes> attributes;
+        /// Text of all lines, kept in memory even if spilled, to be searched without decoding.
+        std::string text;
+        /// End offset of each line's text.
+        std::vector<uint32_t> textEnds;
+        crispy::trigram_filter trigrams;
+        /// VT output of the lines to be parsed instead of decoded, if not empty, kept alive
+        /// by externalOwner. The lengths are upper bounds until parsed, see appendOutput().
+        crispy::span<uint8_t const> output;
+        /// SGR sequences in effect at the start of output.
+        std::string outputPrefix;
+    };
+
+    struct CachedPage {
+        size_t serial;
+        std::vector<Line> lines;
+        bool dirty;
+        uint64_t lastUse;
+    };
+
+    static void encodeLine(Line const& _line, Page& _page);
+    static void indexLine(Line const& _line, Page& _page);
+
+    std::pair<size_t, size_t> locate(size_t _index) const noexcept;
+    CachedPage& cachedPage(size_t _pageIndex) const;
+    void dropCachedPage(size_t _serial) const noexcept;
+    void writeBack(CachedPage& _cachedPage) const;
+    std::vector<Line> decode(Page const& _page) const;
+    std::vector<Line> parse(std::string_view _prefix, crispy::span<uint8_t const> _output, size_t _lineCount) const;
+    void releasePage(Page const& _page) const noexcept;
+    void packFront();
+    void thawBack();
+    void spill();
+
+    size_t lengthOf(size_t _index) const;
+    size_t rowsOf(size_t _length) const noexcept;
+    void ensureLayout() const;
+
+    // Mutable, as dirty cached pages are written back on eviction, which may happen on const access.
+    mutable std::deque<Page> pages_;
+    size_t firstPageSerial_ = 0;
+    size_t firstSerial_ = 0;
+    size_t frontSkip_ = 0;       // number of lines already dropped from the first page
+    size_t packedLineCount_ = 0;
+    std::deque<Line> hotLines_;
+    std::vector<Line> spareLines_;
+    /// Serial numbers of all marked lines, in ascending order.
+    std::deque<size_t> markedSerials_;
+
+    size_t pageSize_ = DefaultPageSize;
+    size_t cachedPageCount_ = DefaultCachedPageCount;
+    mutable std::vector<CachedPage> cache_;
+    mutable uint64_t useCounter_ = 0;
+
+    size_t rowWidth_ = 0;
+    mutable bool layoutValid_ = true;
+    /// Cumulative row counts of each logical line, including droppedRows_.
+    mutable std::deque<size_t> rowEnds_;
+    /// Number of rows dropped from the front since the layout was computed.
+    mutable size_t droppedRows_ = 0;
+
+    std::optional<size_t> spillThreshold_;
+    mutable size_t residentSize_ = 0;
+    mutable size_t spilledSize_ = 0;
+    std::unique_ptr<std::FILE, int(*)(std::FILE*)> spillFile_{nullptr, &std::fclose};
+};
+// }}}
+
+/// Approximate number of heap bytes held by a Screen, by kind of storage.
+struct ScreenMemoryUsage {
+    size_t lines = 0;       ///< cells of the main and alternate screen buffers
+    size_t history = 0;     ///< history lines, packed or not, including spilled pages' search text
+    size_t cellExtras = 0;  ///< out-of-line cell records (combining codepoints, hyperlinks, image fragments)
+    size_t hyperlinks = 0;  ///< hyperlink table and implicitly detected links
+    size_t attributes = 0;  ///< interned graphics renditions, shared by all screens of the process
+    size_t images = 0;      ///< pixel data of the image pool
+
+    size_t total() const noexcept { return lines + history + cellExtras + hyperlinks + attributes + images; }
+};
+
+/// State of a Screen but its history, as saved to and restored from snapshots.
+struct ScreenState {
+    Size size;
+    ScreenType screenType = ScreenType::Main;
+    Cursor cursor;              ///< restored without its character set mapping
+    Cursor savedCursor;         ///< restored without its character set mapping
+    int wrapPending = 0;
+    Margin margin;
+    std::vector<bool> modes;    ///< indexed by Mode
+    int tabWidth = 8;
+    std::vector<int> tabs;
+    std::string windowTitle;
+    PortableLines primaryLines;
+    PortableLines alternateLines;
+};
+
+/// Changes of a Screen since a previous update, as mirrored to the viewers of a session.
+///
+/// The active buffer is scrolled up by scrolledLines first, before its changed rows are replaced.
+/// The most recent history line may still be continued by a later line, and is therefore sent
+/// again with the next update.
+struct ScreenUpdate {
+    bool historyCleared = false;    ///< drops all history lines before appending the history
+    size_t historyDropped = 0;      ///< number of most recent history lines to drop before that
+    PortableLines history;          ///< lines appended to the history
+    int scrolledLines = 0;
+    std::vector<int> rows;          ///< changed rows of the active buffer, in the order of lines
+    PortableLines lines;
+    ScreenState state;              ///< without any lines
+};
+
+/// Formats logical lines are exported in, see Screen::exportLines().
+enum class ExportFormat {
+    Text,   ///< plain text, as copied
+    VT,     ///< text with SGR sequences for the graphics renditions of its cells
+};
+
 /**
  * Terminal Screen.
  *
@@ -498,7 +1090,15 @@ class Screen {
     }
 
     void setMaxHistoryLineCount(std::optional<size_t> _maxHistoryLineCount);
-    int historyLineCount() const noexcept { return static_cast<int>(savedLines_.size()); }
+
+    /// Sets the number of bytes of packed history to keep in memory before spilling it to disk,
+    /// or std::nullopt to keep all history in memory.
+    void setHistorySpillThreshold(std::optional<size_t> _bytes) { savedLines_.setSpillThreshold(_bytes); }
+
+    /// Sets the number of lines per packed history page and of decoded pages kept, see SavedLines::setPaging().
+    void setHistoryPaging(size_t _pageSize, size_t _cachedPageCount) { savedLines_.setPaging(_pageSize, _cachedPageCount); }
+
+    int historyLineCount() const noexcept { return static_cast<int>(savedLines_.rowCount()); }
 
     /// Writes given data into the screen.
     void write(char const* _data, size_t _size);
@@ -510,16 +1110,41 @@ class Screen {
 
     void writeText(char32_t _char);
 
+    /// Writes a run of printable US-ASCII characters (0x20 .. 0x7E) into the screen,
+    /// filling the current line's cells in one go and wrapping only at line boundaries.
+    void writeText(std::string_view _chars);
+
     /// Renders the full screen by passing every grid cell to the callback.
     template <typename RendererT>
     void render(RendererT _renderer, std::optional<int> _scrollOffset = std::nullopt) const;
 
+    /// Renders the full screen like render() above, but passes every blank line
+    /// (see Line::blankCell()) of the main buffer as a whole to @p _renderBlankLine(row, cell).
+    ///
+    /// @param _rows restricts rendering to the given 1-based rows of the viewport, which may
+    ///              extend one row beyond the screen's height when scrolled into the history.
+    template <typename RendererT, typename BlankLineRendererT>
+    void render(RendererT _renderer, BlankLineRendererT _renderBlankLine, std::optional<int> _scrollOffset,
+                std::optional<Margin::Range> _rows = std::nullopt) const;
+
+    /// Renders a single line of the main buffer, see render().
+    template <typename RendererT, typename BlankLineRendererT>
+    void renderLine(int _row, RendererT _renderer, BlankLineRendererT _renderBlankLine) const;
+
     /// Renders a single text line.
     std::string renderTextLine(int _row) const;
 
     /// Renders the full screen as text into the given string. Each line will be terminated by LF.
     std::string renderText() const;
 
+    /// Appends the codepoints of the cells in the columns [@p _fromColumn, @p _toColumn] of the given
+    /// absolute row (as used by the Selector) to @p _output, skipping empty cells.
+    void appendRowText(int _absoluteRow, int _fromColumn, int _toColumn, std::string& _output) const;
+
+    /// Tests whether the given absolute row (as used by the Selector) continues the logical line
+    /// of the row above, which has been soft-wrapped onto it.
+    bool continuesLine(int _absoluteRow) const;
+
     /// Takes a screenshot by outputting VT sequences needed to render the current state of the screen.
     ///
     /// @note Only the screenshot of the current buffer is taken, not both (main and alternate).
@@ -528,6 +1153,97 @@ class Screen {
     ///          including initial clear screen, and initial cursor hide.
     std::string screenshot() const;
 
+    // {{{ text search
+    // Logical lines (i.e. joining soft-wrapped rows) of the history and the current buffer are
+    // numbered consecutively by a serial number, that is kept when being scrolled into the history.
+
+    /// @returns serial number of the oldest logical line still available.
+    size_t firstLineSerial() const noexcept { return savedLines_.firstSerial(); }
+
+    /// @returns one past the serial number of the most recent logical line.
+    size_t lineSerialEnd() const;
+
+    /// @returns text of the given logical line (see Line::appendText()) without trailing blanks,
+    ///          possibly stored into @p _buffer.
+    std::string_view lineText(size_t _serial, std::string& _buffer) const;
+
+    /// Appends the logical lines [@p _serial, @p _serial + @p _count) to @p _output in the given
+    /// format, each terminated by a newline, skipping lines no longer or not yet available.
+    ///
+    /// Packed history lines are only decoded for ExportFormat::VT.
+    void exportLines(size_t _serial, size_t _count, ExportFormat _format, std::string& _output) const;
+
+    /// @returns serial number of the first line of a block of lines including @p _serial that
+    ///          cannot contain any line with all trigrams of @p _needle, or std::nullopt if unknown.
+    std::optional<size_t> firstLineWithout(size_t _serial, crispy::trigram_filter const& _needle) const;
+
+    /// @returns absolute coordinate (as used by the Selector) of the cell at the given zero-based
+    ///          column of the given logical line, or std::nullopt if not available anymore.
+    std::optional<Coordinate> absoluteCoordinate(size_t _serial, int _column) const;
+    // }}}
+
+    // {{{ implicit hyperlinks
+    /// A URL or file path detected in the text of a logical line, see detectLinks().
+    struct ImplicitHyperlink {
+        HyperlinkId hyperlink;
+        Coordinate from;    // absolute coordinate (as used by the Selector) of the first cell
+        Coordinate to;      // absolute coordinate of the last cell
+    };
+
+    /// @returns the URL or file path detected at the given absolute coordinate (as used by the
+    ///          Selector), or std::nullopt if there is none.
+    ///
+    /// Logical lines are scanned on their first lookup, and only scanned again once modified.
+    std::optional<ImplicitHyperlink> implicitHyperlinkAt(Coordinate const& _absolute);
+    // }}}
+
+    /// @returns the hyperlinks referred to by the cells of this screen.
+    HyperlinkStorage const& hyperlinks() const noexcept { return hyperlinks_; }
+
+    /// @returns the memory held by this screen, which walks all cells but the packed history's.
+    ScreenMemoryUsage memoryUsage() const;
+
+    // {{{ snapshots
+    /// @returns one past the serial number of the most recent history line.
+    size_t historySerialEnd() const noexcept { return savedLines_.firstSerial() + savedLines_.size(); }
+
+    /// Appends @p _count history lines, starting at the given serial number, to @p _output.
+    void saveHistory(size_t _serial, size_t _count, PortableLines& _output) const;
+
+    /// @returns the state of this screen but its history.
+    ScreenState saveState() const;
+
+    /// Replaces the history and state of this screen, keeping its size.
+    ///
+    /// The history is restored from @p _history, oldest first, without its first @p _skip lines.
+    /// Pages of SavedLines::pageSize() lines leading @p _history are adopted as they are, such that
+    /// their cells are decoded only once accessed.
+    void restore(std::vector<PortableLines> const& _history, size_t _skip, ScreenState const& _state);
+
+    /// Replaces the history of the primary buffer with the lines of the VT output @p _output,
+    /// such as a log file mapped into memory, kept alive by @p _owner.
+    ///
+    /// The output is split into lines up front, but only parsed as far as it is scrolled into
+    /// view or searched (see SavedLines::appendOutput()). The history's maximum line count is
+    /// raised to hold all of its lines, until the history is cleared or replaced.
+    void openHistory(crispy::span<uint8_t const> _output, std::shared_ptr<void const> _owner);
+
+    /// Takes the changes since the previous update and clears the damage of this screen.
+    ///
+    /// @param _historySerialEnd  one past the serial number of the most recent history line sent
+    ///                           with the previous update, which is advanced to the one sent now
+    /// @param _full              whether to include all rows rather than the damaged ones, such as
+    ///                           after the size or the active buffer changed
+    ScreenUpdate takeUpdate(size_t& _historySerialEnd, bool _full);
+
+    /// @returns all rows as an update like takeUpdate(), leaving the damage of this screen as it is,
+    ///          such that viewers can start over from it at any time.
+    ScreenUpdate keyframe(size_t& _historySerialEnd) const;
+
+    /// Applies the changes taken from another screen by takeUpdate(), keeping the size of this one.
+    void applyUpdate(ScreenUpdate const& _update);
+    // }}}
+
     void setFocus(bool _focused) { focused_ = _focused; }
     bool focused() const noexcept { return focused_; }
 
@@ -604,6 +1320,18 @@ class Screen {
     void singleShiftSelect(CharsetTable _table);
     void requestPixelSize(RequestPixelSize::Area _area);
     void sixelImage(Size _pixelSize, Image::Data&& _rgba);
+
+    /// Places a compressed (PNG or JPEG) image at the cursor, which is decoded asynchronously.
+    ///
+    /// The image is left blank until decoded, and the cursor is moved below the image.
+    void inlineImage(std::string&& _data, ImageExtent _width, ImageExtent _height, bool _preserveAspectRatio);
+
+    /// Provides the decoded pixel data of an image placed by inlineImage().
+    void provideImage(Image const& _image, Image::Data&& _data);
+
+    /// Shows the upper part of a Sixel image still being received, where the final image
+    /// is about to be placed by sixelImage(), without moving the cursor or scrolling.
+    void sixelImagePreview(Size _pixelSize, Image::Data&& _rgba);
     void requestStatusString(RequestStatusString::Value _value);
     void requestTabStops();
     void resetDynamicColor(DynamicColorName _name);
@@ -635,6 +1363,12 @@ class Screen {
                      ImageResize _resizePolicy,
                      bool _autoScroll);
 
+    /// @returns number of grid cells spanned by an image of the given size in pixels.
+    Size gridSizeOf(Size _pixelSize) const noexcept;
+
+    /// Evicts images not displayed on the screen buffers while exceeding the image memory budget.
+    void evictImages(Image const& _keep);
+
     void dumpState(std::string const& _message) const;
 
     // reset screen
@@ -651,6 +1385,12 @@ class Screen {
     Size const& size() const noexcept { return size_; }
     void resize(Size const& _newSize);
 
+    /// Frees the alternate buffer while the primary one is in use, to be allocated again when
+    /// switching to it.
+    ///
+    /// @returns whether it had been allocated.
+    bool releaseAlternateBuffer();
+
     /// Implements semantics for  DECCOLM / DECSCPP.
     void resizeColumns(int _newColumnCount, bool _clear);
 
@@ -750,15 +1490,20 @@ class Screen {
         assert(crispy::ascending(1, _coord.column, size_.width));
 
         if (_coord.row > 0)
-            return (*next(begin(lines()), _coord.row - 1))[_coord.column - 1];
-        else
-            return (*next(rbegin(savedLines_), -_coord.row))[_coord.column - 1];
+            return (*std::next(begin(lines()), _coord.row - 1))[_coord.column - 1];
+        else // history is read-only
+            return const_cast<Cell&>(std::as_const(*this).at(_coord));
     }
 
     /// Gets a reference to the cell relative to screen origin (top left, 1:1).
     Cell const& at(Coordinate const& _coord) const noexcept
     {
-        return const_cast<Screen&>(*this).at(_coord);
+        if (_coord.row > 0)
+            return const_cast<Screen&>(*this).at(_coord);
+
+        assert(crispy::ascending(1 - historyLineCount(), _coord.row, size_.height));
+        assert(crispy::ascending(1, _coord.column, size_.width));
+        return historyCell(static_cast<size_t>(historyLineCount() - 1 + _coord.row), _coord.column);
     }
 
     bool isPrimaryScreen() const noexcept { return activeBuffer_ == &lines_[0]; }
@@ -773,7 +1518,7 @@ class Screen {
     bool horizontalMarginsEnabled() const noexcept { return isModeEnabled(Mode::LeftRightMargin); }
 
     Margin const& margin() const noexcept { return margin_; }
-    Lines const& scrollbackLines() const noexcept { return savedLines_; }
+    SavedLines const& scrollbackLines() const noexcept { return savedLines_; }
 
     void setTabWidth(int _value)
     {
@@ -807,23 +1552,102 @@ class Screen {
     ///         in the screen area, and in the savedLines area otherwise.
     std::optional<int> findMarkerBackward(int _currentCursorLine) const;
 
+    // {{{ output folding
+    // The history lines following a marked line, up to the next marked line, can be folded away,
+    // hiding them from rendering, scrolling and searching. Visible rows number the history rows
+    // (and the main screen rows below) with all folded rows skipped.
+
+    /// Folds the history lines after the marked line at or above the given absolute history row,
+    /// up to the next marked line.
+    ///
+    /// @retval true a fold has been added.
+    bool foldOutput(int _absoluteRow);
+
+    /// Unfolds the lines after the marked line at or above the given absolute history row.
+    ///
+    /// @retval true a fold has been removed.
+    bool unfoldOutput(int _absoluteRow);
+
+    /// Folds or unfolds the lines after the marked line at or above the given absolute history row.
+    bool toggleFold(int _absoluteRow);
+
+    void unfoldAll()
+    {
+        folds_.clear();
+        ++foldChanges_;
+    }
+
+    /// @returns number of times folds have been added or removed, telling renderers that
+    ///          the visible rows have changed.
+    uint64_t foldChanges() const noexcept { return foldChanges_; }
+
+    /// @returns number of history rows hidden by folds.
+    int foldedRowCount() const;
+
+    /// @returns the absolute row displayed as the given visible row.
+    int absoluteRowOf(int _visibleRow) const;
+
+    /// @returns the visible row of the given absolute row, or of the end of its fold if folded.
+    int visibleRowOf(int _absoluteRow) const;
+
+    /// @returns serial number of the first logical line of the fold the given line is hidden by.
+    std::optional<size_t> foldStart(size_t _serial) const;
+    // }}}
+
     /// ScreenBuffer's type, such as main screen or alternate screen.
     ScreenType bufferType() const noexcept { return screenType_; }
 
-    bool synchronizeOutput() const noexcept { return false; } // TODO
+    /// Tests whether the application is updating the screen in a synchronized update, during
+    /// which the previous frame should remain visible.
+    bool synchronizeOutput() const noexcept { return isModeEnabled(Mode::BatchedRendering); }
 
     ScreenEvents& eventListener() noexcept { return eventListener_; }
     ScreenEvents const& eventListener()  const noexcept { return eventListener_; }
 
     void setWindowTitle(std::string const& _title);
+
+    /// Number of window titles kept by saveWindowTitle(), dropping the oldest beyond, as xterm does.
+    static constexpr size_t MaxSavedWindowTitles = 10;
+
     void saveWindowTitle();
     void restoreWindowTitle();
 
     void setMaxImageSize(Size _size) noexcept { sequencer_.setMaxImageSize(_size); }
+    void setSixelDecoderThreads(unsigned _value) { sequencer_.setSixelDecoderThreads(_value); }
+
+    /// Sets the maximum number of bytes of image pixel data to keep, or 0 for no limit.
+    ///
+    /// Images not displayed on the screen buffers are evicted beyond that, least recently created first.
+    void setMaxImageMemory(size_t _bytes) noexcept { imagePool_.setMaxMemory(_bytes); }
+
+    ImagePool const& imagePool() const noexcept { return imagePool_; }
+
+    /// Sets the (optional) sink for counting processed VT sequences.
+    void setMetrics(Metrics* _metrics) noexcept { sequencer_.setMetrics(_metrics); }
 
     void scrollUp(int n) { scrollUp(n, margin_); }
     void scrollDown(int n) { scrollDown(n, margin_); }
 
+    // {{{ damage tracking
+    /// @returns true if the given row (1-based, in screen coordinates) has been modified
+    ///          since the last call to clearDamage().
+    ///
+    /// @note Cells modified directly via at() or currentCell() are not tracked.
+    bool isLineDamaged(int _row) const noexcept { return damagedLines_[static_cast<size_t>(_row - 1)]; }
+
+    /// @returns the smallest range of rows enclosing all damaged rows, or nothing if no row is damaged.
+    std::optional<Margin::Range> const& damagedRows() const noexcept { return damagedRows_; }
+
+    /// @returns number of lines the full screen has been scrolled up since the last clearDamage().
+    ///
+    /// Damage moves along with the scrolled rows, i.e. an undamaged row shows the contents that
+    /// were displayed scrolledLines() rows further down at the time of the last clearDamage().
+    int scrolledLines() const noexcept { return scrolledLines_; }
+
+    /// Marks all rows as undamaged, e.g. after the renderer has picked up the screen contents.
+    void clearDamage() noexcept;
+    // }}}
+
     void verifyState() const;
 
     // interactive replies
@@ -841,11 +1665,20 @@ class Screen {
   private:
     void setBuffer(ScreenType _type);
 
-    Coordinate resizeBuffer(Size const& _newSize, Lines& _buffer, Lines& _savedLines) const;
+    /// Saves or restores everything of a ScreenState but its lines, see saveState() and restore().
+    void saveCursorAndModes(ScreenState& _state) const;
+    void restoreCursorAndModes(ScreenState const& _state);
+
+    ScreenUpdate makeUpdate(size_t& _historySerialEnd, bool _full) const;
+
+    Coordinate resizeBuffer(Size const& _newSize, Lines& _buffer, SavedLines& _savedLines) const;
 
     Lines& primaryBuffer() noexcept { return lines_[0]; }
     Lines& alternateBuffer() noexcept { return lines_[1]; }
 
+    /// Allocates the alternate buffer if not yet, or fits it to the screen size, before using it.
+    void allocateAlternateBuffer();
+
     Lines const& lines() const noexcept { return *activeBuffer_; }
     Lines& lines() noexcept { return *activeBuffer_; }
 
@@ -860,13 +1693,52 @@ class Screen {
     void clearAndAdvance(int _offset);
 
     void clampSavedLines();
-    void clampSavedLines(Lines& _savedLines) const;
+    void clampSavedLines(SavedLines& _savedLines) const;
 
     void fail(std::string const& _message) const;
 
+    void damageLine(int _row) noexcept { damageLines(_row, _row); }
+    void damageLines(int _from, int _to) noexcept;
+    void damageScreen() noexcept { damageLines(1, size_.height); }
+    void damageScroll(int _n);
+
+    /// Moves the cursor to the beginning of the next line due to auto-wrap.
+    void wrapLine();
+
+    /// Tests whether the given row of the current buffer starts a logical line.
+    bool startsLogicalLine(int _row) const;
+
+    /// @returns first row of the current buffer of the given logical line, or std::nullopt.
+    std::optional<int> firstRowOfLine(size_t _serial) const;
+
+    /// @returns serial number of the logical line the given row of the current buffer belongs to.
+    size_t lineSerialOfRow(int _row) const;
+
+    /// Drops the links detected in all logical lines modified since the last lookup.
+    void invalidateImplicitHyperlinks();
+
+    /// Adds a hyperlink, releasing all hyperlinks no longer referred to whenever the table grew
+    /// to twice its size since doing so last.
+    HyperlinkId addHyperlink(HyperlinkInfo _hyperlink);
+    void collectHyperlinks();
+
+    /// @returns the cell at the given 0-based history row (oldest first) and 1-based column.
+    Cell const& historyCell(size_t _row, int _column) const;
+
+    /// @returns serial number of the marked logical line at or above the given history row.
+    std::optional<size_t> markedLineAt(int _absoluteRow) const;
+
+    /// Invokes @p _callback(fromRow, toRow) for the history rows [fromRow, toRow) of each fold,
+    /// top to bottom, until it returns false.
+    template <typename Callback>
+    void forEachFoldedRows(Callback _callback) const;
+
+    /// @returns the given absolute row, or the first row below it not hidden by any fold.
+    int unfoldedRowFrom(int _absoluteRow) const;
+
     void updateCursorIterators()
     {
-        currentLine_ = next(begin(lines()), cursor_.position.row - 1);
+        currentLine_ = std::next(begin(lines()), cursor_.position.row - 1);
         updateColumnIterator();
     }
 
@@ -914,7 +1786,6 @@ class Screen {
     VTType terminalId_ = VTType::VT525;
 
     Modes modes_;
-    std::map<Mode, std::vector<bool>> savedModes_; //!< saved DEC modes
 
     int maxImageColorRegisters_;
     std::shared_ptr<ColorPalette> imageColorPalette_;
@@ -925,9 +1796,10 @@ class Screen {
     int64_t instructionCounter_ = 0;
 
     Size size_;
-    std::optional<size_t> maxHistoryLineCount_;
+    std::optional<size_t> maxHistoryLineCount_;   // as configured
+    size_t openedHistoryRowCount_ = 0;             // rows of an opened file held beyond maxHistoryLineCount_
     std::string windowTitle_{};
-    std::stack<std::string> savedWindowTitles_{};
+    std::deque<std::string> savedWindowTitles_{};
 
     bool sixelCursorConformance_ = true;
 
@@ -942,7 +1814,15 @@ class Screen {
     std::array<Lines, 2> lines_;
     ScreenType screenType_ = ScreenType::Main;
     Lines* activeBuffer_;
-    Lines savedLines_{};
+    SavedLines savedLines_{};
+    std::map<size_t, size_t> folds_;    // serial numbers of the first and one past the last line of each fold
+    uint64_t foldChanges_ = 0;
+
+    // rows modified since the last clearDamage()
+    //
+    std::vector<bool> damagedLines_;
+    std::optional<Margin::Range> damagedRows_;
+    int scrolledLines_ = 0;
 
     // cursor related
     //
@@ -955,53 +1835,122 @@ class Screen {
 
     // Hyperlink related
     //
-    HyperlinkRef currentHyperlink_ = {};
-    std::unordered_map<std::string, HyperlinkRef> hyperlinks_; // TODO: use a deque<> instead, always push_back, lookup reverse, evict in front.
+    static constexpr size_t MinHyperlinkCollectionSize = 1024;
+    HyperlinkStorage hyperlinks_;
+    size_t hyperlinkCollectionSize_ = MinHyperlinkCollectionSize;   // number of hyperlinks to trigger collectHyperlinks()
+    HyperlinkId currentHyperlink_ = 0;
+    std::unordered_map<std::string, HyperlinkId> hyperlinkIds_;    // by OSC 8 id parameter
+
+    // links detected in logical lines (keyed by serial number), see implicitHyperlinkAt()
+    //
+    struct ImplicitLink {
+        int column;
+        int length;
+        HyperlinkId hyperlink;
+    };
+    std::unordered_map<size_t, std::vector<ImplicitLink>> implicitHyperlinks_;
+    std::optional<int> implicitHyperlinksDamage_;   // topmost row modified since the last lookup
+    size_t implicitHyperlinksTop_ = 0;              // serial number of the top row's line at the last lookup
 };
 
 // {{{ template functions
 template <typename RendererT>
 void Screen::render(RendererT _render, std::optional<int> _scrollOffset) const
 {
-    if (!_scrollOffset.has_value())
+    render(
+        _render,
+        [&](int _row, Cell const& _blankCell) {
+            for (int col = 1; col <= size_.width; ++col)
+                _render({_row, col}, _blankCell);
+        },
+        _scrollOffset
+    );
+}
+
+template <typename RendererT, typename BlankLineRendererT>
+void Screen::render(RendererT _render, BlankLineRendererT _renderBlankLine, std::optional<int> _scrollOffset,
+                    std::optional<Margin::Range> _rows) const
+{
+    auto const fromRow = _rows.has_value() ? _rows->from : 1;
+    auto const toRow = _rows.has_value() ? _rows->to : size_.height;
+    int rowNumber = 1;
+
+    if (_scrollOffset.has_value())
     {
-        crispy::for_each(
-            crispy::times(1, size_.height) * crispy::times(1, size_.width),
-            [&](auto const& _pos) {
-                auto const [row, col] = _pos;
-                auto const pos = Coordinate{row, col};
-                _render({row, col}, at(pos));
+        _scrollOffset = std::clamp(*_scrollOffset, 0, historyLineCount());
+
+        // render first part from history, skipping folded rows
+        for (auto row = static_cast<size_t>(unfoldedRowFrom(*_scrollOffset));
+                row < savedLines_.rowCount() && rowNumber <= toRow;
+                row = static_cast<size_t>(unfoldedRowFrom(static_cast<int>(row) + 1)), ++rowNumber)
+        {
+            if (rowNumber < fromRow)
+                continue;
+
+            static Cell const emptyCell{};
+            auto const [lineIndex, offset] = savedLines_.locateRow(row);
+            Line const& line = savedLines_.at(lineIndex);
+            for (int colNumber = 1; colNumber <= size_.width; ++colNumber)
+            {
+                auto const i = offset + static_cast<size_t>(colNumber - 1);
+                _render({rowNumber, colNumber}, i < line.size() ? line[i] : emptyCell);
             }
-        );
+        }
     }
-    else
+
+    // render second part from main screen buffer
+    for (int row = 1; rowNumber <= toRow && row <= size_.height; ++row, ++rowNumber)
     {
-        _scrollOffset = std::clamp(*_scrollOffset, 0, historyLineCount());
+        if (rowNumber < fromRow)
+            continue;
 
-        int rowNumber = 1;
+        renderLine(
+            row,
+            [&](Coordinate const& _pos, Cell const& _cell) { _render({rowNumber, _pos.column}, _cell); },
+            [&](int, Cell const& _blankCell) { _renderBlankLine(rowNumber, _blankCell); }
+        );
+    }
+}
 
-        // render first part from history
-        for (auto line = next(begin(const_cast<Screen*>(this)->savedLines_), *_scrollOffset);
-                line != end(savedLines_) && rowNumber <= size_.height;
-                ++line, ++rowNumber)
-        {
-            if (static_cast<int>(line->size()) < size_.width)
-                line->resize(size_.width); // TODO: don't resize; fill the gap with stub render calls instead
+template <typename Callback>
+void Screen::forEachFoldedRows(Callback _callback) const
+{
+    auto const first = savedLines_.firstSerial();
+    auto const end = first + savedLines_.size();
 
-            auto column = begin(*line);
-            for (int colNumber = 1; colNumber <= size_.width; ++colNumber, ++column)
-                _render({rowNumber, colNumber}, *column);
-        }
+    // Folds may refer to lines already dropped from the history, or not (or no longer) in it yet.
+    // As folds do not overlap, only the one starting last before the first line may reach into it.
+    auto i = folds_.upper_bound(first);
+    if (i != folds_.begin())
+        --i;
 
-        // render second part from main screen buffer
-        for (auto line = begin(lines()); rowNumber <= size_.height; ++line, ++rowNumber)
-        {
-            auto column = begin(*line);
-            for (int colNumber = 1; colNumber <= size_.width; ++colNumber, ++column)
-                _render({rowNumber, colNumber}, *column);
-        }
+    for (; i != folds_.end() && i->first < end; ++i)
+    {
+        auto const [from, to] = *i;
+        if (to <= first)
+            continue;
+
+        auto const fromRow = savedLines_.firstRowOf(std::max(from, first) - first);
+        auto const toRow = to < end ? savedLines_.firstRowOf(to - first) : savedLines_.rowCount();
+        if (!_callback(static_cast<int>(fromRow), static_cast<int>(toRow)))
+            break;
     }
 }
+
+template <typename RendererT, typename BlankLineRendererT>
+void Screen::renderLine(int _row, RendererT _render, BlankLineRendererT _renderBlankLine) const
+{
+    Line const& line = *std::next(std::begin(lines()), _row - 1);
+    if (Cell const* blankCell = line.blankCell(); blankCell != nullptr)
+    {
+        _renderBlankLine(_row, *blankCell);
+        return;
+    }
+
+    auto column = std::begin(line);
+    for (int colNumber = 1; colNumber <= size_.width; ++colNumber, ++column)
+        _render({_row, colNumber}, *column);
+}
 // }}}
 
 }  // namespace terminal
@@ -16,7 +16,9 @@
 #include <terminal/InputGenerator.h>
 #include <terminal/Sequencer.h>
 
+#include <memory>
 #include <optional>
+#include <string>
 #include <string_view>
 #include <vector>
 
@@ -53,11 +55,15 @@ class ScreenEvents {
     virtual void setMouseProtocol(MouseProtocol, bool) {}
     virtual void setMouseTransport(MouseTransport) {}
     virtual void setMouseWheelMode(InputGenerator::MouseWheelMode) {}
+    virtual void setSynchronizedOutput(bool /*_enabled*/) {}
     virtual void setWindowTitle(std::string_view const& /*_title*/) {}
     virtual void useApplicationCursorKeys(bool /*_enabled*/) {}
 
     // Invoked by screen buffer when an image is not being referenced by any grid cell anymore.
     virtual void discardImage(Image const&) {}
+
+    /// Decodes the compressed @p _data into the pixel data of @p _image, which is placed already.
+    virtual void decodeImage(std::shared_ptr<Image const> /*_image*/, std::string&& /*_data*/) {}
 };
 
 class MockScreenEvents : public ScreenEvents {
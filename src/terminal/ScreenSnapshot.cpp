@@ -0,0 +1,535 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2020 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <terminal/ScreenSnapshot.h>
+#include <terminal/Screen.h>
+
+#include <crispy/mapped_file.h>
+#include <crispy/overloaded.h>
+
+#include <algorithm>
+#include <cstring>
+#include <variant>
+
+using std::shared_ptr;
+using std::string;
+using std::string_view;
+using std::vector;
+
+namespace terminal {
+
+using snapshot::ChunkKind;
+
+namespace
+{
+    // {{{ encoding
+    template <typename T>
+    void store(vector<uint8_t>& _output, T _value)
+    {
+        auto const offset = _output.size();
+        _output.resize(offset + sizeof(T));
+        std::memcpy(_output.data() + offset, &_value, sizeof(T));
+    }
+
+    void storeBytes(vector<uint8_t>& _output, void const* _data, size_t _size)
+    {
+        auto const* bytes = static_cast<uint8_t const*>(_data);
+        store(_output, static_cast<uint32_t>(_size));
+        _output.insert(_output.end(), bytes, bytes + _size);
+    }
+
+    void storeString(vector<uint8_t>& _output, string_view _text)
+    {
+        storeBytes(_output, _text.data(), _text.size());
+    }
+
+    void storeColor(vector<uint8_t>& _output, Color const& _color)
+    {
+        store(_output, static_cast<uint8_t>(_color.index()));
+        store(_output, std::visit(overloaded{
+            [](UndefinedColor) { return uint32_t{0}; },
+            [](DefaultColor) { return uint32_t{0}; },
+            [](IndexedColor _value) { return static_cast<uint32_t>(_value); },
+            [](BrightColor _value) { return static_cast<uint32_t>(_value); },
+            [](RGBColor _value) { return uint32_t{_value.red} << 16 | uint32_t{_value.green} << 8 | _value.blue; },
+        }, _color));
+    }
+
+    void storeAttributes(vector<uint8_t>& _output, GraphicsAttributes const& _attributes)
+    {
+        storeColor(_output, _attributes.foregroundColor);
+        storeColor(_output, _attributes.backgroundColor);
+        storeColor(_output, _attributes.underlineColor);
+        store(_output, static_cast<uint32_t>(_attributes.styles.mask()));
+    }
+
+    void storeCursor(vector<uint8_t>& _output, Cursor const& _cursor)
+    {
+        store(_output, static_cast<int32_t>(_cursor.position.row));
+        store(_output, static_cast<int32_t>(_cursor.position.column));
+        store(_output, static_cast<uint8_t>((_cursor.autoWrap ? 0x01 : 0)
+                                          | (_cursor.originMode ? 0x02 : 0)
+                                          | (_cursor.visible ? 0x04 : 0)));
+        storeAttributes(_output, _cursor.graphicsRendition);
+    }
+
+    void storeLines(vector<uint8_t>& _output, PortableLines const& _lines)
+    {
+        store(_output, static_cast<uint32_t>(_lines.size()));
+        _output.insert(_output.end(), _lines.flags.begin(), _lines.flags.end());
+        for (uint32_t const length : _lines.lengths)
+            store(_output, length);
+        for (uint32_t const end : _lines.textEnds)
+            store(_output, end);
+        storeString(_output, _lines.text);
+        store(_output, static_cast<uint32_t>(_lines.attributes.size()));
+        for (GraphicsAttributes const& attributes : _lines.attributes)
+            storeAttributes(_output, attributes);
+        store(_output, static_cast<uint32_t>(_lines.hyperlinks.size()));
+        for (auto const& [id, uri] : _lines.hyperlinks)
+        {
+            storeString(_output, id);
+            storeString(_output, uri);
+        }
+        auto cells = _lines.cells();
+        storeBytes(_output, cells.begin(), cells.size());
+    }
+
+    vector<uint8_t> encodeHistory(Screen const& _screen, size_t _serial)
+    {
+        auto lines = PortableLines{};
+        _screen.saveHistory(_serial, SavedLines::DefaultPageSize, lines);
+
+        auto data = vector<uint8_t>{};
+        store(data, static_cast<uint64_t>(_serial));
+        storeLines(data, lines);
+        return data;
+    }
+
+    /// Stores everything of @p _state but its lines.
+    void storeState(vector<uint8_t>& _output, ScreenState const& _state)
+    {
+        store(_output, static_cast<uint16_t>(_state.size.width));
+        store(_output, static_cast<uint16_t>(_state.size.height));
+        store(_output, static_cast<uint8_t>(_state.screenType));
+        storeCursor(_output, _state.cursor);
+        storeCursor(_output, _state.savedCursor);
+        store(_output, static_cast<uint8_t>(_state.wrapPending));
+        store(_output, static_cast<int32_t>(_state.margin.vertical.from));
+        store(_output, static_cast<int32_t>(_state.margin.vertical.to));
+        store(_output, static_cast<int32_t>(_state.margin.horizontal.from));
+        store(_output, static_cast<int32_t>(_state.margin.horizontal.to));
+        store(_output, static_cast<uint32_t>(_state.modes.size()));
+        for (bool const enabled : _state.modes)
+            store(_output, static_cast<uint8_t>(enabled));
+        store(_output, static_cast<int32_t>(_state.tabWidth));
+        store(_output, static_cast<uint32_t>(_state.tabs.size()));
+        for (int const tab : _state.tabs)
+            store(_output, static_cast<int32_t>(tab));
+        storeString(_output, _state.windowTitle);
+    }
+
+    vector<uint8_t> encodeScreen(Screen const& _screen, size_t _tailSerial)
+    {
+        auto tail = PortableLines{};
+        _screen.saveHistory(_tailSerial, _screen.historySerialEnd() - _tailSerial, tail);
+        auto const state = _screen.saveState();
+
+        auto data = vector<uint8_t>{};
+        store(data, static_cast<uint64_t>(_screen.firstLineSerial()));
+        store(data, static_cast<uint64_t>(_tailSerial));
+        storeLines(data, tail);
+        storeState(data, state);
+        storeLines(data, state.primaryLines);
+        storeLines(data, state.alternateLines);
+        return data;
+    }
+
+    void storeChunk(vector<uint8_t>& _output, ChunkKind _kind, vector<uint8_t> const& _data)
+    {
+        store(_output, static_cast<uint32_t>(_kind));
+        store(_output, static_cast<uint32_t>(_data.size()));
+        _output.insert(_output.end(), _data.begin(), _data.end());
+    }
+    // }}}
+
+    // {{{ decoding
+    /// Reads values from a chunk, failing rather than reading past its end.
+    struct Input {
+        uint8_t const* begin;
+        uint8_t const* end;
+        bool good = true;
+
+        size_t remaining() const noexcept { return static_cast<size_t>(end - begin); }
+
+        crispy::span<uint8_t const> bytes(size_t _size) noexcept
+        {
+            if (!good || remaining() < _size)
+            {
+                good = false;
+                return {};
+            }
+            auto const result = crispy::span<uint8_t const>{begin, begin + _size};
+            begin += _size;
+            return result;
+        }
+
+        template <typename T>
+        T load() noexcept
+        {
+            T value{};
+            if (auto data = bytes(sizeof(T)); good)
+                std::memcpy(&value, data.begin(), sizeof(T));
+            return value;
+        }
+
+        /// @returns the number of elements following, being at least @p _minSize bytes each.
+        size_t count(size_t _minSize) noexcept
+        {
+            auto const n = size_t{load<uint32_t>()};
+            if (n * _minSize > remaining())
+                good = false;
+            return good ? n : 0;
+        }
+
+        string loadString()
+        {
+            auto const data = bytes(load<uint32_t>());
+            return string(reinterpret_cast<char const*>(data.begin()), data.size());
+        }
+
+        Color loadColor() noexcept
+        {
+            auto const index = load<uint8_t>();
+            auto const value = load<uint32_t>();
+            switch (index)
+            {
+                case 1: return DefaultColor{};
+                case 2: return static_cast<IndexedColor>(value);
+                case 3: return static_cast<BrightColor>(value);
+                case 4: return RGBColor{static_cast<uint8_t>(value >> 16), static_cast<uint8_t>(value >> 8), static_cast<uint8_t>(value)};
+                default: return UndefinedColor{};
+            }
+        }
+
+        GraphicsAttributes loadAttributes() noexcept
+        {
+            auto attributes = GraphicsAttributes{};
+            attributes.foregroundColor = loadColor();
+            attributes.backgroundColor = loadColor();
+            attributes.underlineColor = loadColor();
+            attributes.styles = CharacterStyleMask{load<uint32_t>()};
+            return attributes;
+        }
+
+        Cursor loadCursor() noexcept
+        {
+            auto cursor = Cursor{};
+            cursor.position.row = load<int32_t>();
+            cursor.position.column = load<int32_t>();
+            auto const flags = load<uint8_t>();
+            cursor.autoWrap = flags & 0x01;
+            cursor.originMode = flags & 0x02;
+            cursor.visible = flags & 0x04;
+            cursor.graphicsRendition = loadAttributes();
+            return cursor;
+        }
+
+        /// Loads everything of a ScreenState but its lines.
+        void loadState(ScreenState& _state)
+        {
+            _state.size.width = load<uint16_t>();
+            _state.size.height = load<uint16_t>();
+            _state.screenType = load<uint8_t>() ? ScreenType::Alternate : ScreenType::Main;
+            _state.cursor = loadCursor();
+            _state.savedCursor = loadCursor();
+            _state.wrapPending = load<uint8_t>();
+            _state.margin.vertical.from = load<int32_t>();
+            _state.margin.vertical.to = load<int32_t>();
+            _state.margin.horizontal.from = load<int32_t>();
+            _state.margin.horizontal.to = load<int32_t>();
+            auto const modeCount = count(sizeof(uint8_t));
+            for (size_t i = 0; i < modeCount; ++i)
+                _state.modes.push_back(load<uint8_t>() != 0);
+            _state.tabWidth = load<int32_t>();
+            auto const tabCount = count(sizeof(int32_t));
+            for (size_t i = 0; i < tabCount; ++i)
+                _state.tabs.push_back(load<int32_t>());
+            _state.windowTitle = loadString();
+        }
+
+        /// Loads lines, referring to their cells in place if @p _owner is given, copying them otherwise.
+        PortableLines loadLines(shared_ptr<void const> _owner = {})
+        {
+            auto lines = PortableLines{};
+            auto const n = count(2 * sizeof(uint32_t) + 1);
+            auto const flags = bytes(n);
+            lines.flags.assign(flags.begin(), flags.end());
+            for (size_t i = 0; i < n; ++i)
+                lines.lengths.push_back(load<uint32_t>());
+            for (size_t i = 0; i < n; ++i)
+                lines.textEnds.push_back(load<uint32_t>());
+            lines.text = loadString();
+            if (!std::is_sorted(lines.textEnds.begin(), lines.textEnds.end())
+                    || (!lines.textEnds.empty() && lines.textEnds.back() > lines.text.size()))
+                good = false;
+
+            auto const attributeCount = count(3 * (sizeof(uint8_t) + sizeof(uint32_t)) + sizeof(uint32_t));
+            for (size_t i = 0; i < attributeCount; ++i)
+                lines.attributes.push_back(loadAttributes());
+
+            auto const hyperlinkCount = count(2 * sizeof(uint32_t));
+            for (size_t i = 0; i < hyperlinkCount; ++i)
+            {
+                auto id = loadString();
+                auto uri = loadString();
+                lines.hyperlinks.emplace_back(std::move(id), std::move(uri));
+            }
+
+            auto const cells = bytes(load<uint32_t>());
+            if (_owner && !cells.empty())
+            {
+                lines.externalData = cells;
+                lines.externalOwner = std::move(_owner);
+            }
+            else
+                lines.data.assign(cells.begin(), cells.end());
+
+            return lines;
+        }
+    };
+
+    struct HistoryChunk {
+        size_t serial;
+        Input input;
+    };
+    // }}}
+}
+
+// {{{ SnapshotWriter
+bool SnapshotWriter::write(Screen const& _screen)
+{
+    auto const first = _screen.firstLineSerial();
+    auto const end = _screen.historySerialEnd();
+
+    while (!pages_.empty() && pages_.front().first <= first)
+        pages_.pop_front();
+
+    auto liveSize = snapshot::HeaderSize + screenChunkSize_;
+    for (auto const& page : pages_)
+        liveSize += page.second;
+
+    // History lines already saved may have changed if the history shrank into them.
+    auto const outdated = !file_
+                       || !nextSerial_
+                       || (end <= *nextSerial_ && first < *nextSerial_)
+                       || fileSize_ > 2 * liveSize + MinRewriteSize;
+
+    return outdated ? rewrite(_screen) : append(_screen);
+}
+
+bool SnapshotWriter::rewrite(Screen const& _screen)
+{
+    file_.reset();
+    pages_.clear();
+    nextSerial_ = _screen.firstLineSerial();
+
+    auto output = vector<uint8_t>(snapshot::Magic, snapshot::Magic + sizeof(snapshot::Magic));
+    store(output, snapshot::Version);
+
+    // The most recent history line may still be continued, and is therefore never part of a page.
+    auto const end = _screen.historySerialEnd();
+    for (; end - *nextSerial_ > SavedLines::DefaultPageSize; *nextSerial_ += SavedLines::DefaultPageSize)
+    {
+        auto const size = output.size();
+        storeChunk(output, ChunkKind::History, encodeHistory(_screen, *nextSerial_));
+        pages_.emplace_back(*nextSerial_ + SavedLines::DefaultPageSize, output.size() - size);
+    }
+
+    auto const size = output.size();
+    storeChunk(output, ChunkKind::Screen, encodeScreen(_screen, *nextSerial_));
+    screenChunkSize_ = output.size() - size;
+
+    // The snapshot holds everything the session printed, hence only its owner may read it.
+    if (!crispy::replace_file(path_, output.data(), output.size(), 0600))
+    {
+        nextSerial_.reset();
+        return false;
+    }
+
+    fileSize_ = output.size();
+    file_.reset(std::fopen(path_.c_str(), "ab"));
+    return file_ != nullptr;
+}
+
+bool SnapshotWriter::append(Screen const& _screen)
+{
+    *nextSerial_ = std::max(*nextSerial_, _screen.firstLineSerial());
+
+    auto const end = _screen.historySerialEnd();
+    for (; end - *nextSerial_ > SavedLines::DefaultPageSize; *nextSerial_ += SavedLines::DefaultPageSize)
+    {
+        auto const data = encodeHistory(_screen, *nextSerial_);
+        if (!writeChunk(ChunkKind::History, data))
+            return false;
+        pages_.emplace_back(*nextSerial_ + SavedLines::DefaultPageSize, snapshot::ChunkHeaderSize + data.size());
+    }
+
+    auto const data = encodeScreen(_screen, *nextSerial_);
+    if (!writeChunk(ChunkKind::Screen, data))
+        return false;
+    screenChunkSize_ = snapshot::ChunkHeaderSize + data.size();
+
+    return std::fflush(file_.get()) == 0;
+}
+
+bool SnapshotWriter::writeChunk(ChunkKind _kind, vector<uint8_t> const& _data)
+{
+    auto output = vector<uint8_t>{};
+    output.reserve(snapshot::ChunkHeaderSize + _data.size());
+    storeChunk(output, _kind, _data);
+
+    if (std::fwrite(output.data(), 1, output.size(), file_.get()) != output.size())
+    {
+        // Starts over with the next write, as the file now ends with an incomplete chunk.
+        file_.reset();
+        return false;
+    }
+
+    fileSize_ += output.size();
+    return true;
+}
+// }}}
+
+// {{{ restoreSnapshot
+bool restoreSnapshot(Screen& _screen, string const& _path)
+{
+    auto file = crispy::mapped_file::open(_path);
+    return file && restoreSnapshot(_screen, std::make_shared<crispy::mapped_file const>(std::move(*file)));
+}
+
+bool restoreSnapshot(Screen& _screen, shared_ptr<crispy::mapped_file const> _file)
+{
+    if (_file->size() < snapshot::HeaderSize)
+        return false;
+
+    auto input = Input{_file->data(), _file->data() + _file->size()};
+    auto const magic = input.bytes(sizeof(snapshot::Magic));
+    if (std::memcmp(magic.begin(), snapshot::Magic, sizeof(snapshot::Magic)) != 0
+            || input.load<uint32_t>() != snapshot::Version)
+        return false;
+
+    // A snapshot cut short by a crash ends with an incomplete chunk, which is ignored.
+    auto history = vector<HistoryChunk>{};
+    auto screenChunk = std::optional<Input>{};
+    auto historyCount = size_t{0}; // history chunks preceding the most recent screen chunk
+    while (input.remaining() >= snapshot::ChunkHeaderSize)
+    {
+        auto const kind = static_cast<ChunkKind>(input.load<uint32_t>());
+        auto const size = size_t{input.load<uint32_t>()};
+        if (input.remaining() < size)
+            break;
+
+        auto chunk = Input{input.begin, input.begin + size};
+        input.begin += size;
+
+        switch (kind)
+        {
+            case ChunkKind::History:
+                if (auto const serial = chunk.load<uint64_t>(); chunk.good)
+                    history.push_back(HistoryChunk{static_cast<size_t>(serial), chunk});
+                break;
+            case ChunkKind::Screen:
+                screenChunk = chunk;
+                historyCount = history.size();
+                break;
+        }
+    }
+
+    if (!screenChunk)
+        return false;
+
+    auto& chunk = *screenChunk;
+    auto const oldestSerial = static_cast<size_t>(chunk.load<uint64_t>());
+    auto const tailSerial = static_cast<size_t>(chunk.load<uint64_t>());
+    auto tail = chunk.loadLines();
+
+    auto state = ScreenState{};
+    chunk.loadState(state);
+    state.primaryLines = chunk.loadLines();
+    state.alternateLines = chunk.loadLines();
+    if (!chunk.good)
+        return false;
+
+    // Collects the pages continuing each other up to the tail, most recent first. Pages are not
+    // replaced in place, so an interrupted sequence means older pages are of an earlier rewrite.
+    auto pages = vector<PortableLines>{};
+    auto serial = tailSerial;
+    for (auto i = historyCount; i > 0 && serial > oldestSerial; --i)
+    {
+        auto& page = history[i - 1];
+        if (page.serial + SavedLines::DefaultPageSize != serial)
+            break;
+
+        auto lines = page.input.loadLines(_file);
+        if (!page.input.good || lines.size() != SavedLines::DefaultPageSize)
+            break;
+
+        pages.emplace_back(std::move(lines));
+        serial = page.serial;
+    }
+    std::reverse(pages.begin(), pages.end());
+    pages.emplace_back(std::move(tail));
+
+    auto const skip = serial < oldestSerial ? oldestSerial - serial : size_t{0};
+    _screen.restore(pages, skip, state);
+    return true;
+}
+// }}}
+
+// {{{ updates
+vector<uint8_t> snapshot::encodeUpdate(ScreenUpdate const& _update)
+{
+    auto data = vector<uint8_t>{};
+    store(data, static_cast<uint8_t>(_update.historyCleared));
+    store(data, static_cast<uint32_t>(_update.historyDropped));
+    storeLines(data, _update.history);
+    store(data, static_cast<int32_t>(_update.scrolledLines));
+    store(data, static_cast<uint32_t>(_update.rows.size()));
+    for (int const row : _update.rows)
+        store(data, static_cast<uint16_t>(row));
+    storeLines(data, _update.lines);
+    storeState(data, _update.state);
+    return data;
+}
+
+std::optional<ScreenUpdate> snapshot::decodeUpdate(crispy::span<uint8_t const> _data)
+{
+    auto input = Input{_data.begin(), _data.end()};
+    auto update = ScreenUpdate{};
+    update.historyCleared = input.load<uint8_t>() != 0;
+    update.historyDropped = input.load<uint32_t>();
+    update.history = input.loadLines();
+    update.scrolledLines = input.load<int32_t>();
+    auto const rowCount = input.count(sizeof(uint16_t));
+    for (size_t i = 0; i < rowCount; ++i)
+        update.rows.push_back(input.load<uint16_t>());
+    update.lines = input.loadLines();
+    input.loadState(update.state);
+    if (!input.good || update.rows.size() != update.lines.size())
+        return std::nullopt;
+    return update;
+}
+// }}}
+
+} // end namespace
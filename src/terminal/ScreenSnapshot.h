@@ -0,0 +1,136 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2020 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <crispy/span.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <memory>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace crispy { class mapped_file; }
+
+namespace terminal {
+
+class Screen;
+struct ScreenUpdate;
+
+/// Screen snapshots hold the history and state of a Screen, such that it can be restored after
+/// restarting without parsing anything. History lines are appended to a snapshot in pages as they
+/// are scrolled into the history, such that saving again mostly writes what changed.
+///
+/// The file starts with a header, followed by any number of chunks, all in host byte order:
+///
+///   header:     char[8] magic "VTSNAP\0\0", uint32 version
+///   chunk:      uint32 kind, uint32 size, and size bytes of data
+///
+/// History chunks hold SavedLines::DefaultPageSize consecutive history lines each. Screen chunks hold
+/// the state of the screen, along with the history lines not saved in history chunks (the tail):
+///
+///   history:    uint64 serial number of the first line, lines
+///   screen:     uint64 serial number of the oldest history line, uint64 serial number of the
+///               tail's first line, lines (tail), uint16 columns, uint16 lines, uint8 screen type,
+///               cursor, cursor (saved), uint8 wrap pending, int32 margins (top, bottom, left,
+///               right), uint32 mode count, uint8 per mode, int32 tab width, uint32 tab count,
+///               int32 per tab, string window title, lines (primary), lines (alternate)
+///
+///   lines:      uint32 count, uint8 flags per line, uint32 used columns per line, uint32 text end
+///               per line, string text, uint32 attributes count, attributes per attributes,
+///               uint32 hyperlink count, string id and string URI per hyperlink, uint32 size,
+///               size bytes of cells (see PortableLines)
+///   attributes: color (foreground, background, underline), uint32 styles
+///   color:      uint8 index of the Color alternative, uint32 value
+///   cursor:     int32 row, int32 column, uint8 flags (auto-wrap, origin mode, visible), attributes
+///   string:     uint32 size, size bytes
+///
+/// Cells come last and nothing is aligned, such that the cells of history lines can be decoded
+/// straight from the memory mapped file once accessed.
+///
+/// The most recent screen chunk is restored, along with the history chunks preceding it that
+/// continue each other up to its tail. A snapshot cut short by a crash ends with an incomplete
+/// chunk, which is ignored.
+namespace snapshot {
+    constexpr char Magic[8] = {'V', 'T', 'S', 'N', 'A', 'P', 0, 0};
+    constexpr uint32_t Version = 1;
+    constexpr size_t HeaderSize = sizeof(Magic) + sizeof(uint32_t);
+    constexpr size_t ChunkHeaderSize = 2 * sizeof(uint32_t);
+
+    enum class ChunkKind : uint32_t {
+        History = 0,
+        Screen = 1,
+    };
+
+    /// Encodes @p _update like the chunks of snapshots, in the following layout:
+    ///
+    ///   update:     uint8 history cleared, uint32 history lines dropped, lines (history),
+    ///               int32 scrolled lines, uint32 row count, uint16 per row, lines (rows),
+    ///               the fields of screen chunks from uint16 columns up to string window title
+    std::vector<uint8_t> encodeUpdate(ScreenUpdate const& _update);
+
+    /// @returns the update encoded by encodeUpdate() in @p _data, or nothing if malformed.
+    std::optional<ScreenUpdate> decodeUpdate(crispy::span<uint8_t const> _data);
+}
+
+/// Writes snapshots of a screen into a file, see the snapshot namespace for its format.
+///
+/// The file is readable by its owner only.
+class SnapshotWriter {
+  public:
+    explicit SnapshotWriter(std::string _path) : path_{std::move(_path)} {}
+
+    SnapshotWriter(SnapshotWriter const&) = delete;
+    SnapshotWriter& operator=(SnapshotWriter const&) = delete;
+
+    /// Saves the history and state of @p _screen, appending the lines scrolled into its history
+    /// since the last write. The file is replaced as a whole on the first write, if history lines
+    /// already saved have changed, or if most of the file has become outdated.
+    ///
+    /// @retval false the snapshot could not be written.
+    bool write(Screen const& _screen);
+
+    /// @returns the number of bytes of the snapshot file.
+    size_t fileSize() const noexcept { return fileSize_; }
+
+  private:
+    bool rewrite(Screen const& _screen);
+    bool append(Screen const& _screen);
+    bool writeChunk(snapshot::ChunkKind _kind, std::vector<uint8_t> const& _data);
+
+    /// Files at least this large are replaced once mostly outdated.
+    static constexpr size_t MinRewriteSize = 1024 * 1024;
+
+    std::string path_;
+    std::unique_ptr<std::FILE, int(*)(std::FILE*)> file_{nullptr, &std::fclose};
+    size_t fileSize_ = 0;
+    size_t screenChunkSize_ = 0;                    // size of the most recent screen chunk
+    std::optional<size_t> nextSerial_;              // serial number of the first line of the tail
+    std::deque<std::pair<size_t, size_t>> pages_;   // serial number end and size of history chunks
+};
+
+/// Restores the history and state of @p _screen from the snapshot at @p _path, keeping the
+/// screen's size. The cells of history lines are decoded only once accessed, while the file
+/// stays mapped into memory.
+///
+/// @retval false the file could not be read or is not a snapshot, leaving the screen untouched.
+bool restoreSnapshot(Screen& _screen, std::string const& _path);
+
+/// Restores the history and state of @p _screen from the snapshot in @p _file, like above.
+bool restoreSnapshot(Screen& _screen, std::shared_ptr<crispy::mapped_file const> _file);
+
+} // end namespace
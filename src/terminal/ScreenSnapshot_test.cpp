@@ -0,0 +1,179 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2020 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <terminal/ScreenSnapshot.h>
+#include <terminal/Screen.h>
+
+#include <crispy/stdfs.h>
+
+#include <catch2/catch.hpp>
+
+#include <fmt/format.h>
+
+#include <cstdio>
+
+using namespace terminal;
+
+namespace
+{
+    void writeLines(Screen& _screen, int _first, int _count)
+    {
+        for (int i = _first; i < _first + _count; ++i)
+            _screen.write(fmt::format("\033[3{}mline {}\033[m\r\n", i % 8, i));
+    }
+
+    void checkEqual(Screen const& _a, Screen const& _b)
+    {
+        REQUIRE(_a.historyLineCount() == _b.historyLineCount());
+        for (int row = 1 - _a.historyLineCount(); row <= _a.size().height; ++row)
+        {
+            for (int column = 1; column <= _a.size().width; ++column)
+            {
+                Cell const& a = _a.at({row, column});
+                Cell const& b = _b.at({row, column});
+                INFO(fmt::format("row {} column {}", row, column));
+                REQUIRE(a.toUtf8() == b.toUtf8());
+                REQUIRE(a.attributes().foregroundColor == b.attributes().foregroundColor);
+            }
+        }
+    }
+}
+
+TEST_CASE("ScreenSnapshot.roundtrip", "[screen]")
+{
+    auto const path = (FileSystem::temp_directory_path() / "contour-ScreenSnapshot_test.vtsnap").string();
+
+    auto events = MockScreenEvents{};
+    auto screen = Screen{Size{20, 5}, events};
+    screen.write("\033]8;;https://example.com/\033\\link\033]8;;\033\\\r\n");
+    writeLines(screen, 1, 3 * int(SavedLines::DefaultPageSize));
+    screen.write("\033]2;Title\033\\\033[?7l\033[2;4r\033[3;7H\033[1mX");
+
+    auto writer = SnapshotWriter{path};
+    REQUIRE(writer.write(screen));
+
+    auto restoredEvents = MockScreenEvents{};
+    auto restored = Screen{Size{20, 5}, restoredEvents};
+    REQUIRE(restoreSnapshot(restored, path));
+
+    checkEqual(screen, restored);
+    CHECK(restored.windowTitle() == "Title");
+    CHECK(restored.realCursorPosition() == screen.realCursorPosition());
+    CHECK(unsigned(restored.cursor().graphicsRendition.styles) == CharacterStyleMask::Bold);
+    CHECK_FALSE(restored.isModeEnabled(Mode::AutoWrap));
+    CHECK(restored.margin().vertical == screen.margin().vertical);
+
+    Cell const& link = restored.at({1 - restored.historyLineCount(), 1});
+    REQUIRE(link.hyperlink() != 0);
+    CHECK(restored.hyperlinks().get(link.hyperlink())->uri == "https://example.com/");
+
+    std::remove(path.c_str());
+}
+
+TEST_CASE("ScreenSnapshot.incremental", "[screen]")
+{
+    auto const path = (FileSystem::temp_directory_path() / "contour-ScreenSnapshot_test.vtsnap").string();
+
+    auto events = MockScreenEvents{};
+    auto screen = Screen{Size{20, 5}, events};
+    auto writer = SnapshotWriter{path};
+
+    writeLines(screen, 0, 2 * int(SavedLines::DefaultPageSize));
+    REQUIRE(writer.write(screen));
+    auto const firstSize = writer.fileSize();
+
+    writeLines(screen, 2 * int(SavedLines::DefaultPageSize), int(SavedLines::DefaultPageSize));
+    REQUIRE(writer.write(screen));
+    writeLines(screen, 3 * int(SavedLines::DefaultPageSize), 10);
+    REQUIRE(writer.write(screen));
+
+    // The pages written before are kept, with the new ones appended.
+    CHECK(writer.fileSize() > firstSize);
+    CHECK(writer.fileSize() < 3 * firstSize);
+
+    auto restoredEvents = MockScreenEvents{};
+    auto restored = Screen{Size{20, 5}, restoredEvents};
+    REQUIRE(restoreSnapshot(restored, path));
+    checkEqual(screen, restored);
+
+    // Clearing the history drops the pages written before.
+    screen.write("\033[3J");
+    writeLines(screen, 0, 5);
+    REQUIRE(writer.write(screen));
+    auto cleared = Screen{Size{20, 5}, restoredEvents};
+    REQUIRE(restoreSnapshot(cleared, path));
+    checkEqual(screen, cleared);
+
+    std::remove(path.c_str());
+}
+
+TEST_CASE("ScreenSnapshot.malformed", "[screen]")
+{
+    auto const path = (FileSystem::temp_directory_path() / "contour-ScreenSnapshot_test.txt").string();
+    {
+        auto* file = std::fopen(path.c_str(), "wb");
+        REQUIRE(file);
+        std::fputs("not a screen snapshot", file);
+        std::fclose(file);
+    }
+
+    auto events = MockScreenEvents{};
+    auto screen = Screen{Size{20, 5}, events};
+    screen.write("text");
+    CHECK_FALSE(restoreSnapshot(screen, path));
+    CHECK(screen.renderTextLine(1).substr(0, 4) == "text");
+    std::remove(path.c_str());
+}
+
+TEST_CASE("ScreenSnapshot.updates", "[screen]")
+{
+    auto events = MockScreenEvents{};
+    auto screen = Screen{Size{20, 5}, events};
+    auto mirrorEvents = MockScreenEvents{};
+    auto mirror = Screen{Size{20, 5}, mirrorEvents};
+    size_t historySerialEnd = 0;
+
+    auto const mirrorUpdate = [&](bool _full) {
+        auto const data = snapshot::encodeUpdate(screen.takeUpdate(historySerialEnd, _full));
+        auto const update = snapshot::decodeUpdate(crispy::span<uint8_t const>(data.data(), data.data() + data.size()));
+        REQUIRE(update.has_value());
+        mirror.applyUpdate(*update);
+        checkEqual(screen, mirror);
+        CHECK(mirror.realCursorPosition() == screen.realCursorPosition());
+    };
+
+    screen.write("\033]2;Title\033\\first");
+    mirrorUpdate(true);
+    CHECK(mirror.windowTitle() == "Title");
+
+    // Scrolling into the history, with the most recent history line continued by a wrapped line.
+    writeLines(screen, 0, 12);
+    screen.write("01234567890123456789012345");
+    mirrorUpdate(false);
+    screen.write("6789\r\nnext");
+    mirrorUpdate(false);
+
+    // Switching buffers replaces all rows.
+    screen.write("\033[?1049h\033[2;3Halternate");
+    mirrorUpdate(true);
+    CHECK(mirror.bufferType() == ScreenType::Alternate);
+    screen.write("\033[?1049l");
+    mirrorUpdate(true);
+
+    screen.write("\033[3J");
+    writeLines(screen, 100, 2);
+    mirrorUpdate(false);
+
+    auto const data = snapshot::encodeUpdate(screen.takeUpdate(historySerialEnd, false));
+    CHECK_FALSE(snapshot::decodeUpdate(crispy::span<uint8_t const>(data.data(), data.data() + data.size() - 1)));
+}
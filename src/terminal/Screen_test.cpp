@@ -13,7 +13,9 @@
  */
 #include <terminal/Screen.h>
 #include <terminal/Viewport.h>
+#include <crispy/base64.h>
 #include <catch2/catch.hpp>
+#include <map>
 #include <string_view>
 
 using namespace terminal;
@@ -87,6 +89,60 @@ TEST_CASE("Screen.isLineVisible", "[screen]")
     CHECK(viewport.isLineVisible(-2));
 }
 
+TEST_CASE("Viewport.scrollPixels", "[screen]")
+{
+    auto screen = MockScreen{Size{2, 2}};
+    auto viewport = terminal::Viewport{screen};
+    screen.write("1020304050");
+    REQUIRE(screen.historyLineCount() == 3);
+
+    // Scrolling up by less than a row already moves the row above into the viewport.
+    CHECK(viewport.scrollPixels(4, 10));
+    CHECK(viewport.absoluteScrollOffset() == 2);
+    CHECK(viewport.pixelOffset() == 6);
+
+    CHECK(viewport.scrollPixels(16, 10));
+    CHECK(viewport.absoluteScrollOffset() == 1);
+    CHECK(viewport.pixelOffset() == 0);
+
+    CHECK(viewport.scrollPixels(-15, 10));
+    CHECK(viewport.absoluteScrollOffset() == 2);
+    CHECK(viewport.pixelOffset() == 5);
+
+    // The top of the history and the main screen stop at whole rows.
+    CHECK(viewport.scrollPixels(100, 10));
+    CHECK(viewport.absoluteScrollOffset() == 0);
+    CHECK(viewport.pixelOffset() == 0);
+    CHECK_FALSE(viewport.scrollPixels(1, 10));
+
+    CHECK(viewport.scrollPixels(-29, 10));
+    CHECK(viewport.absoluteScrollOffset() == 2);
+    CHECK(viewport.pixelOffset() == 9);
+    CHECK(viewport.scrollPixels(-1, 10));
+    CHECK_FALSE(viewport.scrolled());
+    CHECK(viewport.pixelOffset() == 0);
+}
+
+TEST_CASE("Screen.render.rows", "[screen]")
+{
+    auto screen = MockScreen{Size{2, 2}};
+    screen.write("1020304050");
+
+    auto rendered = std::map<int, std::string>{};
+    auto const renderCell = [&](Coordinate const& _pos, Cell const& _cell) {
+        rendered[_pos.row] += static_cast<char>(_cell.codepoint(0));
+    };
+    auto const renderBlankLine = [&](int _row, Cell const&) { rendered[_row] = "blank"; };
+
+    // The row below the screen is rendered when scrolled.
+    screen.render(renderCell, renderBlankLine, 1, Margin::Range{2, 3});
+    CHECK(rendered == std::map<int, std::string>{{2, "30"}, {3, "40"}});
+
+    rendered.clear();
+    screen.render(renderCell, renderBlankLine, std::nullopt, Margin::Range{2, 3});
+    CHECK(rendered == std::map<int, std::string>{{2, "50"}});
+}
+
 TEST_CASE("AppendChar", "[screen]")
 {
     auto screen = MockScreen{{3, 1}};
@@ -319,6 +375,33 @@ TEST_CASE("AppendChar_AutoWrap", "[screen]")
     REQUIRE("G  " == screen.renderTextLine(2));
 }
 
+TEST_CASE("AppendChar_AutoWrap_bulk", "[screen]")
+{
+    auto screen = MockScreen{{3, 2}};
+    screen.setMode(Mode::AutoWrap, true);
+
+    screen.write("ABCDEFG");
+    REQUIRE("DEF" == screen.renderTextLine(1));
+    REQUIRE("G  " == screen.renderTextLine(2));
+    REQUIRE(screen.cursorPosition() == Coordinate{2, 2});
+
+    screen.setMode(Mode::AutoWrap, false);
+    screen.write("HIJK");
+    REQUIRE("GHK" == screen.renderTextLine(2));
+    REQUIRE(screen.cursorPosition() == Coordinate{2, 3});
+}
+
+TEST_CASE("AppendChar_AutoWrap_bulk_LeftRightMargin", "[screen]")
+{
+    auto screen = MockScreen{{14, 2}};
+    screen.setMode(Mode::AutoWrap, true);
+
+    // The cursor starts left of the margins and wraps at the right margin once it entered them.
+    screen.write("\033[?69h\033[9;11s\033[3GABCDEFGHIJKL");
+    CHECK("  ABCDEFGHI   " == screen.renderTextLine(1));
+    CHECK("        JKL   " == screen.renderTextLine(2));
+}
+
 TEST_CASE("AppendChar_AutoWrap_LF", "[screen]")
 {
     auto screen = MockScreen{{3, 2}};
@@ -758,6 +841,376 @@ TEST_CASE("ClearScrollbackBuffer", "[screen]")
     REQUIRE("12345" == screen.renderHistoryTextLine(1));
 }
 
+TEST_CASE("ScrollUp.bounded_history", "[screen]")
+{
+    auto screen = MockScreen{{5, 3}};
+    screen.setMaxHistoryLineCount(2);
+    screen.write("11111\r\n22222\r\n33333\r\n44444\r\n55555\r\n66666\033[m");
+    REQUIRE("44444\n55555\n66666\n" == screen.renderText());
+    REQUIRE(2 == screen.scrollbackLines().size());
+    CHECK("33333" == screen.renderHistoryTextLine(1));
+    CHECK("22222" == screen.renderHistoryTextLine(2));
+
+    // recycled lines must come back blank
+    screen.write("\r\n");
+    CHECK("55555\n66666\n     \n" == screen.renderText());
+    CHECK("44444" == screen.renderHistoryTextLine(1));
+}
+
+TEST_CASE("SavedLines.paged", "[screen]")
+{
+    auto screen = MockScreen{{6, 2}};
+    for (int i = 1; i <= 2000; ++i)
+        screen.write(fmt::format("\033[{}m{:04}\r\n", 30 + i % 8, i));
+
+    auto const& savedLines = screen.scrollbackLines();
+    REQUIRE(savedLines.size() == 1999);
+    CHECK(savedLines.residentSize() > 0);
+
+    auto const checkHistory = [&]() {
+        CHECK("1999  " == screen.renderHistoryTextLine(1));
+        CHECK("1000  " == screen.renderHistoryTextLine(1000));
+        CHECK("0001  " == screen.renderHistoryTextLine(1999));
+        CHECK(screen.at({1 - screen.historyLineCount(), 1}).attributes().foregroundColor == Color{IndexedColor::Red});
+    };
+    checkHistory();
+
+    SECTION("spilled") {
+        screen.setHistorySpillThreshold(0);
+        CHECK(savedLines.residentSize() == 0);
+        CHECK(savedLines.spilledSize() > 0);
+        checkHistory();
+    }
+
+    SECTION("bounded") {
+        screen.setMaxHistoryLineCount(1500);
+        REQUIRE(savedLines.size() == 1500);
+        CHECK("0500  " == screen.renderHistoryTextLine(1500));
+        CHECK("1999  " == screen.renderHistoryTextLine(1));
+    }
+
+    SECTION("repaged") {
+        screen.setHistoryPaging(100, 1);
+        CHECK(savedLines.pageSize() == 100);
+        CHECK(savedLines.cachedPageCount() == 1);
+        REQUIRE(savedLines.size() == 1999);
+        checkHistory();
+
+        screen.setHistoryPaging(SavedLines::DefaultPageSize, SavedLines::DefaultCachedPageCount);
+        REQUIRE(savedLines.size() == 1999);
+        checkHistory();
+    }
+}
+
+TEST_CASE("SavedLines.appendOutput", "[screen]")
+{
+    auto screen = MockScreen{{6, 2}};
+    auto output = string{};
+    for (int i = 1; i <= 600; ++i)
+        output += fmt::format("{}{:04}\n", i == 200 ? "\033[31m" : "", i);
+    output += "last";
+    screen.openHistory(crispy::span<uint8_t const>{reinterpret_cast<uint8_t const*>(output.data()),
+                                                   reinterpret_cast<uint8_t const*>(output.data() + output.size())},
+                       nullptr);
+
+    // Two pages are split off, and the remaining lines are parsed right away.
+    auto const& savedLines = screen.scrollbackLines();
+    REQUIRE(savedLines.size() == 601);
+    CHECK(savedLines.residentSize() == 0);
+
+    auto buffer = string{};
+    CHECK(savedLines.text(256, buffer) == "0257");
+
+    CHECK("last  " == screen.renderHistoryTextLine(1));
+    CHECK("0600  " == screen.renderHistoryTextLine(2));
+    CHECK("0001  " == screen.renderHistoryTextLine(601));
+
+    // The second page starts with the graphics rendition set on the first one.
+    auto const lineRow = [&](int _line) { return _line - screen.historyLineCount(); };
+    CHECK(screen.at({lineRow(1), 1}).attributes().foregroundColor == Color{DefaultColor{}});
+    CHECK(screen.at({lineRow(200), 1}).attributes().foregroundColor == Color{IndexedColor::Red});
+    CHECK(screen.at({lineRow(257), 1}).attributes().foregroundColor == Color{IndexedColor::Red});
+}
+
+TEST_CASE("SavedLines.openHistory_limit", "[screen]")
+{
+    auto screen = MockScreen{{6, 2}};
+    screen.setMaxHistoryLineCount(100);
+
+    auto output = string{};
+    for (int i = 1; i <= 600; ++i)
+        output += fmt::format("{:04}\n", i);
+    auto const open = [&]() {
+        screen.openHistory(crispy::span<uint8_t const>{reinterpret_cast<uint8_t const*>(output.data()),
+                                                       reinterpret_cast<uint8_t const*>(output.data() + output.size())},
+                           nullptr);
+    };
+
+    // The file is kept as a whole, with the configured room for output following.
+    open();
+    open();
+    REQUIRE(screen.historyLineCount() == 600);
+    for (int i = 0; i < 150; ++i)
+        screen.write("x\r\n");
+    CHECK(screen.historyLineCount() == 700);
+
+    // Clearing the history goes back to the configured limit.
+    screen.clearScrollbackBuffer();
+    for (int i = 0; i < 300; ++i)
+        screen.write("x\r\n");
+    CHECK(screen.historyLineCount() == 100);
+}
+
+TEST_CASE("SavedLines.pop_back", "[screen]")
+{
+    auto savedLines = SavedLines{};
+    auto const lineCount = 5 * SavedLines::DefaultPageSize;
+    for (size_t i = 0; i < lineCount; ++i)
+    {
+        auto line = Line(3, Cell{static_cast<char32_t>('A' + i % 26), GraphicsAttributes{}});
+        line.marked = i % 7 == 0;
+        savedLines.emplace_back(std::move(line));
+    }
+    savedLines.pop_front();
+
+    for (size_t i = lineCount - 1; i > 0; --i)
+    {
+        REQUIRE(savedLines.size() == i);
+        CHECK(savedLines.marked(i - 1) == ((i % 7) == 0));
+        REQUIRE(savedLines.back()[0].codepoint(0) == static_cast<char32_t>('A' + i % 26));
+        CHECK(savedLines.back().marked == ((i % 7) == 0));
+        savedLines.pop_back();
+    }
+    CHECK(savedLines.empty());
+}
+
+TEST_CASE("SavedLines.setPaging", "[screen]")
+{
+    auto savedLines = SavedLines{};
+    auto const lineCount = 5 * SavedLines::DefaultPageSize;
+    for (size_t i = 0; i < lineCount; ++i)
+    {
+        auto line = Line(3, Cell{static_cast<char32_t>('A' + i % 26), GraphicsAttributes{}});
+        line.marked = i % 7 == 0;
+        savedLines.emplace_back(std::move(line));
+    }
+    savedLines.pop_front();
+
+    savedLines.setPaging(64, 2);
+    REQUIRE(savedLines.size() == lineCount - 1);
+    CHECK(savedLines.packedLineCount() > 0);
+    for (size_t i = 0; i < savedLines.size(); ++i)
+    {
+        CHECK(savedLines.at(i)[0].codepoint(0) == static_cast<char32_t>('A' + (i + 1) % 26));
+        CHECK(savedLines.marked(i) == ((i + 1) % 7 == 0));
+    }
+    CHECK(savedLines.markedRowAfter(0) == 6);
+}
+
+TEST_CASE("SavedLines.markedRows", "[screen]")
+{
+    auto savedLines = SavedLines{};
+    auto const lineCount = 5 * SavedLines::DefaultPageSize;
+    for (size_t i = 0; i < lineCount; ++i)
+    {
+        auto line = Line(3, Cell{});
+        line.marked = i % 100 == 0;
+        savedLines.emplace_back(std::move(line));
+    }
+
+    CHECK_FALSE(savedLines.markedRowBefore(0).has_value());
+    CHECK(savedLines.markedRowBefore(1) == 0);
+    CHECK(savedLines.markedRowBefore(100) == 0);
+    CHECK(savedLines.markedRowBefore(101) == 100);
+    CHECK(savedLines.markedRowBefore(lineCount + 10) == (lineCount - 1) / 100 * 100);
+    CHECK(savedLines.markedRowAfter(0) == 100);
+    CHECK(savedLines.markedRowAfter(99) == 100);
+    CHECK(savedLines.markedRowAfter(100) == 200);
+    CHECK_FALSE(savedLines.markedRowAfter((lineCount - 1) / 100 * 100).has_value());
+
+    SECTION("pop_front") {
+        for (auto i = 0; i < 150; ++i)
+            savedLines.pop_front();
+        CHECK_FALSE(savedLines.markedRowBefore(50).has_value());
+        CHECK(savedLines.markedRowBefore(51) == 50);
+        CHECK(savedLines.markedRowAfter(0) == 50);
+    }
+
+    SECTION("pop_back") {
+        while (savedLines.size() > 201)
+            savedLines.pop_back();
+        CHECK(savedLines.markedRowBefore(201) == 200);
+        savedLines.pop_back();
+        CHECK(savedLines.markedRowBefore(200) == 100);
+        CHECK_FALSE(savedLines.markedRowAfter(100).has_value());
+    }
+
+    SECTION("clear") {
+        savedLines.clear();
+        auto line = Line(3, Cell{});
+        line.marked = true;
+        savedLines.emplace_back(std::move(line));
+        CHECK(savedLines.markedRowBefore(1) == 0);
+        CHECK_FALSE(savedLines.markedRowAfter(0).has_value());
+    }
+}
+
+TEST_CASE("SavedLines.bounded_by_rows", "[screen]")
+{
+    auto screen = MockScreen{{8, 2}};
+    screen.setMaxHistoryLineCount(10);
+
+    // A single logical line, spanning far more rows than the history may hold.
+    for (int i = 0; i < 100; ++i)
+        screen.write(fmt::format("{:08}", i));
+
+    CHECK(screen.historyLineCount() == 10);
+    CHECK(screen.scrollbackLines().size() == 1);
+    CHECK(screen.scrollbackLines().at(0).size() <= 11 * 8);
+    CHECK("00000097" == screen.renderHistoryTextLine(1));
+    CHECK("00000088" == screen.renderHistoryTextLine(10));
+
+    SECTION("packed") {
+        auto packed = MockScreen{{8, 2}};
+        for (int i = 0; i < 100; ++i)
+            packed.write(fmt::format("{:08}", i));
+        for (auto i = 0u; i < 4 * SavedLines::DefaultPageSize; ++i)
+            packed.write("\r\nx");
+        REQUIRE(packed.scrollbackLines().packedLineCount() > 0);
+
+        auto const rowCount = static_cast<size_t>(packed.historyLineCount());
+        packed.setMaxHistoryLineCount(rowCount - 50);
+        CHECK(packed.historyLineCount() == static_cast<int>(rowCount - 50));
+        CHECK("00000050" == packed.renderHistoryTextLine(packed.historyLineCount()));
+        CHECK("00000099" == packed.renderHistoryTextLine(packed.historyLineCount() - 49));
+    }
+}
+
+TEST_CASE("SavedLines.blank_continuation", "[screen]")
+{
+    auto screen = MockScreen{{4, 2}};
+
+    // The second row continues the first one, and is blanked after wrapping.
+    screen.write("HHHHx\b\033[K\r\nA\r\nB\r\n");
+
+    REQUIRE(screen.historyLineCount() == 3);
+    CHECK("HHHH" == screen.renderHistoryTextLine(3));
+    CHECK("    " == screen.renderHistoryTextLine(2));
+    CHECK("A   " == screen.renderHistoryTextLine(1));
+
+    // The rows joined are kept when the lines are packed and decoded again.
+    screen.setHistoryPaging(1, 1);
+    REQUIRE(screen.historyLineCount() == 3);
+    CHECK("    " == screen.renderHistoryTextLine(2));
+}
+
+TEST_CASE("SavedLines.reflow", "[screen]")
+{
+    auto screen = MockScreen{{4, 2}};
+    screen.write("ABCDEFGHIJ\r\nxy\r\n\r\n\r\n");
+
+    REQUIRE(screen.scrollbackLines().size() == 3);
+    REQUIRE(screen.historyLineCount() == 5);
+    CHECK("ABCD" == screen.renderHistoryTextLine(5));
+    CHECK("EFGH" == screen.renderHistoryTextLine(4));
+    CHECK("IJ  " == screen.renderHistoryTextLine(3));
+    CHECK("xy  " == screen.renderHistoryTextLine(2));
+
+    SECTION("wider") {
+        screen.resize({5, 2});
+        REQUIRE(screen.historyLineCount() == 4);
+        CHECK("ABCDE" == screen.renderHistoryTextLine(4));
+        CHECK("FGHIJ" == screen.renderHistoryTextLine(3));
+        CHECK("xy   " == screen.renderHistoryTextLine(2));
+
+        screen.resize({12, 2});
+        REQUIRE(screen.historyLineCount() == 3);
+        CHECK("ABCDEFGHIJ  " == screen.renderHistoryTextLine(3));
+    }
+
+    SECTION("narrower") {
+        screen.resize({3, 2});
+        REQUIRE(screen.historyLineCount() == 6);
+        CHECK("ABC" == screen.renderHistoryTextLine(6));
+        CHECK("J  " == screen.renderHistoryTextLine(3));
+    }
+
+    SECTION("taller") {
+        screen.resize({4, 6});
+        CHECK(screen.historyLineCount() == 1);
+        CHECK("ABCD" == screen.renderHistoryTextLine(1));
+        CHECK("EFGH\nIJ  \nxy  \n    \n    \n    \n" == screen.renderText());
+    }
+}
+
+TEST_CASE("Screen.damage", "[screen]")
+{
+    auto screen = MockScreen{{5, 4}};
+    REQUIRE(screen.damagedRows().has_value());
+    screen.clearDamage();
+    REQUIRE_FALSE(screen.damagedRows().has_value());
+
+    SECTION("text") {
+        screen.write("\033[2;3Habc");
+        REQUIRE(screen.damagedRows() == Margin::Range{2, 2});
+        CHECK_FALSE(screen.isLineDamaged(1));
+        CHECK(screen.isLineDamaged(2));
+        CHECK_FALSE(screen.isLineDamaged(3));
+
+        screen.clearDamage();
+        CHECK_FALSE(screen.isLineDamaged(2));
+        CHECK_FALSE(screen.damagedRows().has_value());
+    }
+
+    SECTION("unchanged text") {
+        screen.write("\033[0m\033[2;1Habcd\033[3;1H\033[1mx");
+        screen.clearDamage();
+
+        screen.write("\033[0m\033[2;1Habcd\033[3;1H\033[1mx");
+        CHECK_FALSE(screen.damagedRows().has_value());
+
+        screen.write("\033[2;2HB\033[3;1H\033[0mx");
+        REQUIRE(screen.damagedRows() == Margin::Range{2, 3});
+        CHECK(screen.renderTextLine(2) == "aBcd ");
+    }
+
+    SECTION("cursor movement and SGR") {
+        screen.write("\033[3;4H\033[1;31m\033[1A");
+        CHECK_FALSE(screen.damagedRows().has_value());
+    }
+
+    SECTION("erase and insert") {
+        screen.write("\033[3;1H\033[K\033[1;1H\033[2@");
+        REQUIRE(screen.damagedRows() == Margin::Range{1, 3});
+        CHECK(screen.isLineDamaged(1));
+        CHECK_FALSE(screen.isLineDamaged(2));
+        CHECK(screen.isLineDamaged(3));
+    }
+
+    SECTION("scroll region") {
+        screen.write("\033[2;3r\033[1S");
+        REQUIRE(screen.damagedRows() == Margin::Range{2, 3});
+        CHECK_FALSE(screen.isLineDamaged(4));
+    }
+
+    SECTION("linefeed at bottom") {
+        screen.write("\033[4;1H\n");
+        CHECK(screen.scrolledLines() == 1);
+        CHECK(screen.damagedRows() == Margin::Range{4, 4});
+
+        screen.clearDamage();
+        screen.write("\033[3;1Hx\033[4;1H\n");
+        CHECK(screen.scrolledLines() == 1);
+        REQUIRE(screen.damagedRows() == Margin::Range{2, 4});
+        CHECK(screen.isLineDamaged(2));
+        CHECK_FALSE(screen.isLineDamaged(3));
+        CHECK(screen.isLineDamaged(4));
+
+        screen.clearDamage();
+        CHECK(screen.scrolledLines() == 0);
+    }
+}
+
 TEST_CASE("EraseCharacters", "[screen]")
 {
     auto screen = MockScreen{{5, 5}};
@@ -822,6 +1275,24 @@ TEST_CASE("ScrollUp", "[screen]")
     }
 }
 
+TEST_CASE("ScrollUp.status_line", "[screen]")
+{
+    // A top-anchored scroll region above a status line, as used by tmux or vim.
+    auto screen = MockScreen{{2, 5}};
+    screen.write("AB\r\nCD\r\nEF\r\nGH\r\nst");
+    screen.setTopBottomMargin(1, 4);
+
+    screen.scrollUp(1);
+    CHECK("CD\nEF\nGH\n  \nst\n" == screen.renderText());
+
+    screen.scrollDown(2);
+    CHECK("  \n  \nCD\nEF\nst\n" == screen.renderText());
+
+    screen.setTopBottomMargin(2, 5);
+    screen.scrollUp(1);
+    CHECK("  \nCD\nEF\nst\n  \n" == screen.renderText());
+}
+
 TEST_CASE("ScrollDown", "[screen]")
 {
     auto screen = MockScreen{{5, 5}};
@@ -1750,6 +2221,36 @@ TEST_CASE("render into history", "[screen]")
     }
 }
 
+TEST_CASE("render blank lines", "[screen]")
+{
+    auto screen = MockScreen{{3, 4}};
+    screen.write("ABC\r\nDEF\r\nGHI\r\nJKL\033[2;2H\033[41m\033[J");
+
+    vector<int> blankRows;
+    string renderedText;
+    auto const renderCell = [&](Coordinate const&, Cell const& cell) {
+        renderedText += cell.empty() ? ' ' : static_cast<char>(cell.codepoint(0));
+    };
+    auto const renderBlankLine = [&](int row, Cell const& cell) {
+        blankRows.push_back(row);
+        CHECK(cell.attributes().backgroundColor == Color{IndexedColor::Red});
+    };
+
+    screen.render(renderCell, renderBlankLine, nullopt);
+    CHECK(blankRows == vector{3, 4});
+    CHECK(renderedText == "ABCD  ");
+
+    // Writing into a blank line materializes it.
+    screen.write("\033[4;2Hx");
+    blankRows.clear();
+    renderedText.clear();
+    screen.render(renderCell, renderBlankLine, nullopt);
+    CHECK(blankRows == vector{3});
+    CHECK(renderedText == "ABCD   x ");
+    CHECK(screen.at({4, 3}).attributes().backgroundColor == Color{IndexedColor::Red});
+    CHECK("ABC\nD  \n   \n x \n" == screen.renderText());
+}
+
 TEST_CASE("HorizontalTabClear.AllTabs", "[screen]")
 {
     auto screen = MockScreen{{5, 3}};
@@ -2210,6 +2711,78 @@ TEST_CASE("findMarkerBackward", "[screen]")
     }
 }
 
+TEST_CASE("foldOutput", "[screen]")
+{
+    auto screen = MockScreen{{4, 2}};
+    auto viewport = terminal::Viewport{screen};
+    screen.write("pre\r\n"sv);          // 0
+    screen.setMark();
+    screen.write("$ a\r\n"sv);          // 1
+    for (auto i = 1; i <= 5; ++i)
+        screen.write(fmt::format("o{}\r\n", i)); // 2..6
+    screen.setMark();
+    screen.write("$ b\r\np1\r\np2\r\n"sv); // 7, 8
+    REQUIRE(screen.historyLineCount() == 9);
+
+    string renderedText;
+    auto const renderer = [&](Coordinate const& pos, Cell const& cell) {
+        if (pos.column == 1 && pos.row > 1)
+            renderedText += '\n';
+        renderedText += cell.codepointCount() ? static_cast<char>(cell.codepoint(0)) : ' ';
+    };
+
+    CHECK_FALSE(screen.foldOutput(0)); // no mark above
+    REQUIRE(screen.foldOutput(4));
+    CHECK(screen.foldedRowCount() == 5);
+    CHECK(screen.absoluteRowOf(1) == 1);
+    CHECK(screen.absoluteRowOf(2) == 7);
+    CHECK(screen.visibleRowOf(4) == 2);
+    CHECK(screen.visibleRowOf(7) == 2);
+    CHECK(screen.visibleRowOf(9) == 4);
+
+    SECTION("render") {
+        screen.render(renderer, 1);
+        CHECK(renderedText == "$ a \n$ b ");
+    }
+
+    SECTION("scroll") {
+        viewport.scrollUp(2);
+        REQUIRE(viewport.absoluteScrollOffset() == 7);
+        CHECK(viewport.relativeScrollOffset() == 2);
+        CHECK(viewport.absoluteRow(1) == 8);
+        viewport.scrollUp(1);
+        CHECK(viewport.absoluteScrollOffset() == 1);
+        viewport.scrollDown(1);
+        CHECK(viewport.absoluteScrollOffset() == 7);
+    }
+
+    SECTION("last output") {
+        // The output of the last command is folded up to the main screen.
+        REQUIRE(screen.foldOutput(8));
+        CHECK(screen.foldedRowCount() == 6);
+        CHECK(screen.absoluteRowOf(3) == 9);
+    }
+
+    SECTION("toggle") {
+        CHECK(screen.toggleFold(1));
+        CHECK(screen.foldedRowCount() == 0);
+        CHECK(screen.toggleFold(6));
+        CHECK(screen.foldedRowCount() == 5);
+    }
+
+    SECTION("evicted") {
+        screen.setMaxHistoryLineCount(5);
+        REQUIRE(screen.historyLineCount() == 5);
+        CHECK(screen.foldedRowCount() == 3);
+        CHECK(screen.absoluteRowOf(0) == 3);
+    }
+
+    SECTION("cleared") {
+        screen.clearScrollbackBuffer();
+        CHECK(screen.foldedRowCount() == 0);
+    }
+}
+
 TEST_CASE("DECTABSR", "[screen]")
 {
     auto screen = MockScreen{{35, 2}};
@@ -2245,6 +2818,22 @@ TEST_CASE("DECTABSR", "[screen]")
     }
 }
 
+TEST_CASE("SGR.sub_parameters", "[screen]")
+{
+    auto screen = MockScreen{{4, 1}};
+
+    screen.write("\033[1;38:2:1:2:3;48:5:4mA\033[0mB");
+
+    auto const& a = screen.at({1, 1}).attributes();
+    CHECK(a.styles & CharacterStyleMask::Bold);
+    CHECK(a.foregroundColor == Color{RGBColor{1, 2, 3}});
+    CHECK(a.backgroundColor == Color{IndexedColor::Blue});
+
+    auto const& b = screen.at({1, 2}).attributes();
+    CHECK(b.foregroundColor == Color{DefaultColor{}});
+    CHECK(b.backgroundColor == Color{DefaultColor{}});
+}
+
 TEST_CASE("save_restore_DEC_modes", "[screen]")
 {
     auto screen = MockScreen{{2, 2}};
@@ -2259,6 +2848,27 @@ TEST_CASE("save_restore_DEC_modes", "[screen]")
     CHECK_FALSE(screen.isModeEnabled(Mode::MouseProtocolHighlightTracking));
 }
 
+TEST_CASE("save_restore_DEC_modes.nested", "[screen]")
+{
+    auto screen = MockScreen{{2, 2}};
+
+    screen.setMode(Mode::BracketedPaste, true);
+    screen.saveModes(vector{Mode::BracketedPaste});
+    screen.setMode(Mode::BracketedPaste, false);
+    screen.saveModes(vector{Mode::BracketedPaste});
+    screen.setMode(Mode::BracketedPaste, true);
+
+    screen.restoreModes(vector{Mode::BracketedPaste});
+    CHECK_FALSE(screen.isModeEnabled(Mode::BracketedPaste));
+
+    screen.restoreModes(vector{Mode::BracketedPaste});
+    CHECK(screen.isModeEnabled(Mode::BracketedPaste));
+
+    // Restoring beyond the saved depth leaves the mode untouched.
+    screen.restoreModes(vector{Mode::BracketedPaste});
+    CHECK(screen.isModeEnabled(Mode::BracketedPaste));
+}
+
 TEST_CASE("resize", "[screen]")
 {
     auto screen = MockScreen{{2, 2}};
@@ -2362,8 +2972,27 @@ TEST_CASE("resize", "[screen]")
 // TODO: SendMouseEvents
 // TODO: AlternateKeypadMode
 
-// TODO: DesignateCharset
-// TODO: SingleShiftSelect
+TEST_CASE("DesignateCharset", "[screen]")
+{
+    auto screen = MockScreen{Size{6, 2}};
+
+    // DEC Special Graphics applies to whole runs of text, and no longer once US-ASCII is designated again.
+    screen.write("\033(0lqqk\033(Bqq");
+    CHECK(screen.renderTextLine(1) == "\u250C\u2500\u2500\u2510qq");
+}
+
+TEST_CASE("SingleShiftSelect", "[screen]")
+{
+    auto screen = MockScreen{Size{6, 2}};
+
+    // The single shift applies to the first character of the run only.
+    screen.designateCharset(CharsetTable::G2, CharsetId::Special);
+    screen.write("\033Nqqq");
+    CHECK(screen.renderTextLine(1) == "\u2500qq   ");
+
+    screen.write("\r\nqq\033Nq");
+    CHECK(screen.renderTextLine(2) == "qq\u2500   ");
+}
 
 // TODO: ChangeWindowTitle
 
@@ -2373,3 +3002,261 @@ TEST_CASE("resize", "[screen]")
 // TODO: DeviceStatusReport
 // TODO: SendDeviceAttributes
 // TODO: SendTerminalId
+
+TEST_CASE("OSC.1337.inline_image", "[screen]")
+{
+    auto screen = MockScreen{{6, 4}};
+    screen.setCellPixelSize(Size{10, 10});
+
+    // Only the header of a 20x10 pixel PNG, as the image is decoded asynchronously.
+    auto const png = string("\x89PNG\r\n\x1A\n\0\0\0\x0DIHDR\0\0\0\x14\0\0\0\x0A", 24);
+    screen.write(fmt::format("\033]1337;File=name=eC5wbmc=;inline=1;width=4;preserveAspectRatio=1:{}\033\\",
+                             crispy::base64::encode(png)));
+
+    // Scaled to 4 cells wide, preserving the aspect ratio.
+    CHECK(screen.at({1, 1}).imageFragment().has_value());
+    CHECK(screen.at({2, 4}).imageFragment().has_value());
+    CHECK_FALSE(screen.at({1, 5}).imageFragment().has_value());
+    CHECK_FALSE(screen.at({3, 1}).imageFragment().has_value());
+    CHECK(screen.cursorPosition() == Coordinate{3, 1});
+    CHECK(screen.imagePool().imageCount() == 1);
+
+    // Without inline=1, files are not displayed.
+    screen.write(fmt::format("\033]1337;File=size=24:{}\033\\", crispy::base64::encode(png)));
+    CHECK(screen.cursorPosition() == Coordinate{3, 1});
+}
+
+TEST_CASE("Cell.compact", "[screen]")
+{
+    static_assert(sizeof(Cell) <= 16);
+
+    auto attributes = GraphicsAttributes{};
+    attributes.foregroundColor = RGBColor{0x12, 0x34, 0x56};
+    attributes.styles |= CharacterStyleMask::Bold;
+
+    auto a = Cell{'A', attributes};
+    auto b = Cell{'B', attributes};
+    CHECK(a.attributesId() == b.attributesId());
+    CHECK(a.attributesId() != GraphicsAttributesTable::DefaultId);
+    CHECK(a.attributes() == attributes);
+    CHECK(Cell{}.attributes() == GraphicsAttributes{});
+
+    a.appendCharacter(0x0301);
+    CHECK(a.codepointCount() == 2);
+    CHECK(a.codepoints() == U"A\u0301");
+
+    auto const c = a; // deep copies the combining codepoints
+    a.setCharacter('X');
+    CHECK(a.codepoints() == U"X");
+    CHECK(c.codepoints() == U"A\u0301");
+    CHECK(c.attributes() == attributes);
+}
+
+TEST_CASE("Screen.appendRowText", "[screen]")
+{
+    auto screen = MockScreen{Size{2, 1}};
+    screen.write("10203040");
+    REQUIRE(screen.historyLineCount() == 3);
+
+    // Absolute rows count from the oldest history row.
+    auto text = string{};
+    screen.appendRowText(1, 1, 2, text);
+    screen.appendRowText(2, 2, 2, text);
+    screen.appendRowText(3, 1, 1, text);
+    screen.appendRowText(4, 1, 2, text);
+    CHECK(text == "10" "0" "3" "40");
+
+    text.clear();
+    screen.appendRowText(4, 2, 1, text);
+    screen.appendRowText(5, 1, 2, text);
+    CHECK(text.empty());
+}
+
+TEST_CASE("Screen.continuesLine", "[screen]")
+{
+    auto screen = MockScreen{Size{2, 2}};
+    screen.write("1020304\r\n56");
+    REQUIRE(screen.historyLineCount() == 3);
+
+    // "1020304" spans the absolute rows 1 to 4, of which the last three continue it.
+    CHECK_FALSE(screen.continuesLine(1));
+    CHECK(screen.continuesLine(2));
+    CHECK(screen.continuesLine(3));
+    CHECK(screen.continuesLine(4));
+    CHECK_FALSE(screen.continuesLine(5));
+    CHECK_FALSE(screen.continuesLine(6));
+}
+
+TEST_CASE("Screen.exportLines", "[screen]")
+{
+    auto screen = MockScreen{Size{4, 2}};
+    screen.write("ab\033[1;31mcdef\033[m\r\ngh");
+    REQUIRE(screen.historyLineCount() == 1);
+
+    // "abcdef" continues from the history into the first row.
+    auto text = string{};
+    screen.exportLines(screen.firstLineSerial(), 10, ExportFormat::Text, text);
+    CHECK(text == "abcdef\ngh\n");
+
+    auto vt = string{};
+    screen.exportLines(screen.firstLineSerial(), 10, ExportFormat::VT, vt);
+    CHECK(vt == "ab\033[0;1;31mcdef\033[m\ngh\n");
+
+    // Only the given range of lines is exported.
+    auto last = string{};
+    screen.exportLines(screen.firstLineSerial() + 1, 1, ExportFormat::Text, last);
+    CHECK(last == "gh\n");
+}
+
+TEST_CASE("Screen.implicitHyperlinkAt", "[screen]")
+{
+    auto screen = MockScreen{Size{8, 3}};
+    screen.write("go http://x.org/ab\r\n");
+    REQUIRE(screen.historyLineCount() == 1);
+
+    // The link is wrapped from the history into the rows of the screen.
+    auto const link = screen.implicitHyperlinkAt(Coordinate{2, 2});
+    REQUIRE(link.has_value());
+    CHECK(screen.hyperlinks().get(link->hyperlink)->uri == "http://x.org/ab");
+    CHECK(link->from == Coordinate{1, 4});
+    CHECK(link->to == Coordinate{3, 2});
+    CHECK(!screen.implicitHyperlinkAt(Coordinate{1, 2}).has_value());
+    CHECK(!screen.implicitHyperlinkAt(Coordinate{3, 3}).has_value());
+
+    // Lookups of unmodified lines share the link, modified lines are scanned again.
+    CHECK(screen.implicitHyperlinkAt(Coordinate{1, 5})->hyperlink == link->hyperlink);
+    screen.write("/tmp/a.txt");
+    auto const path = screen.implicitHyperlinkAt(Coordinate{5, 1});
+    REQUIRE(path.has_value());
+    CHECK(screen.hyperlinks().get(path->hyperlink)->uri == "file:///tmp/a.txt");
+    CHECK(path->from == Coordinate{4, 1});
+    CHECK(path->to == Coordinate{5, 2});
+    CHECK(screen.implicitHyperlinkAt(Coordinate{2, 2})->hyperlink == link->hyperlink);
+
+    screen.write("\r\033[2Kx ftp://y");
+    CHECK(screen.hyperlinks().get(screen.implicitHyperlinkAt(Coordinate{5, 3})->hyperlink)->uri == "ftp://y");
+}
+
+TEST_CASE("Screen.hyperlinks", "[screen]")
+{
+    auto screen = MockScreen{Size{8, 2}};
+    screen.write("\033]8;id=a;file://host/x\033\\ab\033]8;;\033\\\r\n");
+    auto const id = screen.at({1, 1}).hyperlink();
+    auto const* hyperlink = screen.hyperlinks().get(id);
+    REQUIRE(hyperlink != nullptr);
+    CHECK(hyperlink->isLocal());
+    CHECK(hyperlink->scheme() == "file");
+    CHECK(hyperlink->host() == "host");
+    CHECK(hyperlink->path() == "/x");
+    CHECK(screen.at({1, 2}).hyperlink() == id);
+    CHECK(screen.at({1, 3}).hyperlink() == 0);
+
+    // Hyperlinks no longer referred to by any cell are released eventually.
+    for (int i = 0; i < 4096; ++i)
+        screen.write("\033]8;;http://y\033\\c\033]8;;\033\\\r");
+    CHECK(screen.hyperlinks().size() <= 1024);
+    REQUIRE(screen.hyperlinks().get(id) != nullptr);
+    CHECK(screen.hyperlinks().get(id)->uri == "file://host/x");
+    CHECK(screen.hyperlinks().get(screen.at({2, 1}).hyperlink())->uri == "http://y");
+}
+
+TEST_CASE("Screen.memoryUsage", "[screen]")
+{
+    auto screen = MockScreen{Size{8, 2}};
+    auto const initial = screen.memoryUsage();
+    CHECK(initial.lines >= 2 * 8 * sizeof(Cell));
+    CHECK(initial.cellExtras == 0);
+    CHECK(initial.images == 0);
+
+    // Combining codepoints are stored out-of-line.
+    screen.write("e\xCC\x81");
+    CHECK(screen.memoryUsage().cellExtras > 0);
+
+    for (int i = 0; i < 10; ++i)
+        screen.write("line\r\n");
+    REQUIRE(screen.historyLineCount() > 0);
+
+    auto const usage = screen.memoryUsage();
+    CHECK(usage.history > initial.history);
+    CHECK(usage.total() == usage.lines + usage.history + usage.cellExtras + usage.hyperlinks + usage.attributes + usage.images);
+}
+
+TEST_CASE("Screen.boundedPathologicalInput", "[screen]")
+{
+    auto screen = MockScreen{Size{10, 2}};
+
+    SECTION("window title stack") {
+        for (int i = 0; i < 1000; ++i)
+        {
+            screen.Screen::setWindowTitle(std::to_string(i));
+            screen.saveWindowTitle();
+        }
+        // Only the most recently saved titles are kept.
+        for (size_t i = 0; i < 2 * Screen::MaxSavedWindowTitles; ++i)
+            screen.restoreWindowTitle();
+        CHECK(screen.windowTitle() == std::to_string(1000 - Screen::MaxSavedWindowTitles));
+    }
+
+    SECTION("repeated tab stop") {
+        screen.horizontalTabClear(HorizontalTabClear::AllTabs);
+        screen.moveCursorToColumn(4);
+        for (int i = 0; i < 1000; ++i)
+            screen.horizontalTabSet();
+        screen.requestTabStops();
+        CHECK(screen.replyData == "\033P2$u4\x5c");
+    }
+
+    SECTION("huge parameters") {
+        // Numbers saturate rather than overflow, and are clamped to the screen.
+        screen.write("\033[99999999999999999999;99999999999999999999H");
+        CHECK(screen.cursorPosition() == Coordinate{2, 10});
+        screen.write("\033[99999999999999999999Z");
+        CHECK(screen.cursorPosition() == Coordinate{2, 1});
+        screen.write("\033[99999999999999999999I");
+        CHECK(screen.cursorPosition().row == 2);
+    }
+}
+
+TEST_CASE("Screen.synchronizeOutput", "[screen]")
+{
+    auto screen = MockScreen{Size{10, 3}};
+    screen.clearDamage();
+
+    screen.write("\033[?2026h");
+    CHECK(screen.synchronizeOutput());
+
+    // The update goes to the screen right away, only its rendering is held back.
+    screen.write("\033[2;3HAB\033[6n");
+    CHECK(screen.renderTextLine(2) == "  AB      ");
+    CHECK(screen.replyData == "\033[2;5R");
+    CHECK(screen.isLineDamaged(2));
+
+    screen.write("\033[?2026l");
+    CHECK_FALSE(screen.synchronizeOutput());
+}
+
+TEST_CASE("Screen.alternateBuffer", "[screen]")
+{
+    auto screen = MockScreen{Size{4, 2}};
+    auto const primaryUsage = screen.memoryUsage().lines;
+
+    // Allocated once used.
+    screen.write("\033[?47hAB");
+    CHECK(screen.renderTextLine(1) == "AB  ");
+    CHECK(screen.memoryUsage().lines > primaryUsage);
+    CHECK_FALSE(screen.releaseAlternateBuffer());
+
+    // Resized once used again.
+    screen.write("\033[?47l");
+    screen.resize(Size{6, 3});
+    screen.write("\033[?47h");
+    CHECK(screen.renderTextLine(1) == "AB    ");
+    CHECK(screen.renderTextLine(3) == "      ");
+
+    // Released while not in use.
+    screen.write("\033[?47l");
+    CHECK(screen.releaseAlternateBuffer());
+    CHECK_FALSE(screen.releaseAlternateBuffer());
+    screen.write("\033[?47h");
+    CHECK(screen.renderTextLine(1) == "      ");
+}
@@ -0,0 +1,319 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2020 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <terminal/Search.h>
+#include <terminal/CodepointProperties.h>
+
+#include <unicode/utf8.h>
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <optional>
+#include <utility>
+#include <variant>
+
+using std::max;
+using std::min;
+using std::move;
+using std::nullopt;
+using std::optional;
+using std::pair;
+using std::regex;
+using std::string;
+using std::string_view;
+using std::vector;
+
+namespace terminal {
+
+namespace
+{
+    char foldCase(char _ch) noexcept
+    {
+        return _ch >= 'A' && _ch <= 'Z' ? static_cast<char>(_ch | 0x20) : _ch;
+    }
+
+    /// Maps byte offsets into a line's text to columns, for monotonically increasing offsets.
+    class ColumnMapper {
+      public:
+        explicit ColumnMapper(string_view _text) : text_{_text} {}
+
+        int operator()(size_t _offset)
+        {
+            for (; offset_ < _offset && offset_ < text_.size(); ++offset_)
+            {
+                auto const result = unicode::from_utf8(state_, static_cast<uint8_t>(text_[offset_]));
+                if (std::holds_alternative<unicode::Success>(result))
+                    column_ += max(CodepointProperties::width(std::get<unicode::Success>(result).value), 1);
+                else if (std::holds_alternative<unicode::Invalid>(result))
+                    ++column_;
+            }
+            return column_;
+        }
+
+      private:
+        string_view text_;
+        unicode::utf8_decoder_state state_{};
+        size_t offset_ = 0;
+        int column_ = 0;
+    };
+
+    auto constexpr LinkSchemes = std::array<string_view, 8>{
+        "file", "ftp", "ftps", "git", "http", "https", "sftp", "ssh"
+    };
+
+    bool isLinkDelimiter(char _ch) noexcept
+    {
+        switch (_ch)
+        {
+            case ' ': case '\t': case '"': case '\'': case '`': case '<': case '>': case '|':
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    bool isPathCharacter(char _ch) noexcept
+    {
+        auto const ch = static_cast<unsigned char>(_ch);
+        return ch >= 0x80 || std::isalnum(ch) || string_view{"._-/~+@%#=,()[]"}.find(_ch) != string_view::npos;
+    }
+
+    /// Strips trailing punctuation, as well as closing brackets not opened within @p _link.
+    string_view trimLinkEnd(string_view _link) noexcept
+    {
+        auto const unbalanced = [&](char _open, char _close) {
+            return std::count(_link.begin(), _link.end(), _open) < std::count(_link.begin(), _link.end(), _close);
+        };
+
+        while (!_link.empty())
+        {
+            auto const ch = _link.back();
+            if (string_view{".,;:!?"}.find(ch) != string_view::npos
+                    || (ch == ')' && unbalanced('(', ')'))
+                    || (ch == ']' && unbalanced('[', ']'))
+                    || (ch == '}' && unbalanced('{', '}')))
+                _link.remove_suffix(1);
+            else
+                break;
+        }
+        return _link;
+    }
+
+    /// @returns the URL within @p _word along with its URI, if any.
+    optional<pair<string_view, string>> detectUrl(string_view _word)
+    {
+        auto const separator = _word.find("://");
+        if (separator == string_view::npos)
+            return nullopt;
+
+        auto const isSchemeCharacter = [](char _ch) {
+            return std::isalnum(static_cast<unsigned char>(_ch)) || _ch == '+' || _ch == '-' || _ch == '.';
+        };
+        auto start = separator;
+        while (start > 0 && isSchemeCharacter(_word[start - 1]))
+            --start;
+        while (start < separator && !std::isalpha(static_cast<unsigned char>(_word[start])))
+            ++start;
+
+        auto scheme = string(_word.substr(start, separator - start));
+        std::transform(scheme.begin(), scheme.end(), scheme.begin(), foldCase);
+        if (std::find(LinkSchemes.begin(), LinkSchemes.end(), scheme) == LinkSchemes.end())
+            return nullopt;
+
+        auto const url = trimLinkEnd(_word.substr(start));
+        if (url.size() <= scheme.size() + 3)
+            return nullopt;
+
+        return pair{url, string(url)};
+    }
+
+    /// @returns the file path within @p _word along with its URI, if any.
+    optional<pair<string_view, string>> detectPath(string_view _word)
+    {
+        while (!_word.empty() && (_word.front() == '(' || _word.front() == '[' || _word.front() == '{'))
+            _word.remove_prefix(1);
+        auto const link = trimLinkEnd(_word);
+
+        // An optional line number, possibly followed by a column number.
+        auto path = link;
+        auto const stripNumber = [&]() {
+            auto const i = path.find_last_not_of("0123456789");
+            if (i == string_view::npos || i + 1 == path.size() || path[i] != ':')
+                return false;
+            path = path.substr(0, i);
+            return true;
+        };
+        auto const numbered = stripNumber();
+        if (numbered)
+            stripNumber();
+
+        if (path.empty() || !std::all_of(path.begin(), path.end(), isPathCharacter))
+            return nullopt;
+
+        if (path.size() > 1 && path[0] == '/' && path[1] != '/')
+            return pair{link, "file://" + string(path)};
+
+        if (path.size() > 2 && path.substr(0, 2) == "~/")
+            return pair{link, string(path)};
+
+        if (numbered && path.find_first_of("./") != string_view::npos && std::isalnum(static_cast<unsigned char>(path.back())))
+            return pair{link, string(path)};
+
+        return nullopt;
+    }
+}
+
+Search::Search(Screen const& _screen, string _pattern, Options _options) :
+    pattern_{move(_pattern)},
+    options_{_options},
+    next_{_screen.lineSerialEnd()}
+{
+    if (options_.regex)
+    {
+        auto flags = regex::ECMAScript | regex::optimize;
+        if (!options_.caseSensitive)
+            flags |= regex::icase;
+        regex_.emplace(pattern_, flags);
+    }
+    else
+    {
+        if (!options_.caseSensitive)
+            std::transform(pattern_.begin(), pattern_.end(), pattern_.begin(), foldCase);
+        trigrams_ = crispy::trigram_filter::of(pattern_);
+    }
+
+    complete_ = pattern_.empty();
+}
+
+bool Search::step(Screen const& _screen, size_t _lineBudget)
+{
+    for (; !complete_ && _lineBudget != 0; --_lineBudget)
+    {
+        if (next_ <= _screen.firstLineSerial())
+        {
+            complete_ = true;
+            break;
+        }
+
+        auto const serial = next_ - 1;
+        if (auto const first = _screen.foldStart(serial); first.has_value())
+        {
+            next_ = *first;
+            continue;
+        }
+
+        if (!trigrams_.empty())
+        {
+            if (auto const first = _screen.firstLineWithout(serial, trigrams_); first.has_value())
+            {
+                next_ = *first;
+                continue;
+            }
+        }
+
+        searchLine(serial, _screen.lineText(serial, buffer_));
+        next_ = serial;
+    }
+
+    return complete_;
+}
+
+void Search::searchLine(size_t _serial, string_view _text)
+{
+    auto mapColumn = ColumnMapper{_text};
+    auto const addMatch = [&](size_t _offset, size_t _length) {
+        auto const column = mapColumn(_offset);
+        matches_.emplace_back(Match{_serial, column, mapColumn(_offset + _length) - column});
+    };
+
+    if (regex_.has_value())
+    {
+        auto const end = std::cregex_iterator{};
+        for (auto i = std::cregex_iterator(_text.data(), _text.data() + _text.size(), *regex_); i != end; ++i)
+            if (i->length() != 0)
+                addMatch(static_cast<size_t>(i->position()), static_cast<size_t>(i->length()));
+        return;
+    }
+
+    auto text = _text;
+    if (!options_.caseSensitive)
+    {
+        foldedBuffer_.resize(_text.size());
+        std::transform(_text.begin(), _text.end(), foldedBuffer_.begin(), foldCase);
+        text = foldedBuffer_;
+    }
+
+    for (auto i = text.find(pattern_); i != string_view::npos; i = text.find(pattern_, i + pattern_.size()))
+        addMatch(i, pattern_.size());
+}
+
+vector<Selector::Range> Search::ranges(Screen const& _screen) const
+{
+    auto const columnCount = _screen.size().width;
+    auto ranges = vector<Selector::Range>{};
+
+    for (Match const& match : matches_)
+    {
+        auto const start = _screen.absoluteCoordinate(match.line, match.column);
+        if (!start.has_value())
+            continue;
+
+        auto row = start->row;
+        auto column = start->column;
+        for (auto remaining = match.length; remaining > 0; ++row, column = 1)
+        {
+            auto const n = min(remaining, columnCount - column + 1);
+            ranges.emplace_back(Selector::Range{row, column, column + n - 1});
+            remaining -= n;
+        }
+    }
+
+    return ranges;
+}
+
+vector<DetectedLink> detectLinks(string_view _text)
+{
+    auto links = vector<DetectedLink>{};
+    auto mapColumn = ColumnMapper{_text};
+
+    for (size_t start = 0; start < _text.size();)
+    {
+        if (isLinkDelimiter(_text[start]))
+        {
+            ++start;
+            continue;
+        }
+
+        auto end = start;
+        while (end < _text.size() && !isLinkDelimiter(_text[end]))
+            ++end;
+
+        auto const word = _text.substr(start, end - start);
+        auto link = detectUrl(word);
+        if (!link.has_value())
+            link = detectPath(word);
+        if (link.has_value())
+        {
+            auto const offset = start + static_cast<size_t>(link->first.data() - word.data());
+            auto const column = mapColumn(offset);
+            links.emplace_back(DetectedLink{column, mapColumn(offset + link->first.size()) - column, move(link->second)});
+        }
+
+        start = end;
+    }
+
+    return links;
+}
+
+} // namespace terminal
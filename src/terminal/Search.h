@@ -0,0 +1,106 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2020 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <terminal/Screen.h>
+#include <terminal/Selector.h>
+
+#include <crispy/trigram_filter.h>
+
+#include <optional>
+#include <regex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace terminal {
+
+/**
+ * Incremental text search in the history and the current buffer of a Screen.
+ *
+ * The search walks the logical lines from the most recent one towards the oldest one in bounded
+ * steps, so that it can be run off the render thread by repeatedly invoking step(), each time
+ * while holding the terminal's lock. Lines appended after the search has been started are not
+ * searched, lines dropped from the history in the meantime are skipped.
+ *
+ * Plain text searches skip whole history pages whose text index rules out a match.
+ * Folded history lines (see Screen::foldOutput()) are skipped as a whole.
+ */
+class Search {
+  public:
+    struct Options {
+        /// Interprets the pattern as an ECMAScript regular expression.
+        bool regex = false;
+        /// Plain text searches only ignore the case of ASCII letters.
+        bool caseSensitive = true;
+    };
+
+    struct Match {
+        /// Serial number of the logical line, see Screen::lineText().
+        size_t line;
+        /// Zero-based column within the logical line.
+        int column;
+        /// Number of columns spanned.
+        int length;
+    };
+
+    /// @throws std::regex_error if @p _pattern is not a valid regular expression.
+    Search(Screen const& _screen, std::string _pattern, Options _options);
+
+    /// Searches at most @p _lineBudget further lines of @p _screen.
+    ///
+    /// @retval true the search is complete.
+    bool step(Screen const& _screen, size_t _lineBudget);
+
+    bool complete() const noexcept { return complete_; }
+
+    /// @returns all matches found so far, starting with the most recent line.
+    std::vector<Match> const& matches() const noexcept { return matches_; }
+
+    /// @returns the cells of all matches still available, in absolute coordinates and with one range per row.
+    std::vector<Selector::Range> ranges(Screen const& _screen) const;
+
+  private:
+    void searchLine(size_t _serial, std::string_view _text);
+
+    std::string pattern_;
+    Options options_;
+    std::optional<std::regex> regex_;
+    crispy::trigram_filter trigrams_;
+
+    size_t next_;           // serial number of the line below the one to be searched next
+    bool complete_ = false;
+    std::vector<Match> matches_;
+    std::string buffer_;
+    std::string foldedBuffer_;
+};
+
+/// A URL or file path found in the text of a logical line, see detectLinks().
+struct DetectedLink {
+    /// Zero-based column within the logical line.
+    int column;
+    /// Number of columns spanned.
+    int length;
+    /// The URL, a "file://" URI for absolute paths, or the path as is if relative to the
+    /// working directory or to the home directory ("~/").
+    std::string uri;
+};
+
+/// Detects URLs of well-known schemes and file paths in the text of a logical line.
+///
+/// Relative paths are only detected with a line number suffix (as in "src/main.cpp:42:7"),
+/// which is spanned by the link but not part of its URI.
+std::vector<DetectedLink> detectLinks(std::string_view _text);
+
+} // namespace terminal
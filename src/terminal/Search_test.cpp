@@ -0,0 +1,189 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2020 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <terminal/Search.h>
+#include <terminal/Screen.h>
+
+#include <catch2/catch.hpp>
+
+#include <fmt/format.h>
+
+#include <limits>
+#include <string>
+#include <vector>
+
+using namespace std;
+using namespace terminal;
+
+namespace
+{
+    class MockScreen : public MockScreenEvents,
+                       public Screen {
+      public:
+        explicit MockScreen(Size const& _size) : Screen{_size, *this} {}
+    };
+
+    size_t constexpr Unbounded = numeric_limits<size_t>::max();
+
+    vector<pair<int, int>> rangeStarts(Search const& _search, Screen const& _screen)
+    {
+        auto starts = vector<pair<int, int>>{};
+        for (auto const& range : _search.ranges(_screen))
+            starts.emplace_back(range.line, range.fromColumn);
+        return starts;
+    }
+}
+
+TEST_CASE("Search.plain", "[search]")
+{
+    auto screen = MockScreen{{6, 2}};
+    screen.write("foo 1\r\nbar 2\r\nFoo 3\r\nbaz 4\r\nfoo 5");
+    REQUIRE(screen.historyLineCount() == 3);
+
+    SECTION("case sensitive") {
+        auto search = Search{screen, "foo", Search::Options{}};
+        CHECK(search.step(screen, Unbounded));
+        REQUIRE(search.matches().size() == 2);
+        CHECK(rangeStarts(search, screen) == vector<pair<int, int>>{{5, 1}, {1, 1}});
+        CHECK(search.ranges(screen)[0].toColumn == 3);
+    }
+
+    SECTION("case insensitive") {
+        auto search = Search{screen, "FOO", Search::Options{false, false}};
+        CHECK(search.step(screen, Unbounded));
+        CHECK(rangeStarts(search, screen) == vector<pair<int, int>>{{5, 1}, {3, 1}, {1, 1}});
+    }
+
+    SECTION("regex") {
+        auto search = Search{screen, "ba[rz] [0-9]", Search::Options{true, true}};
+        CHECK(search.step(screen, Unbounded));
+        CHECK(rangeStarts(search, screen) == vector<pair<int, int>>{{4, 1}, {2, 1}});
+        CHECK_THROWS_AS((Search{screen, "(", Search::Options{true, true}}), std::regex_error);
+    }
+
+    SECTION("incremental") {
+        auto search = Search{screen, "o", Search::Options{}};
+        CHECK_FALSE(search.step(screen, 2));
+        CHECK(search.matches().size() == 2);
+        CHECK(search.step(screen, Unbounded));
+        CHECK(search.matches().size() == 6);
+    }
+}
+
+TEST_CASE("Search.wrapped_lines", "[search]")
+{
+    auto screen = MockScreen{{6, 3}};
+    screen.write("abcdefgh\r\n\xE4\xBD\xA0\xE5\xA5\xBD x");
+
+    auto search = Search{screen, "fgh", Search::Options{}};
+    search.step(screen, Unbounded);
+    auto const ranges = search.ranges(screen);
+    REQUIRE(ranges.size() == 2);
+    CHECK(ranges[0].line == 1);
+    CHECK(ranges[0].fromColumn == 6);
+    CHECK(ranges[0].toColumn == 6);
+    CHECK(ranges[1].line == 2);
+    CHECK(ranges[1].fromColumn == 1);
+    CHECK(ranges[1].toColumn == 2);
+
+    // Columns after wide characters account for their width.
+    auto wide = Search{screen, " x", Search::Options{}};
+    wide.step(screen, Unbounded);
+    REQUIRE(wide.matches().size() == 1);
+    CHECK(wide.matches()[0].column == 4);
+    CHECK(wide.matches()[0].length == 2);
+}
+
+TEST_CASE("Search.stable_coordinates", "[search]")
+{
+    auto screen = MockScreen{{6, 2}};
+    screen.write("one\r\ntwo\r\nthree");
+
+    auto search = Search{screen, "two", Search::Options{}};
+    search.step(screen, Unbounded);
+    auto const before = rangeStarts(search, screen);
+    REQUIRE(before == vector<pair<int, int>>{{2, 1}});
+
+    // Scrolling the match into the history keeps its absolute coordinates.
+    screen.write("\r\nfour\r\nfive");
+    CHECK(rangeStarts(search, screen) == before);
+
+    // Lines appended since the search started are not searched.
+    screen.write("\r\ntwo");
+    CHECK(search.complete());
+    CHECK(search.matches().size() == 1);
+}
+
+TEST_CASE("Search.skips_pages", "[search]")
+{
+    auto constexpr LineCount = 10 * SavedLines::DefaultPageSize;
+    auto screen = MockScreen{{16, 2}};
+    screen.write("needle\r\n");
+    for (size_t i = 1; i < LineCount; ++i)
+        screen.write(fmt::format("line {}\r\n", i));
+
+    auto plain = Search{screen, "needle", Search::Options{}};
+    auto plainSteps = 0u;
+    while (!plain.step(screen, 1))
+        ++plainSteps;
+
+    auto regex = Search{screen, "needle", Search::Options{true, true}};
+    auto regexSteps = 0u;
+    while (!regex.step(screen, 1))
+        ++regexSteps;
+
+    REQUIRE(plain.matches().size() == 1);
+    REQUIRE(regex.matches().size() == 1);
+    CHECK(plain.ranges(screen).front().line == 1);
+    CHECK(plainSteps + 4 * SavedLines::DefaultPageSize < regexSteps);
+}
+
+TEST_CASE("Search.skips_folds", "[search]")
+{
+    auto screen = MockScreen{{16, 2}};
+    screen.setMark();
+    screen.write("$ make\r\n");
+    for (auto i = 0; i < 100; ++i)
+        screen.write(fmt::format("needle {}\r\n", i));
+    screen.setMark();
+    screen.write("$ needle\r\n\r\n");
+    REQUIRE(screen.foldOutput(0));
+
+    auto search = Search{screen, "needle", Search::Options{true, true}};
+    auto steps = 0u;
+    while (!search.step(screen, 1))
+        ++steps;
+
+    REQUIRE(search.matches().size() == 1);
+    CHECK(search.ranges(screen).front().line == 102);
+    CHECK(steps < 10);
+}
+
+TEST_CASE("Search.detectLinks", "[search]")
+{
+    auto const links = detectLinks("see (https://en.wikipedia.org/wiki/C_(language)), src/main.cpp:42:7: error");
+    REQUIRE(links.size() == 2);
+    CHECK(links[0].uri == "https://en.wikipedia.org/wiki/C_(language)");
+    CHECK(links[0].column == 5);
+    CHECK(links[0].length == 42);
+    CHECK(links[1].uri == "src/main.cpp");
+    CHECK(links[1].column == 50);
+    CHECK(links[1].length == 17);
+
+    auto const paths = detectLinks("\xE4\xBD\xA0 /etc/hosts ~/.profile and/or 12:30 http:// mailto:x@y");
+    REQUIRE(paths.size() == 2);
+    CHECK(paths[0].uri == "file:///etc/hosts");
+    CHECK(paths[0].column == 3);
+    CHECK(paths[0].length == 10);
+    CHECK(paths[1].uri == "~/.profile");
+}
@@ -21,14 +21,27 @@ using namespace std;
 
 namespace terminal {
 
+namespace
+{
+    Cell const* screenCellAt(Screen const& _screen, Coordinate const& _pos)
+    {
+        assert(_pos.row >= 0 && "must be absolute coordinate");
+        auto const row = _pos.row - _screen.historyLineCount(); // translate to coordinate relative to the screen's home position
+        if (row <= _screen.size().height)
+            return &_screen.at({row, _pos.column});
+        else
+            return nullptr;
+    }
+}
+
 Selector::Selector(Mode _mode,
 				   GetCellAt _getCellAt,
-				   std::u32string const& _wordDelimiters,
+				   crispy::codepoint_set const& _wordDelimiters,
 				   int _totalRowCount,
 				   int _columnCount,
 				   Coordinate const& _from) :
 	mode_{_mode},
-	getCellAt_{move(_getCellAt)},
+	getCellAt_{_getCellAt},
 	wordDelimiters_{_wordDelimiters},
 	totalRowCount_{_totalRowCount},
     columnCount_{_columnCount},
@@ -52,20 +65,12 @@ Selector::Selector(Mode _mode,
 }
 
 Selector::Selector(Mode _mode,
-                   std::u32string const& _wordDelimiters,
+                   crispy::codepoint_set const& _wordDelimiters,
                    Screen const& _screen,
                    Coordinate const& _from) :
     Selector{
         _mode,
-        [screen = std::ref(_screen)](Coordinate const& _pos) -> Cell const* {
-            assert(_pos.row >= 0 && "must be absolute coordinate");
-            auto const& buffer = screen.get();
-            auto const row = _pos.row - buffer.historyLineCount(); // translate to coordinate relative to the screen's home position
-            if (row <= buffer.size().height)
-                return &buffer.at({row, _pos.column});
-            else
-                return nullptr;
-        },
+        GetCellAt::bind<&screenCellAt>(_screen),
         _wordDelimiters,
         _screen.size().height + static_cast<int>(_screen.historyLineCount()),
         _screen.size().width,
@@ -139,7 +144,7 @@ void Selector::extendSelectionBackward()
 {
     auto const isWordDelimiterAt = [this](Coordinate const& _coord) -> bool {
         Cell const* cell = at(_coord);
-        return !cell || cell->empty() || wordDelimiters_.find(cell->codepoint(0)) != wordDelimiters_.npos;
+        return !cell || cell->empty() || wordDelimiters_.contains(cell->codepoint(0));
     };
 
     auto last = to_;
@@ -173,7 +178,7 @@ void Selector::extendSelectionForward()
 {
     auto const isWordDelimiterAt = [this](Coordinate const& _coord) -> bool {
         Cell const* cell = at(_coord);
-        return !cell || cell->empty() || wordDelimiters_.find(cell->codepoint(0)) != wordDelimiters_.npos;
+        return !cell || cell->empty() || wordDelimiters_.contains(cell->codepoint(0));
     };
 
     auto last = to_;
@@ -292,8 +297,8 @@ vector<Selector::Range> Selector::rectangular() const
     {
         result[row] = Range{
             from.row + row,
-            from.column,
-            to.column
+            min(from.column, to.column),
+            max(from.column, to.column)
         };
     }
 
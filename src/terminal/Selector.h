@@ -17,11 +17,15 @@
 #include <terminal/Screen.h>
 #include <terminal/Size.h>          // Coordinate
 
+#include <crispy/codepoint_set.h>
+#include <crispy/function_ref.h>
 #include <crispy/utils.h>
 
 #include <fmt/format.h>
 
+#include <algorithm>
 #include <functional>
+#include <optional>
 #include <vector>
 #include <utility>
 
@@ -73,18 +77,21 @@ class Selector {
 
 
     enum class Mode { Linear, LinearWordWise, FullLine, Rectangular };
-	using GetCellAt = std::function<Cell const*(Coordinate const&)>;
+
+    /// Invoked per cell while extending the selection, hence referred to rather than owned.
+    /// The callable must outlive the Selector.
+	using GetCellAt = crispy::function_ref<Cell const*(Coordinate const&)>;
 
     Selector(Mode _mode,
 			 GetCellAt _at,
-			 std::u32string const& _wordDelimiters,
+			 crispy::codepoint_set const& _wordDelimiters,
 			 int _totalRowCount,
              int _columnCount,
 			 Coordinate const& _from);
 
 	/// Convenience constructor when access to Screen is available.
     Selector(Mode _mode,
-			 std::u32string const& _wordDelimiters,
+			 crispy::codepoint_set const& _wordDelimiters,
 			 Screen const& _screen,
 			 Coordinate const& _from);
 
@@ -107,20 +114,34 @@ class Selector {
     /// @returns boolean indicating whether or not given absolute coordinate is within the range of the selection.
     constexpr bool contains(Coordinate _coord) const noexcept
     {
+        auto const range = rangeAt(_coord.row);
+        return range.has_value() && crispy::ascending(range->fromColumn, _coord.column, range->toColumn);
+    }
+
+    /// @returns the selected columns of the given absolute row, or std::nullopt if none.
+    ///
+    /// Every row is covered by a single range, hence the selection state of a row's cells is
+    /// determined by computing this once per row, rather than once per cell.
+    constexpr std::optional<Range> rangeAt(int _row) const noexcept
+    {
+        auto const from = negativeSelection() ? to_ : from_;
+        auto const to = negativeSelection() ? from_ : to_;
+        if (_row < from.row || _row > to.row)
+            return std::nullopt;
+
         switch (mode_)
         {
             case Mode::FullLine:
-                return crispy::ascending(from_.row, _coord.row, to_.row)
-                    || crispy::ascending(to_.row, _coord.row, from_.row);
+                return Range{_row, 1, columnCount_};
             case Mode::Linear:
             case Mode::LinearWordWise:
-                return crispy::ascending(from_, _coord, to_)
-                    || crispy::ascending(to_, _coord, from_);
+                return Range{_row,
+                             _row == from.row ? from.column : 1,
+                             _row == to.row ? to.column : columnCount_};
             case Mode::Rectangular:
-                return crispy::ascending(from_.row, _coord.row, to_.row)
-                    && crispy::ascending(from_.column, _coord.column, to_.column);
+                return Range{_row, std::min(from.column, to.column), std::max(from.column, to.column)};
         }
-        return false;
+        return std::nullopt;
     }
 
     /// Tests whether selection is upwards.
@@ -182,7 +203,7 @@ class Selector {
     State state_{State::Waiting};
 	Mode mode_;
 	GetCellAt getCellAt_;
-	std::u32string wordDelimiters_;
+	crispy::codepoint_set wordDelimiters_;
 	int totalRowCount_;
     int columnCount_;
     Coordinate start_{};
@@ -203,5 +203,62 @@ TEST_CASE("Selector.FullLine", "[selector]")
 
 TEST_CASE("Selector.Rectangular", "[selector]")
 {
-    // TODO
+    auto screenEvents = ScreenEvents{};
+    auto screen = Screen{Size{11, 3}, screenEvents, [&](auto const& msg) { INFO(fmt::format("{}", msg)); }};
+    screen.write(
+    //   123456789AB
+        "12345,67890"s +
+        "ab,cdefg,hi"s +
+        "12345,67890"s
+    );
+
+    SECTION("towards bottom left") { // ",cd\n345"
+        auto selector = Selector{Selector::Mode::Rectangular, U",", screen, Coordinate{2, 5}};
+        selector.extend(Coordinate{3, 3});
+        selector.stop();
+
+        vector<Selector::Range> const selection = selector.selection();
+        REQUIRE(selection.size() == 2);
+        CHECK(selection[0].fromColumn == 3);
+        CHECK(selection[0].toColumn == 5);
+        CHECK(selection[1].fromColumn == 3);
+        CHECK(selection[1].toColumn == 5);
+
+        CHECK_FALSE(selector.rangeAt(1).has_value());
+        CHECK(selector.rangeAt(3)->fromColumn == 3);
+        CHECK(selector.contains(Coordinate{2, 4}));
+        CHECK_FALSE(selector.contains(Coordinate{2, 6}));
+
+        auto selectedText = TextSelection{};
+        selector.render(selectedText);
+        CHECK(selectedText.text == ",cd\n345");
+    }
+}
+
+TEST_CASE("Selector.rangeAt", "[selector]")
+{
+    auto screenEvents = ScreenEvents{};
+    auto screen = Screen{Size{11, 3}, screenEvents, [&](auto const& msg) { INFO(fmt::format("{}", msg)); }};
+    screen.write("12345,67890ab,cdefg,hi12345,67890"s);
+
+    auto selector = Selector{Selector::Mode::Linear, U",", screen, Coordinate{3, 4}};
+    selector.extend(Coordinate{1, 9});
+    selector.stop();
+
+    // Matches the ranges of selection() and the cells contains() reports.
+    for (Selector::Range const& range : selector.selection())
+    {
+        auto const rangeAt = selector.rangeAt(range.line);
+        REQUIRE(rangeAt.has_value());
+        CHECK(rangeAt->fromColumn == range.fromColumn);
+        CHECK(rangeAt->toColumn == range.toColumn);
+    }
+    for (int row = 1; row <= 3; ++row)
+        for (int column = 1; column <= 11; ++column)
+        {
+            auto const rangeAt = selector.rangeAt(row);
+            bool const inRange = rangeAt.has_value()
+                              && rangeAt->fromColumn <= column && column <= rangeAt->toColumn;
+            CHECK(selector.contains(Coordinate{row, column}) == inRange);
+        }
 }
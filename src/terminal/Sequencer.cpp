@@ -14,10 +14,12 @@
 #include <terminal/Sequencer.h>
 
 #include <terminal/Functions.h>
+#include <terminal/Metrics.h>
 #include <terminal/SixelParser.h>
 #include <terminal/Screen.h>
 
 #include <crispy/algorithm.h>
+#include <crispy/allocation_tracker.h>
 #include <crispy/escape.h>
 #include <crispy/base64.h>
 #include <crispy/utils.h>
@@ -47,16 +49,22 @@ using std::pair;
 using std::runtime_error;
 using std::shared_ptr;
 using std::string;
+using std::string_view;
 using std::stringstream;
 using std::unique_ptr;
 using std::vector;
 
-#define CONTOUR_SYNCHRONIZED_OUTPUT 1
-
 namespace terminal {
 
 namespace // {{{ helpers
 {
+    // Sixel images at least twice as high are shown progressively while being received,
+    // updated whenever this many more pixel rows have been painted.
+    auto constexpr SixelPreviewRows = 192;
+
+    // Leading bytes of an OSC carrying an iTerm2 inline image, which may exceed Sequence::MaxOscLength.
+    auto constexpr InlineImagePrefix = string_view{"1337;File="};
+
     /// @returns parsed tuple with OSC code and offset to first data parameter byte.
     pair<int, int> parseOSC(string const& _data)
     {
@@ -64,7 +72,7 @@ namespace // {{{ helpers
         size_t i = 0;
 
         while (i < _data.size() && isdigit(_data[i]))
-            code = code * 10 + _data[i++] - '0';
+            code = min(code * 10 + _data[i++] - '0', static_cast<int>(Sequence::MaxParameterValue));
 
         if (i == 0 && !_data.empty() && _data[0] != ';')
         {
@@ -204,7 +212,7 @@ namespace impl // {{{ some command generator helpers
                         auto const b = _seq.subparam(i, 3);
                         if (r <= 255 && g <= 255 && b <= 255)
                         {
-                            *pi = i + 1;
+                            *pi = i;
                             return Color{RGBColor{static_cast<uint8_t>(r), static_cast<uint8_t>(g), static_cast<uint8_t>(b)} };
                         }
                     }
@@ -215,7 +223,7 @@ namespace impl // {{{ some command generator helpers
                 case 5: // ":5:P"
                     if (auto const P = _seq.subparam(i, 1); P <= 255)
                     {
-                        *pi = i + 1;
+                        *pi = i;
                         return static_cast<IndexedColor>(P);
                     }
                     break;
@@ -582,6 +590,67 @@ namespace impl // {{{ some command generator helpers
             return ApplyResult::Unsupported;
     }
 
+    /// Parses an inline image's width or height, that is: N (cells), Npx, N% or auto.
+    optional<ImageExtent> parseImageExtent(string_view _value)
+    {
+        if (_value.empty() || _value == "auto")
+            return ImageExtent{};
+
+        auto extent = ImageExtent{ImageExtent::Unit::Cells, 0};
+        if (_value.size() > 2 && _value.substr(_value.size() - 2) == "px")
+        {
+            extent.unit = ImageExtent::Unit::Pixels;
+            _value.remove_suffix(2);
+        }
+        else if (_value.back() == '%')
+        {
+            extent.unit = ImageExtent::Unit::Percent;
+            _value.remove_suffix(1);
+        }
+
+        if (_value.empty())
+            return nullopt;
+
+        for (char const ch : _value)
+        {
+            if (!isdigit(ch) || extent.value > 100000)
+                return nullopt;
+            extent.value = extent.value * 10 + (ch - '0');
+        }
+
+        return extent;
+    }
+
+    ApplyResult INLINEIMAGE(Sequence const& _seq, Screen& _screen)
+    {
+        // OSC 1337 ; File=[args] : base64-data ST
+        // args := pair (';' pair)*
+        auto const value = string_view(_seq.intermediateCharacters());
+        auto const colon = value.find(':');
+        if (value.substr(0, 5) != "File=" || colon == value.npos)
+            return ApplyResult::Unsupported;
+
+        auto const args = crispy::splitKeyValuePairs(value.substr(5, colon - 5), ';');
+        auto const arg = [&](string_view _key, string_view _default) -> string_view {
+            auto const i = args.find(_key);
+            return i != args.end() ? i->second : _default;
+        };
+
+        // Downloading files without displaying them is not supported.
+        if (arg("inline", "0") != "1")
+            return ApplyResult::Unsupported;
+
+        auto const width = parseImageExtent(arg("width", "auto"));
+        auto const height = parseImageExtent(arg("height", "auto"));
+        if (!width || !height)
+            return ApplyResult::Invalid;
+
+        auto const preserveAspectRatio = arg("preserveAspectRatio", "1") != "0";
+
+        _screen.inlineImage(crispy::base64::decode(value.substr(colon + 1)), *width, *height, preserveAspectRatio);
+        return ApplyResult::Ok;
+    }
+
     ApplyResult HYPERLINK(Sequence const& _seq, Screen& _screen)
     {
         auto const& value = _seq.intermediateCharacters();
@@ -801,33 +870,16 @@ string Sequence::text() const
 
     if (parameterCount() > 1 || (parameterCount() == 1 && parameters_[0][0] != 0))
     {
-        sstr << ' ' << accumulate(
-            begin(parameters_), end(parameters_), string{},
-            [](string const& a, auto const& p) -> string {
-                return !a.empty()
-                    ? fmt::format("{};{}",
-                            a,
-                            accumulate(
-                                begin(p), end(p),
-                                string{},
-                                [](string const& x, Sequence::Parameter y) -> string {
-                                    return !x.empty()
-                                        ? fmt::format("{}:{}", x, y)
-                                        : std::to_string(y);
-                                }
-                            )
-                        )
-                    : accumulate(
-                            begin(p), end(p),
-                            string{},
-                            [](string const& x, Sequence::Parameter y) -> string {
-                                return !x.empty()
-                                    ? fmt::format("{}:{}", x, y)
-                                    : std::to_string(y);
-                            }
-                        );
-            }
-        );
+        sstr << ' ';
+        for (auto i = 0u; i < parameterCount(); ++i)
+        {
+            if (i)
+                sstr << ';';
+
+            sstr << param(i);
+            for (auto k = 0u; k < subParameterCount(i); ++k)
+                sstr << ':' << subparam(i, k);
+        }
     }
 
     if (!intermediateCharacters().empty())
@@ -861,19 +913,45 @@ void Sequencer::error(std::string_view const& _errorString)
     logger_(ParserErrorEvent{string(_errorString)});
 }
 
+template <typename F>
+void Sequencer::profiled(FunctionDefinition const* _function, F&& _dispatch)
+{
+    CRISPY_ALLOCATION_SCOPE(screen);
+
+    if (!metrics_ || !metrics_->sampleNext())
+    {
+        _dispatch();
+        return;
+    }
+
+    auto const start = crispy::cycle_clock::now();
+    _dispatch();
+    metrics_->addSample(_function, crispy::cycle_clock::now() - start);
+}
+
 void Sequencer::print(char32_t _char)
 {
-    if (batching_)
-        batchedSequences_.emplace_back(_char);
-    else
+    instructionCounter_++;
+    if (metrics_)
     {
-        instructionCounter_++;
-        screen_.writeText(_char);
+        uint8_t u8[4];
+        metrics_->text(unicode::to_utf8(_char, u8));
     }
+    profiled(nullptr, [&]() { screen_.writeText(_char); });
+}
+
+void Sequencer::print(string_view _chars)
+{
+    instructionCounter_++;
+    if (metrics_)
+        metrics_->text(_chars.size());
+    profiled(nullptr, [&]() { screen_.writeText(_chars); });
 }
 
 void Sequencer::execute(char _controlCode)
 {
+    if (metrics_)
+        metrics_->addBytes(OutputCategory::C0, 1);
     executeControlFunction(_controlCode);
 }
 
@@ -884,7 +962,8 @@ void Sequencer::clear()
 
 void Sequencer::collect(char _char)
 {
-    sequence_.intermediateCharacters().push_back(_char);
+    if (sequence_.intermediateCharacters().size() < Sequence::MaxIntermediateCharacters)
+        sequence_.intermediateCharacters().push_back(_char);
 }
 
 void Sequencer::collectLeader(char _leader)
@@ -894,18 +973,16 @@ void Sequencer::collectLeader(char _leader)
 
 void Sequencer::param(char _char)
 {
-    if (sequence_.parameters().empty())
-        sequence_.parameters().push_back({0});
+    if (sequence_.parameterCount() == 0)
+        sequence_.appendParameter();
 
     switch (_char)
     {
         case ';':
-            if (sequence_.parameters().size() < Sequence::MaxParameters)
-                sequence_.parameters().push_back({0});
+            sequence_.appendParameter();
             break;
         case ':':
-            if (sequence_.parameters().back().size() < Sequence::MaxParameters)
-                sequence_.parameters().back().push_back({0});
+            sequence_.appendSubParameter();
             break;
         case '0':
         case '1':
@@ -917,7 +994,7 @@ void Sequencer::param(char _char)
         case '7':
         case '8':
         case '9':
-            sequence_.parameters().back().back() = sequence_.parameters().back().back() * 10 + (_char - U'0');
+            sequence_.appendParameterDigit(_char - '0');
             break;
     }
 }
@@ -933,11 +1010,33 @@ void Sequencer::dispatchCSI(char _finalChar)
 {
     sequence_.setCategory(FunctionCategory::CSI);
     sequence_.setFinalChar(_finalChar);
+
+    // SGR is by far the most frequently used sequence, so it bypasses the
+    // function lookup and the generic apply() dispatch.
+    if (_finalChar == 'm' && !sequence_.leaderSymbol() && sequence_.intermediateCharacters().empty())
+    {
+#if defined(LIBTERMINAL_LOG_TRACE)
+        if (logger_.enabled<TraceOutputEvent>())
+            logger_(TraceOutputEvent{fmt::format("{}", sequence_)});
+#endif
+        instructionCounter_++;
+        static FunctionDefinition const* const sgr = select({FunctionCategory::CSI, 0, 0, 0, 'm'});
+        if (metrics_)
+        {
+            (*metrics_)(*sgr);
+            metrics_->addBytes(OutputCategory::CSI, Metrics::encodedSize(sequence_));
+        }
+        profiled(sgr, [&]() { impl::dispatchSGR(sequence_, screen_); });
+        return;
+    }
+
     handleSequence();
 }
 
 void Sequencer::startOSC()
 {
+    if (metrics_)
+        metrics_->addBytes(OutputCategory::OSC, 2); // ESC ]
     sequence_.setCategory(FunctionCategory::OSC);
 }
 
@@ -945,18 +1044,46 @@ void Sequencer::putOSC(char32_t _char)
 {
     uint8_t u8[4];
     size_t const count = unicode::to_utf8(_char, u8);
-    if (sequence_.intermediateCharacters().size() + count < Sequence::MaxOscLength)
-        for (size_t i = 0; i < count; ++i)
-            sequence_.intermediateCharacters().push_back(u8[i]);
+    putOSC(string_view(reinterpret_cast<char const*>(u8), count));
+}
+
+void Sequencer::putOSC(string_view _chars)
+{
+    if (metrics_)
+        metrics_->addBytes(OutputCategory::OSC, _chars.size());
+
+    // Appends as many whole characters as fit below the given length limit.
+    auto& value = sequence_.intermediateCharacters();
+    auto const append = [&](size_t _limit) {
+        if (value.size() + 1 >= _limit)
+            return;
+        auto count = min(_chars.size(), _limit - 1 - value.size());
+        if (count < _chars.size())
+            while (count != 0 && (static_cast<uint8_t>(_chars[count]) & 0xC0) == 0x80)
+                --count;
+        value.append(_chars.data(), count);
+        _chars.remove_prefix(count);
+    };
+
+    append(Sequence::MaxOscLength);
+    if (!_chars.empty() && value.compare(0, InlineImagePrefix.size(), InlineImagePrefix) == 0)
+        append(Sequence::MaxOscFileLength);
 }
 
 void Sequencer::dispatchOSC()
 {
     auto const [code, skipCount] = parseOSC(sequence_.intermediateCharacters());
-    sequence_.parameters().push_back({static_cast<Sequence::Parameter>(code)});
+    sequence_.appendParameter(static_cast<Sequence::Parameter>(code));
     sequence_.intermediateCharacters().erase(0, skipCount);
     handleSequence();
     sequence_.clear();
+
+    // Releases the memory of a file received, while keeping the reserve for regular sequences.
+    if (sequence_.intermediateCharacters().capacity() > Sequence::MaxOscLength)
+    {
+        sequence_.intermediateCharacters() = Sequence::Intermediaries{};
+        sequence_.intermediateCharacters().reserve(Sequence::MaxOscLength);
+    }
 }
 
 void Sequencer::hook(char _finalChar)
@@ -964,6 +1091,8 @@ void Sequencer::hook(char _finalChar)
     instructionCounter_++;
     sequence_.setCategory(FunctionCategory::DCS);
     sequence_.setFinalChar(_finalChar);
+    if (metrics_)
+        metrics_->addBytes(OutputCategory::DCS, Metrics::encodedSize(sequence_));
     if (FunctionDefinition const* funcSpec = sequence_.functionDefinition(); funcSpec != nullptr)
     {
         switch (funcSpec->id())
@@ -983,12 +1112,28 @@ void Sequencer::hook(char _finalChar)
 
 void Sequencer::put(char32_t _char)
 {
+    CRISPY_ALLOCATION_SCOPE(image);
+    if (metrics_)
+    {
+        uint8_t u8[4];
+        metrics_->addBytes(OutputCategory::DCS, unicode::to_utf8(_char, u8));
+    }
     if (hookedParser_)
         hookedParser_->pass(_char);
 }
 
+void Sequencer::put(string_view _chars)
+{
+    CRISPY_ALLOCATION_SCOPE(image);
+    if (metrics_)
+        metrics_->addBytes(OutputCategory::DCS, _chars.size());
+    if (hookedParser_)
+        hookedParser_->pass(_chars);
+}
+
 void Sequencer::unhook()
 {
+    CRISPY_ALLOCATION_SCOPE(image);
     if (hookedParser_)
     {
         hookedParser_->finalize();
@@ -996,6 +1141,16 @@ void Sequencer::unhook()
     }
 }
 
+void Sequencer::setSixelDecoderThreads(unsigned _value)
+{
+    if (_value == sixelDecoderThreads_)
+        return;
+
+    // An image being decoded keeps the previous pool alive until finished.
+    sixelDecoderThreads_ = _value;
+    sixelDecoderPool_.reset();
+}
+
 unique_ptr<ParserExtension> Sequencer::hookSixel(Sequence const& _seq)
 {
     auto const Pa = _seq.param_or(0, 1);
@@ -1037,29 +1192,43 @@ unique_ptr<ParserExtension> Sequencer::hookSixel(Sequence const& _seq)
             : imageColorPalette_
     );
 
-    return make_unique<SixelParser>(
-        *sixelImageBuilder_,
-        [this]() {
-#if defined(CONTOUR_SYNCHRONIZED_OUTPUT)
-            if (batching_)
-            {
-                batchedSequences_.emplace_back(SixelImage{
-                    sixelImageBuilder_->size(),
-                    sixelImageBuilder_->data()
-                });
-            }
-            else
-#endif
-            {
-                screen_.sixelImage(
-                    sixelImageBuilder_->size(),
-                    move(sixelImageBuilder_->data())
-                );
-            }
-        }
+    sixelPreviewRows_ = 0;
+    sixelImageBuilder_->setBandListener(SixelImageBuilder::OnBand::bind<&Sequencer::previewSixelImage>(*this));
+
+    auto const onFinalize = SixelParser::OnFinalize::bind<&Sequencer::finalizeSixelImage>(*this);
+
+    if (sixelDecoderThreads_ > 1)
+    {
+        if (!sixelDecoderPool_)
+            sixelDecoderPool_ = make_shared<crispy::parallel_for_pool>(sixelDecoderThreads_);
+        return make_unique<SixelBandParser>(*sixelImageBuilder_, sixelDecoderPool_, onFinalize);
+    }
+
+    return make_unique<SixelParser>(*sixelImageBuilder_, onFinalize);
+}
+
+void Sequencer::finalizeSixelImage()
+{
+    screen_.sixelImage(
+        sixelImageBuilder_->size(),
+        move(sixelImageBuilder_->data())
     );
 }
 
+void Sequencer::previewSixelImage(int _rows)
+{
+    Size const& size = sixelImageBuilder_->size();
+    if (size.height < 2 * SixelPreviewRows || _rows - sixelPreviewRows_ < SixelPreviewRows || _rows >= size.height)
+        return;
+
+    sixelPreviewRows_ = _rows;
+
+    // Only the rows painted so far are shown, the final image replaces the preview once complete.
+    auto const& data = sixelImageBuilder_->data();
+    auto const bytes = static_cast<size_t>(size.width) * static_cast<size_t>(_rows) * 4;
+    screen_.sixelImagePreview(Size{size.width, _rows}, Image::Data(data.begin(), data.begin() + bytes));
+}
+
 unique_ptr<ParserExtension> Sequencer::hookDECRQSS(Sequence const& /*_seq*/)
 {
     return make_unique<SimpleStringCollector>(
@@ -1085,24 +1254,12 @@ unique_ptr<ParserExtension> Sequencer::hookDECRQSS(Sequence const& /*_seq*/)
             if (s.has_value())
                 screen_.requestStatusString(s.value());
 
-            // TODO: handle batching
         }
     );
 }
 
 void Sequencer::executeControlFunction(char _c0)
 {
-#if defined(CONTOUR_SYNCHRONIZED_OUTPUT)
-    if (batching_)
-    {
-        sequence_.clear();
-        sequence_.setCategory(FunctionCategory::C0);
-        sequence_.setFinalChar(_c0);
-        handleSequence();
-        return;
-    }
-#endif
-
     instructionCounter_++;
     switch (_c0)
     {
@@ -1143,70 +1300,49 @@ void Sequencer::executeControlFunction(char _c0)
 void Sequencer::handleSequence()
 {
 #if defined(LIBTERMINAL_LOG_TRACE)
-    logger_(TraceOutputEvent{fmt::format("{}", sequence_)});
+    if (logger_.enabled<TraceOutputEvent>())
+        logger_(TraceOutputEvent{fmt::format("{}", sequence_)});
 #endif
 
     instructionCounter_++;
-    if (FunctionDefinition const* funcSpec = sequence_.functionDefinition(); funcSpec != nullptr)
+    if (metrics_)
     {
-#if defined(CONTOUR_SYNCHRONIZED_OUTPUT)
-        if (*funcSpec == DECSM && sequence_.containsParameter(2026))
+        switch (sequence_.category())
         {
-            batching_ = true;
-            apply(*funcSpec, sequence_);
-        }
-        else if (*funcSpec == DECRM && sequence_.containsParameter(2026))
-        {
-            batching_ = false;
-            flushBatchedSequences();
-            apply(*funcSpec, sequence_);
-        }
-        else if (batching_ && isBatchable(*funcSpec))
-        {
-            batchedSequences_.emplace_back(sequence_);
+            case FunctionCategory::ESC:
+                metrics_->addBytes(OutputCategory::ESC, Metrics::encodedSize(sequence_));
+                break;
+            case FunctionCategory::CSI:
+                metrics_->addBytes(OutputCategory::CSI, Metrics::encodedSize(sequence_));
+                break;
+            case FunctionCategory::OSC:
+                metrics_->addBytes(OutputCategory::OSC, 1); // string terminator, BEL or the final byte of ST
+                break;
+            default:
+                break;
         }
-        else
-#endif
-            apply(*funcSpec, sequence_);
+    }
+
+    if (FunctionDefinition const* funcSpec = sequence_.functionDefinition(); funcSpec != nullptr)
+    {
+        if (metrics_)
+            (*metrics_)(*funcSpec);
+
+        profiled(funcSpec, [&]() { apply(*funcSpec, sequence_); });
 
         screen_.verifyState();
     }
     else
-        std::cerr << fmt::format("Unknown VT sequence: {}\n", sequence_);
-}
-
-void Sequencer::flushBatchedSequences()
-{
-    for (auto const& batchable : batchedSequences_)
     {
-        if (holds_alternative<char32_t>(batchable))
-            print(get<char32_t>(batchable));
-        else if (holds_alternative<Sequence>(batchable))
-        {
-            auto const& seq = get<Sequence>(batchable);
-            if (FunctionDefinition const* spec = seq.functionDefinition(); spec != nullptr)
-                apply(*spec, seq);
-        }
-        else if (holds_alternative<SixelImage>(batchable))
-        {
-            auto const& si = get<SixelImage>(batchable);
-            screen_.sixelImage(si.size, Image::Data(si.rgba));
-        }
+        if (metrics_)
+            metrics_->unknownSequences++;
+        std::cerr << fmt::format("Unknown VT sequence: {}\n", sequence_);
     }
-    batchedSequences_.clear();
 }
 
 /// Applies a FunctionDefinition to a given context, emitting the respective command.
 ApplyResult Sequencer::apply(FunctionDefinition const& _function, Sequence const& _seq)
 {
-#if defined(CONTOUR_SYNCHRONIZED_OUTPUT)
-    if (batching_ && isBatchable(_function))
-    {
-        batchedSequences_.emplace_back(_seq);
-        return ApplyResult::Ok;
-    }
-#endif
-
     // This function assumed that the incoming instruction has been already resolved to a given
     // FunctionDefinition
     switch (_function)
@@ -1335,6 +1471,7 @@ ApplyResult Sequencer::apply(FunctionDefinition const& _function, Sequence const
         case RCOLORHIGHLIGHTBG: screen_.resetDynamicColor(DynamicColorName::HighlightBackgroundColor); break;
         case NOTIFY: return impl::NOTIFY(_seq, screen_);
         case DUMPSTATE: screen_.dumpState(); break;
+        case INLINEIMAGE: return impl::INLINEIMAGE(_seq, screen_);
         default: return ApplyResult::Unsupported;
     }
     return ApplyResult::Ok;
@@ -19,7 +19,12 @@
 #include <terminal/Functions.h>
 #include <terminal/SixelParser.h>
 
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstdint>
 #include <memory>
+#include <optional>
 #include <string>
 #include <string_view>
 #include <vector>
@@ -27,6 +32,7 @@
 namespace terminal {
 
 class Screen;
+struct Metrics;
 
 // {{{ enums
 enum class CursorDisplay {
@@ -161,25 +167,29 @@ enum class Mode {
     // }}}
     // {{{ Mouse related flags
     /// extend mouse protocl encoding
-    MouseExtended = 1005,
+    MouseExtended, // ?1005
 
     /// Uses a (SGR-style?) different encoding.
-    MouseSGR = 1006,
+    MouseSGR, // ?1006
 
     // URXVT invented extend mouse protocol
-    MouseURXVT = 1015,
+    MouseURXVT, // ?1015
 
     /// Toggles scrolling in alternate screen buffer, encodes CUP/CUD instead of mouse wheel events.
-    MouseAlternateScroll = 1007,
+    MouseAlternateScroll, // ?1007
     // }}}
     // {{{ Extensions
     // This merely resembles the "Synchronized Output" feature from iTerm2, except that it is using
     // a different VT sequence to be enabled. Instead of a DCS,
     // this feature is using CSI ? 2026 h (DECSM and DECRM).
-    BatchedRendering = 2026,
+    BatchedRendering, // ?2026
     // }}}
 };
 
+/// Number of modes. Modes are numbered densely (their VT codes are mapped via to_code()),
+/// so they can be used as indices, e.g. into a bitset.
+constexpr size_t ModeCount = static_cast<size_t>(Mode::BatchedRendering) + 1;
+
 enum class CharsetTable {
     G0 = 0,
     G1 = 1,
@@ -417,14 +427,6 @@ struct RequestStatusString {
     Value value;
 };
 
-/// DECSIXEL - Sixel Graphics Image.
-struct SixelImage { // TODO: this struct is only used internally in Sequencer, make it private
-    /// Size in pixels for this image
-    Size size;
-    /// RGBA buffer of the image to be rendered
-    std::vector<uint8_t> rgba;
-};
-
 inline std::string setDynamicColorValue(RGBColor const& color) // TODO: yet another helper. maybe SemanticsUtils static class?
 {
     auto const r = static_cast<unsigned>(static_cast<float>(color.red) / 255.0f * 0xFFFF);
@@ -444,29 +446,42 @@ enum class ApplyResult {
 class Sequence {
   public:
     using Parameter = int;
-    using ParameterList = std::vector<std::vector<Parameter>>;
     using Intermediaries = std::string;
     using DataString = std::string;
 
+    size_t constexpr static MaxParameters = 16;
+    size_t constexpr static MaxSubParameters = 8;
+    size_t constexpr static MaxOscLength = 512;
+
+    /// Maximum value of a (sub-)parameter, larger values are saturated to it.
+    Parameter constexpr static MaxParameterValue = 65535;
+
+    /// Maximum number of intermediate characters kept for ESC, CSI, and DCS sequences.
+    /// No function takes more than one, so sequences with more than one are unknown either way.
+    size_t constexpr static MaxIntermediateCharacters = 4;
+
+    /// Maximum length of an OSC carrying a file, such as an inline image.
+    size_t constexpr static MaxOscFileLength = 16 * 1024 * 1024;
+
   private:
+    /// Number of values stored per parameter, that is, the parameter itself plus its sub-parameters.
+    size_t constexpr static MaxParameterValues = 1 + MaxSubParameters;
+
     FunctionCategory category_;
     char leaderSymbol_ = 0;
-    ParameterList parameters_;
+    std::array<std::array<Parameter, MaxParameterValues>, MaxParameters> parameters_{};
+    std::array<uint8_t, MaxParameters> parameterValueCounts_{};
+    size_t parameterCount_ = 0;
     Intermediaries intermediateCharacters_;
     char finalChar_ = 0;
     DataString dataString_;
 
   public:
-    size_t constexpr static MaxParameters = 16;
-    size_t constexpr static MaxSubParameters = 8;
-    size_t constexpr static MaxOscLength = 512;
-
     Sequence()
     {
-        parameters_.resize(MaxParameters);
-        for (auto& param : parameters_)
-            param.reserve(MaxSubParameters);
-        parameters_.clear();
+        // Reserve upfront, so that clear() followed by parsing a new sequence never allocates.
+        intermediateCharacters_.reserve(MaxOscLength);
+        dataString_.reserve(MaxOscLength);
     }
 
     // mutators
@@ -476,17 +491,44 @@ class Sequence {
         category_ = FunctionCategory::C0;
         leaderSymbol_ = 0;
         intermediateCharacters_.clear();
-        parameters_.clear();
+        parameterCount_ = 0;
         finalChar_ = 0;
         dataString_.clear();
     }
 
     void setCategory(FunctionCategory _cat) noexcept { category_ = _cat; }
     void setLeader(char _ch) noexcept { leaderSymbol_ = _ch; }
-    ParameterList& parameters() noexcept { return parameters_; }
     Intermediaries& intermediateCharacters() noexcept { return intermediateCharacters_; }
     void setFinalChar(char _ch) noexcept { finalChar_ = _ch; }
 
+    /// Appends a new parameter, silently ignored if MaxParameters is already reached.
+    void appendParameter(Parameter _value = 0) noexcept
+    {
+        if (parameterCount_ < MaxParameters)
+        {
+            parameters_[parameterCount_][0] = _value;
+            parameterValueCounts_[parameterCount_] = 1;
+            ++parameterCount_;
+        }
+    }
+
+    /// Appends a new sub-parameter to the last parameter, silently ignored if MaxSubParameters is already reached.
+    void appendSubParameter() noexcept
+    {
+        assert(parameterCount_ != 0);
+        auto& count = parameterValueCounts_[parameterCount_ - 1];
+        if (count < MaxParameterValues)
+            parameters_[parameterCount_ - 1][count++] = 0;
+    }
+
+    /// Shifts the given decimal digit into the last (sub-)parameter value.
+    void appendParameterDigit(int _digit) noexcept
+    {
+        assert(parameterCount_ != 0);
+        auto& value = parameters_[parameterCount_ - 1][parameterValueCounts_[parameterCount_ - 1] - 1];
+        value = std::min(value * 10 + _digit, MaxParameterValue);
+    }
+
     DataString const& dataString() const noexcept { return dataString_; }
     DataString& dataString() noexcept { return dataString_; }
 
@@ -515,7 +557,7 @@ class Sequence {
                     ? static_cast<char>(intermediateCharacters_[0])
                     : char{};
 
-                return FunctionSelector{category_, leaderSymbol_, static_cast<int>(parameters_.size()), intermediate, finalChar_};
+                return FunctionSelector{category_, leaderSymbol_, static_cast<int>(parameterCount_), intermediate, finalChar_};
             }
         }
     }
@@ -523,16 +565,16 @@ class Sequence {
     // accessors
     //
     FunctionCategory category() const noexcept { return category_; }
+    char leaderSymbol() const noexcept { return leaderSymbol_; }
     Intermediaries const& intermediateCharacters() const noexcept { return intermediateCharacters_; }
     char finalChar() const noexcept { return finalChar_; }
 
-    ParameterList const& parameters() const noexcept { return parameters_; }
-    size_t parameterCount() const noexcept { return parameters_.size(); }
-    size_t subParameterCount(size_t _index) const noexcept { return parameters_[_index].size() - 1; }
+    size_t parameterCount() const noexcept { return parameterCount_; }
+    size_t subParameterCount(size_t _index) const noexcept { return parameterValueCounts_[_index] - 1u; }
 
     std::optional<Parameter> param_opt(size_t _index) const noexcept
     {
-        if (_index < parameters_.size() && parameters_[_index][0])
+        if (_index < parameterCount_ && parameters_[_index][0])
             return {parameters_[_index][0]};
         else
             return std::nullopt;
@@ -545,15 +587,14 @@ class Sequence {
 
     int param(size_t _index) const noexcept
     {
-        assert(_index < parameters_.size());
-        assert(0 < parameters_[_index].size());
+        assert(_index < parameterCount_);
         return parameters_[_index][0];
     }
 
     int subparam(size_t _index, size_t _subIndex) const noexcept
     {
-        assert(_index < parameters_.size());
-        assert(_subIndex + 1 < parameters_[_index].size());
+        assert(_index < parameterCount_);
+        assert(_subIndex + 1 < parameterValueCounts_[_index]);
         return parameters_[_index][_subIndex + 1];
     }
 
@@ -588,12 +629,20 @@ class Sequencer : public ParserEvents {
                     std::make_shared<ColorPalette>()) {}
 
     void setMaxImageSize(Size _value) { maxImageSize_ = _value; }
+    Size maxImageSize() const noexcept { return maxImageSize_; }
     void setMaxImageColorRegisters(int _value) { maxImageRegisterCount_ = _value; }
     void setUsePrivateColorRegisters(bool _value) { usePrivateColorRegisters_ = _value; }
 
+    /// Sets the number of threads Sixel images are decoded with, band by band, or 0 or 1 for
+    /// decoding them serially while being received, showing large images progressively.
+    void setSixelDecoderThreads(unsigned _value);
+
     int64_t instructionCounter() const noexcept { return instructionCounter_; }
     void resetInstructionCounter() noexcept { instructionCounter_ = 0; }
 
+    /// Sets the (optional) sink for counting processed VT sequences.
+    void setMetrics(Metrics* _metrics) noexcept { metrics_ = _metrics; }
+
     // helper methods
     //
     static std::optional<RGBColor> parseColor(std::string_view const& _value);
@@ -602,6 +651,7 @@ class Sequencer : public ParserEvents {
     //
     void error(std::string_view const& _errorString) override;
     void print(char32_t _text) override;
+    void print(std::string_view _chars) override;
     void execute(char _controlCode) override;
     void clear() override;
     void collect(char _char) override;
@@ -611,9 +661,11 @@ class Sequencer : public ParserEvents {
     void dispatchCSI(char _function) override;
     void startOSC() override;
     void putOSC(char32_t _char) override;
+    void putOSC(std::string_view _chars) override;
     void dispatchOSC() override;
     void hook(char _function) override;
     void put(char32_t _char) override;
+    void put(std::string_view _chars) override;
     void unhook() override;
 
   private:
@@ -621,31 +673,37 @@ class Sequencer : public ParserEvents {
     void handleSequence();
 
     [[nodiscard]] std::unique_ptr<ParserExtension> hookSixel(Sequence const& _ctx);
+    void previewSixelImage(int _rows);
+    void finalizeSixelImage();
     [[nodiscard]] std::unique_ptr<ParserExtension> hookDECRQSS(Sequence const& _ctx);
 
-    void flushBatchedSequences();
-
     ApplyResult apply(FunctionDefinition const& _function, Sequence const& _context);
 
+    /// Invokes @p _dispatch, timing every Metrics::sampleInterval'th invocation as @p _function,
+    /// or as writing text if nullptr.
+    template <typename F>
+    void profiled(FunctionDefinition const* _function, F&& _dispatch);
+
     template <typename Event, typename... Args>
     void log(Args&&... args) const
     {
-        if (logger_)
+        if (logger_.enabled<Event>())
             logger_(Event{ std::forward<Args>(args)... });
     }
 
   private:
     Sequence sequence_{};
     Screen& screen_;
-    bool batching_ = false;
     int64_t instructionCounter_ = 0;
-    using Batchable = std::variant<char32_t, Sequence, SixelImage>;
-    std::vector<Batchable> batchedSequences_;
+    Metrics* metrics_ = nullptr;
 
     Logger const logger_;
 
     std::unique_ptr<ParserExtension> hookedParser_;
     std::unique_ptr<SixelImageBuilder> sixelImageBuilder_;
+    int sixelPreviewRows_ = 0;  // pixel rows of the Sixel image being received shown so far
+    unsigned sixelDecoderThreads_ = 0;
+    std::shared_ptr<crispy::parallel_for_pool> sixelDecoderPool_; // created with the first image decoded in parallel
     std::shared_ptr<ColorPalette> imageColorPalette_;
     bool usePrivateColorRegisters_ = false;
     Size maxImageSize_;
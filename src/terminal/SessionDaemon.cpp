@@ -0,0 +1,912 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2020 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <terminal/SessionDaemon.h>
+#include <terminal/Screen.h>
+#include <terminal/SharedRing.h>
+#include <terminal/Terminal.h>
+#include <terminal/pty/Pty.h>
+
+#include <crispy/mapped_file.h>
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <mutex>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using std::chrono::ceil;
+using std::chrono::milliseconds;
+using std::chrono::steady_clock;
+using std::make_shared;
+using std::max;
+using std::nullopt;
+using std::optional;
+using std::scoped_lock;
+using std::shared_ptr;
+using std::string;
+using std::unique_ptr;
+using std::vector;
+
+namespace terminal {
+
+using session::MessageHeaderSize;
+using session::MessageKind;
+using session::MaxMessageSize;
+
+namespace
+{
+#if defined(MSG_NOSIGNAL)
+    constexpr int NoSignal = MSG_NOSIGNAL;
+#else
+    constexpr int NoSignal = 0; // SIGPIPE is to be ignored by the process instead.
+#endif
+
+    void setDescriptorFlags(int _fd, bool _nonBlocking)
+    {
+        fcntl(_fd, F_SETFD, fcntl(_fd, F_GETFD) | FD_CLOEXEC);
+        if (_nonBlocking)
+            fcntl(_fd, F_SETFL, fcntl(_fd, F_GETFL) | O_NONBLOCK);
+    }
+
+    vector<uint8_t> message(MessageKind _kind, void const* _payload = nullptr, size_t _size = 0)
+    {
+        auto const header = std::array<uint32_t, 2>{static_cast<uint32_t>(_kind), static_cast<uint32_t>(_size)};
+        auto data = vector<uint8_t>(MessageHeaderSize + _size);
+        std::memcpy(data.data(), header.data(), MessageHeaderSize);
+        if (_size)
+            std::memcpy(data.data() + MessageHeaderSize, _payload, _size);
+        return data;
+    }
+
+    template <typename T>
+    void put(vector<uint8_t>& _data, T _value)
+    {
+        auto const* bytes = reinterpret_cast<uint8_t const*>(&_value);
+        _data.insert(_data.end(), bytes, bytes + sizeof(T));
+    }
+
+    template <typename T>
+    T get(uint8_t const* _data)
+    {
+        T value{};
+        std::memcpy(&value, _data, sizeof(T));
+        return value;
+    }
+
+    optional<sockaddr_un> socketAddress(string const& _path)
+    {
+        auto address = sockaddr_un{};
+        if (_path.size() >= sizeof(address.sun_path))
+            return nullopt;
+        address.sun_family = AF_UNIX;
+        std::memcpy(address.sun_path, _path.data(), _path.size());
+        return address;
+    }
+
+    /// @returns a socket connected to @p _path, or -1.
+    int connectSocket(string const& _path)
+    {
+        auto const address = socketAddress(_path);
+        if (!address)
+            return -1;
+
+        int const fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0)
+            return -1;
+        setDescriptorFlags(fd, false);
+        if (::connect(fd, reinterpret_cast<sockaddr const*>(&*address), sizeof(*address)) != 0)
+        {
+            ::close(fd);
+            return -1;
+        }
+        return fd;
+    }
+
+    /// @returns a socket listening at @p _path, replacing a stale socket there, or -1.
+    int listenSocket(string const& _path)
+    {
+        auto const address = socketAddress(_path);
+        if (!address)
+            return -1;
+
+        if (int const existing = connectSocket(_path); existing >= 0)
+        {
+            // Another daemon is serving its session there.
+            ::close(existing);
+            return -1;
+        }
+        unlink(_path.c_str());
+
+        int const fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0)
+            return -1;
+        setDescriptorFlags(fd, true);
+        if (bind(fd, reinterpret_cast<sockaddr const*>(&*address), sizeof(*address)) != 0
+                || listen(fd, 4) != 0)
+        {
+            ::close(fd);
+            return -1;
+        }
+        return fd;
+    }
+
+    /// Calls @p _process with each complete message at the front of @p _input, and erases them.
+    ///
+    /// @retval false a message was malformed or rejected by @p _process.
+    template <typename Process>
+    bool processMessages(vector<uint8_t>& _input, Process&& _process)
+    {
+        size_t offset = 0;
+        auto result = true;
+        while (result && _input.size() - offset >= MessageHeaderSize)
+        {
+            auto const kind = get<uint32_t>(_input.data() + offset);
+            auto const size = get<uint32_t>(_input.data() + offset + sizeof(uint32_t));
+            if (size > MaxMessageSize)
+                return false;
+            if (_input.size() - offset - MessageHeaderSize < size)
+                break;
+
+            result = _process(static_cast<MessageKind>(kind), _input.data() + offset + MessageHeaderSize, size);
+            offset += MessageHeaderSize + size;
+        }
+        _input.erase(_input.begin(), next(_input.begin(), static_cast<ptrdiff_t>(offset)));
+        return result;
+    }
+
+    string ringName()
+    {
+        static std::atomic<unsigned> counter = 0;
+        return "/contour-" + std::to_string(getpid()) + "-" + std::to_string(counter++);
+    }
+}
+
+// {{{ SessionDaemon
+struct SessionDaemon::Client {
+    struct Output {
+        shared_ptr<vector<uint8_t> const> data;
+        size_t sent = 0;
+        int fd = -1;                    // sent along with the first byte
+        size_t historySerialEnd = 0;    // of the viewer once an Update message has been sent
+    };
+
+    enum class Mode { Detached, Shared, Streaming };
+
+    int socket = -1;
+    Mode mode = Mode::Detached;
+    bool updatePending = false;     // an Updated message is queued
+    vector<uint8_t> input;
+    std::deque<Output> output;
+
+    // Streaming only.
+    size_t backlog = 0;             // bytes of Update messages queued
+    size_t historySerialEnd = 0;    // of the viewer once the queued Update messages have been sent
+    size_t sentHistorySerialEnd = 0;
+    bool keyframePending = false;   // updates have been skipped, to be replaced by a keyframe
+    bool changedSinceKeyframe = false;
+
+    ~Client()
+    {
+        for (auto const& item: output)
+            if (item.fd >= 0)
+                ::close(item.fd);
+        ::close(socket);
+    }
+
+    void send(vector<uint8_t> _message, int _fd = -1)
+    {
+        output.push_back(Output{make_shared<vector<uint8_t> const>(std::move(_message)), 0, _fd, 0});
+    }
+
+    static bool isUpdate(Output const& _item)
+    {
+        return get<uint32_t>(_item.data->data()) == static_cast<uint32_t>(MessageKind::Update);
+    }
+
+    /// Drops the Update messages not being sent yet.
+    void skipUpdates()
+    {
+        auto const skipped = [](Output const& _item) { return _item.sent == 0 && isUpdate(_item); };
+        output.erase(std::remove_if(output.begin(), output.end(), skipped), output.end());
+
+        backlog = 0;
+        historySerialEnd = sentHistorySerialEnd;
+        for (auto const& item: output)
+        {
+            if (isUpdate(item))
+            {
+                backlog += item.data->size();
+                historySerialEnd = item.historySerialEnd;
+            }
+        }
+    }
+};
+
+unique_ptr<SessionDaemon> SessionDaemon::create(Terminal& _terminal, string _socketPath)
+{
+    auto ring = SharedRing::create(ringName());
+    if (!ring)
+        return nullptr;
+
+    int const listener = listenSocket(_socketPath);
+    if (listener < 0)
+        return nullptr;
+
+    return unique_ptr<SessionDaemon>(new SessionDaemon(_terminal, std::move(_socketPath), listener, std::move(ring)));
+}
+
+SessionDaemon::SessionDaemon(Terminal& _terminal, string _socketPath, int _listener, unique_ptr<SharedRing> _ring) :
+    terminal_{_terminal},
+    socketPath_{std::move(_socketPath)},
+    listener_{_listener},
+    ring_{std::move(_ring)},
+    snapshot_{socketPath_ + ".snapshot"}
+{
+    if (pipe(wakeupPipe_) == 0)
+        for (int const fd: wakeupPipe_)
+            setDescriptorFlags(fd, true);
+    thread_ = std::thread{[this]() { run(); }};
+}
+
+SessionDaemon::~SessionDaemon()
+{
+    quit_ = true;
+    wakeup();
+    thread_.join();
+
+    clients_.clear();
+    ::close(listener_);
+    ::close(wakeupPipe_[0]);
+    ::close(wakeupPipe_[1]);
+    unlink(socketPath_.c_str());
+    unlink((socketPath_ + ".snapshot").c_str());
+}
+
+void SessionDaemon::screenUpdated()
+{
+    // Called with the terminal locked, hence publishing is left to the daemon's thread.
+    if (!updated_.exchange(true))
+        wakeup();
+}
+
+void SessionDaemon::close()
+{
+    closed_ = true;
+    wakeup();
+}
+
+void SessionDaemon::wakeup()
+{
+    auto const byte = uint8_t{0};
+    (void) ::write(wakeupPipe_[1], &byte, 1);
+}
+
+void SessionDaemon::run()
+{
+    auto lastPublish = steady_clock::time_point{};
+    auto fds = vector<pollfd>{};
+    auto closing = false;
+
+    for (;;)
+    {
+        auto const timeoutUntil = [now = steady_clock::now()](steady_clock::time_point _time) {
+            return static_cast<int>(max(ceil<milliseconds>(_time - now).count(), milliseconds::rep{0}));
+        };
+        auto timeout = -1;
+        if (updated_)
+            timeout = timeoutUntil(lastPublish + PublishInterval);
+        else if (std::any_of(clients_.begin(), clients_.end(), [](auto const& c) { return c->changedSinceKeyframe; }))
+            timeout = timeoutUntil(lastKeyframe_ + KeyframeInterval);
+
+        fds.clear();
+        fds.push_back(pollfd{wakeupPipe_[0], POLLIN, 0});
+        fds.push_back(pollfd{listener_, static_cast<short>(closing ? 0 : POLLIN), 0});
+        for (auto const& client: clients_)
+            fds.push_back(pollfd{client->socket, static_cast<short>(POLLIN | (client->output.empty() ? 0 : POLLOUT)), 0});
+
+        if (poll(fds.data(), fds.size(), timeout) < 0 && errno != EINTR)
+            break;
+
+        if (fds[0].revents & POLLIN)
+        {
+            uint8_t buffer[64];
+            while (::read(wakeupPipe_[0], buffer, sizeof(buffer)) > 0)
+                ;
+        }
+
+        for (size_t i = 0; i < clients_.size(); ++i)
+        {
+            auto& client = *clients_[i];
+            auto const events = fds[2 + i].revents;
+            auto alive = !(events & (POLLERR | POLLNVAL));
+            if (alive && (events & (POLLIN | POLLHUP)))
+                alive = receive(client);
+            if (alive && (events & POLLOUT))
+                alive = flush(client);
+            if (!alive)
+                clients_[i].reset();
+        }
+        clients_.erase(std::remove(clients_.begin(), clients_.end(), nullptr), clients_.end());
+
+        if (fds[1].revents & POLLIN)
+            accept();
+
+        if (closed_ && !closing)
+        {
+            closing = true;
+            updated_ = false;
+            publish();
+            for (auto& client: clients_)
+                client->send(message(MessageKind::Closed));
+        }
+        else if (updated_ && steady_clock::now() >= lastPublish + PublishInterval)
+        {
+            updated_ = false;
+            lastPublish = steady_clock::now();
+            publish();
+        }
+        if (!closing)
+            sendKeyframes();
+
+        for (size_t i = 0; i < clients_.size(); ++i)
+            if (!clients_[i]->output.empty() && !flush(*clients_[i]))
+                clients_[i].reset();
+        clients_.erase(std::remove(clients_.begin(), clients_.end(), nullptr), clients_.end());
+
+        if (quit_)
+            break;
+    }
+}
+
+void SessionDaemon::accept()
+{
+    for (;;)
+    {
+        int const fd = ::accept(listener_, nullptr, nullptr);
+        if (fd < 0)
+            return;
+        setDescriptorFlags(fd, true);
+        clients_.emplace_back(std::make_unique<Client>())->socket = fd;
+    }
+}
+
+bool SessionDaemon::receive(Client& _client)
+{
+    uint8_t buffer[16 * 1024];
+    for (;;)
+    {
+        auto const n = ::recv(_client.socket, buffer, sizeof(buffer), 0);
+        if (n == 0)
+            return false;
+        if (n < 0)
+            return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+
+        _client.input.insert(_client.input.end(), buffer, buffer + n);
+        auto const processed = processMessages(_client.input, [&](MessageKind _kind, uint8_t const* _data, size_t _size) {
+            return process(_client, _kind, _data, _size);
+        });
+        if (!processed)
+            return false;
+    }
+}
+
+bool SessionDaemon::process(Client& _client, MessageKind _kind, uint8_t const* _data, size_t _size)
+{
+    switch (_kind)
+    {
+        case MessageKind::Attach:
+            return attach(_client);
+        case MessageKind::Subscribe:
+            subscribe(_client);
+            return true;
+        case MessageKind::Input:
+            terminal_.sendRaw(std::string_view(reinterpret_cast<char const*>(_data), _size));
+            return true;
+        case MessageKind::Resize:
+            if (_size == 4 * sizeof(uint16_t))
+            {
+                auto const cells = Size{get<uint16_t>(_data), get<uint16_t>(_data + 2)};
+                auto const pixels = Size{get<uint16_t>(_data + 4), get<uint16_t>(_data + 6)};
+                if (cells.width > 0 && cells.height > 0)
+                    terminal_.resizeScreen(cells, pixels.width && pixels.height ? optional{pixels} : nullopt);
+                return true;
+            }
+            return false;
+        default:
+            return false;
+    }
+}
+
+bool SessionDaemon::flush(Client& _client)
+{
+    while (!_client.output.empty())
+    {
+        auto& item = _client.output.front();
+        auto const* data = item.data->data() + item.sent;
+        auto const size = item.data->size() - item.sent;
+
+        ssize_t n = 0;
+        if (item.fd >= 0)
+        {
+            auto part = iovec{const_cast<uint8_t*>(data), size};
+            char control[CMSG_SPACE(sizeof(int))] = {};
+            auto header = msghdr{};
+            header.msg_iov = &part;
+            header.msg_iovlen = 1;
+            header.msg_control = control;
+            header.msg_controllen = sizeof(control);
+            auto* cmsg = CMSG_FIRSTHDR(&header);
+            cmsg->cmsg_level = SOL_SOCKET;
+            cmsg->cmsg_type = SCM_RIGHTS;
+            cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+            std::memcpy(CMSG_DATA(cmsg), &item.fd, sizeof(int));
+            n = ::sendmsg(_client.socket, &header, NoSignal);
+            if (n > 0)
+            {
+                ::close(item.fd);
+                item.fd = -1;
+            }
+        }
+        else
+            n = ::send(_client.socket, data, size, NoSignal);
+
+        if (n < 0)
+            return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+
+        item.sent += static_cast<size_t>(n);
+        if (item.sent < item.data->size())
+            return true;
+
+        if (get<uint32_t>(item.data->data()) == static_cast<uint32_t>(MessageKind::Updated))
+            _client.updatePending = false;
+        else if (Client::isUpdate(item))
+        {
+            _client.backlog -= item.data->size();
+            _client.sentHistorySerialEnd = item.historySerialEnd;
+        }
+        _client.output.pop_front();
+    }
+    return true;
+}
+
+void SessionDaemon::publish()
+{
+    auto const _l = scoped_lock{terminal_};
+    publishLocked();
+}
+
+void SessionDaemon::publishLocked()
+{
+    using Mode = Client::Mode;
+
+    auto& screen = terminal_.screen();
+    auto const attached = [&](Mode _mode) {
+        return std::any_of(clients_.begin(), clients_.end(), [&](auto const& c) { return c->mode == _mode; });
+    };
+    auto const shared = attached(Mode::Shared);
+    auto const streaming = attached(Mode::Streaming);
+    if (!shared && !streaming)
+    {
+        // Whoever attaches starts from a snapshot or keyframe.
+        screen.clearDamage();
+        return;
+    }
+
+    auto const full = publishedSize_ != screen.size() || publishedScreenType_ != screen.bufferType();
+    publishedSize_ = screen.size();
+    publishedScreenType_ = screen.bufferType();
+
+    // Encoded once, regardless of the number of viewers.
+    auto const update = snapshot::encodeUpdate(screen.takeUpdate(historySerialEnd_, full));
+
+    if (shared && !ring_->write(update.data(), update.size()))
+    {
+        // Too large for the ring, hence the viewers start over from a snapshot.
+        for (auto& client: clients_)
+            if (client->mode == Mode::Shared && !attachLocked(*client))
+                client->mode = Mode::Detached;
+    }
+    else if (shared)
+    {
+        for (auto& client: clients_)
+        {
+            if (client->mode == Mode::Shared && !client->updatePending)
+            {
+                client->send(message(MessageKind::Updated));
+                client->updatePending = true;
+            }
+        }
+    }
+
+    if (streaming)
+    {
+        auto const data = make_shared<vector<uint8_t> const>(message(MessageKind::Update, update.data(), update.size()));
+        for (auto& client: clients_)
+            if (client->mode == Mode::Streaming)
+                stream(*client, data);
+    }
+}
+
+bool SessionDaemon::attach(Client& _client)
+{
+    auto const _l = scoped_lock{terminal_};
+
+    // Viewers attached already get the updates up to the snapshot.
+    publishLocked();
+
+    return attachLocked(_client);
+}
+
+bool SessionDaemon::attachLocked(Client& _client)
+{
+    auto& screen = terminal_.screen();
+    if (!snapshot_.write(screen))
+        return false;
+
+    // The size is passed along, as the file may be appended to before the viewer maps it.
+    int const fd = ::open((socketPath_ + ".snapshot").c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return false;
+
+    historySerialEnd_ = screen.historySerialEnd();
+    publishedSize_ = screen.size();
+    publishedScreenType_ = screen.bufferType();
+    screen.clearDamage();
+
+    auto payload = vector<uint8_t>{};
+    put<uint64_t>(payload, ring_->end());
+    put<uint64_t>(payload, snapshot_.fileSize());
+    payload.insert(payload.end(), ring_->name().begin(), ring_->name().end());
+    _client.send(message(MessageKind::Attached, payload.data(), payload.size()), fd);
+    _client.mode = Client::Mode::Shared;
+    return true;
+}
+
+void SessionDaemon::subscribe(Client& _client)
+{
+    auto const _l = scoped_lock{terminal_};
+
+    // Keyframes continue the updates published before.
+    publishLocked();
+
+    _client.mode = Client::Mode::Streaming;
+    _client.historySerialEnd = 0;
+    _client.sentHistorySerialEnd = 0;
+    sendKeyframe(_client);
+}
+
+void SessionDaemon::stream(Client& _client, shared_ptr<vector<uint8_t> const> _update)
+{
+    if (_client.keyframePending)
+        return;
+
+    if (_client.backlog > MaxStreamBacklog)
+    {
+        // The viewer falls behind, hence it continues with a keyframe once it caught up instead.
+        _client.skipUpdates();
+        _client.keyframePending = true;
+        return;
+    }
+
+    _client.backlog += _update->size();
+    _client.historySerialEnd = historySerialEnd_;
+    _client.changedSinceKeyframe = true;
+    _client.output.push_back(Client::Output{std::move(_update), 0, -1, historySerialEnd_});
+}
+
+void SessionDaemon::sendKeyframe(Client& _client)
+{
+    // Without any pending damage, such that the following updates apply on top of it.
+    auto const update = snapshot::encodeUpdate(terminal_.screen().keyframe(_client.historySerialEnd));
+    auto data = make_shared<vector<uint8_t> const>(message(MessageKind::Update, update.data(), update.size()));
+
+    _client.backlog += data->size();
+    _client.keyframePending = false;
+    _client.changedSinceKeyframe = false;
+    _client.output.push_back(Client::Output{std::move(data), 0, -1, _client.historySerialEnd});
+}
+
+void SessionDaemon::sendKeyframes()
+{
+    using Mode = Client::Mode;
+
+    auto const now = steady_clock::now();
+    auto const periodic = now >= lastKeyframe_ + KeyframeInterval;
+    if (periodic)
+        lastKeyframe_ = now;
+
+    auto const due = [&](Client const& _client) {
+        return _client.mode == Mode::Streaming
+            && (_client.keyframePending ? _client.output.empty() : periodic && _client.changedSinceKeyframe);
+    };
+    if (std::none_of(clients_.begin(), clients_.end(), [&](auto const& c) { return due(*c); }))
+        return;
+
+    auto const _l = scoped_lock{terminal_};
+    publishLocked();
+    for (auto& client: clients_)
+        if (due(*client))
+            sendKeyframe(*client);
+}
+// }}}
+
+// {{{ SessionViewer
+struct SessionViewer::Connection {
+    int socket;
+    std::mutex writeLock;
+    std::mutex closedLock;
+    std::condition_variable closedChanged;
+    bool closed = false;
+
+    explicit Connection(int _socket) : socket{_socket} {}
+    ~Connection() { ::close(socket); }
+
+    bool send(MessageKind _kind, void const* _data = nullptr, size_t _size = 0)
+    {
+        auto const data = message(_kind, _data, _size);
+        auto const _l = scoped_lock{writeLock};
+        for (size_t sent = 0; sent < data.size(); )
+        {
+            auto const n = ::send(socket, data.data() + sent, data.size() - sent, NoSignal);
+            if (n < 0 && errno != EINTR)
+                return false;
+            if (n > 0)
+                sent += static_cast<size_t>(n);
+        }
+        return true;
+    }
+
+    void close()
+    {
+        {
+            auto const _l = scoped_lock{closedLock};
+            closed = true;
+        }
+        closedChanged.notify_all();
+        shutdown(socket, SHUT_RDWR);
+    }
+};
+
+/// Stands in for the PTY of a terminal mirroring a session.
+class SessionViewer::RemotePty : public Pty {
+  public:
+    RemotePty(shared_ptr<Connection> _connection, Size _size) :
+        connection_{std::move(_connection)},
+        size_{_size}
+    {
+    }
+
+    ~RemotePty() override { close(); }
+
+    void close() override { connection_->close(); }
+    void prepareParentProcess() override {}
+    void prepareChildProcess() override {}
+
+    int read(char* /*_buf*/, size_t /*_size*/) override
+    {
+        // The screen is updated by the viewer instead.
+        auto lock = std::unique_lock{connection_->closedLock};
+        connection_->closedChanged.wait(lock, [&]() { return connection_->closed; });
+        return -1;
+    }
+
+    int write(char const* _buf, size_t _size) override
+    {
+        return connection_->send(MessageKind::Input, _buf, _size) ? static_cast<int>(_size) : -1;
+    }
+
+    Size screenSize() const noexcept override { return size_; }
+
+    void resizeScreen(Size _cells, optional<Size> _pixels) override
+    {
+        size_ = _cells;
+        pixels_ = _pixels.value_or(Size{});
+        sendSize();
+    }
+
+    void sendSize()
+    {
+        auto const payload = std::array<uint16_t, 4>{
+            static_cast<uint16_t>(size_.width), static_cast<uint16_t>(size_.height),
+            static_cast<uint16_t>(pixels_.width), static_cast<uint16_t>(pixels_.height)
+        };
+        connection_->send(MessageKind::Resize, payload.data(), sizeof(payload));
+    }
+
+  private:
+    shared_ptr<Connection> connection_;
+    Size size_;
+    Size pixels_{};
+};
+
+unique_ptr<SessionViewer> SessionViewer::connect(string const& _socketPath)
+{
+    int const fd = connectSocket(_socketPath);
+    if (fd < 0)
+        return nullptr;
+
+    return unique_ptr<SessionViewer>(new SessionViewer(make_shared<Connection>(fd)));
+}
+
+SessionViewer::SessionViewer(shared_ptr<Connection> _connection) :
+    connection_{std::move(_connection)}
+{
+}
+
+SessionViewer::~SessionViewer()
+{
+    connection_->close();
+    if (thread_.joinable())
+        thread_.join();
+}
+
+unique_ptr<Pty> SessionViewer::createPty(Size _screenSize)
+{
+    return std::make_unique<RemotePty>(connection_, _screenSize);
+}
+
+void SessionViewer::attach(Terminal& _terminal, bool _streaming)
+{
+    terminal_ = &_terminal;
+    streaming_ = _streaming;
+    thread_ = std::thread{[this]() { run(); }};
+}
+
+void SessionViewer::run()
+{
+    // The daemon's terminal takes the viewer's size before the snapshot is taken.
+    static_cast<RemotePty&>(terminal_->device()).sendSize();
+    auto running = streaming_ ? connection_->send(MessageKind::Subscribe)
+                              : (attaching_ = connection_->send(MessageKind::Attach));
+
+    auto input = vector<uint8_t>{};
+    auto fds = std::deque<int>{};
+    while (running)
+    {
+        uint8_t buffer[16 * 1024];
+        auto part = iovec{buffer, sizeof(buffer)};
+        char control[CMSG_SPACE(sizeof(int))] = {};
+        auto header = msghdr{};
+        header.msg_iov = &part;
+        header.msg_iovlen = 1;
+        header.msg_control = control;
+        header.msg_controllen = sizeof(control);
+
+        auto const n = ::recvmsg(connection_->socket, &header, 0);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            break;
+
+        for (auto* cmsg = CMSG_FIRSTHDR(&header); cmsg; cmsg = CMSG_NXTHDR(&header, cmsg))
+            if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS)
+                fds.push_back(get<int>(CMSG_DATA(cmsg)));
+
+        input.insert(input.end(), buffer, buffer + n);
+        running = processMessages(input, [&](MessageKind _kind, uint8_t const* _data, size_t _size) {
+            if (_kind != MessageKind::Attached)
+                return process(_kind, _data, _size);
+
+            int const fd = fds.empty() ? -1 : fds.front();
+            if (!fds.empty())
+                fds.pop_front();
+            auto const result = !streaming_ && fd >= 0 && attached(fd, _data, _size);
+            if (fd >= 0)
+                ::close(fd);
+            if (result || streaming_)
+                return true;
+
+            // Without the snapshot or the ring, such as via a socket forwarded from another host.
+            streaming_ = true;
+            attaching_ = false;
+            return connection_->send(MessageKind::Subscribe);
+        });
+    }
+
+    for (int const fd: fds)
+        ::close(fd);
+    connection_->close();
+}
+
+bool SessionViewer::attached(int _fd, uint8_t const* _data, size_t _size)
+{
+    if (_size < 2 * sizeof(uint64_t))
+        return false;
+
+    auto const offset = get<uint64_t>(_data);
+    auto const size = get<uint64_t>(_data + sizeof(uint64_t));
+    auto const ringName = string(reinterpret_cast<char const*>(_data) + 2 * sizeof(uint64_t),
+                                 _size - 2 * sizeof(uint64_t));
+
+    auto file = crispy::mapped_file::map(_fd, static_cast<size_t>(size));
+    if (!file)
+        return false;
+
+    if (!ring_ || ring_->name() != ringName)
+        ring_ = SharedRing::open(ringName);
+    if (!ring_)
+        return false;
+
+    {
+        auto const _l = scoped_lock{*terminal_};
+        if (!restoreSnapshot(terminal_->screen(), make_shared<crispy::mapped_file const>(std::move(*file))))
+            return false;
+    }
+
+    ringOffset_ = offset;
+    attaching_ = false;
+    follow();
+    return true;
+}
+
+bool SessionViewer::process(MessageKind _kind, uint8_t const* _data, size_t _size)
+{
+    switch (_kind)
+    {
+        case MessageKind::Updated:
+            if (!attaching_ && !streaming_)
+                follow();
+            return true;
+        case MessageKind::Update:
+            if (streaming_)
+                apply(_data, _size);
+            return true;
+        case MessageKind::Closed:
+            return false;
+        default:
+            return false;
+    }
+}
+
+void SessionViewer::follow()
+{
+    auto record = vector<uint8_t>{};
+    for (;;)
+    {
+        switch (ring_->read(ringOffset_, record))
+        {
+            case SharedRing::ReadResult::Record:
+                apply(record.data(), record.size());
+                break;
+            case SharedRing::ReadResult::Empty:
+                return;
+            case SharedRing::ReadResult::Overrun:
+                // Fell behind by more than the ring holds, hence starting over from a snapshot.
+                attaching_ = connection_->send(MessageKind::Attach);
+                return;
+        }
+    }
+}
+
+bool SessionViewer::apply(uint8_t const* _data, size_t _size)
+{
+    auto const update = snapshot::decodeUpdate(crispy::span<uint8_t const>(_data, _data + _size));
+    if (!update)
+        return false;
+
+    auto const _l = scoped_lock{*terminal_};
+    terminal_->screen().applyUpdate(*update);
+    return true;
+}
+// }}}
+
+} // end namespace
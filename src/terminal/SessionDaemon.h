@@ -0,0 +1,190 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2020 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <terminal/ScreenEvents.h>
+#include <terminal/ScreenSnapshot.h>
+#include <terminal/Size.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace terminal {
+
+class Pty;
+class SharedRing;
+class Terminal;
+
+/// Sessions keep a terminal and its application running in a daemon process, independent of any
+/// window showing it. Viewers attach to the daemon through a Unix domain socket, starting from a
+/// screen snapshot, and follow the screen updates the daemon publishes into a SharedRing.
+///
+/// Viewers unable to share memory with the daemon, such as when the socket is forwarded from
+/// another host, subscribe to a stream of the updates on the socket instead. It starts with a
+/// keyframe holding all rows, followed by the changed rows only, and another keyframe every
+/// KeyframeInterval. Viewers falling behind skip the updates queued up for them, and continue
+/// with a keyframe once they caught up, such that no more than the current screen is sent.
+///
+/// Messages on the socket consist of a header and payload, in host byte order:
+///
+///   header:     uint32 kind, uint32 payload size
+///   Attach:     (viewer) requests a snapshot, after which updates are followed
+///   Input:      (viewer) bytes to send to the application
+///   Resize:     (viewer) uint16 columns, uint16 lines, uint16 pixel width, uint16 pixel height
+///   Attached:   (daemon) uint64 ring offset, uint64 snapshot size, ring name, along with the
+///               descriptor of the snapshot file
+///   Updated:    (daemon) updates have been written to the ring
+///   Closed:     (daemon) the application has exited
+///   Subscribe:  (viewer) requests the stream of updates, in place of the ring
+///   Update:     (daemon) an update of the stream, see snapshot::encodeUpdate()
+///
+/// Only available on POSIX platforms.
+namespace session {
+    constexpr size_t MessageHeaderSize = 2 * sizeof(uint32_t);
+
+    /// Messages beyond this size close the connection.
+    constexpr size_t MaxMessageSize = 256 * 1024 * 1024;
+
+    enum class MessageKind : uint32_t {
+        Attach = 0,
+        Input = 1,
+        Resize = 2,
+        Attached = 3,
+        Updated = 4,
+        Closed = 5,
+        Subscribe = 6,
+        Update = 7,
+    };
+}
+
+/// Serves the screen of a terminal to the viewers of a session.
+class SessionDaemon {
+  public:
+    /// Listens at @p _socketPath for viewers of @p _terminal, keeping the snapshot viewers
+    /// attach with next to it.
+    ///
+    /// screenUpdated() must be called on each of the terminal's screen updates.
+    ///
+    /// @returns the daemon, or nullptr if the socket is in use or could not be created.
+    static std::unique_ptr<SessionDaemon> create(Terminal& _terminal, std::string _socketPath);
+
+    SessionDaemon(SessionDaemon const&) = delete;
+    SessionDaemon& operator=(SessionDaemon const&) = delete;
+    ~SessionDaemon();
+
+    /// Lets the daemon publish the terminal's screen updates, from within Terminal::Events.
+    void screenUpdated();
+
+    /// Publishes the final screen updates and tells the viewers that the session has ended.
+    void close();
+
+    /// Time the screen updates are collected for at least, before they are published.
+    static constexpr std::chrono::milliseconds PublishInterval{4};
+
+    /// Time between keyframes of the stream of updates, sent only if anything changed.
+    static constexpr std::chrono::seconds KeyframeInterval{10};
+
+    /// Number of bytes of updates queued up for a subscriber, beyond which they are skipped.
+    static constexpr size_t MaxStreamBacklog = 4 * 1024 * 1024;
+
+  private:
+    struct Client;
+
+    SessionDaemon(Terminal& _terminal, std::string _socketPath, int _listener,
+                  std::unique_ptr<SharedRing> _ring);
+
+    void run();
+    void wakeup();
+    void accept();
+    bool receive(Client& _client);
+    bool process(Client& _client, session::MessageKind _kind, uint8_t const* _data, size_t _size);
+    bool flush(Client& _client);
+    void publish();
+    void publishLocked();
+    bool attach(Client& _client);
+    bool attachLocked(Client& _client);
+    void subscribe(Client& _client);
+    void stream(Client& _client, std::shared_ptr<std::vector<uint8_t> const> _update);
+    void sendKeyframe(Client& _client);
+    void sendKeyframes();
+
+    Terminal& terminal_;
+    std::string socketPath_;
+    int listener_;
+    int wakeupPipe_[2] = {-1, -1};
+    std::unique_ptr<SharedRing> ring_;
+    SnapshotWriter snapshot_;
+
+    std::vector<std::unique_ptr<Client>> clients_;
+    size_t historySerialEnd_ = 0;
+    std::optional<Size> publishedSize_;
+    std::optional<ScreenType> publishedScreenType_;
+    std::chrono::steady_clock::time_point lastKeyframe_;
+
+    std::atomic<bool> updated_ = false;
+    std::atomic<bool> closed_ = false;
+    std::atomic<bool> quit_ = false;
+    std::thread thread_;
+};
+
+/// Mirrors the screen of a session into a local terminal, and forwards its input to the daemon.
+class SessionViewer {
+  public:
+    /// @returns the viewer connected to the daemon at @p _socketPath, or nullptr if none is
+    ///          listening there.
+    static std::unique_ptr<SessionViewer> connect(std::string const& _socketPath);
+
+    SessionViewer(SessionViewer const&) = delete;
+    SessionViewer& operator=(SessionViewer const&) = delete;
+    ~SessionViewer();
+
+    /// @returns the PTY to create the mirroring terminal with, of @p _screenSize. Its input and
+    ///          resizes go to the daemon, and reading from it waits for the session to end.
+    std::unique_ptr<Pty> createPty(Size _screenSize);
+
+    /// Starts mirroring the session into @p _terminal, which must have been created with the PTY
+    /// of createPty(), and must outlive this viewer.
+    ///
+    /// @param _streaming  whether to subscribe to the stream of updates right away, rather than
+    ///                    trying to share memory with the daemon first
+    void attach(Terminal& _terminal, bool _streaming = false);
+
+  private:
+    struct Connection;
+    class RemotePty;
+
+    explicit SessionViewer(std::shared_ptr<Connection> _connection);
+
+    void run();
+    bool process(session::MessageKind _kind, uint8_t const* _data, size_t _size);
+    bool attached(int _fd, uint8_t const* _data, size_t _size);
+    void follow();
+    bool apply(uint8_t const* _data, size_t _size);
+
+    std::shared_ptr<Connection> connection_;
+    Terminal* terminal_ = nullptr;
+    std::unique_ptr<SharedRing> ring_;
+    uint64_t ringOffset_ = 0;
+    bool attaching_ = false;
+    bool streaming_ = false;
+    std::thread thread_;
+};
+
+} // end namespace
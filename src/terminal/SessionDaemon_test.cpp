@@ -0,0 +1,183 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2020 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <terminal/SessionDaemon.h>
+#include <terminal/Terminal.h>
+#include <terminal/pty/MockPty.h>
+
+#include <crispy/stdfs.h>
+
+#include <catch2/catch.hpp>
+
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace terminal;
+using namespace std::chrono_literals;
+
+namespace
+{
+    struct DaemonEvents : public Terminal::Events {
+        SessionDaemon* daemon = nullptr;
+
+        void screenUpdated() override
+        {
+            if (daemon)
+                daemon->screenUpdated();
+        }
+    };
+
+    /// @returns whether @p _condition became true within a few seconds.
+    bool eventually(std::function<bool()> const& _condition)
+    {
+        auto const deadline = std::chrono::steady_clock::now() + 5s;
+        while (!_condition())
+        {
+            if (std::chrono::steady_clock::now() > deadline)
+                return false;
+            std::this_thread::sleep_for(1ms);
+        }
+        return true;
+    }
+
+    std::string lineText(Terminal& _terminal, int _row)
+    {
+        auto const _l = std::scoped_lock{_terminal};
+        return _terminal.screen().renderTextLine(_row);
+    }
+}
+
+TEST_CASE("SessionDaemon.attach", "[session]")
+{
+    auto const socketPath = (FileSystem::temp_directory_path()
+                             / ("contour-SessionDaemon_test-" + std::to_string(getpid()))).string();
+
+    auto daemonEvents = DaemonEvents{};
+    auto ownedPty = std::make_unique<MockPty>(Size{20, 4});
+    auto& pty = *ownedPty;
+    auto terminal = Terminal{std::move(ownedPty), daemonEvents};
+    auto daemon = SessionDaemon::create(terminal, socketPath);
+    REQUIRE(daemon);
+    daemonEvents.daemon = daemon.get();
+    CHECK_FALSE(SessionDaemon::create(terminal, socketPath));
+
+    pty.appendOutput("before\r\n");
+    REQUIRE(eventually([&]() { return lineText(terminal, 1).substr(0, 6) == "before"; }));
+
+    auto viewer = SessionViewer::connect(socketPath);
+    REQUIRE(viewer);
+    auto viewerEvents = Terminal::Events{};
+    auto viewerTerminal = Terminal{viewer->createPty(Size{20, 4}), viewerEvents};
+    viewer->attach(viewerTerminal);
+
+    // Attaching starts from a snapshot, followed by the updates.
+    CHECK(eventually([&]() { return lineText(viewerTerminal, 1).substr(0, 6) == "before"; }));
+    pty.appendOutput("after");
+    CHECK(eventually([&]() { return lineText(viewerTerminal, 2).substr(0, 5) == "after"; }));
+
+    // Input and resizes go to the daemon.
+    viewerTerminal.sendRaw("input");
+    CHECK(eventually([&]() { return pty.input() == "input"; }));
+    viewerTerminal.resizeScreen(Size{30, 6}, std::nullopt);
+    CHECK(eventually([&]() { return pty.screenSize() == Size{30, 6}; }));
+
+    viewer.reset();
+    daemon.reset();
+    CHECK_FALSE(SessionViewer::connect(socketPath));
+    pty.close();
+}
+
+TEST_CASE("SessionDaemon.snapshotMode", "[session]")
+{
+    auto const socketPath = (FileSystem::temp_directory_path()
+                             / ("contour-SessionDaemon_test-" + std::to_string(getpid()))).string();
+
+    // Even with a umask that lets everybody read new files, as the snapshot holds all output.
+    auto const umask = ::umask(0022);
+
+    auto daemonEvents = DaemonEvents{};
+    auto ownedPty = std::make_unique<MockPty>(Size{20, 4});
+    auto& pty = *ownedPty;
+    auto terminal = Terminal{std::move(ownedPty), daemonEvents};
+    auto daemon = SessionDaemon::create(terminal, socketPath);
+    REQUIRE(daemon);
+    daemonEvents.daemon = daemon.get();
+
+    // The snapshot is written when a viewer attaches.
+    pty.appendOutput("secret");
+    auto viewer = SessionViewer::connect(socketPath);
+    REQUIRE(viewer);
+    auto viewerEvents = Terminal::Events{};
+    auto viewerTerminal = Terminal{viewer->createPty(Size{20, 4}), viewerEvents};
+    viewer->attach(viewerTerminal);
+    REQUIRE(eventually([&]() { return lineText(viewerTerminal, 1).substr(0, 6) == "secret"; }));
+
+    struct stat st{};
+    REQUIRE(::stat((socketPath + ".snapshot").c_str(), &st) == 0);
+    CHECK((st.st_mode & 0777) == 0600);
+
+    ::umask(umask);
+    viewer.reset();
+    daemon.reset();
+    pty.close();
+}
+
+TEST_CASE("SessionDaemon.stream", "[session]")
+{
+    auto const socketPath = (FileSystem::temp_directory_path()
+                             / ("contour-SessionDaemon_test-" + std::to_string(getpid()))).string();
+
+    auto daemonEvents = DaemonEvents{};
+    auto ownedPty = std::make_unique<MockPty>(Size{20, 4});
+    auto& pty = *ownedPty;
+    auto terminal = Terminal{std::move(ownedPty), daemonEvents};
+    auto daemon = SessionDaemon::create(terminal, socketPath);
+    REQUIRE(daemon);
+    daemonEvents.daemon = daemon.get();
+
+    pty.appendOutput("before\r\n");
+    REQUIRE(eventually([&]() { return lineText(terminal, 1).substr(0, 6) == "before"; }));
+
+    // Subscribers and attached viewers follow the same session side by side.
+    auto streamer = SessionViewer::connect(socketPath);
+    REQUIRE(streamer);
+    auto streamerEvents = Terminal::Events{};
+    auto streamerTerminal = Terminal{streamer->createPty(Size{20, 4}), streamerEvents};
+    streamer->attach(streamerTerminal, true);
+
+    auto viewer = SessionViewer::connect(socketPath);
+    REQUIRE(viewer);
+    auto viewerEvents = Terminal::Events{};
+    auto viewerTerminal = Terminal{viewer->createPty(Size{20, 4}), viewerEvents};
+    viewer->attach(viewerTerminal);
+
+    // The stream starts with a keyframe, followed by the changed rows.
+    CHECK(eventually([&]() { return lineText(streamerTerminal, 1).substr(0, 6) == "before"; }));
+    pty.appendOutput("after");
+    CHECK(eventually([&]() { return lineText(streamerTerminal, 2).substr(0, 5) == "after"; }));
+    CHECK(eventually([&]() { return lineText(viewerTerminal, 2).substr(0, 5) == "after"; }));
+
+    streamerTerminal.sendRaw("input");
+    CHECK(eventually([&]() { return pty.input() == "input"; }));
+
+    streamer.reset();
+    viewer.reset();
+    daemon.reset();
+    pty.close();
+}
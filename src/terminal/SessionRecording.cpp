@@ -0,0 +1,200 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2020 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <terminal/SessionRecording.h>
+#include <terminal/Terminal.h>
+#include <terminal/pty/MockPty.h>
+
+#include <algorithm>
+#include <cstring>
+#include <thread>
+
+using std::min;
+using std::nullopt;
+using std::optional;
+using std::string;
+using std::string_view;
+using std::unique_ptr;
+
+using namespace std::chrono;
+
+namespace terminal {
+
+using recording::ChunkKind;
+
+namespace
+{
+    template <typename T>
+    T load(uint8_t const* _data) noexcept
+    {
+        T value;
+        std::memcpy(&value, _data, sizeof(T));
+        return value;
+    }
+
+    template <typename T>
+    void store(uint8_t*& _output, T _value) noexcept
+    {
+        std::memcpy(_output, &_value, sizeof(T));
+        _output += sizeof(T);
+    }
+}
+
+// {{{ SessionRecorder
+unique_ptr<SessionRecorder> SessionRecorder::create(string const& _path, Size _screenSize, steady_clock::time_point _now)
+{
+    std::FILE* file = std::fopen(_path.c_str(), "wb");
+    if (!file)
+        return nullptr;
+
+    auto recorder = unique_ptr<SessionRecorder>(new SessionRecorder(file, _now));
+
+    uint8_t header[recording::HeaderSize];
+    auto* output = header;
+    std::memcpy(output, recording::Magic, sizeof(recording::Magic));
+    output += sizeof(recording::Magic);
+    store(output, recording::Version);
+    store(output, static_cast<uint16_t>(_screenSize.width));
+    store(output, static_cast<uint16_t>(_screenSize.height));
+    std::fwrite(header, 1, sizeof(header), file);
+
+    return recorder;
+}
+
+SessionRecorder::~SessionRecorder()
+{
+    std::fflush(file_.get());
+}
+
+void SessionRecorder::output(char const* _data, size_t _size, steady_clock::time_point _now)
+{
+    // Chunks are bounded by the size of their size field.
+    while (_size != 0)
+    {
+        auto const n = min(_size, size_t{UINT32_MAX});
+        writeChunk(ChunkKind::Output, _data, static_cast<uint32_t>(n), _now);
+        _data += n;
+        _size -= n;
+    }
+}
+
+void SessionRecorder::resize(Size _screenSize, steady_clock::time_point _now)
+{
+    uint8_t data[2 * sizeof(uint16_t)];
+    auto* output = data;
+    store(output, static_cast<uint16_t>(_screenSize.width));
+    store(output, static_cast<uint16_t>(_screenSize.height));
+    writeChunk(ChunkKind::Resize, data, sizeof(data), _now);
+}
+
+void SessionRecorder::writeChunk(ChunkKind _kind, void const* _data, uint32_t _size, steady_clock::time_point _now)
+{
+    uint8_t header[recording::ChunkHeaderSize];
+    auto* output = header;
+    store(output, static_cast<uint64_t>(duration_cast<nanoseconds>(_now - start_).count()));
+    store(output, static_cast<uint32_t>(_kind));
+    store(output, _size);
+    std::fwrite(header, 1, sizeof(header), file_.get());
+    std::fwrite(_data, 1, _size, file_.get());
+}
+// }}}
+
+// {{{ SessionRecording
+optional<SessionRecording> SessionRecording::open(string const& _path)
+{
+    auto file = crispy::mapped_file::open(_path);
+    if (!file || file->size() < recording::HeaderSize)
+        return nullopt;
+
+    uint8_t const* const data = file->data();
+    size_t const size = file->size();
+    if (std::memcmp(data, recording::Magic, sizeof(recording::Magic)) != 0
+            || load<uint32_t>(data + sizeof(recording::Magic)) != recording::Version)
+        return nullopt;
+
+    auto result = SessionRecording{std::move(*file)};
+    result.screenSize_ = Size{
+        load<uint16_t>(data + sizeof(recording::Magic) + sizeof(uint32_t)),
+        load<uint16_t>(data + sizeof(recording::Magic) + sizeof(uint32_t) + sizeof(uint16_t))
+    };
+
+    // A recording cut short by a crash ends with an incomplete chunk, which is ignored.
+    for (size_t offset = recording::HeaderSize; size - offset >= recording::ChunkHeaderSize;)
+    {
+        auto const time = nanoseconds(load<uint64_t>(data + offset));
+        auto const kind = static_cast<ChunkKind>(load<uint32_t>(data + offset + sizeof(uint64_t)));
+        auto const chunkSize = size_t{load<uint32_t>(data + offset + sizeof(uint64_t) + sizeof(uint32_t))};
+        offset += recording::ChunkHeaderSize;
+        if (size - offset < chunkSize)
+            break;
+
+        auto const* chunkData = data + offset;
+        offset += chunkSize;
+
+        switch (kind)
+        {
+            case ChunkKind::Output:
+                result.chunks_.emplace_back(Chunk{time, kind, string_view(reinterpret_cast<char const*>(chunkData), chunkSize), Size{}});
+                result.outputSize_ += chunkSize;
+                break;
+            case ChunkKind::Resize:
+                if (chunkSize >= 2 * sizeof(uint16_t))
+                    result.chunks_.emplace_back(Chunk{time, kind, string_view{}, Size{
+                        load<uint16_t>(chunkData),
+                        load<uint16_t>(chunkData + sizeof(uint16_t))
+                    }});
+                break;
+            default:
+                // Chunks of unknown kinds are skipped, being added by later versions.
+                break;
+        }
+    }
+
+    return result;
+}
+// }}}
+
+void replay(SessionRecording const& _recording, Terminal& _terminal, MockPty& _pty, ReplayPace _pace)
+{
+    auto const start = steady_clock::now();
+    auto const parsedStart = _terminal.parsedBytes();
+    auto written = uint64_t{0};
+
+    auto const waitUntilParsed = [&]() {
+        while (_terminal.parsedBytes() - parsedStart < written)
+            std::this_thread::yield();
+    };
+
+    for (SessionRecording::Chunk const& chunk : _recording.chunks())
+    {
+        if (_pace == ReplayPace::Recorded)
+            std::this_thread::sleep_until(start + chunk.time);
+
+        switch (chunk.kind)
+        {
+            case ChunkKind::Output:
+                _pty.appendOutput(chunk.output);
+                written += chunk.output.size();
+                break;
+            case ChunkKind::Resize:
+                // All output preceding the resize must have been parsed at the previous size.
+                waitUntilParsed();
+                _terminal.resizeScreen(chunk.screenSize, nullopt);
+                break;
+        }
+    }
+
+    waitUntilParsed();
+}
+
+} // end namespace
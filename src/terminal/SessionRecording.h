@@ -0,0 +1,132 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2020 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <terminal/Size.h>
+
+#include <crispy/mapped_file.h>
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace terminal {
+
+class MockPty;
+class Terminal;
+
+/// Session recordings hold the output of an application, as parsed by the Terminal, along with
+/// the time it was parsed at and the screen resizes in between, such that real sessions can be
+/// replayed for reproducible performance measurements.
+///
+/// The file starts with a header, followed by any number of chunks, all in host byte order:
+///
+///   header: char[8] magic "VTREC\0\0\0", uint32 version, uint16 columns, uint16 lines
+///   chunk:  uint64 nanoseconds since the start, uint32 kind, uint32 size, and size bytes of data
+///
+/// The data of output chunks is the output itself, the data of resize chunks is uint16 columns
+/// and uint16 lines. Nothing is aligned, such that chunks can be appended as they come, and read
+/// straight from the memory mapped file.
+namespace recording {
+    constexpr char Magic[8] = {'V', 'T', 'R', 'E', 'C', 0, 0, 0};
+    constexpr uint32_t Version = 1;
+    constexpr size_t HeaderSize = sizeof(Magic) + sizeof(uint32_t) + 2 * sizeof(uint16_t);
+    constexpr size_t ChunkHeaderSize = sizeof(uint64_t) + 2 * sizeof(uint32_t);
+
+    enum class ChunkKind : uint32_t {
+        Output = 0,
+        Resize = 1,
+    };
+}
+
+/// Writes a session recording, see the recording namespace for its format.
+class SessionRecorder {
+  public:
+    /// Creates a recorder writing to @p _path, starting at the given screen size.
+    ///
+    /// @returns the recorder, or nullptr if the file could not be created.
+    static std::unique_ptr<SessionRecorder> create(std::string const& _path,
+                                                   Size _screenSize,
+                                                   std::chrono::steady_clock::time_point _now);
+
+    SessionRecorder(SessionRecorder const&) = delete;
+    SessionRecorder& operator=(SessionRecorder const&) = delete;
+    ~SessionRecorder();
+
+    /// Records output about to be parsed at @p _now.
+    void output(char const* _data, size_t _size, std::chrono::steady_clock::time_point _now);
+
+    /// Records the screen being resized at @p _now.
+    void resize(Size _screenSize, std::chrono::steady_clock::time_point _now);
+
+  private:
+    SessionRecorder(std::FILE* _file, std::chrono::steady_clock::time_point _start) :
+        file_{_file, &std::fclose},
+        start_{_start}
+    {}
+
+    void writeChunk(recording::ChunkKind _kind, void const* _data, uint32_t _size, std::chrono::steady_clock::time_point _now);
+
+    std::unique_ptr<std::FILE, int(*)(std::FILE*)> file_;
+    std::chrono::steady_clock::time_point start_;
+};
+
+/// Session recording read from a (memory mapped) file.
+class SessionRecording {
+  public:
+    struct Chunk {
+        std::chrono::nanoseconds time;  // since the start of the recording
+        recording::ChunkKind kind;
+        std::string_view output;        // output, if an output chunk
+        Size screenSize;                // new screen size, if a resize chunk
+    };
+
+    /// @returns the recording at @p _path, or std::nullopt if it cannot be read or is malformed.
+    static std::optional<SessionRecording> open(std::string const& _path);
+
+    /// @returns the screen size at the start of the recording.
+    Size screenSize() const noexcept { return screenSize_; }
+
+    /// @returns the chunks of the recording, referring to the file's contents.
+    std::vector<Chunk> const& chunks() const noexcept { return chunks_; }
+
+    /// @returns the total number of bytes of output.
+    size_t outputSize() const noexcept { return outputSize_; }
+
+  private:
+    explicit SessionRecording(crispy::mapped_file _file) : file_{std::move(_file)} {}
+
+    crispy::mapped_file file_;
+    Size screenSize_{};
+    std::vector<Chunk> chunks_;
+    size_t outputSize_ = 0;
+};
+
+enum class ReplayPace {
+    Recorded,   // waits for each chunk's time to have passed since the replay started
+    MaxSpeed,   // feeds all chunks right away
+};
+
+/// Replays @p _recording into @p _terminal by writing its output to @p _pty, being the
+/// terminal's PTY, and resizing the terminal as recorded.
+///
+/// @returns once all of the output has been parsed by the terminal.
+void replay(SessionRecording const& _recording, Terminal& _terminal, MockPty& _pty, ReplayPace _pace);
+
+} // end namespace
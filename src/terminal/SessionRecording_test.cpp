@@ -0,0 +1,69 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2020 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <terminal/SessionRecording.h>
+
+#include <crispy/stdfs.h>
+
+#include <catch2/catch.hpp>
+
+#include <cstdio>
+
+using namespace std::chrono;
+using namespace terminal;
+using recording::ChunkKind;
+
+TEST_CASE("SessionRecording.roundtrip")
+{
+    auto const path = (FileSystem::temp_directory_path() / "contour-SessionRecording_test.vtrec").string();
+    auto const start = steady_clock::now();
+
+    {
+        auto recorder = SessionRecorder::create(path, Size{80, 25}, start);
+        REQUIRE(recorder);
+        recorder->output("Hello", 5, start + milliseconds(1));
+        recorder->resize(Size{100, 30}, start + milliseconds(2));
+        recorder->output("\033[mWorld", 8, start + milliseconds(3));
+    }
+
+    auto const recording = SessionRecording::open(path);
+    REQUIRE(recording.has_value());
+    CHECK(recording->screenSize() == Size{80, 25});
+    CHECK(recording->outputSize() == 13);
+
+    auto const& chunks = recording->chunks();
+    REQUIRE(chunks.size() == 3);
+    CHECK(chunks[0].kind == ChunkKind::Output);
+    CHECK(chunks[0].time == milliseconds(1));
+    CHECK(chunks[0].output == "Hello");
+    CHECK(chunks[1].kind == ChunkKind::Resize);
+    CHECK(chunks[1].screenSize == Size{100, 30});
+    CHECK(chunks[2].output == "\033[mWorld");
+    CHECK(chunks[2].time == milliseconds(3));
+
+    std::remove(path.c_str());
+}
+
+TEST_CASE("SessionRecording.malformed")
+{
+    auto const path = (FileSystem::temp_directory_path() / "contour-SessionRecording_test.txt").string();
+    {
+        auto* file = std::fopen(path.c_str(), "wb");
+        REQUIRE(file);
+        std::fputs("not a session recording", file);
+        std::fclose(file);
+    }
+
+    CHECK_FALSE(SessionRecording::open(path).has_value());
+    std::remove(path.c_str());
+}
@@ -0,0 +1,193 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2020 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <terminal/SharedRing.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <new>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using std::min;
+using std::string;
+using std::unique_ptr;
+using std::vector;
+
+namespace terminal {
+
+namespace
+{
+    constexpr char Magic[8] = {'V', 'T', 'R', 'I', 'N', 'G', 0, 0};
+    constexpr uint32_t Version = 1;
+}
+
+/// Placed at the start of the shared memory, followed by the ring's data.
+///
+/// The writer announces the end of the data it is about to overwrite in reserved, before writing,
+/// and the end of the data completely written in committed, after writing. Readers copy a record
+/// out first and check reserved afterwards, to know whether it was overwritten meanwhile.
+struct SharedRing::Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t headerSize;
+    uint64_t capacity;
+    std::atomic<uint64_t> reserved;
+    std::atomic<uint64_t> committed;
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "Shared memory requires address-free atomics.");
+
+unique_ptr<SharedRing> SharedRing::create(string const& _name, size_t _capacity)
+{
+    int const fd = shm_open(_name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0)
+        return nullptr;
+
+    auto const size = sizeof(Header) + _capacity;
+    void* memory = ftruncate(fd, static_cast<off_t>(size)) == 0
+        ? mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)
+        : MAP_FAILED;
+    ::close(fd);
+    if (memory == MAP_FAILED)
+    {
+        shm_unlink(_name.c_str());
+        return nullptr;
+    }
+
+    auto* header = new (memory) Header{};
+    std::memcpy(header->magic, Magic, sizeof(Magic));
+    header->version = Version;
+    header->headerSize = sizeof(Header);
+    header->capacity = _capacity;
+
+    return unique_ptr<SharedRing>(new SharedRing(_name, memory, size, true));
+}
+
+unique_ptr<SharedRing> SharedRing::open(string const& _name)
+{
+    int const fd = shm_open(_name.c_str(), O_RDONLY, 0);
+    if (fd < 0)
+        return nullptr;
+
+    struct stat st{};
+    void* memory = fstat(fd, &st) == 0 && static_cast<size_t>(st.st_size) > sizeof(Header)
+        ? mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_SHARED, fd, 0)
+        : MAP_FAILED;
+    ::close(fd);
+    if (memory == MAP_FAILED)
+        return nullptr;
+
+    auto const size = static_cast<size_t>(st.st_size);
+    auto const* header = static_cast<Header const*>(memory);
+    if (std::memcmp(header->magic, Magic, sizeof(Magic)) != 0
+            || header->version != Version
+            || header->headerSize != sizeof(Header)
+            || header->capacity != size - sizeof(Header))
+    {
+        munmap(memory, size);
+        return nullptr;
+    }
+
+    return unique_ptr<SharedRing>(new SharedRing(_name, memory, size, false));
+}
+
+SharedRing::SharedRing(string _name, void* _memory, size_t _size, bool _owner) :
+    name_{std::move(_name)},
+    memory_{_memory},
+    size_{_size},
+    owner_{_owner},
+    header_{static_cast<Header*>(_memory)},
+    data_{static_cast<uint8_t*>(_memory) + sizeof(Header)},
+    capacity_{_size - sizeof(Header)}
+{
+}
+
+SharedRing::~SharedRing()
+{
+    munmap(memory_, size_);
+    if (owner_)
+        shm_unlink(name_.c_str());
+}
+
+uint64_t SharedRing::end() const noexcept
+{
+    return header_->committed.load(std::memory_order_acquire);
+}
+
+bool SharedRing::write(uint8_t const* _data, size_t _size)
+{
+    auto const recordSize = sizeof(uint32_t) + _size;
+    if (recordSize > capacity_)
+        return false;
+
+    auto const offset = header_->committed.load(std::memory_order_relaxed);
+    header_->reserved.store(offset + recordSize, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    auto const size = static_cast<uint32_t>(_size);
+    copyIn(offset, &size, sizeof(size));
+    copyIn(offset + sizeof(size), _data, _size);
+
+    header_->committed.store(offset + recordSize, std::memory_order_release);
+    return true;
+}
+
+SharedRing::ReadResult SharedRing::read(uint64_t& _offset, vector<uint8_t>& _record) const
+{
+    auto const committed = header_->committed.load(std::memory_order_acquire);
+    if (_offset == committed)
+        return ReadResult::Empty;
+    if (_offset > committed || committed - _offset > capacity_)
+        return ReadResult::Overrun;
+
+    uint32_t size = 0;
+    copyOut(_offset, &size, sizeof(size));
+    if (size > committed - _offset - sizeof(size))
+        return ReadResult::Overrun;
+
+    _record.resize(size);
+    copyOut(_offset + sizeof(size), _record.data(), size);
+
+    // Whatever the writer overwrote meanwhile, it announced before.
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (header_->reserved.load(std::memory_order_relaxed) - _offset > capacity_)
+        return ReadResult::Overrun;
+
+    _offset += sizeof(size) + size;
+    return ReadResult::Record;
+}
+
+void SharedRing::copyIn(uint64_t _offset, void const* _data, size_t _size) noexcept
+{
+    auto const* input = static_cast<uint8_t const*>(_data);
+    auto const position = static_cast<size_t>(_offset % capacity_);
+    auto const n = min(_size, static_cast<size_t>(capacity_) - position);
+    std::memcpy(data_ + position, input, n);
+    std::memcpy(data_, input + n, _size - n);
+}
+
+void SharedRing::copyOut(uint64_t _offset, void* _data, size_t _size) const noexcept
+{
+    auto* output = static_cast<uint8_t*>(_data);
+    auto const position = static_cast<size_t>(_offset % capacity_);
+    auto const n = min(_size, static_cast<size_t>(capacity_) - position);
+    std::memcpy(output, data_ + position, n);
+    std::memcpy(output + n, data_, _size - n);
+}
+
+} // end namespace
@@ -0,0 +1,84 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2020 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace terminal {
+
+/// Ring buffer of records in shared memory, written by one process and read by any number of others.
+///
+/// Records are addressed by their offset into the stream of all records ever written. Readers
+/// never hold back the writer: a reader falling behind by more than the ring's capacity misses
+/// records, which it is told about, and has to catch up by other means.
+///
+/// Only available on POSIX platforms.
+class SharedRing {
+  public:
+    static constexpr size_t DefaultCapacity = 16 * 1024 * 1024;
+
+    /// Creates the shared memory object @p _name (starting with a slash), removed again once
+    /// the ring is destroyed.
+    ///
+    /// @returns the ring to write to, or nullptr if it could not be created.
+    static std::unique_ptr<SharedRing> create(std::string const& _name, size_t _capacity = DefaultCapacity);
+
+    /// @returns the ring created as @p _name to read from, or nullptr if it could not be opened.
+    static std::unique_ptr<SharedRing> open(std::string const& _name);
+
+    SharedRing(SharedRing const&) = delete;
+    SharedRing& operator=(SharedRing const&) = delete;
+    ~SharedRing();
+
+    std::string const& name() const noexcept { return name_; }
+
+    /// @returns the offset following the most recent record.
+    uint64_t end() const noexcept;
+
+    /// Appends a record, overwriting the oldest ones as needed.
+    ///
+    /// @retval false the record is larger than the ring's capacity.
+    bool write(uint8_t const* _data, size_t _size);
+
+    enum class ReadResult {
+        Record,     ///< the record has been read and the offset advanced past it
+        Empty,      ///< no more records have been written yet
+        Overrun,    ///< the record at the offset has been overwritten already
+    };
+
+    /// Reads the record at @p _offset into @p _record.
+    ReadResult read(uint64_t& _offset, std::vector<uint8_t>& _record) const;
+
+  private:
+    struct Header;
+
+    SharedRing(std::string _name, void* _memory, size_t _size, bool _owner);
+
+    void copyIn(uint64_t _offset, void const* _data, size_t _size) noexcept;
+    void copyOut(uint64_t _offset, void* _data, size_t _size) const noexcept;
+
+    std::string name_;
+    void* memory_;
+    size_t size_;
+    bool owner_;
+    Header* header_;
+    uint8_t* data_;
+    uint64_t capacity_;
+};
+
+} // end namespace
@@ -0,0 +1,96 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2020 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <terminal/SharedRing.h>
+
+#include <catch2/catch.hpp>
+
+#include <string>
+#include <unistd.h>
+
+using namespace terminal;
+using ReadResult = SharedRing::ReadResult;
+
+namespace
+{
+    std::string ringName()
+    {
+        return "/contour-SharedRing_test-" + std::to_string(getpid());
+    }
+
+    bool write(SharedRing& _ring, std::string const& _text)
+    {
+        return _ring.write(reinterpret_cast<uint8_t const*>(_text.data()), _text.size());
+    }
+
+    std::string text(std::vector<uint8_t> const& _record)
+    {
+        return std::string(_record.begin(), _record.end());
+    }
+}
+
+TEST_CASE("SharedRing.roundtrip")
+{
+    auto writer = SharedRing::create(ringName(), 64);
+    REQUIRE(writer);
+    auto reader = SharedRing::open(ringName());
+    REQUIRE(reader);
+
+    auto offset = reader->end();
+    auto record = std::vector<uint8_t>{};
+    CHECK(reader->read(offset, record) == ReadResult::Empty);
+
+    // Records wrap around the end of the ring.
+    for (int i = 0; i < 10; ++i)
+    {
+        auto const message = "record " + std::to_string(i);
+        REQUIRE(write(*writer, message));
+        REQUIRE(reader->read(offset, record) == ReadResult::Record);
+        CHECK(text(record) == message);
+        CHECK(reader->read(offset, record) == ReadResult::Empty);
+    }
+    CHECK(offset == writer->end());
+
+    CHECK_FALSE(writer->write(nullptr, 64));
+}
+
+TEST_CASE("SharedRing.overrun")
+{
+    auto writer = SharedRing::create(ringName(), 64);
+    REQUIRE(writer);
+    auto reader = SharedRing::open(ringName());
+    REQUIRE(reader);
+
+    auto offset = reader->end();
+    for (int i = 0; i < 10; ++i)
+        REQUIRE(write(*writer, "record " + std::to_string(i)));
+
+    auto record = std::vector<uint8_t>{};
+    CHECK(reader->read(offset, record) == ReadResult::Overrun);
+
+    // Readers catch up with the most recent records.
+    offset = writer->end();
+    REQUIRE(write(*writer, "latest"));
+    REQUIRE(reader->read(offset, record) == ReadResult::Record);
+    CHECK(text(record) == "latest");
+}
+
+TEST_CASE("SharedRing.removed")
+{
+    {
+        auto writer = SharedRing::create(ringName(), 64);
+        REQUIRE(writer);
+        CHECK_FALSE(SharedRing::create(ringName(), 64));
+    }
+    CHECK_FALSE(SharedRing::open(ringName()));
+}
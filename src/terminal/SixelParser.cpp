@@ -14,11 +14,17 @@
 #include <terminal/SixelParser.h>
 
 #include <algorithm>
+#include <optional>
+#include <utility>
 
 using std::clamp;
 using std::fill;
+using std::make_shared;
 using std::max;
 using std::min;
+using std::optional;
+using std::shared_ptr;
+using std::string_view;
 using std::vector;
 
 namespace terminal {
@@ -49,6 +55,47 @@ namespace
     {
         return RGBColor{r, g, b};
     }
+
+    // Maximum number of sixels collected before being passed to the event handler.
+    auto constexpr MaxPendingSixels = size_t{4096};
+
+    /// Paints @p _sixel into @p _count consecutive columns, the top pixel of the first at @p _line.
+    void paintRepeated(uint8_t* _line, size_t _stride, int _rows, RGBColor _color, int8_t _sixel, int _count)
+    {
+        for (int i = 0; i < _rows; ++i, _line += _stride)
+        {
+            if ((_sixel & (1 << i)) == 0)
+                continue;
+
+            auto p = _line;
+            for (int n = 0; n < _count; ++n)
+            {
+                *p++ = _color.red;
+                *p++ = _color.green;
+                *p++ = _color.blue;
+                *p++ = 0xFF;
+            }
+        }
+    }
+
+    /// Paints the run of @p _count sixels, the top pixel of the first at @p _column.
+    void paintRun(uint8_t* _column, size_t _stride, int _rows, RGBColor _color, int8_t const* _sixels, int _count)
+    {
+        for (int n = 0; n < _count; ++n, _column += 4)
+        {
+            auto p = _column;
+            for (int i = 0; i < _rows; ++i, p += _stride)
+            {
+                if ((_sixels[n] & (1 << i)) != 0)
+                {
+                    p[0] = _color.red;
+                    p[1] = _color.green;
+                    p[2] = _color.blue;
+                    p[3] = 0xFF;
+                }
+            }
+        }
+    }
 }
 
 // VT 340 default color palette (https://www.vt100.net/docs/vt3xx-gp/chapter2.html#S2.4)
@@ -118,12 +165,22 @@ RGBColor ColorPalette::at(int _index) const noexcept
 
 SixelParser::SixelParser(Events& _events, OnFinalize _finalizer) :
     events_{ _events },
-    finalizer_{ move(_finalizer) }
+    finalizer_{ _finalizer }
 {
 }
 
 void SixelParser::parse(char32_t _value)
 {
+    if (state_ == State::Ground && isSixel(_value))
+    {
+        sixels_.push_back(toSixel(_value));
+        if (sixels_.size() == MaxPendingSixels)
+            flushSixels();
+        return;
+    }
+
+    flushSixels();
+
     switch (state_)
     {
         case State::Ground:
@@ -136,9 +193,7 @@ void SixelParser::parse(char32_t _value)
                 paramShiftAndAddDigit(toDigit(_value));
             else if (isSixel(_value))
             {
-                auto const sixel = toSixel(_value);
-                for (int i = 0; i < params_[0]; ++i)
-                    events_.render(sixel);
+                events_.render(toSixel(_value), params_[0]);
                 transitionTo(State::Ground);
             }
             else
@@ -159,7 +214,7 @@ void SixelParser::parse(char32_t _value)
             if (isDigit(_value))
                 paramShiftAndAddDigit(toDigit(_value));
             else if (_value == ';')
-                params_.push_back(0);
+                appendParameter();
             else
                 fallback(_value);
             break;
@@ -168,7 +223,7 @@ void SixelParser::parse(char32_t _value)
             if (isDigit(_value))
                 paramShiftAndAddDigit(toDigit(_value));
             else if (_value == ';')
-                params_.push_back(0);
+                appendParameter();
             else
                 fallback(_value);
             break;
@@ -199,14 +254,24 @@ void SixelParser::fallback(char32_t _value)
             transitionTo(State::Ground);
 
         if (isSixel(_value))
-            events_.render(toSixel(_value));
+            events_.render(toSixel(_value), 1);
     }
 
     // ignore any other input value
 }
 
+void SixelParser::flushSixels()
+{
+    if (sixels_.empty())
+        return;
+
+    events_.render(sixels_.data(), sixels_.size());
+    sixels_.clear();
+}
+
 void SixelParser::done()
 {
+    flushSixels();
     transitionTo(State::Ground); // this also ensures current state's leave action is invoked
 
     if (finalizer_)
@@ -216,7 +281,13 @@ void SixelParser::done()
 void SixelParser::paramShiftAndAddDigit(int _value)
 {
     int& number = params_.back();
-    number = number * 10 + _value;
+    number = min(number * 10 + _value, MaxParameterValue);
+}
+
+void SixelParser::appendParameter()
+{
+    if (params_.size() < MaxParameters)
+        params_.push_back(0);
 }
 
 void SixelParser::transitionTo(State _newState)
@@ -301,6 +372,12 @@ void SixelParser::pass(char32_t _char)
     parse(_char);
 }
 
+void SixelParser::pass(std::string_view _chars)
+{
+    for (char const ch: _chars)
+        parse(static_cast<char32_t>(ch));
+}
+
 void SixelParser::finalize()
 {
     done();
@@ -315,31 +392,50 @@ SixelImageBuilder::SixelImageBuilder(Size const& _maxSize,
                                      std::shared_ptr<ColorPalette> _colorPalette) :
     maxSize_{ _maxSize },
     colors_{ std::move(_colorPalette) },
+    backgroundColor_{ _backgroundColor },
     size_{ _maxSize },
-    buffer_(size_.width * size_.height * 4),
+    buffer_{},
     sixelCursor_{ 0, 0 },
     currentColor_{0},
     aspectRatio_{ _aspectVertical, _aspectHorizontal }
 {
-    clear(_backgroundColor);
+}
+
+void SixelImageBuilder::allocate()
+{
+    if (!buffer_.empty())
+        return;
+
+    buffer_.resize(static_cast<size_t>(size_.width) * static_cast<size_t>(size_.height) * 4);
+
+    auto const fillColor = std::array<uint8_t, 4>{
+        backgroundColor_.red(),
+        backgroundColor_.green(),
+        backgroundColor_.blue(),
+        backgroundColor_.alpha()
+    };
+    for (auto p = buffer_.begin(); p != buffer_.end(); p += 4)
+        std::copy(fillColor.begin(), fillColor.end(), p);
 }
 
 void SixelImageBuilder::clear(RGBAColor _fillColor)
 {
     sixelCursor_ = {0, 0};
+    backgroundColor_ = _fillColor;
+    resizedWithData_ = false;
 
-    auto p = &buffer_[0];
-    for (int i = 0; i < size_.width * size_.height; ++i)
+    if (!buffer_.empty())
     {
-        *p++ = _fillColor.red();
-        *p++ = _fillColor.green();
-        *p++ = _fillColor.blue();
-        *p++ = _fillColor.alpha();
+        buffer_.clear();
+        allocate();
     }
 }
 
 RGBAColor SixelImageBuilder::at(Coordinate _coord) const noexcept
 {
+    if (buffer_.empty())
+        return backgroundColor_;
+
     auto const row = _coord.row % size_.height;
     auto const col = _coord.column % size_.width;
     auto const base = row * size_.width * 4 + col * 4;
@@ -347,18 +443,6 @@ RGBAColor SixelImageBuilder::at(Coordinate _coord) const noexcept
     return RGBAColor{color[0], color[1], color[2], color[3]};
 }
 
-void SixelImageBuilder::write(Coordinate const& _coord, RGBColor const& _value) noexcept
-{
-    if (_coord.row >= 0 && _coord.row < size_.height && _coord.column >= 0 && _coord.column < size_.width)
-    {
-        auto const base = _coord.row * size_.width * 4 + _coord.column * 4;
-        buffer_[base + 0] = _value.red;
-        buffer_[base + 1] = _value.green;
-        buffer_[base + 2] = _value.blue;
-        buffer_[base + 3] = 0xFF;
-    }
-}
-
 void SixelImageBuilder::setColor(int _index, RGBColor const& _color)
 {
     colors_->setColor(_index, _color);
@@ -378,37 +462,323 @@ void SixelImageBuilder::newline()
 {
     sixelCursor_.column = 0;
 
+    auto const rows = min(sixelCursor_.row + 6, size_.height);
+
     if (sixelCursor_.row + 6 < size_.height)
         sixelCursor_.row += 6;
+
+    if (onBand_)
+        onBand_(rows);
 }
 
 void SixelImageBuilder::setRaster(int _pan, int _pad, Size const& _imageSize)
 {
     aspectRatio_.nominator = _pan;
     aspectRatio_.denominator = _pad;
-    size_.width = clamp(_imageSize.width, 0, maxSize_.width);
-    size_.height = clamp(_imageSize.height, 0, maxSize_.height);
 
-    buffer_.resize(size_.width * size_.height * 4);
+    auto const newSize = Size{
+        clamp(_imageSize.width, 0, maxSize_.width),
+        clamp(_imageSize.height, 0, maxSize_.height)
+    };
+
+    if (buffer_.empty() || newSize == size_)
+    {
+        size_ = newSize;
+        return;
+    }
+
+    // Raster attributes are expected to preceed any pixel data, but if not, keep what has been
+    // painted so far. Copying that is done once at most, such that repeated raster attributes
+    // cannot take time quadratic in the size of the input.
+    if (resizedWithData_)
+        return;
+    resizedWithData_ = true;
+
+    auto const oldSize = size_;
+    auto const oldBuffer = move(buffer_);
+    buffer_.clear();
+    size_ = newSize;
+    allocate();
+
+    auto const rowBytes = static_cast<size_t>(min(oldSize.width, size_.width)) * 4;
+    for (int row = 0; row < min(oldSize.height, size_.height); ++row)
+        std::copy_n(&oldBuffer[static_cast<size_t>(row * oldSize.width) * 4],
+                    rowBytes,
+                    &buffer_[static_cast<size_t>(row * size_.width) * 4]);
 }
 
-void SixelImageBuilder::render(int8_t _sixel)
+void SixelImageBuilder::render(int8_t _sixel, int _count)
 {
     // TODO: respect aspect ratio!
     auto const x = sixelCursor_.column;
-    if (x < size_.width)
+    auto const count = min(_count, size_.width - x);
+    if (count <= 0)
+        return;
+
+    auto const rows = min(6, size_.height - sixelCursor_.row);
+    if (rows <= 0)
     {
-        for (int i = 0; i < 6; ++i)
+        sixelCursor_.column += count;
+        return;
+    }
+
+    allocate();
+
+    auto const stride = static_cast<size_t>(size_.width) * 4;
+    auto const line = &buffer_[(static_cast<size_t>(sixelCursor_.row) * static_cast<size_t>(size_.width) + static_cast<size_t>(x)) * 4];
+    paintRepeated(line, stride, rows, currentColor(), _sixel, count);
+
+    sixelCursor_.column += count;
+}
+
+void SixelImageBuilder::render(int8_t const* _sixels, size_t _count)
+{
+    // TODO: respect aspect ratio!
+    auto const x = sixelCursor_.column;
+    auto const count = min(static_cast<int>(min(_count, static_cast<size_t>(size_.width))), size_.width - x);
+    if (count <= 0)
+        return;
+
+    auto const rows = min(6, size_.height - sixelCursor_.row);
+    if (rows <= 0)
+    {
+        sixelCursor_.column += count;
+        return;
+    }
+
+    allocate();
+
+    auto const stride = static_cast<size_t>(size_.width) * 4;
+    auto const column = &buffer_[(static_cast<size_t>(sixelCursor_.row) * static_cast<size_t>(size_.width) + static_cast<size_t>(x)) * 4];
+    paintRun(column, stride, rows, currentColor(), _sixels, count);
+
+    sixelCursor_.column += count;
+}
+
+// =================================================================================
+
+namespace
+{
+    /// Follows the color commands of a Sixel image, forwarding them to the image builder.
+    ///
+    /// The color registers of the image builder may be shared with other images, such that
+    /// a copy is kept to tell the color registers at the start of each band.
+    class SixelColorTracker final : public SixelParser::Events
+    {
+      public:
+        explicit SixelColorTracker(SixelImageBuilder& _builder) :
+            builder_{ _builder },
+            palette_{ _builder.colorPalette() },
+            color_{ _builder.currentColorIndex() }
+        {
+        }
+
+        ColorPalette const& palette() const noexcept { return palette_; }
+        int color() const noexcept { return color_; }
+
+        /// @returns whether any color register was defined since the last call.
+        bool takeChanged() noexcept { return std::exchange(changed_, false); }
+
+        void setColor(int _index, RGBColor const& _color) override
+        {
+            palette_.setColor(_index, _color);
+            builder_.setColor(_index, _color);
+            changed_ = true;
+        }
+
+        void useColor(int _index) override
+        {
+            color_ = _index % palette_.size();
+            builder_.useColor(_index);
+        }
+
+        void rewind() override {}
+        void newline() override {}
+        void setRaster(int, int, Size const&) override {}
+        void render(int8_t, int) override {}
+        void render(int8_t const*, size_t) override {}
+
+      private:
+        SixelImageBuilder& builder_;
+        ColorPalette palette_;
+        int color_;
+        bool changed_ = false;
+    };
+
+    /// Paints a single band of a Sixel image into the (allocated) buffer of the image builder,
+    /// just like SixelImageBuilder, but without touching any state shared with other bands.
+    class SixelBandPainter final : public SixelParser::Events
+    {
+      public:
+        SixelBandPainter(uint8_t* _buffer, Size _size, int _row, ColorPalette const& _palette, int _color) :
+            buffer_{ _buffer },
+            size_{ _size },
+            row_{ _row },
+            palette_{ &_palette },
+            color_{ _color }
+        {
+        }
+
+        void setColor(int _index, RGBColor const& _color) override
+        {
+            if (!ownPalette_)
+            {
+                ownPalette_ = *palette_;
+                palette_ = &*ownPalette_;
+            }
+            ownPalette_->setColor(_index, _color);
+        }
+
+        void useColor(int _index) override { color_ = _index % palette_->size(); }
+        void rewind() override { column_ = 0; }
+        void newline() override { column_ = 0; }
+        void setRaster(int, int, Size const&) override {} // bands with raster attributes are not decoded in parallel
+
+        void render(int8_t _sixel, int _count) override
+        {
+            auto const count = min(_count, size_.width - column_);
+            if (count <= 0)
+                return;
+
+            auto const rows = min(6, size_.height - row_);
+            if (rows > 0)
+                paintRepeated(pixel(), stride(), rows, palette_->at(color_), _sixel, count);
+
+            column_ += count;
+        }
+
+        void render(int8_t const* _sixels, size_t _count) override
+        {
+            auto const count = min(static_cast<int>(min(_count, static_cast<size_t>(size_.width))), size_.width - column_);
+            if (count <= 0)
+                return;
+
+            auto const rows = min(6, size_.height - row_);
+            if (rows > 0)
+                paintRun(pixel(), stride(), rows, palette_->at(color_), _sixels, count);
+
+            column_ += count;
+        }
+
+      private:
+        size_t stride() const noexcept { return static_cast<size_t>(size_.width) * 4; }
+
+        uint8_t* pixel() const noexcept
         {
-            auto const y = sixelCursor_.row + i;
-            auto const pos = Coordinate{y, x};
-            auto const pin = 1 << i;
-            auto const pinned = (_sixel & pin) != 0;
-            if (pinned)
-                write(pos, currentColor());
+            return buffer_ + (static_cast<size_t>(row_) * static_cast<size_t>(size_.width) + static_cast<size_t>(column_)) * 4;
         }
-        sixelCursor_.column++;
+
+        uint8_t* buffer_;
+        Size size_;
+        int row_;
+        int column_ = 0;
+        ColorPalette const* palette_;
+        optional<ColorPalette> ownPalette_; // copy of the color registers once the band defines any
+        int color_;
+    };
+
+    /// The part of a Sixel image's payload painting one band, and the color registers it starts with.
+    struct SixelBand
+    {
+        string_view data;
+        shared_ptr<ColorPalette const> palette;
+        int color;
+    };
+}
+
+SixelBandParser::SixelBandParser(SixelImageBuilder& _builder,
+                                 shared_ptr<crispy::parallel_for_pool> _pool,
+                                 OnFinalize _finalizer) :
+    builder_{ _builder },
+    pool_{ std::move(_pool) },
+    finalizer_{ _finalizer }
+{
+}
+
+void SixelBandParser::start()
+{
+    payload_.clear();
+}
+
+void SixelBandParser::pass(char32_t _char)
+{
+    // Characters beyond US-ASCII are ignored by the Sixel parser, just like NUL.
+    payload_.push_back(_char < 0x80 ? static_cast<char>(_char) : '\0');
+}
+
+void SixelBandParser::pass(std::string_view _chars)
+{
+    payload_.append(_chars);
+}
+
+void SixelBandParser::finalize()
+{
+    decode();
+
+    if (finalizer_)
+        finalizer_();
+}
+
+void SixelBandParser::decode()
+{
+    auto const payload = string_view(payload_);
+    auto const firstBandEnd = min(payload.find('-'), payload.size());
+
+    // The first band is decoded by the image builder itself, as the raster attributes are
+    // expected to preceed the pixel data, and so is everything if any later band has them.
+    auto serialParser = SixelParser{builder_};
+    serialParser.pass(payload.substr(0, firstBandEnd + 1));
+    if (firstBandEnd == payload.size() || payload.find('"', firstBandEnd) != string_view::npos)
+    {
+        serialParser.pass(payload.substr(min(firstBandEnd + 1, payload.size())));
+        serialParser.done();
+        return;
+    }
+    serialParser.done();
+
+    // Pre-scan the remaining bands for the color registers each one starts with.
+    auto bands = vector<SixelBand>{};
+    auto tracker = SixelColorTracker{builder_};
+    auto scanner = SixelParser{tracker};
+    auto palette = make_shared<ColorPalette const>(tracker.palette());
+    for (auto begin = firstBandEnd + 1; begin <= payload.size();)
+    {
+        auto const end = min(payload.find('-', begin), payload.size());
+        auto const band = payload.substr(begin, end - begin);
+
+        if (tracker.takeChanged())
+            palette = make_shared<ColorPalette const>(tracker.palette());
+        bands.push_back(SixelBand{band, palette, tracker.color()});
+
+        // Color commands consist of digits and semicolons only, up to the next character.
+        for (auto i = band.find('#'); i != string_view::npos; i = band.find('#', i + 1))
+        {
+            auto const commandEnd = min(band.find_first_not_of("0123456789;", i + 1), band.size());
+            scanner.pass(band.substr(i, commandEnd - i));
+            scanner.pass(U'$'); // leaves the command, just like any other character would
+        }
+
+        begin = end + 1;
     }
+    scanner.done();
+
+    // Bands are painted at every sixth pixel row, the ones beyond the last band of the image
+    // all painting over that last band, in order.
+    auto const size = builder_.size();
+    auto const lastRow = max(0, (size.height - 1) / 6 * 6);
+    auto const buffer = builder_.data().data();
+    auto const paint = [&](size_t _index) {
+        auto const& band = bands[_index];
+        auto painter = SixelBandPainter{buffer, size, min(static_cast<int>(_index + 1) * 6, lastRow), *band.palette, band.color};
+        auto parser = SixelParser{painter};
+        parser.pass(band.data);
+        parser.done();
+    };
+
+    auto const parallelBands = min(bands.size(), static_cast<size_t>(max(0, lastRow / 6 - 1)));
+    pool_->run(parallelBands, paint);
+    for (auto i = parallelBands; i < bands.size(); ++i)
+        paint(i);
 }
 
 }
@@ -17,10 +17,14 @@
 #include <terminal/Size.h>                  // Size, Coordinate
 #include <terminal/ParserExtension.h>
 
+#include <crispy/function_ref.h>
+#include <crispy/parallel_for.h>
 #include <crispy/range.h>
 
 #include <array>
+#include <functional>
 #include <memory>
+#include <string>
 #include <string_view>
 #include <vector>
 
@@ -31,6 +35,9 @@ namespace terminal {
 /// Parses a sixel stream without any Sixel introducer CSI or ST to leave sixel mode,
 /// that must be done by the parent parser.
 ///
+/// Consecutive sixel bytes are collected and passed to the event handler in runs, and so are
+/// repeated sixels, such that the per-pixel work is left to a tight loop in the event handler.
+///
 /// TODO: make this parser O(1) with state table lookup tables, just like the VT parser.
 class SixelParser : public ParserExtension
 {
@@ -67,11 +74,15 @@ class SixelParser : public ParserExtension
         /// the upcoming pixel data.
         virtual void setRaster(int _pan, int _pad, Size const& _imageSize) = 0;
 
-        /// renders a given sixel at the current sixel-cursor position.
-        virtual void render(int8_t _sixel) = 0;
+        /// renders a given sixel @p _count times, starting at the current sixel-cursor position.
+        virtual void render(int8_t _sixel, int _count) = 0;
+
+        /// renders the given run of sixels, starting at the current sixel-cursor position.
+        virtual void render(int8_t const* _sixels, size_t _count) = 0;
     };
 
-    using OnFinalize = std::function<void()>;
+    /// Invoked once the image is complete. The callable must outlive the parser.
+    using OnFinalize = crispy::function_ref<void()>;
     explicit SixelParser(Events& _events, OnFinalize _finisher = {});
 
     using iterator = char32_t const*;
@@ -80,6 +91,7 @@ class SixelParser : public ParserExtension
     {
         for (auto const ch : crispy::range(_begin, _end))
             parse(ch);
+        flushSixels();
     }
 
     void parseFragment(std::u32string_view _range)
@@ -91,6 +103,7 @@ class SixelParser : public ParserExtension
     {
         for (char32_t ch : _range)
             parse(static_cast<char>(ch)); // XXX only used in unit tests
+        flushSixels();
     }
 
     void parse(char32_t _value);
@@ -106,18 +119,29 @@ class SixelParser : public ParserExtension
     // ParserExtension overrides
     void start() override;
     void pass(char32_t _char) override;
+    void pass(std::string_view _chars) override;
     void finalize() override;
 
+    /// Maximum number of parameters kept, which is more than any sixel command takes, such that
+    /// excess parameters still make the command be ignored.
+    static constexpr size_t MaxParameters = 8;
+
+    /// Maximum value of a parameter, larger values are saturated to it.
+    static constexpr int MaxParameterValue = 65535;
+
   private:
     void paramShiftAndAddDigit(int _value);
+    void appendParameter();
     void transitionTo(State _newState);
     void enterState();
     void leaveState();
     void fallback(char32_t _value);
+    void flushSixels();
 
   private:
     State state_ = State::Ground;
     std::vector<int> params_;
+    std::vector<int8_t> sixels_; // sixels not yet passed to the event handler
 
     Events& events_;
     OnFinalize finalizer_;
@@ -149,11 +173,18 @@ class ColorPalette
 /// Sixel Image Builder API
 ///
 /// Implements the SixelParser::Events event listener to construct a Sixel image.
-class SixelImageBuilder : public SixelParser::Events
+///
+/// The RGBA buffer is allocated once the first pixel is painted, in the size announced by the
+/// raster attributes if any, or the maximum image size otherwise.
+class SixelImageBuilder final : public SixelParser::Events
 {
   public:
     using Buffer = std::vector<uint8_t>;
 
+    /// Invoked with the number of pixel rows painted so far whenever a sixel band is complete.
+    /// The callable must outlive the builder.
+    using OnBand = crispy::function_ref<void(int _rows)>;
+
     SixelImageBuilder(Size const& _maxSize,
                       int _aspectVertical,
                       int _aspectHorizontal,
@@ -172,11 +203,15 @@ class SixelImageBuilder : public SixelParser::Events
     int aspectRatioNominator() const noexcept { return aspectRatio_.nominator; }
     int aspectRatioDenominator() const noexcept { return aspectRatio_.denominator; }
     RGBColor currentColor() const noexcept { return colors_->at(currentColor_); }
+    int currentColorIndex() const noexcept { return currentColor_; }
+    ColorPalette const& colorPalette() const noexcept { return *colors_; }
 
     RGBAColor at(Coordinate _coord) const noexcept;
 
     Buffer const& data() const noexcept { return buffer_; }
-    Buffer& data() noexcept { return buffer_; }
+    Buffer& data() { allocate(); return buffer_; }
+
+    void setBandListener(OnBand _listener) { onBand_ = _listener; }
 
     void clear(RGBAColor _fillColor);
 
@@ -185,18 +220,22 @@ class SixelImageBuilder : public SixelParser::Events
     void rewind() override;
     void newline() override;
     void setRaster(int _pan, int _pad, Size const& _imageSize) override;
-    void render(int8_t _sixel) override;
+    void render(int8_t _sixel, int _count) override;
+    void render(int8_t const* _sixels, size_t _count) override;
 
     Coordinate const& sixelCursor() const noexcept { return sixelCursor_; }
 
   private:
-    void write(Coordinate const& _coord, RGBColor const& _value) noexcept;
+    void allocate();
 
   private:
     Size const maxSize_;
     std::shared_ptr<ColorPalette> colors_;
+    RGBAColor backgroundColor_;
     Size size_;
-    Buffer buffer_; /// RGBA buffer
+    Buffer buffer_; /// RGBA buffer, empty until the first pixel is painted
+    bool resizedWithData_ = false;  // whether raster attributes resized the buffer after painting
+    OnBand onBand_;
     Coordinate sixelCursor_;
     int currentColor_;
     struct {
@@ -205,4 +244,37 @@ class SixelImageBuilder : public SixelParser::Events
     } aspectRatio_;
 };
 
+/// Sixel Stream Parser decoding the bands of an image in parallel.
+///
+/// Each band of six pixel rows is ended by a graphics newline, which also ends any command,
+/// and paints only its own rows. So once the color registers a band starts out with are known,
+/// it can be decoded independently of the others. The payload is therefore collected until the
+/// image is complete, pre-scanned for the band boundaries and color commands, and the bands are
+/// then decoded on the given thread pool straight into the image builder's buffer.
+///
+/// Unlike SixelParser, the image is not shown progressively while being received.
+class SixelBandParser : public ParserExtension
+{
+  public:
+    using OnFinalize = SixelParser::OnFinalize;
+
+    SixelBandParser(SixelImageBuilder& _builder,
+                    std::shared_ptr<crispy::parallel_for_pool> _pool,
+                    OnFinalize _finalizer = {});
+
+    // ParserExtension overrides
+    void start() override;
+    void pass(char32_t _char) override;
+    void pass(std::string_view _chars) override;
+    void finalize() override;
+
+  private:
+    void decode();
+
+    SixelImageBuilder& builder_;
+    std::shared_ptr<crispy::parallel_for_pool> pool_;
+    OnFinalize finalizer_;
+    std::string payload_;
+};
+
 } // end namespace
@@ -14,6 +14,8 @@
 #include <terminal/SixelParser.h>
 #include <crispy/times.h>
 #include <catch2/catch.hpp>
+#include <memory>
+#include <string>
 #include <string_view>
 #include <array>
 
@@ -322,3 +324,95 @@ TEST_CASE("SixelParser.newline", "[sixel]")
     }
 }
 
+
+TEST_CASE("SixelParser.raster_presized", "[sixel]")
+{
+    auto constexpr defaultColor = RGBAColor{0, 0, 0, 0xFF};
+    auto ib = SixelImageBuilder{Size{640, 480}, defaultColor};
+    auto sp = SixelParser{ib};
+
+    sp.parseFragment("\"1;1;3;7");
+    sp.parseFragment("!5~");
+    sp.done();
+
+    CHECK(ib.sixelCursor() == Coordinate{0, 3});
+    CHECK(ib.data().size() == 3 * 7 * 4);
+}
+
+TEST_CASE("SixelParser.bands", "[sixel]")
+{
+    auto constexpr defaultColor = RGBAColor{0, 0, 0, 0xFF};
+    auto ib = SixelImageBuilder{Size{4, 16}, defaultColor};
+    auto sp = SixelParser{ib};
+
+    auto bands = std::vector<int>{};
+    auto const onBand = [&](int _rows) { bands.push_back(_rows); };
+    ib.setBandListener(onBand);
+
+    sp.parseFragment("~~-~~-~~");
+    CHECK(bands == std::vector<int>{6, 12});
+
+    sp.parseFragment("-");
+    sp.done();
+    CHECK(bands == std::vector<int>{6, 12, 16});
+}
+
+TEST_CASE("SixelParser.boundedParameters", "[sixel]")
+{
+    auto constexpr defaultColor = RGBAColor{0, 0, 0, 0xFF};
+    auto ib = SixelImageBuilder{Size{640, 480}, defaultColor};
+    auto sp = SixelParser{ib};
+
+    // Overlong numbers saturate rather than overflow.
+    sp.parseFragment("\"1;1;99999999999999999999;7");
+    sp.done();
+    CHECK(ib.size().width == 640);
+    CHECK(ib.size().height == 7);
+
+    // Excess parameters are dropped rather than accumulated, and make the command be ignored.
+    sp.parseFragment("#1;2;100;0;0");
+    sp.parseFragment("#1;2;0;100;0");
+    for (int i = 0; i < 10000; ++i)
+        sp.parseFragment(";0");
+    sp.parseFragment("#1~");
+    sp.done();
+    CHECK(ib.at(Coordinate{0, 0}) == RGBAColor{255, 0, 0, 255});
+}
+
+TEST_CASE("SixelBandParser.sameAsSerial", "[sixel]")
+{
+    // Colors (re)defined and used throughout, with more bands than the image is high.
+    auto payload = std::string{"\"1;1;37;40#1;2;100;0;0#2;2;0;100;0"};
+    for (int band = 0; band < 9; ++band)
+    {
+        payload += fmt::format("#1!{}~$#2{}?@AB{}", band * 3 + 1, band % 2 ? "" : "#3;2;0;0;100#3", band);
+        if (band == 4)
+            payload += "#2;2;50;50;50#2~~";
+        payload += "-";
+    }
+    payload += "#1~~~";
+
+    auto constexpr defaultColor = RGBAColor{0, 0, 0, 0xFF};
+    auto serialBuilder = SixelImageBuilder{Size{640, 480}, defaultColor};
+    auto serialParser = SixelParser{serialBuilder};
+    serialParser.pass(payload);
+    serialParser.finalize();
+
+    auto pool = std::make_shared<crispy::parallel_for_pool>(4);
+    auto finalized = false;
+    auto const onFinalize = [&]() { finalized = true; };
+    auto bandBuilder = SixelImageBuilder{Size{640, 480}, defaultColor};
+    auto bandParser = SixelBandParser{bandBuilder, pool, onFinalize};
+    bandParser.start();
+    bandParser.pass(payload.substr(0, 100));
+    for (char const ch : payload.substr(100))
+        bandParser.pass(static_cast<char32_t>(ch));
+    bandParser.finalize();
+
+    CHECK(finalized);
+    CHECK(bandBuilder.size() == serialBuilder.size());
+    CHECK(bandBuilder.data() == serialBuilder.data());
+    CHECK(bandBuilder.currentColor() == serialBuilder.currentColor());
+    for (int i = 0; i < serialBuilder.colorPalette().size(); ++i)
+        CHECK(bandBuilder.colorPalette().at(i) == serialBuilder.colorPalette().at(i));
+}
@@ -12,14 +12,19 @@
  * limitations under the License.
  */
 #include <terminal/InputGenerator.h>
+#include <terminal/IOReactor.h>
 #include <terminal/Terminal.h>
 
 #include <terminal/ControlCode.h>
 
+#include <crispy/allocation_tracker.h>
 #include <crispy/escape.h>
 #include <crispy/stdfs.h>
+#include <crispy/trace.h>
 
 #include <chrono>
+#include <cstdio>
+#include <memory>
 #include <utility>
 
 #include <iostream>
@@ -66,41 +71,243 @@ Terminal::Terminal(std::unique_ptr<Pty> _pty,
         _maxImageColorRegisters,
         _sixelCursorConformance
     },
-    screenUpdateThread_{ [this]() { screenUpdateThread(); } },
-    viewport_{ screen_ }
+    inputWriterThread_{ [this]() { inputWriterThread(); } },
+    viewport_{ screen_ },
+    imageDecoder_{ [this](auto&& _image, auto&& _data) { onImageDecoded(move(_image), move(_data)); } }
 {
+    // PTYs that can be waited on are all serviced by the process-wide reactor, such that the
+    // number of threads does not grow with the number of terminals.
+    if (auto const handle = pty_->readableHandle(); handle != NoNativeHandle && IOReactor::supported())
+    {
+        reactor_ = &IOReactor::get();
+        reactor_->add(handle, *this);
+    }
+    else
+    {
+        ptyReaderThread_ = thread{ [this]() { ptyReaderThread(); } };
+        screenUpdateThread_ = thread{ [this]() { screenUpdateThread(); } };
+    }
 }
 
 Terminal::~Terminal()
 {
-    screenUpdateThread_.join();
+    {
+        auto const _l = scoped_lock{pendingInputLock_};
+        quitInputWriter_ = true;
+    }
+    pendingInputChanged_.notify_all();
+    inputWriterThread_.join();
+
+    if (reactor_)
+        reactor_->remove(*this);
+    else
+    {
+        ptyReaderThread_.join();
+        screenUpdateThread_.join();
+    }
 }
 
-void Terminal::screenUpdateThread()
+void Terminal::notifyOutputRingChanged()
 {
-    constexpr size_t BufSize = 32 * 1024;
-    vector<char> buf;
-    buf.resize(BufSize);
+    {
+        // Taking the lock ensures that a waiting thread has either not yet checked
+        // its predicate, or is already waiting, so that the notification isn't lost.
+        lock_guard<mutex> _l{ outputRingLock_ };
+    }
+    outputRingChanged_.notify_all();
+}
 
+void Terminal::ptyReaderThread()
+{
     for (;;)
     {
-        if (auto const n = pty_->read(buf.data(), buf.size()); n != -1)
+        auto target = outputRing_.writable();
+        if (target.empty())
         {
-            //log("outputThread.data: {}", crispy::escape(buf, buf + n));
-            lock_guard<decltype(screenLock_)> _l{ screenLock_ };
-            screen_.write(buf.data(), n);
+            unique_lock<mutex> l{ outputRingLock_ };
+            outputRingChanged_.wait(l, [this]() { return !outputRing_.full(); });
+            continue;
         }
-        else
-        {
-            eventListener_.onClosed();
+
+        auto const n = pty_->read(target.begin(), min(target.size(), readBufferSize_.load()));
+        if (n == -1)
             break;
+
+        outputRing_.commit(static_cast<size_t>(n));
+        notifyOutputRingChanged();
+    }
+
+    ptyClosed_ = true;
+    notifyOutputRingChanged();
+}
+
+void Terminal::screenUpdateThread()
+{
+    for (;;)
+    {
+        auto const chunk = outputRing_.readable();
+        if (chunk.empty())
+        {
+            if (ptyClosed_ && outputRing_.empty())
+            {
+                eventListener_.onClosed();
+                break;
+            }
+
+            // Waits for output, or for the alternate buffer to be released once idle for long enough.
+            auto const ready = [this]() { return !outputRing_.empty() || ptyClosed_; };
+            auto const delay = chrono::milliseconds(alternateBufferReleaseDelay_.load());
+            auto const unusedSince = alternateBufferUnusedSince_.load();
+            unique_lock<mutex> l{ outputRingLock_ };
+            if (delay.count() == 0 || unusedSince == 0)
+                outputRingChanged_.wait(l, ready);
+            else if (!outputRingChanged_.wait_until(l, steady_clock::time_point(steady_clock::duration(unusedSince)) + delay, ready))
+            {
+                l.unlock();
+                releaseAlternateBuffer(unusedSince);
+            }
+            continue;
+        }
+
+        CRISPY_TRACE_ZONE("Terminal::screenUpdateThread");
+        parseOutput();
+        notifyOutputRingChanged();
+    }
+}
+
+void Terminal::parseOutput()
+{
+    CRISPY_TRACE_ZONE("Terminal::parseOutput");
+    CRISPY_ALLOCATION_SCOPE(parser);
+
+    // Granularity at which the parse slice's time budget is checked.
+    auto constexpr ParseStepSize = size_t{16 * 1024};
+
+    auto const chunk = outputRing_.readable();
+
+    // Bound the time spent holding the screen lock, so that rendering is not starved.
+    auto const size = min(chunk.size(), readBufferSize_.load());
+    auto const budget = inputAwaitingFrame_ ? parseSliceTime_.load() / 4 : parseSliceTime_.load();
+    auto const start = steady_clock::now();
+    auto n = size_t{0};
+    {
+        //log("outputThread.data: {}", crispy::escape(chunk.begin(), chunk.begin() + size));
+        lock_guard<decltype(screenLock_)> _l{ screenLock_ };
+
+        fastForwarding_ = outputBacklogged();
+        suppressScreenUpdates_ = fastForwarding_;
+
+        do
+        {
+            auto const step = min(size - n, ParseStepSize);
+            screen_.write(chunk.begin() + n, step);
+            n += step;
         }
+        while (n < size && steady_clock::now() - start < budget);
+
+        if (recorder_)
+            recorder_->output(chunk.begin(), n, start);
+
+        // Only the final state of a fast-forwarded slice is notified.
+        suppressScreenUpdates_ = false;
+        if (exchange(screenUpdateSuppressed_, false))
+            eventListener_.screenUpdated();
+    }
+    outputRing_.consume(n);
+    parsedBytes_.fetch_add(n, memory_order_relaxed);
+    fastForwarding_ = outputBacklogged();
+
+    // Let a renderer waiting for the screen lock take it before the next slice.
+    if (!outputRing_.empty())
+        this_thread::yield();
+}
+
+chrono::milliseconds Terminal::synchronizedOutputRemaining(steady_clock::time_point _now) const noexcept
+{
+    auto const start = synchronizedOutputStart_.load();
+    if (start == 0)
+        return chrono::milliseconds::zero();
+
+    auto const end = steady_clock::time_point(steady_clock::duration(start)) + SynchronizedOutputTimeout;
+    return end > _now ? chrono::ceil<chrono::milliseconds>(end - _now) : chrono::milliseconds::zero();
+}
+
+void Terminal::releaseAlternateBuffer(steady_clock::rep _unusedSince)
+{
+    lock_guard<decltype(screenLock_)> _l{ screenLock_ };
+    if (alternateBufferUnusedSince_.compare_exchange_strong(_unusedSince, 0))
+        screen_.releaseAlternateBuffer();
+}
+
+void Terminal::scheduleAlternateBufferRelease()
+{
+    auto const delay = chrono::milliseconds(alternateBufferReleaseDelay_.load());
+    auto const unusedSince = alternateBufferUnusedSince_.load();
+    if (delay.count() == 0 || unusedSince == 0)
+        return;
+
+    auto const releaseTime = steady_clock::time_point(steady_clock::duration(unusedSince)) + delay;
+    if (steady_clock::now() >= releaseTime)
+        releaseAlternateBuffer(unusedSince);
+    else if (exchange(releaseScheduledAt_, releaseTime) != releaseTime)
+        reactor_->scheduleAt(*this, releaseTime);
+}
+
+bool Terminal::outputBacklogged() const noexcept
+{
+    auto const threshold = fastForwardThreshold_.load();
+    return threshold != 0 && outputRing_.size() > threshold;
+}
+
+bool Terminal::onReadable()
+{
+    auto target = outputRing_.writable();
+    if (target.empty())
+    {
+        // Reading pauses until parsing made room again. Unless it did so meanwhile,
+        // in which case reading goes on, or it already requested to resume.
+        readPaused_ = true;
+        target = outputRing_.writable();
+        if (target.empty() || !readPaused_.exchange(false))
+            return false;
+    }
+
+    auto const n = pty_->readAvailable(target.begin(), min(target.size(), readBufferSize_.load()));
+    if (n < 0)
+    {
+        ptyClosed_ = true;
+        return false;
+    }
+
+    outputRing_.commit(static_cast<size_t>(n));
+    return true;
+}
+
+bool Terminal::process()
+{
+    if (!outputRing_.empty())
+    {
+        parseOutput();
+
+        if (readPaused_.exchange(false))
+            reactor_->resume(*this);
+
+        if (!outputRing_.empty())
+            return true;
     }
+
+    scheduleAlternateBufferRelease();
+
+    // Also reached by the slice parsing the last output, if the PTY was closed before that.
+    if (ptyClosed_ && !exchange(closeNotified_, true))
+        eventListener_.onClosed();
+    return false;
 }
 
 bool Terminal::send(KeyInputEvent const& _keyEvent, chrono::steady_clock::time_point _now)
 {
-    logger_(TraceInputEvent{ fmt::format("key: {}", to_string(_keyEvent.key), to_string(_keyEvent.modifier)) });
+    if (logger_.enabled<TraceInputEvent>())
+        logger_(TraceInputEvent{ fmt::format("key: {}", to_string(_keyEvent.key), to_string(_keyEvent.modifier)) });
 
     cursorBlinkState_ = 1;
     lastCursorBlink_ = _now;
@@ -109,6 +316,7 @@ bool Terminal::send(KeyInputEvent const& _keyEvent, chrono::steady_clock::time_p
     if (screen_.isModeEnabled(Mode::KeyboardAction))
         return true;
 
+    stampInputTime(_now);
     bool const success = inputGenerator_.generate(_keyEvent);
     flushInput();
     return success;
@@ -119,20 +327,30 @@ bool Terminal::send(CharInputEvent const& _charEvent, chrono::steady_clock::time
     cursorBlinkState_ = 1;
     lastCursorBlink_ = _now;
 
-    if (_charEvent.value <= 0x7F && isprint(static_cast<int>(_charEvent.value)))
-        logger_(TraceInputEvent{ fmt::format("char: {} ({})", static_cast<char>(_charEvent.value), to_string(_charEvent.modifier)) });
-    else
-        logger_(TraceInputEvent{ fmt::format("char: 0x{:04X} ({})", static_cast<uint32_t>(_charEvent.value), to_string(_charEvent.modifier)) });
+    if (logger_.enabled<TraceInputEvent>())
+    {
+        if (_charEvent.value <= 0x7F && isprint(static_cast<int>(_charEvent.value)))
+            logger_(TraceInputEvent{ fmt::format("char: {} ({})", static_cast<char>(_charEvent.value), to_string(_charEvent.modifier)) });
+        else
+            logger_(TraceInputEvent{ fmt::format("char: 0x{:04X} ({})", static_cast<uint32_t>(_charEvent.value), to_string(_charEvent.modifier)) });
+    }
 
     // Early exit if KAM is enabled.
     if (screen_.isModeEnabled(Mode::KeyboardAction))
         return true;
 
+    stampInputTime(_now);
     bool const success = inputGenerator_.generate(_charEvent);
     flushInput();
     return success;
 }
 
+void Terminal::stampInputTime(chrono::steady_clock::time_point _now) noexcept
+{
+    auto expected = chrono::steady_clock::rep{0};
+    sentInputTime_.compare_exchange_strong(expected, _now.time_since_epoch().count());
+}
+
 bool Terminal::send(MousePressEvent const& _mousePress, chrono::steady_clock::time_point _now)
 {
     // TODO: anything else? logging?
@@ -193,6 +411,67 @@ bool Terminal::send(MousePressEvent const& _mousePress, chrono::steady_clock::ti
     return false;
 }
 
+string Terminal::extractText(Selector const& _selection) const
+{
+    auto const firstRow = min(_selection.from().row, _selection.to().row);
+    auto const lastRow = max(_selection.from().row, _selection.to().row);
+
+    // Reserves for one byte per selected cell, which is exact for the more common US-ASCII text.
+    auto size = size_t{0};
+    for (int row = firstRow; row <= lastRow; ++row)
+        if (auto const range = _selection.rangeAt(row); range.has_value())
+            size += static_cast<size_t>(range->length()) + 1;
+
+    auto text = string{};
+    text.reserve(size);
+    for (int row = firstRow; row <= lastRow; ++row)
+    {
+        // Rows of the same logical line are joined, so that soft-wrapped text is copied as written.
+        if (row != firstRow && !screen_.continuesLine(row))
+            text += '\n';
+        if (auto const range = _selection.rangeAt(row); range.has_value())
+            screen_.appendRowText(row, range->fromColumn, range->toColumn, text);
+    }
+    return text;
+}
+
+bool Terminal::exportLines(string const& _path, ExportFormat _format) const
+{
+    // Lines are written in chunks of about this size, and taken a history page at a time.
+    auto constexpr ChunkSize = size_t{1024 * 1024};
+    auto constexpr LineCount = SavedLines::DefaultPageSize;
+
+    auto file = unique_ptr<FILE, int(*)(FILE*)>{fopen(_path.c_str(), "wb"), &fclose};
+    if (!file)
+        return false;
+
+    auto [serial, end] = [&]() {
+        auto const _l = scoped_lock{*this};
+        return pair{screen_.firstLineSerial(), screen_.lineSerialEnd()};
+    }();
+
+    auto chunk = string{};
+    chunk.reserve(ChunkSize + LineCount * 256);
+    while (serial < end)
+    {
+        auto const count = min(end - serial, LineCount);
+        {
+            auto const _l = scoped_lock{*this};
+            screen_.exportLines(serial, count, _format, chunk);
+        }
+        serial += count;
+
+        if (chunk.size() >= ChunkSize || serial == end)
+        {
+            if (fwrite(chunk.data(), 1, chunk.size(), file.get()) != chunk.size())
+                return false;
+            chunk.clear();
+        }
+    }
+
+    return fclose(file.release()) == 0;
+}
+
 void Terminal::clearSelection()
 {
     selector_.reset();
@@ -318,20 +597,146 @@ bool Terminal::send(InputEvent const& _inputEvent, chrono::steady_clock::time_po
     }, _inputEvent);
 }
 
-void Terminal::sendPaste(string_view const& _text)
+void Terminal::sendPaste(string _text)
 {
-    inputGenerator_.generatePaste(_text);
-    flushInput();
+    if (_text.size() <= PasteChunkSize)
+    {
+        inputGenerator_.generatePaste(_text);
+        flushInput();
+        return;
+    }
+
+    // The enclosing sequences are queued separately, as these are still to be sent when cancelled.
+    inputGenerator_.generatePasteBegin();
+    inputGenerator_.swap(pendingInput_);
+    auto begin = PendingInput{string(pendingInput_.begin(), pendingInput_.end()), false};
+    pendingInput_.clear();
+
+    inputGenerator_.generatePasteEnd();
+    inputGenerator_.swap(pendingInput_);
+    auto end = PendingInput{string(pendingInput_.begin(), pendingInput_.end()), false};
+    pendingInput_.clear();
+
+    auto const size = begin.data.size() + _text.size() + end.data.size();
+    {
+        auto const _l = scoped_lock{pendingInputLock_};
+        pendingInputs_.emplace_back(move(begin));
+        pendingInputs_.emplace_back(PendingInput{move(_text), true});
+        pendingInputs_.emplace_back(move(end));
+        addPendingInputBytes(size);
+    }
+    pendingInputChanged_.notify_one();
+}
+
+void Terminal::cancelPaste()
+{
+    auto const _l = scoped_lock{pendingInputLock_};
+    for (PendingInput& input : pendingInputs_)
+        if (input.paste)
+            input.cancelled = true;
+}
+
+void Terminal::flushMouseMotion()
+{
+    if (inputGenerator_.flushMouseMotion())
+        flushInput();
 }
 
 void Terminal::flushInput()
 {
     inputGenerator_.swap(pendingInput_);
-    pty_->write(pendingInput_.data(), pendingInput_.size());
-    logger_(RawInputEvent{crispy::escape(begin(pendingInput_), end(pendingInput_))});
+    if (pendingInput_.empty())
+        return;
+
+    writeInput(string_view(pendingInput_.data(), pendingInput_.size()));
+    inputAwaitingFrame_ = true;
+    if (logger_.enabled<RawInputEvent>())
+        logger_(RawInputEvent{string(pendingInput_.begin(), pendingInput_.end())});
     pendingInput_.clear();
 }
 
+void Terminal::writeInput(string_view _data)
+{
+    if (_data.empty())
+        return;
+
+    {
+        auto const _l = scoped_lock{pendingInputLock_};
+        pendingInputs_.emplace_back(PendingInput{string(_data), false});
+        addPendingInputBytes(_data.size());
+    }
+    pendingInputChanged_.notify_one();
+}
+
+void Terminal::addPendingInputBytes(size_t _size) noexcept
+{
+    // Only modified with pendingInputLock_ held, hence a plain load-modify-store suffices.
+    auto const pending = pendingInputBytes_.load(memory_order_relaxed) + _size;
+    pendingInputBytes_.store(pending, memory_order_relaxed);
+    if (pending > peakPendingInputBytes_.load(memory_order_relaxed))
+        peakPendingInputBytes_.store(pending, memory_order_relaxed);
+}
+
+void Terminal::removePendingInputBytes(size_t _size) noexcept
+{
+    pendingInputBytes_.store(pendingInputBytes_.load(memory_order_relaxed) - _size, memory_order_relaxed);
+}
+
+void Terminal::inputWriterThread()
+{
+    // Waiting for the application to consume its input is interrupted this often, for noticing
+    // cancellation and destruction.
+    auto constexpr WriteTimeout = chrono::milliseconds(100);
+
+    for (;;)
+    {
+        PendingInput* input = nullptr;
+        {
+            auto lock = unique_lock{pendingInputLock_};
+            pendingInputChanged_.wait(lock, [this]() { return quitInputWriter_ || !pendingInputs_.empty(); });
+            if (quitInputWriter_)
+                return;
+
+            // Only this thread removes inputs, hence the front one stays valid while being written.
+            input = &pendingInputs_.front();
+            if (input->cancelled)
+            {
+                auto const written = input->written;
+                auto const total = input->data.size();
+                removePendingInputBytes(total - written);
+                pendingInputs_.pop_front();
+                lock.unlock();
+                eventListener_.pasteProgress(written, total);
+                continue;
+            }
+        }
+
+        auto const size = min(PasteChunkSize, input->data.size() - input->written);
+        int const rv = pty_->writeSome(input->data.data() + input->written, size, WriteTimeout);
+        if (rv > 0 && input->paste && logger_.enabled<RawInputEvent>())
+            logger_(RawInputEvent{input->data.substr(input->written, static_cast<size_t>(rv))});
+
+        auto const written = input->written + static_cast<size_t>(max(rv, 0));
+        auto const total = input->data.size();
+        auto const paste = input->paste;
+        {
+            auto const _l = scoped_lock{pendingInputLock_};
+            removePendingInputBytes(written - input->written);
+            input->written = written;
+
+            // Input failing to be written is dropped, as the application most likely has gone.
+            if (rv < 0 || written == total)
+            {
+                removePendingInputBytes(total - written);
+                pendingInputs_.pop_front();
+            }
+        }
+
+        if (paste)
+            eventListener_.pasteProgress(written, total);
+    }
+}
+
 void Terminal::writeToScreen(char const* data, size_t size)
 {
     lock_guard<decltype(screenLock_)> _l{ screenLock_ };
@@ -358,10 +763,10 @@ void Terminal::updateCursorVisibilityState(std::chrono::steady_clock::time_point
 std::chrono::milliseconds Terminal::nextRender(chrono::steady_clock::time_point _now) const
 {
     auto const diff = chrono::duration_cast<chrono::milliseconds>(_now - lastCursorBlink_);
-    if (diff <= cursorBlinkInterval())
-        return {diff};
+    if (diff < cursorBlinkInterval())
+        return cursorBlinkInterval() - diff;
     else
-        return chrono::milliseconds::min();
+        return chrono::milliseconds::zero();
 }
 
 void Terminal::resizeScreen(Size _cells, optional<Size> _pixels)
@@ -371,9 +776,18 @@ void Terminal::resizeScreen(Size _cells, optional<Size> _pixels)
     if (_pixels)
         screen_.setCellPixelSize(*_pixels / _cells);
 
+    if (recorder_)
+        recorder_->resize(_cells, steady_clock::now());
+
     pty_->resizeScreen(_cells, _pixels);
 }
 
+void Terminal::setRecorder(unique_ptr<SessionRecorder> _recorder)
+{
+    lock_guard<decltype(screenLock_)> _l{ screenLock_ };
+    recorder_ = move(_recorder);
+}
+
 void Terminal::setCursorDisplay(CursorDisplay _display)
 {
     cursorDisplay_ = _display;
@@ -386,7 +800,7 @@ void Terminal::setCursorShape(CursorShape _shape)
 
 void Terminal::setWordDelimiters(string const& _wordDelimiters)
 {
-    wordDelimiters_ = unicode::from_utf8(_wordDelimiters);
+    wordDelimiters_ = crispy::codepoint_set{unicode::from_utf8(_wordDelimiters)};
 }
 
 // {{{ ScreenEvents overrides
@@ -402,6 +816,9 @@ void Terminal::bell()
 
 void Terminal::bufferChanged(ScreenType _type)
 {
+    alternateBufferUnusedSince_ = _type == ScreenType::Main ? steady_clock::now().time_since_epoch().count() : 0;
+    if (reactor_ && _type == ScreenType::Main)
+        reactor_->schedule(*this); // to wake up for releasing the alternate buffer
     selector_.reset();
     viewport_.forceScrollToBottom();
     eventListener_.bufferChanged(_type);
@@ -418,6 +835,16 @@ void Terminal::screenUpdated()
 {
     changes_++;
 
+    if (sentInputTime_.load(memory_order_relaxed) != 0)
+        if (auto const t = sentInputTime_.exchange(0); t != 0)
+            echoedInputTime_ = t;
+
+    if (suppressScreenUpdates_)
+    {
+        screenUpdateSuppressed_ = true;
+        return;
+    }
+
     // Screen output commands be here - anything this terminal is interested in?
     eventListener_.screenUpdated();
 }
@@ -439,7 +866,7 @@ void Terminal::notify(std::string_view const& _title, std::string_view const& _b
 
 void Terminal::reply(string_view const& reply)
 {
-    pty_->write(reply.data(), reply.size());
+    writeInput(reply);
 }
 
 void Terminal::resetDynamicColor(DynamicColorName _name)
@@ -498,6 +925,11 @@ void Terminal::setMouseWheelMode(InputGenerator::MouseWheelMode _mode)
     inputGenerator_.setMouseWheelMode(_mode);
 }
 
+void Terminal::setSynchronizedOutput(bool _enabled)
+{
+    synchronizedOutputStart_ = _enabled ? steady_clock::now().time_since_epoch().count() : 0;
+}
+
 void Terminal::setWindowTitle(std::string_view const& _title)
 {
     eventListener_.setWindowTitle(_title);
@@ -513,6 +945,31 @@ void Terminal::discardImage(Image const& _image)
 {
     eventListener_.discardImage(_image);
 }
+
+void Terminal::decodeImage(std::shared_ptr<Image const> _image, std::string&& _data)
+{
+    imageDecoder_.decode(move(_image), move(_data));
+}
+
+void Terminal::onImageDecoded(std::shared_ptr<Image const>&& _image, std::optional<Image::Data>&& _data)
+{
+    {
+        auto const _l = std::lock_guard{*this};
+        if (_data.has_value())
+        {
+            screen_.provideImage(*_image, move(*_data));
+
+            // The blank placeholder may have been uploaded already.
+            eventListener_.discardImage(*_image);
+        }
+
+        // Releasing the last reference removes the image from the pool, which is guarded by the lock.
+        _image.reset();
+    }
+
+    if (_data.has_value())
+        screenUpdated();
+}
 // }}}
 
 }  // namespace terminal
@@ -13,21 +13,31 @@
  */
 #pragma once
 
+#include <terminal/ImageDecoder.h>
 #include <terminal/Logger.h>
 #include <terminal/InputGenerator.h>
+#include <terminal/IOReactor.h>
 #include <terminal/pty/Pty.h>
 #include <terminal/ScreenEvents.h>
 #include <terminal/Screen.h>
+#include <terminal/SessionRecording.h>
 #include <terminal/Selector.h>
 #include <terminal/Viewport.h>
 
+#include <crispy/codepoint_set.h>
+#include <crispy/spsc_ring.h>
+
 #include <fmt/format.h>
 
+#include <algorithm>
 #include <atomic>
 #include <chrono>
+#include <condition_variable>
+#include <deque>
 #include <functional>
 #include <memory>
 #include <mutex>
+#include <optional>
 #include <string_view>
 #include <thread>
 #include <vector>
@@ -40,7 +50,7 @@ namespace terminal {
 /// gets updated according to the process' outputted text,
 /// whereas input to the process can be send high-level via the various
 /// send(...) member functions.
-class Terminal : public ScreenEvents {
+class Terminal : public ScreenEvents, private IOReactor::Session {
   public:
     class Events {
       public:
@@ -60,6 +70,10 @@ class Terminal : public ScreenEvents {
         virtual void setDynamicColor(DynamicColorName, RGBColor const&) {}
         virtual void setWindowTitle(std::string_view const& /*_title*/) {}
         virtual void discardImage(Image const&) {}
+
+        /// Reports @p _written of @p _total bytes of the current paste having been sent (or
+        /// cancelled, once no more follow), from the paste writer thread.
+        virtual void pasteProgress(size_t /*_written*/, size_t /*_total*/) {}
     };
 
     Terminal(std::unique_ptr<Pty> _pty,
@@ -83,6 +97,80 @@ class Terminal : public ScreenEvents {
     Size screenSize() const noexcept { return pty_->screenSize(); }
     void resizeScreen(Size _cells, std::optional<Size> _pixels);
 
+    /// Default size in bytes of the buffer used for reading the application's output.
+    static constexpr size_t DefaultReadBufferSize = 256 * 1024;
+
+    /// Sets the size in bytes of the buffer used for reading the application's output.
+    ///
+    /// Takes effect with the next read from the PTY device.
+    void setReadBufferSize(size_t _size) noexcept { readBufferSize_ = std::max(_size, size_t{4096}); }
+
+    /// Default maximum time the application's output is parsed at once.
+    static constexpr std::chrono::microseconds DefaultParseSliceTime{4000};
+
+    /// Sets the maximum time the application's output is parsed at once while holding the screen
+    /// lock, at most the read buffer size at a time, before rendering gets its turn.
+    ///
+    /// As long as user input has not been rendered yet, slices are cut down to a quarter of it,
+    /// such that the frame showing the input's echo is not held back by an output flood.
+    void setParseSliceTime(std::chrono::microseconds _time) noexcept { parseSliceTime_ = _time; }
+
+    /// Default number of bytes read but not yet parsed, beyond which parsing fast-forwards.
+    static constexpr size_t DefaultFastForwardThreshold = 1024 * 1024;
+
+    /// Sets the number of bytes read from the PTY but not yet parsed, beyond which the parser
+    /// fast-forwards, or 0 for never fast-forwarding.
+    ///
+    /// While fast-forwarding, screen updates are notified once per parse slice instead
+    /// of once per write, and should be rendered under pressure, as their intermediate
+    /// states pass by too fast to be read anyways. All output still makes it into the history.
+    void setFastForwardThreshold(size_t _bytes) noexcept { fastForwardThreshold_ = _bytes; }
+
+    /// Sets the time after leaving the alternate screen, beyond which the memory of its buffer is
+    /// released, or 0 for keeping it.
+    void setAlternateBufferReleaseDelay(std::chrono::milliseconds _delay)
+    {
+        alternateBufferReleaseDelay_ = _delay.count();
+        if (reactor_)
+            reactor_->schedule(*this);
+    }
+
+    /// Tests whether the parser is fast-forwarding through a flood of output.
+    bool fastForwarding() const noexcept { return fastForwarding_.load(); }
+
+    /// Time a synchronized update (mode ?2026) holds back rendering for at most, such that an
+    /// application never ending it does not freeze the display.
+    static constexpr std::chrono::milliseconds SynchronizedOutputTimeout{150};
+
+    /// @returns time the previous frame remains on display for at most, while the application
+    ///          is updating the screen in a synchronized update, or zero if it is not.
+    std::chrono::milliseconds synchronizedOutputRemaining(std::chrono::steady_clock::time_point _now) const noexcept;
+
+    /// @returns total number of bytes of the application's output parsed so far.
+    uint64_t parsedBytes() const noexcept { return parsedBytes_.load(std::memory_order_relaxed); }
+
+    /// Records all output parsed from now on, along with screen resizes, to @p _recorder,
+    /// or stops recording if nullptr.
+    void setRecorder(std::unique_ptr<SessionRecorder> _recorder);
+
+    /// @returns number of bytes read from the PTY but not parsed yet.
+    size_t pendingOutputBytes() const noexcept { return outputRing_.size(); }
+
+    /// Takes the time of the key press whose echo got rendered by the most recent frame, if any.
+    ///
+    /// Only one key press is in flight at a time: it is stamped in send(), its echo is the
+    /// next screen update, and that is picked up by the next preRender(). Key presses while
+    /// one is in flight are not measured. The caller measures up to when the frame is shown.
+    std::optional<std::chrono::steady_clock::time_point> takeRenderedInputTime() noexcept
+    {
+        if (auto const t = renderedInputTime_.exchange(0); t != 0)
+            return std::chrono::steady_clock::time_point(std::chrono::steady_clock::duration(t));
+        return std::nullopt;
+    }
+
+    /// Sets the codec used for decoding compressed inline images, which are left blank without one.
+    void setImageDecoder(ImageDecoder::Decode _decode) { imageDecoder_.setDecode(std::move(_decode)); }
+
     // {{{ input proxy
     // Sends given input event to connected slave.
     bool send(KeyInputEvent const& _inputEvent, std::chrono::steady_clock::time_point _now);
@@ -97,17 +185,41 @@ class Terminal : public ScreenEvents {
     bool send(InputEvent const& _inputEvent, std::chrono::steady_clock::time_point _now);
 
     /// Sends verbatim text in bracketed mode to application.
-    void sendPaste(std::string_view const& _text);
+    ///
+    /// Texts exceeding PasteChunkSize are sent in chunks, as fast as the application consumes
+    /// them, such that other input still gets through when cancelling the paste.
+    void sendPaste(std::string _text);
+
+    /// Stops sending the remainder of any pastes in progress.
+    void cancelPaste();
+
+    /// Sends @p _data to the application as it is, such as the input forwarded by session viewers.
+    void sendRaw(std::string_view _data) { writeInput(_data); }
+
+    /// Enables merging mouse motion reports sent in between two calls to flushMouseMotion()
+    /// into the most recent one. Button, key and other input is never merged.
+    void setMouseMotionCoalescing(bool _enable) { inputGenerator_.setMouseMotionCoalescing(_enable); }
+
+    /// Sends the most recent mouse motion report held back by mouse motion coalescing, if any.
+    ///
+    /// Meant to be called once per frame.
+    void flushMouseMotion();
+
+    /// Number of bytes of a paste that are sent at once.
+    static constexpr size_t PasteChunkSize = 16 * 1024;
+
+    /// @returns number of input bytes queued up that the application did not consume yet.
+    size_t pendingInputBytes() const noexcept { return pendingInputBytes_.load(std::memory_order_relaxed); }
+
+    /// @returns highest number of input bytes that have been queued up at once.
+    size_t peakPendingInputBytes() const noexcept { return peakPendingInputBytes_.load(std::memory_order_relaxed); }
     // }}}
 
     // {{{ screen proxy
-    /// @returns absolute coordinate of @p _pos with scroll offset and applied.
-    Coordinate absoluteCoordinate(Coordinate const& _pos) const noexcept
+    /// @returns absolute coordinate of @p _pos with scroll offset and folded rows applied.
+    Coordinate absoluteCoordinate(Coordinate const& _pos) const
     {
-        // TODO: unit test case me BEFORE merge, yo !
-        auto const row = viewport_.absoluteScrollOffset().value_or(screen_.historyLineCount()) + _pos.row;
-        auto const col = _pos.column;
-        return Coordinate{row, col};
+        return Coordinate{viewport_.absoluteRow(_pos.row), _pos.column};
     }
 
     /// Writes a given VT-sequence to screen.
@@ -140,6 +252,9 @@ class Terminal : public ScreenEvents {
     uint64_t preRender(std::chrono::steady_clock::time_point _now) const
     {
         auto const changes = changes_.exchange(0);
+        inputAwaitingFrame_ = false;
+        if (auto const t = echoedInputTime_.exchange(0); t != 0)
+            renderedInputTime_ = t;
         updateCursorVisibilityState(_now);
         return changes;
     }
@@ -181,7 +296,7 @@ class Terminal : public ScreenEvents {
     // {{{ selection management
     // TODO: move you, too?
     void setWordDelimiters(std::string const& _wordDelimiters);
-    std::u32string const& wordDelimiters() const noexcept { return wordDelimiters_; }
+    crispy::codepoint_set const& wordDelimiters() const noexcept { return wordDelimiters_; }
 
     Selector const* selector() const noexcept { return selector_.get(); }
     Selector* selector() noexcept { return selector_.get(); }
@@ -206,6 +321,29 @@ class Terminal : public ScreenEvents {
             && selector_->contains(_coord);
     }
 
+    /// @returns the selected columns of the given absolute row, or std::nullopt if none.
+    std::optional<Selector::Range> selectedColumnsAbsolute(int _row) const noexcept
+    {
+        if (!selector_ || selector_->state() == Selector::State::Waiting)
+            return std::nullopt;
+        return selector_->rangeAt(_row);
+    }
+
+    /// @returns the text of @p _selection, with a LF in between each selected row.
+    ///
+    /// The screen's lines are walked directly and need to be locked by the caller, which may be
+    /// another thread, as long as @p _selection is not modified meanwhile.
+    std::string extractText(Selector const& _selection) const;
+
+    /// Writes all logical lines of the history and the current buffer into the file at @p _path.
+    ///
+    /// The terminal is locked only while taking a page of lines at a time, such that this may run
+    /// on another thread while the terminal is in use, and must be called without holding the lock.
+    /// Lines appended meanwhile are not written, and lines dropped meanwhile are skipped.
+    ///
+    /// @retval false the file could not be written.
+    bool exportLines(std::string const& _path, ExportFormat _format) const;
+
     /// Sets or resets to a new selection.
     void setSelector(std::unique_ptr<Selector> _selector) { selector_ = std::move(_selector); }
 
@@ -215,7 +353,34 @@ class Terminal : public ScreenEvents {
 
   private:
     void flushInput();
+    void stampInputTime(std::chrono::steady_clock::time_point _now) noexcept;
+
+    /// Queues @p _data to be written to the PTY by the input writer thread.
+    void writeInput(std::string_view _data);
+    void addPendingInputBytes(size_t _size) noexcept;
+    void removePendingInputBytes(size_t _size) noexcept;
+
+    void inputWriterThread();
+    void ptyReaderThread();
     void screenUpdateThread();
+
+    /// Parses one slice of the output read from the PTY.
+    void parseOutput();
+
+    /// Tests whether more output than the fast-forward threshold is waiting to be parsed.
+    bool outputBacklogged() const noexcept;
+
+    /// Releases the alternate buffer, unless it has been used since @p _unusedSince.
+    void releaseAlternateBuffer(std::chrono::steady_clock::rep _unusedSince);
+
+    /// Releases the alternate buffer if it has been unused for long enough, or has the reactor
+    /// process this terminal again once it will have been.
+    void scheduleAlternateBufferRelease();
+
+    bool onReadable() override;
+    bool process() override;
+
+    void notifyOutputRingChanged();
     void onScreenReply(std::string_view const& reply);
     void updateCursorVisibilityState(std::chrono::steady_clock::time_point _now) const;
 
@@ -249,9 +414,12 @@ class Terminal : public ScreenEvents {
     void setMouseProtocol(MouseProtocol _protocol, bool _enabled) override;
     void setMouseTransport(MouseTransport _transport) override;
     void setMouseWheelMode(InputGenerator::MouseWheelMode _mode) override;
+    void setSynchronizedOutput(bool _enabled) override;
     void setWindowTitle(std::string_view const& _title) override;
     void useApplicationCursorKeys(bool _enabled) override;
     void discardImage(Image const&) override;
+    void decodeImage(std::shared_ptr<Image const> _image, std::string&& _data) override;
+    void onImageDecoded(std::shared_ptr<Image const>&& _image, std::optional<Image::Data>&& _data);
 
   private:
     /// Boolean, indicating whether the terminal's screen buffer contains updates to be rendered.
@@ -271,7 +439,7 @@ class Terminal : public ScreenEvents {
 
     std::chrono::steady_clock::time_point startTime_;
 
-    std::u32string wordDelimiters_;
+    crispy::codepoint_set wordDelimiters_;
     std::function<void()> onSelectionComplete_;
 
     // helpers for detecting double/tripple clicks
@@ -285,9 +453,60 @@ class Terminal : public ScreenEvents {
     InputGenerator::Sequence pendingInput_;
     Screen screen_;
     std::mutex mutable screenLock_;
+    std::atomic<size_t> readBufferSize_{ DefaultReadBufferSize };
+    std::atomic<std::chrono::microseconds> parseSliceTime_{ DefaultParseSliceTime };
+    mutable std::atomic<bool> inputAwaitingFrame_ = false; // input has been sent since the last frame
+    std::atomic<size_t> fastForwardThreshold_{ DefaultFastForwardThreshold };
+    std::atomic<bool> fastForwarding_ = false;
+    std::atomic<uint64_t> parsedBytes_ = 0;
+    std::unique_ptr<SessionRecorder> recorder_;  // guarded by screenLock_
+
+    // Input latency measurement, see takeRenderedInputTime(). Times since the clock's epoch, or 0.
+    std::atomic<std::chrono::steady_clock::rep> sentInputTime_ = 0;
+    mutable std::atomic<std::chrono::steady_clock::rep> echoedInputTime_ = 0;
+    mutable std::atomic<std::chrono::steady_clock::rep> renderedInputTime_ = 0;
+    std::atomic<std::chrono::steady_clock::rep> synchronizedOutputStart_ = 0;
+    std::atomic<std::chrono::milliseconds::rep> alternateBufferReleaseDelay_ = 0;
+    std::atomic<std::chrono::steady_clock::rep> alternateBufferUnusedSince_ = 0; // 0 if in use or released
+    bool suppressScreenUpdates_ = false;  // set while parsing a fast-forwarded slice
+    bool screenUpdateSuppressed_ = false; // screenUpdated() not notified while fast-forwarding
+
+    // The PTY reader thread (or the reactor) only fills outputRing_, while the screen update thread
+    // (or a reactor worker) parses it, so draining the PTY never waits for parsing or rendering.
+    static constexpr size_t OutputRingCapacity = 4 * 1024 * 1024;
+    crispy::spsc_ring<char> outputRing_{ OutputRingCapacity };
+    std::mutex outputRingLock_; // Only used for sleeping on outputRingChanged_.
+    std::condition_variable outputRingChanged_;
+    std::atomic<bool> ptyClosed_ = false;
+    std::thread ptyReaderThread_;
     std::thread screenUpdateThread_;
+    IOReactor* reactor_ = nullptr;          // services the PTY instead of the two threads above, if set
+    std::atomic<bool> readPaused_ = false;  // reactor stopped reading until outputRing_ has room
+    bool closeNotified_ = false;
+    std::chrono::steady_clock::time_point releaseScheduledAt_{}; // alternate buffer release the reactor is to wake up for
+
+    // All input is written by the input writer thread, such that neither the GUI nor the screen
+    // update thread ever block on an application not consuming its input. The lock is only held
+    // for queueing and dequeueing, never while writing to the PTY.
+    struct PendingInput {
+        std::string data;
+        bool paste;                 // pasted text, rather than its enclosing sequences or other input
+        size_t written = 0;
+        bool cancelled = false;
+    };
+    std::mutex pendingInputLock_;
+    std::condition_variable pendingInputChanged_;
+    std::deque<PendingInput> pendingInputs_;
+    bool quitInputWriter_ = false;
+    std::atomic<size_t> pendingInputBytes_ = 0;
+    std::atomic<size_t> peakPendingInputBytes_ = 0;
+    std::thread inputWriterThread_;
+
     Viewport viewport_;
     std::unique_ptr<Selector> selector_;
+
+    // Declared last, so that the decoder's thread stops before anything it calls back into is destroyed.
+    ImageDecoder imageDecoder_;
 };
 
 }  // namespace terminal
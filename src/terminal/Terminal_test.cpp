@@ -0,0 +1,172 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2020 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <terminal/Terminal.h>
+#include <catch2/catch.hpp>
+
+#if defined(__linux__)
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace terminal;
+using namespace std::chrono_literals;
+using std::string;
+
+namespace
+{
+    /// PTY whose output is written into a pipe, serviced by the I/O reactor.
+    class PipePty : public Pty {
+      public:
+        explicit PipePty(Size _size) : size_{ _size }
+        {
+            REQUIRE(pipe2(fds_, O_NONBLOCK | O_CLOEXEC) == 0);
+        }
+
+        ~PipePty() override
+        {
+            close();
+            hangUp();
+        }
+
+        /// Writes @p _data as output of the application, waiting for the pipe to drain as needed.
+        void send(string const& _data)
+        {
+            size_t written = 0;
+            while (written < _data.size())
+            {
+                auto const n = ::write(fds_[1], _data.data() + written, _data.size() - written);
+                if (n > 0)
+                    written += static_cast<size_t>(n);
+                else if (n < 0 && errno != EAGAIN)
+                    break;
+                else
+                    std::this_thread::sleep_for(100us);
+            }
+        }
+
+        void hangUp()
+        {
+            if (fds_[1] >= 0)
+                ::close(fds_[1]);
+            fds_[1] = -1;
+        }
+
+        void close() override
+        {
+            if (fds_[0] >= 0)
+                ::close(fds_[0]);
+            fds_[0] = -1;
+        }
+
+        void prepareParentProcess() override {}
+        void prepareChildProcess() override {}
+
+        int read(char* buf, size_t size) override
+        {
+            for (;;)
+            {
+                if (auto const n = readAvailable(buf, size); n != 0)
+                    return n;
+                std::this_thread::sleep_for(1ms);
+            }
+        }
+
+        NativeHandle readableHandle() const noexcept override { return fds_[0]; }
+
+        int readAvailable(char* buf, size_t size) override
+        {
+            auto const n = ::read(fds_[0], buf, size);
+            if (n < 0 && errno == EAGAIN)
+                return 0;
+            return n > 0 ? static_cast<int>(n) : -1;
+        }
+
+        int write(char const*, size_t size) override { return static_cast<int>(size); }
+        Size screenSize() const noexcept override { return size_; }
+        void resizeScreen(Size _cells, std::optional<Size>) override { size_ = _cells; }
+
+      private:
+        Size size_;
+        int fds_[2] = {-1, -1};
+    };
+
+    struct ClosingEvents : public Terminal::Events {
+        std::atomic<bool> closed = false;
+        void onClosed() override { closed = true; }
+    };
+
+    template <typename Predicate>
+    bool eventually(Predicate _predicate, std::chrono::milliseconds _timeout = 10s)
+    {
+        auto const end = std::chrono::steady_clock::now() + _timeout;
+        while (!_predicate())
+        {
+            if (std::chrono::steady_clock::now() > end)
+                return false;
+            std::this_thread::sleep_for(1ms);
+        }
+        return true;
+    }
+}
+
+TEST_CASE("Terminal.closedWithOutputPending", "[terminal]")
+{
+    auto events = ClosingEvents{};
+    auto ownedPty = std::make_unique<PipePty>(Size{80, 25});
+    auto& pty = *ownedPty;
+    auto terminal = Terminal{std::move(ownedPty), events, size_t{100}};
+
+    // Far more output than parsed before the PTY is closed, such that closing is
+    // noticed while output is still pending.
+    auto line = string(79, 'x') + "\r\n";
+    auto output = string{};
+    while (output.size() < 8 * 1024 * 1024)
+        output += line;
+    pty.send(output);
+    pty.hangUp();
+
+    CHECK(eventually([&]() { return events.closed.load(); }));
+}
+
+TEST_CASE("Terminal.releaseAlternateBuffer", "[terminal]")
+{
+    auto events = Terminal::Events{};
+    auto ownedPty = std::make_unique<PipePty>(Size{80, 25});
+    auto& pty = *ownedPty;
+    auto terminal = Terminal{std::move(ownedPty), events};
+    terminal.setAlternateBufferReleaseDelay(50ms);
+
+    auto const linesMemory = [&]() {
+        auto const _l = std::scoped_lock{terminal};
+        return terminal.screen().memoryUsage().lines;
+    };
+    auto const primaryOnly = linesMemory();
+
+    pty.send("\033[?1049h");
+    REQUIRE(eventually([&]() { return linesMemory() > primaryOnly; }));
+
+    // No more output follows, so only the reactor's timer can have the buffer released.
+    pty.send("\033[?1049l");
+    CHECK(eventually([&]() { return linesMemory() == primaryOnly; }));
+}
+
+#endif
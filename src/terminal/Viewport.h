@@ -43,14 +43,28 @@ class Viewport {
         return scrollOffset_.has_value();
     }
 
-    /// @returns scroll offset relative to the main screen buffer
+    /// @returns scroll offset relative to the main screen buffer, in visible (not folded) rows.
     int relativeScrollOffset() const noexcept
     {
         return scrollOffset_.has_value()
-            ? historyLineCount() - scrollOffset_.value()
+            ? screen_.visibleRowOf(historyLineCount()) - screen_.visibleRowOf(scrollOffset_.value())
             : 0;
     }
 
+    /// @returns the absolute row (as used by the Selector) displayed at the given 1-based row,
+    ///          mapped through the folded history rows.
+    int absoluteRow(int _row) const
+    {
+        if (!scrollOffset_.has_value())
+            return historyLineCount() + _row;
+
+        return screen_.absoluteRowOf(screen_.visibleRowOf(scrollOffset_.value()) + _row - 1) + 1;
+    }
+
+    /// @returns number of pixels the top row is scrolled out of the viewport, in [0, row height),
+    ///          with one more row than the screen's height shown partially at the bottom.
+    int pixelOffset() const noexcept { return pixelOffset_; }
+
     bool isLineVisible(int _row) const noexcept
     {
         return crispy::ascending(1 - relativeScrollOffset(), _row, screenLineCount() - relativeScrollOffset());
@@ -61,8 +75,8 @@ class Viewport {
         if (_numLines <= 0)
             return false;
 
-        auto const newOffset = std::max(absoluteScrollOffset().value_or(historyLineCount()) - _numLines, 0);
-        return scrollToAbsolute(newOffset);
+        auto const top = screen_.visibleRowOf(absoluteScrollOffset().value_or(historyLineCount()));
+        return scrollToAbsolute(screen_.absoluteRowOf(std::max(top - _numLines, 0)));
     }
 
     bool scrollDown(int _numLines)
@@ -70,8 +84,37 @@ class Viewport {
         if (_numLines <= 0)
             return false;
 
-        auto const newOffset = absoluteScrollOffset().value_or(historyLineCount()) + _numLines;
-        return scrollToAbsolute(newOffset);
+        auto const top = screen_.visibleRowOf(absoluteScrollOffset().value_or(historyLineCount()));
+        return scrollToAbsolute(screen_.absoluteRowOf(top + _numLines));
+    }
+
+    /// Scrolls by @p _pixels (positive towards the top of the history) of rows @p _rowHeight pixels tall,
+    /// moving the viewport by all rows crossed and keeping the remainder as pixelOffset().
+    bool scrollPixels(int _pixels, int _rowHeight)
+    {
+        if (scrollingDisabled() || _pixels == 0 || _rowHeight <= 0)
+            return false;
+
+        auto const hidden = pixelOffset_ - _pixels;
+        auto const rows = hidden >= 0 ? hidden / _rowHeight : -((_rowHeight - 1 - hidden) / _rowHeight);
+        auto const history = screen_.visibleRowOf(historyLineCount());
+        auto const top = screen_.visibleRowOf(absoluteScrollOffset().value_or(historyLineCount())) + rows;
+
+        auto const lastScrollOffset = scrollOffset_;
+        auto const lastPixelOffset = pixelOffset_;
+        if (top < 0)
+        {
+            pixelOffset_ = 0;
+            scrollToAbsolute(0);
+        }
+        else if (top >= history)
+            forceScrollToBottom();
+        else
+        {
+            pixelOffset_ = hidden - rows * _rowHeight;
+            scrollToAbsolute(screen_.absoluteRowOf(top));
+        }
+        return scrollOffset_ != lastScrollOffset || pixelOffset_ != lastPixelOffset;
     }
 
     bool scrollToTop()
@@ -93,6 +136,7 @@ class Viewport {
     bool forceScrollToBottom()
     {
         scrollOffset_.reset();
+        pixelOffset_ = 0;
         return true;
     }
 
@@ -140,6 +184,16 @@ class Viewport {
         return true;
     }
 
+    /// Folds or unfolds the output following the mark at or above the top of the viewport,
+    /// or above the main screen if not scrolled.
+    bool toggleFold()
+    {
+        if (scrollingDisabled())
+            return false;
+
+        return screen_.toggleFold(absoluteScrollOffset().value_or(historyLineCount()) - (scrolled() ? 0 : 1));
+    }
+
   private:
     int historyLineCount() const noexcept { return screen_.historyLineCount(); }
     int screenLineCount() const noexcept { return screen_.size().height; }
@@ -153,6 +207,7 @@ class Viewport {
   private:
     Screen& screen_;
     std::optional<int> scrollOffset_; //!< scroll offset relative to scroll top (0) or nullopt if not scrolled into history
+    int pixelOffset_ = 0;             //!< pixels of the top row scrolled out of the viewport
 };
 
 }
@@ -0,0 +1,120 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2020 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Keeps a terminal session running without a window, for contour to attach to and detach from.
+//
+// Usage: contour-daemon SOCKET [PROGRAM [ARGUMENTS...]]
+//
+// Runs PROGRAM, or the login shell, in a terminal of its own, whose screen is served to the
+// viewers attaching with `contour --attach SOCKET`. Closing a window only detaches it. Exits
+// with the exit code of the program, once it has exited.
+
+#include <terminal/Process.h>
+#include <terminal/SessionDaemon.h>
+#include <terminal/Terminal.h>
+#include <terminal/pty/UnixPty.h>
+
+#include <crispy/stdfs.h>
+
+#include <fmt/format.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <csignal>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <variant>
+
+using namespace std;
+using namespace terminal;
+
+namespace
+{
+    class Events : public Terminal::Events {
+      public:
+        void setDaemon(SessionDaemon* _daemon) { daemon_ = _daemon; }
+
+        void waitForClosed()
+        {
+            auto lock = unique_lock{mutex_};
+            closedChanged_.wait(lock, [this]() { return closed_; });
+        }
+
+      private:
+        void screenUpdated() override
+        {
+            if (auto* daemon = daemon_.load())
+                daemon->screenUpdated();
+        }
+
+        void onClosed() override
+        {
+            {
+                auto const _l = scoped_lock{mutex_};
+                closed_ = true;
+            }
+            closedChanged_.notify_all();
+        }
+
+        atomic<SessionDaemon*> daemon_ = nullptr;
+        mutex mutex_;
+        condition_variable closedChanged_;
+        bool closed_ = false;
+    };
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc < 2)
+    {
+        cerr << "Usage: contour-daemon SOCKET [PROGRAM [ARGUMENTS...]]\n";
+        return EXIT_FAILURE;
+    }
+
+    // Viewers going away must not take the daemon with them.
+    signal(SIGPIPE, SIG_IGN);
+
+    auto const socketPath = string(argv[1]);
+    auto shell = Process::ExecInfo{};
+    shell.program = argc > 2 ? string(argv[2]) : Process::loginShell();
+    for (int i = 3; i < argc; ++i)
+        shell.arguments.emplace_back(argv[i]);
+    shell.workingDirectory = FileSystem::current_path();
+    shell.env["TERM"] = "xterm-256color";
+    shell.env["COLORTERM"] = "truecolor";
+
+    auto events = Events{};
+    auto terminal = Terminal{UnixPty::create(Size{80, 25}), events};
+    auto daemon = SessionDaemon::create(terminal, socketPath);
+    if (!daemon)
+    {
+        cerr << fmt::format("Cannot serve the session at {}, which may be in use already.\n", socketPath);
+        terminal.device().close();
+        return EXIT_FAILURE;
+    }
+    events.setDaemon(daemon.get());
+
+    auto process = Process{shell, terminal.device()};
+    auto const status = process.wait();
+    terminal.device().close();
+    events.waitForClosed();
+    daemon->close();
+
+    if (auto const* normalExit = get_if<Process::NormalExit>(&status))
+        return normalExit->exitCode;
+    return EXIT_FAILURE;
+}
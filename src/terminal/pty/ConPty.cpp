@@ -13,9 +13,17 @@
  */
 #include <terminal/pty/ConPty.h>
 
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <atomic>
+#include <stdexcept>
+#include <utility>
+
 #include <Windows.h>
 
 using namespace std;
+using std::chrono::milliseconds;
 
 namespace {
     string GetLastErrorAsString()
@@ -41,12 +49,51 @@ namespace {
 
         return message;
     }
+
+    /// Size of the pipes' buffers, and the number of bytes read at once.
+    constexpr DWORD PipeBufferSize = 128 * 1024;
+
+    /// Creates a pipe like CreatePipe(), but with the returned server end opened for overlapped
+    /// I/O, which anonymous pipes do not support. The client end is meant for the pseudo console.
+    ///
+    /// @param _inbound whether the server end is the reading end of the pipe.
+    ///
+    /// @returns the server end and the client end.
+    pair<HANDLE, HANDLE> createOverlappedPipe(bool _inbound)
+    {
+        static auto serial = atomic<unsigned>{0};
+        auto const name = fmt::format("\\\\.\\pipe\\contour-conpty-{}-{}", GetCurrentProcessId(), serial++);
+
+        HANDLE const server = CreateNamedPipeA(
+            name.c_str(),
+            (_inbound ? PIPE_ACCESS_INBOUND : PIPE_ACCESS_OUTBOUND) | FILE_FLAG_OVERLAPPED | FILE_FLAG_FIRST_PIPE_INSTANCE,
+            PIPE_TYPE_BYTE | PIPE_READMODE_BYTE | PIPE_WAIT | PIPE_REJECT_REMOTE_CLIENTS,
+            1,
+            PipeBufferSize,
+            PipeBufferSize,
+            0,
+            nullptr
+        );
+        if (server == INVALID_HANDLE_VALUE)
+            throw runtime_error{ GetLastErrorAsString() };
+
+        HANDLE const client = CreateFileA(name.c_str(), _inbound ? GENERIC_WRITE : GENERIC_READ, 0, nullptr, OPEN_EXISTING, 0, nullptr);
+        if (client == INVALID_HANDLE_VALUE)
+        {
+            auto const message = GetLastErrorAsString();
+            CloseHandle(server);
+            throw runtime_error{ message };
+        }
+
+        return {server, client};
+    }
 } // anonymous namespace
 
 namespace terminal {
 
 ConPty::ConPty(Size const& _windowSize) :
-    size_{ _windowSize }
+    size_{ _windowSize },
+    readBuffer_(PipeBufferSize)
 {
     master_ = INVALID_HANDLE_VALUE;
     input_ = INVALID_HANDLE_VALUE;
@@ -56,15 +103,23 @@ ConPty::ConPty(Size const& _windowSize) :
     HANDLE hPipePTYOut{ INVALID_HANDLE_VALUE };
 
     // Create the pipes to which the ConPty will connect to
-    if (!CreatePipe(&hPipePTYIn, &output_, NULL, 0))
-        throw runtime_error{ GetLastErrorAsString() };
+    tie(output_, hPipePTYIn) = createOverlappedPipe(false);
 
-    if (!CreatePipe(&input_, &hPipePTYOut, NULL, 0))
+    try
+    {
+        tie(input_, hPipePTYOut) = createOverlappedPipe(true);
+    }
+    catch (...)
     {
         CloseHandle(hPipePTYIn);
-        throw runtime_error{ GetLastErrorAsString() };
+        close();
+        throw;
     }
 
+    // Manual reset events, as GetOverlappedResult() requires.
+    readOverlapped_.hEvent = CreateEventA(nullptr, TRUE, FALSE, nullptr);
+    writeOverlapped_.hEvent = CreateEventA(nullptr, TRUE, FALSE, nullptr);
+
     // Create the Pseudo Console of the required size, attached to the PTY-end of the pipes
     HRESULT hr = CreatePseudoConsole(
         { static_cast<SHORT>(_windowSize.width), static_cast<SHORT>(_windowSize.height) },
@@ -87,6 +142,13 @@ ConPty::ConPty(Size const& _windowSize) :
 ConPty::~ConPty()
 {
     close();
+
+    // The cancelled read must be done with readBuffer_ before it is gone.
+    if (readPending_)
+        WaitForSingleObject(readOverlapped_.hEvent, INFINITE);
+
+    CloseHandle(readOverlapped_.hEvent);
+    CloseHandle(writeOverlapped_.hEvent);
 }
 
 void ConPty::close()
@@ -99,6 +161,7 @@ void ConPty::close()
 
     if (input_ != INVALID_HANDLE_VALUE)
     {
+        CancelIoEx(input_, nullptr);
         CloseHandle(input_);
         input_ = INVALID_HANDLE_VALUE;
     }
@@ -120,20 +183,104 @@ void ConPty::prepareChildProcess()
 
 int ConPty::read(char* buf, size_t size)
 {
-    DWORD nread{};
-    if (ReadFile(input_, buf, static_cast<DWORD>(size), &nread, nullptr))
-        return static_cast<int>(nread);
-    else
-        return -1;
+    return readBuffered(buf, size, true);
+}
+
+int ConPty::readAvailable(char* buf, size_t size)
+{
+    return readBuffered(buf, size, false);
+}
+
+int ConPty::readBuffered(char* buf, size_t size, bool _wait)
+{
+    for (;;)
+    {
+        if (readOffset_ < readSize_)
+        {
+            auto const n = min(size, readSize_ - readOffset_);
+            copy_n(readBuffer_.data() + readOffset_, n, buf);
+            readOffset_ += n;
+
+            // Keeps the pipe being read from while the caller processes the data.
+            // Failures are reported by the next call.
+            if (readOffset_ == readSize_)
+                startRead();
+
+            return static_cast<int>(n);
+        }
+
+        if (!readPending_ && !startRead())
+            return -1;
+
+        DWORD nread{};
+        if (!GetOverlappedResult(input_, &readOverlapped_, &nread, _wait ? TRUE : FALSE))
+        {
+            if (GetLastError() == ERROR_IO_INCOMPLETE)
+                return 0;
+
+            readPending_ = false;
+            return -1;
+        }
+
+        readPending_ = false;
+        readOffset_ = 0;
+        readSize_ = nread;
+    }
+}
+
+bool ConPty::startRead()
+{
+    if (readPending_)
+        return true;
+
+    readOffset_ = 0;
+    readSize_ = 0;
+
+    // Reads completing right away are collected via GetOverlappedResult() just the same,
+    // and are reported to a completion port the handle is associated with as well.
+    if (!ReadFile(input_, readBuffer_.data(), static_cast<DWORD>(readBuffer_.size()), nullptr, &readOverlapped_)
+            && GetLastError() != ERROR_IO_PENDING)
+        return false;
+
+    readPending_ = true;
+    return true;
 }
 
 int ConPty::write(char const* buf, size_t size)
 {
-    DWORD nwritten{};
-    if (WriteFile(output_, buf, static_cast<DWORD>(size), &nwritten, nullptr))
-        return static_cast<int>(nwritten);
-    else
-        return -1;
+    return write(buf, size, nullopt);
+}
+
+int ConPty::writeSome(char const* buf, size_t size, milliseconds _timeout)
+{
+    return write(buf, size, _timeout);
+}
+
+int ConPty::write(char const* buf, size_t size, optional<milliseconds> _timeout)
+{
+    size_t total = 0;
+    while (total < size)
+    {
+        if (!WriteFile(output_, buf + total, static_cast<DWORD>(size - total), nullptr, &writeOverlapped_)
+                && GetLastError() != ERROR_IO_PENDING)
+            return total != 0 ? static_cast<int>(total) : -1;
+
+        // The pipe's buffer is full, wait until the other end has consumed some of it,
+        // keeping whatever has been written when giving up.
+        auto const timeout = _timeout.has_value() ? static_cast<DWORD>(_timeout.value().count()) : INFINITE;
+        bool const timedOut = WaitForSingleObject(writeOverlapped_.hEvent, timeout) == WAIT_TIMEOUT;
+        if (timedOut)
+            CancelIoEx(output_, &writeOverlapped_);
+
+        DWORD nwritten{};
+        if (!GetOverlappedResult(output_, &writeOverlapped_, &nwritten, TRUE) && GetLastError() != ERROR_OPERATION_ABORTED)
+            return total != 0 ? static_cast<int>(total) : -1;
+
+        total += nwritten;
+        if (timedOut)
+            break;
+    }
+    return static_cast<int>(total);
 }
 
 Size ConPty::screenSize() const noexcept
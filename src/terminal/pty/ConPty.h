@@ -15,11 +15,18 @@
 
 #include <terminal/pty/Pty.h>
 
+#include <chrono>
+#include <optional>
+#include <vector>
+
 #include <Windows.h>
 
 namespace terminal {
 
 /// ConPty implementation for newer Windows 10 versions.
+///
+/// The pipes to the pseudo console are used with overlapped I/O, such that reads can be serviced
+/// by the IOReactor's completion port rather than a thread per terminal, and writes can time out.
 class ConPty : public Pty
 {
   public:
@@ -32,17 +39,44 @@ class ConPty : public Pty
     void prepareChildProcess() override;
 
     int read(char* buf, size_t size) override;
+    NativeHandle readableHandle() const noexcept override { return input_; }
+    int readAvailable(char* buf, size_t size) override;
     int write(char const* buf, size_t size) override;
+    int writeSome(char const* buf, size_t size, std::chrono::milliseconds _timeout) override;
     Size screenSize() const noexcept override;
     void resizeScreen(Size _cells, std::optional<Size> _pixels = std::nullopt) override;
 
     HPCON master() const noexcept { return master_; }
 
   private:
+    /// Hands out what has been read into readBuffer_, reading ahead once it is drained.
+    ///
+    /// @param _wait whether to wait for the pending read to complete if nothing has been read yet.
+    ///
+    /// @returns number of bytes stored in @p buf (0 only if not waiting), or -1 once closed.
+    int readBuffered(char* buf, size_t size, bool _wait);
+
+    /// Starts an overlapped read into readBuffer_, unless one is pending already.
+    ///
+    /// @returns false if reading failed, e.g. because the other end has been closed.
+    bool startRead();
+
+    /// Writes @p size bytes, waiting at most @p _timeout (or infinitely if not set) for the
+    /// other end to consume its input.
+    int write(char const* buf, size_t size, std::optional<std::chrono::milliseconds> _timeout);
+
     Size size_;
     HPCON master_;
     HANDLE input_;
     HANDLE output_;
+
+    OVERLAPPED readOverlapped_{};
+    std::vector<char> readBuffer_;
+    size_t readOffset_ = 0;         // bytes of readBuffer_ handed out already
+    size_t readSize_ = 0;           // bytes of readBuffer_ filled by the last completed read
+    bool readPending_ = false;      // readOverlapped_ is in use
+
+    OVERLAPPED writeOverlapped_{};
 };
 
 }  // namespace terminal
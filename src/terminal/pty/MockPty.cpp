@@ -0,0 +1,105 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2020 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <terminal/pty/MockPty.h>
+
+#include <algorithm>
+#include <cstring>
+
+using std::min;
+using std::optional;
+using std::scoped_lock;
+using std::string;
+using std::string_view;
+using std::unique_lock;
+
+namespace terminal {
+
+MockPty::MockPty(Size const& _windowSize) :
+    size_{_windowSize}
+{
+}
+
+MockPty::~MockPty()
+{
+    close();
+}
+
+int MockPty::read(char* _buf, size_t _size)
+{
+    auto lock = unique_lock{mutex_};
+    outputChanged_.wait(lock, [this]() { return outputRead_ < outputBuffer_.size() || closed_; });
+    if (outputRead_ == outputBuffer_.size())
+        return -1;
+
+    auto const n = min(_size, outputBuffer_.size() - outputRead_);
+    std::memcpy(_buf, outputBuffer_.data() + outputRead_, n);
+    outputRead_ += n;
+    if (outputRead_ == outputBuffer_.size())
+    {
+        outputBuffer_.clear();
+        outputRead_ = 0;
+    }
+    return static_cast<int>(n);
+}
+
+int MockPty::write(char const* _buf, size_t _size)
+{
+    auto const _l = scoped_lock{mutex_};
+    inputBuffer_.append(_buf, _size);
+    return static_cast<int>(_size);
+}
+
+Size MockPty::screenSize() const noexcept
+{
+    return size_;
+}
+
+void MockPty::resizeScreen(Size _cells, optional<Size> /*_pixels*/)
+{
+    size_ = _cells;
+}
+
+void MockPty::prepareChildProcess()
+{
+}
+
+void MockPty::prepareParentProcess()
+{
+}
+
+void MockPty::close()
+{
+    {
+        auto const _l = scoped_lock{mutex_};
+        closed_ = true;
+    }
+    outputChanged_.notify_all();
+}
+
+void MockPty::appendOutput(string_view _data)
+{
+    {
+        auto const _l = scoped_lock{mutex_};
+        outputBuffer_.append(_data);
+    }
+    outputChanged_.notify_all();
+}
+
+string MockPty::input() const
+{
+    auto const _l = scoped_lock{mutex_};
+    return inputBuffer_;
+}
+
+} // end namespace
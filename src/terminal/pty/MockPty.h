@@ -15,9 +15,17 @@
 
 #include <terminal/pty/Pty.h>
 
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <string_view>
+
 namespace terminal {
 
-/// Mock-PTY, to be used in unit tests.
+/// Mock-PTY, to be used in unit tests and for replaying recorded sessions.
+///
+/// Output is provided via appendOutput() in place of an application, and read() blocks until
+/// there is some or until the PTY is closed. Input written to it is collected in input().
 class MockPty : public Pty
 {
   public:
@@ -33,10 +41,20 @@ class MockPty : public Pty
     void prepareParentProcess() override;
     void close() override;
 
+    /// Provides @p _data as output of the application, to be read by the terminal.
+    void appendOutput(std::string_view _data);
+
+    /// @returns the input written to the PTY so far.
+    std::string input() const;
+
   private:
     Size size_;
+    mutable std::mutex mutex_;
+    std::condition_variable outputChanged_;
+    bool closed_ = false;
     std::string inputBuffer_;
     std::string outputBuffer_;
+    size_t outputRead_ = 0;    // offset into outputBuffer_ of what has not been read yet
 };
 
 } // end namespace
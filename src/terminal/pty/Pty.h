@@ -15,10 +15,20 @@
 
 #include <terminal/Size.h>
 
+#include <chrono>
 #include <optional>
 
 namespace terminal {
 
+/// Operating system handle a PTY can be waited on with.
+#if defined(_WIN32)
+using NativeHandle = void*; // HANDLE
+constexpr NativeHandle NoNativeHandle = nullptr;
+#else
+using NativeHandle = int; // file descriptor
+constexpr NativeHandle NoNativeHandle = -1;
+#endif
+
 class Pty {
   public:
     virtual ~Pty() = default;
@@ -47,6 +57,22 @@ class Pty {
     /// @returns number of bytes stored in @p buf or -1 on error.
     virtual int read(char* buf, size_t size) = 0;
 
+    /// @returns handle to wait on for the PTY becoming readable, such that many PTYs can be
+    ///          serviced by a single thread via readAvailable(), or NoNativeHandle if unsupported.
+    virtual NativeHandle readableHandle() const noexcept { return NoNativeHandle; }
+
+    /// Reads from the terminal like read(), but only what is available right away, never blocking.
+    ///
+    /// Only supported if readableHandle() is.
+    ///
+    /// @returns number of bytes stored in @p buf (possibly 0), or -1 on error or once closed.
+    virtual int readAvailable(char* buf, size_t size)
+    {
+        (void) buf;
+        (void) size;
+        return -1;
+    }
+
     /// Writes to the PTY device, so the other end can read from it.
     ///
     /// @param buf    Buffer of data to be written.
@@ -55,6 +81,16 @@ class Pty {
     /// @returns Number of bytes written or -1 on error.
     virtual int write(char const* buf, size_t size) = 0;
 
+    /// Writes to the PTY device like write(), but gives up waiting for the other end to consume
+    /// its input after @p _timeout, such that the caller can check for cancellation meanwhile.
+    ///
+    /// @returns Number of bytes written, which is less than @p size when timed out, or -1 on error.
+    virtual int writeSome(char const* buf, size_t size, std::chrono::milliseconds _timeout)
+    {
+        (void) _timeout;
+        return write(buf, size);
+    }
+
     /// @returns current underlying window size in characters width and height.
     virtual Size screenSize() const noexcept = 0;
 
@@ -13,6 +13,10 @@
  */
 #include <terminal/pty/UnixPty.h>
 
+#if defined(LIBTERMINAL_IO_URING)
+#include <terminal/pty/UringPty.h>
+#endif
+
 #include <cassert>
 #include <cstddef>
 #include <cstdlib>
@@ -27,17 +31,29 @@
 #include <pty.h>
 #endif
 
+#if defined(__linux__)
+#include <sys/epoll.h>
+#elif defined(__APPLE__) || defined(__FreeBSD__)
+#include <sys/event.h>
+#endif
+
 #include <fcntl.h>
 #include <utmp.h>
+#include <poll.h>
 #include <pwd.h>
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <sys/ioctl.h>
-#include <sys/select.h>
 #include <unistd.h>
 
 using std::runtime_error;
 using std::numeric_limits;
+using std::nullopt;
+using std::optional;
+using std::chrono::duration_cast;
+using std::chrono::microseconds;
+using std::chrono::milliseconds;
+using std::chrono::steady_clock;
 using namespace std::string_literals;
 
 namespace terminal {
@@ -89,10 +105,48 @@ namespace
 
         return tio;
     }
+
+    /// Number of bytes that must have been read in one go before read() considers
+    /// the output a burst and starts waiting for more data to coalesce.
+    constexpr size_t CoalescingThreshold = 4096;
+
+    int createEventLoop(int _fd)
+    {
+#if defined(__linux__)
+        int const epfd = epoll_create1(EPOLL_CLOEXEC);
+        if (epfd < 0)
+            return -1;
+        epoll_event ev{};
+        ev.events = EPOLLIN;
+        ev.data.fd = _fd;
+        if (epoll_ctl(epfd, EPOLL_CTL_ADD, _fd, &ev) < 0)
+        {
+            ::close(epfd);
+            return -1;
+        }
+        return epfd;
+#elif defined(__APPLE__) || defined(__FreeBSD__)
+        int const kq = kqueue();
+        if (kq < 0)
+            return -1;
+        struct kevent ev{};
+        EV_SET(&ev, _fd, EVFILT_READ, EV_ADD, 0, 0, nullptr);
+        if (kevent(kq, &ev, 1, nullptr, 0, nullptr) < 0)
+        {
+            ::close(kq);
+            return -1;
+        }
+        return kq;
+#else
+        (void) _fd;
+        return -1;
+#endif
+    }
 }
 
-UnixPty::UnixPty(Size const& _windowSize) :
-    size_{ _windowSize }
+UnixPty::UnixPty(Size const& _windowSize, microseconds _readCoalescingLatency) :
+    size_{ _windowSize },
+    readCoalescingLatency_{ _readCoalescingLatency }
 {
     // See https://code.woboq.org/userspace/glibc/login/forkpty.c.html
     assert(_windowSize.height <= numeric_limits<unsigned short>::max());
@@ -114,6 +168,13 @@ UnixPty::UnixPty(Size const& _windowSize) :
     // TODO: termios term{};
     if (openpty(&master_, &slave_, nullptr, /*&term*/ nullptr, wsa) < 0)
         throw runtime_error{ "Failed to open PTY. "s + strerror(errno) };
+
+    // The master end is kept non-blocking for its whole lifetime, read() and write()
+    // wait for readiness via the event loop instead.
+    fcntl(master_, F_SETFL, fcntl(master_, F_GETFL) | O_NONBLOCK);
+    fcntl(master_, F_SETFD, FD_CLOEXEC);
+
+    eventLoop_ = createEventLoop(master_);
 }
 
 UnixPty::~UnixPty()
@@ -121,8 +182,32 @@ UnixPty::~UnixPty()
     close();
 }
 
+std::unique_ptr<UnixPty> UnixPty::create(Size const& _windowSize, microseconds _readCoalescingLatency)
+{
+#if defined(LIBTERMINAL_IO_URING)
+    if (UringPty::supported())
+    {
+        try
+        {
+            return std::make_unique<UringPty>(_windowSize, _readCoalescingLatency);
+        }
+        catch (runtime_error const&)
+        {
+            // Such as when out of locked memory for the io_uring, read conventionally then.
+        }
+    }
+#endif
+    return std::make_unique<UnixPty>(_windowSize, _readCoalescingLatency);
+}
+
 void UnixPty::close()
 {
+    if (eventLoop_ >= 0)
+    {
+        ::close(eventLoop_);
+        eventLoop_ = -1;
+    }
+
     if (master_ >= 0)
     {
         ::close(master_);
@@ -136,54 +221,157 @@ void UnixPty::close()
     }
 }
 
+bool UnixPty::waitForReadable(optional<microseconds> _timeout)
+{
+#if defined(__linux__)
+    if (eventLoop_ >= 0)
+    {
+        int const timeoutMillis = _timeout.has_value()
+            ? static_cast<int>((_timeout.value().count() + 999) / 1000)
+            : -1;
+        epoll_event ev{};
+        for (;;)
+        {
+            int const rv = epoll_wait(eventLoop_, &ev, 1, timeoutMillis);
+            if (rv < 0 && errno == EINTR)
+                continue;
+            return rv > 0;
+        }
+    }
+#elif defined(__APPLE__) || defined(__FreeBSD__)
+    if (eventLoop_ >= 0)
+    {
+        timespec ts{};
+        if (_timeout.has_value())
+        {
+            ts.tv_sec = static_cast<time_t>(_timeout.value().count() / 1000000);
+            ts.tv_nsec = static_cast<long>((_timeout.value().count() % 1000000) * 1000);
+        }
+        struct kevent ev{};
+        for (;;)
+        {
+            int const rv = kevent(eventLoop_, nullptr, 0, &ev, 1, _timeout.has_value() ? &ts : nullptr);
+            if (rv < 0 && errno == EINTR)
+                continue;
+            return rv > 0;
+        }
+    }
+#endif
+
+    pollfd pfd{ master_, POLLIN, 0 };
+    int const timeoutMillis = _timeout.has_value()
+        ? static_cast<int>((_timeout.value().count() + 999) / 1000)
+        : -1;
+    for (;;)
+    {
+        int const rv = poll(&pfd, 1, timeoutMillis);
+        if (rv < 0 && errno == EINTR)
+            continue;
+        return rv > 0;
+    }
+}
+
 int UnixPty::read(char* buf, size_t size)
 {
-    ssize_t rv = ::read(master_, buf, size);
-    if (rv < 0 || rv >= static_cast<decltype(rv)>(size))
-        return rv;
-#if 1
-    //size_t const cap = size;
-    ssize_t nread = rv;
-    int i = 1;
-    size -= rv;
-    buf += rv;
-
-    auto const oldFlags = fcntl(master_, F_GETFL);
-    fcntl(master_, F_SETFL, oldFlags | O_NONBLOCK);
-
-    fd_set in, out, err;
-    FD_ZERO(&in);
-    FD_ZERO(&out);
-    FD_ZERO(&err);
-    FD_SET(master_, &in);
-
-    while (size > 0)
+    size_t nread = 0;
+    steady_clock::time_point burstStart{};
+
+    while (nread < size)
     {
-        ++i;
-        timeval tv{0, 0};
-        int const selected = select(master_ + 1, &in, &out, &err, &tv);
-        if (selected <= 0)
+        ssize_t const rv = ::read(master_, buf + nread, size - nread);
+        if (rv > 0)
+        {
+            if (nread == 0)
+                burstStart = steady_clock::now();
+            nread += static_cast<size_t>(rv);
+            continue;
+        }
+
+        if (rv < 0 && errno == EINTR)
+            continue;
+
+        if (rv == 0 || (errno != EAGAIN && errno != EWOULDBLOCK))
+            break; // EOF or error
+
+        if (nread == 0)
+        {
+            // Nothing read yet, so block until there is something to read.
+            if (!waitForReadable(std::nullopt))
+                return -1;
+            continue;
+        }
+
+        // Small amounts of data (such as interactive echo) are returned right away,
+        // whereas bursts keep being coalesced until the latency budget is used up.
+        if (nread < CoalescingThreshold)
             break;
-        rv = ::read(master_, buf, size);
-        if (rv < 0)
+
+        auto const elapsed = duration_cast<microseconds>(steady_clock::now() - burstStart);
+        if (elapsed >= readCoalescingLatency_ || !waitForReadable(readCoalescingLatency_ - elapsed))
             break;
-        nread += rv;
-        size -= rv;
-        buf += rv;
     }
 
-    fcntl(master_, F_SETFL, oldFlags);
-    //printf("pty.read: %zu/%zu bytes (%ld%%, #%d)\n", nread, cap, nread * 100 / cap, i);
-    return nread;
-#else
-    return rv;
-#endif
+    if (nread == 0)
+        return -1;
+
+    return static_cast<int>(nread);
+}
+
+int UnixPty::readAvailable(char* buf, size_t size)
+{
+    for (;;)
+    {
+        ssize_t const rv = ::read(master_, buf, size);
+        if (rv > 0)
+            return static_cast<int>(rv);
+
+        if (rv < 0 && errno == EINTR)
+            continue;
+
+        if (rv < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            return 0;
+
+        return -1; // EOF or error
+    }
 }
 
 int UnixPty::write(char const* buf, size_t size)
 {
-    ssize_t rv = ::write(master_, buf, size);
-    return static_cast<int>(rv);
+    return write(buf, size, nullopt);
+}
+
+int UnixPty::writeSome(char const* buf, size_t size, milliseconds _timeout)
+{
+    return write(buf, size, _timeout);
+}
+
+int UnixPty::write(char const* buf, size_t size, optional<milliseconds> _timeout)
+{
+    size_t nwritten = 0;
+    while (nwritten < size)
+    {
+        ssize_t const rv = ::write(master_, buf + nwritten, size - nwritten);
+        if (rv >= 0)
+        {
+            nwritten += static_cast<size_t>(rv);
+            continue;
+        }
+
+        if (errno == EINTR)
+            continue;
+
+        if (errno != EAGAIN && errno != EWOULDBLOCK)
+            return nwritten != 0 ? static_cast<int>(nwritten) : -1;
+
+        // The PTY's input buffer is full, wait until the other end has consumed some of it.
+        pollfd pfd{ master_, POLLOUT, 0 };
+        int const ready = poll(&pfd, 1, _timeout.has_value() ? static_cast<int>(_timeout.value().count()) : -1);
+        if (ready < 0 && errno != EINTR)
+            return nwritten != 0 ? static_cast<int>(nwritten) : -1;
+        if (ready == 0)
+            break; // timed out
+    }
+    return static_cast<int>(nwritten);
 }
 
 Size UnixPty::screenSize() const noexcept
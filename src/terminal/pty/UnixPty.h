@@ -15,6 +15,8 @@
 
 #include <terminal/pty/Pty.h>
 
+#include <chrono>
+#include <memory>
 #include <optional>
 
 #if defined(__APPLE__)
@@ -28,11 +30,26 @@ namespace terminal {
 class UnixPty : public Pty
 {
   public:
-    explicit UnixPty(Size const& windowSize);
+    /// Default time budget for coalescing bursts of output into a single read().
+    static constexpr std::chrono::microseconds DefaultReadCoalescingLatency{500};
+
+    /// @param windowSize             initial window size in character cells.
+    /// @param _readCoalescingLatency maximum time read() keeps waiting for more data
+    ///                               while the child process is flooding output.
+    explicit UnixPty(Size const& windowSize,
+                     std::chrono::microseconds _readCoalescingLatency = DefaultReadCoalescingLatency);
     ~UnixPty() override;
 
+    /// @returns a new PTY, reading via io_uring where the kernel supports it (see UringPty),
+    ///          and constructed with the given arguments otherwise.
+    static std::unique_ptr<UnixPty> create(Size const& windowSize,
+                                           std::chrono::microseconds _readCoalescingLatency = DefaultReadCoalescingLatency);
+
     int read(char* buf, size_t size) override;
+    NativeHandle readableHandle() const noexcept override { return master_; }
+    int readAvailable(char* buf, size_t size) override;
     int write(char const* buf, size_t size) override;
+    int writeSome(char const* buf, size_t size, std::chrono::milliseconds _timeout) override;
     Size screenSize() const noexcept override;
     void resizeScreen(Size _cells, std::optional<Size> _pixels = std::nullopt) override;
 
@@ -40,10 +57,25 @@ class UnixPty : public Pty
     void prepareChildProcess() override;
     void close() override;
 
+    /// @returns file descriptor of the slave end, or -1 once closed by prepareParentProcess().
+    int slave() const noexcept { return slave_; }
+
   private:
+    /// Waits (at most @p _timeout, or infinitely if not set) for the master end to become readable.
+    ///
+    /// @retval true  data is available for reading (or the other end has been closed).
+    /// @retval false timeout reached or waiting failed.
+    bool waitForReadable(std::optional<std::chrono::microseconds> _timeout);
+
+    /// Writes @p size bytes, waiting at most @p _timeout (or infinitely if not set) for the
+    /// other end to consume its input once the PTY's input buffer is full.
+    int write(char const* buf, size_t size, std::optional<std::chrono::milliseconds> _timeout);
+
     Size size_;
     int master_;
     int slave_;
+    int eventLoop_ = -1; // epoll or kqueue file descriptor, if available
+    std::chrono::microseconds readCoalescingLatency_;
 };
 
 }  // namespace terminal
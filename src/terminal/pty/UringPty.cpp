@@ -0,0 +1,343 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2020 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <terminal/pty/UringPty.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+using std::max;
+using std::min;
+using std::runtime_error;
+using std::chrono::microseconds;
+using namespace std::string_literals;
+
+namespace terminal {
+
+namespace
+{
+    /// IORING_OP_READ_MULTISHOT, from Linux 6.7 on, spelled out for older kernel headers.
+    constexpr uint8_t OpReadMultishot = 49;
+
+    /// Providing the buffers and the read, or cancelling the read.
+    constexpr unsigned SubmissionQueueSize = 2;
+
+    /// Number and size of the buffers reads are placed into.
+    constexpr unsigned BufferCount = 16;
+    constexpr size_t BufferSize = 16 * 1024;
+
+    /// Large enough for each buffer's completion plus the one ending the read.
+    constexpr unsigned CompletionQueueSize = 2 * BufferCount;
+
+    constexpr uint16_t BufferGroup = 0;
+
+    constexpr uint64_t ReadUserData = 1;
+    constexpr uint64_t ProvideUserData = 2;
+    constexpr uint64_t CancelUserData = 3;
+
+    int ioUringSetup(unsigned _entries, io_uring_params& _params)
+    {
+        return static_cast<int>(syscall(__NR_io_uring_setup, _entries, &_params));
+    }
+
+    int ioUringEnter(int _ring, unsigned _submit, unsigned _wait, unsigned _flags)
+    {
+        for (;;)
+        {
+            auto const rv = static_cast<int>(syscall(__NR_io_uring_enter, _ring, _submit, _wait, _flags, nullptr, 0));
+            if (rv >= 0 || errno != EINTR)
+                return rv;
+        }
+    }
+
+    int ioUringRegister(int _ring, unsigned _opcode, void* _arg, unsigned _count)
+    {
+        return static_cast<int>(syscall(__NR_io_uring_register, _ring, _opcode, _arg, _count));
+    }
+
+    /// @returns whether or not the io_uring @p _ring supports the operation @p _opcode.
+    bool supportsOpcode(int _ring, unsigned _opcode)
+    {
+        constexpr unsigned OpCount = 256;
+        auto* probe = static_cast<io_uring_probe*>(calloc(1, sizeof(io_uring_probe) + OpCount * sizeof(io_uring_probe_op)));
+        if (!probe)
+            return false;
+
+        bool const supported = ioUringRegister(_ring, IORING_REGISTER_PROBE, probe, OpCount) >= 0
+                            && probe->last_op >= _opcode
+                            && (probe->ops[_opcode].flags & IO_URING_OP_SUPPORTED) != 0;
+        free(probe);
+        return supported;
+    }
+
+    runtime_error systemError(char const* _what)
+    {
+        return runtime_error{ _what + ": "s + strerror(errno) };
+    }
+}
+
+bool UringPty::supported() noexcept
+{
+    static bool const result = []() {
+        auto params = io_uring_params{};
+        int const ring = ioUringSetup(SubmissionQueueSize, params);
+        if (ring < 0)
+            return false;
+
+        // Multishot reads came after provided buffers and single mmap rings.
+        bool const supported = (params.features & IORING_FEAT_SINGLE_MMAP) != 0
+                            && supportsOpcode(ring, IORING_OP_PROVIDE_BUFFERS)
+                            && supportsOpcode(ring, OpReadMultishot);
+        ::close(ring);
+        return supported;
+    }();
+    return result;
+}
+
+UringPty::UringPty(Size const& _windowSize, microseconds _readCoalescingLatency) :
+    UnixPty{ _windowSize, _readCoalescingLatency }
+{
+    auto params = io_uring_params{};
+    params.flags = IORING_SETUP_CQSIZE;
+    params.cq_entries = CompletionQueueSize;
+    ring_ = ioUringSetup(SubmissionQueueSize, params);
+    if (ring_ < 0)
+        throw systemError("io_uring_setup");
+
+    try
+    {
+        if (!(params.features & IORING_FEAT_SINGLE_MMAP))
+            throw runtime_error{ "io_uring_setup: single mmap rings unsupported" };
+
+        // {{{ queues
+        ringsSize_ = max(params.sq_off.array + params.sq_entries * sizeof(unsigned),
+                         params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe));
+        rings_ = mmap(nullptr, ringsSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_, IORING_OFF_SQ_RING);
+        if (rings_ == MAP_FAILED)
+        {
+            rings_ = nullptr;
+            throw systemError("mmap");
+        }
+
+        sqesSize_ = params.sq_entries * sizeof(io_uring_sqe);
+        auto const sqes = mmap(nullptr, sqesSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_, IORING_OFF_SQES);
+        if (sqes == MAP_FAILED)
+            throw systemError("mmap");
+        sqes_ = static_cast<io_uring_sqe*>(sqes);
+
+        auto* const rings = static_cast<char*>(rings_);
+        sqTail_ = reinterpret_cast<unsigned*>(rings + params.sq_off.tail);
+        sqArray_ = reinterpret_cast<unsigned*>(rings + params.sq_off.array);
+        sqMask_ = *reinterpret_cast<unsigned*>(rings + params.sq_off.ring_mask);
+        cqHead_ = reinterpret_cast<unsigned*>(rings + params.cq_off.head);
+        cqTail_ = reinterpret_cast<unsigned*>(rings + params.cq_off.tail);
+        cqes_ = reinterpret_cast<io_uring_cqe*>(rings + params.cq_off.cqes);
+        cqMask_ = *reinterpret_cast<unsigned*>(rings + params.cq_off.ring_mask);
+        // }}}
+
+        buffers_ = std::make_unique<char[]>(BufferCount * BufferSize);
+
+        if (!armRead())
+            throw systemError("io_uring_enter");
+    }
+    catch (...)
+    {
+        closeRing();
+        throw;
+    }
+}
+
+UringPty::~UringPty()
+{
+    closeRing();
+}
+
+void UringPty::close()
+{
+    closeRing();
+    UnixPty::close();
+}
+
+void UringPty::closeRing()
+{
+    if (ring_ < 0)
+        return;
+
+    // The read is cancelled and waited for before the buffers are freed, which the kernel
+    // would otherwise still write to while tearing down the io_uring in the background.
+    if (readArmed_)
+    {
+        auto& cancel = nextSubmission();
+        cancel.opcode = IORING_OP_ASYNC_CANCEL;
+        cancel.fd = -1;
+        cancel.addr = ReadUserData;
+        cancel.user_data = CancelUserData;
+
+        if (submit(1))
+        {
+            while (readArmed_)
+            {
+                if (!reapCompletion() && ioUringEnter(ring_, 0, 1, IORING_ENTER_GETEVENTS) < 0)
+                    break;
+            }
+        }
+    }
+
+    if (sqes_)
+        munmap(sqes_, sqesSize_);
+    if (rings_)
+        munmap(rings_, ringsSize_);
+    ::close(ring_);
+
+    ring_ = -1;
+    sqes_ = nullptr;
+    rings_ = nullptr;
+    readArmed_ = false;
+    readClosed_ = true;
+}
+
+bool UringPty::armRead()
+{
+    if (readArmed_)
+        return true;
+
+    // The read is re-armed only once all buffers have been handed out, so all are free again.
+    // Provided buffers are taken in order, with the read submitted after them.
+    auto& provide = nextSubmission();
+    provide.opcode = IORING_OP_PROVIDE_BUFFERS;
+    provide.fd = static_cast<int>(BufferCount);
+    provide.addr = reinterpret_cast<uint64_t>(buffers_.get());
+    provide.len = static_cast<uint32_t>(BufferSize);
+    provide.off = 0; // first buffer id
+    provide.buf_group = BufferGroup;
+    provide.user_data = ProvideUserData;
+
+    auto& read = nextSubmission();
+    read.opcode = OpReadMultishot;
+    read.fd = UnixPty::readableHandle();
+    read.flags = IOSQE_BUFFER_SELECT;
+    read.buf_group = BufferGroup;
+    read.user_data = ReadUserData;
+
+    if (!submit(2))
+        return false;
+
+    readArmed_ = true;
+    return true;
+}
+
+io_uring_sqe& UringPty::nextSubmission()
+{
+    // Entries are published right away, the kernel only takes them when submitting.
+    auto const tail = *sqTail_;
+    auto const index = tail & sqMask_;
+    auto& sqe = sqes_[index];
+    sqe = io_uring_sqe{};
+    sqArray_[index] = index;
+    __atomic_store_n(sqTail_, tail + 1, __ATOMIC_RELEASE);
+    return sqe;
+}
+
+bool UringPty::submit(unsigned _count)
+{
+    return ioUringEnter(ring_, _count, 0, 0) == static_cast<int>(_count);
+}
+
+bool UringPty::reapCompletion()
+{
+    auto const head = *cqHead_;
+    if (head == __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE))
+        return false;
+
+    auto const cqe = cqes_[head & cqMask_];
+    __atomic_store_n(cqHead_, head + 1, __ATOMIC_RELEASE);
+
+    if (cqe.user_data == ProvideUserData && cqe.res < 0)
+        readClosed_ = true; // the read would end right away for lack of buffers, over and over again
+
+    if (cqe.user_data != ReadUserData)
+        return true;
+
+    if (!(cqe.flags & IORING_CQE_F_MORE))
+        readArmed_ = false;
+
+    if (cqe.res > 0 && (cqe.flags & IORING_CQE_F_BUFFER))
+    {
+        currentBuffer_ = cqe.flags >> IORING_CQE_BUFFER_SHIFT;
+        currentOffset_ = 0;
+        currentSize_ = static_cast<size_t>(cqe.res);
+    }
+    else if (cqe.res != -ENOBUFS)
+        readClosed_ = true; // EOF, or an error such as EIO once the slave end has been closed
+
+    return true;
+}
+
+int UringPty::readAvailable(char* buf, size_t size)
+{
+    if (ring_ < 0)
+        return -1;
+
+    auto total = size_t{0};
+    auto drained = false;
+    while (total < size)
+    {
+        if (currentOffset_ < currentSize_)
+        {
+            auto const n = min(size - total, currentSize_ - currentOffset_);
+            memcpy(buf + total, buffers_.get() + currentBuffer_ * BufferSize + currentOffset_, n);
+            currentOffset_ += n;
+            total += n;
+            continue;
+        }
+
+        if (!reapCompletion())
+        {
+            drained = true;
+            break;
+        }
+    }
+
+    // The read ends once all buffers are filled, and is re-armed after all have been handed out.
+    if (!readArmed_ && !readClosed_ && drained && !armRead())
+        readClosed_ = true;
+
+    if (total == 0 && readClosed_ && drained)
+        return -1;
+
+    return static_cast<int>(total);
+}
+
+int UringPty::read(char* buf, size_t size)
+{
+    for (;;)
+    {
+        auto const n = readAvailable(buf, size);
+        if (n != 0)
+            return n;
+
+        if (ioUringEnter(ring_, 0, 1, IORING_ENTER_GETEVENTS) < 0)
+            return -1;
+    }
+}
+
+}  // namespace terminal
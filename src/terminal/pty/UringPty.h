@@ -0,0 +1,103 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2020 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <terminal/pty/UnixPty.h>
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+struct io_uring_sqe;
+struct io_uring_cqe;
+
+namespace terminal {
+
+/// UnixPty reading the master end via io_uring (Linux 6.7 and later).
+///
+/// A single multishot read keeps filling buffers provided to the kernel for as long as the child
+/// process writes, such that no system call is made per read. Once all buffers are filled, the
+/// read ends, and is re-armed after they have been handed out, providing them all anew in the
+/// same system call. The io_uring's file descriptor is the readable handle, becoming readable
+/// when reads have completed.
+///
+/// Writing is done by UnixPty, as input comes in few bytes at a time.
+///
+/// Use UnixPty::create() to get one of these wherever the kernel supports it.
+class UringPty : public UnixPty
+{
+  public:
+    /// @returns whether or not the running kernel supports all that is used here.
+    static bool supported() noexcept;
+
+    /// @throws std::runtime_error if the io_uring cannot be set up, see supported().
+    explicit UringPty(Size const& windowSize,
+                      std::chrono::microseconds _readCoalescingLatency = DefaultReadCoalescingLatency);
+    ~UringPty() override;
+
+    int read(char* buf, size_t size) override;
+    NativeHandle readableHandle() const noexcept override { return ring_; }
+    int readAvailable(char* buf, size_t size) override;
+    void close() override;
+
+  private:
+    void closeRing();
+
+    /// Provides all buffers to the kernel and submits the multishot read, unless it is still active.
+    ///
+    /// @returns false if submitting failed.
+    bool armRead();
+
+    /// @returns the next free submission queue entry, cleared, to be submitted via submit().
+    io_uring_sqe& nextSubmission();
+
+    /// Submits the entries taken via nextSubmission().
+    ///
+    /// @returns false if submitting failed.
+    bool submit(unsigned _count);
+
+    /// Takes the next completion of the multishot read off the completion queue, if any.
+    ///
+    /// @returns false if there was none.
+    bool reapCompletion();
+
+    int ring_ = -1;
+
+    // the io_uring's queues, shared with the kernel
+    void* rings_ = nullptr;
+    size_t ringsSize_ = 0;
+    io_uring_sqe* sqes_ = nullptr;
+    size_t sqesSize_ = 0;
+    unsigned* sqTail_ = nullptr;
+    unsigned* sqArray_ = nullptr;
+    unsigned sqMask_ = 0;
+    unsigned* cqHead_ = nullptr;
+    unsigned* cqTail_ = nullptr;
+    io_uring_cqe* cqes_ = nullptr;
+    unsigned cqMask_ = 0;
+
+    // the buffers reads are placed into
+    std::unique_ptr<char[]> buffers_;
+
+    bool readArmed_ = false;    // the multishot read is active
+    bool readClosed_ = false;   // the multishot read ended for good, by EOF or error
+
+    // the buffer filled by the last completed read, being handed out
+    unsigned currentBuffer_ = 0;
+    size_t currentOffset_ = 0;
+    size_t currentSize_ = 0;
+};
+
+}  // namespace terminal
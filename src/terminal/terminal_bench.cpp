@@ -0,0 +1,533 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2020 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <terminal/Parser.h>
+#include <terminal/Process.h>
+#include <terminal/Screen.h>
+#include <terminal/ScreenEvents.h>
+#include <terminal/Search.h>
+#include <terminal/SessionRecording.h>
+#include <terminal/Terminal.h>
+#include <terminal/pty/MockPty.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <terminal/pty/UnixPty.h>
+#endif
+
+#if defined(LIBTERMINAL_IO_URING)
+#include <terminal/pty/UringPty.h>
+#endif
+
+#include <benchmark/benchmark.h>
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <limits>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+using namespace std;
+using namespace terminal;
+
+namespace
+{
+    // {{{ corpora
+    // All corpora are generated to be roughly of the same size, resembling typical output
+    // of the respective kind of application.
+    constexpr size_t CorpusSize = 4 * 1024 * 1024;
+
+    string const& asciiCorpus()
+    {
+        static string const corpus = []() {
+            string_view constexpr alphabet =
+                "ABCDEFGHIJKLMNOPQRSTUVWXYZ "
+                "abcdefghijklmnopqrstuvwxyz "
+                "0123456789 []{}();+-*/=";
+            string s;
+            for (size_t i = 0; s.size() < CorpusSize; ++i)
+            {
+                s += alphabet[i % alphabet.size()];
+                if (i % 79 == 78)
+                    s += "\r\n";
+            }
+            return s;
+        }();
+        return corpus;
+    }
+
+    string const& sgrCorpus()
+    {
+        static string const corpus = []() {
+            string s;
+            for (unsigned i = 0; s.size() < CorpusSize; ++i)
+            {
+                s += fmt::format("\033[{};38;5;{}mcolored\033[0m \033[48;2;{};{};{}mword\033[m ",
+                                 i % 2 ? 1 : 22, i % 256, i % 256, (i * 3) % 256, (i * 7) % 256);
+                if (i % 5 == 4)
+                    s += "\r\n";
+            }
+            return s;
+        }();
+        return corpus;
+    }
+
+    string const& unicodeCorpus()
+    {
+        static string const corpus = []() {
+            string s;
+            for (size_t i = 0; s.size() < CorpusSize; ++i)
+            {
+                s += "Grüße, 你好世界, こんにちは, \xF0\x9F\x98\x80 \xF0\x9F\x91\x8D\xF0\x9F\x8F\xBC ";
+                if (i % 2 == 1)
+                    s += "\r\n";
+            }
+            return s;
+        }();
+        return corpus;
+    }
+
+    string const& scrollRegionCorpus()
+    {
+        static string const corpus = []() {
+            string s;
+            for (size_t i = 0; s.size() < CorpusSize; ++i)
+            {
+                // set a scroll region, scroll it up and down, and reset it again.
+                s += "\033[5;20r\033[20;1H";
+                for (int k = 0; k < 10; ++k)
+                    s += fmt::format("scrolled line {}\r\n", k);
+                s += "\033[5;1H\033M\033M\033[3S\033[2T\033[r";
+            }
+            return s;
+        }();
+        return corpus;
+    }
+
+    string const& sixelCorpus()
+    {
+        static string const corpus = []() {
+            string s;
+            for (size_t i = 0; s.size() < CorpusSize; ++i)
+            {
+                s += "\033[H\033Pq\"1;1;64;12#0;2;100;0;0#1;2;0;100;0";
+                for (int band = 0; band < 2; ++band)
+                {
+                    s += "#0";
+                    s += string(32, '~');
+                    s += "#1";
+                    s += string(32, '~');
+                    s += '-';
+                }
+                s += "\033\\";
+            }
+            return s;
+        }();
+        return corpus;
+    }
+
+    string const& controlSequenceCorpus()
+    {
+        static string const corpus = []() {
+            string s;
+            for (size_t i = 0; s.size() < CorpusSize; ++i)
+            {
+                // Window titles and cursor motion without any text, such as shell prompts emit,
+                // keeping the parser outside of its ground state for most of the bytes.
+                s += fmt::format("\033]2;{}: ~/src/project\033\\\033[{};{}H\033[?2004h\033[K", i, i % 24 + 1, i % 80 + 1);
+            }
+            return s;
+        }();
+        return corpus;
+    }
+
+    string const& lineEditingCorpus()
+    {
+        static string const corpus = []() {
+            string s;
+            for (size_t i = 0; s.size() < CorpusSize; ++i)
+            {
+                // Keystrokes in the middle of a command line, as redrawn by line editors such as
+                // zsh or readline: inserting and deleting characters, and erasing the line's rest.
+                auto const column = i % 60 + 10;
+                s += fmt::format("\033[24;{}H\033[@x\033[24;{}H\033[P\033[2X\033[K{}\033[1K\033[2K",
+                                 column, column + 1, static_cast<char>('a' + i % 26));
+            }
+            return s;
+        }();
+        return corpus;
+    }
+
+    string const& fullscreenRedrawCorpus()
+    {
+        static string const corpus = []() {
+            string s;
+            for (size_t i = 0; s.size() < CorpusSize; ++i)
+            {
+                // Cursor-addressed full-screen redraw, as done by vim or htop.
+                s += "\033[?25l\033[H";
+                for (int row = 1; row <= 24; ++row)
+                    s += fmt::format("\033[{};1H\033[{}m{:>4} ~ redraw of row {} in frame {}\033[m\033[K",
+                                     row, 31 + row % 7, row, row, i);
+                s += "\033[24;1H\033[?25h";
+            }
+            return s;
+        }();
+        return corpus;
+    }
+
+    string const& cursorAddressingCorpus()
+    {
+        static string const corpus = []() {
+            string s;
+            for (size_t i = 0; s.size() < CorpusSize; ++i)
+            {
+                // Fields updated in place, as done by htop or ncurses dashboards: a cursor
+                // position for nearly every short run of text, all over the screen.
+                for (int row = 1; row <= 24; ++row)
+                    for (int field = 0; field < 6; ++field)
+                        s += fmt::format("\033[{};{}H{:>5}", row, 1 + field * 13, (i + static_cast<size_t>(row * field)) % 100000);
+            }
+            return s;
+        }();
+        return corpus;
+    }
+    // }}}
+
+    size_t countSequences(string_view _corpus)
+    {
+        return static_cast<size_t>(std::count(_corpus.begin(), _corpus.end(), '\033'));
+    }
+
+    void reportThroughput(benchmark::State& _state, string const& _corpus)
+    {
+        auto const iterations = static_cast<double>(_state.iterations());
+        _state.SetBytesProcessed(static_cast<int64_t>(_state.iterations()) * static_cast<int64_t>(_corpus.size()));
+        _state.counters["sequences"] = benchmark::Counter(
+            iterations * static_cast<double>(countSequences(_corpus)),
+            benchmark::Counter::kIsRate
+        );
+    }
+
+    /// Measures the VT parser alone.
+    void parserThroughput(benchmark::State& _state, string const& _corpus)
+    {
+        BasicParserEvents events;
+        auto parser = parser::Parser{events};
+
+        for (auto _ : _state)
+            parser.parseFragment(_corpus);
+
+        reportThroughput(_state, _corpus);
+    }
+
+    /// Measures the full pipeline of parser, sequencer and screen.
+    void screenThroughput(benchmark::State& _state, string const& _corpus)
+    {
+        MockScreenEvents events;
+        auto screen = Screen{
+            Size{80, 25},
+            events,
+            Logger{},
+            false, // logRaw
+            false, // logTrace
+            size_t{1000}
+        };
+
+        for (auto _ : _state)
+        {
+            screen.write(_corpus);
+            events.replyData.clear();
+        }
+
+        reportThroughput(_state, _corpus);
+    }
+
+    // {{{ recorded sessions
+    /// Measures the screen replaying a recorded session, without the terminal's threads.
+    void screenReplay(benchmark::State& _state, SessionRecording const& _recording)
+    {
+        MockScreenEvents events;
+        auto screen = Screen{
+            _recording.screenSize(),
+            events,
+            Logger{},
+            false, // logRaw
+            false, // logTrace
+            size_t{1000}
+        };
+
+        for (auto _ : _state)
+        {
+            for (SessionRecording::Chunk const& chunk : _recording.chunks())
+            {
+                if (chunk.kind == recording::ChunkKind::Output)
+                    screen.write(chunk.output);
+                else
+                    screen.resize(chunk.screenSize);
+            }
+            events.replyData.clear();
+        }
+
+        _state.SetBytesProcessed(static_cast<int64_t>(_state.iterations()) * static_cast<int64_t>(_recording.outputSize()));
+    }
+
+    /// Measures a terminal replaying a recorded session at maximum speed, from reading its
+    /// PTY through parsing, including the hand-off between the terminal's threads.
+    void terminalReplay(benchmark::State& _state, SessionRecording const& _recording)
+    {
+        Terminal::Events events;
+
+        for (auto _ : _state)
+        {
+            _state.PauseTiming();
+            auto pty = make_unique<MockPty>(_recording.screenSize());
+            auto& mockPty = *pty;
+            auto terminal = make_unique<Terminal>(move(pty), events, size_t{1000});
+            _state.ResumeTiming();
+
+            replay(_recording, *terminal, mockPty, ReplayPace::MaxSpeed);
+
+            _state.PauseTiming();
+            mockPty.close();
+            terminal.reset();
+            _state.ResumeTiming();
+        }
+
+        _state.SetBytesProcessed(static_cast<int64_t>(_state.iterations()) * static_cast<int64_t>(_recording.outputSize()));
+    }
+
+    /// Loads @p _recording into @p _screen, whose history keeps all lines scrolled off, packed into
+    /// pages of the page size given as the benchmark's argument.
+    void loadHistory(benchmark::State& _state, Screen& _screen, SessionRecording const& _recording)
+    {
+        _screen.setHistoryPaging(static_cast<size_t>(_state.range(0)), SavedLines::DefaultCachedPageCount);
+        for (SessionRecording::Chunk const& chunk : _recording.chunks())
+        {
+            if (chunk.kind == recording::ChunkKind::Output)
+                _screen.write(chunk.output);
+            else
+                _screen.resize(chunk.screenSize);
+        }
+    }
+
+    /// Measures scrolling through the history of a recorded session, from the most recent line
+    /// to the oldest one, for a given page size, and reports how well its pages are packed.
+    ///
+    /// Only one page is kept decoded, such that each page is decoded once per pass.
+    void historyScroll(benchmark::State& _state, SessionRecording const& _recording)
+    {
+        MockScreenEvents events;
+        auto screen = Screen{_recording.screenSize(), events};
+        loadHistory(_state, screen, _recording);
+        screen.setHistoryPaging(static_cast<size_t>(_state.range(0)), 1);
+
+        SavedLines const& savedLines = screen.scrollbackLines();
+        if (savedLines.packedLineCount() == 0)
+        {
+            _state.SkipWithError("too little history to be packed");
+            return;
+        }
+
+        auto unpackedSize = size_t{0};
+        for (size_t i = 0; i < savedLines.packedLineCount(); ++i)
+            unpackedSize += savedLines.at(i).size() * sizeof(Cell);
+
+        for (auto _ : _state)
+        {
+            for (size_t i = savedLines.size(); i > 0; --i)
+                benchmark::DoNotOptimize(savedLines.at(i - 1).wrapped);
+        }
+
+        auto const pageCount = (savedLines.packedLineCount() + savedLines.pageSize() - 1) / savedLines.pageSize();
+        _state.counters["page_decode"] = benchmark::Counter(
+            static_cast<double>(_state.iterations()) * static_cast<double>(pageCount),
+            benchmark::Counter::kIsRate | benchmark::Counter::kInvert
+        );
+        _state.counters["bytes_per_line"] =
+            static_cast<double>(savedLines.memoryUsage()) / static_cast<double>(savedLines.size());
+        _state.counters["compression_ratio"] =
+            static_cast<double>(unpackedSize) / static_cast<double>(savedLines.residentSize() + savedLines.spilledSize());
+    }
+
+    /// Measures searching the history of a recorded session for the text of a line half-way
+    /// through it, for a given page size.
+    void historySearch(benchmark::State& _state, SessionRecording const& _recording)
+    {
+        MockScreenEvents events;
+        auto screen = Screen{_recording.screenSize(), events};
+        loadHistory(_state, screen, _recording);
+
+        auto buffer = string{};
+        auto pattern = string(screen.lineText(screen.firstLineSerial() + screen.scrollbackLines().size() / 2, buffer));
+        pattern.resize(min(pattern.size(), size_t{16}));
+        if (pattern.empty())
+        {
+            _state.SkipWithError("no text to search for");
+            return;
+        }
+
+        for (auto _ : _state)
+        {
+            auto search = Search{screen, pattern, Search::Options{}};
+            while (!search.step(screen, numeric_limits<size_t>::max()))
+                ;
+            benchmark::DoNotOptimize(search.matches().size());
+        }
+
+        _state.SetItemsProcessed(static_cast<int64_t>(_state.iterations())
+                                 * static_cast<int64_t>(screen.lineSerialEnd() - screen.firstLineSerial()));
+    }
+
+    /// Registers the replay benchmarks for each of the session recordings listed in the
+    /// environment variable CONTOUR_BENCH_RECORDINGS, separated like PATH.
+    void registerRecordings()
+    {
+#if defined(_WIN32)
+        char constexpr Separator = ';';
+#else
+        char constexpr Separator = ':';
+#endif
+        static auto recordings = vector<unique_ptr<SessionRecording>>{};
+
+        auto const* paths = getenv("CONTOUR_BENCH_RECORDINGS");
+        auto list = string_view(paths ? paths : "");
+        while (!list.empty())
+        {
+            auto const end = min(list.find(Separator), list.size());
+            auto const path = string(list.substr(0, end));
+            list.remove_prefix(min(end + 1, list.size()));
+            if (path.empty())
+                continue;
+
+            auto recording = SessionRecording::open(path);
+            if (!recording)
+            {
+                fmt::print(stderr, "Skipping unreadable session recording: {}\n", path);
+                continue;
+            }
+            recordings.emplace_back(make_unique<SessionRecording>(move(*recording)));
+
+            auto const name = path.substr(path.find_last_of("/\\") + 1);
+            benchmark::RegisterBenchmark(("screenReplay/" + name).c_str(), screenReplay, *recordings.back());
+            benchmark::RegisterBenchmark(("terminalReplay/" + name).c_str(), terminalReplay, *recordings.back())
+                ->Unit(benchmark::kMillisecond)
+                ->UseRealTime();
+
+            // The page sizes to choose from, in lines, around SavedLines::DefaultPageSize.
+            benchmark::RegisterBenchmark(("historyScroll/" + name).c_str(), historyScroll, *recordings.back())
+                ->RangeMultiplier(2)
+                ->Range(64, 1024)
+                ->Unit(benchmark::kMillisecond);
+            benchmark::RegisterBenchmark(("historySearch/" + name).c_str(), historySearch, *recordings.back())
+                ->RangeMultiplier(2)
+                ->Range(64, 1024)
+                ->Unit(benchmark::kMillisecond);
+        }
+    }
+    // }}}
+
+#if defined(__unix__) || defined(__APPLE__)
+    /// Measures the time from spawning a shell in a new PTY until its first output arrives.
+    void timeToFirstOutput(benchmark::State& _state)
+    {
+        for (auto _ : _state)
+        {
+            auto pty = UnixPty{Size{80, 25}};
+            auto process = Process{"/bin/sh", {"-c", "echo ready"}, FileSystem::path{}, Process::Environment{}, pty};
+            char buffer[64];
+            while (pty.read(buffer, sizeof(buffer)) <= 0)
+                ;
+            (void) process.wait();
+        }
+    }
+
+    /// Measures reading CorpusSize bytes of output of a child process through a PTY of type
+    /// @p PtyType, such that the ways of reading can be compared.
+    template <typename PtyType>
+    void ptyThroughput(benchmark::State& _state)
+    {
+#if defined(LIBTERMINAL_IO_URING)
+        if constexpr (std::is_same_v<PtyType, UringPty>)
+        {
+            if (!UringPty::supported())
+            {
+                _state.SkipWithError("io_uring unsupported by the running kernel");
+                return;
+            }
+        }
+#endif
+
+        auto const command = fmt::format("head -c {} /dev/zero", CorpusSize);
+        auto buffer = vector<char>(64 * 1024);
+        for (auto _ : _state)
+        {
+            auto pty = PtyType{Size{80, 25}};
+            auto process = Process{"/bin/sh", {"-c", command}, FileSystem::path{}, Process::Environment{}, pty};
+            auto total = size_t{0};
+            while (total < CorpusSize)
+            {
+                auto const n = pty.read(buffer.data(), buffer.size());
+                if (n < 0)
+                    break;
+                total += static_cast<size_t>(n);
+            }
+            (void) process.wait();
+        }
+        _state.SetBytesProcessed(static_cast<int64_t>(_state.iterations() * CorpusSize));
+    }
+#endif
+}
+
+BENCHMARK_CAPTURE(parserThroughput, ascii, asciiCorpus());
+BENCHMARK_CAPTURE(parserThroughput, sgr, sgrCorpus());
+BENCHMARK_CAPTURE(parserThroughput, unicode, unicodeCorpus());
+BENCHMARK_CAPTURE(parserThroughput, scroll_region, scrollRegionCorpus());
+BENCHMARK_CAPTURE(parserThroughput, sixel, sixelCorpus());
+BENCHMARK_CAPTURE(parserThroughput, fullscreen_redraw, fullscreenRedrawCorpus());
+BENCHMARK_CAPTURE(parserThroughput, cursor_addressing, cursorAddressingCorpus());
+BENCHMARK_CAPTURE(parserThroughput, control_sequences, controlSequenceCorpus());
+BENCHMARK_CAPTURE(parserThroughput, line_editing, lineEditingCorpus());
+
+BENCHMARK_CAPTURE(screenThroughput, ascii, asciiCorpus());
+BENCHMARK_CAPTURE(screenThroughput, sgr, sgrCorpus());
+BENCHMARK_CAPTURE(screenThroughput, unicode, unicodeCorpus());
+BENCHMARK_CAPTURE(screenThroughput, scroll_region, scrollRegionCorpus());
+BENCHMARK_CAPTURE(screenThroughput, sixel, sixelCorpus());
+BENCHMARK_CAPTURE(screenThroughput, fullscreen_redraw, fullscreenRedrawCorpus());
+BENCHMARK_CAPTURE(screenThroughput, cursor_addressing, cursorAddressingCorpus());
+BENCHMARK_CAPTURE(screenThroughput, control_sequences, controlSequenceCorpus());
+BENCHMARK_CAPTURE(screenThroughput, line_editing, lineEditingCorpus());
+
+#if defined(__unix__) || defined(__APPLE__)
+BENCHMARK(timeToFirstOutput)->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(ptyThroughput, UnixPty)->Unit(benchmark::kMillisecond)->UseRealTime();
+#endif
+#if defined(LIBTERMINAL_IO_URING)
+BENCHMARK_TEMPLATE(ptyThroughput, UringPty)->Unit(benchmark::kMillisecond)->UseRealTime();
+#endif
+
+int main(int argc, char** argv)
+{
+    registerRecordings();
+
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv))
+        return 1;
+    benchmark::RunSpecifiedBenchmarks();
+    return 0;
+}
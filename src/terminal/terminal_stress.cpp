@@ -0,0 +1,239 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2020 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Feeds pathological VT input through parser, sequencer and screen, and verifies that the time
+// and memory taken grow no more than linearly with the size of the input.
+//
+// Usage: terminal_stress [--fuzz ITERATIONS [SEED]]
+//
+// Each pattern is written once at a base size and once at four times that size. The larger run
+// must take no more than Slack times four as long, and must not grow the screen's memory by more
+// than MemorySlack beyond the smaller run. The fuzz mode writes random chunks biased towards
+// control sequences instead, checking that the screen's memory stays below a fixed ceiling.
+//
+// Exits with a non-zero status if any of the checks fails.
+
+#include <terminal/Screen.h>
+#include <terminal/ScreenEvents.h>
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using namespace std;
+using namespace terminal;
+
+namespace
+{
+    constexpr size_t BaseSize = 1024 * 1024;
+    constexpr double Slack = 2.0;
+    constexpr size_t MemorySlack = 4 * 1024 * 1024;
+    constexpr size_t MemoryCeiling = 256 * 1024 * 1024;
+    constexpr size_t FuzzChunkSize = 64 * 1024;
+
+    struct Pattern {
+        string_view name;
+        std::function<string(size_t)> generate;
+    };
+
+    /// @returns @p _head, followed by @p _body repeated until at least @p _size bytes, and @p _tail.
+    string repeated(string_view _head, string_view _body, string_view _tail, size_t _size)
+    {
+        auto s = string(_head);
+        s.reserve(_size + _tail.size() + _body.size());
+        while (s.size() < _size)
+            s += _body;
+        s += _tail;
+        return s;
+    }
+
+    vector<Pattern> const& patterns()
+    {
+        static auto const list = vector<Pattern>{
+            {"csi_parameters", [](size_t n) { return repeated("\033[", ";", "m", n); }},
+            {"csi_sub_parameters", [](size_t n) { return repeated("\033[38", ":", "m", n); }},
+            {"csi_digits", [](size_t n) { return repeated("\033[", "9", "m", n); }},
+            {"csi_intermediates", [](size_t n) { return repeated("\033[", "!", "p", n); }},
+            {"osc_title", [](size_t n) { return repeated("\033]2;", "A", "\033\\", n); }},
+            {"osc_code", [](size_t n) { return repeated("\033]", "9", "\033\\", n); }},
+            {"osc_hyperlinks", [](size_t n) { return repeated("", "\033]8;;http://x\033\\y\033]8;;\033\\", "", n); }},
+            {"dcs_decrqss", [](size_t n) { return repeated("\033P$q", "m", "\033\\", n); }},
+            {"dcs_unknown", [](size_t n) { return repeated("\033Pz", "A", "\033\\", n); }},
+            {"sixel_repeat", [](size_t n) { return repeated("\033Pq#0;2;100;0;0", "!99999~", "\033\\", n); }},
+            {"sixel_raster", [](size_t n) { return repeated("\033Pq~", "\"1;1;640;480\"1;1;320;240", "\033\\", n); }},
+            {"sixel_parameters", [](size_t n) { return repeated("\033Pq#1", ";2", "\033\\", n); }},
+            {"sixel_newlines", [](size_t n) { return repeated("\033Pq", "~-", "\033\\", n); }},
+            {"sixel_images", [](size_t n) { return repeated("", "\033Pq#0;2;100;0;0~~~~\033\\", "", n); }},
+            {"title_stack", [](size_t n) { return repeated("", "\033[22;0t", "", n); }},
+            {"tab_stops", [](size_t n) { return repeated("", "\033H", "", n); }},
+            {"cursor_forward_tab", [](size_t n) { return repeated("", "\033[99999I", "", n); }},
+            {"cursor_backward_tab", [](size_t n) { return repeated("", "\033[99999Z", "", n); }},
+            {"combining", [](size_t n) { return repeated("e", "\xCC\x81", "", n); }},
+            {"long_line", [](size_t n) { return repeated("", "A", "", n); }},
+            {"newlines", [](size_t n) { return repeated("", "\n", "", n); }},
+            {"scroll_region", [](size_t n) { return repeated("\033[2;24r", "\033[24;1H\n\033M", "", n); }},
+            {"insert_delete", [](size_t n) { return repeated("", "\033[99999@\033[99999P\033[99999L\033[99999M", "", n); }},
+            {"synchronized_update", [](size_t n) { return repeated("\033[?2026h", "A\033[m", "", n); }},
+        };
+        return list;
+    }
+
+    struct Measurement {
+        double seconds;
+        size_t memory;
+    };
+
+    Screen makeScreen(MockScreenEvents& _events)
+    {
+        return Screen{
+            Size{80, 25},
+            _events,
+            Logger{},
+            false, // logRaw
+            false, // logTrace
+            size_t{1000}
+        };
+    }
+
+    Measurement measure(string const& _input)
+    {
+        MockScreenEvents events;
+        auto screen = makeScreen(events);
+
+        auto const start = chrono::steady_clock::now();
+        screen.write(_input);
+        auto const seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+        return Measurement{seconds, screen.memoryUsage().total()};
+    }
+
+    /// Runs all patterns, @returns the number of patterns failing.
+    int runPatterns()
+    {
+        fmt::print("{:<22} {:>12} {:>12} {:>8} {:>14} {:>14}\n",
+                   "pattern", "ns/byte", "ns/byte(4x)", "ratio", "memory", "memory(4x)");
+
+        int failures = 0;
+        for (Pattern const& pattern : patterns())
+        {
+            auto const small = pattern.generate(BaseSize);
+            auto const large = pattern.generate(4 * BaseSize);
+
+            // Warms up caches and lazily initialized tables, such that they do not count for the first run.
+            (void) measure(small);
+
+            auto const a = measure(small);
+            auto const b = measure(large);
+
+            auto const nsPerByteA = a.seconds * 1e9 / static_cast<double>(small.size());
+            auto const nsPerByteB = b.seconds * 1e9 / static_cast<double>(large.size());
+            auto const ratio = b.seconds / max(a.seconds, 1e-9);
+
+            auto const superlinear = ratio > 4.0 * Slack;
+            auto const unbounded = b.memory > a.memory + MemorySlack;
+
+            fmt::print("{:<22} {:>12.2f} {:>12.2f} {:>8.2f} {:>14} {:>14}{}{}\n",
+                       pattern.name, nsPerByteA, nsPerByteB, ratio, a.memory, b.memory,
+                       superlinear ? "  SUPERLINEAR" : "",
+                       unbounded ? "  UNBOUNDED" : "");
+
+            if (superlinear || unbounded)
+                ++failures;
+        }
+        return failures;
+    }
+
+    /// @returns a chunk of random input, mostly made of the bytes that start or continue
+    ///          control sequences, interspersed with fragments of the patterns.
+    string randomChunk(mt19937_64& _rng)
+    {
+        static string_view constexpr alphabet = "\033\033\033[[]P\\;;;:0123456789!\"#$?qmHItrM-~A \r\n\x07\x18";
+
+        auto s = string{};
+        s.reserve(FuzzChunkSize);
+        while (s.size() < FuzzChunkSize)
+        {
+            if (_rng() % 64 == 0)
+            {
+                auto const& pattern = patterns()[_rng() % patterns().size()];
+                s += pattern.generate(_rng() % 256);
+            }
+            else
+                s += alphabet[_rng() % alphabet.size()];
+        }
+        return s;
+    }
+
+    /// Writes @p _iterations random chunks, @returns non-zero if the memory ceiling was exceeded.
+    int runFuzz(size_t _iterations, uint64_t _seed)
+    {
+        fmt::print("Fuzzing {} chunks of {} bytes with seed {}.\n", _iterations, FuzzChunkSize, _seed);
+
+        MockScreenEvents events;
+        auto screen = makeScreen(events);
+        auto rng = mt19937_64{_seed};
+
+        double worstNsPerByte = 0.0;
+        size_t peakMemory = 0;
+        for (size_t i = 0; i < _iterations; ++i)
+        {
+            auto const chunk = randomChunk(rng);
+
+            auto const start = chrono::steady_clock::now();
+            screen.write(chunk);
+            auto const seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+            events.replyData.clear();
+
+            worstNsPerByte = max(worstNsPerByte, seconds * 1e9 / static_cast<double>(chunk.size()));
+            peakMemory = max(peakMemory, screen.memoryUsage().total());
+
+            if (peakMemory > MemoryCeiling)
+            {
+                fmt::print("Chunk {} exceeded the memory ceiling with {} bytes.\n", i, peakMemory);
+                return EXIT_FAILURE;
+            }
+        }
+
+        fmt::print("Worst chunk: {:.2f} ns/byte, peak memory: {} bytes.\n", worstNsPerByte, peakMemory);
+        return EXIT_SUCCESS;
+    }
+}
+
+int main(int argc, char const* argv[])
+{
+    if (argc >= 3 && string_view(argv[1]) == "--fuzz")
+    {
+        auto const iterations = static_cast<size_t>(strtoull(argv[2], nullptr, 10));
+        auto const seed = argc >= 4 ? strtoull(argv[3], nullptr, 10) : random_device{}();
+        return runFuzz(iterations, seed);
+    }
+
+    if (argc != 1)
+    {
+        fmt::print(stderr, "Usage: {} [--fuzz ITERATIONS [SEED]]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    auto const failures = runPatterns();
+    if (failures)
+        fmt::print("{} patterns failed.\n", failures);
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
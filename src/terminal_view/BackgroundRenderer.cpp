@@ -22,9 +22,11 @@
 
 namespace terminal::view {
 
-BackgroundRenderer::BackgroundRenderer(ScreenCoordinates const& _screenCoordinates,
+BackgroundRenderer::BackgroundRenderer(RenderMetrics& _renderMetrics,
+                                       ScreenCoordinates const& _screenCoordinates,
                                        RGBColor const& _defaultColor,
                                        OpenGLRenderer& _renderTarget) :
+    renderMetrics_{ _renderMetrics },
     screenCoordinates_{ _screenCoordinates },
     defaultColor_{ _defaultColor },
     renderTarget_{ _renderTarget }
@@ -33,7 +35,7 @@ BackgroundRenderer::BackgroundRenderer(ScreenCoordinates const& _screenCoordinat
 
 void BackgroundRenderer::renderCell(Coordinate const& _pos, RGBColor const& _color)
 {
-    if (row_ == _pos.row && color_ == _color)
+    if (row_ == _pos.row && color_ == _color && startColumn_ + static_cast<int>(columnCount_) == _pos.column)
         columnCount_++;
     else
     {
@@ -61,7 +63,10 @@ void BackgroundRenderer::renderOnce(Coordinate const& _pos, RGBColor const& _col
 void BackgroundRenderer::renderCellRange()
 {
     if (color_ == defaultColor_)
+    {
+        columnCount_ = 0;
         return;
+    }
 
     auto const pos = QPoint{screenCoordinates_.map(startColumn_, row_)};
 
@@ -70,13 +75,24 @@ void BackgroundRenderer::renderCellRange()
                                  static_cast<float>(color_.blue) / 255.0f,
                                  opacity_};
 
-    renderTarget_.renderRectangle(
-        static_cast<unsigned>(pos.x()),
-        static_cast<unsigned>(pos.y()),
-        screenCoordinates_.cellSize.width * columnCount_,
-        screenCoordinates_.cellSize.height,
-        color
-    );
+    if (output_)
+        OpenGLRenderer::makeRectangle(
+            *output_,
+            static_cast<unsigned>(pos.x()),
+            static_cast<unsigned>(pos.y()),
+            screenCoordinates_.cellSize.width * columnCount_,
+            screenCoordinates_.cellSize.height,
+            color
+        );
+    else
+        renderTarget_.renderRectangle(
+            static_cast<unsigned>(pos.x()),
+            static_cast<unsigned>(pos.y()),
+            screenCoordinates_.cellSize.width * columnCount_,
+            screenCoordinates_.cellSize.height,
+            color
+        );
+    renderMetrics_.cellBackgroundRenderCount++;
 
     columnCount_ = 0;
     startColumn_ = 0;
@@ -13,11 +13,13 @@
  */
 #pragma once
 
+#include <terminal_view/RenderMetrics.h>
 #include <terminal_view/ShaderConfig.h>
 
 #include <terminal/Screen.h>
 
 #include <memory>
+#include <vector>
 
 namespace terminal::view {
 
@@ -26,12 +28,18 @@ class OpenGLRenderer;
 
 class BackgroundRenderer {
   public:
-    /// Constructs the decoration renderer.
+    /// Constructs the background renderer.
     ///
+    /// Adjacent cells of the same background color are coalesced into a single rectangle,
+    /// whereas cells of the default background color are not rendered at all, as the
+    /// framebuffer is cleared with that color already.
+    ///
+    /// @param _renderMetrics metrics to count the rectangles rendered in
     /// @param _screenCoordinates
     /// @param _defaultColor
     /// @param _renderTarget
-    BackgroundRenderer(ScreenCoordinates const& _screenCoordinates,
+    BackgroundRenderer(RenderMetrics& _renderMetrics,
+                       ScreenCoordinates const& _screenCoordinates,
                        RGBColor const& _defaultColor,
                        OpenGLRenderer& _renderTarget);
 
@@ -39,6 +47,13 @@ class BackgroundRenderer {
 
     constexpr void setOpacity(float _value) noexcept { opacity_ = _value; }
 
+    RGBColor const& defaultColor() const noexcept { return defaultColor_; }
+    constexpr float opacity() const noexcept { return opacity_; }
+
+    /// Makes the rectangles into @p _instances (see OpenGLRenderer::makeRectangle()) if given,
+    /// rather than rendering them, such that rows can be rendered by other threads.
+    void setOutput(std::vector<float>* _instances) noexcept { output_ = _instances; }
+
     // TODO: pass background color directly (instead of whole grid cell),
     // because there is no need to detect bg/fg color more than once per grid cell!
 
@@ -54,6 +69,7 @@ class BackgroundRenderer {
     void renderCellRange();
 
   private:
+    RenderMetrics& renderMetrics_;
     ScreenCoordinates const& screenCoordinates_;
     RGBColor defaultColor_;
     float opacity_ = 1.0f; // normalized opacity value between 0.0 .. 1.0
@@ -66,6 +82,7 @@ class BackgroundRenderer {
 
     // rendering
     OpenGLRenderer& renderTarget_;
+    std::vector<float>* output_ = nullptr;
 };
 
 } // end namespace
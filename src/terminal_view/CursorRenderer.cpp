@@ -13,163 +13,62 @@
  */
 #include <terminal_view/CursorRenderer.h>
 
-#include <QtCore/QSize>
+#include <algorithm>
 
-#include <QtGui/QOpenGLFunctions> // for GL_RED
-
-#include <stdexcept>
-#include <vector>
-
-using std::get;
 using std::max;
-using std::nullopt;
-using std::optional;
-using std::runtime_error;
-using std::string;
 
 namespace terminal::view {
 
-CursorRenderer::CursorRenderer(crispy::atlas::CommandListener& _commandListener,
-                               crispy::atlas::TextureAtlasAllocator& _monochromeTextureAtlas,
+CursorRenderer::CursorRenderer(OpenGLRenderer& _renderTarget,
                                ScreenCoordinates const& _screenCoordinates,
                                CursorShape _shape,
                                QVector4D const& _color) :
-    commandListener_{ _commandListener },
-    textureAtlas_{ _monochromeTextureAtlas },
+    renderTarget_{ _renderTarget },
     screenCoordinates_{ _screenCoordinates },
     shape_{ _shape },
-    color_{ _color },
-    columnWidth_{ 1 }
-{
-}
-
-void CursorRenderer::setShape(CursorShape _shape)
-{
-    if (_shape != shape_)
-    {
-        shape_ = _shape;
-        rebuild();
-    }
-}
-
-void CursorRenderer::setColor(QVector4D const& _color)
+    color_{ _color }
 {
-    color_ = _color;
 }
 
-void CursorRenderer::clearCache()
-{
-    textureAtlas_.clear();
-}
-
-void CursorRenderer::rebuild()
+void CursorRenderer::render(QPoint _pos, int _columnWidth)
 {
-    clearCache();
-
-    auto const width = screenCoordinates_.cellSize.width * columnWidth_;
+    auto const x = _pos.x();
+    auto const y = _pos.y();
+    auto const width = screenCoordinates_.cellSize.width * _columnWidth;
+    auto const height = screenCoordinates_.cellSize.height;
     auto const baseline = screenCoordinates_.textBaseline;
     auto constexpr LineThickness = 1;
 
-    { // {{{ CursorShape::Block
-        auto const height = screenCoordinates_.cellSize.height;
-        auto image = crispy::atlas::Buffer(width * height, 0xFFu);
-
-        textureAtlas_.insert(
-            CursorShape::Block,
-            width, height,
-            width, height,
-            GL_RED,
-            move(image)
-        );
-    } // }}}
-    { // {{{ CursorShape::Underscore
-        auto const thickness = max(LineThickness * baseline / 3, 1);
-        auto const height = baseline;
-        auto const base_y = max((height - thickness) / 2, 0);
-        auto image = crispy::atlas::Buffer(width * height, 0);
-
-        for (int y = 1; y <= thickness; ++y)
-            for (int x = 0; x < width; ++x)
-                image[(base_y + y) * width + x] = 0xFF;
-
-        textureAtlas_.insert(
-            CursorShape::Underscore,
-            width, height,
-            width, height,
-            GL_RED,
-            move(image)
-        );
-    } // }}}
-    { // {{{ CursorShape::Bar
-        auto const thickness = max(LineThickness * baseline / 3, 1);
-        auto const height = screenCoordinates_.cellSize.height;
-        //auto const base_y = max((height - thickness) / 2, 0);
-        auto image = crispy::atlas::Buffer(width * height, 0);
-
-        for (int x = 0; x < thickness; ++x)
-            for (int y = 0; y < height; ++y)
-                image[y * width + x] = 0xFF;
-
-        textureAtlas_.insert(
-            CursorShape::Bar,
-            width, height,
-            width, height,
-            GL_RED,
-            move(image)
-        );
-    } // }}}
-    { // {{{ CursorShape::Rectangle
-        auto const height = screenCoordinates_.cellSize.height;
-        auto image = crispy::atlas::Buffer(width * height, 0xFFu);
-        auto const thickness = max(width / 12, 1);
-
-        auto const innerWidth = width - 2 * thickness;
-        auto const innerHeight = height - 2 * thickness;
-
-        for (int y = thickness; y <= innerHeight; ++y)
-            for (int x = thickness; x <= innerWidth; ++x)
-                image[y * width + x] = 0;
-
-        textureAtlas_.insert(
-            CursorShape::Rectangle,
-            width, height,
-            width, height,
-            GL_RED,
-            move(image)
-        );
-    } // }}}
-}
-
-optional<CursorRenderer::DataRef> CursorRenderer::getDataRef(CursorShape _shape)
-{
-    if (optional<DataRef> const dataRef = textureAtlas_.get(_shape); dataRef.has_value())
-        return dataRef;
-
-    if (textureAtlas_.empty())
-        rebuild();
-
-    if (optional<DataRef> const dataRef = textureAtlas_.get(_shape); dataRef.has_value())
-        return dataRef;
-
-    return nullopt;
-}
-
-void CursorRenderer::render(QPoint _pos, int _columnWidth)
-{
-    if (columnWidth_ != _columnWidth)
-    {
-        // XXX we could optimize here  by keying for (shape, columnWidth) and just cache them all, but that's a minor.
-        columnWidth_ = _columnWidth;
-        rebuild();
-    }
+    renderTarget_.setCursorColor(color_);
 
-    if (optional<DataRef> const dataRef = getDataRef(shape_); dataRef.has_value())
+    switch (shape_)
     {
-        auto const& textureInfo = get<0>(dataRef.value()).get();
-        auto const x = _pos.x();
-        auto const y = _pos.y();
-        auto constexpr z = 0;
-        commandListener_.renderTexture({textureInfo, x, y, z, color_});
+        case CursorShape::Block:
+            renderTarget_.renderCursorRectangle(x, y, width, height);
+            break;
+        case CursorShape::Underscore:
+        {
+            auto const thickness = max(LineThickness * baseline / 3, 1);
+            auto const base_y = max((baseline - thickness) / 2, 0);
+            renderTarget_.renderCursorRectangle(x, y + base_y + 1, width, thickness);
+            break;
+        }
+        case CursorShape::Bar:
+        {
+            auto const thickness = max(LineThickness * baseline / 3, 1);
+            renderTarget_.renderCursorRectangle(x, y, thickness, height);
+            break;
+        }
+        case CursorShape::Rectangle:
+        {
+            auto const thickness = max(width / 12, 1);
+            auto const innerHeight = max(height - 2 * thickness, 0);
+            renderTarget_.renderCursorRectangle(x, y, width, thickness);
+            renderTarget_.renderCursorRectangle(x, y + height - thickness, width, thickness);
+            renderTarget_.renderCursorRectangle(x, y + thickness, thickness, innerHeight);
+            renderTarget_.renderCursorRectangle(x + width - thickness, y + thickness, thickness, innerHeight);
+            break;
+        }
     }
 }
 
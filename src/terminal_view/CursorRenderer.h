@@ -13,46 +13,37 @@
  */
 #pragma once
 
+#include <terminal_view/OpenGLRenderer.h>
 #include <terminal_view/ScreenCoordinates.h>
 
-#include <crispy/Atlas.h>
-
 #include <QtCore/QPoint>
 #include <QtGui/QVector4D>
 
 namespace terminal::view {
 
 /// Takes care of rendering the text cursor.
+///
+/// The cursor's shape is made of filled rectangles, drawn in the render target's cursor pass,
+/// which blinks and moves the cursor by itself.
 class CursorRenderer {
   public:
-    CursorRenderer(crispy::atlas::CommandListener& _commandListener,
-                   crispy::atlas::TextureAtlasAllocator& _monochromeTextureAtlas,
+    CursorRenderer(OpenGLRenderer& _renderTarget,
                    ScreenCoordinates const& _screenCoordinates,
                    CursorShape _shape,
                    QVector4D const& _color);
 
     CursorShape shape() const noexcept { return shape_; }
-    void setShape(CursorShape _shape);
-    void setColor(QVector4D const& _color);
+    void setShape(CursorShape _shape) noexcept { shape_ = _shape; }
+    void setColor(QVector4D const& _color) noexcept { color_ = _color; }
 
     void render(QPoint _pos, int _columnWidth);
-    void clearCache();
-
-  private:
-    using TextureAtlas = crispy::atlas::MetadataTextureAtlas<CursorShape, int>;
-    using DataRef = TextureAtlas::DataRef;
-
-    void rebuild();
-    std::optional<DataRef> getDataRef(CursorShape _shape);
 
   private:
-    crispy::atlas::CommandListener& commandListener_;
-    TextureAtlas textureAtlas_;
+    OpenGLRenderer& renderTarget_;
     ScreenCoordinates const& screenCoordinates_;
 
     CursorShape shape_;
     QVector4D color_;
-    int columnWidth_;
 };
 
 } // namespace terminal::view
@@ -26,6 +26,7 @@
 using std::array;
 using std::get;
 using std::max;
+using std::move;
 using std::nullopt;
 using std::optional;
 using std::pair;
@@ -35,6 +36,24 @@ namespace atlas = crispy::atlas;
 
 namespace terminal::view {
 
+namespace
+{
+    /// @returns whether or not the decoration looks the same in every pixel column of a cell.
+    constexpr bool isHorizontallyUniform(Decorator _decorator) noexcept
+    {
+        switch (_decorator)
+        {
+            case Decorator::Underline:
+            case Decorator::DoubleUnderline:
+            case Decorator::Overline:
+            case Decorator::CrossedOut:
+                return true;
+            default:
+                return false;
+        }
+    }
+}
+
 optional<Decorator> to_decorator(std::string const& _value)
 {
     auto constexpr mappings = array{
@@ -78,6 +97,7 @@ DecorationRenderer::DecorationRenderer(atlas::CommandListener& _commandListener,
 
 void DecorationRenderer::clearCache()
 {
+    stretchedTextures_.clear();
     atlas_.clear();
 }
 
@@ -261,17 +281,19 @@ void DecorationRenderer::rebuild()
 }
 
 void DecorationRenderer::renderCell(Coordinate const& _pos,
-                                    Cell const& _cell)
+                                    Cell const& _cell,
+                                    int _columnCount)
 {
+    auto present = array<bool, DecoratorCount>{};
+
     if (_cell.hyperlink())
     {
-        auto const& color = _cell.hyperlink()->state == HyperlinkState::Hover
-                            ? colorProfile_.hyperlinkDecoration.hover
-                            : colorProfile_.hyperlinkDecoration.normal;
-        auto const decoration = _cell.hyperlink()->state == HyperlinkState::Hover
-                            ? hyperlinkHover_
-                            : hyperlinkNormal_;
-        renderDecoration(decoration, _pos, 1, color);
+        auto const hovered = _cell.hyperlink() == hoveredHyperlink_;
+        auto const& color = hovered ? colorProfile_.hyperlinkDecoration.hover
+                                    : colorProfile_.hyperlinkDecoration.normal;
+        auto const decoration = hovered ? hyperlinkHover_ : hyperlinkNormal_;
+        extendRun(decoration, _pos, _columnCount, color);
+        present[static_cast<size_t>(decoration)] = true;
     }
     else
     {
@@ -284,8 +306,13 @@ void DecorationRenderer::renderCell(Coordinate const& _pos,
         };
 
         for (auto const& mapping : underlineMappings)
+        {
             if (_cell.attributes().styles & mapping.first)
-                renderDecoration(mapping.second, _pos, 1, _cell.attributes().getUnderlineColor(colorProfile_));
+            {
+                extendRun(mapping.second, _pos, _columnCount, _cell.attributes().getUnderlineColor(colorProfile_));
+                present[static_cast<size_t>(mapping.second)] = true;
+            }
+        }
     }
 
     auto constexpr supplementalMappings = array{
@@ -296,8 +323,90 @@ void DecorationRenderer::renderCell(Coordinate const& _pos,
     };
 
     for (auto const& mapping : supplementalMappings)
+    {
         if (_cell.attributes().styles & mapping.first)
-            renderDecoration(mapping.second, _pos, 1, _cell.attributes().getUnderlineColor(colorProfile_));
+        {
+            extendRun(mapping.second, _pos, _columnCount, _cell.attributes().getUnderlineColor(colorProfile_));
+            present[static_cast<size_t>(mapping.second)] = true;
+        }
+    }
+
+    // Runs not continued by this cell are complete.
+    for (size_t i = 0; i < DecoratorCount; ++i)
+        if (!present[i] && runs_[i].columnCount)
+            renderRun(static_cast<Decorator>(i));
+}
+
+void DecorationRenderer::renderPendingCells()
+{
+    for (size_t i = 0; i < DecoratorCount; ++i)
+        if (runs_[i].columnCount)
+            renderRun(static_cast<Decorator>(i));
+}
+
+void DecorationRenderer::extendRun(Decorator _decorator,
+                                   Coordinate const& _pos,
+                                   int _columnCount,
+                                   RGBColor const& _color)
+{
+    Run& run = runs_[static_cast<size_t>(_decorator)];
+    if (run.columnCount
+            && run.row == _pos.row
+            && run.startColumn + run.columnCount == _pos.column
+            && run.color == _color)
+    {
+        run.columnCount += _columnCount;
+        return;
+    }
+
+    if (run.columnCount)
+        renderRun(_decorator);
+
+    run = Run{_pos.row, _pos.column, _columnCount, _color};
+}
+
+void DecorationRenderer::renderRun(Decorator _decorator)
+{
+    Run& run = runs_[static_cast<size_t>(_decorator)];
+    renderDecoration(_decorator, Coordinate{run.row, run.startColumn}, run.columnCount, run.color);
+    run.columnCount = 0;
+}
+
+atlas::TextureInfo const& DecorationRenderer::stretchedTexture(Decorator _decorator,
+                                                               atlas::TextureInfo const& _texture,
+                                                               int _columnCount)
+{
+    // Only the middle pixel column is sampled, such that no neighboring texels bleed in at the ends.
+    auto const middle = _texture.width / 2;
+
+    // Decorations evicted from the atlas are inserted elsewhere again.
+    auto const key = pair{_decorator, _columnCount};
+    if (auto const i = stretchedTextures_.find(key); i != stretchedTextures_.end())
+    {
+        atlas::TextureInfo const& texture = i->second;
+        if (texture.atlas == _texture.atlas && texture.x == _texture.x + middle
+                && texture.y == _texture.y && texture.z == _texture.z)
+            return texture;
+    }
+
+    auto const scaleX = _texture.relativeWidth / static_cast<float>(_texture.width);
+    auto texture = atlas::TextureInfo{
+        _texture.atlas,
+        _texture.atlasName,
+        _texture.x + middle,
+        _texture.y,
+        _texture.z,
+        1,
+        _texture.height,
+        _texture.targetWidth * static_cast<unsigned>(_columnCount),
+        _texture.targetHeight,
+        _texture.relativeX + static_cast<float>(middle) * scaleX,
+        _texture.relativeY,
+        scaleX,
+        _texture.relativeHeight,
+        _texture.user
+    };
+    return stretchedTextures_.insert_or_assign(key, move(texture)).first->second;
 }
 
 optional<DecorationRenderer::DataRef> DecorationRenderer::getDataRef(Decorator _decoration)
@@ -342,6 +451,13 @@ void DecorationRenderer::renderDecoration(Decorator _decoration,
             1.0f
         );
         atlas::TextureInfo const& textureInfo = get<0>(dataRef.value()).get();
+        if (isHorizontallyUniform(_decoration) && _columnCount > 1)
+        {
+            commandListener_.renderTexture({stretchedTexture(_decoration, textureInfo, _columnCount), x, y, z, color});
+            return;
+        }
+
+        // Patterns are repeated per cell.
         auto const advanceX = static_cast<int>(screenCoordinates_.cellSize.width);
         for (int i = 0; i < static_cast<int>(_columnCount); ++i)
         {
@@ -20,6 +20,10 @@
 
 #include <terminal/Screen.h>
 
+#include <array>
+#include <map>
+#include <utility>
+
 namespace terminal::view {
 
 struct ScreenCoordinates;
@@ -51,6 +55,9 @@ enum class Decorator {
     Encircle,
 };
 
+/// Number of Decorator values.
+constexpr size_t DecoratorCount = static_cast<size_t>(Decorator::Encircle) + 1;
+
 std::optional<Decorator> to_decorator(std::string const& _value);
 
 /// Renders any kind of grid cell decorations, ranging from basic underline to surrounding boxes.
@@ -84,7 +91,17 @@ class DecorationRenderer {
         hyperlinkHover_ = _hover;
     }
 
-    void renderCell(Coordinate const& _pos, Cell const& _cell);
+    /// Sets the hyperlink to be decorated as hovered by the cells referring to it, or 0 for none.
+    void setHoveredHyperlink(HyperlinkId _hyperlink) noexcept { hoveredHyperlink_ = _hyperlink; }
+
+    /// Queues up the decorations of @p _cell, spanning @p _columnCount columns starting at @p _pos.
+    ///
+    /// Adjacent cells of the same decoration and color are coalesced into runs, which are rendered
+    /// once interrupted or by renderPendingCells().
+    void renderCell(Coordinate const& _pos, Cell const& _cell, int _columnCount = 1);
+
+    /// Renders all runs of decorations queued up so far.
+    void renderPendingCells();
 
     void renderDecoration(Decorator _decoration,
                           Coordinate const& _pos,
@@ -98,15 +115,38 @@ class DecorationRenderer {
     using DataRef = Atlas::DataRef;
     using AtlasRenderer = crispy::atlas::Renderer;
 
+    /// A run of adjacent cells with the same decoration and color.
+    struct Run {
+        int row = 0;
+        int startColumn = 0;
+        int columnCount = 0;
+        RGBColor color{};
+    };
+
     void rebuild();
 
     std::optional<DataRef> getDataRef(Decorator _decorator);
 
+    /// Extends the pending run of @p _decorator by the given cells, or renders it and starts a new one.
+    void extendRun(Decorator _decorator, Coordinate const& _pos, int _columnCount, RGBColor const& _color);
+
+    /// Renders the pending run of @p _decorator, if any.
+    void renderRun(Decorator _decorator);
+
+    /// @returns the texture of @p _decorator stretched across @p _columnCount cells.
+    ///
+    /// Only decorations that do not change horizontally within a cell can be stretched, whereas
+    /// all others are rendered by repeating their texture per cell.
+    crispy::atlas::TextureInfo const& stretchedTexture(Decorator _decorator,
+                                                       crispy::atlas::TextureInfo const& _texture,
+                                                       int _columnCount);
+
   private:
     ScreenCoordinates const& screenCoordinates_;
 
     Decorator hyperlinkNormal_ = Decorator::DottedUnderline;
     Decorator hyperlinkHover_ = Decorator::Underline;
+    HyperlinkId hoveredHyperlink_ = 0;
     int lineThickness_ = 1;
     float curlyAmplitude_ = 1.0f;
     float curlyFrequency_ = 1.0f;
@@ -115,6 +155,9 @@ class DecorationRenderer {
 
     crispy::atlas::CommandListener& commandListener_;
     Atlas atlas_;
+
+    std::array<Run, DecoratorCount> runs_{}; // runs pending to be rendered, indexed by Decorator
+    std::map<std::pair<Decorator, int>, crispy::atlas::TextureInfo> stretchedTextures_; // keyed by column count
 };
 
 } // end namespace
@@ -0,0 +1,333 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2020 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <terminal_view/GlyphCache.h>
+
+#include <crispy/FNV.h>
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+using std::make_pair;
+using std::make_unique;
+using std::move;
+using std::nullopt;
+using std::optional;
+using std::string;
+using std::unordered_map;
+using std::vector;
+
+using crispy::text::Font;
+using crispy::text::GlyphBitmap;
+
+namespace terminal::view {
+
+namespace
+{
+    // Cache file layout: FileHeader, followed by FileHeader::count Records, followed by the bitmaps.
+    auto constexpr FileMagic = uint32_t{0x46594c47}; // "GLYF"
+    auto constexpr FileVersion = uint32_t{2};
+
+    // Glyphs are no longer added to a file once it reached this size.
+    auto constexpr MaxFileSize = size_t{32} * 1024 * 1024;
+
+    // Number of leading bytes of a font file that are fingerprinted. These contain the table
+    // directory, including the checksums of all tables.
+    auto constexpr FingerprintedBytes = size_t{64} * 1024;
+
+    struct FileHeader {
+        uint32_t magic;
+        uint32_t version;
+        uint64_t key;
+        uint32_t count;
+        uint32_t reserved;
+    };
+    static_assert(sizeof(FileHeader) == 24);
+
+    auto constexpr fnv = crispy::FNV<uint64_t>{1099511628211llu, 14695981039346656037llu};
+
+    /// @returns 64-bit FNV-1a hash of the given bytes, continuing from @p _hash.
+    uint64_t hashBytes(uint64_t _hash, uint8_t const* _data, size_t _size) noexcept
+    {
+        for (size_t i = 0; i < _size; ++i)
+            _hash = fnv(_hash, _data[i]);
+        return _hash;
+    }
+
+    /// @returns a key identifying the glyphs rasterized from @p _font, or std::nullopt if the
+    ///          font file could not be read.
+    optional<uint64_t> cacheKey(Font& _font)
+    {
+        auto file = std::ifstream(_font.filePath(), std::ios::binary | std::ios::ate);
+        if (!file.good())
+            return nullopt;
+
+        auto const fileSize = static_cast<uint64_t>(file.tellg());
+        auto head = vector<uint8_t>(std::min(static_cast<size_t>(fileSize), FingerprintedBytes));
+        file.seekg(0);
+        file.read(reinterpret_cast<char*>(head.data()), static_cast<std::streamsize>(head.size()));
+        if (!file.good())
+            return nullopt;
+
+        // Glyph bitmaps are rendered upside down unless rendering in natural coordinates.
+#if defined(LIBTERMINAL_VIEW_NATURAL_COORDS) && LIBTERMINAL_VIEW_NATURAL_COORDS
+        auto constexpr naturalCoords = uint64_t{1};
+#else
+        auto constexpr naturalCoords = uint64_t{0};
+#endif
+
+        auto hash = uint64_t{14695981039346656037llu};
+        hash = hashBytes(hash, head.data(), head.size());
+        hash = fnv(hash, fileSize);
+        hash = fnv(hash, static_cast<uint64_t>(_font.fontSize()));
+        hash = fnv(hash, _font.hasColor() ? uint64_t{1} : uint64_t{0});
+        hash = fnv(hash, naturalCoords);
+        return fnv(hash, FileVersion);
+    }
+}
+
+struct GlyphCache::Record {
+    uint32_t glyphIndex;
+    uint32_t hasBitmap;
+    int32_t advance;
+    int32_t bitmapLeft;
+    int32_t bitmapTop;
+    int32_t metricsHeight;
+    int32_t faceHeight;
+    uint32_t width;
+    uint32_t rows;
+    int32_t bitmapWidth;
+    int32_t bitmapHeight;
+    uint32_t size;      // number of bytes of the bitmap
+    uint64_t offset;    // file offset of the bitmap
+};
+
+struct GlyphCache::Face {
+    optional<uint64_t> key;                          // std::nullopt if the font file can not be cached
+    FileSystem::path path;
+    optional<crispy::mapped_file> file;
+    unordered_map<unsigned, Record const*> records;  // glyphs of the cache file
+    vector<RasterizedGlyph> added;                   // glyphs inserted since the last flush
+    unordered_map<unsigned, size_t> addedIndex;      // indices into added
+    size_t size = 0;                                 // file size including added glyphs
+};
+
+GlyphCache::GlyphCache(FileSystem::path _directory) :
+    directory_{ move(_directory) }
+{
+}
+
+GlyphCache::~GlyphCache()
+{
+    flush();
+}
+
+void GlyphCache::setDirectory(FileSystem::path _directory)
+{
+    flush();
+    faces_.clear();
+    directory_ = move(_directory);
+}
+
+optional<RasterizedGlyph> GlyphCache::find(Font& _font, unsigned _glyphIndex)
+{
+    if (!enabled())
+        return nullopt;
+
+    Face& face = this->face(_font);
+
+    if (auto const i = face.addedIndex.find(_glyphIndex); i != face.addedIndex.end())
+    {
+        ++hits_;
+        auto glyph = face.added[i->second];
+        glyph.font = &_font;
+        return glyph;
+    }
+
+    auto const i = face.records.find(_glyphIndex);
+    if (i == face.records.end())
+    {
+        ++misses_;
+        return nullopt;
+    }
+
+    ++hits_;
+    Record const& record = *i->second;
+    auto glyph = RasterizedGlyph{};
+    glyph.font = &_font;
+    glyph.glyphIndex = _glyphIndex;
+    glyph.advance = record.advance;
+    glyph.bitmapLeft = record.bitmapLeft;
+    glyph.bitmapTop = record.bitmapTop;
+    glyph.metricsHeight = record.metricsHeight;
+    glyph.faceHeight = record.faceHeight;
+    glyph.width = record.width;
+    glyph.rows = record.rows;
+    if (record.hasBitmap)
+    {
+        auto const* data = face.file->data() + record.offset;
+        glyph.bitmap = GlyphBitmap{
+            record.bitmapWidth,
+            record.bitmapHeight,
+            vector<uint8_t>(data, data + record.size)
+        };
+    }
+    return glyph;
+}
+
+void GlyphCache::insert(Font& _font, RasterizedGlyph const& _glyph)
+{
+    if (!enabled())
+        return;
+
+    Face& face = this->face(_font);
+    if (!face.key.has_value()
+            || face.records.count(_glyph.glyphIndex)
+            || face.addedIndex.count(_glyph.glyphIndex))
+        return;
+
+    auto const bytes = sizeof(Record) + (_glyph.bitmap.has_value() ? _glyph.bitmap->buffer.size() : 0);
+    if (face.size + bytes > MaxFileSize)
+        return;
+
+    face.size += bytes;
+    face.addedIndex[_glyph.glyphIndex] = face.added.size();
+    face.added.emplace_back(_glyph);
+}
+
+void GlyphCache::flush()
+{
+    for (auto& [_, face] : faces_)
+        if (!face->added.empty())
+            write(*face);
+}
+
+GlyphCache::Face& GlyphCache::face(Font& _font)
+{
+    auto& face = faces_[make_pair(_font.filePath(), _font.fontSize())];
+    if (face)
+        return *face;
+
+    face = make_unique<Face>();
+    face->key = cacheKey(_font);
+    if (face->key.has_value())
+    {
+        face->path = directory_ / fmt::format("glyphs-{:016x}.bin", *face->key);
+        load(*face);
+    }
+    return *face;
+}
+
+void GlyphCache::load(Face& _face)
+{
+    static_assert(sizeof(Record) == 56, "Records are mapped from files and must not change in layout.");
+
+    _face.records.clear();
+    _face.size = sizeof(FileHeader);
+    _face.file = crispy::mapped_file::open(_face.path.string());
+    if (!_face.file.has_value())
+        return;
+
+    auto const* data = _face.file->data();
+    auto const size = _face.file->size();
+
+    auto const* header = reinterpret_cast<FileHeader const*>(data);
+    if (size < sizeof(FileHeader)
+            || header->magic != FileMagic
+            || header->version != FileVersion
+            || header->key != *_face.key
+            || size < sizeof(FileHeader) + static_cast<size_t>(header->count) * sizeof(Record))
+    {
+        _face.file.reset();
+        return;
+    }
+
+    // A record pointing outside of the file renders the whole file invalid.
+    auto const* records = reinterpret_cast<Record const*>(data + sizeof(FileHeader));
+    for (uint32_t i = 0; i < header->count; ++i)
+    {
+        Record const& record = records[i];
+        if (record.offset > size || record.size > size - record.offset)
+        {
+            _face.records.clear();
+            _face.file.reset();
+            return;
+        }
+        _face.records[record.glyphIndex] = &record;
+    }
+
+    _face.size = size;
+}
+
+void GlyphCache::write(Face& _face)
+{
+    auto const count = _face.records.size() + _face.added.size();
+    auto records = vector<Record>{};
+    records.reserve(count);
+
+    auto bitmaps = vector<uint8_t>{};
+    auto const dataOffset = sizeof(FileHeader) + count * sizeof(Record);
+
+    for (auto const& [glyphIndex, record] : _face.records)
+    {
+        auto& copy = records.emplace_back(*record);
+        copy.offset = dataOffset + bitmaps.size();
+        auto const* data = _face.file->data() + record->offset;
+        bitmaps.insert(bitmaps.end(), data, data + record->size);
+    }
+
+    for (RasterizedGlyph const& glyph : _face.added)
+    {
+        auto& record = records.emplace_back(Record{});
+        record.glyphIndex = glyph.glyphIndex;
+        record.hasBitmap = glyph.bitmap.has_value() ? 1 : 0;
+        record.advance = glyph.advance;
+        record.bitmapLeft = glyph.bitmapLeft;
+        record.bitmapTop = glyph.bitmapTop;
+        record.metricsHeight = glyph.metricsHeight;
+        record.faceHeight = glyph.faceHeight;
+        record.width = glyph.width;
+        record.rows = glyph.rows;
+        record.offset = dataOffset + bitmaps.size();
+        if (glyph.bitmap.has_value())
+        {
+            record.bitmapWidth = glyph.bitmap->width;
+            record.bitmapHeight = glyph.bitmap->height;
+            record.size = static_cast<uint32_t>(glyph.bitmap->buffer.size());
+            bitmaps.insert(bitmaps.end(), glyph.bitmap->buffer.begin(), glyph.bitmap->buffer.end());
+        }
+    }
+
+    auto const header = FileHeader{FileMagic, FileVersion, *_face.key, static_cast<uint32_t>(count), 0};
+
+    auto contents = vector<uint8_t>(dataOffset + bitmaps.size());
+    std::memcpy(contents.data(), &header, sizeof(header));
+    std::memcpy(contents.data() + sizeof(header), records.data(), records.size() * sizeof(Record));
+    if (!bitmaps.empty())
+        std::memcpy(contents.data() + dataOffset, bitmaps.data(), bitmaps.size());
+
+    auto ec = FileSystemError{};
+    FileSystem::create_directories(directory_, ec);
+    crispy::replace_file(_face.path.string(), contents.data(), contents.size());
+
+    // Continue with the file just written, even if writing failed, as the added glyphs are
+    // not to be written again.
+    _face.added.clear();
+    _face.addedIndex.clear();
+    load(_face);
+}
+
+} // end namespace
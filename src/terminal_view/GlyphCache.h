@@ -0,0 +1,80 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2020 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <terminal_view/GlyphRasterizer.h>
+
+#include <crispy/mapped_file.h>
+#include <crispy/stdfs.h>
+#include <crispy/text/Font.h>
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace terminal::view {
+
+/**
+ * Persistent cache of rasterized glyphs, shared across processes via files in a cache directory.
+ *
+ * Every font face has its own file, keyed by a fingerprint of the font file, the pixel size
+ * (which has the display's DPI applied already) and the render mode. The files are memory mapped
+ * and looked up on demand, whereas glyphs inserted meanwhile are written back on flush().
+ */
+class GlyphCache {
+  public:
+    /// @param _directory directory to keep the cache files in, or empty for disabling the cache.
+    explicit GlyphCache(FileSystem::path _directory = {});
+    ~GlyphCache();
+
+    GlyphCache(GlyphCache const&) = delete;
+    GlyphCache& operator=(GlyphCache const&) = delete;
+
+    bool enabled() const noexcept { return !directory_.empty(); }
+
+    /// Flushes the glyphs inserted so far and continues with cache files in @p _directory.
+    void setDirectory(FileSystem::path _directory);
+
+    /// @returns the cached glyph of the given font, or std::nullopt if it is not in the cache.
+    std::optional<RasterizedGlyph> find(crispy::text::Font& _font, unsigned _glyphIndex);
+
+    /// Adds a freshly rasterized glyph to the cache.
+    void insert(crispy::text::Font& _font, RasterizedGlyph const& _glyph);
+
+    /// Writes all glyphs inserted since the last flush to the cache files.
+    void flush();
+
+    uint64_t hits() const noexcept { return hits_; }
+    uint64_t misses() const noexcept { return misses_; }
+
+  private:
+    struct Record;
+    struct Face;
+
+    Face& face(crispy::text::Font& _font);
+    void load(Face& _face);
+    void write(Face& _face);
+
+    FileSystem::path directory_;
+    std::map<std::pair<std::string, int>, std::unique_ptr<Face>> faces_;  // keyed by file path and font size
+    uint64_t hits_ = 0;
+    uint64_t misses_ = 0;
+};
+
+} // end namespace
@@ -0,0 +1,228 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2020 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <terminal_view/GlyphRasterizer.h>
+
+#include <crispy/distance_field.h>
+
+#include <map>
+
+using std::make_pair;
+using std::make_unique;
+using std::map;
+using std::move;
+using std::pair;
+using std::scoped_lock;
+using std::string;
+using std::unique_lock;
+using std::unique_ptr;
+using std::vector;
+
+using crispy::text::Font;
+
+namespace terminal::view {
+
+RasterizedGlyph rasterize(Font& _font, unsigned _glyphIndex, bool _distanceField)
+{
+    auto glyph = RasterizedGlyph{};
+    glyph.font = &_font;
+    glyph.glyphIndex = _glyphIndex;
+    glyph.distanceField = _distanceField && !_font.hasColor();
+    glyph.bitmap = _font.loadGlyphByIndex(static_cast<int>(_glyphIndex));
+    if (!glyph.bitmap.has_value())
+        return glyph;
+
+    glyph.advance = static_cast<int>(_font->glyph->advance.x >> 6);
+    glyph.bitmapLeft = _font->glyph->bitmap_left;
+    glyph.bitmapTop = _font->glyph->bitmap_top;
+    glyph.metricsHeight = static_cast<int>(_font->glyph->metrics.height >> 6);
+    glyph.faceHeight = static_cast<int>(static_cast<unsigned>(_font->height) >> 6);
+    glyph.width = _font->glyph->bitmap.width;
+    glyph.rows = _font->glyph->bitmap.rows;
+
+    if (glyph.distanceField)
+    {
+        auto& bitmap = glyph.bitmap.value();
+        bitmap.buffer = crispy::signed_distance_field(bitmap.buffer.data(),
+                                                      static_cast<unsigned>(bitmap.width),
+                                                      static_cast<unsigned>(bitmap.height),
+                                                      DistanceFieldSpread);
+        bitmap.width += static_cast<int>(2 * DistanceFieldSpread);
+        bitmap.height += static_cast<int>(2 * DistanceFieldSpread);
+
+        auto constexpr spread = static_cast<int>(DistanceFieldSpread);
+        glyph.bitmapLeft -= spread;
+        glyph.bitmapTop += spread;
+        glyph.metricsHeight += 2 * spread;
+        glyph.width += 2 * DistanceFieldSpread;
+        glyph.rows += 2 * DistanceFieldSpread;
+    }
+
+    return glyph;
+}
+
+struct GlyphRasterizer::Worker {
+    FT_Library ft = nullptr;
+    map<pair<string, int>, unique_ptr<Font>> fonts;  // keyed by file path and font size
+    uint64_t generation = 0;
+    std::thread thread;
+
+    ~Worker()
+    {
+        fonts.clear();
+        if (ft)
+            FT_Done_FreeType(ft);
+    }
+
+    /// @returns a private copy of the given font face, or nullptr if it could not be loaded.
+    Font* font(string const& _filePath, int _fontSize)
+    {
+        auto& font = fonts[make_pair(_filePath, _fontSize)];
+        if (font)
+            return font.get();
+
+        if (!ft && FT_Init_FreeType(&ft) != FT_Err_Ok)
+        {
+            ft = nullptr;
+            return nullptr;
+        }
+
+        FT_Face face = Font::loadFace(nullptr, ft, _filePath, _fontSize);
+        if (!face)
+            return nullptr;
+
+        font = make_unique<Font>(nullptr, ft, face, _fontSize, _filePath);
+        return font.get();
+    }
+};
+
+GlyphRasterizer::GlyphRasterizer(unsigned _threadCount, std::function<void()> _onReady) :
+    onReady_{ move(_onReady) }
+{
+    for (unsigned i = 0; i < _threadCount; ++i)
+    {
+        auto& worker = *workers_.emplace_back(make_unique<Worker>());
+        worker.thread = std::thread(&GlyphRasterizer::work, this, std::ref(worker));
+    }
+}
+
+GlyphRasterizer::~GlyphRasterizer()
+{
+    {
+        auto const _l = scoped_lock{mutex_};
+        quit_ = true;
+    }
+    wakeup_.notify_all();
+
+    for (auto& worker : workers_)
+        worker->thread.join();
+}
+
+void GlyphRasterizer::request(Font& _font, unsigned _glyphIndex, bool _distanceField)
+{
+    {
+        auto const _l = scoped_lock{mutex_};
+        if (!pending_.emplace(&_font, _glyphIndex).second)
+            return;
+
+        // The font's properties are captured here, as the render thread may change them meanwhile.
+        auto const fontSize = _distanceField ? DistanceFieldFontSize : _font.fontSize();
+        jobs_.emplace_back(Job{&_font, _font.filePath(), fontSize, _glyphIndex, _distanceField});
+    }
+    wakeup_.notify_one();
+}
+
+RasterizedGlyph GlyphRasterizer::rasterizeDistanceField(Font& _font, unsigned _glyphIndex)
+{
+    if (!callingThread_)
+        callingThread_ = make_unique<Worker>();
+
+    Font* font = callingThread_->font(_font.filePath(), DistanceFieldFontSize);
+    auto glyph = font ? rasterize(*font, _glyphIndex, true) : RasterizedGlyph{};
+    glyph.font = &_font;
+    glyph.glyphIndex = _glyphIndex;
+    glyph.distanceField = true;
+    return glyph;
+}
+
+vector<RasterizedGlyph> GlyphRasterizer::fetch()
+{
+    auto const _l = scoped_lock{mutex_};
+
+    // Glyphs stay pending until fetched, so that they are not requested again in the meantime.
+    for (RasterizedGlyph const& glyph : results_)
+        pending_.erase(make_pair(glyph.font, glyph.glyphIndex));
+
+    auto results = vector<RasterizedGlyph>{};
+    swap(results, results_);
+    return results;
+}
+
+void GlyphRasterizer::clearCache()
+{
+    auto const _l = scoped_lock{mutex_};
+    jobs_.clear();
+    pending_.clear();
+    results_.clear();
+
+    // Workers release their font copies and discard their current job when noticing.
+    ++generation_;
+    callingThread_.reset();
+}
+
+void GlyphRasterizer::work(Worker& _worker)
+{
+    for (;;)
+    {
+        auto job = Job{};
+        auto generation = uint64_t{0};
+        {
+            auto lock = unique_lock{mutex_};
+            wakeup_.wait(lock, [&]() { return quit_ || !jobs_.empty(); });
+            if (quit_)
+                return;
+            job = move(jobs_.front());
+            jobs_.pop_front();
+            generation = generation_;
+        }
+
+        if (_worker.generation != generation)
+        {
+            _worker.fonts.clear();
+            _worker.generation = generation;
+        }
+
+        Font* font = _worker.font(job.filePath, job.fontSize);
+        auto glyph = font ? rasterize(*font, job.glyphIndex, job.distanceField) : RasterizedGlyph{};
+        glyph.font = job.font;
+        glyph.glyphIndex = job.glyphIndex;
+        glyph.distanceField = job.distanceField;
+
+        bool ready = false;
+        {
+            auto const _l = scoped_lock{mutex_};
+            if (generation != generation_)
+                continue;
+
+            results_.emplace_back(move(glyph));
+
+            // Only the first result of a batch needs to wake up the render thread.
+            ready = results_.size() == 1;
+        }
+
+        if (ready && onReady_)
+            onReady_();
+    }
+}
+
+} // end namespace
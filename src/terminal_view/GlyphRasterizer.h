@@ -0,0 +1,124 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2020 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <crispy/text/Font.h>
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <set>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace terminal::view {
+
+/// Font size (in pixels) at which the distance fields of glyphs are rasterized, once for any size
+/// they are rendered at.
+constexpr int DistanceFieldFontSize = 48;
+
+/// Number of pixels the distance fields of glyphs extend beyond their outlines, at
+/// DistanceFieldFontSize.
+constexpr unsigned DistanceFieldSpread = 6;
+
+/// A rasterized glyph along with the metrics of the glyph slot it has been loaded into.
+struct RasterizedGlyph {
+    crispy::text::Font* font;                       //!< font the glyph has been requested for
+    unsigned glyphIndex;
+    std::optional<crispy::text::GlyphBitmap> bitmap;
+    int advance = 0;
+    int bitmapLeft = 0;
+    int bitmapTop = 0;
+    int metricsHeight = 0;
+    int faceHeight = 0;
+    unsigned width = 0;
+    unsigned rows = 0;
+    bool distanceField = false;                     //!< whether the bitmap is a signed distance field
+};
+
+/// Rasterizes a glyph of @p _font on the calling thread.
+///
+/// @param _distanceField  whether to convert the glyph's coverage into a signed distance field,
+///                        whose metrics include the DistanceFieldSpread around it
+RasterizedGlyph rasterize(crispy::text::Font& _font, unsigned _glyphIndex, bool _distanceField = false);
+
+/**
+ * Rasterizes glyphs on background threads.
+ *
+ * FreeType faces may not be used concurrently, therefore every worker thread owns its own
+ * FreeType instance with private copies of the requested font faces. Finished glyphs are
+ * collected until the render thread fetches them for uploading into the texture atlas.
+ */
+class GlyphRasterizer {
+  public:
+    /// @param _threadCount number of background threads, zero for rasterizing synchronously.
+    /// @param _onReady invoked on a worker thread whenever glyphs have become ready to be fetched.
+    GlyphRasterizer(unsigned _threadCount, std::function<void()> _onReady);
+    ~GlyphRasterizer();
+
+    GlyphRasterizer(GlyphRasterizer const&) = delete;
+    GlyphRasterizer& operator=(GlyphRasterizer const&) = delete;
+
+    bool asynchronous() const noexcept { return !workers_.empty(); }
+
+    /// Queues the given glyph for rasterization, unless it is already pending.
+    ///
+    /// @param _distanceField  whether to rasterize the glyph's distance field at
+    ///                        DistanceFieldFontSize, rather than at the font's size
+    void request(crispy::text::Font& _font, unsigned _glyphIndex, bool _distanceField = false);
+
+    /// Rasterizes the distance field of the given glyph on the calling thread, from a private copy
+    /// of the font face at DistanceFieldFontSize.
+    RasterizedGlyph rasterizeDistanceField(crispy::text::Font& _font, unsigned _glyphIndex);
+
+    /// @returns all glyphs rasterized since the last call, without blocking.
+    std::vector<RasterizedGlyph> fetch();
+
+    /// Drops all pending requests and results as well as the workers' copies of the font faces,
+    /// e.g. after the fonts have changed.
+    void clearCache();
+
+  private:
+    struct Job {
+        crispy::text::Font* font;
+        std::string filePath;
+        int fontSize;
+        unsigned glyphIndex;
+        bool distanceField;
+    };
+
+    struct Worker;
+
+    void work(Worker& _worker);
+
+    std::function<void()> onReady_;
+    std::vector<std::unique_ptr<Worker>> workers_;
+    std::unique_ptr<Worker> callingThread_;  // font copies of rasterizeDistanceField()
+
+    std::mutex mutex_;
+    std::condition_variable wakeup_;
+    std::deque<Job> jobs_;
+    std::set<std::pair<crispy::text::Font const*, unsigned>> pending_;
+    std::vector<RasterizedGlyph> results_;
+    uint64_t generation_ = 0;
+    bool quit_ = false;
+};
+
+} // end namespace
@@ -0,0 +1,209 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2020 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <terminal_view/HeadlessView.h>
+#include <terminal_view/ShaderConfig.h>
+
+#include <QtGui/QMatrix4x4>
+#include <QtGui/QOffscreenSurface>
+#include <QtGui/QOpenGLContext>
+#include <QtGui/QOpenGLExtraFunctions>
+#include <QtGui/QOpenGLFramebufferObject>
+#include <QtGui/QOpenGLFunctions>
+#include <QtGui/QSurfaceFormat>
+
+#include <stdexcept>
+
+using std::make_unique;
+using std::move;
+using std::nullopt;
+using std::runtime_error;
+using std::unique_ptr;
+using std::chrono::steady_clock;
+
+#if !defined(GL_TIME_ELAPSED)
+#define GL_TIME_ELAPSED 0x88BF
+#endif
+
+namespace terminal::view {
+
+namespace
+{
+    QSurfaceFormat surfaceFormat()
+    {
+        QSurfaceFormat format;
+        if (QOpenGLContext::openGLModuleType() == QOpenGLContext::LibGLES)
+        {
+            format.setVersion(3, 2);
+            format.setRenderableType(QSurfaceFormat::OpenGLES);
+        }
+        else
+        {
+            format.setVersion(3, 3);
+            format.setRenderableType(QSurfaceFormat::OpenGL);
+        }
+        format.setProfile(QSurfaceFormat::CoreProfile);
+        format.setAlphaBufferSize(8);
+        return format;
+    }
+
+    QMatrix4x4 ortho(float _width, float _height)
+    {
+        QMatrix4x4 mat;
+        mat.ortho(0.0f, _width, 0.0f, _height, -1.0f, 1.0f);
+        return mat;
+    }
+
+    bool supportsTimerQueries(QOpenGLContext const& _context)
+    {
+        if (_context.isOpenGLES())
+            return _context.hasExtension("GL_EXT_disjoint_timer_query");
+
+        auto const version = _context.format().version();
+        return version >= qMakePair(3, 3) || _context.hasExtension("GL_ARB_timer_query");
+    }
+}
+
+HeadlessView::HeadlessView(FontConfig const& _fonts,
+                           terminal::ColorProfile _colorProfile,
+                           unique_ptr<Pty> _client,
+                           Process::ExecInfo const& _shell,
+                           Logger _logger) :
+    surface_{ make_unique<QOffscreenSurface>() },
+    context_{ make_unique<QOpenGLContext>() },
+    colorProfile_{ _colorProfile }
+{
+    // The shell starts up while the context and the renderer are set up.
+    auto process = make_unique<Process>(_shell, *_client);
+
+    context_->setFormat(surfaceFormat());
+    if (!context_->create())
+        throw runtime_error{"Failed to create OpenGL context."};
+
+    surface_->setFormat(context_->format());
+    surface_->create();
+    makeCurrent();
+
+    auto const width = _client->screenSize().width * _fonts.regular.first.get().maxAdvance();
+    auto const height = _client->screenSize().height * _fonts.regular.first.get().lineHeight();
+    framebuffer_ = make_unique<QOpenGLFramebufferObject>(width, height);
+    if (!framebuffer_->isValid())
+        throw runtime_error{"Failed to create offscreen framebuffer."};
+
+    if (supportsTimerQueries(*context_))
+    {
+        getQueryObjectui64v_ = reinterpret_cast<GetQueryObjectui64v>(context_->getProcAddress(
+            context_->isOpenGLES() ? "glGetQueryObjectui64vEXT" : "glGetQueryObjectui64v"
+        ));
+        if (getQueryObjectui64v_)
+            context_->extraFunctions()->glGenQueries(1, &timerQuery_);
+    }
+
+    view_ = make_unique<TerminalView>(
+        steady_clock::now(),
+        static_cast<TerminalView::Events&>(*this),
+        nullopt,
+        " ",
+        _fonts,
+        CursorShape::Block,
+        CursorDisplay::Steady,
+        std::chrono::milliseconds{500},
+        _colorProfile,
+        Opacity::Opaque,
+        Decorator::DottedUnderline,
+        Decorator::Underline,
+        move(_client),
+        move(process),
+        ortho(static_cast<float>(width), static_cast<float>(height)),
+        defaultShaderConfig(ShaderClass::Background),
+        defaultShaderConfig(ShaderClass::Text),
+        defaultShaderConfig(ShaderClass::Cursor),
+        move(_logger)
+    );
+}
+
+HeadlessView::~HeadlessView()
+{
+    // The renderer releases its OpenGL resources, which requires the context to be current.
+    makeCurrent();
+    if (timerQuery_)
+        context_->extraFunctions()->glDeleteQueries(1, &timerQuery_);
+    view_.reset();
+    framebuffer_.reset();
+    context_->doneCurrent();
+}
+
+void HeadlessView::makeCurrent()
+{
+    if (!context_->makeCurrent(surface_.get()))
+        throw runtime_error{"Failed to make OpenGL context current."};
+}
+
+uint64_t HeadlessView::render(steady_clock::time_point _now)
+{
+    makeCurrent();
+    framebuffer_->bind();
+
+    dirty_ = false;
+
+    bool const reverseVideo = view_->terminal().screen().isModeEnabled(terminal::Mode::ReverseVideo);
+    QVector4D const bg = Renderer::canonicalColor(
+        reverseVideo ? colorProfile_.defaultForeground : colorProfile_.defaultBackground
+    );
+
+    QOpenGLFunctions* gl = context_->functions();
+    gl->glViewport(0, 0, framebuffer_->width(), framebuffer_->height());
+    gl->glClearColor(bg[0], bg[1], bg[2], bg[3]);
+    gl->glClear(GL_COLOR_BUFFER_BIT);
+
+    QOpenGLExtraFunctions* glx = context_->extraFunctions();
+    if (timerQuery_)
+        glx->glBeginQuery(GL_TIME_ELAPSED, timerQuery_);
+
+    auto const start = steady_clock::now();
+    auto const updates = view_->render(_now, false);
+    frameTimes_.cpu = steady_clock::now() - start;
+
+    if (timerQuery_)
+        glx->glEndQuery(GL_TIME_ELAPSED);
+
+    // Render costs are measured per frame, and the frame is to be read back afterwards.
+    gl->glFinish();
+
+    if (timerQuery_)
+    {
+        GLuint64 elapsed = 0;
+        getQueryObjectui64v_(timerQuery_, GL_QUERY_RESULT, &elapsed);
+        frameTimes_.gpu = std::chrono::nanoseconds(elapsed);
+    }
+
+    return updates;
+}
+
+QImage HeadlessView::screenshot()
+{
+    makeCurrent();
+    return framebuffer_->toImage();
+}
+
+void HeadlessView::screenUpdated()
+{
+    dirty_ = true;
+}
+
+void HeadlessView::glyphsRasterized()
+{
+    dirty_ = true;
+}
+
+} // end namespace
@@ -0,0 +1,102 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2020 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <terminal_view/TerminalView.h>
+
+#include <QtGui/QImage>
+#include <QtGui/qopengl.h>
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <optional>
+
+class QOffscreenSurface;
+class QOpenGLContext;
+class QOpenGLFramebufferObject;
+
+namespace terminal::view {
+
+/**
+ * TerminalView rendering into an offscreen framebuffer, without any window.
+ *
+ * Each headless view owns its own OpenGL context on an offscreen surface, so that views may be
+ * rendered independently of each other and of any display server, for example for testing
+ * and for measuring the render cost. Rendered frames can be read back via screenshot().
+ *
+ * A QGuiApplication must have been constructed before. Running it with the "offscreen"
+ * platform plugin (QT_QPA_PLATFORM=offscreen) together with a software OpenGL implementation
+ * (such as Mesa's llvmpipe) does not require any display nor GPU.
+ */
+class HeadlessView : private TerminalView::Events {
+  public:
+    /// @throws std::runtime_error if no OpenGL context could be created.
+    HeadlessView(FontConfig const& _fonts,
+                 terminal::ColorProfile _colorProfile,
+                 std::unique_ptr<Pty> _client,
+                 Process::ExecInfo const& _shell,
+                 Logger _logger = {});
+
+    ~HeadlessView();
+
+    HeadlessView(HeadlessView const&) = delete;
+    HeadlessView& operator=(HeadlessView const&) = delete;
+
+    TerminalView& view() noexcept { return *view_; }
+    Terminal& terminal() noexcept { return view_->terminal(); }
+
+    /// Tests whether the screen has been updated since the last frame rendered.
+    bool dirty() const noexcept { return dirty_.load(); }
+
+    /// Renders a frame into the offscreen framebuffer and waits for it to be completed.
+    ///
+    /// @returns number of screen updates since the last frame.
+    uint64_t render(std::chrono::steady_clock::time_point _now);
+
+    /// @returns the most recently rendered frame.
+    QImage screenshot();
+
+    struct FrameTimes {
+        std::chrono::nanoseconds cpu{};             // issuing the frame, without waiting for the GPU
+        std::optional<std::chrono::nanoseconds> gpu; // executing the frame on the GPU, if measurable
+    };
+
+    /// @returns the times spent on the most recently rendered frame.
+    ///
+    /// The GPU time is measured with timer queries, which require OpenGL 3.3 or an extension
+    /// on OpenGL ES (GL_EXT_disjoint_timer_query), and is std::nullopt without.
+    FrameTimes const& frameTimes() const noexcept { return frameTimes_; }
+
+  private:
+    void screenUpdated() override;
+    void glyphsRasterized() override;
+
+    void makeCurrent();
+
+  private:
+    std::unique_ptr<QOffscreenSurface> surface_;
+    std::unique_ptr<QOpenGLContext> context_;
+    std::unique_ptr<QOpenGLFramebufferObject> framebuffer_;
+    std::unique_ptr<TerminalView> view_;
+    terminal::ColorProfile colorProfile_;
+    std::atomic<bool> dirty_ = true;
+
+    using GetQueryObjectui64v = void (*)(GLuint, GLenum, GLuint64*);
+    GetQueryObjectui64v getQueryObjectui64v_ = nullptr;  // resolved if timer queries are supported
+    GLuint timerQuery_ = 0;
+    FrameTimes frameTimes_;
+};
+
+} // end namespace
@@ -15,13 +15,26 @@
 
 #include <crispy/times.h>
 #include <crispy/algorithm.h>
+#include <crispy/trace.h>
 
+#include <cmath>
+
+using std::clamp;
+using std::max;
+using std::min;
+using std::move;
 using std::nullopt;
 using std::optional;
 using crispy::times;
 
 namespace terminal::view {
 
+namespace
+{
+    // Maximum width and height in pixels of the tiles images are uploaded in.
+    auto constexpr MaxTileSize = 512;
+}
+
 ImageRenderer::ImageRenderer(crispy::atlas::CommandListener& _commandListener,
                              crispy::atlas::TextureAtlasAllocator& _colorAtlasAllocator,
                              Size const& _cellSize) :
@@ -34,38 +47,129 @@ ImageRenderer::ImageRenderer(crispy::atlas::CommandListener& _commandListener,
 
 void ImageRenderer::setCellSize(Size const& _cellSize)
 {
+    // Tiles are independent of the cell size, hence merely rendered at the new size.
     cellSize_ = _cellSize;
-    // TODO: recompute slices here?
 }
 
 void ImageRenderer::renderImage(QPoint _pos, ImageFragment const& _fragment)
 {
-    if (optional<DataRef> const dataRef = getTextureInfo(_fragment); dataRef.has_value())
-    {
-        //std::cout << fmt::format("ImageRenderer.renderImage: {}\n", _fragment);
+    CRISPY_TRACE_ZONE("ImageRenderer::renderImage");
+
+    RasterizedImage const& rasterized = _fragment.rasterizedImage();
+    Image const& image = rasterized.image();
+    auto const placement = rasterized.placement();
+    auto const sourceCellSize = rasterized.cellSize();
+    if (placement.width <= 0 || placement.height <= 0 || !area(sourceCellSize))
+        return;
+
+    // The cell in pixels of the rasterized image, and its scale to the current cell size.
+    auto const cellLeft = static_cast<double>(_fragment.offset().column * sourceCellSize.width);
+    auto const cellTop = static_cast<double>(_fragment.offset().row * sourceCellSize.height);
+    auto const scaleX = static_cast<double>(cellSize_.width) / sourceCellSize.width;
+    auto const scaleY = static_cast<double>(cellSize_.height) / sourceCellSize.height;
+
+    // The part of the cell covered by the image, the remainder being left to the cell's background.
+    auto const visibleLeft = max(cellLeft, placement.left);
+    auto const visibleTop = max(cellTop, placement.top);
+    auto const visibleRight = min(cellLeft + sourceCellSize.width, placement.left + placement.width);
+    auto const visibleBottom = min(cellTop + sourceCellSize.height, placement.top + placement.height);
+    if (visibleLeft >= visibleRight || visibleTop >= visibleBottom)
+        return;
+
+    // Image pixels per pixel of the rasterized image.
+    auto const pixelsPerX = image.width() / placement.width;
+    auto const pixelsPerY = image.height() / placement.height;
+    auto const tileIndex = [](double _pixel, int _extent) {
+        return clamp(static_cast<int>(_pixel) / MaxTileSize, 0, (_extent - 1) / MaxTileSize);
+    };
 
-        auto const color = QVector4D(1.0f, 0.0f, 0.0f, 1.0f); // not used
-        crispy::atlas::TextureInfo const& textureInfo = std::get<0>(*dataRef).get();
+    auto const color = QVector4D(1.0f, 1.0f, 1.0f, 1.0f); // leaves the image's colors untouched
 
-        // TODO: actually make x/y/z all signed (for future work, i.e. smooth scrolling!)
-        auto const x = _pos.x();
-        auto const y = _pos.y();
-        auto const z = 0;
-        commandListener_.renderTexture({textureInfo, x, y, z, color});
+    for (int tileRow = tileIndex((visibleTop - placement.top) * pixelsPerY, image.height()),
+             lastTileRow = tileIndex((visibleBottom - placement.top) * pixelsPerY, image.height());
+         tileRow <= lastTileRow; ++tileRow)
+    {
+        for (int tileColumn = tileIndex((visibleLeft - placement.left) * pixelsPerX, image.width()),
+                 lastTileColumn = tileIndex((visibleRight - placement.left) * pixelsPerX, image.width());
+             tileColumn <= lastTileColumn; ++tileColumn)
+        {
+            auto const tileOffset = Coordinate{tileRow * MaxTileSize, tileColumn * MaxTileSize};
+            optional<DataRef> const tileRef = getTileTextureInfo(image, tileOffset);
+            if (!tileRef.has_value())
+                return;
+
+            crispy::atlas::TextureInfo const& tile = std::get<0>(*tileRef).get();
+
+            // The part of the cell covered by this tile, with its edges rounded to whole target
+            // pixels, such that adjacent cells and tiles meet without seams.
+            auto const edge = [](double _pixel, double _scale) { return static_cast<int>(std::lround(_pixel * _scale)); };
+            auto const x0 = edge(max(visibleLeft, placement.left + tileOffset.column / pixelsPerX) - cellLeft, scaleX);
+            auto const x1 = edge(min(visibleRight, placement.left + (tileOffset.column + static_cast<int>(tile.width)) / pixelsPerX) - cellLeft, scaleX);
+            auto const y0 = edge(max(visibleTop, placement.top + tileOffset.row / pixelsPerY) - cellTop, scaleY);
+            auto const y1 = edge(min(visibleBottom, placement.top + (tileOffset.row + static_cast<int>(tile.height)) / pixelsPerY) - cellTop, scaleY);
+            if (x0 >= x1 || y0 >= y1)
+                continue;
+
+            // The texture coordinates are those of the rounded edges, in pixels of the tile.
+            auto const u = [&](int _x) { return static_cast<float>((cellLeft + _x / scaleX - placement.left) * pixelsPerX - tileOffset.column); };
+            auto const v = [&](int _y) { return static_cast<float>((cellTop + _y / scaleY - placement.top) * pixelsPerY - tileOffset.row); };
+            auto const texelWidth = tile.relativeWidth / static_cast<float>(tile.width);
+            auto const texelHeight = tile.relativeHeight / static_cast<float>(tile.height);
+
+            auto const texture = crispy::atlas::TextureInfo{
+                tile.atlas,
+                tile.atlasName,
+                tile.x + static_cast<unsigned>(u(x0)),
+                tile.y + static_cast<unsigned>(v(y0)),
+                tile.z,
+                static_cast<unsigned>(u(x1) - u(x0)),
+                static_cast<unsigned>(v(y1) - v(y0)),
+                static_cast<unsigned>(x1 - x0),
+                static_cast<unsigned>(y1 - y0),
+                tile.relativeX + u(x0) * texelWidth,
+                tile.relativeY + v(y0) * texelHeight,
+                (u(x1) - u(x0)) * texelWidth,
+                (v(y1) - v(y0)) * texelHeight,
+                tile.user
+            };
+
+            // The render command is consumed right away, hence the texture may be a temporary.
+            auto const x = _pos.x() + x0;
+            auto const y = _pos.y() + cellSize_.height - y1;
+            auto const z = 0;
+            commandListener_.renderTexture({texture, x, y, z, color});
+        }
     }
 }
 
-optional<ImageRenderer::DataRef> ImageRenderer::getTextureInfo(ImageFragment const& _fragment)
+optional<ImageRenderer::DataRef> ImageRenderer::getTileTextureInfo(Image const& _image, Coordinate _tileOffset)
 {
-    auto const key = ImageFragmentKey{
-        _fragment.rasterizedImage().image().id(),
-        _fragment.offset(),
-        _fragment.rasterizedImage().cellSize()
-    };
+    auto const key = ImageFragmentKey{_image.id(), _tileOffset, Size{}};
+
+    auto& tiles = imageTilesInUse_[_image.id()];
+    tiles.lastUse = ++useCounter_;
 
     if (optional<DataRef> const info = atlas_.get(key); info.has_value())
         return info;
 
+    // Evicted images, and images not decoded yet, are not rendered.
+    auto const data = _image.data();
+    if (!data || data->size() < static_cast<size_t>(_image.width()) * static_cast<size_t>(_image.height()) * 4)
+        return nullopt;
+
+    // Tiles at the right and bottom edge only span the remaining pixels of the image.
+    auto const width = static_cast<unsigned>(min(MaxTileSize, _image.width() - _tileOffset.column));
+    auto const height = static_cast<unsigned>(min(MaxTileSize, _image.height() - _tileOffset.row));
+
+    auto pixels = crispy::atlas::Buffer{};
+    pixels.reserve(static_cast<size_t>(width) * height * 4);
+    for (unsigned y = 0; y < height; ++y)
+    {
+        auto const source = data->data() + (static_cast<size_t>(_tileOffset.row + static_cast<int>(y)) * static_cast<size_t>(_image.width())
+                                            + static_cast<size_t>(_tileOffset.column)) * 4;
+        pixels.insert(pixels.end(), source, source + width * 4);
+    }
+
     auto metadata = Metadata{}; // TODO: do we want/need to fill this?
 
     auto constexpr colored = true;
@@ -73,38 +177,66 @@ optional<ImageRenderer::DataRef> ImageRenderer::getTextureInfo(ImageFragment con
     // FIXME: remember if insertion failed already, don't repeat then? or how to deal with GPU atlas/GPU exhaustion?
 
     auto handle = atlas_.insert(key,
-                         _fragment.rasterizedImage().cellSize().width,
-                         _fragment.rasterizedImage().cellSize().height,
-                         cellSize_.width,
-                         cellSize_.height,
+                         width,
+                         height,
+                         width,
+                         height,
                          GL_RGBA,
-                         _fragment.data(),
+                         move(pixels),
                          colored,
                          metadata);
 
-    // remember image fragment key so we can later on release the GPU memory when not needed anymore.
+    // remember image tile key so we can later on release the GPU memory when not needed anymore.
     if (handle)
-        imageFragmentsInUse_[_fragment.rasterizedImage().image().id()].emplace_back(key);
+    {
+        auto const bytes = static_cast<size_t>(width) * height * 4;
+        tiles.keys.emplace_back(key);
+        tiles.bytes += bytes;
+        textureMemory_ += bytes;
+
+        if (maxTextureMemory_ != 0 && textureMemory_ > maxTextureMemory_)
+            evictTextures();
+    }
 
     return handle;
 }
 
-void ImageRenderer::discardImage(Image const& _image)
+void ImageRenderer::evictTextures()
+{
+    while (textureMemory_ > maxTextureMemory_)
+    {
+        auto victim = end(imageTilesInUse_);
+        for (auto i = begin(imageTilesInUse_); i != end(imageTilesInUse_); ++i)
+            if (i->second.lastUse < frameStart_ && i->second.bytes != 0
+                    && (victim == end(imageTilesInUse_) || i->second.lastUse < victim->second.lastUse))
+                victim = i;
+
+        if (victim == end(imageTilesInUse_))
+            break;
+
+        ++textureEvictions_;
+        discardImage(victim->first);
+    }
+}
+
+void ImageRenderer::discardImage(Image::Id _imageId)
 {
-    auto const fragmentsIterator = imageFragmentsInUse_.find(_image.id());
-    if (fragmentsIterator != end(imageFragmentsInUse_))
+    auto const tilesIterator = imageTilesInUse_.find(_imageId);
+    if (tilesIterator != end(imageTilesInUse_))
     {
-        auto const& fragments = fragmentsIterator->second;
-        for (ImageFragmentKey const& key : fragments)
+        auto const& tiles = tilesIterator->second;
+        for (ImageFragmentKey const& key : tiles.keys)
             atlas_.release(key);
 
-        imageFragmentsInUse_.erase(fragmentsIterator);
+        textureMemory_ -= tiles.bytes;
+        imageTilesInUse_.erase(tilesIterator);
     }
 }
 
 void ImageRenderer::clearCache()
 {
-    imageFragmentsInUse_.clear();
+    imageTilesInUse_.clear();
+    textureMemory_ = 0;
     atlas_.clear();
 }
 
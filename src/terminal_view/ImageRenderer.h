@@ -15,6 +15,7 @@
 
 #include <crispy/Atlas.h>
 #include <crispy/AtlasRenderer.h>
+#include <crispy/hash.h>
 
 #include <terminal/Image.h>
 #include <terminal/Size.h>
@@ -26,6 +27,14 @@ namespace terminal::view {
 /// Image Rendering API.
 ///
 /// Can render any arbitrary RGBA image (for example Sixel Graphics images).
+///
+/// The pixels of an image are uploaded once, in tiles independent of the grid cells, and every
+/// cell is rendered as the sub-rectangles of the tiles it covers. Resizing and aligning the image
+/// into the grid cells it spans is thereby left to the texture coordinates, sampled on the GPU,
+/// such that neither placing an image nor changing the cell size rasterizes it on the CPU.
+///
+/// Once the tiles exceed the texture memory budget, the least recently rendered images' tiles
+/// are released, to be uploaded again when needed.
 class ImageRenderer
 {
   public:
@@ -41,8 +50,21 @@ class ImageRenderer
     void renderImage(QPoint _pos, ImageFragment const& _fragment);
 
     /// notify underlying cache that this fragment is not going to be rendered anymore, maybe freeing up some GPU caches.
-    void discardImage(Image const& _image);
+    void discardImage(Image::Id _imageId);
+
+    /// Starts rendering a new frame. Images rendered in the current frame are never evicted.
+    void beginFrame() noexcept { frameStart_ = useCounter_ + 1; }
+
+    /// Sets the maximum number of bytes of image textures to keep, or 0 for no limit.
+    void setMaxTextureMemory(size_t _bytes) noexcept { maxTextureMemory_ = _bytes; }
+
+    /// @returns number of bytes of image textures uploaded.
+    size_t textureMemory() const noexcept { return textureMemory_; }
+
+    /// @returns number of images whose textures have been released for exceeding the budget.
+    uint64_t textureEvictions() const noexcept { return textureEvictions_; }
 
+    /// Identifies a tile of an image by the offset of its top left pixel.
     struct ImageFragmentKey {
         Image::Id const imageId;
         Coordinate const offset;
@@ -77,14 +99,45 @@ class ImageRenderer
     void clearCache();
 
   private:
-    std::optional<DataRef> getTextureInfo(ImageFragment const& _fragment);
+    /// @returns the texture of the tile of @p _image at the given pixel offset, uploading the tile
+    ///          if needed, or std::nullopt if the image's pixel data is not available.
+    std::optional<DataRef> getTileTextureInfo(Image const& _image, Coordinate _tileOffset);
+
+    /// Releases the tiles of the least recently rendered images, not rendered in the current frame,
+    /// until the texture memory budget is met.
+    void evictTextures();
+
+    struct ImageTiles {
+        std::vector<ImageFragmentKey> keys;
+        size_t bytes = 0;
+        uint64_t lastUse = 0;
+    };
 
   private:
     ImagePool imagePool_;
-    std::map<Image::Id, std::vector<ImageFragmentKey>> imageFragmentsInUse_; // remember each fragment key per image for proper GPU texture GC.
+    std::map<Image::Id, ImageTiles> imageTilesInUse_; // remember each tile key per image for proper GPU texture GC.
     Size cellSize_;
     crispy::atlas::CommandListener& commandListener_;
     TextureAtlas atlas_;
+    size_t maxTextureMemory_ = 0;
+    size_t textureMemory_ = 0;
+    uint64_t useCounter_ = 0;
+    uint64_t frameStart_ = 1;
+    uint64_t textureEvictions_ = 0;
 };
 
 }
+
+namespace std {
+    template<>
+    struct hash<terminal::view::ImageRenderer::ImageFragmentKey> {
+        size_t operator()(terminal::view::ImageRenderer::ImageFragmentKey const& _key) const noexcept {
+            // offset and size are small, hence packed into one word mixed into the image's id.
+            auto const cell = (static_cast<uint64_t>(_key.offset.row) << 48)
+                            ^ (static_cast<uint64_t>(_key.offset.column) << 32)
+                            ^ (static_cast<uint64_t>(_key.size.width) << 16)
+                            ^ static_cast<uint64_t>(_key.size.height);
+            return crispy::hash_word(cell, _key.imageId);
+        }
+    };
+}
@@ -14,11 +14,12 @@
 #include <terminal_view/OpenGLRenderer.h>
 #include <terminal_view/TextRenderer.h>
 
-#include <crispy/algorithm.h>
-
 #include <algorithm>
+#include <array>
+#include <stdexcept>
 
 using std::min;
+using std::move;
 
 namespace terminal::view {
 
@@ -26,8 +27,34 @@ constexpr unsigned MaxInstanceCount = 1;
 constexpr unsigned MaxMonochromeTextureSize = 1024;
 constexpr unsigned MaxColorTextureSize = 2048;
 
+// Every filled rectangle is one instance of a quad: <X Y Z> position, <W H> size and <R G B A> color.
+constexpr size_t RectInstanceSize = 3 + 2 + 4;
+
+std::array<GLfloat, RectInstanceSize> rectangleInstance(unsigned _x, unsigned _y, unsigned _width, unsigned _height,
+                                                       QVector4D const& _color)
+{
+    GLfloat const x = _x;
+    GLfloat const y = _y;
+    GLfloat const z = 0.0f;
+    GLfloat const r = _width;
+    GLfloat const s = _height;
+    GLfloat const cr = _color[0];
+    GLfloat const cg = _color[1];
+    GLfloat const cb = _color[2];
+    GLfloat const ca = _color[3];
+
+    return {
+    // <X  Y  Z> <W  H> <R   G   B   A>
+        x, y, z,  r, s,  cr, cg, cb, ca
+    };
+}
+
+// Every cursor rectangle is one instance of a quad: <X Y Z> position and <W H> size.
+constexpr size_t CursorInstanceSize = 3 + 2;
+
 OpenGLRenderer::OpenGLRenderer(ShaderConfig const& _textShaderConfig,
                                ShaderConfig const& _rectShaderConfig,
+                               ShaderConfig const& _cursorShaderConfig,
                                QMatrix4x4 const& _projectionMatrix,
                                int _leftMargin,
                                int _bottomMargin,
@@ -36,10 +63,11 @@ OpenGLRenderer::OpenGLRenderer(ShaderConfig const& _textShaderConfig,
     leftMargin_{ _leftMargin },
     bottomMargin_{ _bottomMargin },
     cellSize_{ _cellSize },
-    textShader_{ createShader(_textShaderConfig) },
-    textProjectionLocation_{ textShader_->uniformLocation("vs_projection") },
-    marginLocation_{ textShader_->uniformLocation("vs_margin") },
-    cellSizeLocation_{ textShader_->uniformLocation("vs_cellSize") },
+    glyphAtlas_{ SharedGlyphAtlas::acquire(
+        maxTextureSize() / maxTextureDepth(),
+        min(MaxMonochromeTextureSize, maxTextureSize()),
+        min(MaxColorTextureSize, maxTextureSize())
+    ) },
     monochromeAtlasAllocator_{
         0,
         MaxInstanceCount,
@@ -59,21 +87,19 @@ OpenGLRenderer::OpenGLRenderer(ShaderConfig const& _textShaderConfig,
         GL_RGBA8,
         textureRenderer_.scheduler(),
         "colorAtlas"
-    },
-    rectShader_{ createShader(_rectShaderConfig) },
-    rectProjectionLocation_{ rectShader_->uniformLocation("u_projection") }
+    }
 {
     initialize();
 
+    textureRenderer_.setSharedTextures(&glyphAtlas_->textures());
+
+    if (!setShaders(_textShaderConfig, _rectShaderConfig, _cursorShaderConfig))
+        throw std::runtime_error("Failed to build the default shaders.");
+
     glEnable(GL_BLEND);
     glBlendFuncSeparate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ONE, GL_ONE);
     //glBlendFunc(GL_SRC1_COLOR, GL_ONE_MINUS_SRC1_COLOR);
 
-    textShader_->bind();
-    textShader_->setUniformValue("fs_monochromeTextures", 0);
-    textShader_->setUniformValue("fs_colorTextures", 1);
-    textShader_->release();
-
     // setup filled-rectangle rendering
     //
     glGenVertexArrays(1, &rectVAO_);
@@ -81,25 +107,97 @@ OpenGLRenderer::OpenGLRenderer(ShaderConfig const& _textShaderConfig,
 
     glGenBuffers(1, &rectVBO_);
     glBindBuffer(GL_ARRAY_BUFFER, rectVBO_);
-    glBufferData(GL_ARRAY_BUFFER, 0, nullptr, GL_STREAM_DRAW);
+    glBufferData(GL_ARRAY_BUFFER, 0, nullptr, GL_DYNAMIC_DRAW);
 
-    auto constexpr BufferStride = 7 * sizeof(GLfloat);
-    auto const VertexOffset = (void const*) (0 * sizeof(GLfloat));
-    auto const ColorOffset = (void const*) (3 * sizeof(GLfloat));
+    // All attributes advance per instance rather than per vertex.
+    for (GLuint location = 0; location < 3; ++location)
+    {
+        glEnableVertexAttribArray(location);
+        glVertexAttribDivisor(location, 1);
+    }
+    bindRectangles(0);
 
-    // 0 (vec3): vertex buffer
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, BufferStride, VertexOffset);
-    glEnableVertexAttribArray(0);
+    // setup cursor rendering
+    //
+    glGenVertexArrays(1, &cursorVAO_);
+    glBindVertexArray(cursorVAO_);
+
+    glGenBuffers(1, &cursorVBO_);
+    glBindBuffer(GL_ARRAY_BUFFER, cursorVBO_);
+    glBufferData(GL_ARRAY_BUFFER, 0, nullptr, GL_DYNAMIC_DRAW);
+
+    auto constexpr CursorStride = static_cast<GLsizei>(CursorInstanceSize * sizeof(GLfloat));
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, CursorStride, nullptr); // position
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, CursorStride, reinterpret_cast<void const*>(3 * sizeof(GLfloat))); // size
+    for (GLuint location = 0; location < 2; ++location)
+    {
+        glEnableVertexAttribArray(location);
+        glVertexAttribDivisor(location, 1);
+    }
+
+    // setup highlight rendering
+    //
+    glGenVertexArrays(1, &highlightVAO_);
+    glBindVertexArray(highlightVAO_);
 
-    // 1 (vec4): color buffer
-    glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, BufferStride, ColorOffset);
-    glEnableVertexAttribArray(1);
+    glGenBuffers(1, &highlightVBO_);
+    glBindBuffer(GL_ARRAY_BUFFER, highlightVBO_);
+    glBufferData(GL_ARRAY_BUFFER, 0, nullptr, GL_DYNAMIC_DRAW);
+
+    for (GLuint location = 0; location < 3; ++location)
+    {
+        glEnableVertexAttribArray(location);
+        glVertexAttribDivisor(location, 1);
+    }
+    glBindVertexArray(0);
 }
 
 OpenGLRenderer::~OpenGLRenderer()
 {
     glDeleteVertexArrays(1, &rectVAO_);
     glDeleteBuffers(1, &rectVBO_);
+    glDeleteVertexArrays(1, &cursorVAO_);
+    glDeleteBuffers(1, &cursorVBO_);
+    glDeleteVertexArrays(1, &highlightVAO_);
+    glDeleteBuffers(1, &highlightVBO_);
+}
+
+bool OpenGLRenderer::setShaders(ShaderConfig const& _textShaderConfig,
+                                ShaderConfig const& _rectShaderConfig,
+                                ShaderConfig const& _cursorShaderConfig)
+{
+    auto textShader = createShader(_textShaderConfig);
+    auto rectShader = createShader(_rectShaderConfig);
+    auto cursorShader = createShader(_cursorShaderConfig);
+    if (!textShader || !rectShader || !cursorShader)
+        return false;
+
+    textShader_ = move(textShader);
+    textProjectionLocation_ = textShader_->uniformLocation("vs_projection");
+    marginLocation_ = textShader_->uniformLocation("vs_margin");
+    cellSizeLocation_ = textShader_->uniformLocation("vs_cellSize");
+    textScrollOffsetLocation_ = textShader_->uniformLocation("vs_scrollOffset");
+
+    textShader_->bind();
+    textShader_->setUniformValue("fs_textures", 0);
+    textShader_->release();
+
+    rectShader_ = move(rectShader);
+    rectProjectionLocation_ = rectShader_->uniformLocation("u_projection");
+    rectScrollOffsetLocation_ = rectShader_->uniformLocation("u_scrollOffset");
+
+    cursorShader_ = move(cursorShader);
+    cursorProjectionLocation_ = cursorShader_->uniformLocation("u_projection");
+    cursorScrollOffsetLocation_ = cursorShader_->uniformLocation("u_scrollOffset");
+    cursorTimeLocation_ = cursorShader_->uniformLocation("u_time");
+    cursorMoveOffsetLocation_ = cursorShader_->uniformLocation("u_moveOffset");
+    cursorMoveStartLocation_ = cursorShader_->uniformLocation("u_moveStart");
+    cursorMoveDurationLocation_ = cursorShader_->uniformLocation("u_moveDuration");
+    cursorColorLocation_ = cursorShader_->uniformLocation("u_color");
+    cursorBlinkStartLocation_ = cursorShader_->uniformLocation("u_blinkStart");
+    cursorBlinkIntervalLocation_ = cursorShader_->uniformLocation("u_blinkInterval");
+
+    return true;
 }
 
 void OpenGLRenderer::initialize()
@@ -157,51 +255,229 @@ void OpenGLRenderer::destroyAtlas(crispy::atlas::DestroyAtlas const& _param)
 
 void OpenGLRenderer::renderRectangle(unsigned _x, unsigned _y, unsigned _width, unsigned _height, QVector4D const& _color)
 {
-    GLfloat const x = _x;
-    GLfloat const y = _y;
-    GLfloat const z = 0.0f;
-    GLfloat const r = _width;
-    GLfloat const s = _height;
-    GLfloat const cr = _color[0];
-    GLfloat const cg = _color[1];
-    GLfloat const cb = _color[2];
-    GLfloat const ca = _color[3];
+    auto const instance = rectangleInstance(_x, _y, _width, _height, _color);
+    rectBuffer_.append(instance.data(), instance.size());
+}
 
-    GLfloat const vertices[6 * 7] = {
-        // first triangle
-        x,     y + s, z, cr, cg, cb, ca,
-        x,     y,     z, cr, cg, cb, ca,
-        x + r, y,     z, cr, cg, cb, ca,
+void OpenGLRenderer::makeRectangle(std::vector<GLfloat>& _instances,
+                                   unsigned _x, unsigned _y, unsigned _width, unsigned _height,
+                                   QVector4D const& _color)
+{
+    auto const instance = rectangleInstance(_x, _y, _width, _height, _color);
+    _instances.insert(_instances.end(), instance.begin(), instance.end());
+}
 
-        // second triangle
-        x,     y + s, z, cr, cg, cb, ca,
-        x + r, y,     z, cr, cg, cb, ca,
-        x + r, y + s, z, cr, cg, cb, ca
+void OpenGLRenderer::renderRectangles(std::vector<GLfloat> const& _instances)
+{
+    rectBuffer_.append(_instances.data(), _instances.size());
+}
+
+void OpenGLRenderer::renderCursorRectangle(int _x, int _y, int _width, int _height)
+{
+    GLfloat const instance[CursorInstanceSize] = {
+    // <X  Y  Z> <W  H>
+        static_cast<GLfloat>(_x), static_cast<GLfloat>(_y), 0.0f,
+        static_cast<GLfloat>(_width), static_cast<GLfloat>(_height)
     };
 
-    crispy::copy(vertices, back_inserter(rectBuffer_));
+    cursorRects_.insert(cursorRects_.end(), instance, instance + CursorInstanceSize);
+}
+
+void OpenGLRenderer::executeCursor()
+{
+    if (cursorRects_.empty())
+        return;
+
+    cursorShader_->bind();
+    cursorShader_->setUniformValue(cursorProjectionLocation_, projectionMatrix_);
+    cursorShader_->setUniformValue(cursorScrollOffsetLocation_, scrollOffset_);
+    cursorShader_->setUniformValue(cursorTimeLocation_, time_);
+    cursorShader_->setUniformValue(cursorMoveOffsetLocation_, cursorMoveOffset_);
+    cursorShader_->setUniformValue(cursorMoveStartLocation_, cursorMoveStart_);
+    cursorShader_->setUniformValue(cursorMoveDurationLocation_, cursorMoveDuration_);
+    cursorShader_->setUniformValue(cursorColorLocation_, cursorColor_);
+    cursorShader_->setUniformValue(cursorBlinkStartLocation_, cursorBlinkStart_);
+    cursorShader_->setUniformValue(cursorBlinkIntervalLocation_, cursorBlinkInterval_);
+
+    glBindVertexArray(cursorVAO_);
+    glBindBuffer(GL_ARRAY_BUFFER, cursorVBO_);
+    glBufferData(GL_ARRAY_BUFFER,
+                 static_cast<GLsizeiptr>(cursorRects_.size() * sizeof(GLfloat)),
+                 cursorRects_.data(),
+                 GL_STREAM_DRAW);
+    glDrawArraysInstanced(GL_TRIANGLES, 0, 6, static_cast<GLsizei>(cursorRects_.size() / CursorInstanceSize));
+    ++drawCalls_;
+    uploadedBytes_ += cursorRects_.size() * sizeof(GLfloat);
+
+    cursorShader_->release();
+    glBindVertexArray(0);
+
+    cursorRects_.clear();
+}
+
+void OpenGLRenderer::renderHighlightRectangle(int _x, int _y, int _width, int _height, QVector4D const& _color)
+{
+    auto const instance = rectangleInstance(static_cast<unsigned>(_x), static_cast<unsigned>(_y),
+                                            static_cast<unsigned>(_width), static_cast<unsigned>(_height),
+                                            _color);
+    highlightRects_.insert(highlightRects_.end(), instance.begin(), instance.end());
+}
+
+void OpenGLRenderer::renderInvertedRectangle(int _x, int _y, int _width, int _height)
+{
+    auto const instance = rectangleInstance(static_cast<unsigned>(_x), static_cast<unsigned>(_y),
+                                            static_cast<unsigned>(_width), static_cast<unsigned>(_height),
+                                            QVector4D{1.0f, 1.0f, 1.0f, 1.0f});
+    invertedRects_.insert(invertedRects_.end(), instance.begin(), instance.end());
+}
+
+void OpenGLRenderer::executeHighlights()
+{
+    if (highlightRects_.empty() && invertedRects_.empty())
+        return;
+
+    rectShader_->bind();
+    rectShader_->setUniformValue(rectProjectionLocation_, projectionMatrix_);
+    rectShader_->setUniformValue(rectScrollOffsetLocation_, scrollOffset_);
+
+    glBindVertexArray(highlightVAO_);
+    glBindBuffer(GL_ARRAY_BUFFER, highlightVBO_);
+    auto const bytes = (highlightRects_.size() + invertedRects_.size()) * sizeof(GLfloat);
+    glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(bytes), nullptr, GL_STREAM_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0,
+                    static_cast<GLsizeiptr>(highlightRects_.size() * sizeof(GLfloat)),
+                    highlightRects_.data());
+    glBufferSubData(GL_ARRAY_BUFFER,
+                    static_cast<GLintptr>(highlightRects_.size() * sizeof(GLfloat)),
+                    static_cast<GLsizeiptr>(invertedRects_.size() * sizeof(GLfloat)),
+                    invertedRects_.data());
+    uploadedBytes_ += bytes;
+
+    auto const highlightCount = highlightRects_.size() / RectInstanceSize;
+    if (highlightCount)
+    {
+        bindRectangles(0);
+        glDrawArraysInstanced(GL_TRIANGLES, 0, 6, static_cast<GLsizei>(highlightCount));
+        ++drawCalls_;
+    }
+
+    if (auto const invertedCount = invertedRects_.size() / RectInstanceSize; invertedCount)
+    {
+        // The rectangles are white, turning what is below into its complement: (1 - dst) * 1 + dst * 0.
+        glBlendFuncSeparate(GL_ONE_MINUS_DST_COLOR, GL_ZERO, GL_ZERO, GL_ONE);
+        bindRectangles(highlightCount);
+        glDrawArraysInstanced(GL_TRIANGLES, 0, 6, static_cast<GLsizei>(invertedCount));
+        ++drawCalls_;
+        glBlendFuncSeparate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ONE, GL_ONE);
+    }
+
+    rectShader_->release();
+    glBindVertexArray(0);
+
+    highlightRects_.clear();
+    invertedRects_.clear();
 }
 
+void OpenGLRenderer::bindRectangles(size_t _first)
+{
+    // OpenGL ES lacks base instances, hence sub ranges are drawn by moving the attributes instead.
+    auto constexpr Stride = static_cast<GLsizei>(RectInstanceSize * sizeof(GLfloat));
+    auto const offset = [&](size_t _component) {
+        return reinterpret_cast<void const*>((_first * RectInstanceSize + _component) * sizeof(GLfloat));
+    };
+
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, Stride, offset(0)); // position
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, Stride, offset(3)); // size
+    glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, Stride, offset(5)); // color
+}
+
+void OpenGLRenderer::setSlotCount(size_t _count)
+{
+    rectBuffer_.resize(_count);
+    textureRenderer_.setSlotCount(_count);
+}
+
+void OpenGLRenderer::selectSlot(size_t _slot)
+{
+    rectBuffer_.select(_slot);
+    textureRenderer_.selectSlot(_slot);
+}
+
+void OpenGLRenderer::selectStream()
+{
+    rectBuffer_.select_stream();
+    textureRenderer_.selectStream();
+}
+
+void OpenGLRenderer::shiftSlots(long _count, int _offsetY)
+{
+    rectBuffer_.shift(_count, 1, static_cast<GLfloat>(_offsetY));
+    textureRenderer_.shiftSlots(_count, static_cast<GLfloat>(_offsetY));
+}
+
+
 void OpenGLRenderer::execute()
 {
+    drawCalls_ = 0;
+    uploadedBytes_ = 0;
+
+    if (damage_.has_value())
+    {
+        glEnable(GL_SCISSOR_TEST);
+        glScissor(damage_->x(), damage_->y(), damage_->width(), damage_->height());
+    }
+    if (clear_)
+        glClear(GL_COLOR_BUFFER_BIT);
+
     // render filled rects
     //
     if (!rectBuffer_.empty())
     {
         rectShader_->bind();
         rectShader_->setUniformValue(rectProjectionLocation_, projectionMatrix_);
+        rectShader_->setUniformValue(rectScrollOffsetLocation_, scrollOffset_);
 
         glBindVertexArray(rectVAO_);
         glBindBuffer(GL_ARRAY_BUFFER, rectVBO_);
-        glBufferData(GL_ARRAY_BUFFER, rectBuffer_.size() * sizeof(GLfloat), rectBuffer_.data(), GL_STREAM_DRAW);
-
-        glDrawArrays(GL_TRIANGLES, 0, rectBuffer_.size() / 7);
+        rectBuffer_.flush(
+            [this](size_t _size) {
+                glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(_size * sizeof(GLfloat)), nullptr, GL_DYNAMIC_DRAW);
+            },
+            [this](size_t _offset, GLfloat const* _data, size_t _count) {
+                glBufferSubData(GL_ARRAY_BUFFER,
+                                static_cast<GLintptr>(_offset * sizeof(GLfloat)),
+                                static_cast<GLsizeiptr>(_count * sizeof(GLfloat)),
+                                _data);
+                uploadedBytes_ += _count * sizeof(GLfloat);
+            }
+        );
+
+        // Each instance is expanded into the six vertices of a quad's two triangles by the vertex shader.
+        // The stream is drawn on top of the retained rows.
+        auto const slotInstanceCount = rectBuffer_.slot_vertex_count();
+        if (slotInstanceCount)
+        {
+            bindRectangles(0);
+            glDrawArraysInstanced(GL_TRIANGLES, 0, 6, static_cast<GLsizei>(slotInstanceCount));
+            ++drawCalls_;
+        }
+        if (auto const streamInstanceCount = static_cast<GLsizei>(rectBuffer_.stream_vertex_count()); streamInstanceCount)
+        {
+            bindRectangles(slotInstanceCount);
+            glDrawArraysInstanced(GL_TRIANGLES, 0, 6, streamInstanceCount);
+            ++drawCalls_;
+        }
 
         rectShader_->release();
         glBindVertexArray(0);
-        rectBuffer_.clear();
     }
 
+    rectBuffer_.clear_stream();
+
+    // render the cursor, blinking and moving by itself with the time passed in
+    //
+    executeCursor();
+
     // render textures
     //
     textShader_->bind();
@@ -216,10 +492,22 @@ void OpenGLRenderer::execute()
         static_cast<float>(cellSize_.width),
         static_cast<float>(cellSize_.height)
     ));
+    textShader_->setUniformValue(textScrollOffsetLocation_, scrollOffset_);
 
     textureRenderer_.execute();
 
     textShader_->release();
+
+    // render the highlights, such as the selection, on top of everything
+    //
+    executeHighlights();
+
+    if (damage_.has_value())
+        glDisable(GL_SCISSOR_TEST);
+
+    monochromeAtlasAllocator_.nextFrame();
+    coloredAtlasAllocator_.nextFrame();
+    glyphAtlas_->nextFrame();
 }
 
 } // end namespace
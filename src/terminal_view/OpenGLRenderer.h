@@ -13,15 +13,24 @@
  */
 #pragma once
 
+#include <terminal_view/SharedGlyphAtlas.h>
+
 #include <crispy/Atlas.h>
 #include <crispy/AtlasRenderer.h>
+#include <crispy/vertex_slots.h>
 #include <terminal/Size.h>
 
+#include <QtCore/QRect>
+
 #include <QtGui/QMatrix4x4>
 #include <QtGui/QOpenGLExtraFunctions>
 #include <QtGui/QOpenGLShaderProgram>
+#include <QtGui/QVector2D>
 
+#include <chrono>
 #include <memory>
+#include <optional>
+#include <vector>
 
 namespace terminal::view {
 
@@ -34,6 +43,7 @@ class OpenGLRenderer :
   public:
     OpenGLRenderer(ShaderConfig const& _textShaderConfig,
                    ShaderConfig const& _rectShaderConfig,
+                   ShaderConfig const& _cursorShaderConfig,
                    QMatrix4x4 const& _projectionMatrix,
                    int _leftMargin,
                    int _bottomMargin,
@@ -41,6 +51,13 @@ class OpenGLRenderer :
 
     ~OpenGLRenderer();
 
+    /// Replaces the shader programs, keeping the current ones if any of the given ones fails to build.
+    ///
+    /// @retval false any of the shaders failed to build.
+    bool setShaders(ShaderConfig const& _textShaderConfig,
+                    ShaderConfig const& _rectShaderConfig,
+                    ShaderConfig const& _cursorShaderConfig);
+
     void clearCache();
 
     constexpr void setMargin(int _left, int _bottom) noexcept { leftMargin_ = _left; bottomMargin_ = _bottom; }
@@ -48,6 +65,51 @@ class OpenGLRenderer :
     constexpr void setProjection(QMatrix4x4 const& _projectionMatrix) noexcept { projectionMatrix_ = _projectionMatrix; }
 
     void renderRectangle(unsigned _x, unsigned _y, unsigned _width, unsigned _height, QVector4D const& _color);
+
+    /// Appends the instance of a filled rectangle to @p _instances, to be rendered later by
+    /// renderRectangles(). Safe to be called from any thread.
+    static void makeRectangle(std::vector<GLfloat>& _instances,
+                              unsigned _x, unsigned _y, unsigned _width, unsigned _height,
+                              QVector4D const& _color);
+
+    /// Renders the filled rectangles of @p _instances, made by makeRectangle().
+    void renderRectangles(std::vector<GLfloat> const& _instances);
+
+    // {{{ cursor
+    /// Adds a rectangle to the cursor's shape of the current frame, drawn in the cursor's own pass.
+    void renderCursorRectangle(int _x, int _y, int _width, int _height);
+
+    void setCursorColor(QVector4D const& _color) noexcept { cursorColor_ = _color; }
+
+    /// Moves the cursor from @p _offset pixels relative to its position towards its position,
+    /// starting at @p _start seconds for @p _duration seconds.
+    void setCursorMotion(QVector2D const& _offset, float _start, float _duration) noexcept
+    {
+        cursorMoveOffset_ = _offset;
+        cursorMoveStart_ = _start;
+        cursorMoveDuration_ = _duration;
+    }
+
+    /// Blinks the cursor every @p _interval seconds since @p _start, or not at all if @p _interval is 0.
+    void setCursorBlink(float _start, float _interval) noexcept
+    {
+        cursorBlinkStart_ = _start;
+        cursorBlinkInterval_ = _interval;
+    }
+
+    /// Sets the time (in seconds) the cursor's blinking and motion are evaluated at.
+    void setTime(float _seconds) noexcept { time_ = _seconds; }
+    // }}}
+
+    // {{{ highlights
+    /// Blends @p _color over the given rectangle, drawn on top of the text with the current frame only.
+    void renderHighlightRectangle(int _x, int _y, int _width, int _height, QVector4D const& _color);
+
+    /// Inverts the colors of the given rectangle, drawn on top of the text and of the blended
+    /// highlights with the current frame only.
+    void renderInvertedRectangle(int _x, int _y, int _width, int _height);
+    // }}}
+
     void createAtlas(crispy::atlas::CreateAtlas const& _param) override;
     void uploadTexture(crispy::atlas::UploadTexture const& _param) override;
     void renderTexture(crispy::atlas::RenderTexture const& _param) override;
@@ -55,18 +117,82 @@ class OpenGLRenderer :
 
     crispy::atlas::TextureAtlasAllocator& monochromeAtlasAllocator() noexcept { return monochromeAtlasAllocator_; }
     crispy::atlas::TextureAtlasAllocator& coloredAtlasAllocator() noexcept { return coloredAtlasAllocator_; }
+    crispy::atlas::TextureAtlasAllocator const& monochromeAtlasAllocator() const noexcept { return monochromeAtlasAllocator_; }
+    crispy::atlas::TextureAtlasAllocator const& coloredAtlasAllocator() const noexcept { return coloredAtlasAllocator_; }
+
+    /// @returns the glyph atlas shared with the other windows of this process.
+    SharedGlyphAtlas& glyphAtlas() noexcept { return *glyphAtlas_; }
+    SharedGlyphAtlas const& glyphAtlas() const noexcept { return *glyphAtlas_; }
+
+    /// @returns number of atlas pages evicted so far, each invalidating the slots that referred to it.
+    uint64_t atlasEvictions() const noexcept
+    {
+        return monochromeAtlasAllocator_.evictedPages()
+             + coloredAtlasAllocator_.evictedPages()
+             + glyphAtlas_->evictedPages();
+    }
 
     void execute();
 
+    /// @returns time the most recent execute() spent creating atlases and uploading textures.
+    std::chrono::nanoseconds uploadTime() const noexcept { return textureRenderer_.uploadTime(); }
+
+    /// @returns number of draw calls issued by the most recent execute().
+    unsigned drawCalls() const noexcept { return drawCalls_ + textureRenderer_.drawCalls(); }
+
+    /// @returns number of bytes of textures and vertices uploaded by the most recent execute().
+    size_t uploadedBytes() const noexcept { return uploadedBytes_ + textureRenderer_.uploadedBytes(); }
+
+    /// @returns number of bytes of GPU memory of this window's own atlas textures.
+    size_t textureMemory() const noexcept { return textureRenderer_.textureMemory(); }
+
+    /// @returns number of bytes of GPU memory of the glyph atlas textures shared with the other windows.
+    size_t sharedTextureMemory() const noexcept { return glyphAtlas_->textures().textureMemory(); }
+
+    // {{{ retained rendering
+    /// Retains rectangles and textures across frames in @p _count slots, one per screen row.
+    void setSlotCount(size_t _count);
+    size_t slotCount() const noexcept { return rectBuffer_.slot_count(); }
+
+    /// Routes subsequent render calls into the given slot, replacing its previous contents.
+    void selectSlot(size_t _slot);
+
+    /// Routes subsequent render calls into the current frame only.
+    void selectStream();
+
+    /// Moves the retained contents by @p _count slots towards the first one, translating them by @p _offsetY pixels.
+    void shiftSlots(long _count, int _offsetY);
+
+    /// Translates everything drawn, retained or not, by @p _offsetY pixels in the vertex shaders.
+    void setScrollOffset(float _offsetY) noexcept { scrollOffset_ = _offsetY; }
+
+    /// Lets execute() clear the framebuffer first if @p _clear is set, restricting both the clearing
+    /// and all drawing to @p _area if given, leaving the rest of the previous frame in place.
+    void setDamage(bool _clear, std::optional<QRect> _area) noexcept
+    {
+        clear_ = _clear;
+        damage_ = _area;
+    }
+    // }}}
+
   private:
     void initialize();
     unsigned maxTextureDepth();
     unsigned maxTextureSize();
 
+    /// Points the rectangle attributes at the @p _first instance of the rectangle buffer.
+    void bindRectangles(size_t _first);
+
+    void executeCursor();
+    void executeHighlights();
+
   private:
     bool initialized_ = false;
     QMatrix4x4 projectionMatrix_;
 
+    bool clear_ = false;
+    std::optional<QRect> damage_;
+
     int leftMargin_ = 0;
     int bottomMargin_ = 0;
     Size cellSize_;
@@ -75,18 +201,58 @@ class OpenGLRenderer :
     int textProjectionLocation_;
     int marginLocation_;
     int cellSizeLocation_;
+    int textScrollOffsetLocation_;
 
+    // The shared glyph atlas is released last, as the texture renderer draws its textures.
+    std::shared_ptr<SharedGlyphAtlas> glyphAtlas_;
     crispy::atlas::Renderer textureRenderer_;
     crispy::atlas::TextureAtlasAllocator monochromeAtlasAllocator_;
     crispy::atlas::TextureAtlasAllocator coloredAtlasAllocator_;
 
     // filled rectangles
     //
-    std::vector<GLfloat> rectBuffer_;
+    crispy::vertex_slots<GLfloat> rectBuffer_{3 + 2 + 4}; // one instance per rectangle
     std::unique_ptr<QOpenGLShaderProgram> rectShader_;
     GLint rectProjectionLocation_;
+    GLint rectScrollOffsetLocation_;
     GLuint rectVAO_;
     GLuint rectVBO_;
+
+    // cursor, drawn on top of the filled rectangles and below the text
+    //
+    std::vector<GLfloat> cursorRects_; // one instance per rectangle
+    std::unique_ptr<QOpenGLShaderProgram> cursorShader_;
+    GLint cursorProjectionLocation_;
+    GLint cursorScrollOffsetLocation_;
+    GLint cursorTimeLocation_;
+    GLint cursorMoveOffsetLocation_;
+    GLint cursorMoveStartLocation_;
+    GLint cursorMoveDurationLocation_;
+    GLint cursorColorLocation_;
+    GLint cursorBlinkStartLocation_;
+    GLint cursorBlinkIntervalLocation_;
+    GLuint cursorVAO_;
+    GLuint cursorVBO_;
+
+    // highlights, drawn on top of the text with the filled-rectangle shader
+    //
+    std::vector<GLfloat> highlightRects_;   // one instance per rectangle, blended
+    std::vector<GLfloat> invertedRects_;    // one instance per rectangle, inverting
+    GLuint highlightVAO_;
+    GLuint highlightVBO_;
+
+    // Draw calls and uploaded bytes of the rectangles and the cursor of the most recent execute().
+    unsigned drawCalls_ = 0;
+    size_t uploadedBytes_ = 0;
+
+    float time_ = 0.0f;
+    float scrollOffset_ = 0.0f;
+    QVector4D cursorColor_;
+    QVector2D cursorMoveOffset_{0.0f, 0.0f};
+    float cursorMoveStart_ = 0.0f;
+    float cursorMoveDuration_ = 0.0f;
+    float cursorBlinkStart_ = 0.0f;
+    float cursorBlinkInterval_ = 0.0f;
 };
 
 } // end namespace
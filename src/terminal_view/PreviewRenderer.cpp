@@ -0,0 +1,243 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2020 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <terminal_view/PreviewRenderer.h>
+
+#include <crispy/hash.h>
+#include <crispy/stdfs.h>
+#include <crispy/trace.h>
+
+#include <QtGui/QImage>
+#include <QtGui/QImageReader>
+
+#include <QtCore/QSize>
+
+#include <algorithm>
+#include <string_view>
+
+using std::move;
+using std::nullopt;
+using std::optional;
+using std::pair;
+using std::scoped_lock;
+using std::string;
+using std::unique_lock;
+using std::vector;
+
+namespace terminal::view {
+
+namespace
+{
+    // Maximum width and height in pixels of a preview.
+    auto constexpr MaxPreviewSize = 256;
+
+    // Maximum size of the image files previews are made of, in bytes and in pixels.
+    auto constexpr MaxImageFileBytes = uintmax_t{64} * 1024 * 1024;
+    auto constexpr MaxImageSize = Size{8192, 8192};
+
+    // Maximum number of thumbnails kept, and their total size in bytes.
+    auto constexpr MaxThumbnails = size_t{64};
+    auto constexpr MaxThumbnailBytes = size_t{8} * 1024 * 1024;
+
+    uint64_t pathHash(string const& _path) noexcept
+    {
+        return crispy::hash_bytes(std::string_view{_path});
+    }
+}
+
+PreviewRenderer::Thumbnail PreviewRenderer::makeThumbnail(string const& _path)
+{
+    // Anything but a regular file, such as a FIFO or a terminal, may block reading forever.
+    auto ec = FileSystemError{};
+    if (!FileSystem::is_regular_file(_path, ec) || FileSystem::file_size(_path, ec) > MaxImageFileBytes || ec)
+        return {};
+
+    auto reader = QImageReader{QString::fromStdString(_path)};
+    reader.setAutoTransform(true);
+
+    // The size is read from the header, refusing images too large to be decoded, or whose size
+    // is not known without decoding them.
+    auto const imageSize = reader.size();
+    if (!imageSize.isValid() || imageSize.width() > MaxImageSize.width || imageSize.height() > MaxImageSize.height)
+        return {};
+
+    // Decoded right into the size of the preview, keeping the aspect ratio, which some formats
+    // (JPEG for one) do without decoding the image at full resolution.
+    if (imageSize.width() > MaxPreviewSize || imageSize.height() > MaxPreviewSize)
+        reader.setScaledSize(imageSize.scaled(MaxPreviewSize, MaxPreviewSize, Qt::KeepAspectRatio)
+                                      .expandedTo(QSize{1, 1}));
+
+    auto const image = reader.read().convertToFormat(QImage::Format_RGBA8888);
+    if (image.isNull())
+        return {};
+
+    auto thumbnail = Thumbnail{Size{image.width(), image.height()}, {}};
+    auto const rowBytes = static_cast<size_t>(image.width()) * 4;
+    thumbnail.pixels.resize(rowBytes * static_cast<size_t>(image.height()));
+    for (int y = 0; y < image.height(); ++y)
+        std::copy_n(image.constScanLine(y), rowBytes, thumbnail.pixels.data() + static_cast<size_t>(y) * rowBytes);
+
+    return thumbnail;
+}
+
+PreviewRenderer::PreviewRenderer(crispy::atlas::CommandListener& _commandListener,
+                                 crispy::atlas::TextureAtlasAllocator& _colorAtlasAllocator,
+                                 std::function<void()> _thumbnailMade) :
+    commandListener_{ _commandListener },
+    thumbnails_{ MaxThumbnails, MaxThumbnailBytes },
+    atlas_{ _colorAtlasAllocator },
+    thumbnailMade_{ move(_thumbnailMade) },
+    thread_{ [this]() { work(); } }
+{
+}
+
+PreviewRenderer::~PreviewRenderer()
+{
+    {
+        auto const _l = scoped_lock{mutex_};
+        quit_ = true;
+    }
+    wakeup_.notify_one();
+    thread_.join();
+}
+
+void PreviewRenderer::work()
+{
+    auto lock = unique_lock{mutex_};
+    for (;;)
+    {
+        wakeup_.wait(lock, [&]() { return quit_ || !request_.empty(); });
+        if (quit_)
+            return;
+
+        auto const path = move(request_);
+        request_.clear();
+
+        lock.unlock();
+        auto thumbnail = makeThumbnail(path);
+        lock.lock();
+
+        made_.emplace_back(path, move(thumbnail));
+
+        if (thumbnailMade_)
+        {
+            lock.unlock();
+            thumbnailMade_();
+            lock.lock();
+        }
+    }
+}
+
+void PreviewRenderer::collectThumbnails()
+{
+    auto made = vector<pair<string, Thumbnail>>{};
+    {
+        auto const _l = scoped_lock{mutex_};
+        swap(made, made_);
+    }
+
+    for (auto& [path, thumbnail] : made)
+    {
+        if (path == lastRequest_)
+            lastRequest_.clear();
+
+        auto const hash = pathHash(path);
+        auto const bytes = path.size() + thumbnail.pixels.size();
+        thumbnails_.insert(hash, path, move(thumbnail), bytes);
+
+        // Textures of thumbnails no longer kept are released, as is the one of a thumbnail
+        // replaced under the same hash.
+        auto const released = std::stable_partition(textures_.begin(), textures_.end(), [&](Texture const& _texture) {
+            return _texture.hash != hash && thumbnails_.contains(_texture.hash, _texture.path);
+        });
+        for (auto i = released; i != textures_.end(); ++i)
+        {
+            atlas_.release(i->hash);
+            textureMemory_ -= i->bytes;
+        }
+        textures_.erase(released, textures_.end());
+    }
+}
+
+optional<Size> PreviewRenderer::previewSize(string const& _path)
+{
+    collectThumbnails();
+
+    if (Thumbnail const* thumbnail = thumbnails_.find(pathHash(_path), _path); thumbnail != nullptr)
+    {
+        if (thumbnail->pixels.empty())
+            return nullopt;
+        return thumbnail->size;
+    }
+
+    if (_path != lastRequest_)
+    {
+        lastRequest_ = _path;
+        {
+            auto const _l = scoped_lock{mutex_};
+            request_ = _path;
+        }
+        wakeup_.notify_one();
+    }
+
+    return nullopt;
+}
+
+void PreviewRenderer::renderPreview(QPoint _pos, string const& _path)
+{
+    CRISPY_TRACE_ZONE("PreviewRenderer::renderPreview");
+
+    auto const hash = pathHash(_path);
+    Thumbnail const* thumbnail = thumbnails_.find(hash, _path);
+    if (!thumbnail || thumbnail->pixels.empty())
+        return;
+
+    auto const width = static_cast<unsigned>(thumbnail->size.width);
+    auto const height = static_cast<unsigned>(thumbnail->size.height);
+
+    auto texture = atlas_.get(hash);
+    if (!texture.has_value())
+    {
+        // Uploaded again after the texture has been evicted from the atlas.
+        auto const evicted = std::find_if(textures_.begin(), textures_.end(),
+                                          [&](Texture const& _texture) { return _texture.hash == hash; });
+        if (evicted != textures_.end())
+        {
+            textureMemory_ -= evicted->bytes;
+            textures_.erase(evicted);
+        }
+
+        auto constexpr colored = 1u;
+        texture = atlas_.insert(hash, width, height, width, height, GL_RGBA,
+                                crispy::atlas::Buffer(thumbnail->pixels.begin(), thumbnail->pixels.end()),
+                                colored);
+        if (!texture.has_value())
+            return;
+
+        textures_.emplace_back(Texture{hash, _path, thumbnail->pixels.size()});
+        textureMemory_ += thumbnail->pixels.size();
+    }
+
+    auto const color = QVector4D(1.0f, 1.0f, 1.0f, 1.0f); // leaves the image's colors untouched
+    crispy::atlas::TextureInfo const& info = std::get<0>(*texture).get();
+    commandListener_.renderTexture({info, _pos.x(), _pos.y(), 0, color});
+}
+
+void PreviewRenderer::clearCache()
+{
+    atlas_.clear();
+    textures_.clear();
+    textureMemory_ = 0;
+}
+
+} // end namespace
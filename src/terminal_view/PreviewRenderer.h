@@ -0,0 +1,119 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2020 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <crispy/Atlas.h>
+#include <crispy/AtlasRenderer.h>
+#include <crispy/lru_cache.h>
+
+#include <terminal/Size.h>
+
+#include <QtCore/QPoint>
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace terminal::view {
+
+/// Renders previews of local image files, such as the ones hovered hyperlinks refer to.
+///
+/// Decoding an image file takes far longer than a frame, hence the previews' thumbnails are made
+/// on a background thread, and a preview is rendered with the first frame after its thumbnail has
+/// been made, never blocking rendering. A thumbnail is decoded right into the maximum preview
+/// size, and only of regular files of a limited size.
+///
+/// The most recently used thumbnails are kept, along with their textures, such that hovering the
+/// same files again shows their previews right away.
+class PreviewRenderer
+{
+  public:
+    /// @param _thumbnailMade invoked on the background thread when a thumbnail has been made,
+    ///                      requesting another frame to be rendered.
+    PreviewRenderer(crispy::atlas::CommandListener& _commandListener,
+                    crispy::atlas::TextureAtlasAllocator& _colorAtlasAllocator,
+                    std::function<void()> _thumbnailMade);
+    ~PreviewRenderer();
+
+    PreviewRenderer(PreviewRenderer const&) = delete;
+    PreviewRenderer& operator=(PreviewRenderer const&) = delete;
+
+    /// @returns the size in pixels of the preview of the image file at the absolute path @p _path,
+    ///          or std::nullopt if its thumbnail is being made or the file is no image.
+    ///
+    /// Requests the thumbnail to be made if it has not been made yet.
+    std::optional<Size> previewSize(std::string const& _path);
+
+    /// Renders the preview of @p _path, whose size is known by previewSize(), with its bottom left
+    /// corner at @p _pos.
+    void renderPreview(QPoint _pos, std::string const& _path);
+
+    /// @returns number of bytes of preview textures uploaded.
+    size_t textureMemory() const noexcept { return textureMemory_; }
+
+    /// Releases the preview textures, which are uploaded again from the kept thumbnails when needed.
+    void clearCache();
+
+    /// RGBA pixels of an image file downscaled, or none if the file could not be decoded.
+    struct Thumbnail {
+        Size size;
+        std::vector<uint8_t> pixels;
+    };
+
+    /// Decodes the image file at @p _path downscaled to fit into the maximum preview size.
+    ///
+    /// @returns the thumbnail, without pixels if the path is no regular file, or the file is too
+    ///          large or no image.
+    static Thumbnail makeThumbnail(std::string const& _path);
+
+  private:
+
+    /// Makes the thumbnails requested, on the background thread.
+    void work();
+
+    /// Moves the thumbnails made since the last frame into the cache.
+    void collectThumbnails();
+
+    crispy::atlas::CommandListener& commandListener_;
+
+    // Thumbnails by path, with the textures of those uploaded, keyed by the hash of the path.
+    struct Texture {
+        uint64_t hash;
+        std::string path;
+        size_t bytes;
+    };
+    crispy::lru_cache<std::string, Thumbnail> thumbnails_;
+    crispy::atlas::MetadataTextureAtlas<uint64_t, int> atlas_;
+    std::vector<Texture> textures_;         // released along with their thumbnails
+    size_t textureMemory_ = 0;
+
+    std::string lastRequest_;               // the path requested last, unless made since
+
+    // state shared with the background thread
+    std::function<void()> thumbnailMade_;
+    std::mutex mutex_;
+    std::condition_variable wakeup_;
+    std::string request_;                   // only the most recent request is made, the others are dropped
+    std::vector<std::pair<std::string, Thumbnail>> made_;
+    bool quit_ = false;
+    std::thread thread_;
+};
+
+} // end namespace
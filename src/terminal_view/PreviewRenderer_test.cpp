@@ -0,0 +1,100 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2020 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <terminal_view/PreviewRenderer.h>
+
+#include <crispy/stdfs.h>
+
+#include <QtCore/QCoreApplication>
+#include <QtGui/QImage>
+
+#include <catch2/catch.hpp>
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/stat.h>
+#endif
+
+using namespace terminal;
+using terminal::view::PreviewRenderer;
+
+namespace
+{
+    std::string tempPath(std::string const& _name)
+    {
+        return (FileSystem::temp_directory_path()
+                / ("contour-PreviewRenderer_test-" + std::to_string(QCoreApplication::applicationPid()) + "-" + _name)).string();
+    }
+
+    void putLE(std::string& _out, uint32_t _value, int _bytes)
+    {
+        for (int i = 0; i < _bytes; ++i)
+            _out.push_back(static_cast<char>((_value >> (8 * i)) & 0xFF));
+    }
+}
+
+TEST_CASE("PreviewRenderer.makeThumbnail", "[preview]")
+{
+    auto const path = tempPath("image.png");
+    auto image = QImage(1024, 512, QImage::Format_RGBA8888);
+    image.fill(Qt::red);
+    REQUIRE(image.save(QString::fromStdString(path), "PNG"));
+
+    // Decoded right into the preview size, keeping the aspect ratio.
+    auto const thumbnail = PreviewRenderer::makeThumbnail(path);
+    CHECK(thumbnail.size == Size{256, 128});
+    CHECK(thumbnail.pixels.size() == 256 * 128 * 4);
+
+    FileSystem::remove(path);
+}
+
+TEST_CASE("PreviewRenderer.makeThumbnail_oversized", "[preview]")
+{
+    // The header of a 50000x50000 BMP file, without its pixels, is refused before decoding.
+    auto const path = tempPath("oversized.bmp");
+    auto header = std::string{"BM"};
+    putLE(header, 54, 4);                       // file size, as far as written
+    putLE(header, 0, 4);                        // reserved
+    putLE(header, 54, 4);                       // offset of the pixels
+    putLE(header, 40, 4);                       // size of the info header
+    putLE(header, 50000, 4);                    // width
+    putLE(header, 50000, 4);                    // height
+    putLE(header, 1, 2);                        // planes
+    putLE(header, 24, 2);                       // bits per pixel
+    putLE(header, 0, 4);                        // uncompressed
+    for (int i = 0; i < 5; ++i)
+        putLE(header, 0, 4);                    // image size, resolution, colors
+    std::ofstream{path, std::ios::binary} << header;
+
+    auto const thumbnail = PreviewRenderer::makeThumbnail(path);
+    CHECK(thumbnail.pixels.empty());
+
+    FileSystem::remove(path);
+}
+
+#if defined(__unix__) || defined(__APPLE__)
+TEST_CASE("PreviewRenderer.makeThumbnail_fifo", "[preview]")
+{
+    // Opening a FIFO without a writer blocks, hence it is not opened at all.
+    auto const path = tempPath("fifo");
+    REQUIRE(mkfifo(path.c_str(), 0600) == 0);
+
+    auto const thumbnail = PreviewRenderer::makeThumbnail(path);
+    CHECK(thumbnail.pixels.empty());
+
+    FileSystem::remove(path);
+}
+#endif
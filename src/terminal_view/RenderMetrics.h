@@ -1,4 +1,7 @@
 #pragma once
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
 #include <string>
 
 #include <fmt/format.h>
@@ -6,24 +9,89 @@
 namespace terminal::view {
 
 struct RenderMetrics {
-    unsigned cellBackgroundRenderCount = 0;
+    unsigned cellBackgroundRenderCount = 0; //!< number of background rectangles rendered
     unsigned cachedText = 0; //!< number of text words that were rendered using the cache.
     unsigned shapedText = 0; //!< number of text segments that went through text shaping
+    unsigned reshapedText = 0; //!< number of text segments shaped by re-shaping only what changed of them
+
+    unsigned shapingCacheHits = 0;      //!< number of text shaping cache lookups that hit
+    unsigned shapingCacheMisses = 0;    //!< number of text shaping cache lookups that missed
+    unsigned shapingCacheEvictions = 0; //!< number of entries evicted from the text shaping cache
+    unsigned shapingCacheSize = 0;      //!< current number of entries in the text shaping cache
+    size_t shapingCacheBytes = 0;       //!< current size of the text shaping cache in bytes
+    unsigned missingGlyphs = 0;         //!< number of glyphs left blank while being rasterized in the background
+    unsigned rasterizedGlyphs = 0;      //!< number of glyphs uploaded after being rasterized in the background
+
+    size_t imageCount = 0;              //!< current number of images in the screen's image pool
+    size_t imageBytes = 0;              //!< current size of the image pool's pixel data in bytes
+    uint64_t deduplicatedImages = 0;    //!< total number of images found in the image pool already
+    uint64_t evictedImages = 0;         //!< total number of images whose pixel data has been evicted
+    size_t imageTextureBytes = 0;       //!< current size of the uploaded image textures in bytes
+    uint64_t imageTextureEvictions = 0; //!< total number of images whose textures have been released
+
+    // Time spent per stage of the most recent frame.
+    std::chrono::nanoseconds lockWaitTime{};    //!< waiting for the terminal's screen lock
+    std::chrono::nanoseconds cellWalkTime{};    //!< copying and walking the cells into render commands, except for shaping
+    std::chrono::nanoseconds shapingTime{};     //!< shaping text missing in the text shaping cache
+    std::chrono::nanoseconds atlasUploadTime{}; //!< creating atlases and uploading glyph and image textures
+    std::chrono::nanoseconds submitTime{};      //!< issuing the draw calls, except for the atlas uploads
+
+    unsigned drawCalls = 0;             //!< number of draw calls issued by the most recent frame
+    size_t uploadedBytes = 0;           //!< bytes of textures and vertices uploaded by the most recent frame
 
     constexpr void clear() noexcept
     {
         cellBackgroundRenderCount = 0;
         shapedText = 0;
+        reshapedText = 0;
         cachedText = 0;
+        shapingCacheHits = 0;
+        shapingCacheMisses = 0;
+        shapingCacheEvictions = 0;
+        missingGlyphs = 0;
+        rasterizedGlyphs = 0;
+        lockWaitTime = {};
+        cellWalkTime = {};
+        shapingTime = {};
+        atlasUploadTime = {};
+        submitTime = {};
+        drawCalls = 0;
+        uploadedBytes = 0;
     }
 
     std::string to_string() const
     {
         return fmt::format(
-            "background renders: {}, shaped text: {}, cached text: {}",
+            "background renders: {}, shaped text: {}, re-shaped text: {}, cached text: {}, "
+            "shaping cache: {} hits, {} misses, {} evictions, {} entries, {} bytes, "
+            "glyphs: {} missing, {} rasterized, "
+            "images: {} images, {} bytes, {} deduplicated, {} evicted, {} texture bytes, {} texture evictions, "
+            "frame: {} us lock wait, {} us cell walk, {} us shaping, {} us atlas uploads, {} us submit, "
+            "{} draw calls, {} bytes uploaded",
             cellBackgroundRenderCount,
             shapedText,
-            cachedText
+            reshapedText,
+            cachedText,
+            shapingCacheHits,
+            shapingCacheMisses,
+            shapingCacheEvictions,
+            shapingCacheSize,
+            shapingCacheBytes,
+            missingGlyphs,
+            rasterizedGlyphs,
+            imageCount,
+            imageBytes,
+            deduplicatedImages,
+            evictedImages,
+            imageTextureBytes,
+            imageTextureEvictions,
+            std::chrono::duration_cast<std::chrono::microseconds>(lockWaitTime).count(),
+            std::chrono::duration_cast<std::chrono::microseconds>(cellWalkTime).count(),
+            std::chrono::duration_cast<std::chrono::microseconds>(shapingTime).count(),
+            std::chrono::duration_cast<std::chrono::microseconds>(atlasUploadTime).count(),
+            std::chrono::duration_cast<std::chrono::microseconds>(submitTime).count(),
+            drawCalls,
+            uploadedBytes
         );
     }
 };
@@ -0,0 +1,77 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2020 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <terminal/Screen.h>
+
+#include <optional>
+#include <vector>
+
+namespace terminal::view {
+
+/**
+ * Copy of the screen rows to be rendered with a frame.
+ *
+ * The snapshot is taken while the terminal is locked, such that turning it into render commands
+ * does not block the terminal from processing further output. Rows are kept across frames,
+ * so that their buffers are reused rather than reallocated for every frame.
+ */
+class RenderSnapshot {
+  public:
+    struct Row {
+        int row = 0;                    //!< screen row number
+        std::optional<Cell> blankCell;  //!< set if the whole row consists of this cell
+        std::vector<Cell> cells;        //!< the row's cells, unless blankCell is set
+        bool hasImages = false;         //!< whether any of the cells shows an image fragment
+    };
+
+    using const_iterator = std::vector<Row>::const_iterator;
+
+    /// Discards all rows, releasing their cells (and thereby any images referred to).
+    void clear()
+    {
+        for (size_t i = 0; i < size_; ++i)
+        {
+            rows_[i].blankCell.reset();
+            rows_[i].cells.clear();
+            rows_[i].hasImages = false;
+        }
+        size_ = 0;
+    }
+
+    /// Appends an empty row for the given screen row number.
+    Row& beginRow(int _row)
+    {
+        if (size_ == rows_.size())
+            rows_.emplace_back();
+        auto& row = rows_[size_++];
+        row.row = _row;
+        return row;
+    }
+
+    bool empty() const noexcept { return size_ == 0; }
+    size_t size() const noexcept { return size_; }
+
+    Row& back() noexcept { return rows_[size_ - 1]; }
+    Row const& operator[](size_t _index) const noexcept { return rows_[_index]; }
+
+    const_iterator begin() const noexcept { return rows_.begin(); }
+    const_iterator end() const noexcept { return std::next(rows_.begin(), static_cast<std::ptrdiff_t>(size_)); }
+
+  private:
+    std::vector<Row> rows_;
+    size_t size_ = 0;
+};
+
+} // end namespace
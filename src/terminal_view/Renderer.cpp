@@ -14,15 +14,82 @@
 #include <terminal_view/Renderer.h>
 #include <terminal_view/TextRenderer.h>
 
+#include <crispy/allocation_tracker.h>
+#include <crispy/trace.h>
+
+#include <QtCore/QSysInfo>
+#include <QtCore/QUrl>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
 #include <functional>
+#include <limits>
+#include <thread>
+#include <utility>
 
+using std::move;
+using std::nullopt;
 using std::scoped_lock;
+using std::unique_lock;
 using std::chrono::steady_clock;
 using std::optional;
 using std::tuple;
+using std::vector;
 
 namespace terminal::view {
 
+namespace
+{
+    // Minimum number of rows to be rendered for their text to be shaped in parallel.
+    auto constexpr ParallelShapingMinRows = size_t{8};
+
+    // Minimum number of rows to be rendered for their backgrounds to be made in parallel, and
+    // the number of rows each thread takes at a time.
+    auto constexpr ParallelBackgroundMinRows = size_t{16};
+    auto constexpr BackgroundRowsPerJob = size_t{8};
+    auto constexpr MaxBackgroundThreads = 4u;
+
+    // Maximum number of columns the cursor glides over when moved within its row.
+    auto constexpr MaxCursorGlideColumns = 3;
+
+    // Number of rows above and below each changed one that are presented along with it, covering
+    // glyphs and decorations reaching into neighboring rows.
+    auto constexpr DamagePaddingRows = 1;
+
+    // Opacity of the selection background blended over selected cells, if configured (the
+    // selection inverts the cells otherwise), and of the color blended over search matches.
+    auto constexpr SelectionOpacity = 0.5f;
+    auto constexpr SearchHighlightOpacity = 0.3f;
+
+    /// @returns the absolute path of the file on this host that @p _hyperlink refers to, or an empty string.
+    std::string localFilePath(HyperlinkInfo const& _hyperlink)
+    {
+        // Paths detected in the text come without a scheme, of which only absolute ones are known.
+        if (_hyperlink.scheme().empty())
+            return _hyperlink.uri.size() > 1 && _hyperlink.uri.front() == '/' ? _hyperlink.uri : std::string{};
+
+        if (!_hyperlink.isLocal())
+            return {};
+
+        static auto const hostName = QSysInfo::machineHostName().toStdString();
+        auto const host = _hyperlink.host();
+        if (!host.empty() && host != "localhost" && host != hostName)
+            return {};
+
+        // The path is percent-encoded, as in any URI, for names with spaces or non-ASCII characters.
+        auto const path = _hyperlink.path();
+        return QUrl::fromPercentEncoding(QByteArray(path.data(), static_cast<int>(path.size()))).toStdString();
+    }
+
+    /// @returns the fraction of the cursor motion left at @p _progress, easing out as the cursor shader does.
+    float remainingMotion(float _progress) noexcept
+    {
+        return std::pow(1.0f - std::min(std::max(_progress, 0.0f), 1.0f), 3.0f);
+    }
+}
+
 Renderer::Renderer(Logger _logger,
                    Size const& _screenSize,
                    FontConfig const& _fonts,
@@ -32,7 +99,9 @@ Renderer::Renderer(Logger _logger,
                    Decorator _hyperlinkHover,
                    ShaderConfig const& _backgroundShaderConfig,
                    ShaderConfig const& _textShaderConfig,
-                   QMatrix4x4 const& _projectionMatrix) :
+                   ShaderConfig const& _cursorShaderConfig,
+                   QMatrix4x4 const& _projectionMatrix,
+                   std::function<void()> _glyphsRasterized) :
     screenCoordinates_{
         _screenSize,
         _fonts.regular.first.get().maxAdvance(), // cell width
@@ -46,12 +115,14 @@ Renderer::Renderer(Logger _logger,
     renderTarget_{
         _textShaderConfig,
         _backgroundShaderConfig,
+        _cursorShaderConfig,
         _projectionMatrix,
         0, // TODO left margin
         0, // TODO bottom margin
         {}, // TODO _cellSize?
     },
     backgroundRenderer_{
+        metrics_,
         screenCoordinates_,
         _colorProfile.defaultBackground,
         renderTarget_
@@ -61,14 +132,20 @@ Renderer::Renderer(Logger _logger,
         renderTarget_.coloredAtlasAllocator(),
         cellSize()
     },
+    previewRenderer_{
+        renderTarget_,
+        renderTarget_.coloredAtlasAllocator(),
+        _glyphsRasterized
+    },
     textRenderer_{
         metrics_,
         renderTarget_,
-        renderTarget_.monochromeAtlasAllocator(),
-        renderTarget_.coloredAtlasAllocator(),
+        renderTarget_.glyphAtlas(),
         screenCoordinates_,
         _fonts,
-        cellSize()
+        cellSize(),
+        frameArena_,
+        move(_glyphsRasterized)
     },
     decorationRenderer_{
         renderTarget_,
@@ -83,29 +160,50 @@ Renderer::Renderer(Logger _logger,
     },
     cursorRenderer_{
         renderTarget_,
-        renderTarget_.monochromeAtlasAllocator(),
         screenCoordinates_,
         CursorShape::Block, // TODO: should not be hard-coded; actual value be passed via render(terminal, now);
         canonicalColor(_colorProfile.cursor)
-    }
+    },
+    backgroundPool_{ std::clamp(std::thread::hardware_concurrency(), 1u, MaxBackgroundThreads) },
+    epoch_{ steady_clock::now() }
 {
 }
 
 void Renderer::discardImage(Image const& _image)
 {
-    imageRenderer_.discardImage(_image);
+    // Images are discarded by the screen, while the render thread may be using the image renderer.
+    auto const _l = scoped_lock{discardedImagesMutex_};
+    discardedImages_.emplace_back(_image.id());
+}
+
+void Renderer::releaseDiscardedImages()
+{
+    auto discardedImages = vector<Image::Id>{};
+    {
+        auto const _l = scoped_lock{discardedImagesMutex_};
+        swap(discardedImages, discardedImages_);
+    }
+
+    if (discardedImages.empty())
+        return;
+
+    for (Image::Id const imageId : discardedImages)
+        imageRenderer_.discardImage(imageId);
+
+    redrawAll_ = true;
 }
 
 void Renderer::clearCache()
 {
     renderTarget_.clearCache();
+    redrawAll_ = true;
 
     // TODO(?): below functions are actually doing the same again and again and again. delete them (and their functions for that)
     // either that, or only the render target is allowed to clear the actual atlas caches.
     decorationRenderer_.clearCache();
-    cursorRenderer_.clearCache();
     textRenderer_.clearCache();
     imageRenderer_.clearCache();
+    previewRenderer_.clearCache();
 }
 
 void Renderer::setFont(FontConfig const& _fonts)
@@ -146,11 +244,23 @@ bool Renderer::setFontSize(int _fontSize)
     textRenderer_.setCellSize(cellSize());
     imageRenderer_.setCellSize(cellSize());
 
-    clearCache();
+    // Unlike clearCache(), the text shaped at the previous size is kept for switching back.
+    textRenderer_.updateFontSize();
+    renderTarget_.clearCache();
+    decorationRenderer_.clearCache();
+    imageRenderer_.clearCache();
+    previewRenderer_.clearCache();
+    redrawAll_ = true;
 
     return true;
 }
 
+void Renderer::setDistanceFieldGlyphs(bool _enabled)
+{
+    textRenderer_.setDistanceFieldGlyphs(_enabled);
+    redrawAll_ = true;
+}
+
 void Renderer::setProjection(QMatrix4x4 const& _projectionMatrix)
 {
     renderTarget_.setProjection(_projectionMatrix);
@@ -159,6 +269,7 @@ void Renderer::setProjection(QMatrix4x4 const& _projectionMatrix)
 void Renderer::setBackgroundOpacity(terminal::Opacity _opacity)
 {
     backgroundOpacity_ = _opacity;
+    redrawAll_ = true;
 }
 
 void Renderer::setColorProfile(terminal::ColorProfile const& _colors)
@@ -167,6 +278,89 @@ void Renderer::setColorProfile(terminal::ColorProfile const& _colors)
     backgroundRenderer_.setDefaultColor(_colors.defaultBackground);
     decorationRenderer_.setColorProfile(_colors);
     cursorRenderer_.setColor(canonicalColor(colorProfile_.cursor));
+    resolvedColors_.clear();
+    redrawAll_ = true;
+}
+
+std::pair<RGBColor, RGBColor> Renderer::resolveColors(Cell const& _cell, bool _reverseVideo)
+{
+    // Cells of the same attributes share their colors, which are therefore resolved once
+    // per attributes and color profile, rather than per cell and frame.
+    auto const id = _cell.attributesId();
+    if (id == GraphicsAttributesTable::InvalidId)
+        return _cell.attributes().makeColors(colorProfile_, _reverseVideo);
+
+    auto const index = static_cast<size_t>(id) * 2 + (_reverseVideo ? 1 : 0);
+    if (index >= resolvedColors_.size())
+        resolvedColors_.resize(index + 1);
+
+    ResolvedColors& resolved = resolvedColors_[index];
+    if (!resolved.valid)
+    {
+        std::tie(resolved.foreground, resolved.background) = _cell.attributes().makeColors(colorProfile_, _reverseVideo);
+        resolved.valid = true;
+    }
+    return std::pair{resolved.foreground, resolved.background};
+}
+
+std::pair<RGBColor, RGBColor> Renderer::resolveColorsConcurrently(Cell const& _cell, bool _reverseVideo) const
+{
+    auto const id = _cell.attributesId();
+    auto const index = static_cast<size_t>(id) * 2 + (_reverseVideo ? 1 : 0);
+    if (id != GraphicsAttributesTable::InvalidId && index < resolvedColors_.size() && resolvedColors_[index].valid)
+        return std::pair{resolvedColors_[index].foreground, resolvedColors_[index].background};
+
+    auto const [fg, bg] = _cell.attributes().makeColors(colorProfile_, _reverseVideo);
+    return std::pair{fg, bg};
+}
+
+void Renderer::makeBackgrounds(bool _reverseVideo, int _columnCount)
+{
+    if (rowBackgrounds_.size() < renderTarget_.slotCount() + 1)
+        rowBackgrounds_.resize(renderTarget_.slotCount() + 1);
+
+    auto const jobCount = (snapshot_.size() + BackgroundRowsPerJob - 1) / BackgroundRowsPerJob;
+    auto rectangleCount = std::atomic<unsigned>{0};
+    backgroundPool_.run(jobCount, [&](size_t _job) {
+        auto metrics = RenderMetrics{};
+        auto background = BackgroundRenderer{metrics, screenCoordinates_, backgroundRenderer_.defaultColor(), renderTarget_};
+        background.setOpacity(backgroundRenderer_.opacity());
+
+        auto const end = std::min((_job + 1) * BackgroundRowsPerJob, snapshot_.size());
+        for (auto i = _job * BackgroundRowsPerJob; i < end; ++i)
+        {
+            RenderSnapshot::Row const& row = snapshot_[i];
+            auto& instances = rowBackgrounds_[static_cast<size_t>(row.row)];
+            instances.clear();
+            background.setOutput(&instances);
+
+            auto const renderCell = [&](int _column, Cell const& _cell) {
+                auto const bg = resolveColorsConcurrently(_cell, _reverseVideo).second;
+                background.renderCell(Coordinate{row.row, _column}, bg);
+            };
+
+            // The same cells as passed to the backgrounds by the cell walk, see renderSnapshot.
+            if (!row.blankCell.has_value())
+            {
+                for (int column = 1; column <= static_cast<int>(row.cells.size()); ++column)
+                    renderCell(column, row.cells[static_cast<size_t>(column - 1)]);
+            }
+            else if (!row.blankCell->empty())
+            {
+                for (int column = 1; column <= _columnCount; ++column)
+                    renderCell(column, *row.blankCell);
+            }
+            else
+            {
+                auto const bg = resolveColorsConcurrently(*row.blankCell, _reverseVideo).second;
+                background.renderOnce(Coordinate{row.row, 1}, bg, static_cast<unsigned>(_columnCount));
+            }
+            background.renderPendingCells();
+            background.finish();
+        }
+        rectangleCount += metrics.cellBackgroundRenderCount;
+    });
+    metrics_.cellBackgroundRenderCount += rectangleCount;
 }
 
 uint64_t Renderer::render(Terminal& _terminal,
@@ -174,19 +368,51 @@ uint64_t Renderer::render(Terminal& _terminal,
                           terminal::Coordinate const& _currentMousePosition,
                           bool _pressure)
 {
+    CRISPY_TRACE_ZONE("Renderer::render");
+    CRISPY_ALLOCATION_SCOPE(render);
+
+    auto const start = steady_clock::now();
     metrics_.clear();
 
     screenCoordinates_.screenSize = _terminal.screenSize();
 
+    releaseDiscardedImages();
+    imageRenderer_.beginFrame();
+
     uint64_t const changes = renderInternalNoFlush(_terminal, _now, _currentMousePosition, _pressure);
 
     backgroundRenderer_.renderPendingCells();
     backgroundRenderer_.finish();
 
+    decorationRenderer_.renderPendingCells();
+
     textRenderer_.flushPendingSegments();
     textRenderer_.finish();
 
+    renderOverlay();
+    renderHighlights();
+    auto const preview = renderPreview();
+
+    // Overlays and previews are drawn at any position, on top of any rows.
+    if (!overlay_.empty() || lastOverlay_ || preview || lastPreview_)
+        fullDamage_ = true;
+    lastOverlay_ = !overlay_.empty();
+    lastPreview_ = preview;
+
+    if (partialPresentation_)
+        renderTarget_.setDamage(true, fullDamage_ ? nullopt : optional<QRect>{damage_});
+
+    auto const submitStart = steady_clock::now();
     renderTarget_.execute();
+    frameArena_.reset();
+
+    metrics_.atlasUploadTime = renderTarget_.uploadTime();
+    metrics_.submitTime = steady_clock::now() - submitStart - metrics_.atlasUploadTime;
+    metrics_.drawCalls = renderTarget_.drawCalls();
+    metrics_.uploadedBytes = renderTarget_.uploadedBytes();
+    metrics_.cellWalkTime = submitStart - start - metrics_.lockWaitTime - metrics_.shapingTime;
+    metrics_.imageTextureBytes = imageRenderer_.textureMemory();
+    metrics_.imageTextureEvictions = imageRenderer_.textureEvictions();
 
     return changes;
 }
@@ -199,92 +425,717 @@ uint64_t Renderer::renderInternalNoFlush(Terminal& _terminal,
     auto const pressure = _pressure && _terminal.screen().isPrimaryScreen();
     textRenderer_.setPressure(pressure);
 
-    auto _l = scoped_lock{_terminal};
-    auto const reverseVideo = _terminal.screen().isModeEnabled(terminal::Mode::ReverseVideo);
-    auto const baseLine = _terminal.viewport().absoluteScrollOffset().value_or(_terminal.screen().historyLineCount());
+    // The terminal is locked only while taking a snapshot of the rows to be rendered, such that
+    // the screen can be updated concurrently with turning the snapshot into render commands.
+    auto const lockStart = steady_clock::now();
+    auto lock = unique_lock{_terminal};
+    metrics_.lockWaitTime += steady_clock::now() - lockStart;
+    auto& screen = _terminal.screen();
+
+    // Accumulates the area of the rows rendered and the cursor moved in, both before and after.
+    fullDamage_ = false;
+    damage_ = QRect{};
+    auto const damageRow = [&](int _y) {
+        auto const cellHeight = screenCoordinates_.cellSize.height;
+        damage_ |= QRect{0, _y - DamagePaddingRows * cellHeight,
+                         std::numeric_limits<int>::max() / 2, (1 + 2 * DamagePaddingRows) * cellHeight};
+    };
+    auto const damageCursor = [&]() {
+        if (lastCursorPosition_.has_value())
+            damageRow(lastCursorPosition_->y());
+    };
+
+    // The screen is the back buffer of a synchronized update, hence the retained rows and the
+    // cursor of the previous frame are presented again. The damage accumulates meanwhile, such
+    // that the whole update is picked up at once by the first frame after it.
+    if (_terminal.synchronizedOutputRemaining(_now).count() > 0)
+    {
+        lock.unlock();
+        renderTarget_.selectStream();
+        renderTarget_.setTime(seconds(_now));
+        if (lastCursorPosition_.has_value())
+            cursorRenderer_.render(*lastCursorPosition_, lastCursorWidth_);
+        // The retained rows are presented as they are, all of them if they are to be redrawn.
+        fullDamage_ = redrawAll_;
+        damageCursor();
+        return 0;
+    }
 
-    renderCursor(_terminal);
+    auto const reverseVideo = screen.isModeEnabled(terminal::Mode::ReverseVideo);
+    auto const& viewport = _terminal.viewport();
+    auto const scrollOffset = viewport.absoluteScrollOffset();
+    auto const columnCount = screen.size().width;
 
-    auto const renderHyperlinks = !pressure && _terminal.screen().contains(_currentMousePosition);
+    metrics_.imageCount = screen.imagePool().imageCount();
+    metrics_.imageBytes = screen.imagePool().memoryUsage();
+    metrics_.deduplicatedImages = screen.imagePool().deduplicatedImageCount();
+    metrics_.evictedImages = screen.imagePool().evictedImageCount();
 
+    // The cursor is not retained, but rendered in its own pass on every frame.
+    renderTarget_.selectStream();
+    damageCursor();
+    renderCursor(_terminal, _now);
+    damageCursor();
+
+    auto const renderHyperlinks = !pressure && screen.contains(_currentMousePosition);
+
+    auto hoveredHyperlink = HyperlinkId{0};
     if (renderHyperlinks)
+        hoveredHyperlink = screen.at(_currentMousePosition).hyperlink(); // TODO: Left-Ctrl pressed?
+
+    // URLs and file paths detected in the text are hovered just like explicit hyperlinks.
+    auto implicitHyperlink = optional<Screen::ImplicitHyperlink>{};
+    if (renderHyperlinks && !hoveredHyperlink)
     {
-        auto& cellAtMouse = _terminal.screen().at(_currentMousePosition);
-        if (cellAtMouse.hyperlink())
-            cellAtMouse.hyperlink()->state = HyperlinkState::Hover; // TODO: Left-Ctrl pressed?
+        implicitHyperlink = screen.implicitHyperlinkAt(Coordinate{viewport.absoluteRow(_currentMousePosition.row), _currentMousePosition.column});
+        if (implicitHyperlink.has_value())
+            hoveredHyperlink = implicitHyperlink->hyperlink;
     }
+    decorationRenderer_.setHoveredHyperlink(hoveredHyperlink);
+
+    previewPath_.clear();
+    previewPosition_ = _currentMousePosition;
+    if (hoveredHyperlink)
+        if (auto const* hyperlink = screen.hyperlinks().get(hoveredHyperlink); hyperlink != nullptr)
+            previewPath_ = localFilePath(*hyperlink);
 
     auto const changes = _terminal.preRender(_now);
 
-    _terminal.screen().render(
-        [&](Coordinate const& _pos, Cell const& _cell) {
-            auto const absolutePos = Coordinate{baseLine + _pos.row, _pos.column};
-            auto const selected = _terminal.isSelectedAbsolute(absolutePos);
-            renderCell(_pos, _cell, reverseVideo, selected);
-        },
-        _terminal.viewport().absoluteScrollOffset()
-    );
+    // Glyphs rasterized in the background have been left blank in the rows they were needed in.
+    if (textRenderer_.uploadRasterizedGlyphs())
+        redrawAll_ = true;
 
-    if (renderHyperlinks)
+    // Atlas pages evicted since the last frame, which other windows sharing the glyph atlas may
+    // do, cause all rows to be rendered. The selection is drawn on top of the rows instead, see
+    // renderHighlights(), and hovering a hyperlink renders only the rows referring to it, see below.
+    // One more slot than the screen's height holds the row partially scrolled into the bottom of
+    // the viewport while the top row is partially scrolled out of it by the viewport's pixel offset.
+    auto const slotCount = static_cast<size_t>(screen.size().height + 1);
+    auto const extraRow = scrollOffset.has_value() && viewport.pixelOffset() > 0;
+    auto const lastRow = screen.size().height + (extraRow ? 1 : 0);
+    redrawAll_ = redrawAll_
+              || slotCount != renderTarget_.slotCount()
+              || renderTarget_.atlasEvictions() != lastAtlasEvictions_;
+
+    // A scrolled viewport does not follow the screen's damage. As long as neither the screen nor
+    // the history have changed, scrolling moves the retained rows instead, rendering only the rows
+    // scrolled into the viewport.
+    auto const relativeScrollOffset = viewport.relativeScrollOffset();
+    auto scrolledRows = 0;
+    if (scrollOffset.has_value() || lastScrollOffset_.has_value())
+    {
+        if (screen.damagedRows().has_value() || screen.scrolledLines() != 0
+                || screen.historyLineCount() != lastHistoryLineCount_
+                || screen.foldChanges() != lastFoldChanges_
+                || std::abs(relativeScrollOffset - lastRelativeScrollOffset_) >= screen.size().height)
+            redrawAll_ = true;
+        else
+            scrolledRows = relativeScrollOffset - lastRelativeScrollOffset_;
+    }
+    auto const lastScrollOffset = lastScrollOffset_;
+    auto const lastExtraRow = lastExtraRow_;
+    auto const lastHoveredHyperlink = lastHoveredHyperlink_;
+    lastHoveredHyperlink_ = hoveredHyperlink;
+    lastScrollOffset_ = scrollOffset;
+    lastRelativeScrollOffset_ = relativeScrollOffset;
+    lastHistoryLineCount_ = screen.historyLineCount();
+    lastFoldChanges_ = screen.foldChanges();
+    lastExtraRow_ = extraRow;
+
+    // Moving the retained rows or the pixel offset changes all of them on screen.
+    fullDamage_ = scrolledRows != 0 || screen.scrolledLines() != 0
+               || viewport.pixelOffset() != 0 || lastPixelOffset_ != 0;
+    lastPixelOffset_ = viewport.pixelOffset();
+#if !defined(LIBTERMINAL_VIEW_NATURAL_COORDS) || !LIBTERMINAL_VIEW_NATURAL_COORDS
+    fullDamage_ = true; // The damage is tracked in the framebuffer's bottom-up coordinates only.
+#endif
+
+    // The pixel offset moves all rows (and the cursor) on the GPU.
+    auto const rowOffsetY = screenCoordinates_.map(1, 1).y() - screenCoordinates_.map(1, 2).y();
+    renderTarget_.setScrollOffset(static_cast<float>(rowOffsetY > 0 ? viewport.pixelOffset() : -viewport.pixelOffset()));
+
+    if (redrawAll_)
+    {
+        if (slotCount != renderTarget_.slotCount())
+        {
+            renderTarget_.setSlotCount(slotCount);
+            slotHyperlinks_.resize(slotCount);
+        }
+    }
+    else if (scrolledRows != 0)
+        shiftSlots(-scrolledRows, rowOffsetY * -scrolledRows);
+    else if (auto const n = screen.scrolledLines(); n != 0)
+        shiftSlots(n, screenCoordinates_.map(1, 1).y() - screenCoordinates_.map(1, 1 + n).y());
+
+    // Hovering a hyperlink (or no longer doing so) changes its decoration, so the rows retained
+    // with cells referring to the hyperlink hovered before or now are rendered again, as are the
+    // rows of a URL or file path detected in the text, whose cells refer to it once captured.
+    hoveredRows_.clear();
+    if (!redrawAll_ && hoveredHyperlink != lastHoveredHyperlink)
+    {
+        for (int row = 1; row <= lastRow; ++row)
+        {
+            auto const& hyperlinks = slotHyperlinks_[static_cast<size_t>(row - 1)];
+            auto const refersTo = [&](HyperlinkId _hyperlink) {
+                return _hyperlink && std::find(hyperlinks.begin(), hyperlinks.end(), _hyperlink) != hyperlinks.end();
+            };
+            auto const absoluteRow = viewport.absoluteRow(row);
+            if (refersTo(lastHoveredHyperlink) || refersTo(hoveredHyperlink)
+                    || (implicitHyperlink.has_value()
+                        && implicitHyperlink->from.row <= absoluteRow && absoluteRow <= implicitHyperlink->to.row))
+                hoveredRows_.push_back(row);
+        }
+    }
+
+    // Copies the rows to be rendered (all of them or the damaged ones) into the snapshot.
+    auto const takeSnapshot = [&]() {
+        snapshot_.clear();
+
+        auto absoluteRow = 0;
+        auto const captureCell = [&](Coordinate const& _pos, Cell const& _cell) {
+            if (snapshot_.empty() || snapshot_.back().row != _pos.row)
+            {
+                snapshot_.beginRow(_pos.row);
+                absoluteRow = viewport.absoluteRow(_pos.row);
+            }
+            auto& row = snapshot_.back();
+            row.cells.push_back(_cell);
+            if (_cell.imageFragment().has_value())
+                row.hasImages = true;
+            if (implicitHyperlink.has_value())
+            {
+                auto const position = Coordinate{absoluteRow, _pos.column};
+                if (implicitHyperlink->from <= position && position <= implicitHyperlink->to)
+                    row.cells.back().setHyperlink(implicitHyperlink->hyperlink);
+            }
+        };
+        auto const captureBlankLine = [&](int _row, Cell const& _blankCell) {
+            auto& row = snapshot_.beginRow(_row);
+            row.blankCell = _blankCell;
+            row.hasImages = _blankCell.imageFragment().has_value();
+        };
+        if (redrawAll_)
+            screen.render(captureCell, captureBlankLine, scrollOffset, Margin::Range{1, lastRow});
+        else if (scrollOffset.has_value() || lastScrollOffset.has_value())
+        {
+            // Scrolling up exposes the top rows, scrolling down the bottom ones, which include the
+            // row below the screen unless it has been empty before.
+            if (scrolledRows > 0)
+                screen.render(captureCell, captureBlankLine, scrollOffset, Margin::Range{1, scrolledRows});
+            else if (scrolledRows < 0)
+                screen.render(captureCell, captureBlankLine, scrollOffset,
+                              Margin::Range{static_cast<int>(slotCount) + scrolledRows + (lastExtraRow ? 1 : 0), lastRow});
+            else if (extraRow && !lastExtraRow)
+                screen.render(captureCell, captureBlankLine, scrollOffset, Margin::Range{lastRow, lastRow});
+        }
+        else if (auto const damage = screen.damagedRows(); damage.has_value())
+            for (int row = damage->from; row <= damage->to; ++row)
+                if (screen.isLineDamaged(row))
+                    screen.renderLine(row, captureCell, captureBlankLine);
+
+        // Each row is captured at most once, as each row's backgrounds may be made concurrently.
+        if (!redrawAll_)
+        {
+            for (int const row : hoveredRows_)
+            {
+                auto const captured = std::any_of(snapshot_.begin(), snapshot_.end(),
+                                                  [&](RenderSnapshot::Row const& _row) { return _row.row == row; });
+                if (!captured)
+                    screen.render(captureCell, captureBlankLine, scrollOffset, Margin::Range{row, row});
+            }
+        }
+    };
+
+    takeSnapshot();
+    screen.clearDamage();
+
+    // Changing the highlights leaves the retained rows as they are, but changes them on screen.
+    if (collectHighlights(_terminal, lastRow))
+        fullDamage_ = true;
+    lock.unlock();
+
+    // Passes every cell of the snapshot to @p _renderCell(pos, cell), except for blank lines,
+    // which are passed as a whole to @p _renderBlankLine(row, cell).
+    auto const renderSnapshot = [&](auto const& _renderCell, auto const& _renderBlankLine) {
+        for (RenderSnapshot::Row const& row : snapshot_)
+        {
+            if (!row.blankCell.has_value())
+            {
+                for (int column = 1; column <= static_cast<int>(row.cells.size()); ++column)
+                    _renderCell(Coordinate{row.row, column}, row.cells[static_cast<size_t>(column - 1)]);
+            }
+            else if (!row.blankCell->empty())
+            {
+                for (int column = 1; column <= columnCount; ++column)
+                    _renderCell(Coordinate{row.row, column}, *row.blankCell);
+            }
+            else
+                _renderBlankLine(row.row, *row.blankCell);
+        }
+    };
+
+    int currentRow = 0;
+    auto const selectRow = [&](int _row) {
+        if (_row != currentRow)
+        {
+            flushRow();
+            currentRow = _row;
+            renderTarget_.selectSlot(static_cast<size_t>(currentRow - 1));
+            if (backgroundsMade_)
+                renderTarget_.renderRectangles(rowBackgrounds_[static_cast<size_t>(currentRow)]);
+        }
+    };
+
+    // Blank lines are rendered as a single run.
+    auto const renderBlankLine = [&](int _row, Cell const& _blankCell) {
+        selectRow(_row);
+        if (!backgroundsMade_)
+        {
+            auto const bg = resolveColors(_blankCell, reverseVideo).second;
+            backgroundRenderer_.renderOnce({_row, 1}, bg, static_cast<unsigned>(columnCount));
+        }
+        decorationRenderer_.renderCell({_row, 1}, _blankCell, columnCount);
+    };
+
+    // Renders the cells of each row with the loop specialized for what the frame and row need,
+    // and blank lines as a single run, just like renderSnapshot() passes them.
+    auto const renderRows = [&]() {
+        for (RenderSnapshot::Row const& row : snapshot_)
+        {
+            rememberHyperlinks(row);
+            if (row.blankCell.has_value() && row.blankCell->empty())
+            {
+                renderBlankLine(row.row, *row.blankCell);
+                continue;
+            }
+            selectRow(row.row);
+            auto const renderRowCells = rowRenderer(reverseVideo, row.hasImages, backgroundsMade_);
+            (this->*renderRowCells)(row, columnCount);
+        }
+    };
+
+    // The backgrounds of many rows are made on multiple threads up front.
+    backgroundsMade_ = snapshot_.size() >= ParallelBackgroundMinRows && backgroundPool_.thread_count() > 1;
+    if (backgroundsMade_)
+        makeBackgrounds(reverseVideo, columnCount);
+
+    // Shapes the text missing in the cache for all rows to be rendered up front, in parallel,
+    // by passing the exact same cells and colors to the text renderer first.
+    if (snapshot_.size() >= ParallelShapingMinRows && textRenderer_.shapesInParallel())
+    {
+        auto const prefetchCell = [&](Coordinate const& _pos, Cell const& _cell) {
+            textRenderer_.schedule(_pos, _cell, resolveColors(_cell, reverseVideo).first);
+        };
+        auto const prefetchBlankLine = [](int, Cell const&) {};
+        textRenderer_.beginPrefetch();
+        renderSnapshot(prefetchCell, prefetchBlankLine);
+        textRenderer_.shapePrefetched();
+    }
+
+    auto const atlasEvictions = renderTarget_.atlasEvictions();
+    auto const imageTextureEvictions = imageRenderer_.textureEvictions();
+    renderRows();
+
+    // Evicting atlas pages or image textures invalidates retained rows referring to them,
+    // so all rows are rendered again.
+    auto const evicted = renderTarget_.atlasEvictions() != atlasEvictions
+                      || imageRenderer_.textureEvictions() != imageTextureEvictions;
+    if (evicted && !redrawAll_)
     {
-        auto& cellAtMouse = _terminal.screen().at(_currentMousePosition);
-        if (cellAtMouse.hyperlink())
-            cellAtMouse.hyperlink()->state = HyperlinkState::Inactive;
+        flushRow();
+        currentRow = 0;
+        redrawAll_ = true;
+        backgroundsMade_ = false;
+        auto const relockStart = steady_clock::now();
+        lock.lock();
+        metrics_.lockWaitTime += steady_clock::now() - relockStart;
+        takeSnapshot();
+        lock.unlock();
+        renderRows();
     }
+    fullDamage_ = fullDamage_ || redrawAll_;
+    redrawAll_ = false;
+    backgroundsMade_ = false;
+    lastAtlasEvictions_ = renderTarget_.atlasEvictions();
+
+    for (RenderSnapshot::Row const& row : snapshot_)
+        damageRow(screenCoordinates_.map(1, row.row).y());
+
+    // Selecting the row below the screen clears it once no longer scrolled into the viewport.
+    if (lastExtraRow && !extraRow)
+    {
+        slotHyperlinks_[slotCount - 1].clear();
+        selectRow(static_cast<int>(slotCount));
+        damageRow(screenCoordinates_.map(1, static_cast<int>(slotCount)).y());
+    }
+
+    flushRow();
+    renderTarget_.selectStream();
 
     return changes;
 }
 
-void Renderer::renderCursor(Terminal const& _terminal)
+void Renderer::shiftSlots(long _count, int _offsetY)
+{
+    renderTarget_.shiftSlots(_count, _offsetY);
+
+    // The same as the slots' contents, with no hyperlinks for those left empty.
+    auto const n = static_cast<long>(slotHyperlinks_.size());
+    auto const count = std::clamp(_count, -n, n);
+    if (count > 0)
+    {
+        std::rotate(slotHyperlinks_.begin(), std::next(slotHyperlinks_.begin(), count), slotHyperlinks_.end());
+        for (auto i = n - count; i < n; ++i)
+            slotHyperlinks_[static_cast<size_t>(i)].clear();
+    }
+    else if (count < 0)
+    {
+        std::rotate(slotHyperlinks_.begin(), std::next(slotHyperlinks_.begin(), n + count), slotHyperlinks_.end());
+        for (auto i = 0; i < -count; ++i)
+            slotHyperlinks_[static_cast<size_t>(i)].clear();
+    }
+}
+
+void Renderer::rememberHyperlinks(RenderSnapshot::Row const& _row)
+{
+    auto& hyperlinks = slotHyperlinks_[static_cast<size_t>(_row.row - 1)];
+    hyperlinks.clear();
+
+    auto const remember = [&](Cell const& _cell) {
+        auto const hyperlink = _cell.hyperlink();
+        if (hyperlink && std::find(hyperlinks.begin(), hyperlinks.end(), hyperlink) == hyperlinks.end())
+            hyperlinks.push_back(hyperlink);
+    };
+
+    if (_row.blankCell.has_value())
+        remember(*_row.blankCell);
+    for (Cell const& cell : _row.cells)
+        remember(cell);
+}
+
+void Renderer::flushRow()
+{
+    backgroundRenderer_.renderPendingCells();
+    backgroundRenderer_.finish();
+
+    decorationRenderer_.renderPendingCells();
+
+    textRenderer_.flushPendingSegments();
+    textRenderer_.finish();
+}
+
+void Renderer::setOverlay(vector<std::string> const& _lines)
+{
+    overlay_.clear();
+    for (auto const& line : _lines)
+        overlay_.emplace_back(unicode::from_utf8(line));
+}
+
+void Renderer::renderOverlay()
+{
+    if (overlay_.empty())
+        return;
+
+    // The overlay is not retained, but drawn into the stream with every frame. Its text is shaped
+    // cell by cell, so that numbers changing with every frame do not fill up the shaping cache.
+    renderTarget_.selectStream();
+    textRenderer_.setPressure(true);
+
+    auto const columnCount = screenCoordinates_.screenSize.width;
+    auto const rowCount = std::min(static_cast<int>(overlay_.size()), screenCoordinates_.screenSize.height);
+    auto width = 0;
+    for (auto const& line : overlay_)
+        width = std::max(width, static_cast<int>(line.size()));
+    width = std::min(width, columnCount);
+    auto const firstColumn = columnCount - width + 1;
+
+    // Drawn in the default colors swapped, to stand out from the text below.
+    auto const attributes = GraphicsAttributes{};
+    auto const foreground = colorProfile_.defaultBackground;
+    auto const background = colorProfile_.defaultForeground;
+
+    for (int row = 1; row <= rowCount; ++row)
+    {
+        auto const& line = overlay_[static_cast<size_t>(row - 1)];
+        backgroundRenderer_.renderOnce({row, firstColumn}, background, static_cast<unsigned>(width));
+        for (int i = 0; i < std::min(static_cast<int>(line.size()), width); ++i)
+            textRenderer_.schedule({row, firstColumn + i}, Cell{line[static_cast<size_t>(i)], attributes}, foreground);
+        flushRow();
+    }
+}
+
+void Renderer::setSearchHighlights(vector<Selector::Range> _ranges)
+{
+    searchHighlights_ = move(_ranges);
+    std::stable_sort(searchHighlights_.begin(), searchHighlights_.end(),
+                     [](auto const& _a, auto const& _b) { return _a.line < _b.line; });
+}
+
+bool Renderer::collectHighlights(Terminal const& _terminal, int _lastRow)
+{
+    lastHighlights_.swap(highlights_);
+    highlights_.clear();
+    selectedCells_.clear();
+
+    auto const selectionAvailable = _terminal.isSelectionAvailable();
+    if (!selectionAvailable && searchHighlights_.empty())
+        return highlights_ != lastHighlights_;
+
+    auto const& viewport = _terminal.viewport();
+    auto const& screen = _terminal.screen();
+    auto const columnCount = screen.size().width;
+    auto const addHighlight = [&](int _row, Selector::Range const& _range, bool _selected) {
+        auto const toColumn = std::min(_range.toColumn, columnCount);
+        if (_range.fromColumn <= toColumn)
+            highlights_.emplace_back(Highlight{_row, _range.fromColumn, toColumn, _selected});
+    };
+
+    // Rows are looked up one by one, as folded history lines make the rows' absolute numbers skip.
+    for (int row = 1; row <= _lastRow; ++row)
+    {
+        auto const absoluteRow = viewport.absoluteRow(row);
+
+        auto const [first, last] = std::equal_range(
+            searchHighlights_.begin(), searchHighlights_.end(), Selector::Range{absoluteRow, 0, 0},
+            [](auto const& _a, auto const& _b) { return _a.line < _b.line; });
+        for (auto match = first; match != last; ++match)
+            addHighlight(row, *match, false);
+
+        if (selectionAvailable)
+            if (auto const selected = _terminal.selectedColumnsAbsolute(absoluteRow); selected.has_value())
+            {
+                addHighlight(row, *selected, true);
+                if (colorProfile_.selectionForeground.has_value())
+                    captureSelectedCells(screen, viewport.absoluteScrollOffset(), row, *selected);
+            }
+    }
+
+    selectedReverseVideo_ = screen.isModeEnabled(terminal::Mode::ReverseVideo);
+    return highlights_ != lastHighlights_;
+}
+
+void Renderer::captureSelectedCells(Screen const& _screen, optional<int> _scrollOffset, int _row,
+                                    Selector::Range const& _columns)
 {
-    bool const shouldDisplayCursor = _terminal.screen().cursor().visible
-        && (_terminal.cursorDisplay() == CursorDisplay::Steady || _terminal.cursorBlinkActive());
+    auto const selected = [&](int _column) {
+        return _columns.fromColumn <= _column && _column <= _columns.toColumn;
+    };
+    auto const captureCell = [&](Coordinate const& _pos, Cell const& _cell) {
+        if (selected(_pos.column))
+            selectedCells_.emplace_back(_pos, _cell);
+    };
+    auto const captureBlankLine = [&](int, Cell const& _blankCell) {
+        for (int column = 1; column <= _screen.size().width; ++column)
+            if (selected(column))
+                selectedCells_.emplace_back(Coordinate{_row, column}, _blankCell);
+    };
+    _screen.render(captureCell, captureBlankLine, _scrollOffset, Margin::Range{_row, _row});
+}
+
+void Renderer::renderHighlights()
+{
+    auto const searchColor = [&]() {
+        auto color = canonicalColor(colorProfile_.selectionBackground.value_or(colorProfile_.defaultForeground));
+        color.setW(SearchHighlightOpacity);
+        return color;
+    }();
+
+    for (Highlight const& highlight : highlights_)
+    {
+        auto const pos = screenCoordinates_.map(highlight.fromColumn, highlight.row);
+        auto const width = (highlight.toColumn - highlight.fromColumn + 1) * screenCoordinates_.cellSize.width;
+        auto const height = screenCoordinates_.cellSize.height;
+
+        if (!highlight.selected)
+            renderTarget_.renderHighlightRectangle(pos.x(), pos.y(), width, height, searchColor);
+        else if (colorProfile_.selectionForeground.has_value())
+            continue; // The selected cells are drawn again below.
+        else if (colorProfile_.selectionBackground.has_value())
+        {
+            auto color = canonicalColor(*colorProfile_.selectionBackground);
+            color.setW(SelectionOpacity);
+            renderTarget_.renderHighlightRectangle(pos.x(), pos.y(), width, height, color);
+        }
+        else
+            renderTarget_.renderInvertedRectangle(pos.x(), pos.y(), width, height);
+    }
+
+    // With a selection foreground color, the selected cells are drawn again on top, with their
+    // colors replaced just like the text is colored with, which a blended rectangle cannot do.
+    if (selectedCells_.empty())
+        return;
+
+    for (auto const& [pos, cell] : selectedCells_)
+    {
+        auto const fg = resolveColors(cell, selectedReverseVideo_).first;
+        backgroundRenderer_.renderCell(pos, colorProfile_.selectionBackground.value_or(fg));
+        decorationRenderer_.renderCell(pos, cell);
+        textRenderer_.schedule(pos, cell, *colorProfile_.selectionForeground);
+    }
+    flushRow();
+}
+
+bool Renderer::renderPreview()
+{
+    if (previewPath_.empty())
+        return false;
+
+    // Requests the thumbnail to be made in the background, if it has not been made yet, in which
+    // case the preview is rendered with the frame requested once it has.
+    auto const size = previewRenderer_.previewSize(previewPath_);
+    if (!size.has_value())
+        return false;
+
+    // Below and right of the hovered cell, or above or left of it if the screen ends before.
+    auto const cell = screenCoordinates_.map(previewPosition_);
+    auto const cellSize = screenCoordinates_.cellSize;
+    auto const screenWidth = screenCoordinates_.leftMargin + screenCoordinates_.screenSize.width * cellSize.width;
+
+    auto x = cell.x() + cellSize.width;
+    if (x + size->width > screenWidth)
+        x = std::max(cell.x() - size->width, 0);
+
+    auto y = cell.y() - size->height;
+    if (y < screenCoordinates_.bottomMargin)
+        y = cell.y() + cellSize.height;
+
+    renderTarget_.selectStream();
+    previewRenderer_.renderPreview(QPoint{x, y}, previewPath_);
+    return true;
+}
+
+void Renderer::renderCursor(Terminal const& _terminal, steady_clock::time_point _now)
+{
+    renderTarget_.setTime(seconds(_now));
 
     // TODO: check if CursorStyle has changed, and update render context accordingly.
-    if (shouldDisplayCursor && _terminal.viewport().isLineVisible(_terminal.screen().cursor().position.row))
+    if (!_terminal.screen().cursor().visible
+            || !_terminal.viewport().isLineVisible(_terminal.screen().cursor().position.row))
     {
-        Cell const& cursorCell = _terminal.screen().at(_terminal.screen().cursor().position);
+        lastCursorPosition_ = nullopt;
+        return;
+    }
 
-        auto const cursorShape = _terminal.screen().focused() ? _terminal.cursorShape()
-                                                              : CursorShape::Rectangle;
+    // The blink phase is evaluated by the shader, based on the time the cursor has become visible at.
+    if (cursorBlinking_ && _terminal.cursorDisplay() == CursorDisplay::Blink)
+    {
+        auto const interval = std::chrono::duration<float>(_terminal.cursorBlinkInterval()).count();
+        auto const visibleSince = seconds(_terminal.lastCursorBlink()) - (_terminal.cursorBlinkActive() ? 0.0f : interval);
+        renderTarget_.setCursorBlink(visibleSince, interval);
+    }
+    else
+        renderTarget_.setCursorBlink(0.0f, 0.0f);
 
-        cursorRenderer_.setShape(cursorShape);
+    auto const position = screenCoordinates_.map(
+        _terminal.screen().cursor().position.column,
+        _terminal.screen().cursor().position.row + _terminal.viewport().relativeScrollOffset()
+    );
 
-        cursorRenderer_.render(
-            screenCoordinates_.map(
-                _terminal.screen().cursor().position.column,
-                _terminal.screen().cursor().position.row + _terminal.viewport().relativeScrollOffset()
-            ),
-            cursorCell.width()
-        );
+    // A cursor moved by a few columns within its row glides from where it is currently displayed,
+    // including any motion in progress, whereas any other move is instant.
+    auto const glides = lastCursorPosition_.has_value()
+                     && *lastCursorPosition_ != position
+                     && lastCursorPosition_->y() == position.y()
+                     && std::abs(lastCursorPosition_->x() - position.x()) <= MaxCursorGlideColumns * screenCoordinates_.cellSize.width;
+    if (glides && cursorMotionDuration_.count() > 0)
+    {
+        auto const duration = std::chrono::duration<float>(cursorMotionDuration_).count();
+        auto const remaining = remainingMotion((seconds(_now) - seconds(cursorMoveStart_)) / duration);
+        auto const displayed = *lastCursorPosition_ + cursorMoveOffset_ * remaining;
+        cursorMoveOffset_ = displayed - position;
+        cursorMoveStart_ = _now;
     }
+    else if (!lastCursorPosition_.has_value() || *lastCursorPosition_ != position)
+        cursorMoveOffset_ = QPoint{};
+    lastCursorPosition_ = position;
+
+    renderTarget_.setCursorMotion(
+        QVector2D(static_cast<float>(cursorMoveOffset_.x()), static_cast<float>(cursorMoveOffset_.y())),
+        seconds(cursorMoveStart_),
+        std::chrono::duration<float>(cursorMotionDuration_).count()
+    );
+
+    Cell const& cursorCell = _terminal.screen().at(_terminal.screen().cursor().position);
+
+    auto const cursorShape = _terminal.screen().focused() ? _terminal.cursorShape()
+                                                          : CursorShape::Rectangle;
+
+    lastCursorWidth_ = cursorCell.width();
+    cursorRenderer_.setShape(cursorShape);
+    cursorRenderer_.render(position, lastCursorWidth_);
 }
 
-tuple<RGBColor, RGBColor> makeColors(ColorProfile const& _colorProfile, Cell const& _cell, bool _reverseVideo, bool _selected)
+template <bool ReverseVideo, bool Images, bool BackgroundsMade>
+void Renderer::renderRowCells(RenderSnapshot::Row const& _row, int _columnCount)
 {
-    auto const [fg, bg] = _cell.attributes().makeColors(_colorProfile, _reverseVideo);
-    if (!_selected)
-        return tuple{fg, bg};
+    auto const renderCell = [&](int _column, Cell const& _cell) {
+        auto const pos = Coordinate{_row.row, _column};
+        auto const [fg, bg] = resolveColors(_cell, ReverseVideo);
+
+        if constexpr (!BackgroundsMade)
+            backgroundRenderer_.renderCell(pos, bg);
+        decorationRenderer_.renderCell(pos, _cell);
+        textRenderer_.schedule(pos, _cell, fg);
 
-    auto const a = _colorProfile.selectionForeground.value_or(bg);
-    auto const b = _colorProfile.selectionBackground.value_or(fg);
-    return tuple{a, b};
+        if constexpr (Images)
+            if (optional<ImageFragment> const& fragment = _cell.imageFragment(); fragment.has_value())
+                imageRenderer_.renderImage(screenCoordinates_.map(pos), fragment.value());
+    };
+
+    if (!_row.blankCell.has_value())
+    {
+        for (int column = 1; column <= static_cast<int>(_row.cells.size()); ++column)
+            renderCell(column, _row.cells[static_cast<size_t>(column - 1)]);
+    }
+    else
+    {
+        for (int column = 1; column <= _columnCount; ++column)
+            renderCell(column, *_row.blankCell);
+    }
 }
 
-void Renderer::renderCell(Coordinate const& _pos, Cell const& _cell, bool _reverseVideo, bool _selected)
+template <size_t... Flags>
+constexpr std::array<Renderer::RowRenderer, sizeof...(Flags)> Renderer::makeRowRenderers(std::index_sequence<Flags...>)
 {
-    auto const [fg, bg] = makeColors(colorProfile_, _cell, _reverseVideo, _selected);
+    return {
+        &Renderer::renderRowCells<(Flags & 1) != 0, (Flags & 2) != 0, (Flags & 4) != 0>...
+    };
+}
 
-    backgroundRenderer_.renderCell(_pos, bg);
-    decorationRenderer_.renderCell(_pos, _cell);
-    textRenderer_.schedule(_pos, _cell, fg);
-    if (optional<ImageFragment> const& fragment = _cell.imageFragment(); fragment.has_value())
-        imageRenderer_.renderImage(screenCoordinates_.map(_pos), fragment.value());
+Renderer::RowRenderer Renderer::rowRenderer(bool _reverseVideo, bool _images, bool _backgroundsMade) noexcept
+{
+    static constexpr auto renderers = makeRowRenderers(std::make_index_sequence<8>{});
+    return renderers[(_reverseVideo ? 1 : 0) | (_images ? 2 : 0) | (_backgroundsMade ? 4 : 0)];
 }
 
 void Renderer::dumpState(std::ostream& _textOutput) const
 {
     textRenderer_.debugCache(_textOutput);
+    _textOutput << fmt::format("{}\n{}\n", renderTarget_.monochromeAtlasAllocator(), renderTarget_.coloredAtlasAllocator());
+}
+
+RendererMemoryUsage Renderer::memoryUsage() const noexcept
+{
+    auto usage = RendererMemoryUsage{};
+    usage.shapingCache = textRenderer_.shapingCacheMemoryUsage();
+    usage.textures = renderTarget_.textureMemory();
+    usage.glyphTextures = renderTarget_.sharedTextureMemory();
+    return usage;
+}
+
+AtlasOccupancy Renderer::atlasOccupancy() const noexcept
+{
+    auto const& glyphs = renderTarget_.glyphAtlas().monochromeAllocator();
+    auto const& colorGlyphs = renderTarget_.glyphAtlas().colorAllocator();
+    auto const& distanceFields = renderTarget_.glyphAtlas().distanceFieldAllocator();
+    auto const& images = renderTarget_.coloredAtlasAllocator();
+
+    auto occupancy = AtlasOccupancy{};
+    occupancy.glyphs = glyphs.fillRatio();
+    occupancy.colorGlyphs = colorGlyphs.fillRatio();
+    occupancy.images = images.fillRatio();
+    occupancy.pages = glyphs.pageCount() + colorGlyphs.pageCount() + distanceFields.pageCount() + images.pageCount();
+    return occupancy;
 }
 
 } // end namespace
@@ -17,6 +17,8 @@
 #include <terminal_view/CursorRenderer.h>
 #include <terminal_view/DecorationRenderer.h>
 #include <terminal_view/ImageRenderer.h>
+#include <terminal_view/PreviewRenderer.h>
+#include <terminal_view/RenderSnapshot.h>
 #include <terminal_view/TextRenderer.h>
 
 #include <terminal_view/RenderMetrics.h>
@@ -28,12 +30,20 @@
 #include <terminal/Logger.h>
 #include <terminal/Terminal.h>
 
+#include <crispy/arena.h>
+#include <crispy/parallel_for.h>
 #include <crispy/text/Font.h>
 
 #include <fmt/format.h>
 
+#include <array>
 #include <chrono>
+#include <functional>
 #include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <tuple>
 #include <vector>
 #include <utility>
 
@@ -41,6 +51,24 @@ namespace terminal::view {
 
 struct ShaderConfig;
 
+/// Approximate number of bytes held by a Renderer, by kind of storage.
+struct RendererMemoryUsage {
+    size_t shapingCache = 0;        ///< cached text shaping results
+    size_t textures = 0;            ///< GPU memory of this window's atlases, such as images
+    size_t glyphTextures = 0;       ///< GPU memory of the glyph atlases, shared by all windows
+
+    size_t total() const noexcept { return shapingCache + textures + glyphTextures; }
+};
+
+/// Fill of the texture atlases used by a Renderer, as the ratio of the area covered by textures
+/// to the area of the pages in use.
+struct AtlasOccupancy {
+    float glyphs = 0.0f;            ///< monochrome glyphs, shared by all windows
+    float colorGlyphs = 0.0f;       ///< colored glyphs such as emoji, shared by all windows
+    float images = 0.0f;            ///< this window's images
+    size_t pages = 0;               ///< number of 2D pages in use, across all of the above
+};
+
 /**
  * Renders a terminal's screen to the current OpenGL context.
  */
@@ -52,6 +80,8 @@ class Renderer {
      * @p _fonts reference to the set of loaded fonts to be used for rendering text.
      * @p _colorProfile user-configurable color profile to use to map terminal colors to.
      * @p _projectionMatrix projection matrix to apply to the rendered scene when rendering the screen.
+     * @p _glyphsRasterized invoked on a background thread when glyphs missing on screen, or the preview of
+     *                      a hovered hyperlink, have become available, requesting another frame to be rendered.
      */
     Renderer(Logger _logger,
              Size const& _screenSize,
@@ -62,7 +92,9 @@ class Renderer {
              Decorator _hyperlinkHover,
              ShaderConfig const& _backgroundShaderConfig,
              ShaderConfig const& _textShaderConfig,
-             QMatrix4x4 const& _projectionMatrix);
+             ShaderConfig const& _cursorShaderConfig,
+             QMatrix4x4 const& _projectionMatrix,
+             std::function<void()> _glyphsRasterized);
 
     int cellHeight() const noexcept { return fonts_.regular.first.get().lineHeight(); }
     int cellWidth() const noexcept { return fonts_.regular.first.get().maxAdvance(); }
@@ -74,6 +106,52 @@ class Renderer {
     bool setFontSize(int _fontSize);
     void setProjection(QMatrix4x4 const& _projectionMatrix);
 
+    /// Replaces the shaders, e.g. when edited on disk, keeping the current ones on failure.
+    bool setShaders(ShaderConfig const& _backgroundShaderConfig,
+                    ShaderConfig const& _textShaderConfig,
+                    ShaderConfig const& _cursorShaderConfig)
+    {
+        if (!renderTarget_.setShaders(_textShaderConfig, _backgroundShaderConfig, _cursorShaderConfig))
+            return false;
+        redrawAll_ = true;
+        return true;
+    }
+    void setGlyphCacheDirectory(FileSystem::path _directory) { textRenderer_.setGlyphCacheDirectory(std::move(_directory)); }
+
+    /// Renders text from distance fields scaled to the font size, see TextRenderer::setDistanceFieldGlyphs().
+    void setDistanceFieldGlyphs(bool _enabled);
+
+    /// Lets each frame clear and draw only the rows changed since the previous frame, which must
+    /// have been left in the framebuffer, rather than the whole framebuffer.
+    ///
+    /// The framebuffer is then cleared by render(), instead of by the caller.
+    void setPartialPresentation(bool _enabled) noexcept
+    {
+        partialPresentation_ = _enabled;
+        renderTarget_.setDamage(_enabled, std::nullopt);
+        redrawAll_ = true;
+    }
+
+    /// Renders all rows again with the next frame, such as when the framebuffer has been cleared
+    /// in a different color.
+    void redrawAll() noexcept { redrawAll_ = true; }
+
+    /// Sets the duration of the cursor gliding from its previous position to its current one,
+    /// or 0 for moving it instantly.
+    void setCursorMotionDuration(std::chrono::milliseconds _duration) noexcept { cursorMotionDuration_ = _duration; }
+
+    /// Enables or disables blinking of a blinking cursor, which is shown steadily otherwise, such
+    /// as while the terminal is idle and not rendering frames for blinking.
+    void setCursorBlinking(bool _enabled) noexcept { cursorBlinking_ = _enabled; }
+
+    /// @returns whether the cursor is still moving at @p _now, requiring further frames to be rendered.
+    bool cursorAnimating(std::chrono::steady_clock::time_point _now) const noexcept
+    {
+        return lastCursorPosition_.has_value()
+            && !cursorMoveOffset_.isNull()
+            && _now - cursorMoveStart_ < cursorMotionDuration_;
+    }
+
     void setHyperlinkDecoration(Decorator _normal, Decorator _hover)
     {
         decorationRenderer_.setHyperlinkDecoration(_normal, _hover);
@@ -82,6 +160,7 @@ class Renderer {
     constexpr void setScreenSize(Size const& _screenSize) noexcept
     {
         screenCoordinates_.screenSize = _screenSize;
+        redrawAll_ = true;
     }
 
     constexpr void setMargin(int _leftMargin, int _bottomMargin) noexcept
@@ -89,6 +168,7 @@ class Renderer {
         renderTarget_.setMargin(_leftMargin, _bottomMargin);
         screenCoordinates_.leftMargin = _leftMargin;
         screenCoordinates_.bottomMargin = _bottomMargin;
+        redrawAll_ = true;
     }
 
     /**
@@ -103,6 +183,14 @@ class Renderer {
 
     RenderMetrics const& metrics() const noexcept { return metrics_; }
 
+    /// Draws @p _lines on top of the top right corner of the screen with every frame,
+    /// or nothing if empty, such as the performance HUD.
+    void setOverlay(std::vector<std::string> const& _lines);
+
+    /// Highlights the cells of @p _ranges (in absolute coordinates, see Search::ranges()),
+    /// such as the matches of a search, or none if empty.
+    void setSearchHighlights(std::vector<Selector::Range> _ranges);
+
     // Converts given RGBColor with its given opacity to a 4D-vector of values between 0.0 and 1.0
     static constexpr QVector4D canonicalColor(RGBColor const& _rgb, Opacity _opacity = Opacity::Opaque)
     {
@@ -114,12 +202,20 @@ class Renderer {
         };
     }
 
+    /// Releases the textures of the given image with the next frame. Safe to invoke from any thread.
     void discardImage(Image const& _image);
 
+    /// Sets the maximum number of bytes of image textures to keep, or 0 for no limit.
+    void setMaxImageTextureMemory(size_t _bytes) noexcept { imageRenderer_.setMaxTextureMemory(_bytes); }
+
     void clearCache();
 
     void dumpState(std::ostream& _textOutput) const;
 
+    RendererMemoryUsage memoryUsage() const noexcept;
+
+    AtlasOccupancy atlasOccupancy() const noexcept;
+
   private:
     /// Invoked internally by render() function.
     uint64_t renderInternalNoFlush(Terminal& _terminal,
@@ -127,8 +223,79 @@ class Renderer {
                                    terminal::Coordinate const& _currentMousePosition,
                                    bool _pressure);
 
-    void renderCell(Coordinate const& _pos, Cell const& _cell, bool _reverseVideo, bool _selected);
-    void renderCursor(Terminal const& _terminal);
+    using RowRenderer = void (Renderer::*)(RenderSnapshot::Row const&, int);
+
+    /// Renders the cells of @p _row, whose decisions common to all cells of the row (and of the
+    /// frame) are made at compile time, rather than per cell.
+    ///
+    /// @param ReverseVideo     whether the screen is in reverse video mode
+    /// @param Images           whether any cell of the row shows an image fragment
+    /// @param BackgroundsMade  whether the row's backgrounds have been made by makeBackgrounds()
+    template <bool ReverseVideo, bool Images, bool BackgroundsMade>
+    void renderRowCells(RenderSnapshot::Row const& _row, int _columnCount);
+
+    template <size_t... Flags>
+    static constexpr std::array<RowRenderer, sizeof...(Flags)> makeRowRenderers(std::index_sequence<Flags...>);
+
+    /// @returns the instance of renderRowCells() for the given flags.
+    static RowRenderer rowRenderer(bool _reverseVideo, bool _images, bool _backgroundsMade) noexcept;
+
+    /// @returns the foreground and background color of the given cell.
+    std::pair<RGBColor, RGBColor> resolveColors(Cell const& _cell, bool _reverseVideo);
+
+    /// Same as resolveColors(), but safe to be called from multiple threads at once, as long as
+    /// resolveColors() is not, as the colors resolved are not remembered.
+    std::pair<RGBColor, RGBColor> resolveColorsConcurrently(Cell const& _cell, bool _reverseVideo) const;
+
+    /// Makes the background rectangles of all rows of the snapshot on the background pool,
+    /// into rowBackgrounds_.
+    void makeBackgrounds(bool _reverseVideo, int _columnCount);
+    void renderCursor(Terminal const& _terminal, std::chrono::steady_clock::time_point _now);
+
+    /// @returns the seconds passed since the renderer was constructed, as passed to the shaders.
+    float seconds(std::chrono::steady_clock::time_point _time) const noexcept
+    {
+        return std::chrono::duration<float>(_time - epoch_).count();
+    }
+
+    /// Releases the textures of the images discarded since the last frame.
+    void releaseDiscardedImages();
+
+    /// Flushes any pending background and text runs, which must not span multiple rows.
+    void flushRow();
+
+    /// Moves the retained rows, see OpenGLRenderer::shiftSlots(), along with their slotHyperlinks_.
+    void shiftSlots(long _count, int _offsetY);
+
+    /// Remembers the hyperlinks referred to by the cells of @p _row, as rendered into its slot.
+    void rememberHyperlinks(RenderSnapshot::Row const& _row);
+
+    /// Renders the overlay's lines into the stream, drawn on top of the retained rows.
+    void renderOverlay();
+
+    /// Collects the selected and search-highlighted cells of the screen rows up to @p _lastRow
+    /// into highlights_, while the terminal is locked.
+    ///
+    /// @retval true the highlights have changed since the previous frame.
+    bool collectHighlights(Terminal const& _terminal, int _lastRow);
+
+    /// Copies the cells of the selected @p _columns of screen row @p _row into selectedCells_,
+    /// while the terminal is locked.
+    void captureSelectedCells(Screen const& _screen, std::optional<int> _scrollOffset, int _row,
+                              Selector::Range const& _columns);
+
+    /// Renders highlights_ on top of the retained rows and the text, such that changing the
+    /// selection or the search does not render any rows again.
+    ///
+    /// The selected cells are drawn again in the selection colors if a selection foreground
+    /// color is configured, and blended with the selection background color (or inverted) otherwise.
+    void renderHighlights();
+
+    /// Renders the preview of the image file the hovered hyperlink refers to next to the mouse,
+    /// if its thumbnail has been made.
+    ///
+    /// @retval true a preview has been rendered.
+    bool renderPreview();
 
   private:
     RenderMetrics metrics_;
@@ -139,15 +306,102 @@ class Renderer {
     ColorProfile colorProfile_;
     Opacity backgroundOpacity_;
 
+    /// Colors of the interned graphics attributes, resolved against colorProfile_,
+    /// indexed by attributes id and reverse video mode.
+    struct ResolvedColors {
+        RGBColor foreground;
+        RGBColor background;
+        bool valid = false;
+    };
+    std::vector<ResolvedColors> resolvedColors_;
+
     FontConfig fonts_;
 
+    // Transient data of the renderers, released after each frame has been executed.
+    crispy::arena frameArena_;
+
     OpenGLRenderer renderTarget_;
 
     BackgroundRenderer backgroundRenderer_;
     ImageRenderer imageRenderer_;
+    PreviewRenderer previewRenderer_;
     TextRenderer textRenderer_;
     DecorationRenderer decorationRenderer_;
     CursorRenderer cursorRenderer_;
+
+    // Rows of many-row frames have their background rectangles made on multiple threads,
+    // each row into its own list of instances (indexed by row number), which are rendered into
+    // the rows' slots when walking their cells, in row order.
+    crispy::parallel_for_pool backgroundPool_;
+    std::vector<std::vector<float>> rowBackgrounds_;
+    bool backgroundsMade_ = false;
+
+    // Each screen row's geometry is retained in the render target, and only damaged rows are
+    // rendered again, unless anything affecting all rows has changed since the last frame.
+    bool redrawAll_ = true;
+    uint64_t lastAtlasEvictions_ = 0;
+
+    std::mutex discardedImagesMutex_;
+    std::vector<Image::Id> discardedImages_;
+    std::optional<int> lastScrollOffset_;
+    int lastRelativeScrollOffset_ = 0;
+    int lastHistoryLineCount_ = 0;
+    uint64_t lastFoldChanges_ = 0;
+    bool lastExtraRow_ = false;                 // whether the row below the screen has been rendered
+    HyperlinkId lastHoveredHyperlink_ = 0;
+
+    // Distinct hyperlinks referred to by the cells retained in each slot, such that hovering a
+    // hyperlink renders only the rows referring to it again, which are collected in hoveredRows_.
+    std::vector<std::vector<HyperlinkId>> slotHyperlinks_;
+    std::vector<int> hoveredRows_;
+
+    // Rows to be rendered with the current frame, copied from the screen.
+    RenderSnapshot snapshot_;
+
+    // Cells drawn highlighted on top of the rows with every frame, one range per row.
+    struct Highlight {
+        int row;                    // screen row
+        int fromColumn;
+        int toColumn;
+        bool selected;              // part of the selection, rather than a search match
+
+        bool operator==(Highlight const& _rhs) const noexcept
+        {
+            return row == _rhs.row && fromColumn == _rhs.fromColumn && toColumn == _rhs.toColumn
+                && selected == _rhs.selected;
+        }
+    };
+    std::vector<Highlight> highlights_;
+    std::vector<Highlight> lastHighlights_;     // of the previous frame, to tell whether they changed
+    std::vector<Selector::Range> searchHighlights_;  // ordered by line
+
+    // Selected cells drawn again in the selection colors, if a selection foreground color is set.
+    std::vector<std::pair<Coordinate, Cell>> selectedCells_;
+    bool selectedReverseVideo_ = false;
+
+    std::vector<std::u32string> overlay_;
+    bool lastOverlay_ = false;                  // whether the overlay has been rendered
+
+    // Local image file referred to by the hovered hyperlink, if any, previewed at the mouse.
+    std::string previewPath_;
+    Coordinate previewPosition_;
+    bool lastPreview_ = false;                  // whether a preview has been rendered
+
+    // Area of the framebuffer changed by the current frame, in drawing coordinates, unless all of
+    // it has (fullDamage_).
+    bool partialPresentation_ = false;
+    bool fullDamage_ = true;
+    QRect damage_;
+    int lastPixelOffset_ = 0;
+
+    // The cursor blinks and moves in the cursor shader, which is passed the time relative to this.
+    std::chrono::steady_clock::time_point const epoch_;
+    std::chrono::milliseconds cursorMotionDuration_{0};
+    bool cursorBlinking_ = true;
+    std::optional<QPoint> lastCursorPosition_;         // position the cursor has been rendered at last
+    QPoint cursorMoveOffset_;                          // position the cursor moves from, relative to the last one
+    int lastCursorWidth_ = 1;                          // in columns
+    std::chrono::steady_clock::time_point cursorMoveStart_;
 };
 
 } // end namespace
@@ -0,0 +1,214 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2020 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <terminal_view/ShaderCache.h>
+
+#include <crispy/FNV.h>
+#include <crispy/mapped_file.h>
+
+#include <fmt/format.h>
+
+#include <QtGui/QOpenGLContext>
+#include <QtGui/QOpenGLExtraFunctions>
+
+#include <cstring>
+
+using std::make_unique;
+using std::move;
+using std::nullopt;
+using std::optional;
+using std::scoped_lock;
+using std::unique_ptr;
+using std::vector;
+
+namespace terminal::view {
+
+namespace
+{
+    // Cache file layout: FileHeader, followed by FileHeader::size bytes of the program binary.
+    auto constexpr FileMagic = uint32_t{0x52444853}; // "SHDR"
+    auto constexpr FileVersion = uint32_t{1};
+
+    struct FileHeader {
+        uint32_t magic;
+        uint32_t version;
+        uint64_t key;
+        uint32_t format;
+        uint32_t size;
+    };
+    static_assert(sizeof(FileHeader) == 24);
+
+    auto constexpr fnv = crispy::FNV<uint64_t>{1099511628211llu, 14695981039346656037llu};
+
+    /// @returns 64-bit FNV-1a hash of the given string and its length, continuing from @p _hash.
+    uint64_t hashString(uint64_t _hash, char const* _text) noexcept
+    {
+        auto const length = _text ? std::strlen(_text) : 0;
+        for (size_t i = 0; i < length; ++i)
+            _hash = fnv(_hash, static_cast<uint8_t>(_text[i]));
+        return fnv(_hash, length);
+    }
+
+    QOpenGLExtraFunctions& functions()
+    {
+        return *QOpenGLContext::currentContext()->extraFunctions();
+    }
+}
+
+ShaderCache& ShaderCache::get()
+{
+    static ShaderCache cache;
+    return cache;
+}
+
+void ShaderCache::setDirectory(FileSystem::path _directory)
+{
+    auto const _l = scoped_lock{mutex_};
+    directory_ = move(_directory);
+}
+
+bool ShaderCache::supported()
+{
+    if (!QOpenGLContext::currentContext())
+        return false;
+
+    GLint formatCount = 0;
+    functions().glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatCount);
+    return formatCount > 0;
+}
+
+uint64_t ShaderCache::key(ShaderConfig const& _shaderConfig)
+{
+    auto& gl = functions();
+    auto hash = uint64_t{14695981039346656037llu};
+    hash = hashString(hash, _shaderConfig.vertexShader.c_str());
+    hash = hashString(hash, _shaderConfig.fragmentShader.c_str());
+    hash = hashString(hash, reinterpret_cast<char const*>(gl.glGetString(GL_VENDOR)));
+    hash = hashString(hash, reinterpret_cast<char const*>(gl.glGetString(GL_RENDERER)));
+    hash = hashString(hash, reinterpret_cast<char const*>(gl.glGetString(GL_VERSION)));
+    return fnv(hash, FileVersion);
+}
+
+unique_ptr<QOpenGLShaderProgram> ShaderCache::load(ShaderConfig const& _shaderConfig)
+{
+    if (!supported())
+        return {};
+
+    auto const _l = scoped_lock{mutex_};
+    auto const key = ShaderCache::key(_shaderConfig);
+
+    auto i = binaries_.find(key);
+    if (i == binaries_.end())
+    {
+        auto binary = read(key);
+        if (!binary.has_value())
+        {
+            ++misses_;
+            return {};
+        }
+        i = binaries_.emplace(key, move(*binary)).first;
+    }
+
+    auto program = make_unique<QOpenGLShaderProgram>();
+    if (!program->create())
+        return {};
+
+    Binary const& binary = i->second;
+    functions().glProgramBinary(program->programId(),
+                                binary.format,
+                                binary.data.data(),
+                                static_cast<GLsizei>(binary.data.size()));
+
+    // A program without any shaders attached is adopted by link() as is, if linked already.
+    // Drivers reject binaries of other driver versions, which are then built from source again.
+    if (!program->link())
+    {
+        binaries_.erase(i);
+        ++misses_;
+        return {};
+    }
+
+    ++hits_;
+    return program;
+}
+
+void ShaderCache::store(ShaderConfig const& _shaderConfig, QOpenGLShaderProgram& _program)
+{
+    if (!supported())
+        return;
+
+    auto& gl = functions();
+    GLint length = 0;
+    gl.glGetProgramiv(_program.programId(), GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0)
+        return;
+
+    auto binary = Binary{0, vector<uint8_t>(static_cast<size_t>(length))};
+    auto format = GLenum{};
+    auto written = GLsizei{0};
+    gl.glGetProgramBinary(_program.programId(), length, &written, &format, binary.data.data());
+    if (written <= 0)
+        return;
+
+    binary.format = format;
+    binary.data.resize(static_cast<size_t>(written));
+
+    auto const _l = scoped_lock{mutex_};
+    auto const key = ShaderCache::key(_shaderConfig);
+    write(key, binary);
+    binaries_[key] = move(binary);
+}
+
+FileSystem::path ShaderCache::path(uint64_t _key) const
+{
+    return directory_ / fmt::format("shader-{:016x}.bin", _key);
+}
+
+optional<ShaderCache::Binary> ShaderCache::read(uint64_t _key) const
+{
+    if (directory_.empty())
+        return nullopt;
+
+    auto const file = crispy::mapped_file::open(path(_key).string());
+    if (!file.has_value() || file->size() < sizeof(FileHeader))
+        return nullopt;
+
+    auto header = FileHeader{};
+    std::memcpy(&header, file->data(), sizeof(header));
+    if (header.magic != FileMagic
+            || header.version != FileVersion
+            || header.key != _key
+            || header.size != file->size() - sizeof(FileHeader))
+        return nullopt;
+
+    auto const* data = file->data() + sizeof(FileHeader);
+    return Binary{header.format, vector<uint8_t>(data, data + header.size)};
+}
+
+void ShaderCache::write(uint64_t _key, Binary const& _binary) const
+{
+    if (directory_.empty())
+        return;
+
+    auto const header = FileHeader{FileMagic, FileVersion, _key, _binary.format, static_cast<uint32_t>(_binary.data.size())};
+
+    auto contents = vector<uint8_t>(sizeof(header) + _binary.data.size());
+    std::memcpy(contents.data(), &header, sizeof(header));
+    std::memcpy(contents.data() + sizeof(header), _binary.data.data(), _binary.data.size());
+
+    auto ec = FileSystemError{};
+    FileSystem::create_directories(directory_, ec);
+    crispy::replace_file(path(_key).string(), contents.data(), contents.size());
+}
+
+} // end namespace
@@ -0,0 +1,80 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2020 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <terminal_view/ShaderConfig.h>
+
+#include <crispy/stdfs.h>
+
+#include <QtGui/QOpenGLShaderProgram>
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+namespace terminal::view {
+
+/**
+ * Process-wide cache of linked shader program binaries, shared across all windows of the process
+ * and persisted in a cache directory across processes.
+ *
+ * Programs are keyed by a fingerprint of their sources and the OpenGL vendor, renderer and version
+ * they have been linked with, as program binaries are only valid for the driver that produced them.
+ */
+class ShaderCache {
+  public:
+    /// @returns the shader cache of this process.
+    static ShaderCache& get();
+
+    /// Continues with cache files in @p _directory, or with the in-memory cache only if empty.
+    void setDirectory(FileSystem::path _directory);
+
+    /// @returns the program linked from the cached binary of @p _shaderConfig, or nullptr if there is none.
+    std::unique_ptr<QOpenGLShaderProgram> load(ShaderConfig const& _shaderConfig);
+
+    /// Adds the binary of the freshly linked @p _program, built from @p _shaderConfig, to the cache.
+    void store(ShaderConfig const& _shaderConfig, QOpenGLShaderProgram& _program);
+
+    uint64_t hits() const noexcept { return hits_; }
+    uint64_t misses() const noexcept { return misses_; }
+
+  private:
+    struct Binary {
+        uint32_t format;
+        std::vector<uint8_t> data;
+    };
+
+    ShaderCache() = default;
+
+    /// @returns whether the current context is able to load program binaries.
+    static bool supported();
+
+    /// @returns a key identifying the program built from @p _shaderConfig by the current context's driver.
+    static uint64_t key(ShaderConfig const& _shaderConfig);
+
+    FileSystem::path path(uint64_t _key) const;
+    std::optional<Binary> read(uint64_t _key) const;
+    void write(uint64_t _key, Binary const& _binary) const;
+
+    std::mutex mutex_;
+    FileSystem::path directory_;
+    std::unordered_map<uint64_t, Binary> binaries_;
+    uint64_t hits_ = 0;
+    uint64_t misses_ = 0;
+};
+
+} // end namespace
@@ -11,12 +11,18 @@
  * See the License for the specific language governing permissions and
  * limitations under the License.
  */
+#include <terminal_view/ShaderCache.h>
 #include <terminal_view/ShaderConfig.h>
 
+#include <QtGui/QOpenGLContext>
+#include <QtGui/QOpenGLExtraFunctions>
+
 #include <string>
 
 #include "background_vert.h"
 #include "background_frag.h"
+#include "cursor_vert.h"
+#include "cursor_frag.h"
 #include "text_vert.h"
 #include "text_frag.h"
 
@@ -40,6 +46,8 @@ ShaderConfig defaultShaderConfig(ShaderClass _shaderClass)
             return {s(background_vert), s(background_frag)};
         case ShaderClass::Text:
             return {s(text_vert), s(text_frag)};
+        case ShaderClass::Cursor:
+            return {s(cursor_vert), s(cursor_frag)};
     }
 
     throw std::invalid_argument(fmt::format("ShaderClass<{}>", static_cast<unsigned>(_shaderClass)));
@@ -47,7 +55,20 @@ ShaderConfig defaultShaderConfig(ShaderClass _shaderClass)
 
 std::unique_ptr<QOpenGLShaderProgram> createShader(ShaderConfig const& _shaderConfig)
 {
+    if (auto shader = ShaderCache::get().load(_shaderConfig); shader)
+        return shader;
+
     auto shader = std::make_unique<QOpenGLShaderProgram>();
+    if (!shader->create())
+    {
+        qDebug() << shader->log();
+        return {};
+    }
+
+    // The linked program's binary is retrieved for the shader cache.
+    if (auto* context = QOpenGLContext::currentContext(); context)
+        context->extraFunctions()->glProgramParameteri(shader->programId(), GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+
     if (!shader->addShaderFromSourceCode(QOpenGLShader::Vertex, _shaderConfig.vertexShader.c_str()))
     {
         qDebug() << shader->log();
@@ -64,6 +85,8 @@ std::unique_ptr<QOpenGLShaderProgram> createShader(ShaderConfig const& _shaderCo
         return {};
     }
 
+    ShaderCache::get().store(_shaderConfig, *shader);
+
     return shader;
 }
 
@@ -25,7 +25,8 @@ namespace terminal::view {
 
 enum class ShaderClass {
     Background,
-    Text
+    Text,
+    Cursor
 };
 
 struct ShaderConfig {
@@ -41,6 +42,8 @@ inline std::string to_string(ShaderClass _shaderClass)
             return "background";
         case ShaderClass::Text:
             return "text";
+        case ShaderClass::Cursor:
+            return "cursor";
     }
 
     throw std::invalid_argument(fmt::format("ShaderClass<{}>", static_cast<unsigned>(_shaderClass)));
@@ -48,6 +51,9 @@ inline std::string to_string(ShaderClass _shaderClass)
 
 ShaderConfig defaultShaderConfig(ShaderClass _shaderClass);
 
+/// @returns the program built from @p _shaderConfig, or nullptr on failure.
+///
+/// Programs are loaded from the ShaderCache if possible, and added to it otherwise.
 std::unique_ptr<QOpenGLShaderProgram> createShader(ShaderConfig const& _shaderConfig);
 
 } // namespace
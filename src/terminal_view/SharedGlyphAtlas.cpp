@@ -0,0 +1,116 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2020 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <terminal_view/SharedGlyphAtlas.h>
+
+using std::make_shared;
+using std::make_tuple;
+using std::shared_ptr;
+using std::weak_ptr;
+
+using crispy::text::Font;
+
+namespace terminal::view {
+
+namespace
+{
+    // The atlas instances of each window's own allocators come first.
+    auto constexpr MonochromeAtlasId = 2u;
+    auto constexpr ColorAtlasId = 3u;
+    auto constexpr DistanceFieldAtlasId = 4u;
+    auto constexpr MaxInstanceCount = 1u;
+
+    // Mipmap levels of color glyphs, whose bitmaps come in a fixed size of typically above 100
+    // pixels, and are scaled down to the cell size by up to this power of two when sampled.
+    auto constexpr ColorGlyphLevels = 4u;
+}
+
+shared_ptr<SharedGlyphAtlas> SharedGlyphAtlas::acquire(unsigned _depth,
+                                                       unsigned _monochromeSize,
+                                                       unsigned _colorSize)
+{
+    // Released along with the last window, such that its textures are deleted with a context current.
+    static weak_ptr<SharedGlyphAtlas> instance;
+
+    if (auto atlas = instance.lock(); atlas)
+        return atlas;
+
+    auto atlas = make_shared<SharedGlyphAtlas>(_depth, _monochromeSize, _colorSize);
+    instance = atlas;
+    return atlas;
+}
+
+SharedGlyphAtlas::SharedGlyphAtlas(unsigned _depth, unsigned _monochromeSize, unsigned _colorSize) :
+    textures_{},
+    monochromeAllocator_{
+        MonochromeAtlasId,
+        MaxInstanceCount,
+        _depth,
+        _monochromeSize,
+        _monochromeSize,
+        GL_R8,
+        textures_,
+        "sharedMonochromeAtlas"
+    },
+    colorAllocator_{
+        ColorAtlasId,
+        MaxInstanceCount,
+        _depth,
+        _colorSize,
+        _colorSize,
+        GL_RGBA8,
+        textures_,
+        "sharedColorAtlas",
+        ColorGlyphLevels,
+        true // color glyphs are uploaded as rasterized, in BGRA order
+    },
+    distanceFieldAllocator_{
+        DistanceFieldAtlasId,
+        MaxInstanceCount,
+        _depth,
+        _monochromeSize,
+        _monochromeSize,
+        GL_R8,
+        textures_,
+        "sharedDistanceFieldAtlas"
+    },
+    monochromeAtlas_{ monochromeAllocator_ },
+    colorAtlas_{ colorAllocator_ },
+    distanceFieldAtlas_{ distanceFieldAllocator_ }
+{
+}
+
+unsigned SharedGlyphAtlas::faceId(Font const& _font, Size const& _cellSize)
+{
+    auto const key = make_tuple(_font.filePath(), _font.fontSize(), _cellSize.width, _cellSize.height);
+    if (auto const i = faceIds_.find(key); i != faceIds_.end())
+        return i->second;
+
+    auto const id = static_cast<unsigned>(faceIds_.size());
+    faceIds_.emplace(key, id);
+    return id;
+}
+
+unsigned SharedGlyphAtlas::sizeIndependentFaceId(Font const& _font)
+{
+    // Such glyphs do not depend on any size, which the key tells by a font size of zero.
+    auto const key = make_tuple(_font.filePath(), 0, 0, 0);
+    if (auto const i = faceIds_.find(key); i != faceIds_.end())
+        return i->second;
+
+    auto const id = static_cast<unsigned>(faceIds_.size());
+    faceIds_.emplace(key, id);
+    return id;
+}
+
+} // end namespace
@@ -0,0 +1,165 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2020 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <terminal/Size.h>
+
+#include <crispy/Atlas.h>
+#include <crispy/AtlasRenderer.h>
+#include <crispy/hash.h>
+#include <crispy/text/Font.h>
+
+#include <QtCore/QPoint>
+
+#include <fmt/format.h>
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <tuple>
+
+namespace terminal::view {
+
+/// Placement of a glyph's texture relative to the pen position.
+struct GlyphMetrics {
+    QPoint size;            // glyph size
+    QPoint bearing;         // offset from baseline to left/top of glyph
+    int height;
+    int descender;
+    int advance;            // offset to advance to next glyph in line.
+};
+
+/// Identifies a glyph in the shared atlas, by its face (see SharedGlyphAtlas::faceId()) and index.
+struct GlyphKey {
+    unsigned face;
+    unsigned glyphIndex;
+
+    bool operator<(GlyphKey const& _rhs) const noexcept
+    {
+        return face < _rhs.face || (face == _rhs.face && glyphIndex < _rhs.glyphIndex);
+    }
+
+    bool operator==(GlyphKey const& _rhs) const noexcept
+    {
+        return face == _rhs.face && glyphIndex == _rhs.glyphIndex;
+    }
+};
+
+/**
+ * Glyph atlases shared by the windows of one process, whose OpenGL contexts share their textures.
+ *
+ * Windows acquire the atlas when creating their renderer and keep it alive for as long as they
+ * are open, so that glyphs rasterized for one window are drawn by any other window rendering the
+ * same font face at the same size, instead of being rasterized and uploaded once per window.
+ *
+ * All windows render on the GUI thread, which is the only one to use the atlas.
+ */
+class SharedGlyphAtlas {
+  public:
+    using TextureAtlas = crispy::atlas::MetadataTextureAtlas<GlyphKey, GlyphMetrics>;
+
+    /// @returns the atlas of this process, created with the given texture limits if there is none yet.
+    static std::shared_ptr<SharedGlyphAtlas> acquire(unsigned _depth,
+                                                     unsigned _monochromeSize,
+                                                     unsigned _colorSize);
+
+    SharedGlyphAtlas(unsigned _depth, unsigned _monochromeSize, unsigned _colorSize);
+
+    SharedGlyphAtlas(SharedGlyphAtlas const&) = delete;
+    SharedGlyphAtlas& operator=(SharedGlyphAtlas const&) = delete;
+
+    /// @returns the number identifying glyphs of @p _font rendered into cells of @p _cellSize,
+    ///          as glyphs differ in size and scaling between these.
+    unsigned faceId(crispy::text::Font const& _font, Size const& _cellSize);
+
+    /// @returns the number identifying glyphs of @p _font rasterized once and scaled to any font
+    ///          and cell size when rendered, such as distance fields rasterized at a reference size,
+    ///          and the bitmaps of color fonts, which come in a fixed size.
+    unsigned sizeIndependentFaceId(crispy::text::Font const& _font);
+
+    crispy::atlas::SharedTextures& textures() noexcept { return textures_; }
+    crispy::atlas::SharedTextures const& textures() const noexcept { return textures_; }
+
+    TextureAtlas& monochromeAtlas() noexcept { return monochromeAtlas_; }
+    TextureAtlas& colorAtlas() noexcept { return colorAtlas_; }
+    TextureAtlas& distanceFieldAtlas() noexcept { return distanceFieldAtlas_; }
+    TextureAtlas const& monochromeAtlas() const noexcept { return monochromeAtlas_; }
+    TextureAtlas const& colorAtlas() const noexcept { return colorAtlas_; }
+    TextureAtlas const& distanceFieldAtlas() const noexcept { return distanceFieldAtlas_; }
+
+    crispy::atlas::TextureAtlasAllocator const& monochromeAllocator() const noexcept { return monochromeAllocator_; }
+    crispy::atlas::TextureAtlasAllocator const& colorAllocator() const noexcept { return colorAllocator_; }
+    crispy::atlas::TextureAtlasAllocator const& distanceFieldAllocator() const noexcept { return distanceFieldAllocator_; }
+
+    /// @returns number of atlas pages evicted so far, by any of the windows.
+    uint64_t evictedPages() const noexcept
+    {
+        return monochromeAllocator_.evictedPages()
+             + colorAllocator_.evictedPages()
+             + distanceFieldAllocator_.evictedPages();
+    }
+
+    /// Marks the beginning of a new frame of any of the windows.
+    void nextFrame() noexcept
+    {
+        monochromeAllocator_.nextFrame();
+        colorAllocator_.nextFrame();
+        distanceFieldAllocator_.nextFrame();
+    }
+
+  private:
+    // The textures go last, after the allocators have queued the destruction of their atlases.
+    crispy::atlas::SharedTextures textures_;
+    crispy::atlas::TextureAtlasAllocator monochromeAllocator_;
+    crispy::atlas::TextureAtlasAllocator colorAllocator_;
+    crispy::atlas::TextureAtlasAllocator distanceFieldAllocator_;
+    TextureAtlas monochromeAtlas_;
+    TextureAtlas colorAtlas_;
+    TextureAtlas distanceFieldAtlas_;
+
+    std::map<std::tuple<std::string, int, int, int>, unsigned> faceIds_;  // keyed by file path, font size and cell size
+};
+
+} // end namespace
+
+namespace std {
+    template<>
+    struct hash<terminal::view::GlyphKey> {
+        size_t operator()(terminal::view::GlyphKey const& _key) const noexcept {
+            return crispy::hash_word((static_cast<uint64_t>(_key.face) << 32) | _key.glyphIndex);
+        }
+    };
+}
+
+namespace fmt {
+    template <>
+    struct formatter<terminal::view::GlyphMetrics> {
+        using GlyphMetrics = terminal::view::GlyphMetrics;
+        template <typename ParseContext>
+        constexpr auto parse(ParseContext& ctx) { return ctx.begin(); }
+        template <typename FormatContext>
+        auto format(GlyphMetrics const& _glyph, FormatContext& ctx)
+        {
+            return format_to(ctx.out(), "size:{}x{}, bearing:{}x{}, height:{}, descender:{}, advance:{}",
+                _glyph.size.x(),
+                _glyph.size.y(),
+                _glyph.bearing.x(),
+                _glyph.bearing.y(),
+                _glyph.height,
+                _glyph.descender,
+                _glyph.advance);
+        }
+    };
+}
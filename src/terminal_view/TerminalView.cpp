@@ -20,14 +20,17 @@
 
 #include <array>
 #include <chrono>
+#include <cstdlib>
 #include <iostream>
 #include <utility>
 
 using std::chrono::milliseconds;
 using std::chrono::steady_clock;
+using std::move;
 using std::nullopt;
 using std::optional;
 using std::string;
+using std::thread;
 using std::unique_ptr;
 
 namespace terminal::view {
@@ -55,10 +58,11 @@ TerminalView::TerminalView(steady_clock::time_point _now,
                            Decorator _hyperlinkNormal,
                            Decorator _hyperlinkHover,
                            unique_ptr<Pty> _pty,
-                           Process::ExecInfo const& _shell,
+                           unique_ptr<Process> _process,
                            QMatrix4x4 const& _projectionMatrix,
                            ShaderConfig const& _backgroundShaderConfig,
                            ShaderConfig const& _textShaderConfig,
+                           ShaderConfig const& _cursorShaderConfig,
                            Logger _logger) :
     events_{ _events },
     logger_{ move(_logger) },
@@ -77,7 +81,9 @@ TerminalView::TerminalView(steady_clock::time_point _now,
         _hyperlinkHover,
         _backgroundShaderConfig,
         _textShaderConfig,
-        _projectionMatrix
+        _cursorShaderConfig,
+        _projectionMatrix,
+        [this]() { events_.glyphsRasterized(); }
     },
     terminal_(
         std::move(_pty),
@@ -88,17 +94,21 @@ TerminalView::TerminalView(steady_clock::time_point _now,
         logger_,
         _wordDelimiters
     ),
-    process_{ _shell, terminal_.device() },
-    processExitWatcher_{ [this]() {
-        (void) process_.wait();
-        terminal_.device().close();
-    } },
+    process_{ move(_process) },
     colorProfile_{_colorProfile},
     defaultColorProfile_{_colorProfile}
 {
     terminal_.setCursorDisplay(_cursorDisplay);
     terminal_.setCursorShape(_cursorShape);
     terminal_.screen().setCellPixelSize(renderer_.cellSize());
+
+    if (process_)
+    {
+        processExitWatcher_ = thread{ [this]() {
+            (void) process_->wait();
+            terminal_.device().close();
+        } };
+    }
 }
 
 optional<RGBColor> TerminalView::requestDynamicColor(DynamicColorName _name)
@@ -138,7 +148,7 @@ void TerminalView::setColorProfile(terminal::ColorProfile const& _colors)
 
 bool TerminalView::alive() const
 {
-    return process_.alive();
+    return !process_ || process_->alive();
 }
 
 void TerminalView::setFont(FontConfig const& _fonts)
@@ -192,18 +202,33 @@ TerminalView::WindowMargin TerminalView::computeMargin(Size const& ws,
 };
 
 void TerminalView::resize(int _width, int _height)
+{
+    resizeView(_width, _height);
+    applyScreenSize();
+}
+
+void TerminalView::resizeView(int _width, int _height)
 {
     size_ = Size{_width, _height};
 
+    // Keeps the current screen anchored at the top, cutting off its bottom lines if the view
+    // became smaller.
+    windowMargin_ = computeMargin(terminal_.screenSize(), _width, _height);
+    renderer_.setMargin(windowMargin_.left, windowMargin_.bottom);
+}
+
+bool TerminalView::applyScreenSize()
+{
     auto const newScreenSize = screenSize();
 
-    windowMargin_ = computeMargin(newScreenSize, _width, _height);
+    windowMargin_ = computeMargin(newScreenSize, size_.width, size_.height);
 
     renderer_.setScreenSize(newScreenSize);
     renderer_.setMargin(windowMargin_.left, windowMargin_.bottom);
     //renderer_.clearCache();
 
-    if (newScreenSize != terminal_.screenSize())
+    auto const changed = newScreenSize != terminal_.screenSize();
+    if (changed)
     {
         terminal_.resizeScreen(newScreenSize, newScreenSize * cellSize());
         terminal_.clearSelection();
@@ -218,6 +243,8 @@ void TerminalView::resize(int _width, int _height)
         renderer_.cellSize()
     );
 #endif
+
+    return changed;
 }
 
 void TerminalView::setCursorShape(CursorShape _shape)
@@ -247,8 +274,11 @@ uint64_t TerminalView::render(steady_clock::time_point const& _now, bool _pressu
 
 Process::ExitStatus TerminalView::waitForProcessExit()
 {
+    if (!process_)
+        return Process::NormalExit{EXIT_SUCCESS};
+
     processExitWatcher_.join();
-    return process_.checkStatus().value();
+    return process_->checkStatus().value();
 }
 
 void TerminalView::bell()
@@ -47,6 +47,9 @@ class TerminalView : private Terminal::Events {
         virtual void bell() {}
         virtual void bufferChanged(ScreenType) {}
         virtual void screenUpdated() {}
+        /// Invoked on a background thread when glyphs, that are missing on screen, have been rasterized,
+        /// or when the preview of a hovered hyperlink has been made.
+        virtual void glyphsRasterized() {}
         virtual void copyToClipboard(std::string_view const& /*_data*/) {}
         virtual void dumpState() {}
         virtual void notify(std::string_view const& /*_title*/, std::string_view const& /*_body*/) {}
@@ -69,10 +72,11 @@ class TerminalView : private Terminal::Events {
                  Decorator _hyperlinkNormal,
                  Decorator _hyperlinkHover,
                  std::unique_ptr<Pty> _client,
-                 Process::ExecInfo const& _shell,
+                 std::unique_ptr<Process> _process,
                  QMatrix4x4 const& _projectionMatrix,
                  ShaderConfig const& _backgroundShaderConfig,
                  ShaderConfig const& _textShaderConfig,
+                 ShaderConfig const& _cursorShaderConfig,
                  Logger _logger);
 
     TerminalView(TerminalView const&) = delete;
@@ -100,6 +104,19 @@ class TerminalView : private Terminal::Events {
     /// PTY slave about the window resize event.
     void resize(int _width, int _height);
 
+    /// Resizes the terminal view to the given number of pixels, but keeps the screen at its
+    /// current number of lines and columns, clipped or padded to the new size, until
+    /// applyScreenSize() is called.
+    ///
+    /// This avoids resizing the screen and signaling the application for each of the
+    /// intermediate sizes of an interactive window resize.
+    void resizeView(int _width, int _height);
+
+    /// Resizes the screen to the number of lines and columns fitting into the view.
+    ///
+    /// @returns whether the screen size has changed.
+    bool applyScreenSize();
+
     void setFont(FontConfig const& _fonts);
     bool setFontSize(int _fontSize);
     bool setTerminalSize(Size _cells);
@@ -107,6 +124,18 @@ class TerminalView : private Terminal::Events {
     void setBackgroundOpacity(terminal::Opacity _opacity) { renderer_.setBackgroundOpacity(_opacity); }
     void setHyperlinkDecoration(Decorator _normal, Decorator _hover) { renderer_.setHyperlinkDecoration(_normal, _hover); }
     void setProjection(QMatrix4x4 const& _projectionMatrix) { return renderer_.setProjection(_projectionMatrix); }
+    void setGlyphCacheDirectory(FileSystem::path _directory) { renderer_.setGlyphCacheDirectory(std::move(_directory)); }
+
+    void setMaxImageTextureMemory(size_t _bytes) noexcept { renderer_.setMaxImageTextureMemory(_bytes); }
+    bool setShaders(ShaderConfig const& _backgroundShaderConfig,
+                    ShaderConfig const& _textShaderConfig,
+                    ShaderConfig const& _cursorShaderConfig)
+    {
+        return renderer_.setShaders(_backgroundShaderConfig, _textShaderConfig, _cursorShaderConfig);
+    }
+    void setCursorMotionDuration(std::chrono::milliseconds _duration) noexcept { renderer_.setCursorMotionDuration(_duration); }
+    void setDistanceFieldGlyphs(bool _enabled) { renderer_.setDistanceFieldGlyphs(_enabled); }
+    void setOverlay(std::vector<std::string> const& _lines) { renderer_.setOverlay(_lines); }
 
     /// Renders the screen buffer to the current OpenGL screen.
     uint64_t render(std::chrono::steady_clock::time_point const& _now, bool _pressure);
@@ -119,12 +148,15 @@ class TerminalView : private Terminal::Events {
     /// The alive() test will fail after this call.
     Process::ExitStatus waitForProcessExit();
 
-    Process const& process() const noexcept { return process_; }
-    Process& process() noexcept { return process_; }
+    /// @returns the process running in the terminal, or nullptr if the PTY is not backed by a
+    ///          local process, such as when viewing a session.
+    Process const* process() const noexcept { return process_.get(); }
+    Process* process() noexcept { return process_.get(); }
     Terminal const& terminal() const noexcept { return terminal_; }
     Terminal& terminal() noexcept { return terminal_; }
 
     Renderer const& renderer() const { return renderer_; }
+    Renderer& renderer() { return renderer_; }
 
     void setColorProfile(terminal::ColorProfile const& _colors);
 
@@ -163,7 +195,7 @@ class TerminalView : private Terminal::Events {
     Renderer renderer_;
 
     Terminal terminal_;
-    Process process_;
+    std::unique_ptr<Process> process_;  // spawned on the PTY by the caller, if any
     std::thread processExitWatcher_;
 
     ColorProfile colorProfile_;
@@ -18,69 +18,171 @@
 
 #include <crispy/times.h>
 #include <crispy/algorithm.h>
+#include <crispy/trace.h>
 
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <thread>
+
+using std::chrono::steady_clock;
 using std::get;
+using std::move;
 using std::nullopt;
 using std::optional;
 using std::u32string;
 using std::u32string_view;
 using std::vector;
 
-using crispy::copy;
 using crispy::text::Font;
-using crispy::text::FontList;
-using crispy::text::FontStyle;
 using crispy::text::GlyphBitmap;
+using crispy::text::GlyphPosition;
 using crispy::text::GlyphPositionList;
 using crispy::times;
 
-using unicode::out;
-
 namespace atlas = crispy::atlas;
 
 namespace terminal::view {
 
 #if !defined(NDEBUG)
 #define METRIC_INCREMENT(name) do { ++renderMetrics_. name ; } while (0)
+#define METRIC_ADD(name, value) do { renderMetrics_. name += (value); } while (0)
 #else
 #define METRIC_INCREMENT(name) do {} while (0)
+#define METRIC_ADD(name, value) do {} while (0)
 #endif
 
+namespace
+{
+    // Bounds of the text shaping cache. The byte limit accounts for key text and glyph positions.
+    auto constexpr ShapingCacheEntryLimit = size_t{16384};
+    auto constexpr ShapingCacheByteLimit = size_t{8} * 1024 * 1024;
+    auto constexpr ShapingCacheEntryOverhead = size_t{64};
+
+    // Segments of at least this many cells are re-shaped incrementally when their text changes,
+    // re-shaping this many unchanged cells around the change, for the context of ligatures.
+    auto constexpr IncrementalShapingMinCells = 16u;
+    auto constexpr IncrementalShapingContextCells = 2;
+
+    // Number of text shaping caches kept for font sizes other than the current one.
+    auto constexpr MaxRetainedFontSizes = size_t{2};
+
+    // Upper bound of threads shaping text in parallel, including the render thread.
+    auto constexpr MaxShapingThreads = 8u;
+
+    // Upper bound of threads rasterizing glyphs in the background.
+    auto constexpr MaxRasterizerThreads = 4u;
+
+    unsigned rasterizerThreadCount() noexcept
+    {
+        auto const cores = std::thread::hardware_concurrency();
+        return cores > 1 ? std::clamp(cores / 2, 1u, MaxRasterizerThreads) : 0u;
+    }
+
+    uint64_t hashOf(CacheKey const& _key) noexcept
+    {
+        return crispy::hash_bytes(_key.text, _key.styles.mask());
+    }
+}
+
 TextRenderer::TextRenderer(RenderMetrics& _renderMetrics,
                            crispy::atlas::CommandListener& _commandListener,
-                           crispy::atlas::TextureAtlasAllocator& _monochromeAtlasAllocator,
-                           crispy::atlas::TextureAtlasAllocator& _colorAtlasAllocator,
+                           SharedGlyphAtlas& _glyphAtlas,
                            ScreenCoordinates const& _screenCoordinates,
                            FontConfig const& _fonts,
-                           Size const& _cellSize) :
+                           Size const& _cellSize,
+                           crispy::arena& _frameArena,
+                           std::function<void()> _glyphsRasterized) :
     renderMetrics_{ _renderMetrics },
     screenCoordinates_{ _screenCoordinates },
     fonts_{ _fonts },
+    cache_{ ShapingCacheEntryLimit, ShapingCacheByteLimit },
+    cacheFontSize_{ _fonts.regular.first.get().fontSize() },
+    frameArena_{ _frameArena },
+    shapingPool_{ std::clamp(std::thread::hardware_concurrency(), 1u, MaxShapingThreads) },
+    rasterizer_{ rasterizerThreadCount(), move(_glyphsRasterized) },
+    glyphCache_{},
     cellSize_{ _cellSize },
     textShaper_{},
     commandListener_{ _commandListener },
-    monochromeAtlas_{ _monochromeAtlasAllocator },
-    colorAtlas_{ _colorAtlasAllocator }
+    glyphAtlas_{ _glyphAtlas }
 {
 }
 
 void TextRenderer::clearCache()
 {
-    monochromeAtlas_.clear();
-    colorAtlas_.clear();
+    // The shared glyph atlas is left intact, as other windows may still use it. Glyphs of
+    // fonts or cell sizes no longer in use are evicted from it eventually.
+    faceIds_.clear();
 
     textShaper_.clearCache();
+    shapingPool_.clearCache();
+    rasterizer_.clearCache();
 
-    cacheKeyStorage_.clear();
+    // Glyph positions refer to the fonts, which may be gone after setFont().
     cache_.clear();
-#if !defined(NDEBUG)
-    cacheHits_.clear();
-#endif
+    cacheFontSize_ = fonts_.regular.first.get().fontSize();
+    retainedCaches_.clear();
+    renderedSegments_.clear();
+    renderMetrics_.shapingCacheSize = 0;
+    renderMetrics_.shapingCacheBytes = 0;
+}
+
+void TextRenderer::updateFontSize()
+{
+    auto const fontSize = fonts_.regular.first.get().fontSize();
+    if (fontSize == cacheFontSize_)
+        return;
+
+    // The shapers' HarfBuzz fonts and pending rasterizations are of the previous size, whereas
+    // the shared glyph atlas keeps the glyphs of each size apart.
+    faceIds_.clear();
+    textShaper_.clearCache();
+    shapingPool_.clearCache();
+    rasterizer_.clearCache();
+
+    auto cache = ShapingCache{ShapingCacheEntryLimit, ShapingCacheByteLimit};
+    auto const retained = std::find_if(retainedCaches_.begin(), retainedCaches_.end(),
+                                       [&](auto const& _retained) { return _retained.first == fontSize; });
+    if (retained != retainedCaches_.end())
+    {
+        cache = move(retained->second);
+        retainedCaches_.erase(retained);
+    }
+
+    retainedCaches_.emplace_back(cacheFontSize_, move(cache_));
+    if (retainedCaches_.size() > MaxRetainedFontSizes)
+        retainedCaches_.erase(retainedCaches_.begin());
+
+    cache_ = move(cache);
+    cacheFontSize_ = fontSize;
+    renderedSegments_.clear();
+    renderMetrics_.shapingCacheSize = static_cast<unsigned>(cache_.size());
+    renderMetrics_.shapingCacheBytes = cache_.bytes();
+}
+
+size_t TextRenderer::shapingCacheMemoryUsage() const noexcept
+{
+    auto bytes = cache_.bytes();
+    for ([[maybe_unused]] auto const& [_, cache] : retainedCaches_)
+        bytes += cache.bytes();
+    return bytes;
 }
 
 void TextRenderer::setCellSize(Size const& _cellSize)
 {
     cellSize_ = _cellSize;
+    faceIds_.clear();
+}
+
+void TextRenderer::setDistanceFieldGlyphs(bool _enabled)
+{
+    if (distanceFieldGlyphs_ == _enabled)
+        return;
+
+    distanceFieldGlyphs_ = _enabled;
+    faceIds_.clear();
+    rasterizer_.clearCache();
 }
 
 void TextRenderer::setFont(FontConfig const& _fonts)
@@ -163,6 +265,14 @@ void TextRenderer::flushPendingSegments()
     if (codepoints_.empty())
         return;
 
+    CRISPY_TRACE_ZONE("TextRenderer::flushPendingSegments");
+
+    if (prefetching_)
+    {
+        prefetchPendingSegment();
+        return;
+    }
+
     render(
         #if 1
         screenCoordinates_.map(startColumn_, row_),
@@ -181,115 +291,204 @@ void TextRenderer::flushPendingSegments()
 
 GlyphPositionList const& TextRenderer::cachedGlyphPositions()
 {
-    auto const codepoints = u32string_view(codepoints_.data(), codepoints_.size());
-    if (auto const cached = cache_.find(CacheKey{codepoints, characterStyleMask_}); cached != cache_.end())
+    auto const key = CacheKey{u32string_view(codepoints_.data(), codepoints_.size()), characterStyleMask_};
+    auto const hash = hashOf(key);
+
+    if (CacheEntry* cached = cache_.find(hash, key); cached != nullptr)
     {
         METRIC_INCREMENT(cachedText);
-#if !defined(NDEBUG)
-        cacheHits_[cached->first]++;
-#endif
-        return cached->second;
+        ++renderMetrics_.shapingCacheHits;
+        ++cached->hits;
+        rememberSegment(hash);
+        return cached->glyphPositions;
     }
-    else
-    {
-        cacheKeyStorage_.emplace_back(u32string{codepoints});
-
-        // std::cout << fmt::format("TextRenderer.newEntry({}): {}\n",
-        //         cacheKeyStorage_.size(),
-        //         unicode::to_utf8(cacheKeyStorage_.back()).c_str());
-
-        auto const cacheKeyFromStorage = CacheKey{
-            cacheKeyStorage_.back(),
-            characterStyleMask_
-        };
 
-#if !defined(NDEBUG)
-        cacheHits_[cacheKeyFromStorage] = 0;
-#endif
+    ++renderMetrics_.shapingCacheMisses;
 
-        return cache_[cacheKeyFromStorage] = requestGlyphPositions();
+    auto const start = steady_clock::now();
+    auto glyphPositions = reshapeIncrementally(key);
+    if (!glyphPositions)
+    {
+        auto runCount = 0u;
+        glyphPositions = shapeText(textShaper_, fonts_, characterStyleMask_, key.text, clusters_.data(), runCount);
+        METRIC_ADD(shapedText, runCount);
     }
+    renderMetrics_.shapingTime += steady_clock::now() - start;
+
+    rememberSegment(hash);
+    return insertCache(hash, key, move(*glyphPositions));
 }
 
-GlyphPositionList TextRenderer::requestGlyphPositions()
+optional<GlyphPositionList> TextRenderer::reshapeIncrementally(CacheKey const& _key)
 {
-    // if (characterStyleMask_.mask() != 0)
-    //     std::cout << fmt::format("TextRenderer.requestGlyphPositions: styles=({})\n", characterStyleMask_);
+    auto const previous = renderedSegments_.find(segmentPosition());
+    if (previous == renderedSegments_.end() || previous->second.styles != _key.styles)
+        return nullopt;
+
+    RenderedSegment const& old = previous->second;
+    CacheEntry const* oldEntry = cache_.find(old.hash, CacheKey{old.codepoints, old.styles});
+    if (!oldEntry)
+        return nullopt;
+
+    GlyphPositionList const& oldGlyphs = oldEntry->glyphPositions;
+    auto const oldCells = old.clusters.back() + 1;
+    auto const newCells = static_cast<int>(clusterOffset_);
+    auto const oldSize = old.codepoints.size();
+    auto const newSize = codepoints_.size();
+
+    // Cells are compared by their codepoints, the clusters telling the cells apart.
+    auto prefix = size_t{0};
+    while (prefix < oldSize && prefix < newSize
+           && old.codepoints[prefix] == codepoints_[prefix]
+           && old.clusters[prefix] == clusters_[prefix])
+        ++prefix;
+    auto const prefixCells = std::min(prefix < oldSize ? old.clusters[prefix] : oldCells,
+                                      prefix < newSize ? clusters_[prefix] : newCells);
+
+    auto suffix = size_t{0};
+    while (suffix < oldSize - prefix && suffix < newSize - prefix
+           && old.codepoints[oldSize - 1 - suffix] == codepoints_[newSize - 1 - suffix]
+           && oldCells - old.clusters[oldSize - 1 - suffix] == newCells - clusters_[newSize - 1 - suffix])
+        ++suffix;
+    auto const suffixCells = std::min(suffix < oldSize ? oldCells - 1 - old.clusters[oldSize - 1 - suffix] : oldCells,
+                                      suffix < newSize ? newCells - 1 - clusters_[newSize - 1 - suffix] : newCells);
+
+    // A cell of the previous text is a safe break point if its first glyph may be broken
+    // in front of, in which case the glyphs before and after it are shaped independently.
+    auto safeBreaks = vector<bool>(static_cast<size_t>(oldCells), false);
+    for (size_t i = 0; i < oldGlyphs.size(); ++i)
+        if (i == 0 || oldGlyphs[i].cluster > oldGlyphs[i - 1].cluster)
+            safeBreaks[static_cast<size_t>(oldGlyphs[i].cluster)] = !oldGlyphs[i].unsafeToBreak;
+
+    auto from = prefixCells - IncrementalShapingContextCells;
+    while (from > 0 && !safeBreaks[static_cast<size_t>(from)])
+        --from;
+    from = std::max(from, 0);
+
+    auto to = oldCells - suffixCells + IncrementalShapingContextCells;
+    while (to < oldCells && !safeBreaks[static_cast<size_t>(to)])
+        ++to;
+    to = std::min(to, oldCells);
+
+    auto const delta = newCells - oldCells;
+    if ((from == 0 && to == oldCells) || to + delta < from)
+        return nullopt;
 
-    GlyphPositionList glyphPositions;
-    unicode::run_segmenter::range run;
-    auto rs = unicode::run_segmenter(codepoints_.data(), codepoints_.size());
-    while (rs.consume(out(run)))
+    auto const advanceX = fonts_.regular.first.get().maxAdvance();
+    auto const first = static_cast<size_t>(std::lower_bound(clusters_.begin(), clusters_.end(), from) - clusters_.begin());
+    auto const last = static_cast<size_t>(std::lower_bound(clusters_.begin(), clusters_.end(), to + delta) - clusters_.begin());
+
+    auto runCount = 0u;
+    auto const changed = shapeText(textShaper_, fonts_, _key.styles, _key.text.substr(first, last - first),
+                                   clusters_.data() + first, runCount);
+    METRIC_ADD(shapedText, runCount);
+    METRIC_INCREMENT(reshapedText);
+
+    auto glyphPositions = GlyphPositionList{};
+    glyphPositions.reserve(oldGlyphs.size() + changed.size());
+    for (GlyphPosition const& gpos : oldGlyphs)
+        if (gpos.cluster < from)
+            glyphPositions.emplace_back(gpos);
+    for (GlyphPosition gpos : changed)
+    {
+        gpos.x += from * advanceX;
+        gpos.cluster += from;
+        glyphPositions.emplace_back(gpos);
+    }
+    for (GlyphPosition gpos : oldGlyphs)
     {
-        METRIC_INCREMENT(shapedText);
-        crispy::copy(prepareRun(run), std::back_inserter(glyphPositions));
+        if (gpos.cluster < to)
+            continue;
+        gpos.x += delta * advanceX;
+        gpos.cluster += delta;
+        glyphPositions.emplace_back(gpos);
     }
 
     return glyphPositions;
 }
 
-GlyphPositionList TextRenderer::prepareRun(unicode::run_segmenter::range const& _run)
+void TextRenderer::rememberSegment(uint64_t _hash)
 {
-    if ((characterStyleMask_ & CharacterStyleMask::Hidden))
-        return {};
-
-    FontStyle const textStyle = [](CharacterStyleMask const& _styles) -> FontStyle {
-        auto const bold = _styles & CharacterStyleMask::Bold
-            ? FontStyle::Bold
-            : FontStyle::Regular;
-        auto const italic = _styles & CharacterStyleMask::Italic
-            ? FontStyle::Italic
-            : FontStyle::Regular;
-        return FontStyle::Regular | bold | italic;
-    }(characterStyleMask_);
-
-    if (characterStyleMask_ & CharacterStyleMask::Blinking)
+    if (clusterOffset_ < IncrementalShapingMinCells)
+        return;
+
+    RenderedSegment& segment = renderedSegments_[segmentPosition()];
+    if (segment.hash == _hash && !segment.codepoints.empty())
+        return;
+
+    segment.hash = _hash;
+    segment.styles = characterStyleMask_;
+    segment.codepoints.assign(codepoints_.begin(), codepoints_.end());
+    segment.clusters = clusters_;
+}
+
+GlyphPositionList& TextRenderer::insertCache(uint64_t _hash, CacheKey const& _key, GlyphPositionList _glyphPositions)
+{
+    auto const bytes = ShapingCacheEntryOverhead
+                     + _key.text.size() * sizeof(char32_t)
+                     + _glyphPositions.size() * sizeof(GlyphPosition);
+
+    auto const evictions = cache_.evictions();
+    auto& entry = cache_.insert(_hash,
+                                StoredCacheKey{u32string(_key.text), _key.styles},
+                                CacheEntry{move(_glyphPositions)},
+                                bytes);
+
+    renderMetrics_.shapingCacheEvictions += static_cast<unsigned>(cache_.evictions() - evictions);
+    renderMetrics_.shapingCacheSize = static_cast<unsigned>(cache_.size());
+    renderMetrics_.shapingCacheBytes = cache_.bytes();
+
+    return entry.glyphPositions;
+}
+
+void TextRenderer::beginPrefetch()
+{
+    flushPendingSegments();
+    finish();
+    prefetching_ = true;
+}
+
+void TextRenderer::prefetchPendingSegment()
+{
+    auto const key = CacheKey{u32string_view(codepoints_.data(), codepoints_.size()), characterStyleMask_};
+    auto const hash = hashOf(key);
+
+    if (cache_.contains(hash, key) || !queuedShapingJobs_.try_emplace(hash, true).second)
+        return;
+
+    // Re-shaping a small part of the text is cheaper than having it shaped as a whole in parallel.
+    auto const start = steady_clock::now();
+    if (auto glyphPositions = reshapeIncrementally(key); glyphPositions.has_value())
     {
-        // TODO: update textshaper's shader to blink (requires current clock knowledge)
+        renderMetrics_.shapingTime += steady_clock::now() - start;
+        insertCache(hash, key, move(*glyphPositions));
+        return;
     }
 
-    bool const isEmojiPresentation = std::get<unicode::PresentationStyle>(_run.properties) == unicode::PresentationStyle::Emoji;
+    shapingJobs_.emplace_back(TextShapingPool::Job{
+        hash,
+        characterStyleMask_,
+        frameArena_.copy(key.text),
+        frameArena_.copy(clusters_.data(), clusters_.size())
+    });
+}
 
-    FontList& font = [](FontConfig& _fonts, FontStyle _style, bool _isEmoji) -> FontList& {
-        if (_isEmoji)
-            return _fonts.emoji;
+void TextRenderer::shapePrefetched()
+{
+    flushPendingSegments();
+    finish();
+    prefetching_ = false;
 
-        switch (_style)
-        {
-            case FontStyle::Bold:
-                return _fonts.bold;
-            case FontStyle::Italic:
-                return _fonts.italic;
-            case FontStyle::BoldItalic:
-                return _fonts.boldItalic;
-            case FontStyle::Regular:
-                return _fonts.regular;
-        }
-        return _fonts.regular;
-    }(fonts_, textStyle, isEmojiPresentation);
+    auto const start = steady_clock::now();
+    [[maybe_unused]] auto const runCount = shapingPool_.run(textShaper_, fonts_, shapingJobs_);
+    METRIC_ADD(shapedText, runCount);
+    renderMetrics_.shapingTime += steady_clock::now() - start;
 
-    auto const advanceX = fonts_.regular.first.get().maxAdvance();
+    for (TextShapingPool::Job& job : shapingJobs_)
+        insertCache(job.hash, CacheKey{job.codepoints, job.styles}, move(job.glyphPositions));
 
-#if 0 // !defined(NDEBUG) )// {{{ debug print
-    std::cout << fmt::format("GLRenderer.renderText() cluster:{} [{}..{}) {}",
-                              clusters_[_run.start],
-                              _run.start, _run.end,
-                              isEmojiPresentation ? "E" : "T");
-    for (size_t i = _run.start; i < _run.end; ++i)
-        std::cout << fmt::format(" {}:{}", (unsigned) codepoints_[i], clusters_[i]);
-    std::cout << '\n';
-#endif // }}}
-
-    auto gpos = textShaper_.shape(
-        std::get<unicode::Script>(_run.properties),
-        font,
-        advanceX,
-        static_cast<int>(_run.end - _run.start),
-        codepoints_.data() + _run.start,
-        clusters_.data() + _run.start,
-        -static_cast<int>(clusters_[0])
-    );
-    return gpos;
+    shapingJobs_.clear();
+    queuedShapingJobs_.clear();
 }
 
 void TextRenderer::finish()
@@ -325,40 +524,111 @@ void TextRenderer::render(QPoint _pos,
     #endif
 }
 
-optional<TextRenderer::DataRef> TextRenderer::getTextureInfo(GlyphId const& _id)
+float TextRenderer::colorGlyphScale(Font const& _font) const noexcept
+{
+    // FIXME: this `* 2` is a hack of my bad knowledge. FIXME.
+    // As I only know of emojis being colored fonts, and those take up 2 cell with units.
+    // The glyph is fit into that area, keeping its aspect ratio.
+    auto const ratioX = static_cast<float>(cellSize_.width) * 2.0f / static_cast<float>(std::max(_font.bitmapWidth(), 1));
+    auto const ratioY = static_cast<float>(cellSize_.height) / static_cast<float>(std::max(_font.bitmapHeight(), 1));
+    return std::min(ratioX, ratioY);
+}
+
+TextRenderer::TextureAtlas& TextRenderer::atlas(Font const& _font) noexcept
+{
+    if (_font.hasColor())
+        return glyphAtlas_.colorAtlas();
+    if (distanceField(_font))
+        return glyphAtlas_.distanceFieldAtlas();
+    return glyphAtlas_.monochromeAtlas();
+}
+
+GlyphKey TextRenderer::glyphKey(GlyphId const& _id)
 {
-    TextureAtlas& atlas = _id.font.get().hasColor()
-        ? colorAtlas_
-        : monochromeAtlas_;
+    Font const* font = &_id.font.get();
+    auto i = faceIds_.find(font);
+    if (i == faceIds_.end())
+    {
+        auto const faceId = distanceField(*font) || font->hasColor() ? glyphAtlas_.sizeIndependentFaceId(*font)
+                                                                     : glyphAtlas_.faceId(*font, cellSize_);
+        i = faceIds_.emplace(font, faceId).first;
+    }
+    return GlyphKey{i->second, _id.glyphIndex};
+}
 
-    return getTextureInfo(_id, atlas);
+optional<TextRenderer::DataRef> TextRenderer::getTextureInfo(GlyphId const& _id)
+{
+    return getTextureInfo(_id, atlas(_id.font.get()));
 }
 
 optional<TextRenderer::DataRef> TextRenderer::getTextureInfo(GlyphId const& _id, TextureAtlas& _atlas)
 {
-    if (optional<DataRef> const dataRef = _atlas.get(_id); dataRef.has_value())
+    if (optional<DataRef> const dataRef = _atlas.get(glyphKey(_id)); dataRef.has_value())
         return dataRef;
 
-    Font& font = _id.font.get();
-    optional<GlyphBitmap> bitmap = font.loadGlyphByIndex(_id.glyphIndex);
-    if (!bitmap.has_value())
+    // Distance fields are not kept in the glyph cache, which holds the bitmaps of each font size.
+    auto const distanceFieldGlyph = distanceField(_id.font.get());
+    if (!distanceFieldGlyph)
+        if (auto cached = glyphCache_.find(_id.font.get(), _id.glyphIndex); cached.has_value())
+            return insertGlyph(_id, *cached, _atlas);
+
+    if (rasterizer_.asynchronous())
+    {
+        // The glyph is left blank until it has been rasterized and uploaded.
+        rasterizer_.request(_id.font.get(), _id.glyphIndex, distanceFieldGlyph);
+        METRIC_INCREMENT(missingGlyphs);
         return nullopt;
+    }
+
+    if (distanceFieldGlyph)
+    {
+        auto glyph = rasterizer_.rasterizeDistanceField(_id.font.get(), _id.glyphIndex);
+        return insertGlyph(_id, glyph, _atlas);
+    }
+
+    auto glyph = rasterize(_id.font.get(), _id.glyphIndex);
+    glyphCache_.insert(_id.font.get(), glyph);
+    return insertGlyph(_id, glyph, _atlas);
+}
+
+bool TextRenderer::uploadRasterizedGlyphs()
+{
+    auto glyphs = rasterizer_.fetch();
+    for (RasterizedGlyph& glyph : glyphs)
+    {
+        auto const id = GlyphId{*glyph.font, glyph.glyphIndex};
+        if (!glyph.distanceField)
+            glyphCache_.insert(id.font.get(), glyph);
+        insertGlyph(id, glyph, atlas(id.font.get()));
+    }
+
+    METRIC_ADD(rasterizedGlyphs, static_cast<unsigned>(glyphs.size()));
+    return !glyphs.empty();
+}
+
+optional<TextRenderer::DataRef> TextRenderer::insertGlyph(GlyphId const& _id,
+                                                          RasterizedGlyph& _glyph,
+                                                          TextureAtlas& _atlas)
+{
+    // Another window may have uploaded the glyph meanwhile.
+    auto const key = glyphKey(_id);
+    if (optional<DataRef> const dataRef = _atlas.get(key); dataRef.has_value())
+        return dataRef;
+
+    // Glyphs failing to load are uploaded empty, rather than being rasterized over and over again.
+    if (!_glyph.bitmap.has_value())
+        _glyph.bitmap = GlyphBitmap{0, 0, {}};
 
+    // Colored glyphs are uploaded in their native size, and scaled to the cell size when rendered.
     auto const format = _id.font.get().hasColor() ? GL_RGBA : GL_RED;
     auto const colored = _id.font.get().hasColor() ? 1 : 0;
 
-    //auto const cw = _id.font.get()->glyph->advance.x >> 6;
-    // FIXME: this `* 2` is a hack of my bad knowledge. FIXME.
-    // As I only know of emojis being colored fonts, and those take up 2 cell with units.
-    auto const ratioX = colored ? static_cast<float>(cellSize_.width) * 2.0f / static_cast<float>(_id.font.get().bitmapWidth()) : 1.0f;
-    auto const ratioY = colored ? static_cast<float>(cellSize_.height) / static_cast<float>(_id.font.get().bitmapHeight()) : 1.0f;
-
-    auto metadata = Glyph{};
-    metadata.advance = _id.font.get()->glyph->advance.x >> 6;
-    metadata.bearing = QPoint(font->glyph->bitmap_left * ratioX, font->glyph->bitmap_top * ratioY);
-    metadata.descender = static_cast<int>(font->glyph->metrics.height >> 6) - font->glyph->bitmap_top;
-    metadata.height = static_cast<int>(static_cast<unsigned>(font->height) >> 6);
-    metadata.size = QPoint(static_cast<int>(font->glyph->bitmap.width), static_cast<int>(font->glyph->bitmap.rows));
+    auto metadata = GlyphMetrics{};
+    metadata.advance = _glyph.advance;
+    metadata.bearing = QPoint(_glyph.bitmapLeft, _glyph.bitmapTop);
+    metadata.descender = _glyph.metricsHeight - _glyph.bitmapTop;
+    metadata.height = _glyph.faceHeight;
+    metadata.size = QPoint(static_cast<int>(_glyph.width), static_cast<int>(_glyph.rows));
 
 #if 0 // !defined(NDEBUG)
     //if (_id.font.get().hasColor())
@@ -374,10 +644,10 @@ optional<TextRenderer::DataRef> TextRenderer::getTextureInfo(GlyphId const& _id,
     }
 #endif
 
-    auto& bmp = bitmap.value();
-    return _atlas.insert(_id, bmp.width, bmp.height,
-                         static_cast<unsigned>(static_cast<float>(bmp.width) * ratioX),
-                         static_cast<unsigned>(static_cast<float>(bmp.height) * ratioY),
+    auto& bmp = _glyph.bitmap.value();
+    return _atlas.insert(key, bmp.width, bmp.height,
+                         bmp.width,
+                         bmp.height,
                          format,
                          move(bmp.buffer),
                          colored,
@@ -387,19 +657,29 @@ optional<TextRenderer::DataRef> TextRenderer::getTextureInfo(GlyphId const& _id,
 void TextRenderer::renderTexture(QPoint const& _pos,
                                  QVector4D const& _color,
                                  atlas::TextureInfo const& _textureInfo,
-                                 Glyph const& _glyph,
+                                 GlyphMetrics const& _glyph,
                                  crispy::text::GlyphPosition const& _gpos)
 {
     auto const baseline = !_gpos.font.get().hasColor() ? fonts_.regular.first.get().baseline()
                                                        : _gpos.font.get().baseline();
 
+    // Distance fields and their metrics are of DistanceFieldFontSize, and scaled to the font size.
+    // Colored glyphs come in a fixed size, and are scaled to the cell size.
+    auto const distanceFieldGlyph = distanceField(_gpos.font.get());
+    auto const scale = distanceFieldGlyph ? static_cast<float>(_gpos.font.get().fontSize()) / static_cast<float>(DistanceFieldFontSize)
+                     : _gpos.font.get().hasColor() ? colorGlyphScale(_gpos.font.get())
+                     : 1.0f;
+    auto const scaled = [scale](int _value) {
+        return static_cast<int>(std::lround(static_cast<float>(_value) * scale));
+    };
+
 #if defined(LIBTERMINAL_VIEW_NATURAL_COORDS) && LIBTERMINAL_VIEW_NATURAL_COORDS
-    auto const x = _pos.x() + _gpos.x + _glyph.bearing.x();
-    auto const y = _pos.y() + _gpos.y + baseline - _glyph.descender;
+    auto const x = _pos.x() + _gpos.x + scaled(_glyph.bearing.x());
+    auto const y = _pos.y() + _gpos.y + baseline - scaled(_glyph.descender);
 #else
     auto const x = _pos.x()
                  + _gpos.x
-                 + _glyph.bearing.x();
+                 + scaled(_glyph.bearing.x());
 
     auto const y = _pos.y()
                  + _gpos.font.get().bitmapHeight()
@@ -420,7 +700,7 @@ void TextRenderer::renderTexture(QPoint const& _pos,
     );
 #endif
 
-    renderTexture(QPoint(x, y), _color, _textureInfo);
+    renderTexture(QPoint(x, y), _color, _textureInfo, scale, distanceFieldGlyph);
 
     //auto const z = 0u;
     //renderer_.scheduler().renderTexture({_textureInfo, x, y, z, _color});
@@ -428,37 +708,39 @@ void TextRenderer::renderTexture(QPoint const& _pos,
 
 void TextRenderer::renderTexture(QPoint const& _pos,
                                  QVector4D const& _color,
-                                 atlas::TextureInfo const& _textureInfo)
+                                 atlas::TextureInfo const& _textureInfo,
+                                 float _scale,
+                                 bool _distanceField)
 {
     // TODO: actually make x/y/z all signed (for future work, i.e. smooth scrolling!)
     auto const x = _pos.x();
     auto const y = _pos.y();
     auto const z = 0;
-    commandListener_.renderTexture({_textureInfo, x, y, z, _color});
+
+    // Textures are tinted by their color, which colored glyphs must not be.
+    auto const color = _textureInfo.user ? QVector4D(1.0f, 1.0f, 1.0f, 1.0f) : _color;
+
+    commandListener_.renderTexture({_textureInfo, x, y, z, color, _scale, _distanceField});
 }
 
 void TextRenderer::debugCache(std::ostream& _textOutput) const
 {
-    std::map<u32string, CacheKey> orderedKeys;
-
-    for (auto && [key, val] : cache_)
-    {
-        (void) val;
-        orderedKeys[u32string(key.text)] = key;
-    }
-
-    _textOutput << fmt::format("TextRenderer: {} cache entries:\n", orderedKeys.size());
-    for (auto && [word, key] : orderedKeys)
-    {
-#if !defined(NDEBUG)
-        auto hits = int64_t{};
-        if (auto i = cacheHits_.find(key); i != cacheHits_.end())
-            hits = i->second;
-        _textOutput << fmt::format("{:>5} : {}\n", hits, unicode::to_utf8(word));
-#else
-        _textOutput << fmt::format("  {}\n", unicode::to_utf8(word));
-#endif
-    }
+    _textOutput << fmt::format("TextRenderer: {} cache entries ({} bytes), {} hits, {} misses, {} evictions:\n",
+                               cache_.size(),
+                               cache_.bytes(),
+                               cache_.hits(),
+                               cache_.misses(),
+                               cache_.evictions());
+
+    _textOutput << fmt::format("{}\n{}\n{}\n",
+                               glyphAtlas_.monochromeAtlas().allocator(),
+                               glyphAtlas_.colorAtlas().allocator(),
+                               glyphAtlas_.distanceFieldAtlas().allocator());
+    _textOutput << fmt::format("Glyph cache: {} hits, {} misses\n", glyphCache_.hits(), glyphCache_.misses());
+
+    // most recently used first
+    for (auto const& entry : cache_)
+        _textOutput << fmt::format("{:>5} : {}\n", entry.value.hits, unicode::to_utf8(entry.key.text));
 }
 
 } // end namespace
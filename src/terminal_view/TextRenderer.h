@@ -17,10 +17,17 @@
 #include <terminal_view/ScreenCoordinates.h>
 #include <terminal_view/ShaderConfig.h>
 #include <terminal_view/FontConfig.h>
+#include <terminal_view/GlyphCache.h>
+#include <terminal_view/GlyphRasterizer.h>
+#include <terminal_view/SharedGlyphAtlas.h>
+#include <terminal_view/TextShapingPool.h>
 
 #include <crispy/Atlas.h>
 #include <crispy/AtlasRenderer.h>
-#include <crispy/FNV.h>
+#include <crispy/arena.h>
+#include <crispy/flat_hash_map.h>
+#include <crispy/hash.h>
+#include <crispy/lru_cache.h>
 #include <crispy/text/Font.h>
 #include <crispy/text/TextShaper.h>
 
@@ -31,8 +38,10 @@
 #include <QtGui/QVector4D>
 
 #include <functional>
-#include <list>
+#include <optional>
+#include <string>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
 namespace terminal::view
@@ -56,30 +65,21 @@ namespace terminal::view
         return false;
     }
 
+    /// Lookup key into the text shaping cache, referring to the text to be shaped.
     struct CacheKey {
         std::u32string_view text;
         CharacterStyleMask styles;
+    };
+
+    /// Key as stored in the text shaping cache, owning its text.
+    struct StoredCacheKey {
+        std::u32string text;
+        CharacterStyleMask styles;
 
         bool operator==(CacheKey const& _rhs) const noexcept
         {
             return text == _rhs.text && styles == _rhs.styles;
         }
-
-        bool operator!=(CacheKey const& _rhs) const noexcept
-        {
-            return !(*this == _rhs);
-        }
-
-        bool operator<(CacheKey const& _rhs) const noexcept
-        {
-            if (text < _rhs.text)
-                return true;
-
-            if (static_cast<unsigned>(styles) < static_cast<unsigned>(_rhs.styles))
-                return true;
-
-            return false;
-        }
     };
 }
 
@@ -89,16 +89,7 @@ namespace std
     struct hash<terminal::view::GlyphId> {
         size_t operator()(terminal::view::GlyphId const& _glyphId) const noexcept
         {
-            return hash<crispy::text::Font>{}(_glyphId.font.get()) + _glyphId.glyphIndex;
-        }
-    };
-
-    template <>
-    struct hash<terminal::view::CacheKey> {
-        size_t operator()(terminal::view::CacheKey const& _key) const noexcept
-        {
-            auto fnv = crispy::FNV<char32_t>{};
-            return static_cast<size_t>(fnv(fnv(_key.text.data(), _key.text.size()), static_cast<char32_t>(_key.styles)));
+            return crispy::hash_word(_glyphId.glyphIndex, hash<crispy::text::Font>{}(_glyphId.font.get()));
         }
     };
 }
@@ -112,64 +103,121 @@ class TextRenderer {
   public:
     TextRenderer(RenderMetrics& _renderMetrics,
                  crispy::atlas::CommandListener& _commandListener,
-                 crispy::atlas::TextureAtlasAllocator& _monochromeAtlasAllocator,
-                 crispy::atlas::TextureAtlasAllocator& _colorAtlasAllocator,
+                 SharedGlyphAtlas& _glyphAtlas,
                  ScreenCoordinates const& _screenCoordinates,
                  FontConfig const& _fonts,
-                 Size const& _cellSize);
+                 Size const& _cellSize,
+                 crispy::arena& _frameArena,
+                 std::function<void()> _glyphsRasterized);
 
     void setFont(FontConfig const& _fonts);
 
+    /// Follows a change of the fonts' size, keeping the text shaped at the previous size, such
+    /// that switching back to any of the recently used sizes (e.g. when zooming in and out again)
+    /// finds its text shaped already.
+    void updateFontSize();
+
     void setCellSize(Size const& _cellSize);
 
+    /// Renders monochrome glyphs from signed distance fields rasterized once at
+    /// DistanceFieldFontSize, which are scaled to any font size, rather than from bitmaps
+    /// rasterized for each font size.
+    void setDistanceFieldGlyphs(bool _enabled);
+
     void setPressure(bool _pressure) noexcept { pressure_ = _pressure; }
 
     void schedule(Coordinate const& _pos, Cell const& _cell, RGBColor const& _color);
     void flushPendingSegments();
     void finish();
 
+    /// Collects the text of subsequently scheduled cells that is missing in the cache,
+    /// instead of rendering it.
+    void beginPrefetch();
+
+    /// Shapes the text collected since beginPrefetch() in parallel and caches the results.
+    void shapePrefetched();
+
+    bool shapesInParallel() const noexcept { return shapingPool_.threadCount() > 1; }
+
+    /// Uploads the glyphs that have been rasterized in the background since the last call.
+    ///
+    /// @retval true glyphs have been uploaded, that are missing in the rows rendered before.
+    bool uploadRasterizedGlyphs();
+
+    /// Keeps rasterized glyphs in @p _directory across processes, or nowhere if empty.
+    void setGlyphCacheDirectory(FileSystem::path _directory) { glyphCache_.setDirectory(std::move(_directory)); }
+
     void debugCache(std::ostream& _textOutput) const;
+
+    /// @returns number of bytes accounted for by the text shaping caches of all retained font sizes.
+    size_t shapingCacheMemoryUsage() const noexcept;
     void clearCache();
 
   private:
     void reset(Coordinate const& _pos, CharacterStyleMask const& _styles, RGBColor const& _color);
     void extend(Cell const& _cell, int _column);
-    crispy::text::GlyphPositionList prepareRun(unicode::run_segmenter::range const& _range);
+    void prefetchPendingSegment();
 
     crispy::text::GlyphPositionList const& cachedGlyphPositions();
-    crispy::text::GlyphPositionList requestGlyphPositions();
+
+    /// Shapes the pending segment by re-shaping only the part that changed of the text that was
+    /// rendered at its position before, between safe break points, taking the rest from the cache.
+    ///
+    /// @returns the glyph positions, or std::nullopt if the segment must be shaped as a whole.
+    std::optional<crispy::text::GlyphPositionList> reshapeIncrementally(CacheKey const& _key);
+
+    /// Remembers the pending segment as rendered at its position, see reshapeIncrementally().
+    void rememberSegment(uint64_t _hash);
+
+    uint64_t segmentPosition() const noexcept
+    {
+        return (uint64_t(uint32_t(row_)) << 32) | uint32_t(startColumn_);
+    }
+
+    crispy::text::GlyphPositionList& insertCache(uint64_t _hash,
+                                                 CacheKey const& _key,
+                                                 crispy::text::GlyphPositionList _glyphPositions);
 
     void render(QPoint _pos,
                 std::vector<crispy::text::GlyphPosition> const& glyphPositions,
                 QVector4D const& _color);
 
-    /// Renders an arbitrary texture.
+    /// Renders an arbitrary texture, scaled by @p _scale.
     void renderTexture(QPoint const& _pos,
                        QVector4D const& _color,
-                       crispy::atlas::TextureInfo const& _textureInfo);
+                       crispy::atlas::TextureInfo const& _textureInfo,
+                       float _scale = 1.0f,
+                       bool _distanceField = false);
 
   private:
     // rendering
     //
-    struct Glyph {
-        QPoint size;            // glyph size
-        QPoint bearing;         // offset from baseline to left/top of glyph
-        int height;
-        int descender;
-        int advance;            // offset to advance to next glyph in line.
-    };
-    friend struct fmt::formatter<TextRenderer::Glyph>;
-
-    using TextureAtlas = crispy::atlas::MetadataTextureAtlas<GlyphId, Glyph>;
+    using TextureAtlas = SharedGlyphAtlas::TextureAtlas;
     using DataRef = TextureAtlas::DataRef;
 
+    /// @returns whether glyphs of @p _font are rendered from distance fields.
+    bool distanceField(crispy::text::Font const& _font) const noexcept
+    {
+        return distanceFieldGlyphs_ && !_font.hasColor();
+    }
+
+    /// @returns the factor the fixed size bitmaps of the color font @p _font are scaled by to fit the cells.
+    float colorGlyphScale(crispy::text::Font const& _font) const noexcept;
+
+    /// @returns the shared atlas holding the glyphs of @p _font.
+    TextureAtlas& atlas(crispy::text::Font const& _font) noexcept;
+
+    /// @returns the key of the given glyph in the shared atlas.
+    GlyphKey glyphKey(GlyphId const& _id);
+
     std::optional<DataRef> getTextureInfo(GlyphId const& _id);
     std::optional<DataRef> getTextureInfo(GlyphId const& _id, TextureAtlas& _atlas);
+    std::optional<DataRef> insertGlyph(GlyphId const& _id, RasterizedGlyph& _glyph, TextureAtlas& _atlas);
 
     void renderTexture(QPoint const& _pos,
                        QVector4D const& _color,
                        crispy::atlas::TextureInfo const& _textureInfo,
-                       Glyph const& _glyph,
+                       GlyphMetrics const& _glyph,
                        crispy::text::GlyphPosition const& _gpos);
 
     // general properties
@@ -196,19 +244,50 @@ class TextRenderer {
 
     // text shaping cache
     //
-    std::list<std::u32string> cacheKeyStorage_;
-    std::unordered_map<CacheKey, crispy::text::GlyphPositionList> cache_;
-#if !defined(NDEBUG)
-    std::unordered_map<CacheKey, int64_t> cacheHits_;
-#endif
+    struct CacheEntry {
+        crispy::text::GlyphPositionList glyphPositions;
+        int64_t hits = 0;
+    };
+    using ShapingCache = crispy::lru_cache<StoredCacheKey, CacheEntry>;
+    ShapingCache cache_;
+    int cacheFontSize_;                                         // font size of the glyph positions in cache_
+    std::vector<std::pair<int, ShapingCache>> retainedCaches_;  // of recently used font sizes, most recent last
+
+    // incremental re-shaping of long segments, such as lines being edited with ligature fonts
+    //
+    struct RenderedSegment {
+        uint64_t hash = 0;
+        CharacterStyleMask styles;
+        std::u32string codepoints;
+        std::vector<int> clusters;
+    };
+    std::unordered_map<uint64_t, RenderedSegment> renderedSegments_;   // by segmentPosition()
+
+    // parallel text shaping of cache misses
+    //
+    bool prefetching_ = false;
+    // The text of the jobs is copied into the frame arena.
+    crispy::arena& frameArena_;
+    std::vector<TextShapingPool::Job> shapingJobs_;
+    crispy::flat_hash_map<uint64_t, bool> queuedShapingJobs_;   // hashes of the jobs, as a set
+    TextShapingPool shapingPool_;
+
+    // glyph rasterization, left to background threads unless single-core
+    //
+    GlyphRasterizer rasterizer_;
+    GlyphCache glyphCache_;
 
     // target surface rendering
     //
     Size cellSize_;
+    bool distanceFieldGlyphs_ = false;
     crispy::text::TextShaper textShaper_;
     crispy::atlas::CommandListener& commandListener_;
-    TextureAtlas monochromeAtlas_;
-    TextureAtlas colorAtlas_;
+
+    // Glyph textures are shared with the other windows, whereas text shaping results refer to
+    // the fonts of this window and hence are not.
+    SharedGlyphAtlas& glyphAtlas_;
+    std::unordered_map<crispy::text::Font const*, unsigned> faceIds_;  // face IDs of the current fonts and cell size
 };
 
 } // end namespace
@@ -225,23 +304,4 @@ namespace fmt {
             return format_to(ctx.out(), "GlyphId<index:{}>", _glyphId.glyphIndex);
         }
     };
-
-    template <>
-    struct formatter<terminal::view::TextRenderer::Glyph> {
-        using Glyph = terminal::view::TextRenderer::Glyph;
-        template <typename ParseContext>
-        constexpr auto parse(ParseContext& ctx) { return ctx.begin(); }
-        template <typename FormatContext>
-        auto format(Glyph const& _glyph, FormatContext& ctx)
-        {
-            return format_to(ctx.out(), "size:{}x{}, bearing:{}x{}, height:{}, descender:{}, advance:{}",
-                _glyph.size.x(),
-                _glyph.size.y(),
-                _glyph.bearing.x(),
-                _glyph.bearing.y(),
-                _glyph.height,
-                _glyph.descender,
-                _glyph.advance);
-        }
-    };
 }
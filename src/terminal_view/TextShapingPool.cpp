@@ -0,0 +1,307 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2020 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <terminal_view/TextShapingPool.h>
+
+#include <crispy/algorithm.h>
+
+#include <unicode/run_segmenter.h>
+
+#include <functional>
+#include <utility>
+
+using std::make_unique;
+using std::move;
+using std::scoped_lock;
+using std::u32string_view;
+using std::unique_lock;
+using std::unique_ptr;
+using std::unordered_map;
+using std::vector;
+
+using crispy::text::Font;
+using crispy::text::FontList;
+using crispy::text::FontStyle;
+using crispy::text::GlyphPositionList;
+using crispy::text::TextShaper;
+
+using unicode::out;
+
+namespace terminal::view {
+
+namespace
+{
+    FontStyle fontStyle(CharacterStyleMask const& _styles)
+    {
+        auto const bold = _styles & CharacterStyleMask::Bold
+            ? FontStyle::Bold
+            : FontStyle::Regular;
+        auto const italic = _styles & CharacterStyleMask::Italic
+            ? FontStyle::Italic
+            : FontStyle::Regular;
+        return FontStyle::Regular | bold | italic;
+    }
+
+    FontList& selectFont(FontConfig& _fonts, FontStyle _style, bool _isEmoji)
+    {
+        if (_isEmoji)
+            return _fonts.emoji;
+
+        switch (_style)
+        {
+            case FontStyle::Bold:
+                return _fonts.bold;
+            case FontStyle::Italic:
+                return _fonts.italic;
+            case FontStyle::BoldItalic:
+                return _fonts.boldItalic;
+            case FontStyle::Regular:
+                return _fonts.regular;
+        }
+        return _fonts.regular;
+    }
+}
+
+GlyphPositionList shapeText(TextShaper& _shaper,
+                            FontConfig& _fonts,
+                            CharacterStyleMask _styles,
+                            u32string_view _codepoints,
+                            int const* _clusters,
+                            unsigned& _runCount)
+{
+    GlyphPositionList glyphPositions;
+    unicode::run_segmenter::range run;
+    auto rs = unicode::run_segmenter(_codepoints.data(), _codepoints.size());
+    while (rs.consume(out(run)))
+    {
+        ++_runCount;
+
+        if (_styles & CharacterStyleMask::Hidden)
+            continue;
+
+        if (_styles & CharacterStyleMask::Blinking)
+        {
+            // TODO: update textshaper's shader to blink (requires current clock knowledge)
+        }
+
+        bool const isEmojiPresentation = std::get<unicode::PresentationStyle>(run.properties) == unicode::PresentationStyle::Emoji;
+        FontList& font = selectFont(_fonts, fontStyle(_styles), isEmojiPresentation);
+        auto const advanceX = _fonts.regular.first.get().maxAdvance();
+
+        crispy::copy(
+            _shaper.shape(
+                std::get<unicode::Script>(run.properties),
+                font,
+                advanceX,
+                static_cast<int>(run.end - run.start),
+                _codepoints.data() + run.start,
+                _clusters + run.start,
+                -_clusters[0]
+            ),
+            std::back_inserter(glyphPositions)
+        );
+    }
+
+    return glyphPositions;
+}
+
+struct TextShapingPool::Worker {
+    FT_Library ft = nullptr;
+    TextShaper shaper;
+    unordered_map<Font const*, unique_ptr<Font>> clones;  // keyed by original font
+    unordered_map<Font const*, Font*> originals;          // keyed by clone
+    std::thread thread;
+
+    ~Worker()
+    {
+        shaper.clearCache();
+        clones.clear();
+        if (ft)
+            FT_Done_FreeType(ft);
+    }
+
+    /// @returns a private copy of @p _font, or nullptr if it could not be loaded.
+    ///
+    /// @param _lazy whether the copy's face is opened not before it is used.
+    Font* clone(Font& _font, bool _lazy)
+    {
+        auto& clone = clones[&_font];
+        if (clone && clone->filePath() == _font.filePath() && clone->fontSize() == _font.fontSize())
+            return clone.get();
+
+        if (clone)
+        {
+            // The shaper's caches refer to the clone by address.
+            originals.erase(clone.get());
+            shaper.clearCache();
+            clone.reset();
+        }
+
+        if (!ft && FT_Init_FreeType(&ft) != FT_Err_Ok)
+        {
+            ft = nullptr;
+            return nullptr;
+        }
+
+        if (_lazy)
+            clone = make_unique<Font>(nullptr, ft, _font.fontSize(), _font.filePath());
+        else if (FT_Face face = Font::loadFace(nullptr, ft, _font.filePath(), _font.fontSize()); face != nullptr)
+            clone = make_unique<Font>(nullptr, ft, face, _font.fontSize(), _font.filePath());
+        else
+            return nullptr;
+
+        originals[clone.get()] = &_font;
+        return clone.get();
+    }
+
+    /// Maps @p _fonts onto private copies.
+    ///
+    /// @retval false some of the fonts could not be loaded and @p _fonts is left untouched.
+    bool clone(FontList& _fonts)
+    {
+        Font* first = clone(_fonts.first.get(), false);
+        if (!first)
+            return false;
+
+        auto fallbacks = crispy::text::FontFallbackList{};
+        for (Font& fallback : _fonts.second)
+        {
+            Font* copy = clone(fallback, true);
+            if (!copy)
+                return false;
+            fallbacks.emplace_back(*copy);
+        }
+
+        _fonts = FontList{*first, move(fallbacks)};
+        return true;
+    }
+};
+
+TextShapingPool::TextShapingPool(unsigned _threadCount)
+{
+    for (unsigned i = 1; i < _threadCount; ++i)
+    {
+        auto& worker = *workers_.emplace_back(make_unique<Worker>());
+        worker.thread = std::thread(&TextShapingPool::work, this, std::ref(worker));
+    }
+}
+
+TextShapingPool::~TextShapingPool()
+{
+    {
+        auto const _l = scoped_lock{mutex_};
+        quit_ = true;
+    }
+    wakeup_.notify_all();
+
+    for (auto& worker : workers_)
+        worker->thread.join();
+}
+
+unsigned TextShapingPool::run(TextShaper& _shaper, FontConfig& _fonts, vector<Job>& _jobs)
+{
+    if (_jobs.size() < 2 || workers_.empty())
+    {
+        auto runCount = 0u;
+        for (Job& job : _jobs)
+            job.glyphPositions = shapeText(_shaper, _fonts, job.styles, job.codepoints, job.clusters, runCount);
+        return runCount;
+    }
+
+    {
+        auto const _l = scoped_lock{mutex_};
+        fonts_ = &_fonts;
+        jobs_ = &_jobs;
+        nextJob_ = 0;
+        runCount_ = 0;
+        busyWorkers_ = workers_.size();
+        ++generation_;
+    }
+    wakeup_.notify_all();
+
+    auto const runCount = shapeJobs(_shaper, _fonts, nullptr);
+
+    auto lock = unique_lock{mutex_};
+    done_.wait(lock, [&]() { return busyWorkers_ == 0; });
+    fonts_ = nullptr;
+    jobs_ = nullptr;
+    lock.unlock();
+
+    // Fallback fonts first used by a worker are loaded here as well, as the glyphs refer
+    // to the original fonts from now on.
+    for (Job const& job : _jobs)
+        for (crispy::text::GlyphPosition const& gpos : job.glyphPositions)
+            gpos.font.get().load();
+
+    return runCount + runCount_;
+}
+
+void TextShapingPool::clearCache()
+{
+    auto const _l = scoped_lock{mutex_};
+    for (auto& worker : workers_)
+    {
+        worker->shaper.clearCache();
+        worker->originals.clear();
+        worker->clones.clear();
+    }
+}
+
+void TextShapingPool::work(Worker& _worker)
+{
+    auto generation = uint64_t{0};
+    for (;;)
+    {
+        FontConfig* fonts = nullptr;
+        {
+            auto lock = unique_lock{mutex_};
+            wakeup_.wait(lock, [&]() { return quit_ || generation_ != generation; });
+            if (quit_)
+                return;
+            generation = generation_;
+            fonts = fonts_;
+        }
+
+        auto workerFonts = *fonts;
+        bool const ready = _worker.clone(workerFonts.regular)
+                        && _worker.clone(workerFonts.bold)
+                        && _worker.clone(workerFonts.italic)
+                        && _worker.clone(workerFonts.boldItalic)
+                        && _worker.clone(workerFonts.emoji);
+
+        // A worker that failed to load its fonts leaves the jobs to the others.
+        if (ready)
+            runCount_ += shapeJobs(_worker.shaper, workerFonts, &_worker);
+
+        auto const _l = scoped_lock{mutex_};
+        if (--busyWorkers_ == 0)
+            done_.notify_one();
+    }
+}
+
+unsigned TextShapingPool::shapeJobs(TextShaper& _shaper, FontConfig& _fonts, Worker* _worker)
+{
+    auto runCount = 0u;
+    for (auto i = nextJob_++; i < jobs_->size(); i = nextJob_++)
+    {
+        Job& job = (*jobs_)[i];
+        job.glyphPositions = shapeText(_shaper, _fonts, job.styles, job.codepoints, job.clusters, runCount);
+
+        if (_worker)
+            for (crispy::text::GlyphPosition& gpos : job.glyphPositions)
+                gpos.font = *_worker->originals.at(&gpos.font.get());
+    }
+    return runCount;
+}
+
+} // end namespace
@@ -0,0 +1,104 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2020 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <terminal/Screen.h>
+#include <terminal_view/FontConfig.h>
+
+#include <crispy/text/Font.h>
+#include <crispy/text/TextShaper.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace terminal::view {
+
+/// Shapes the given text with the fonts matching its styles, one run at a time.
+///
+/// @param _runCount incremented by the number of runs that went through text shaping
+crispy::text::GlyphPositionList shapeText(crispy::text::TextShaper& _shaper,
+                                          FontConfig& _fonts,
+                                          CharacterStyleMask _styles,
+                                          std::u32string_view _codepoints,
+                                          int const* _clusters,
+                                          unsigned& _runCount);
+
+/**
+ * Shapes independent texts in parallel.
+ *
+ * Neither HarfBuzz buffers nor FreeType faces may be used concurrently, therefore every worker
+ * thread owns its text shaper as well as its own FreeType instance with private copies of the
+ * font faces. The glyph positions of the results refer to the fonts passed in, though.
+ */
+class TextShapingPool {
+  public:
+    /// Text to be shaped, referring to codepoints and clusters that outlive the run.
+    struct Job {
+        uint64_t hash;
+        CharacterStyleMask styles;
+        std::u32string_view codepoints;
+        int const* clusters;            // one per codepoint
+        crispy::text::GlyphPositionList glyphPositions{};
+    };
+
+    /// @param _threadCount number of threads shaping, including the thread invoking run().
+    explicit TextShapingPool(unsigned _threadCount);
+    ~TextShapingPool();
+
+    TextShapingPool(TextShapingPool const&) = delete;
+    TextShapingPool& operator=(TextShapingPool const&) = delete;
+
+    unsigned threadCount() const noexcept { return static_cast<unsigned>(workers_.size()) + 1; }
+
+    /// Shapes all @p _jobs, blocking until done.
+    ///
+    /// The calling thread takes part with @p _shaper on the original fonts.
+    ///
+    /// @returns the number of runs that went through text shaping.
+    unsigned run(crispy::text::TextShaper& _shaper, FontConfig& _fonts, std::vector<Job>& _jobs);
+
+    /// Releases the workers' copies of the font faces, e.g. after the fonts have changed.
+    void clearCache();
+
+  private:
+    struct Worker;
+
+    void work(Worker& _worker);
+    unsigned shapeJobs(crispy::text::TextShaper& _shaper, FontConfig& _fonts, Worker* _worker);
+
+    std::vector<std::unique_ptr<Worker>> workers_;
+
+    std::mutex mutex_;
+    std::condition_variable wakeup_;
+    std::condition_variable done_;
+    uint64_t generation_ = 0;
+    size_t busyWorkers_ = 0;
+    bool quit_ = false;
+
+    // state of the current run
+    FontConfig* fonts_ = nullptr;
+    std::vector<Job>* jobs_ = nullptr;
+    std::atomic<size_t> nextJob_ = 0;
+    std::atomic<unsigned> runCount_ = 0;
+};
+
+} // end namespace
@@ -0,0 +1,373 @@
+/**
+ * This file is part of the "libterminal" project
+ *   Copyright (c) 2019-2020 Christian Parpart <christian@parpart.family>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Measures the renderer alone, by rendering canned screen states into an offscreen framebuffer.
+//
+// Each scenario writes its screen state anew before every frame, such that every row is rendered
+// again, and reports the CPU time issuing the frame, the GPU time executing it, the draw calls and
+// the bytes uploaded per frame. The results can be saved as baseline and compared against later on.
+//
+// Usage: render_bench [--frames=N] [--warmup=N] [--font=PATTERN] [--font-size=PIXELS]
+//                     [--filter=SUBSTRING] [--save-baseline=FILE] [--baseline=FILE] [--tolerance=PERCENT]
+//
+// Runs without any display when using the offscreen platform plugin, which is the default.
+
+#include <terminal_view/HeadlessView.h>
+
+#include <terminal/Selector.h>
+#include <terminal/pty/MockPty.h>
+
+#include <crispy/text/FontLoader.h>
+
+#include <fmt/format.h>
+
+#include <QtGui/QGuiApplication>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using namespace std;
+using namespace std::chrono;
+using namespace terminal;
+using namespace terminal::view;
+
+namespace
+{
+    constexpr auto ScreenSize = Size{120, 40};
+
+    // {{{ scenarios
+    /// @returns @p _line repeated over every row of the screen, each row being addressed directly.
+    string fillScreen(function<string(int _row)> const& _line)
+    {
+        string s = "\033[?25l";
+        for (int row = 1; row <= ScreenSize.height; ++row)
+            s += fmt::format("\033[{};1H{}\033[m", row, _line(row));
+        return s;
+    }
+
+    string denseText()
+    {
+        return fillScreen([](int _row) {
+            string_view constexpr text = "The quick brown fox jumps over the lazy dog; 0123456789 (){}[]<>+-*/=!?#$%&|~^_";
+            string s;
+            for (int i = 0; static_cast<int>(s.size()) < ScreenSize.width; ++i)
+                s += text[static_cast<size_t>(_row + i) % text.size()];
+            return s.substr(0, static_cast<size_t>(ScreenSize.width));
+        });
+    }
+
+    string emoji()
+    {
+        return fillScreen([](int _row) {
+            string_view constexpr glyphs[] = {
+                "\xF0\x9F\x98\x80", "\xF0\x9F\x91\x8D\xF0\x9F\x8F\xBC", "\xF0\x9F\x9A\x80", "\xE2\x9D\xA4\xEF\xB8\x8F",
+                "\xF0\x9F\x8C\x8D", "\xF0\x9F\x90\xA7", "\xF0\x9F\x8D\x95", "\xF0\x9F\x87\xA9\xF0\x9F\x87\xAA"
+            };
+            string s;
+            for (int i = 0; i < ScreenSize.width / 2; ++i)
+                s += glyphs[static_cast<size_t>(_row + i) % size(glyphs)];
+            return s;
+        });
+    }
+
+    string ligatures()
+    {
+        return fillScreen([](int _row) {
+            string_view constexpr code = "if (a != b && c >= d || e <= f) { x -> y; z => w; p == q; r === s; } // ";
+            string s;
+            for (int i = 0; static_cast<int>(s.size()) < ScreenSize.width; ++i)
+                s += code[static_cast<size_t>(_row * 3 + i) % code.size()];
+            return s.substr(0, static_cast<size_t>(ScreenSize.width));
+        });
+    }
+
+    string trueColorBackgrounds()
+    {
+        return fillScreen([](int _row) {
+            string s;
+            for (int column = 0; column < ScreenSize.width; ++column)
+                s += fmt::format("\033[38;2;{};{};{};48;2;{};{};{}m{}",
+                                 255 - column * 2, _row * 6, column * 2,
+                                 column * 2, 255 - _row * 6, (column * _row) % 256,
+                                 static_cast<char>('a' + (column + _row) % 26));
+            return s;
+        });
+    }
+
+    string sixelImages()
+    {
+        // Four images of 96x48 pixels in a row on top of some text.
+        string s = denseText();
+        for (int image = 0; image < 4; ++image)
+        {
+            s += fmt::format("\033[2;{}H\033Pq\"1;1;96;48#0;2;{};0;0#1;2;0;{};100", 2 + image * 30, 25 * image, 100 - 25 * image);
+            for (int band = 0; band < 8; ++band)
+            {
+                s += band % 2 ? "#0" : "#1";
+                s += "!96~-";
+            }
+            s += "\033\\";
+        }
+        return s;
+    }
+    // }}}
+
+    struct Scenario {
+        string_view name;
+        string output;                      // written before every frame
+        bool selection = false;             // selects most of the screen before rendering
+    };
+
+    vector<Scenario> scenarios()
+    {
+        return {
+            {"dense_text", denseText()},
+            {"emoji", emoji()},
+            {"ligatures", ligatures()},
+            {"true_color_backgrounds", trueColorBackgrounds()},
+            {"sixel_images", sixelImages()},
+            {"selection", denseText(), true},
+        };
+    }
+
+    struct Result {
+        double cpuMedian = 0;               // in microseconds
+        double cpuP99 = 0;                  // in microseconds
+        optional<double> gpuMedian;         // in microseconds
+        double drawCalls = 0;               // per frame
+        double uploadedBytes = 0;           // per frame
+    };
+
+    double percentile(vector<nanoseconds> _samples, double _percentile)
+    {
+        if (_samples.empty())
+            return 0;
+        sort(_samples.begin(), _samples.end());
+        auto const index = min(_samples.size() - 1, static_cast<size_t>(_percentile / 100.0 * static_cast<double>(_samples.size())));
+        return duration<double, micro>(_samples[index]).count();
+    }
+
+    Result run(Scenario const& _scenario, FontConfig const& _fonts, int _warmupFrames, int _frames)
+    {
+        auto view = HeadlessView{
+            _fonts,
+            ColorProfile{},
+            make_unique<MockPty>(ScreenSize),
+            Process::ExecInfo{"/bin/sh", {"-c", "exit 0"}, FileSystem::path{}, Process::Environment{}}
+        };
+        auto& terminal = view.terminal();
+
+        terminal.writeToScreen(_scenario.output);
+        if (_scenario.selection)
+        {
+            auto const _l = scoped_lock{terminal};
+            auto selector = make_unique<Selector>(Selector::Mode::Linear,
+                                                  terminal.wordDelimiters(),
+                                                  terminal.screen(),
+                                                  terminal.absoluteCoordinate(Coordinate{5, 10}));
+            selector->extend(terminal.absoluteCoordinate(Coordinate{ScreenSize.height - 5, ScreenSize.width - 10}));
+            selector->stop();
+            terminal.setSelector(move(selector));
+        }
+
+        // Warming up renders the glyphs, which are rasterized in the background meanwhile.
+        for (int i = 0; i < _warmupFrames; ++i)
+        {
+            terminal.writeToScreen(_scenario.output);
+            view.render(steady_clock::now());
+        }
+
+        auto cpuTimes = vector<nanoseconds>{};
+        auto gpuTimes = vector<nanoseconds>{};
+        auto drawCalls = uint64_t{0};
+        auto uploadedBytes = uint64_t{0};
+        for (int i = 0; i < _frames; ++i)
+        {
+            terminal.writeToScreen(_scenario.output);
+            view.render(steady_clock::now());
+
+            auto const& times = view.frameTimes();
+            cpuTimes.push_back(times.cpu);
+            if (times.gpu)
+                gpuTimes.push_back(*times.gpu);
+
+            auto const& metrics = view.view().renderer().metrics();
+            drawCalls += metrics.drawCalls;
+            uploadedBytes += metrics.uploadedBytes;
+        }
+
+        auto result = Result{};
+        result.cpuMedian = percentile(cpuTimes, 50);
+        result.cpuP99 = percentile(cpuTimes, 99);
+        if (!gpuTimes.empty())
+            result.gpuMedian = percentile(gpuTimes, 50);
+        result.drawCalls = static_cast<double>(drawCalls) / _frames;
+        result.uploadedBytes = static_cast<double>(uploadedBytes) / _frames;
+        return result;
+    }
+
+    // {{{ baselines
+    // One line per scenario: name, CPU median (us), GPU median (us, or -1), draw calls, uploaded bytes.
+    map<string, Result> loadBaseline(string const& _path)
+    {
+        auto baseline = map<string, Result>{};
+        auto input = ifstream{_path};
+        string line;
+        while (getline(input, line))
+        {
+            auto fields = istringstream{line};
+            string name;
+            Result result;
+            double gpuMedian = -1;
+            if (fields >> name >> result.cpuMedian >> gpuMedian >> result.drawCalls >> result.uploadedBytes)
+            {
+                if (gpuMedian >= 0)
+                    result.gpuMedian = gpuMedian;
+                baseline[name] = result;
+            }
+        }
+        return baseline;
+    }
+
+    void saveBaseline(string const& _path, map<string, Result> const& _results)
+    {
+        auto output = ofstream{_path, ios::trunc};
+        for (auto const& [name, result] : _results)
+            output << fmt::format("{} {:.1f} {:.1f} {:.1f} {:.0f}\n",
+                                  name,
+                                  result.cpuMedian,
+                                  result.gpuMedian.value_or(-1.0),
+                                  result.drawCalls,
+                                  result.uploadedBytes);
+    }
+
+    /// @returns the relative change from @p _baseline to @p _value in percent.
+    double change(double _value, double _baseline)
+    {
+        return _baseline > 0 ? (_value - _baseline) / _baseline * 100.0 : 0.0;
+    }
+    // }}}
+
+    optional<string> argument(QStringList const& _arguments, string_view _name)
+    {
+        auto const prefix = QString::fromUtf8(_name.data(), static_cast<int>(_name.size())) + '=';
+        for (auto const& arg : _arguments)
+            if (arg.startsWith(prefix))
+                return arg.mid(prefix.size()).toStdString();
+        return nullopt;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM"))
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+
+    QGuiApplication app(argc, argv);
+    auto const arguments = app.arguments();
+
+    auto const frames = stoi(argument(arguments, "--frames").value_or("200"));
+    auto const warmupFrames = stoi(argument(arguments, "--warmup").value_or("20"));
+    auto const tolerance = stod(argument(arguments, "--tolerance").value_or("10"));
+    auto const fontPattern = argument(arguments, "--font").value_or("monospace");
+    auto const fontSize = stoi(argument(arguments, "--font-size").value_or("16"));
+    auto const filter = argument(arguments, "--filter").value_or("");
+    auto const baselinePath = argument(arguments, "--baseline");
+    auto const saveBaselinePath = argument(arguments, "--save-baseline");
+
+    crispy::text::FontLoader fontLoader;
+    auto const fonts = FontConfig{
+        fontLoader.load(fontPattern, fontSize),
+        fontLoader.load(fontPattern + ":style=bold", fontSize),
+        fontLoader.load(fontPattern + ":style=italic", fontSize),
+        fontLoader.load(fontPattern + ":style=bold italic", fontSize),
+        fontLoader.load("emoji", fontSize)
+    };
+
+    auto const baseline = baselinePath ? loadBaseline(*baselinePath) : map<string, Result>{};
+    auto results = map<string, Result>{};
+    auto regressions = 0;
+
+    cout << fmt::format("{:<24}{:>12}{:>12}{:>12}{:>12}{:>14}\n",
+                        "scenario", "CPU p50 us", "CPU p99 us", "GPU p50 us", "draw calls", "upload bytes");
+
+    for (Scenario const& scenario : scenarios())
+    {
+        if (scenario.name.find(filter) == string_view::npos)
+            continue;
+
+        auto const result = [&]() {
+            try
+            {
+                return optional<Result>{run(scenario, fonts, warmupFrames, frames)};
+            }
+            catch (std::exception const& e)
+            {
+                cerr << fmt::format("{}: {}\n", scenario.name, e.what());
+                return optional<Result>{};
+            }
+        }();
+        if (!result)
+            return EXIT_FAILURE;
+
+        auto const name = string(scenario.name);
+        results[name] = *result;
+
+        cout << fmt::format("{:<24}{:>12.1f}{:>12.1f}{:>12}{:>12.1f}{:>14.0f}\n",
+                            name,
+                            result->cpuMedian,
+                            result->cpuP99,
+                            result->gpuMedian ? fmt::format("{:.1f}", *result->gpuMedian) : "n/a",
+                            result->drawCalls,
+                            result->uploadedBytes);
+
+        if (auto const i = baseline.find(name); i != baseline.end())
+        {
+            // Draw calls and uploads are deterministic, while times are compared with some tolerance.
+            auto const& base = i->second;
+            auto const cpuChange = change(result->cpuMedian, base.cpuMedian);
+            auto const gpuChange = result->gpuMedian && base.gpuMedian ? change(*result->gpuMedian, *base.gpuMedian) : 0.0;
+            auto const regressed = cpuChange > tolerance
+                                || gpuChange > tolerance
+                                || result->drawCalls > base.drawCalls
+                                || result->uploadedBytes > base.uploadedBytes;
+            cout << fmt::format("{:<24}{:>+11.1f}%{:>12}{:>+11.1f}%{:>+12.1f}{:>+14.0f}{}\n",
+                                "  vs. baseline",
+                                cpuChange,
+                                "",
+                                gpuChange,
+                                result->drawCalls - base.drawCalls,
+                                result->uploadedBytes - base.uploadedBytes,
+                                regressed ? "  REGRESSED" : "");
+            if (regressed)
+                ++regressions;
+        }
+    }
+
+    if (saveBaselinePath)
+        saveBaseline(*saveBaselinePath, results);
+
+    return regressions ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -1,11 +1,18 @@
 uniform mat4 u_projection;
-layout (location = 0) in mediump vec3 vs_vertex;    // target vertex coordinates
-layout (location = 1) in mediump vec4 vs_colors;    // custom foreground colors
+uniform float u_scrollOffset;                       // vertical offset of all rectangles, scrolling them by pixels
+layout (location = 0) in mediump vec3 vs_vertex;    // target coordinates of the rectangle's lower left corner
+layout (location = 1) in mediump vec2 vs_size;      // target size of the rectangle
+layout (location = 2) in mediump vec4 vs_colors;    // custom foreground colors
 
 out mediump vec4 fs_textColor;
 
+// Corners of the quad's two triangles, selected by gl_VertexID, as each rectangle is drawn as one instance.
+const vec2 corners[6] = vec2[6](vec2(0.0, 1.0), vec2(0.0, 0.0), vec2(1.0, 0.0),
+                                vec2(0.0, 1.0), vec2(1.0, 0.0), vec2(1.0, 1.0));
+
 void main()
 {
-    gl_Position = u_projection * vec4(vs_vertex.xyz, 1.0);
+    vec2 corner = corners[gl_VertexID];
+    gl_Position = u_projection * vec4(vs_vertex.xy + vec2(0.0, u_scrollOffset) + corner * vs_size, vs_vertex.z, 1.0);
     fs_textColor = vs_colors;
 }
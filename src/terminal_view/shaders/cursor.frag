@@ -0,0 +1,15 @@
+uniform mediump vec4 u_color;
+uniform highp float u_time;                         // current time in seconds
+uniform highp float u_blinkStart;                   // time the cursor became visible at
+uniform highp float u_blinkInterval;                // duration of each blink phase, or 0.0 for a steady cursor
+
+out mediump vec4 outColor;
+
+void main()
+{
+    // The cursor is visible in the first half of every blink period.
+    highp float visible = u_blinkInterval > 0.0
+                          ? 1.0 - step(u_blinkInterval, mod(u_time - u_blinkStart, 2.0 * u_blinkInterval))
+                          : 1.0;
+    outColor = vec4(u_color.rgb, u_color.a * visible);
+}
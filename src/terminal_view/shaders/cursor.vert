@@ -0,0 +1,23 @@
+uniform mat4 u_projection;
+uniform float u_scrollOffset;                       // vertical offset of the cursor, scrolling it along with the rows
+uniform highp float u_time;                         // current time in seconds
+uniform mediump vec2 u_moveOffset;                  // offset of the previous cursor position, relative to the current one
+uniform highp float u_moveStart;                    // time the cursor started moving at
+uniform highp float u_moveDuration;                 // duration of the cursor motion, or 0.0 for not animating it
+
+layout (location = 0) in mediump vec3 vs_vertex;    // target coordinates of the rectangle's lower left corner
+layout (location = 1) in mediump vec2 vs_size;      // target size of the rectangle
+
+// Corners of the quad's two triangles, selected by gl_VertexID, as each rectangle is drawn as one instance.
+const vec2 corners[6] = vec2[6](vec2(0.0, 1.0), vec2(0.0, 0.0), vec2(1.0, 0.0),
+                                vec2(0.0, 1.0), vec2(1.0, 0.0), vec2(1.0, 1.0));
+
+void main()
+{
+    // Eases out of the previous position towards the current one.
+    float progress = u_moveDuration > 0.0 ? clamp((u_time - u_moveStart) / u_moveDuration, 0.0, 1.0) : 1.0;
+    float remaining = pow(1.0 - progress, 3.0);
+
+    vec2 corner = corners[gl_VertexID];
+    gl_Position = u_projection * vec4(vs_vertex.xy + vec2(0.0, u_scrollOffset) + u_moveOffset * remaining + corner * vs_size, vs_vertex.z, 1.0);
+}
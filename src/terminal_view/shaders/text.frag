@@ -1,10 +1,9 @@
-// layout (binding = 0) uniform mediump sampler2DArray fs_monochromeTextures;
-// layout (binding = 1) uniform mediump sampler2DArray fs_colorTextures;
-uniform mediump sampler2DArray fs_monochromeTextures;
-uniform mediump sampler2DArray fs_colorTextures;
+// layout (binding = 0) uniform mediump sampler2DArray fs_textures;
+uniform mediump sampler2DArray fs_textures;         // atlas of the batch being drawn, bound to GL_TEXTURE0
 
-in mediump vec4 fs_TexCoord;
+in mediump vec3 fs_TexCoord;
 in mediump vec4 fs_textColor;
+in mediump float fs_distanceField;
 
 // Dual source blending (since OpenGL 3.3)
 // layout (location = 0, index = 0) out vec4 color;
@@ -13,22 +12,15 @@ out mediump vec4 color;
 
 void main()
 {
-    if (fs_TexCoord.w == 0.0)
-    {
-        // XXX monochrome glyph (RGB)
-        //mediump vec4 alphaMap = texture(fs_monochromeTextures, fs_TexCoord.xyz);
-        //color = fs_textColor;
-        //colorMask = alphaMap;
+    // Monochrome atlases are sampled as white with the glyph's coverage as alpha value, whereas
+    // colored glyphs come with a white color, hence all textures are shaded without branching.
+    vec4 texel = texture(fs_textures, fs_TexCoord);
 
-        // when only using the RED-channel
-        mediump float v = texture(fs_monochromeTextures, fs_TexCoord.xyz).r;
-        mediump vec4 sampled = vec4(1.0, 1.0, 1.0, v);
-        color = sampled * fs_textColor;
-    }
-    else
-    {
-        // colored glyph (RGBA)
-        mediump vec4 v = texture(fs_colorTextures, fs_TexCoord.xyz);
-        color = v;
-    }
+    // Distance fields are scaled to any size, and their outline at 0.5 is smoothed over about
+    // one pixel of the target, however many texels that is.
+    mediump float smoothing = max(0.5 * fwidth(texel.a), 1.0 / 255.0);
+    mediump float coverage = smoothstep(0.5 - smoothing, 0.5 + smoothing, texel.a);
+    texel.a = mix(texel.a, coverage, fs_distanceField);
+
+    color = texel * fs_textColor;
 }
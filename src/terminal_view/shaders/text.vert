@@ -2,24 +2,31 @@
 uniform mat4 vs_projection;                         // projection matrix (flips around the coordinate system)
 uniform vec2 vs_cellSize;                           // size of a single cell.
 uniform vec2 vs_margin;                             // contains the left and bottom margin
+uniform float vs_scrollOffset;                      // vertical offset of all textures, scrolling them by pixels
 
-layout (location = 0) in mediump vec3 vs_vertex;    // target vertex coordinates
-layout (location = 1) in mediump vec4 vs_texCoords; // 3D-atlas texture coordinates
-layout (location = 2) in mediump vec4 vs_colors;    // custom foreground colors
+layout (location = 0) in mediump vec3 vs_vertex;    // target coordinates of the texture's lower left corner
+layout (location = 1) in mediump vec2 vs_size;      // target size of the texture
+layout (location = 2) in mediump vec4 vs_texCoords; // atlas coordinates (x, y) and extent (width, height) of the texture
+layout (location = 3) in mediump float vs_layer;    // atlas layer
+layout (location = 4) in mediump vec4 vs_colors;    // custom foreground colors
+layout (location = 5) in mediump float vs_distanceField; // 1.0 if the texture is a signed distance field, 0.0 otherwise
 
-out mediump vec4 fs_TexCoord;
+out mediump vec3 fs_TexCoord;
 out mediump vec4 fs_textColor;
+out mediump float fs_distanceField;
+
+// Corners of the quad's two triangles, selected by gl_VertexID, as each texture is drawn as one instance.
+const vec2 corners[6] = vec2[6](vec2(0.0, 1.0), vec2(0.0, 0.0), vec2(1.0, 0.0),
+                                vec2(0.0, 1.0), vec2(1.0, 0.0), vec2(1.0, 1.0));
 
 void main()
 {
-    #if 1
-    gl_Position = vs_projection * vec4(vs_vertex.xyz, 1.0);
-    #else
-    //OLD: gl_Position = vs_projection * vec4(vs_vertex.xyz, 1.0);
-    vec2 coord = vs_margin + vs_cellSize * vs_vertex.xy;
-    gl_Position = vs_projection * vec4(coord, 0.0, 1.0);
-    #endif
+    vec2 corner = corners[gl_VertexID];
+    gl_Position = vs_projection * vec4(vs_vertex.xy + vec2(0.0, vs_scrollOffset) + corner * vs_size, vs_vertex.z, 1.0);
 
-    fs_TexCoord = vs_texCoords;
+    // The atlas stores the texture's top row first, hence the texture coordinates run downwards.
+    vec2 texCoord = vs_texCoords.xy + vec2(corner.x, 1.0 - corner.y) * vs_texCoords.zw;
+    fs_TexCoord = vec3(texCoord, vs_layer);
     fs_textColor = vs_colors;
+    fs_distanceField = vs_distanceField;
 }